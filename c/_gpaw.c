@@ -4,6 +4,7 @@
  *  Please see the accompanying LICENSE file for further information. */
 
 #include <Python.h>
+#include "threadpool.h"
 #define PY_ARRAY_UNIQUE_SYMBOL GPAW_ARRAY_API
 #include <numpy/arrayobject.h>
 
@@ -18,11 +19,17 @@ PyObject* craypat_region_begin(PyObject *self, PyObject *args);
 PyObject* craypat_region_end(PyObject *self, PyObject *args);
 #endif
 
+// Generic profiler regions (regions.c)
+PyObject* region_begin(PyObject *self, PyObject *args);
+PyObject* region_end(PyObject *self, PyObject *args);
+
 
 PyObject* symmetrize(PyObject *self, PyObject *args);
+PyObject* symmetrize_all(PyObject *self, PyObject *args);
 PyObject* symmetrize_wavefunction(PyObject *self, PyObject *args);
 PyObject* scal(PyObject *self, PyObject *args);
 PyObject* gemm(PyObject *self, PyObject *args);
+PyObject* gemm_batched(PyObject *self, PyObject *args);
 PyObject* gemv(PyObject *self, PyObject *args);
 PyObject* axpy(PyObject *self, PyObject *args);
 PyObject* d2Excdnsdnt(PyObject *self, PyObject *args);
@@ -32,11 +39,15 @@ PyObject* r2k(PyObject *self, PyObject *args);
 PyObject* dotc(PyObject *self, PyObject *args);
 PyObject* dotu(PyObject *self, PyObject *args);
 PyObject* multi_dotu(PyObject *self, PyObject *args);
+PyObject* multi_dotc(PyObject *self, PyObject *args);
 PyObject* multi_axpy(PyObject *self, PyObject *args);
 PyObject* diagonalize(PyObject *self, PyObject *args);
 PyObject* diagonalize_mr3(PyObject *self, PyObject *args);
 PyObject* general_diagonalize(PyObject *self, PyObject *args);
+PyObject* general_diagonalize_single(PyObject *self, PyObject *args);
 PyObject* inverse_cholesky(PyObject *self, PyObject *args);
+PyObject* cholesky(PyObject *self, PyObject *args);
+PyObject* cholesky_solve(PyObject *self, PyObject *args);
 PyObject* inverse_symmetric(PyObject *self, PyObject *args);
 PyObject* inverse_general(PyObject *self, PyObject *args);
 PyObject* linear_solve_band(PyObject *self, PyObject *args);
@@ -44,30 +55,53 @@ PyObject* linear_solve_tridiag(PyObject *self, PyObject *args);
 PyObject* right_eigenvectors(PyObject *self, PyObject *args);
 PyObject* NewLocalizedFunctionsObject(PyObject *self, PyObject *args);
 PyObject* NewOperatorObject(PyObject *self, PyObject *args);
+PyObject* NewPrecondObject(PyObject *self, PyObject *args);
+PyObject* mixer_residual(PyObject *self, PyObject *args);
+PyObject* mixer_overlap(PyObject *self, PyObject *args);
+PyObject* mixer_combine(PyObject *self, PyObject *args);
+PyObject* mg_restrict_residual(PyObject *self, PyObject *args);
+PyObject* apply_gradients(PyObject *self, PyObject *args);
+PyObject* gradient_correction(PyObject *self, PyObject *args);
+PyObject* add_kinetic_energy_density(PyObject *self, PyObject *args);
 PyObject* NewSplineObject(PyObject *self, PyObject *args);
 PyObject* NewTransformerObject(PyObject *self, PyObject *args);
 PyObject* pc_potential(PyObject *self, PyObject *args);
 PyObject* pc_potential_value(PyObject *self, PyObject *args);
 PyObject* elementwise_multiply_add(PyObject *self, PyObject *args);
+PyObject* scaled_elementwise_multiply_add(PyObject *self, PyObject *args);
+PyObject* axpby(PyObject *self, PyObject *args);
+PyObject* add_density(PyObject *self, PyObject *args);
 PyObject* utilities_gaussian_wave(PyObject *self, PyObject *args);
 PyObject* utilities_vdot(PyObject *self, PyObject *args);
 PyObject* utilities_vdot_self(PyObject *self, PyObject *args);
+PyObject* ewald_sums(PyObject *self, PyObject *args);
 PyObject* errorfunction(PyObject *self, PyObject *args);
 PyObject* cerf(PyObject *self, PyObject *args);
+PyObject* cerf_array(PyObject *self, PyObject *args);
+PyObject* WritePLT(PyObject *self, PyObject *args);
+PyObject* WritePLTs(PyObject *self, PyObject *args);
+PyObject* benchmark_bmgs(PyObject *self, PyObject *args);
+PyObject* perf_enable(PyObject *self, PyObject *args);
+PyObject* perf_disable(PyObject *self, PyObject *args);
 PyObject* unpack(PyObject *self, PyObject *args);
 PyObject* unpack_complex(PyObject *self, PyObject *args);
 PyObject* hartree(PyObject *self, PyObject *args);
+PyObject* hartree_batch(PyObject *self, PyObject *args);
 PyObject* localize(PyObject *self, PyObject *args);
 PyObject* NewXCFunctionalObject(PyObject *self, PyObject *args);
 PyObject* NewlxcXCFunctionalObject(PyObject *self, PyObject *args);
 PyObject* exterior_electron_density_region(PyObject *self, PyObject *args);
 PyObject* plane_wave_grid(PyObject *self, PyObject *args);
+PyObject* plane_wave_grids(PyObject *self, PyObject *args);
+PyObject* pair_densities(PyObject *self, PyObject *args);
+PyObject* hilbert_transform(PyObject *self, PyObject *args);
 PyObject* overlap(PyObject *self, PyObject *args);
 PyObject* vdw(PyObject *self, PyObject *args);
 PyObject* vdw2(PyObject *self, PyObject *args);
 PyObject* swap_arrays(PyObject *self, PyObject *args);
 PyObject* spherical_harmonics(PyObject *self, PyObject *args);
 PyObject* spline_to_grid(PyObject *self, PyObject *args);
+PyObject* splines_map(PyObject *self, PyObject *args);
 PyObject* NewLFCObject(PyObject *self, PyObject *args);
 PyObject* compiled_WITH_SL(PyObject *self, PyObject *args);
 #if defined(GPAW_WITH_SL) && defined(PARALLEL)
@@ -77,6 +111,7 @@ PyObject* get_blacs_local_shape(PyObject* self, PyObject *args);
 PyObject* blacs_destroy(PyObject *self, PyObject *args);
 PyObject* scalapack_set(PyObject *self, PyObject *args);
 PyObject* scalapack_redist(PyObject *self, PyObject *args);
+PyObject* scalapack_redist_p2p(PyObject *self, PyObject *args);
 PyObject* scalapack_diagonalize_dc(PyObject *self, PyObject *args);
 PyObject* scalapack_diagonalize_ex(PyObject *self, PyObject *args);
 #ifdef GPAW_MR3
@@ -111,11 +146,34 @@ void init_io_wrappers();
 PyObject* Py_enable_io_wrappers(PyObject *self, PyObject *args);
 PyObject* Py_disable_io_wrappers(PyObject *self, PyObject *args);
 
+// Allocation accounting (mstats.c)
+PyObject* memory_stats(PyObject *self, PyObject *args);
+
+// MPI communication statistics (mpi.c)
+#ifdef PARALLEL
+PyObject* mpi_stats_enable(PyObject *self, PyObject *args);
+PyObject* mpi_stats_disable(PyObject *self, PyObject *args);
+#endif
+
+// Set the number of worker threads used by the threaded C kernels.
+// Returns the number actually in use (thread creation can fail):
+static PyObject* set_num_threads(PyObject *self, PyObject *args)
+{
+  int n;
+  if (!PyArg_ParseTuple(args, "i", &n))
+    return NULL;
+  gpaw_threadpool_set_size(n);
+  return Py_BuildValue("i", gpaw_threadpool_size());
+}
+
 static PyMethodDef functions[] = {
+  {"set_num_threads", set_num_threads, METH_VARARGS, 0},
   {"symmetrize", symmetrize, METH_VARARGS, 0},
+  {"symmetrize_all", symmetrize_all, METH_VARARGS, 0},
   {"symmetrize_wavefunction", symmetrize_wavefunction, METH_VARARGS, 0},
   {"scal", scal, METH_VARARGS, 0},
   {"gemm", gemm, METH_VARARGS, 0},
+  {"gemm_batched", gemm_batched, METH_VARARGS, 0},
   {"gemv", gemv, METH_VARARGS, 0},
   {"axpy", axpy, METH_VARARGS, 0},
   {"d2Excdnsdnt", d2Excdnsdnt, METH_VARARGS, 0},
@@ -125,11 +183,15 @@ static PyMethodDef functions[] = {
   {"dotc", dotc, METH_VARARGS, 0},
   {"dotu", dotu, METH_VARARGS, 0},
   {"multi_dotu", multi_dotu, METH_VARARGS, 0},
+  {"multi_dotc", multi_dotc, METH_VARARGS, 0},
   {"multi_axpy", multi_axpy, METH_VARARGS, 0},
   {"diagonalize", diagonalize, METH_VARARGS, 0},
   {"diagonalize_mr3", diagonalize_mr3, METH_VARARGS, 0},
   {"general_diagonalize", general_diagonalize, METH_VARARGS, 0},
+  {"general_diagonalize_single", general_diagonalize_single, METH_VARARGS, 0},
   {"inverse_cholesky", inverse_cholesky, METH_VARARGS, 0},
+  {"cholesky", cholesky, METH_VARARGS, 0},
+  {"cholesky_solve", cholesky_solve, METH_VARARGS, 0},
   {"inverse_symmetric", inverse_symmetric, METH_VARARGS, 0},
   {"inverse_general", inverse_general, METH_VARARGS, 0},
   {"linear_solve_band", linear_solve_band, METH_VARARGS, 0},
@@ -137,19 +199,42 @@ static PyMethodDef functions[] = {
   {"right_eigenvectors", right_eigenvectors, METH_VARARGS, 0},
   {"LocalizedFunctions", NewLocalizedFunctionsObject, METH_VARARGS, 0},
   {"Operator", NewOperatorObject, METH_VARARGS, 0},
+  {"Precondition", NewPrecondObject, METH_VARARGS, 0},
+  {"mixer_residual", mixer_residual, METH_VARARGS, 0},
+  {"mixer_overlap", mixer_overlap, METH_VARARGS, 0},
+  {"mixer_combine", mixer_combine, METH_VARARGS, 0},
+  {"mg_restrict_residual", mg_restrict_residual, METH_VARARGS, 0},
+  {"apply_gradients", apply_gradients, METH_VARARGS, 0},
+  {"gradient_correction", gradient_correction, METH_VARARGS, 0},
+  {"add_kinetic_energy_density", add_kinetic_energy_density, METH_VARARGS, 0},
   {"Spline", NewSplineObject, METH_VARARGS, 0},
   {"Transformer", NewTransformerObject, METH_VARARGS, 0},
   {"elementwise_multiply_add", elementwise_multiply_add, METH_VARARGS, 0},
+  {"scaled_elementwise_multiply_add", scaled_elementwise_multiply_add,
+   METH_VARARGS, 0},
+  {"axpby", axpby, METH_VARARGS, 0},
+  {"add_density", add_density, METH_VARARGS, 0},
   {"utilities_gaussian_wave", utilities_gaussian_wave, METH_VARARGS, 0},
   {"utilities_vdot", utilities_vdot, METH_VARARGS, 0},
   {"utilities_vdot_self", utilities_vdot_self, METH_VARARGS, 0},
+  {"ewald_sums", ewald_sums, METH_VARARGS, 0},
   {"eed_region", exterior_electron_density_region, METH_VARARGS, 0},
   {"plane_wave_grid", plane_wave_grid, METH_VARARGS, 0},
+  {"plane_wave_grids", plane_wave_grids, METH_VARARGS, 0},
+  {"pair_densities", pair_densities, METH_VARARGS, 0},
+  {"hilbert_transform", hilbert_transform, METH_VARARGS, 0},
+  {"WritePLT", WritePLT, METH_VARARGS, 0},
+  {"WritePLTs", WritePLTs, METH_VARARGS, 0},
+  {"benchmark_bmgs", benchmark_bmgs, METH_VARARGS, 0},
+  {"perf_enable",  perf_enable,  METH_VARARGS, 0},
+  {"perf_disable", perf_disable, METH_VARARGS, 0},
   {"erf",        errorfunction,        METH_VARARGS, 0},
   {"cerf",       cerf,        METH_VARARGS, 0},
+  {"cerf_array", cerf_array,  METH_VARARGS, 0},
   {"unpack",       unpack,           METH_VARARGS, 0},
   {"unpack_complex",       unpack_complex,           METH_VARARGS, 0},
   {"hartree",        hartree,        METH_VARARGS, 0},
+  {"hartree_batch",  hartree_batch,  METH_VARARGS, 0},
   {"localize",       localize,        METH_VARARGS, 0},
   {"XCFunctional",    NewXCFunctionalObject,    METH_VARARGS, 0},
   /*  {"MGGAFunctional",    NewMGGAFunctionalObject,    METH_VARARGS, 0},*/
@@ -163,6 +248,7 @@ static PyMethodDef functions[] = {
   {"pc_potential", pc_potential, METH_VARARGS, 0},
   {"pc_potential_value", pc_potential_value, METH_VARARGS, 0},
   {"spline_to_grid", spline_to_grid, METH_VARARGS, 0},
+  {"splines_map", splines_map, METH_VARARGS, 0},
   {"LFC", NewLFCObject, METH_VARARGS, 0},
   /*
   {"calculate_potential_matrix", calculate_potential_matrix, METH_VARARGS, 0},
@@ -176,6 +262,7 @@ static PyMethodDef functions[] = {
   {"blacs_destroy",     blacs_destroy,      METH_VARARGS, 0},
   {"scalapack_set", scalapack_set, METH_VARARGS, 0}, 
   {"scalapack_redist",      scalapack_redist,     METH_VARARGS, 0},
+  {"scalapack_redist_p2p",  scalapack_redist_p2p, METH_VARARGS, 0},
   {"scalapack_diagonalize_dc", scalapack_diagonalize_dc, METH_VARARGS, 0}, 
   {"scalapack_diagonalize_ex", scalapack_diagonalize_ex, METH_VARARGS, 0},
 #ifdef GPAW_MR3
@@ -203,6 +290,8 @@ static PyMethodDef functions[] = {
   {"craypat_region_begin", craypat_region_begin, METH_VARARGS, 0},
   {"craypat_region_end", craypat_region_end, METH_VARARGS, 0},
 #endif // GPAW_CRAYPAT
+  {"region_begin", region_begin, METH_VARARGS, 0},
+  {"region_end", region_end, METH_VARARGS, 0},
   {"mlsqr", mlsqr, METH_VARARGS, 0}, 
 #ifdef HDF5
   {"h5_set_fapl_mpio", set_fapl_mpio, METH_VARARGS, 0}, 
@@ -210,6 +299,11 @@ static PyMethodDef functions[] = {
 #endif // HDF5
   {"enable_io_wrappers", Py_enable_io_wrappers, METH_VARARGS, 0},
   {"disable_io_wrappers", Py_disable_io_wrappers, METH_VARARGS, 0},
+  {"memory_stats", memory_stats, METH_VARARGS, 0},
+#ifdef PARALLEL
+  {"mpi_stats_enable", mpi_stats_enable, METH_VARARGS, 0},
+  {"mpi_stats_disable", mpi_stats_disable, METH_VARARGS, 0},
+#endif // PARALLEL
   {0, 0, 0, 0}
 };
 
@@ -235,6 +329,10 @@ PyMODINIT_FUNC init_gpaw(void)
   PyModule_AddObject(m, "Communicator", (PyObject *)&MPIType);
 #endif
 
+  // Create the shared worker-thread pool up front so the first
+  // stencil/transfer apply does not pay for thread creation:
+  gpaw_threadpool_init();
+
   import_array();
 }
 #endif
@@ -266,12 +364,17 @@ main(int argc, char **argv)
   PAT_region_begin(1, "C-Initializations");
 #endif
 
-#ifndef GPAW_OMP
-  MPI_Init(&argc, &argv);
-#else
+#if defined(GPAW_OMP)
   int granted;
   MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &granted);
   if(granted != MPI_THREAD_MULTIPLE) exit(1);
+#elif defined(GPAW_OMP_MONLY)
+  // The thread pool funnels all MPI calls through the main thread:
+  int granted;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &granted);
+  if(granted < MPI_THREAD_FUNNELED) exit(1);
+#else
+  MPI_Init(&argc, &argv);
 #endif // GPAW_OMP
 
 #ifdef GPAW_PERFORMANCE_REPORT
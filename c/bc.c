@@ -131,6 +131,120 @@ boundary_conditions* bc_init(const long size1[3],
         bc->maxrecv = n;
     }
 
+#ifdef PARALLEL
+  // Shared-memory exchange with on-node neighbors.  Each rank owns six
+  // fixed slots (one per face) in a node-shared window; the slot size
+  // is published in a one-double header so that neighbors with
+  // different local grids can locate our slots.  Faces are exchanged by
+  // packing into our slot and sending a zero-byte notification with
+  // the normal tag, so bc_unpack2's waits are unchanged.  Only
+  // single-band, thread-0 exchanges use the window (the slots are
+  // sized and laid out for one band).
+  bc->nodecomm = MPI_COMM_NULL;
+  bc->shmwin = MPI_WIN_NULL;
+  for (int i = 0; i < 3; i++)
+    for (int d = 0; d < 2; d++)
+      {
+        bc->shmsend[i][d] = NULL;
+        bc->shmrecv[i][d] = NULL;
+      }
+#ifdef GPAW_MPI3
+  if (comm != MPI_COMM_NULL)
+    {
+      MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                          &bc->nodecomm);
+      int nodesize;
+      MPI_Comm_size(bc->nodecomm, &nodesize);
+      if (nodesize == 1)
+        {
+          MPI_Comm_free(&bc->nodecomm);
+          bc->nodecomm = MPI_COMM_NULL;
+        }
+      else
+        {
+          long slot = 0;
+          for (int i = 0; i < 3; i++)
+            for (int d = 0; d < 2; d++)
+              if (bc->nsend[i][d] > slot)
+                slot = bc->nsend[i][d];
+          double* base;
+          MPI_Win_allocate_shared((1 + 6 * slot) * sizeof(double),
+                                  sizeof(double), MPI_INFO_NULL,
+                                  bc->nodecomm, &base, &bc->shmwin);
+          MPI_Win_lock_all(MPI_MODE_NOCHECK, bc->shmwin);
+          base[0] = (double)slot;
+          MPI_Win_sync(bc->shmwin);
+          MPI_Barrier(bc->nodecomm);
+
+          MPI_Group group, nodegroup;
+          MPI_Comm_group(comm, &group);
+          MPI_Comm_group(bc->nodecomm, &nodegroup);
+          for (int i = 0; i < 3; i++)
+            for (int d = 0; d < 2; d++)
+              {
+                int p = bc->sendproc[i][d];
+                int q;
+                if (p >= 0 && !bc->sjoin[i])
+                  {
+                    MPI_Group_translate_ranks(group, 1, &p, nodegroup, &q);
+                    if (q != MPI_UNDEFINED)
+                      bc->shmsend[i][d] = base + 1 + (2 * i + d) * slot;
+                  }
+                p = bc->recvproc[i][d];
+                if (p >= 0 && !bc->rjoin[i])
+                  {
+                    MPI_Group_translate_ranks(group, 1, &p, nodegroup, &q);
+                    if (q != MPI_UNDEFINED)
+                      {
+                        // The neighbor sends this face from its slot
+                        // for the opposite direction:
+                        MPI_Aint nbytes;
+                        int dispunit;
+                        double* nbase;
+                        MPI_Win_shared_query(bc->shmwin, q, &nbytes,
+                                             &dispunit, &nbase);
+                        long nslot = (long)nbase[0];
+                        bc->shmrecv[i][d] = nbase + 1
+                                          + (2 * i + (1 - d)) * nslot;
+                      }
+                  }
+              }
+          MPI_Group_free(&nodegroup);
+          MPI_Group_free(&group);
+        }
+    }
+#endif // GPAW_MPI3
+
+  // Build committed derived datatypes describing the send/receive faces
+  // directly in the extended array, so that single-band real-valued
+  // exchanges can skip the pack/unpack copies (bmgs_cut/bmgs_paste) and
+  // let the MPI library stream the faces itself.  Joined (two
+  // directions in one message) and phase-multiplied exchanges keep the
+  // packed path.
+  for (int i = 0; i < 3; i++)
+    for (int d = 0; d < 2; d++)
+      {
+        bc->sendtype[i][d] = MPI_DATATYPE_NULL;
+        bc->recvtype[i][d] = MPI_DATATYPE_NULL;
+        if (bc->ndouble != 1)
+          continue;
+        if (bc->sendproc[i][d] >= 0 && !bc->sjoin[i])
+          {
+            MPI_Type_create_subarray(3, bc->size2, bc->sendsize[i][d],
+                                     bc->sendstart[i][d], MPI_ORDER_C,
+                                     MPI_DOUBLE, &bc->sendtype[i][d]);
+            MPI_Type_commit(&bc->sendtype[i][d]);
+          }
+        if (bc->recvproc[i][d] >= 0 && !bc->rjoin[i])
+          {
+            MPI_Type_create_subarray(3, bc->size2, bc->recvsize[i][d],
+                                     bc->recvstart[i][d], MPI_ORDER_C,
+                                     MPI_DOUBLE, &bc->recvtype[i][d]);
+            MPI_Type_commit(&bc->recvtype[i][d]);
+          }
+      }
+#endif
+
   return bc;
 }
 
@@ -180,6 +294,22 @@ void bc_unpack1(const boundary_conditions* bc,
                           10 * thd + 1000 * i + 100000,
                           bc->comm, &recvreq[0]);
             }
+          else if (nin == 1 && thd == 0 && bc->shmrecv[i][d] != NULL)
+          {
+            // Face arrives through the shared window; the zero-byte
+            // message only signals that the neighbor has packed it:
+            MPI_Irecv(NULL, 0, MPI_DOUBLE, p,
+		      d + 10 * thd + 1000 * i,
+                      bc->comm, &recvreq[d]);
+          }
+          else if (real && nin == 1 &&
+                   bc->recvtype[i][d] != MPI_DATATYPE_NULL)
+          {
+            // Receive the face directly into place:
+            MPI_Irecv(aa2, 1, bc->recvtype[i][d], p,
+		      d + 10 * thd + 1000 * i,
+                      bc->comm, &recvreq[d]);
+          }
           else
           {
             MPI_Irecv(rbuff, bc->nrecv[i][d] * nin, MPI_DOUBLE, p,
@@ -201,16 +331,35 @@ void bc_unpack1(const boundary_conditions* bc,
           const int* start = bc->sendstart[i][d];
           const int* size = bc->sendsize[i][d];
 
-	  for (int m = 0; m < nin; m++)
-	    if (real)
-	      bmgs_cut(aa2 + m * ng2, bc->size2, start,
-		       sbuf + m * bc->nsend[i][d],
-		       size);
-	    else
-	      bmgs_cutmz((const double_complex*)(aa2 + m * ng2),
-			 bc->size2, start,
-			 (double_complex*)(sbuf + m * bc->nsend[i][d]),
-			 size, phases[d]);
+          bool shm = (nin == 1 && thd == 0 && bc->shmsend[i][d] != NULL);
+          bool direct = (!shm && real && nin == 1 && !bc->sjoin[i] &&
+                         bc->sendtype[i][d] != MPI_DATATYPE_NULL);
+          if (shm)
+            {
+              // Pack the face (phases and all) into our window slot:
+              if (real)
+                bmgs_cut(aa2, bc->size2, start, bc->shmsend[i][d], size);
+              else
+                bmgs_cutmz((const double_complex*)aa2, bc->size2, start,
+                           (double_complex*)bc->shmsend[i][d],
+                           size, phases[d]);
+#ifdef GPAW_MPI3
+              MPI_Win_sync(bc->shmwin);
+#endif
+            }
+          else if (!direct)
+	    {
+	      for (int m = 0; m < nin; m++)
+	        if (real)
+	          bmgs_cut(aa2 + m * ng2, bc->size2, start,
+		           sbuf + m * bc->nsend[i][d],
+		           size);
+	        else
+	          bmgs_cutmz((const double_complex*)(aa2 + m * ng2),
+			     bc->size2, start,
+			     (double_complex*)(sbuf + m * bc->nsend[i][d]),
+			     size, phases[d]);
+	    }
 
           if (bc->sjoin[i])
             {
@@ -222,6 +371,18 @@ void bc_unpack1(const boundary_conditions* bc,
                             bc->comm, &sendreq[0]);
                 }
             }
+          else if (shm)
+            {
+              // Tell the neighbor its face is ready in the window:
+              MPI_Isend(NULL, 0, MPI_DOUBLE, p,
+                        1 - d + 10 * thd + 1000 * i, bc->comm, &sendreq[d]);
+            }
+          else if (direct)
+            {
+              // Send the face directly from the extended array:
+              MPI_Isend(aa2, 1, bc->sendtype[i][d], p,
+                        1 - d + 10 * thd + 1000 * i, bc->comm, &sendreq[d]);
+            }
           else
             {
               MPI_Isend(sbuf, bc->nsend[i][d] * nin, MPI_DOUBLE, p,
@@ -231,22 +392,20 @@ void bc_unpack1(const boundary_conditions* bc,
         }
     }
 #endif // Parallel
-  for (int m = 0; m < nin; m++)
-    {
-      // Copy data for periodic boundary conditions:
-      for (int d = 0; d < 2; d++)
-        if (bc->sendproc[i][d] == COPY_DATA)
-          {
-            if (real)
-              bmgs_translate(aa2 + m * ng2, bc->size2, bc->sendsize[i][d],
-                 bc->sendstart[i][d], bc->recvstart[i][1 - d]);
-            else
-              bmgs_translatemz((double_complex*)(aa2 + m * ng2), bc->size2,
-                   bc->sendsize[i][d],
-                   bc->sendstart[i][d], bc->recvstart[i][1 - d],
-                       phases[d]);
-          }
-    }
+  // Copy data for periodic boundary conditions - all bands in one
+  // batched call with the face offsets computed once:
+  for (int d = 0; d < 2; d++)
+    if (bc->sendproc[i][d] == COPY_DATA)
+      {
+        if (real)
+          bmgs_translate(aa2, bc->size2, bc->sendsize[i][d],
+             bc->sendstart[i][d], bc->recvstart[i][1 - d], nin, ng2);
+        else
+          bmgs_translatemz((double_complex*)aa2, bc->size2,
+               bc->sendsize[i][d],
+               bc->sendstart[i][d], bc->recvstart[i][1 - d],
+                   phases[d], nin, ng2 / 2);
+      }
 }
 
 
@@ -254,7 +413,7 @@ void bc_unpack2(const boundary_conditions* bc,
     double* a2, int i,
     MPI_Request recvreq[2],
     MPI_Request sendreq[2],
-    double* rbuf, int nin)
+    double* rbuf, int thd, int nin)
 {
 #ifdef PARALLEL
   int ng2 = bc->ndouble * bc->size2[0] * bc->size2[1] * bc->size2[2];
@@ -277,8 +436,29 @@ void bc_unpack2(const boundary_conditions* bc,
               rbuf = rbuf0;
 	  }
 	else
-	  MPI_Wait(&recvreq[d], MPI_STATUS_IGNORE);
-	
+	  {
+	    MPI_Wait(&recvreq[d], MPI_STATUS_IGNORE);
+	    if (nin == 1 && thd == 0 && bc->shmrecv[i][d] != NULL)
+	      {
+	        // Copy the face out of the neighbor's window slot:
+#ifdef GPAW_MPI3
+	        MPI_Win_sync(bc->shmwin);
+#endif
+	        if (real)
+	          bmgs_paste(bc->shmrecv[i][d], bc->recvsize[i][d],
+	                     a2, bc->size2, bc->recvstart[i][d]);
+	        else
+	          bmgs_pastez((const double_complex*)bc->shmrecv[i][d],
+	                      bc->recvsize[i][d],
+	                      (double_complex*)a2,
+	                      bc->size2, bc->recvstart[i][d]);
+	        continue;
+	      }
+	    if (real && nin == 1 && bc->recvtype[i][d] != MPI_DATATYPE_NULL)
+	      // The face was received directly into place (bc_unpack1):
+	      continue;
+	  }
+
 	for (int m = 0; m < nin; m++)
 	  if (real)
 	    bmgs_paste(rbuf + m * bc->nrecv[i][d], bc->recvsize[i][d],
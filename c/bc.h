@@ -33,6 +33,21 @@ typedef struct
   int ndouble;
   bool cfd;
   MPI_Comm comm;
+#ifdef PARALLEL
+  // Committed derived datatypes describing the send/receive faces
+  // directly in the extended array (MPI_DATATYPE_NULL when the packed
+  // path must be used):
+  MPI_Datatype sendtype[3][2];
+  MPI_Datatype recvtype[3][2];
+  // Shared-memory halo exchange with on-node neighbors (MPI >= 3).
+  // Each rank packs its faces into fixed slots of a shared window and
+  // sends a zero-byte notification with the usual tag; the receiver
+  // copies the face straight out of the neighbor's segment:
+  MPI_Comm nodecomm;        // on-node subset of comm (MPI_COMM_NULL: off)
+  MPI_Win shmwin;
+  double* shmsend[3][2];    // our packed-face slot (NULL: packed path)
+  double* shmrecv[3][2];    // neighbor's packed-face slot (NULL: ditto)
+#endif
 } boundary_conditions;
 
 static const int COPY_DATA = -2;
@@ -53,4 +68,4 @@ void bc_unpack2(const boundary_conditions* bc,
     double* a2, int i,
     MPI_Request recvreq[2],
     MPI_Request sendreq[2],
-    double* rbuf, int nin);
+    double* rbuf, int thd, int nin);
@@ -0,0 +1,125 @@
+/*  Copyright (C) 2003-2007  CAMP
+ *  Copyright (C) 2007-2008  CAMd
+ *  Please see the accompanying LICENSE file for further information. */
+
+#include <Python.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "extensions.h"
+#include "bmgs/bmgs.h"
+
+/* Timed loops over the bmgs kernels, for benchmarking them in
+ * isolation (see gpaw/testing/benchmark.py).  The timing happens here
+ * so that the loop overhead is a function call, not a Python
+ * interpreter round trip.
+ *
+ * The (n0, n1, n2) argument is always the size of the coarse interior
+ * grid: fd and relax pad it by the stencil range, interpolate reads
+ * n + k - 1 points per axis and writes 2n, restrict reads
+ * 2n + 2k - 3 and writes n.
+ */
+
+static double bench_walltime(void)
+{
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 1e-6 * t.tv_usec;
+}
+
+PyObject* benchmark_bmgs(PyObject *self, PyObject *args)
+{
+  char* kernel;
+  int n0, n1, n2;
+  int k;
+  int repeats;
+  if (!PyArg_ParseTuple(args, "s(iii)ii",
+                        &kernel, &n0, &n1, &n2, &k, &repeats))
+    return NULL;
+
+  long n[3] = {n0, n1, n2};
+  long ng = (long)n0 * n1 * n2;
+  double time;
+
+  if (strcmp(kernel, "fd") == 0 || strcmp(kernel, "relax") == 0)
+    {
+      double h[3] = {0.2, 0.2, 0.2};
+      bmgsstencil s = bmgs_laplace(k, 1.0, h, n);
+      long npad = s.j[0] + n[0] * (s.j[1] + n[1] * (s.j[2] + n[2]));
+      double* a = (double*)calloc(npad, sizeof(double));
+      double* b = (double*)calloc(ng, sizeof(double));
+      double* src = (double*)calloc(ng, sizeof(double));
+      if (a == NULL || b == NULL || src == NULL)
+        return PyErr_NoMemory();
+      if (strcmp(kernel, "fd") == 0)
+        {
+          bmgs_fd(&s, a, b);   // warm up caches and the page tables
+          time = bench_walltime();
+          for (int i = 0; i < repeats; i++)
+            bmgs_fd(&s, a, b);
+          time = bench_walltime() - time;
+        }
+      else
+        {
+          bmgs_relax(1, &s, a, b, src, 2.0 / 3.0);
+          time = bench_walltime();
+          for (int i = 0; i < repeats; i++)
+            bmgs_relax(1, &s, a, b, src, 2.0 / 3.0);
+          time = bench_walltime() - time;
+        }
+      free(src);
+      free(b);
+      free(a);
+      bmgs_deletestencil(&s);
+    }
+  else if (strcmp(kernel, "interpolate") == 0)
+    {
+      int e = k - 1;
+      int m[3] = {n0 + e, n1 + e, n2 + e};
+      int skip[3][2] = {{0, 0}, {0, 0}, {0, 0}};
+      long nin = (long)m[0] * m[1] * m[2];
+      long np1 = (long)m[0] * m[1] * 2 * n2;   // after the first pass
+      double* a = (double*)calloc(nin, sizeof(double));
+      double* b = (double*)calloc((np1 > 8 * ng) ? np1 : 8 * ng,
+                                  sizeof(double));
+      double* w = (double*)calloc((long)m[0] * 4 * n1 * n2,
+                                  sizeof(double));
+      if (a == NULL || b == NULL || w == NULL)
+        return PyErr_NoMemory();
+      bmgs_interpolate(k, skip, a, m, b, w);
+      time = bench_walltime();
+      for (int i = 0; i < repeats; i++)
+        bmgs_interpolate(k, skip, a, m, b, w);
+      time = bench_walltime() - time;
+      free(w);
+      free(b);
+      free(a);
+    }
+  else if (strcmp(kernel, "restrict") == 0)
+    {
+      int e = 2 * k - 3;
+      int m[3] = {2 * n0 + e, 2 * n1 + e, 2 * n2 + e};
+      long nin = (long)m[0] * m[1] * m[2];
+      double* a = (double*)calloc(nin, sizeof(double));
+      double* b = (double*)calloc(ng, sizeof(double));
+      double* w = (double*)calloc((long)m[0] * m[1] * n2,
+                                  sizeof(double));
+      if (a == NULL || b == NULL || w == NULL)
+        return PyErr_NoMemory();
+      bmgs_restrict(k, a, m, b, w);   // note: a is also used as scratch
+      time = bench_walltime();
+      for (int i = 0; i < repeats; i++)
+        bmgs_restrict(k, a, m, b, w);
+      time = bench_walltime() - time;
+      free(w);
+      free(b);
+      free(a);
+    }
+  else
+    {
+      PyErr_SetString(PyExc_ValueError, "unknown kernel");
+      return NULL;
+    }
+
+  return Py_BuildValue("d", time);
+}
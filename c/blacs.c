@@ -445,6 +445,27 @@ PyObject* pblas_rk(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
+// Cache of BLACS contexts: grid creation involves collective
+// synchronization, and band-parallel LCAO runs create and destroy
+// thousands of identical grids for transient redistributions.
+// Identical requests get the existing context back, and
+// blacs_destroy() only drops a reference - the grids live until the
+// process exits.
+#define GPAW_BLACS_CACHE_SIZE 64
+
+struct blacs_context_entry
+{
+  MPI_Comm comm;
+  int nprow, npcol;
+  char order;
+  int ConTxt;
+  int refcount;
+};
+
+static struct blacs_context_entry
+  blacs_context_cache[GPAW_BLACS_CACHE_SIZE];
+static int blacs_context_count = 0;
+
 PyObject* new_blacs_context(PyObject *self, PyObject *args)
 {
   PyObject* comm_obj;
@@ -460,14 +481,32 @@ PyObject* new_blacs_context(PyObject *self, PyObject *args)
 
   // Create blacs grid on this communicator
   MPI_Comm comm = ((MPIObject*)comm_obj)->comm;
-  
+
+  // Hand back an existing grid if we made an identical one before:
+  for (int i = 0; i < blacs_context_count; i++)
+    {
+      struct blacs_context_entry* entry = &blacs_context_cache[i];
+      if (entry->comm == comm && entry->nprow == nprow &&
+	  entry->npcol == npcol && entry->order == order)
+	{
+	  entry->refcount++;
+	  return Py_BuildValue("i", entry->ConTxt);
+	}
+    }
+
   // Get my id and nprocs. This is for debugging purposes only
   Cblacs_pinfo_(&iam, &nprocs);
   MPI_Comm_size(comm, &nprocs);
-  
+
   // Create blacs grid on this communicator continued
   ConTxt = Csys2blacs_handle_(comm);
   Cblacs_gridinit_(&ConTxt, &order, nprow, npcol);
+  if (blacs_context_count < GPAW_BLACS_CACHE_SIZE)
+    {
+      struct blacs_context_entry entry = {comm, nprow, npcol, order,
+					  ConTxt, 1};
+      blacs_context_cache[blacs_context_count++] = entry;
+    }
   PyObject* returnvalue = Py_BuildValue("i", ConTxt);
   return returnvalue;
 }
@@ -510,6 +549,19 @@ PyObject* blacs_destroy(PyObject *self, PyObject *args)
   if (!PyArg_ParseTuple(args, "i", &ConTxt))
     return NULL;
 
+  // Cached grids are kept for reuse - only drop the reference.  The
+  // grid itself is torn down when the process exits.
+  for (int i = 0; i < blacs_context_count; i++)
+    {
+      struct blacs_context_entry* entry = &blacs_context_cache[i];
+      if (entry->ConTxt == ConTxt)
+	{
+	  if (entry->refcount > 0)
+	    entry->refcount--;
+	  Py_RETURN_NONE;
+	}
+    }
+
   Cblacs_gridexit_(ConTxt);
 
   Py_RETURN_NONE;
@@ -540,6 +592,221 @@ PyObject* scalapack_set(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
+// Direct point-to-point redistribution between two block cyclic
+// layouts on the same communicator.  pdgemr2d synchronizes every rank
+// of the union context even when a redistribution touches a handful
+// of blocks; here each rank computes the intersection map of the two
+// layouts itself and exchanges only the needed blocks with
+// nonblocking sends and receives.
+
+// Split [0, mtot) at every multiple of mb1 and mb2, so that each
+// interval lies in a single block of both layouts:
+static int redist_intervals(int mtot, int mb1, int mb2, int* lo, int* hi)
+{
+  int n = 0;
+  int i = 0;
+  while (i < mtot)
+    {
+      int next1 = (i / mb1 + 1) * mb1;
+      int next2 = (i / mb2 + 1) * mb2;
+      int j = MIN(next1, next2);
+      j = MIN(j, mtot);
+      lo[n] = i;
+      hi[n] = j;
+      n++;
+      i = j;
+    }
+  return n;
+}
+
+// Local index of global index I on the process row (column) that owns
+// it:
+static int redist_local(int g, int mb, int nprow, int pr, int rsrc)
+{
+  int b = g / mb;
+  int b0 = (pr - rsrc + nprow) % nprow;
+  return (b - b0) / nprow * mb + g % mb;
+}
+
+PyObject* scalapack_redist_p2p(PyObject *self, PyObject *args)
+{
+  PyArrayObject* desca; // source descriptor
+  PyArrayObject* descb; // destination descriptor
+  PyArrayObject* a;     // source matrix
+  PyArrayObject* b;     // destination matrix
+  PyObject* comm_obj;
+  int m, n;
+  int nprow1, npcol1, nprow2, npcol2;
+  char order1, order2;
+
+  if (!PyArg_ParseTuple(args, "OOOOiiOiiciic",
+                        &desca, &descb,
+                        &a, &b,
+                        &m, &n,
+                        &comm_obj,
+                        &nprow1, &npcol1, &order1,
+                        &nprow2, &npcol2, &order2))
+    return NULL;
+
+  int* da = INTP(desca);
+  int* db = INTP(descb);
+  int mb1 = da[4], nb1 = da[5], rsrc1 = da[6], csrc1 = da[7];
+  int mb2 = db[4], nb2 = db[5], rsrc2 = db[6], csrc2 = db[7];
+  long lld1 = MAX(1, da[8]);
+  long lld2 = MAX(1, db[8]);
+
+  MPI_Comm comm = ((MPIObject*)comm_obj)->comm;
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  long itemsize;
+  if (a->descr->type_num == PyArray_DOUBLE)
+    itemsize = sizeof(double);
+  else
+    itemsize = sizeof(double_complex);
+
+  // Intervals along both dimensions such that each interval lies in a
+  // single block of the source and of the destination layout:
+  int* rlo = GPAW_MALLOC(int, 2 * (m / mb1 + m / mb2 + 2));
+  int* rhi = rlo + m / mb1 + m / mb2 + 2;
+  int* clo = GPAW_MALLOC(int, 2 * (n / nb1 + n / nb2 + 2));
+  int* chi = clo + n / nb1 + n / nb2 + 2;
+  int nri = redist_intervals(m, mb1, mb2, rlo, rhi);
+  int nci = redist_intervals(n, nb1, nb2, clo, chi);
+
+  // Count elements exchanged with each rank:
+  long* nsend = GPAW_MALLOC(long, 2 * size);
+  long* nrecv = nsend + size;
+  for (int r = 0; r < size; r++)
+    nsend[r] = nrecv[r] = 0;
+  for (int cj = 0; cj < nci; cj++)
+    {
+      int pc1 = (clo[cj] / nb1 + csrc1) % npcol1;
+      int pc2 = (clo[cj] / nb2 + csrc2) % npcol2;
+      for (int ri = 0; ri < nri; ri++)
+        {
+          int pr1 = (rlo[ri] / mb1 + rsrc1) % nprow1;
+          int pr2 = (rlo[ri] / mb2 + rsrc2) % nprow2;
+          int rs = (order1 == 'R' || order1 == 'r') ?
+            pr1 * npcol1 + pc1 : pc1 * nprow1 + pr1;
+          int rd = (order2 == 'R' || order2 == 'r') ?
+            pr2 * npcol2 + pc2 : pc2 * nprow2 + pr2;
+          long nel = (long)(rhi[ri] - rlo[ri]) * (chi[cj] - clo[cj]);
+          if (rs == rank && rd != rank)
+            nsend[rd] += nel;
+          if (rd == rank && rs != rank)
+            nrecv[rs] += nel;
+        }
+    }
+
+  // Post receives, pack and send, copying local intersections
+  // directly:
+  char** sbuf = GPAW_MALLOC(char*, 2 * size);
+  char** rbuf = sbuf + size;
+  MPI_Request* requests = GPAW_MALLOC(MPI_Request, 2 * size);
+  int nrequests = 0;
+  for (int r = 0; r < size; r++)
+    {
+      sbuf[r] = NULL;
+      rbuf[r] = NULL;
+      if (nrecv[r] > 0)
+        {
+          rbuf[r] = GPAW_MALLOC(char, nrecv[r] * itemsize);
+          MPI_Irecv(rbuf[r], nrecv[r] * itemsize, MPI_BYTE, r, 201,
+                    comm, &requests[nrequests++]);
+        }
+      if (nsend[r] > 0)
+        sbuf[r] = GPAW_MALLOC(char, nsend[r] * itemsize);
+    }
+
+  long* offset = GPAW_MALLOC(long, size);
+  for (int r = 0; r < size; r++)
+    offset[r] = 0;
+  for (int cj = 0; cj < nci; cj++)
+    {
+      int pc1 = (clo[cj] / nb1 + csrc1) % npcol1;
+      int pc2 = (clo[cj] / nb2 + csrc2) % npcol2;
+      for (int ri = 0; ri < nri; ri++)
+        {
+          int pr1 = (rlo[ri] / mb1 + rsrc1) % nprow1;
+          int pr2 = (rlo[ri] / mb2 + rsrc2) % nprow2;
+          int rs = (order1 == 'R' || order1 == 'r') ?
+            pr1 * npcol1 + pc1 : pc1 * nprow1 + pr1;
+          int rd = (order2 == 'R' || order2 == 'r') ?
+            pr2 * npcol2 + pc2 : pc2 * nprow2 + pr2;
+          if (rs != rank && rd != rank)
+            continue;
+          long nrow = (rhi[ri] - rlo[ri]) * itemsize;
+          int li1 = redist_local(rlo[ri], mb1, nprow1, pr1, rsrc1);
+          int li2 = redist_local(rlo[ri], mb2, nprow2, pr2, rsrc2);
+          for (int J = clo[cj]; J < chi[cj]; J++)
+            {
+              long src = (redist_local(J, nb1, npcol1, pc1, csrc1) * lld1 +
+                          li1) * itemsize;
+              long dst = (redist_local(J, nb2, npcol2, pc2, csrc2) * lld2 +
+                          li2) * itemsize;
+              if (rs == rank && rd == rank)
+                memcpy(b->data + dst, a->data + src, nrow);
+              else if (rs == rank)
+                {
+                  memcpy(sbuf[rd] + offset[rd], a->data + src, nrow);
+                  offset[rd] += nrow;
+                }
+            }
+        }
+    }
+  for (int r = 0; r < size; r++)
+    if (nsend[r] > 0)
+      MPI_Isend(sbuf[r], nsend[r] * itemsize, MPI_BYTE, r, 201,
+                comm, &requests[nrequests++]);
+
+  MPI_Waitall(nrequests, requests, MPI_STATUSES_IGNORE);
+
+  // Unpack in the same deterministic cell order the senders used:
+  for (int r = 0; r < size; r++)
+    offset[r] = 0;
+  for (int cj = 0; cj < nci; cj++)
+    {
+      int pc1 = (clo[cj] / nb1 + csrc1) % npcol1;
+      int pc2 = (clo[cj] / nb2 + csrc2) % npcol2;
+      for (int ri = 0; ri < nri; ri++)
+        {
+          int pr1 = (rlo[ri] / mb1 + rsrc1) % nprow1;
+          int pr2 = (rlo[ri] / mb2 + rsrc2) % nprow2;
+          int rs = (order1 == 'R' || order1 == 'r') ?
+            pr1 * npcol1 + pc1 : pc1 * nprow1 + pr1;
+          int rd = (order2 == 'R' || order2 == 'r') ?
+            pr2 * npcol2 + pc2 : pc2 * nprow2 + pr2;
+          if (rd != rank || rs == rank)
+            continue;
+          long nrow = (rhi[ri] - rlo[ri]) * itemsize;
+          int li2 = redist_local(rlo[ri], mb2, nprow2, pr2, rsrc2);
+          for (int J = clo[cj]; J < chi[cj]; J++)
+            {
+              long dst = (redist_local(J, nb2, npcol2, pc2, csrc2) * lld2 +
+                          li2) * itemsize;
+              memcpy(b->data + dst, rbuf[rs] + offset[rs], nrow);
+              offset[rs] += nrow;
+            }
+        }
+    }
+
+  for (int r = 0; r < size; r++)
+    {
+      free(sbuf[r]);
+      free(rbuf[r]);
+    }
+  free(offset);
+  free(requests);
+  free(sbuf);
+  free(nsend);
+  free(clo);
+  free(rlo);
+
+  Py_RETURN_NONE;
+}
+
 PyObject* scalapack_redist(PyObject *self, PyObject *args)
 {
   PyArrayObject* a; // source matrix
@@ -8,6 +8,7 @@
 #define NO_IMPORT_ARRAY
 #include <numpy/arrayobject.h>
 #include "extensions.h"
+#include "threadpool.h"
 
 #ifdef GPAW_NO_UNDERSCORE_BLAS
 #  define dscal_  dscal
@@ -88,6 +89,39 @@ PyObject* scal(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
+#ifdef GPAW_OMP_MONLY
+struct gemm_slice_task
+{
+  char transa;
+  int m, n, k;
+  int lda, ldb, ldc;
+  int real;
+  Py_complex alpha;
+  Py_complex beta;
+  void* a;
+  void* b;
+  void* c;
+};
+
+static void* gemm_slice_worker(void* vtask)
+{
+  struct gemm_slice_task* task = vtask;
+  if (task->n == 0)
+    return NULL;
+  if (task->real)
+    dgemm_(&task->transa, "n", &task->m, &task->n, &task->k,
+	   &(task->alpha.real), task->a, &task->lda,
+	   task->b, &task->ldb,
+	   &(task->beta.real), task->c, &task->ldc);
+  else
+    zgemm_(&task->transa, "n", &task->m, &task->n, &task->k,
+	   &task->alpha, task->a, &task->lda,
+	   task->b, &task->ldb,
+	   &task->beta, task->c, &task->ldc);
+  return NULL;
+}
+#endif
+
 PyObject* gemm(PyObject *self, PyObject *args)
 {
   Py_complex alpha;
@@ -120,7 +154,37 @@ PyObject* gemm(PyObject *self, PyObject *args)
       ldc = c->strides[0] / c->strides[1];
     }
   int n = b->dimensions[0];
-  if (a->descr->type_num == PyArray_DOUBLE)
+  int real = (a->descr->type_num == PyArray_DOUBLE);
+#ifdef GPAW_OMP_MONLY
+  // The subspace rotations stream the whole wave-function array once
+  // per gemm; slicing the output bands (columns of the column-major
+  // product) over the pool lets each core stream its own slice.  Only
+  // worth it when the product is large enough to hide the task setup:
+  int nthds = gpaw_threadpool_size();
+  if (nthds > 1 && n >= 2 * nthds && (double)m * k * n > 1e6)
+    {
+      struct gemm_slice_task* tasks =
+	GPAW_MALLOC(struct gemm_slice_task, nthds);
+      int itemsize = real ? sizeof(double) : sizeof(double_complex);
+      int j0 = 0;
+      for (int i = 0; i < nthds; i++)
+	{
+	  int j1 = (int)(((long)(i + 1) * n) / nthds);
+	  struct gemm_slice_task task =
+	    {transa, m, j1 - j0, k, lda, ldb, ldc, real, alpha, beta,
+	     a->data,
+	     b->data + (size_t)j0 * ldb * itemsize,
+	     c->data + (size_t)j0 * ldc * itemsize};
+	  tasks[i] = task;
+	  j0 = j1;
+	}
+      gpaw_threadpool_run(gemm_slice_worker, tasks,
+			  sizeof(struct gemm_slice_task), nthds);
+      free(tasks);
+      Py_RETURN_NONE;
+    }
+#endif
+  if (real)
     dgemm_(&transa, "n", &m, &n, &k,
            &(alpha.real),
            DOUBLEP(a), &lda,
@@ -138,6 +202,113 @@ PyObject* gemm(PyObject *self, PyObject *args)
 }
 
 
+#ifdef GPAW_OMP_MONLY
+struct gemm_batched_task
+{
+  int m, n, k;
+  int real;
+  Py_complex alpha;
+  Py_complex beta;
+  void* a;
+  void* b;
+  void* c;
+};
+
+static void* gemm_batched_worker(void* vtask)
+{
+  struct gemm_batched_task* task = vtask;
+  // Row-major c = alpha * a.b + beta * c as the transposed
+  // column-major product:
+  if (task->real)
+    dgemm_("n", "n", &task->n, &task->m, &task->k,
+	   &(task->alpha.real), task->b, &task->n, task->a, &task->k,
+	   &(task->beta.real), task->c, &task->n);
+  else
+    zgemm_("n", "n", &task->n, &task->m, &task->k,
+	   &task->alpha, task->b, &task->n, task->a, &task->k,
+	   &task->beta, task->c, &task->n);
+  return NULL;
+}
+#endif
+
+PyObject* gemm_batched(PyObject *self, PyObject *args)
+{
+  // Many equally shaped matrix multiplications in one call: for tiny
+  // per-atom matrices the Python and BLAS call overhead dominates the
+  // flop time, so the loop lives here (threaded when the pool is
+  // enabled - plain BLAS has no batched gemm to dispatch to).
+  Py_complex alpha;
+  PyArrayObject* a;
+  PyArrayObject* b;
+  Py_complex beta;
+  PyArrayObject* c;
+  if (!PyArg_ParseTuple(args, "DOODO", &alpha, &a, &b, &beta, &c))
+    return NULL;
+  int p = a->dimensions[0];
+  int m = a->dimensions[1];
+  int k = a->dimensions[2];
+  int n = b->dimensions[2];
+  int real = (a->descr->type_num == PyArray_DOUBLE);
+#ifdef GPAW_OMP_MONLY
+  if (p > 1)
+    {
+      struct gemm_batched_task* tasks =
+	GPAW_MALLOC(struct gemm_batched_task, p);
+      char* ap = a->data;
+      char* bp = b->data;
+      char* cp = c->data;
+      int itemsize = real ? sizeof(double) : sizeof(double_complex);
+      for (int x = 0; x < p; x++)
+	{
+	  struct gemm_batched_task task = {m, n, k, real, alpha, beta,
+					   ap, bp, cp};
+	  tasks[x] = task;
+	  ap += m * k * itemsize;
+	  bp += k * n * itemsize;
+	  cp += m * n * itemsize;
+	}
+      gpaw_threadpool_run(gemm_batched_worker, tasks,
+			  sizeof(struct gemm_batched_task), p);
+      free(tasks);
+      Py_RETURN_NONE;
+    }
+#endif
+  if (real)
+    {
+      double* ap = DOUBLEP(a);
+      double* bp = DOUBLEP(b);
+      double* cp = DOUBLEP(c);
+      for (int x = 0; x < p; x++)
+	{
+	  // Row-major c = alpha * a.b + beta * c as the transposed
+	  // column-major product:
+	  dgemm_("n", "n", &n, &m, &k,
+		 &(alpha.real), bp, &n, ap, &k,
+		 &(beta.real), cp, &n);
+	  ap += m * k;
+	  bp += k * n;
+	  cp += m * n;
+	}
+    }
+  else
+    {
+      double_complex* ap = COMPLEXP(a);
+      double_complex* bp = COMPLEXP(b);
+      double_complex* cp = COMPLEXP(c);
+      for (int x = 0; x < p; x++)
+	{
+	  zgemm_("n", "n", &n, &m, &k,
+		 &alpha, (void*)bp, &n, (void*)ap, &k,
+		 &beta, (void*)cp, &n);
+	  ap += m * k;
+	  bp += k * n;
+	  cp += m * n;
+	}
+    }
+  Py_RETURN_NONE;
+}
+
+
 PyObject* gemv(PyObject *self, PyObject *args)
 {
   Py_complex alpha;
@@ -217,6 +388,57 @@ PyObject* axpy(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
+#ifdef GPAW_OMP_MONLY
+// Band-panel size for the blocked rank-k update below:
+#define GPAW_RK_BLOCK 64
+
+struct rk_panel_task
+{
+  int ni, nj, k;
+  int real;
+  double alpha, beta;
+  void* ai;
+  void* aj;  // equal to ai for a diagonal panel
+  void* c;
+  int ldc;
+};
+
+static void* rk_panel_worker(void* vtask)
+{
+  struct rk_panel_task* task = vtask;
+  if (task->ai == task->aj)
+    {
+      // Diagonal panel: an ordinary rank-k update.
+      if (task->real)
+	dsyrk_("u", "t", &task->ni, &task->k,
+	       &task->alpha, task->ai, &task->k, &task->beta,
+	       task->c, &task->ldc);
+      else
+	zherk_("u", "c", &task->ni, &task->k,
+	       &task->alpha, task->ai, &task->k, &task->beta,
+	       task->c, &task->ldc);
+    }
+  else
+    {
+      // Off-diagonal panel: row-major c_ij = alpha * a_i . a_j^dag
+      // + beta * c_ij as the transposed column-major product.
+      if (task->real)
+	dgemm_("t", "n", &task->nj, &task->ni, &task->k,
+	       &task->alpha, task->aj, &task->k, task->ai, &task->k,
+	       &task->beta, task->c, &task->ldc);
+      else
+	{
+	  double_complex alpha = task->alpha;
+	  double_complex beta = task->beta;
+	  zgemm_("c", "n", &task->nj, &task->ni, &task->k,
+		 &alpha, task->aj, &task->k, task->ai, &task->k,
+		 &beta, task->c, &task->ldc);
+	}
+    }
+  return NULL;
+}
+#endif
+
 PyObject* rk(PyObject *self, PyObject *args)
 {
   double alpha;
@@ -230,6 +452,42 @@ PyObject* rk(PyObject *self, PyObject *args)
   for (int d = 2; d < a->nd; d++)
     k *= a->dimensions[d];
   int ldc = c->strides[0] / c->strides[1];
+#ifdef GPAW_OMP_MONLY
+  if (n > GPAW_RK_BLOCK)
+    {
+      // Blocked update: split the bands into panels and update one
+      // triangular panel pair per task.  Only the panels of the
+      // result triangle are touched, and the panel products run
+      // concurrently on the pool.
+      int real = (a->descr->type_num == PyArray_DOUBLE);
+      int itemsize = real ? sizeof(double) : sizeof(double_complex);
+      int npanels = (n + GPAW_RK_BLOCK - 1) / GPAW_RK_BLOCK;
+      struct rk_panel_task* tasks =
+	GPAW_MALLOC(struct rk_panel_task, npanels * (npanels + 1) / 2);
+      int ntasks = 0;
+      for (int i = 0; i < npanels; i++)
+	{
+	  int ri = i * GPAW_RK_BLOCK;
+	  int ni = MIN(GPAW_RK_BLOCK, n - ri);
+	  for (int j = 0; j <= i; j++)
+	    {
+	      int rj = j * GPAW_RK_BLOCK;
+	      int nj = MIN(GPAW_RK_BLOCK, n - rj);
+	      struct rk_panel_task task =
+		{ni, nj, k, real, alpha, beta,
+		 a->data + (long)ri * k * itemsize,
+		 a->data + (long)rj * k * itemsize,
+		 c->data + ((long)ri * ldc + rj) * itemsize,
+		 ldc};
+	      tasks[ntasks++] = task;
+	    }
+	}
+      gpaw_threadpool_run(rk_panel_worker, tasks,
+			  sizeof(struct rk_panel_task), ntasks);
+      free(tasks);
+      Py_RETURN_NONE;
+    }
+#endif
   if (a->descr->type_num == PyArray_DOUBLE)
     dsyrk_("u", "t", &n, &k,
            &alpha, DOUBLEP(a), &k, &beta,
@@ -327,19 +585,74 @@ PyObject* dotu(PyObject *self, PyObject *args)
     }
 }
 
-PyObject* multi_dotu(PyObject *self, PyObject *args)
+#ifdef GPAW_OMP_MONLY
+struct multi_dot_task
+{
+  int n;
+  int real;
+  int conjugate;
+  void* a;
+  void* b;
+  void* c;
+};
+
+static void* multi_dot_worker(void* vtask)
+{
+  struct multi_dot_task* task = vtask;
+  int one = 1;
+  if (task->real)
+    *((double*)task->c) = ddot_(&task->n, task->a, &one, task->b, &one);
+  else
+    {
+      double_complex* ap = task->a;
+      double_complex* bp = task->b;
+      double_complex z = 0.0;
+      if (task->conjugate)
+	for (int j = 0; j < task->n; j++)
+	  z += conj(ap[j]) * bp[j];
+      else
+	for (int j = 0; j < task->n; j++)
+	  z += ap[j] * bp[j];
+      *((double_complex*)task->c) = z;
+    }
+  return NULL;
+}
+#endif
+
+static void multi_dot(PyArrayObject* a, PyArrayObject* b, PyArrayObject* c,
+		      int conjugate)
 {
-  PyArrayObject* a;
-  PyArrayObject* b;
-  PyArrayObject* c;
-  if (!PyArg_ParseTuple(args, "OOO", &a, &b, &c)) 
-    return NULL;
   int n0 = a->dimensions[0];
   int n = a->dimensions[1];
   for (int i = 2; i < a->nd; i++)
     n *= a->dimensions[i];
   int incx = 1;
   int incy = 1;
+#ifdef GPAW_OMP_MONLY
+  if (n0 > 1)
+    {
+      // One band per task: the vectors are independent memory
+      // streams, so a single core cannot saturate the bandwidth.
+      struct multi_dot_task* tasks = GPAW_MALLOC(struct multi_dot_task, n0);
+      int real = (a->descr->type_num == PyArray_DOUBLE);
+      int itemsize = real ? sizeof(double) : sizeof(double_complex);
+      char* ap = a->data;
+      char* bp = b->data;
+      char* cp = c->data;
+      for (int i = 0; i < n0; i++)
+	{
+	  struct multi_dot_task task = {n, real, conjugate, ap, bp, cp};
+	  tasks[i] = task;
+	  ap += (long)n * itemsize;
+	  bp += (long)n * itemsize;
+	  cp += itemsize;
+	}
+      gpaw_threadpool_run(multi_dot_worker, tasks,
+			  sizeof(struct multi_dot_task), n0);
+      free(tasks);
+      return;
+    }
+#endif
   if (a->descr->type_num == PyArray_DOUBLE)
     {
       double *ap = DOUBLEP(a);
@@ -348,7 +661,7 @@ PyObject* multi_dotu(PyObject *self, PyObject *args)
 
       for (int i = 0; i < n0; i++)
 	{
-	  cp[i] = ddot_(&n, (void*)ap, 
+	  cp[i] = ddot_(&n, (void*)ap,
 	     &incx, (void*)bp, &incy);
 	  ap += n;
 	  bp += n;
@@ -362,21 +675,68 @@ PyObject* multi_dotu(PyObject *self, PyObject *args)
       for (int i = 0; i < n0; i++)
 	{
 	  cp[i] = 0.0;
-	  for (int j = 0; j < n; j++)
+	  if (conjugate)
+	    for (int j = 0; j < n; j++)
+	      cp[i] += conj(ap[j]) * bp[j];
+	  else
+	    for (int j = 0; j < n; j++)
 	      cp[i] += ap[j] * bp[j];
 	  ap += n;
 	  bp += n;
 	}
     }
+}
+
+PyObject* multi_dotu(PyObject *self, PyObject *args)
+{
+  PyArrayObject* a;
+  PyArrayObject* b;
+  PyArrayObject* c;
+  if (!PyArg_ParseTuple(args, "OOO", &a, &b, &c))
+    return NULL;
+  multi_dot(a, b, c, 0);
+  Py_RETURN_NONE;
+}
+
+PyObject* multi_dotc(PyObject *self, PyObject *args)
+{
+  PyArrayObject* a;
+  PyArrayObject* b;
+  PyArrayObject* c;
+  if (!PyArg_ParseTuple(args, "OOO", &a, &b, &c))
+    return NULL;
+  multi_dot(a, b, c, 1);
   Py_RETURN_NONE;
 }
 
+#ifdef GPAW_OMP_MONLY
+struct multi_axpy_task
+{
+  int n;
+  int real;
+  void* alpha;
+  void* x;
+  void* y;
+};
+
+static void* multi_axpy_worker(void* vtask)
+{
+  struct multi_axpy_task* task = vtask;
+  int one = 1;
+  if (task->real)
+    daxpy_(&task->n, task->alpha, task->x, &one, task->y, &one);
+  else
+    zaxpy_(&task->n, task->alpha, task->x, &one, task->y, &one);
+  return NULL;
+}
+#endif
+
 PyObject* multi_axpy(PyObject *self, PyObject *args)
 {
   PyArrayObject* alpha;
   PyArrayObject* x;
   PyArrayObject* y;
-  if (!PyArg_ParseTuple(args, "OOO", &alpha, &x, &y)) 
+  if (!PyArg_ParseTuple(args, "OOO", &alpha, &x, &y))
     return NULL;
   int n0 = x->dimensions[0];
   int n = x->dimensions[1];
@@ -385,6 +745,35 @@ PyObject* multi_axpy(PyObject *self, PyObject *args)
   int incx = 1;
   int incy = 1;
 
+#ifdef GPAW_OMP_MONLY
+  if (n0 > 1)
+    {
+      // One band per task, as in multi_dot above.
+      int real = (alpha->descr->type_num == PyArray_DOUBLE);
+      int nd = n;
+      if (real && x->descr->type_num == PyArray_CDOUBLE)
+	nd *= 2;
+      struct multi_axpy_task* tasks = GPAW_MALLOC(struct multi_axpy_task, n0);
+      int itemsize = (x->descr->type_num == PyArray_DOUBLE ?
+		      sizeof(double) : sizeof(double_complex));
+      int alphasize = real ? sizeof(double) : sizeof(double_complex);
+      char* ap = alpha->data;
+      char* xp = x->data;
+      char* yp = y->data;
+      for (int i = 0; i < n0; i++)
+	{
+	  struct multi_axpy_task task = {nd, real, ap, xp, yp};
+	  tasks[i] = task;
+	  ap += alphasize;
+	  xp += (long)n * itemsize;
+	  yp += (long)n * itemsize;
+	}
+      gpaw_threadpool_run(multi_axpy_worker, tasks,
+			  sizeof(struct multi_axpy_task), n0);
+      free(tasks);
+      Py_RETURN_NONE;
+    }
+#endif
    if (alpha->descr->type_num == PyArray_DOUBLE)
     {
       if (x->descr->type_num == PyArray_CDOUBLE)
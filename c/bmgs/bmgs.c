@@ -20,3 +20,15 @@
 #include "paste.c"
 #include "restrict.c"
 #include "interpolate.c"
+
+// Single-precision variants (bmgs_fdf, bmgs_interpolatef, ...) for the
+// preconditioner, which only needs a few digits and is bandwidth bound:
+#undef BMGSCOMPLEX
+#define BMGSFLOAT
+#include "fd.c"
+#include "cut.c"
+#include "zero.c"
+#include "paste.c"
+#include "restrict.c"
+#include "interpolate.c"
+#undef BMGSFLOAT
@@ -11,12 +11,15 @@
 
 #undef T
 #undef Z
-#ifndef BMGSCOMPLEX
-#  define T double
-#  define Z(f) f
-#else
+#if defined(BMGSCOMPLEX)
 #  define T double_complex
 #  define Z(f) f ## z
+#elif defined(BMGSFLOAT)
+#  define T float
+#  define Z(fn) fn ## f
+#else
+#  define T double
+#  define Z(f) f
 #endif
 
 #ifndef BMGS_H
@@ -37,6 +40,20 @@ typedef struct
   long* offsets;
   long n[3];
   long j[3];
+  /* range > 0 marks an axis-separable stencil (as built by bmgs_laplace):
+     every offset lies on one of the three grid axes.  lcoefs holds the
+     central coefficient, then the +axis coefficient vectors for
+     j = 1, ..., range (slots 1..3*range), then the -axis vectors
+     (slots 3*range+1..6*range), allowing bmgs_fd to use an unrolled,
+     vectorizable code path without the per-coefficient offset gather.
+     Stencils touching off-axis points (bmgs_mslaplaceA/B) keep the
+     generic representation. */
+  int range;
+  double lcoefs[25];
+  /* i1/i2 tile sizes for cache-blocked traversal of large grids,
+     chosen from the grid dimensions at stencil-creation time
+     (0 means untiled). */
+  long tile[2];
 } bmgsstencil;
 
 typedef struct
@@ -45,6 +62,12 @@ typedef struct
   double dr;
   int nbins;
   double* data;
+  /* Optional dense table of function values for fast evaluation by
+     linear interpolation, built once at creation (NULL if the spline
+     is too curved for a compact table to be accurate enough). */
+  int ntable;
+  double idt;  // one over table spacing
+  double* table;
 } bmgsspline;
 
 bmgsstencil bmgs_stencil(int ncoefs, const double* coefs, const long* offsets,
@@ -80,7 +103,11 @@ void bmgs_radiald3(const bmgsspline* spline, int m, int c,
       const double h[3],
       const double* f, const double* g, double* a);
 void bmgs_fd(const bmgsstencil* s, const double* a, double* b);
-void bmgs_relax(const int relax_method, const bmgsstencil* s, double* a, double* b,
+void bmgs_fd_sub(const bmgsstencil* s, const double* a, const double* src,
+		 double* b);
+void bmgs_fdm(const bmgsstencil* s, int nb, long astride, long bstride,
+	      const double* a, double* b);
+double bmgs_relax(const int relax_method, const bmgsstencil* s, double* a, double* b,
     const double* src, const double w);
 void bmgs_cut(const double* a, const int n[3], const int c[3],
         double* b, const int m[3]);
@@ -94,7 +121,8 @@ void bmgs_rotate(const double* a, const int size[3], double* b, double angle,
      int d, long c, double*, long*, long*, double*, long*, long*,
      int exact);
 void bmgs_translate(double* a, const int sizea[3], const int size[3],
-        const int start1[3], const int start2[3]);
+        const int start1[3], const int start2[3],
+        int nb, long stride);
 void bmgs_restrict(int k, double* a, const int n[3], double* b, double* w);
 void bmgs_interpolate(int k, int skip[3][2],
           const double* a, const int n[3],
@@ -102,6 +130,8 @@ void bmgs_interpolate(int k, int skip[3][2],
 // complex routines:
 void bmgs_fdz(const bmgsstencil* s, const double_complex* a,
         double_complex* b);
+void bmgs_fdmz(const bmgsstencil* s, int nb, long astride, long bstride,
+	       const double_complex* a, double_complex* b);
 void bmgs_cutz(const double_complex* a, const int n[3],
          const int c[3],
          double_complex* b, const int m[3]);
@@ -123,11 +153,27 @@ void bmgs_rotatez(const double_complex* a, const int size[3],
       int exact);
 void bmgs_translatemz(double_complex* a, const int sizea[3], const int size[3],
           const int start1[3], const int start2[3],
-          double_complex phase);
+          double_complex phase, int nb, long stride);
 void bmgs_restrictz(int k, double_complex* a,
         const int n[3], double_complex* b, double_complex* w);
 void bmgs_interpolatez(int k, int skip[3][2],
            const double_complex* a, const int n[3],
            double_complex* b, double_complex* w);
+// single-precision routines (for the preconditioner):
+void bmgs_fdf(const bmgsstencil* s, const float* a, float* b);
+void bmgs_fdmf(const bmgsstencil* s, int nb, long astride, long bstride,
+	       const float* a, float* b);
+void bmgs_cutf(const float* a, const int n[3], const int c[3],
+        float* b, const int m[3]);
+void bmgs_zerof(float* a, const int n[3], const int c[3],
+         const int s[3]);
+void bmgs_pastef(const float* a, const int n[3],
+    float* b, const int m[3], const int c[3]);
+void bmgs_pastepf(const float* a, const int n[3],
+    float* b, const int m[3], const int c[3]);
+void bmgs_restrictf(int k, float* a, const int n[3], float* b, float* w);
+void bmgs_interpolatef(int k, int skip[3][2],
+           const float* a, const int n[3],
+           float* b, float* w);
 
 #endif
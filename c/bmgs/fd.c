@@ -4,19 +4,84 @@
 #include "bmgs.h"
 #include <pthread.h>
 #include "../extensions.h"
+#include "../threadpool.h"
 
 struct Z(fds){
   int thread_id;
   int nthds;
   const bmgsstencil* s;
   const T* a;
+  const T* src;  // when non-NULL: b = stencil(a) - src in one pass
   T* b;
 };
 
+/* Unrolled code path for axis-separable Laplacian-type stencils (detected
+   in bmgs_classify).  The coefficient loop is replaced by compile-time
+   unrolled axis-wise accumulation so that the inner i2 loop vectorizes. */
+static void Z(bmgs_fd_laplace)(const bmgsstencil* s, const T* a,
+			       const T* src, T* b,
+			       int nstart, int nend)
+{
+  const int r = s->range;
+  const double* c = s->lcoefs;
+  const long stride1 = s->n[2] + 2 * r;
+  const long stride0 = stride1 * (s->n[1] + 2 * r);
+
+#define FD_LAPLACE_LOOP(R, SUB)                                         \
+  for (int i2 = 0; i2 < s->n[2]; i2++)                                  \
+    {                                                                   \
+      T x = c[0] * aa[i2];                                              \
+      for (int j = 1; j <= R; j++)                                      \
+	x += c[j] * aa[i2 + j * stride0]                                \
+	   + c[3 * R + j] * aa[i2 - j * stride0]                        \
+	   + c[R + j] * aa[i2 + j * stride1]                            \
+	   + c[4 * R + j] * aa[i2 - j * stride1]                        \
+	   + c[2 * R + j] * aa[i2 + j]                                  \
+	   + c[5 * R + j] * aa[i2 - j];                                 \
+      bb[i2] = x SUB;                                                   \
+    }
+
+  const long b1 = (s->tile[0] > 0) ? s->tile[0] : s->n[1];
+  // Tile i1 and stream i0 through each tile, so that the slab of input
+  // planes needed for a tile stays cache-resident from one i0 to the next.
+  for (long t1 = 0; t1 < s->n[1]; t1 += b1)
+    {
+      long e1 = (t1 + b1 < s->n[1]) ? t1 + b1 : s->n[1];
+      for (int i0 = nstart; i0 < nend; i0++)
+	for (long i1 = t1; i1 < e1; i1++)
+	  {
+	    const T* aa = a + i0 * (s->j[1] + s->n[1] * (s->j[2] + s->n[2]))
+			    + i1 * (s->j[2] + s->n[2]);
+	    T* bb = b + (i0 * s->n[1] + i1) * s->n[2];
+	    if (src == NULL)
+	      switch (r)
+		{
+		case 1: FD_LAPLACE_LOOP(1,); break;
+		case 2: FD_LAPLACE_LOOP(2,); break;
+		case 3: FD_LAPLACE_LOOP(3,); break;
+		default: FD_LAPLACE_LOOP(4,); break;
+		}
+	    else
+	      {
+		const T* ss = src + (i0 * s->n[1] + i1) * s->n[2];
+		switch (r)
+		  {
+		  case 1: FD_LAPLACE_LOOP(1, - ss[i2]); break;
+		  case 2: FD_LAPLACE_LOOP(2, - ss[i2]); break;
+		  case 3: FD_LAPLACE_LOOP(3, - ss[i2]); break;
+		  default: FD_LAPLACE_LOOP(4, - ss[i2]); break;
+		  }
+	      }
+	  }
+    }
+#undef FD_LAPLACE_LOOP
+}
+
 void *Z(bmgs_fd_worker)(void *threadarg)
 {
   struct Z(fds) *args = (struct Z(fds) *) threadarg;
   const T* a = args->a;
+  const T* src = args->src;
   T* b = args->b;
   const bmgsstencil* s = args->s;
 
@@ -28,41 +93,142 @@ void *Z(bmgs_fd_worker)(void *threadarg)
   if (nend > s->n[0])
     nend = s->n[0];
 
+  if (s->range > 0)
+    {
+      Z(bmgs_fd_laplace)(s, a, src, b, nstart, nend);
+      return NULL;
+    }
+
+  const long b1 = (s->tile[0] > 0) ? s->tile[0] : s->n[1];
+  for (long t1 = 0; t1 < s->n[1]; t1 += b1)
+    {
+      long e1 = (t1 + b1 < s->n[1]) ? t1 + b1 : s->n[1];
+      for (int i0 = nstart; i0 < nend; i0++)
+	for (long i1 = t1; i1 < e1; i1++)
+	  {
+	    const T* aa = a + i0 * (s->j[1] + s->n[1] * (s->j[2] + s->n[2]))
+			    + i1 * (s->j[2] + s->n[2]);
+	    T* bb = b + (i0 * s->n[1] + i1) * s->n[2];
+	    if (src == NULL)
+	      for (int i2 = 0; i2 < s->n[2]; i2++)
+		{
+		  T x = 0.0;
+		  for (int c = 0; c < s->ncoefs; c++)
+		    x += aa[i2 + s->offsets[c]] * s->coefs[c];
+		  bb[i2] = x;
+		}
+	    else
+	      {
+		const T* ss = src + (i0 * s->n[1] + i1) * s->n[2];
+		for (int i2 = 0; i2 < s->n[2]; i2++)
+		  {
+		    T x = 0.0;
+		    for (int c = 0; c < s->ncoefs; c++)
+		      x += aa[i2 + s->offsets[c]] * s->coefs[c];
+		    bb[i2] = x - ss[i2];
+		  }
+	      }
+	  }
+    }
+  return NULL;
+}
 
-  for (int i0 = nstart; i0 < nend; i0++)
-  {
-    const T* aa = a + i0 * (s->j[1] + s->n[1] * (s->j[2] + s->n[2]));
-    T* bb = b + i0 * s->n[1] * s->n[2];
 
-    for (int i1 = 0; i1 < s->n[1]; i1++)
+
+/* Multi-band stencil application.  Bands are processed in groups of
+   four with the coefficient/offset loop shared between them, so one
+   pass over the stencil metadata updates four bands held in registers
+   and the index arithmetic is amortized.  a and b hold nb consecutive
+   extended/regular grids, astride and bstride elements apart.  Intended
+   to be called from an already-threaded worker; does no threading of
+   its own.  Separable Laplacians go through the unrolled per-band path,
+   which is already vectorized. */
+void Z(bmgs_fdm)(const bmgsstencil* s, int nb, long astride, long bstride,
+                 const T* a, T* b)
+{
+  a += (s->j[0] + s->j[1] + s->j[2]) / 2;
+
+  const long b1 = (s->tile[0] > 0) ? s->tile[0] : s->n[1];
+  int n = 0;
+  if (s->range == 0)
+    for (; n + 4 <= nb; n += 4)
       {
-        for (int i2 = 0; i2 < s->n[2]; i2++)
-          {
-            T x = 0.0;
-            for (int c = 0; c < s->ncoefs; c++)
-              x += aa[s->offsets[c]] * s->coefs[c];
-            *bb++ = x;
-            aa++;
-          }
-        aa += s->j[2];
+	const T* a0 = a + n * astride;
+	const T* a1 = a0 + astride;
+	const T* a2 = a1 + astride;
+	const T* a3 = a2 + astride;
+	T* b0 = b + n * bstride;
+	T* b1_ = b0 + bstride;
+	T* b2 = b1_ + bstride;
+	T* b3 = b2 + bstride;
+	for (long t1 = 0; t1 < s->n[1]; t1 += b1)
+	  {
+	    long e1 = (t1 + b1 < s->n[1]) ? t1 + b1 : s->n[1];
+	    for (int i0 = 0; i0 < s->n[0]; i0++)
+	      for (long i1 = t1; i1 < e1; i1++)
+		{
+		  long ra = i0 * (s->j[1] + s->n[1] * (s->j[2] + s->n[2]))
+			  + i1 * (s->j[2] + s->n[2]);
+		  long rb = (i0 * s->n[1] + i1) * s->n[2];
+		  for (int i2 = 0; i2 < s->n[2]; i2++)
+		    {
+		      T x0 = 0.0;
+		      T x1 = 0.0;
+		      T x2 = 0.0;
+		      T x3 = 0.0;
+		      for (int c = 0; c < s->ncoefs; c++)
+			{
+			  long o = ra + i2 + s->offsets[c];
+			  double cc = s->coefs[c];
+			  x0 += a0[o] * cc;
+			  x1 += a1[o] * cc;
+			  x2 += a2[o] * cc;
+			  x3 += a3[o] * cc;
+			}
+		      b0[rb + i2] = x0;
+		      b1_[rb + i2] = x1;
+		      b2[rb + i2] = x2;
+		      b3[rb + i2] = x3;
+		    }
+		}
+	  }
       }
-  }
-  return NULL;
+  for (; n < nb; n++)
+    if (s->range > 0)
+      Z(bmgs_fd_laplace)(s, a + n * astride, NULL, b + n * bstride,
+			 0, s->n[0]);
+    else
+      for (long t1 = 0; t1 < s->n[1]; t1 += b1)
+	{
+	  long e1 = (t1 + b1 < s->n[1]) ? t1 + b1 : s->n[1];
+	  for (int i0 = 0; i0 < s->n[0]; i0++)
+	    for (long i1 = t1; i1 < e1; i1++)
+	      {
+		const T* aa = a + n * astride
+			    + i0 * (s->j[1] + s->n[1] * (s->j[2] + s->n[2]))
+			    + i1 * (s->j[2] + s->n[2]);
+		T* bb = b + n * bstride + (i0 * s->n[1] + i1) * s->n[2];
+		for (int i2 = 0; i2 < s->n[2]; i2++)
+		  {
+		    T x = 0.0;
+		    for (int c = 0; c < s->ncoefs; c++)
+		      x += aa[i2 + s->offsets[c]] * s->coefs[c];
+		    bb[i2] = x;
+		  }
+	      }
+	}
 }
 
 
-
 void Z(bmgs_fd)(const bmgsstencil* s, const T* a, T* b)
 {
   a += (s->j[0] + s->j[1] + s->j[2]) / 2;
 
   int nthds = 1;
 #ifdef GPAW_OMP_MONLY
-  if (getenv("OMP_NUM_THREADS") != NULL)
-    nthds = atoi(getenv("OMP_NUM_THREADS"));
+  nthds = gpaw_threadpool_size();
 #endif
   struct Z(fds) *wargs = GPAW_MALLOC(struct Z(fds), nthds);
-  pthread_t *thds = GPAW_MALLOC(pthread_t, nthds);
 
   for(int i=0; i < nthds; i++)
     {
@@ -70,18 +236,43 @@ void Z(bmgs_fd)(const bmgsstencil* s, const T* a, T* b)
       (wargs+i)->nthds = nthds;
       (wargs+i)->s = s;
       (wargs+i)->a = a;
+      (wargs+i)->src = NULL;
       (wargs+i)->b = b;
     }
 #ifdef GPAW_OMP_MONLY
-  for(int i=1; i < nthds; i++)
-    pthread_create(thds + i, NULL, Z(bmgs_fd_worker), (void*) (wargs+i));
-#endif
+  gpaw_threadpool_run(Z(bmgs_fd_worker), wargs, sizeof(struct Z(fds)), nthds);
+#else
   Z(bmgs_fd_worker)(wargs);
-#ifdef GPAW_OMP_MONLY
-  for(int i=1; i < nthds; i++)
-    pthread_join(*(thds+i), NULL);
 #endif
   free(wargs);
-  free(thds);
 
 }
+
+/* b = stencil(a) - src in a single pass (the multigrid residual);
+   src and b are regular (unextended) grids. */
+void Z(bmgs_fd_sub)(const bmgsstencil* s, const T* a, const T* src, T* b)
+{
+  a += (s->j[0] + s->j[1] + s->j[2]) / 2;
+
+  int nthds = 1;
+#ifdef GPAW_OMP_MONLY
+  nthds = gpaw_threadpool_size();
+#endif
+  struct Z(fds) *wargs = GPAW_MALLOC(struct Z(fds), nthds);
+
+  for(int i=0; i < nthds; i++)
+    {
+      (wargs+i)->thread_id = i;
+      (wargs+i)->nthds = nthds;
+      (wargs+i)->s = s;
+      (wargs+i)->a = a;
+      (wargs+i)->src = src;
+      (wargs+i)->b = b;
+    }
+#ifdef GPAW_OMP_MONLY
+  gpaw_threadpool_run(Z(bmgs_fd_worker), wargs, sizeof(struct Z(fds)), nthds);
+#else
+  Z(bmgs_fd_worker)(wargs);
+#endif
+  free(wargs);
+}
@@ -4,6 +4,7 @@
 #include "bmgs.h"
 #include <pthread.h>
 #include "../extensions.h"
+#include "../threadpool.h"
 
 #ifdef K
 struct IP1DA{
@@ -28,39 +29,45 @@ void *IP1DW(void *threadarg)
   if (nend > m)
     nend = m;
 
-  for (int j = nstart; j < nend; j++)
+  // The j loop is innermost: output accesses are then unit stride and
+  // the fixed-weight updates vectorize.  The write-offset bookkeeping
+  // for skipped first/last lines is independent of j.
+  const int n = args->n;
+  const T* a = args->a;
+  T* b = args->b;
+  const long arow = K - 1 - args->skip[1] + n;
+  long off = 0;
+  for (int i = 0; i < n; i++)
     {
-      const T* aa = args->a + j * (K - 1 - args->skip[1] + args->n);
-      T* bb = args->b + j;
-      for (int i = 0; i < args->n; i++)
-        {
-          if (i == 0 && args->skip[0])
-            bb -= m;
-          else
-            bb[0] = aa[0];
+      const T* aa = a + i;
+      if (i == 0 && args->skip[0])
+        off -= m;
+      else
+        for (int j = nstart; j < nend; j++)
+          b[off + j] = aa[j * arow];
 
-          if (i == args->n - 1 && args->skip[1])
-            bb -= m;
-          else
-            {
-              if (K == 2)
-                bb[m] = 0.5 * (aa[0] + aa[1]);
-              else if (K == 4)
-                bb[m] = ( 0.5625 * (aa[ 0] + aa[1]) +
-                         -0.0625 * (aa[-1] + aa[2]));
-              else if (K == 6)
-                bb[m] = ( 0.58593750 * (aa[ 0] + aa[1]) +
-                         -0.09765625 * (aa[-1] + aa[2]) +
-                          0.01171875 * (aa[-2] + aa[3]));
-              else
-                bb[m] = ( 0.59814453125 * (aa[ 0] + aa[1]) +
-                         -0.11962890625 * (aa[-1] + aa[2]) +
-                          0.02392578125 * (aa[-2] + aa[3]) +
-                         -0.00244140625 * (aa[-3] + aa[4]));
-            }
-          aa++;
-          bb += 2 * m;
-        }
+      if (i == n - 1 && args->skip[1])
+        off -= m;
+      else
+        for (int j = nstart; j < nend; j++)
+          {
+            const T* ap = aa + j * arow;
+            if (K == 2)
+              b[off + m + j] = 0.5 * (ap[0] + ap[1]);
+            else if (K == 4)
+              b[off + m + j] = ( 0.5625 * (ap[ 0] + ap[1]) +
+                                -0.0625 * (ap[-1] + ap[2]));
+            else if (K == 6)
+              b[off + m + j] = ( 0.58593750 * (ap[ 0] + ap[1]) +
+                                -0.09765625 * (ap[-1] + ap[2]) +
+                                 0.01171875 * (ap[-2] + ap[3]));
+            else
+              b[off + m + j] = ( 0.59814453125 * (ap[ 0] + ap[1]) +
+                                -0.11962890625 * (ap[-1] + ap[2]) +
+                                 0.02392578125 * (ap[-2] + ap[3]) +
+                                -0.00244140625 * (ap[-3] + ap[4]));
+          }
+      off += 2 * m;
     }
   return NULL;
 }
@@ -71,11 +78,9 @@ void IP1D(const T* a, int n, int m, T* b, int skip[2])
 
   int nthds = 1;
 #ifdef GPAW_OMP_MONLY
-  if (getenv("OMP_NUM_THREADS") != NULL)
-    nthds = atoi(getenv("OMP_NUM_THREADS"));
+  nthds = gpaw_threadpool_size();
 #endif
   struct IP1DA *wargs = GPAW_MALLOC(struct IP1DA, nthds);
-  pthread_t *thds = GPAW_MALLOC(pthread_t, nthds);
 
   for(int i=0; i < nthds; i++)
     {
@@ -88,16 +93,11 @@ void IP1D(const T* a, int n, int m, T* b, int skip[2])
       (wargs+i)->skip = skip;
     }
 #ifdef GPAW_OMP_MONLY
-  for(int i=1; i < nthds; i++)
-    pthread_create(thds + i, NULL, IP1DW, (void*) (wargs+i));
-#endif
+  gpaw_threadpool_run(IP1DW, wargs, sizeof(struct IP1DA), nthds);
+#else
   IP1DW(wargs);
-#ifdef GPAW_OMP_MONLY
-  for(int i=1; i < nthds; i++)
-    pthread_join(*(thds+i), NULL);
 #endif
   free(wargs);
-  free(thds);
 }
 
 #else
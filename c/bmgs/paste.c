@@ -7,6 +7,17 @@ void Z(bmgs_paste)(const T* a, const int sizea[3],
 		   T* b, const int sizeb[3], const int startb[3])
 {
   b += startb[2] + (startb[1] + startb[0] * sizeb[1]) * sizeb[2];
+  if (sizea[2] == sizeb[2])
+    {
+      // Full rows: merge the middle loop into one copy per plane.
+      for (int i0 = 0; i0 < sizea[0]; i0++)
+	{
+	  memcpy(b, a, sizea[1] * sizea[2] * sizeof(T));
+	  a += sizea[1] * sizea[2];
+	  b += sizeb[1] * sizeb[2];
+	}
+      return;
+    }
   for (int i0 = 0; i0 < sizea[0]; i0++)
     {
       for (int i1 = 0; i1 < sizea[1]; i1++)
@@ -4,6 +4,7 @@
 #include "bmgs.h"
 #include <pthread.h>
 #include "../extensions.h"
+#include "../threadpool.h"
 
 #ifdef K
 struct RST1DA{
@@ -27,38 +28,39 @@ void *RST1DW(void *threadarg)
   if (nend > m)
     nend = m;
 
-  for (int j = 0; j < m; j++)
-    {
-      const T* aa = args->a + j * (args->n * 2 + K * 2 - 3);
-      T* bb = args->b + j;
-
-      for (int i = 0; i < args->n; i++)
-        {
-          if      (K == 2)
-            bb[0] = 0.5 * (aa[0] +
-              0.5 * (aa[1] + aa[-1]));
-
-          else if (K == 4)
-            bb[0] = 0.5 * (aa[0] +
-               0.5625 * (aa[1] + aa[-1]) +
-              -0.0625 * (aa[3] + aa[-3]));
-
-          else if (K == 6)
-            bb[0] = 0.5 * (aa[0] +
-               0.58593750 * (aa[1] + aa[-1]) +
-              -0.09765625 * (aa[3] + aa[-3]) +
-               0.01171875 * (aa[5] + aa[-5]));
-
-          else
-            bb[0] = 0.5 * (aa[0] +
-               0.59814453125 * (aa[1] + aa[-1]) +
-              -0.11962890625 * (aa[3] + aa[-3]) +
-               0.02392578125 * (aa[5] + aa[-5]) +
-              -0.00244140625 * (aa[7] + aa[-7]));
-          aa += 2;
-          bb += m;
-        }
-    }
+  // Each thread handles its own [nstart, nend) slice of the j (fast)
+  // axis; with j innermost the writes are unit stride and the
+  // fixed-weight updates vectorize.
+  const int n = args->n;
+  const T* a = args->a;
+  T* b = args->b;
+  const long arow = n * 2 + K * 2 - 3;
+  for (int i = 0; i < n; i++)
+    for (int j = nstart; j < nend; j++)
+      {
+        const T* ap = a + j * arow + 2 * i;
+        if      (K == 2)
+          b[i * m + j] = 0.5 * (ap[0] +
+            0.5 * (ap[1] + ap[-1]));
+
+        else if (K == 4)
+          b[i * m + j] = 0.5 * (ap[0] +
+             0.5625 * (ap[1] + ap[-1]) +
+            -0.0625 * (ap[3] + ap[-3]));
+
+        else if (K == 6)
+          b[i * m + j] = 0.5 * (ap[0] +
+             0.58593750 * (ap[1] + ap[-1]) +
+            -0.09765625 * (ap[3] + ap[-3]) +
+             0.01171875 * (ap[5] + ap[-5]));
+
+        else
+          b[i * m + j] = 0.5 * (ap[0] +
+             0.59814453125 * (ap[1] + ap[-1]) +
+            -0.11962890625 * (ap[3] + ap[-3]) +
+             0.02392578125 * (ap[5] + ap[-5]) +
+            -0.00244140625 * (ap[7] + ap[-7]));
+      }
   return NULL;
 }
 
@@ -68,11 +70,9 @@ void RST1D(const T* a, int n, int m, T* b)
 
   int nthds = 1;
 #ifdef GPAW_OMP_MONLY
-  if (getenv("OMP_NUM_THREADS") != NULL)
-    nthds = atoi(getenv("OMP_NUM_THREADS"));
+  nthds = gpaw_threadpool_size();
 #endif
   struct RST1DA *wargs = GPAW_MALLOC(struct RST1DA, nthds);
-  pthread_t *thds = GPAW_MALLOC(pthread_t, nthds);
 
   for(int i=0; i < nthds; i++)
     {
@@ -84,16 +84,11 @@ void RST1D(const T* a, int n, int m, T* b)
       (wargs+i)->b = b;
     }
 #ifdef GPAW_OMP_MONLY
-  for(int i=1; i < nthds; i++)
-    pthread_create(thds + i, NULL, RST1DW, (void*) (wargs+i));
-#endif
+  gpaw_threadpool_run(RST1DW, wargs, sizeof(struct RST1DA), nthds);
+#else
   RST1DW(wargs);
-#ifdef GPAW_OMP_MONLY
-  for(int i=1; i < nthds; i++)
-    pthread_join(*(thds+i), NULL);
 #endif
   free(wargs);
-  free(thds);
 }
 
 #else
@@ -33,7 +33,7 @@ bmgsspline bmgs_spline(int l, double dr, int nbins, double* f)
     f2[b] = f2[b] * f2[b + 1] + u[b];
   double* data = (double*)malloc(4 * (nbins + 1) * sizeof(double));
   assert(data != NULL);
-  bmgsspline spline = {l, dr, nbins, data};
+  bmgsspline spline = {l, dr, nbins, data, 0, 0.0, NULL};
   for (int b = 0; b < nbins; b++)
     {
       *data++ = f[b];
@@ -45,6 +45,39 @@ bmgsspline bmgs_spline(int l, double dr, int nbins, double* f)
   data[1] = 0.0;
   data[2] = 0.0;
   data[3] = 0.0;
+  // Tabulate the spline densely for evaluation by linear interpolation.
+  // The interpolation error is bounded by dt^2 / 8 * max|f''|, and f2
+  // holds the second derivative at the knots (it is linear in between),
+  // so we can pick a spacing dt that keeps the error far below the
+  // accuracy of the radial data itself:
+  double fmax = 0.0;
+  double d2max = 0.0;
+  for (int b = 0; b <= nbins; b++)
+    {
+      if (fabs(f[b]) > fmax)
+        fmax = fabs(f[b]);
+      if (fabs(f2[b]) > d2max)
+        d2max = fabs(f2[b]);
+    }
+  if (fmax > 0.0)
+    {
+      double dt = dr;
+      if (d2max > 0.0)
+        dt = sqrt(8.0e-7 * fmax / d2max);
+      int ntable = (int)(nbins * dr / dt) + 1;
+      if (ntable < 4 * nbins)
+        ntable = 4 * nbins;
+      if (ntable > 65536)
+        ntable = 65536;  // ~0.5 MB - still accurate enough (see above)
+      double* table = (double*)malloc((ntable + 1) * sizeof(double));
+      assert(table != NULL);
+      spline.ntable = ntable;
+      spline.idt = ntable / (nbins * dr);
+      for (int t = 0; t < ntable; t++)
+        table[t] = bmgs_splinevalue(&spline, t / spline.idt);
+      table[ntable] = 0.0;
+      spline.table = table;
+    }
   free(u);
   free(f2);
   return spline;
@@ -53,6 +86,15 @@ bmgsspline bmgs_spline(int l, double dr, int nbins, double* f)
 
 double bmgs_splinevalue(const bmgsspline* spline, double r)
 {
+  if (spline->table != NULL)
+    {
+      double s = r * spline->idt;
+      int t = s;
+      if (t >= spline->ntable)
+        return 0.0;
+      double w = s - t;
+      return (1.0 - w) * spline->table[t] + w * spline->table[t + 1];
+    }
   int b = r / spline->dr;
   if (b >= spline->nbins)
     return 0.0;
@@ -82,6 +124,7 @@ void bmgs_get_value_and_derivative(const bmgsspline* spline, double r,
 void bmgs_deletespline(bmgsspline* spline)
 {
   free(spline->data);
+  free(spline->table);
 }
 
 
@@ -129,6 +172,24 @@ void bmgs_radial2(const bmgsspline* spline, const int n[3],
 		  double* f, double* g)
 {
   double dr = spline->dr;
+  if (g == 0 && spline->table != NULL)
+    {
+      // Values only - use the dense lookup table:
+      const double* table = spline->table;
+      for (int q = 0; q < n[0] * n[1] * n[2]; q++)
+	{
+	  double s = (b[q] * dr + d[q]) * spline->idt;
+	  int t = s;
+	  if (t >= spline->ntable)
+	    f[q] = 0.0;
+	  else
+	    {
+	      double w = s - t;
+	      f[q] = (1.0 - w) * table[t] + w * table[t + 1];
+	    }
+	}
+      return;
+    }
   for (int q = 0; q < n[0] * n[1] * n[2]; q++)
     {
       int j = b[q];
@@ -13,10 +13,101 @@
 // Expansion coefficients for finite difference Laplacian.  The numbers are
 // from J. R. Chelikowsky et al., Phys. Rev. B 50, 11355 (1994):
 
+/* Choose i1/i2 tile sizes so that the slab of input planes touched while
+   streaming through i0 stays resident in the outer-level cache.  On small
+   grids a single tile covers the whole plane and the traversal reduces to
+   the plain row order. */
+static void bmgs_choose_tile(bmgsstencil* s)
+{
+  const long target = 256 * 1024;   // bytes of cache to aim for
+  long nplanes = s->j[2] + 1;       // input planes live per output plane
+  long rowbytes = (s->n[2] + s->j[2]) * sizeof(double);
+  long b1 = target / (nplanes * rowbytes) - s->j[2];
+  if (b1 < 4)
+    b1 = 4;
+  if (b1 > s->n[1])
+    b1 = s->n[1];
+  s->tile[0] = b1;
+  s->tile[1] = s->n[2];   // rows are streamed whole; i2 is not split
+}
+
+
+/* Check whether a stencil is axis-separable (center coefficient plus
+   points along the three axes only, as produced by bmgs_laplace).  If
+   so, set stencil->range and fill in the per-axis coefficient vectors
+   in stencil->lcoefs so that bmgs_fd can take its unrolled code path.
+   The +/- coefficients are stored separately, so the representation
+   also covers asymmetric separable stencils.  Stencils with some axis
+   points missing (e.g. gradients) keep the generic path: the separable
+   kernel would read neighbor planes with zero weight. */
+static void bmgs_classify(bmgsstencil* s)
+{
+  s->range = 0;
+  if (s->j[2] % 2 != 0)
+    return;
+  int r = s->j[2] / 2;
+  if (r < 1 || r > 4 || s->ncoefs != 6 * r + 1)
+    return;
+  long stride[3] = {s->j[0] / (2 * r), s->j[1] / (2 * r), 1};
+  double cplus[13];
+  double cminus[13];
+  bool found[25];
+  for (int i = 0; i < 2 * 3 * r + 1; i++)
+    found[i] = false;
+  for (int i = 0; i < s->ncoefs; i++)
+    {
+      long o = s->offsets[i];
+      int m = -1;
+      int sign = 0;
+      if (o == 0)
+	m = 0;
+      else
+	for (int a = 0; a < 3 && m < 0; a++)
+	  for (int j = 1; j <= r; j++)
+	    {
+	      if (o == +j * stride[a])
+		{ m = 1 + a * r + (j - 1); sign = +1; break; }
+	      if (o == -j * stride[a])
+		{ m = 1 + a * r + (j - 1); sign = -1; break; }
+	    }
+      if (m < 0)
+	return;     // offset outside the separable pattern
+      if (m == 0)
+	{
+	  if (found[0])
+	    return;
+	  found[0] = true;
+	  cplus[0] = s->coefs[i];
+	}
+      else if (sign > 0)
+	{
+	  if (found[m])
+	    return;
+	  found[m] = true;
+	  cplus[m] = s->coefs[i];
+	}
+      else
+	{
+	  if (found[3 * r + m])
+	    return;
+	  found[3 * r + m] = true;
+	  cminus[m] = s->coefs[i];
+	}
+    }
+  s->lcoefs[0] = cplus[0];
+  for (int m = 1; m <= 3 * r; m++)
+    {
+      s->lcoefs[m] = cplus[m];
+      s->lcoefs[3 * r + m] = cminus[m];
+    }
+  s->range = r;
+}
+
+
 bmgsstencil bmgs_stencil(int ncoefs, const double* coefs, const long* offsets,
 			 int r, const long n[3])
 {
-  bmgsstencil stencil = 
+  bmgsstencil stencil =
     {ncoefs,
      (double*)malloc(ncoefs * sizeof(double)),
      (long*)malloc(ncoefs * sizeof(long)),
@@ -27,6 +118,8 @@ bmgsstencil bmgs_stencil(int ncoefs, const double* coefs, const long* offsets,
   assert((stencil.coefs != NULL) && (stencil.offsets != NULL));
   memcpy(stencil.coefs, coefs, ncoefs * sizeof(double));
   memcpy(stencil.offsets, offsets, ncoefs * sizeof(long));
+  bmgs_classify(&stencil);
+  bmgs_choose_tile(&stencil);
   return stencil;
 }
 
@@ -70,6 +163,8 @@ bmgsstencil bmgs_laplace(int k, double scale,
      {2 * r * (n[2] + 2 * r) * (n[1] + 2 * r),
      2 * r * (n[2] + 2 * r),
      2 * r}};
+  bmgs_classify(&stencil);
+  bmgs_choose_tile(&stencil);
   return stencil;
 }
 
@@ -17,6 +17,27 @@ PyObject* cerf(PyObject *self, PyObject *args)
   return Py_BuildValue("D", &res);
 }
 
+// Array version: evaluate the complex error function for a whole
+// array in one call, so that frequency grids do not cross the
+// Python-C boundary once per value.  The algorithm branch is still
+// chosen per point; the iterative series and continued fraction run
+// a value-dependent number of terms, so there is nothing to gain
+// from evaluating a branch group in lockstep.
+PyObject* cerf_array(PyObject *self, PyObject *args)
+{
+  PyArrayObject* z_array;
+  PyArrayObject* res_array;
+  if (!PyArg_ParseTuple(args, "OO", &z_array, &res_array))
+    return NULL;
+
+  int n = PyArray_MultiplyList(z_array->dimensions, z_array->nd);
+  const double_complex* z_x = COMPLEXP(z_array);
+  double_complex* res_x = COMPLEXP(res_array);
+  for (int x = 0; x < n; x++)
+    res_x[x] = itpp_erf(z_x[x]);
+  Py_RETURN_NONE;
+}
+
 /* taken from 
    http://prdownloads.sourceforge.net/itpp/itpp-3.10.7.tar.bz2
    and transformed to C */ 
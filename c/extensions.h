@@ -41,6 +41,17 @@ static INLINE void* gpaw_malloc(int n)
   return p;
 }
 
+#ifdef GPAW_MALLOC_STATS
+/* Accounting mode: every GPAW_MALLOC is tagged with its call site and
+   matched against free(), so live bytes and high-water marks per call
+   site can be queried from Python with _gpaw.memory_stats() (see
+   mstats.c).  Pointers not from GPAW_MALLOC pass through untouched. */
+void* gpaw_malloc_tagged(size_t nbytes, const char* file, int line);
+void gpaw_free_tagged(void* p);
+#define GPAW_MALLOC(T, n) \
+  (gpaw_malloc_tagged((size_t)(n) * sizeof(T), __FILE__, __LINE__))
+#define free(p) gpaw_free_tagged(p)
+#else
 #ifdef GPAW_BGP
 #define GPAW_MALLOC(T, n) (gpaw_malloc((n) * sizeof(T)))
 #else
@@ -50,6 +61,32 @@ static INLINE void* gpaw_malloc(int n)
 #define GPAW_MALLOC(T, n) (gpaw_malloc((n) * sizeof(T)))
 #endif
 #endif
+#endif
+/* Growable work buffer attached to a long-lived object: return a
+   buffer of at least n doubles, reallocating only when the requirement
+   grows.  *buf must start out NULL and *size 0; the buffer is freed by
+   the owning object's destructor. */
+static INLINE double* gpaw_workbuf(double** buf, long* size, long n)
+{
+  if (n > *size)
+    {
+      free(*buf);
+      *buf = GPAW_MALLOC(double, n);
+      *size = n;
+    }
+  return *buf;
+}
+
+/* Raw apply entry points (defined in operators.c and transformers.c)
+   for C code that drives stencils and transformers directly without
+   going through the Python methods (see precond.c): */
+void Operator_apply_raw(PyObject* opobj, int nin, int real,
+                        const double_complex* ph,
+                        const double* in, double* out);
+void Transformer_apply_raw(PyObject* trobj, int nin, int real,
+                           const double_complex* ph,
+                           const double* in, double* out);
+
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 #define INTP(a) ((int*) ((a)->data))
@@ -0,0 +1,102 @@
+#include "extensions.h"
+#include "threadpool.h"
+
+// Spectral (Hilbert) transform of the response spectral function:
+//
+//   chi[w, g] = dw * sum_ws K(w, ws) S[ws, g]
+//
+// with K = 1/(w - ws + i eta) - 1/(w + ws + i eta), or, for the full
+// response function, 1/(w - ws - i eta) - 1/(w + ws + i eta).  The
+// kernel weights are generated on the fly and the output frequencies
+// are split over the thread pool, so each thread streams the local
+// G-block of the spectral function once per output frequency row and
+// no (Nw, NwS) kernel matrix is ever stored.
+
+struct ht_args {
+  int thread_id;
+  int nthds;
+  int nw;
+  int nws;
+  long ng;
+  double dw;
+  double eta;
+  int full;
+  const double_complex* s;
+  double_complex* chi;
+};
+
+static void* ht_worker(void* argsptr)
+{
+  struct ht_args* args = (struct ht_args*)argsptr;
+  long ng = args->ng;
+  int chunk = (args->nw + args->nthds - 1) / args->nthds;
+  int wa = args->thread_id * chunk;
+  int wb = MIN(wa + chunk, args->nw);
+  for (int iw = wa; iw < wb; iw++) {
+    double w = iw * args->dw;
+    double_complex* chi = args->chi + (long)iw * ng;
+    for (long g = 0; g < ng; g++)
+      chi[g] = 0.0;
+    for (int jw = 0; jw < args->nws; jw++) {
+      double ww = jw * args->dw;
+      double_complex k;
+      if (args->full)
+        k = 1.0 / (w - ww - I * args->eta) - 1.0 / (w + ww + I * args->eta);
+      else
+        k = 1.0 / (w - ww + I * args->eta) - 1.0 / (w + ww + I * args->eta);
+      k *= args->dw;
+      const double_complex* s = args->s + (long)jw * ng;
+      for (long g = 0; g < ng; g++)
+        chi[g] += k * s[g];
+    }
+  }
+  return NULL;
+}
+
+PyObject *hilbert_transform(PyObject *self, PyObject *args)
+{
+  PyArrayObject* spec_wg;
+  PyArrayObject* chi_wg;
+  double dw;
+  double eta;
+  int full;
+  if (!PyArg_ParseTuple(args, "OOddi", &spec_wg, &chi_wg,
+                        &dw, &eta, &full))
+    return NULL;
+
+  int nws = spec_wg->dimensions[0];
+  int nw = chi_wg->dimensions[0];
+  long ng = 1;
+  for (int d = 1; d < spec_wg->nd; d++)
+    ng *= spec_wg->dimensions[d];
+
+  struct ht_args a;
+  a.nw = nw;
+  a.nws = nws;
+  a.ng = ng;
+  a.dw = dw;
+  a.eta = eta;
+  a.full = full;
+  a.s = COMPLEXP(spec_wg);
+  a.chi = COMPLEXP(chi_wg);
+
+  int nthds = 1;
+#ifdef GPAW_OMP
+  nthds = gpaw_threadpool_size();
+  if (nthds > nw)
+    nthds = nw;
+#endif
+  struct ht_args* wargs = GPAW_MALLOC(struct ht_args, nthds);
+  for (int t = 0; t < nthds; t++) {
+    wargs[t] = a;
+    wargs[t].thread_id = t;
+    wargs[t].nthds = nthds;
+  }
+#ifdef GPAW_OMP
+  gpaw_threadpool_run(ht_worker, wargs, sizeof(struct ht_args), nthds);
+#else
+  ht_worker(wargs);
+#endif
+  free(wargs);
+  Py_RETURN_NONE;
+}
@@ -7,25 +7,94 @@
 #include "io_wrappers.h"
 #include <mpi.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <Python.h>
 
 #define MASTER 0
 #define MAX_FILES FOPEN_MAX // 5000 Maximum number of files to open in parallel
 
-static int rank = MASTER; 
+static int rank = MASTER;
 static int enabled = 0;
 
 static FILE *parallel_fps[MAX_FILES];
 static int current_fp = 0;
 static FILE *fp_dev_null;
 
+// Write aggregation: coalesce small writes per file into large blocks
+#define MAX_WBUFS 64
+#define GPAW_IO_BLOCK_DEFAULT (4 * 1024 * 1024)
+
+static int aggregate = 0;
+static size_t block_size = GPAW_IO_BLOCK_DEFAULT;
+
+typedef struct
+{
+  FILE *fp;
+  char *data;
+  size_t fill;
+} wbuf_t;
+
+static wbuf_t wbufs[MAX_WBUFS];
+
+static wbuf_t *get_wbuf(FILE *fp, int create)
+{
+  wbuf_t *free_slot = NULL;
+  for (int i=0; i < MAX_WBUFS; i++)
+    {
+      if (wbufs[i].fp == fp)
+	return &wbufs[i];
+      if (wbufs[i].fp == NULL && free_slot == NULL)
+	free_slot = &wbufs[i];
+    }
+  if (!create || free_slot == NULL)
+    return NULL;
+  free_slot->fp = fp;
+  if (free_slot->data == NULL)
+    free_slot->data = GPAW_MALLOC(char, block_size);
+  free_slot->fill = 0;
+  return free_slot;
+}
+
+// Push out buffered data, e.g. before positioning calls
+static void flush_wbuf(FILE *fp)
+{
+  wbuf_t *wb = get_wbuf(fp, 0);
+  if (wb == NULL)
+    return;
+  if (wb->fill > 0)
+    __real_fwrite(wb->data, 1, wb->fill, fp);
+  wb->fill = 0;
+}
+
+static void release_wbuf(FILE *fp)
+{
+  wbuf_t *wb = get_wbuf(fp, 0);
+  if (wb == NULL)
+    return;
+  if (wb->fill > 0)
+    __real_fwrite(wb->data, 1, wb->fill, fp);
+  wb->fill = 0;
+  wb->fp = NULL;
+}
+
+static void flush_all_wbufs()
+{
+  for (int i=0; i < MAX_WBUFS; i++)
+    if (wbufs[i].fp != NULL)
+      release_wbuf(wbufs[i].fp);
+}
+
 // Initialize wrapper stuff
-void init_io_wrappers() 
+void init_io_wrappers()
 {
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   for (int i=0; i < MAX_FILES; i++)
     parallel_fps[i] = -1;
+  char* p = getenv("GPAW_IO_BLOCK_SIZE");
+  if (p != NULL && atol(p) > 0)
+    block_size = atol(p);
   fp_dev_null = __real_fopen64("/dev/null", "rb");
   enabled = 1;
 }
@@ -146,6 +215,7 @@ FILE* __wrap_fopen64(const char *filename, const char *modes)
 int  __wrap_fclose(FILE *fp)
 {
   int x;
+  release_wbuf(fp);
   int i = check_fp(fp);
   if ( i == current_fp && i > 0 )
     current_fp--;
@@ -242,7 +312,8 @@ void  __wrap_clearerr(FILE *fp)
 int __wrap_fseek(FILE *fp, long offset, int origin)
 {
   int x;
-  if (check_fp(fp)) 
+  flush_wbuf(fp);
+  if (check_fp(fp))
     {
       if (rank == MASTER) 
 	{
@@ -259,7 +330,8 @@ int __wrap_fseek(FILE *fp, long offset, int origin)
 
 void __wrap_rewind(FILE *fp)
 {
-  if (! check_fp(fp) || (rank == MASTER)) 
+  flush_wbuf(fp);
+  if (! check_fp(fp) || (rank == MASTER))
       __real_rewind(fp);
 }
 
@@ -283,7 +355,8 @@ int __wrap_ungetc(int c, FILE* fp)
 int __wrap_fflush(FILE *fp)
 {
   int x;
-  if (check_fp(fp)) 
+  flush_wbuf(fp);
+  if (check_fp(fp))
     {
       if (rank == MASTER) 
 	{
@@ -317,7 +390,8 @@ int __wrap_fgetpos ( FILE * fp, fpos_t * pos )
 int __wrap_fsetpos ( FILE * fp, const fpos_t * pos )
   {
     int x;
-    if (enabled) 
+    flush_wbuf(fp);
+    if (enabled)
       if (rank == MASTER) 
 	{
 	  x = __real_fsetpos(fp, pos);
@@ -333,7 +407,8 @@ int __wrap_fsetpos ( FILE * fp, const fpos_t * pos )
 long int __wrap_ftell ( FILE * fp )
   {
     long x;
-    if (enabled) 
+    flush_wbuf(fp);
+    if (enabled)
       if (rank == MASTER) 
 	{
 	  x = __real_ftell(fp);
@@ -511,71 +586,89 @@ int __wrap_fileno( FILE *fp )
 */
 
 
-// Write functions
-/*
-int __wrap_fputc ( int character, FILE * fp )
-  {
-    int x;
-    if (rank == MASTER) 
-      {
-	x =  __real_fputc(character, fp);
-	MPI_Bcast(&x, 1, MPI_INT, MASTER, MPI_COMM_WORLD); 
-      }
-    else
-      MPI_Bcast(&x, 1, MPI_INT, MASTER, MPI_COMM_WORLD); 
+// Write functions: with aggregation enabled, small writes are
+// coalesced in the per-file buffer and hit the filesystem in
+// block_size chunks
+size_t __wrap_fwrite ( const void * ptr, size_t size, size_t count, FILE * fp )
+{
+  size_t nbytes = size * count;
+  if (!enabled || !aggregate || check_fp(fp))
+    return __real_fwrite(ptr, size, count, fp);
+  wbuf_t *wb = get_wbuf(fp, 1);
+  if (wb == NULL)  // all buffer slots taken
+    return __real_fwrite(ptr, size, count, fp);
+  if (nbytes >= block_size)
+    {
+      // Large writes bypass the buffer; drain first to keep ordering
+      if (wb->fill > 0)
+	{
+	  __real_fwrite(wb->data, 1, wb->fill, fp);
+	  wb->fill = 0;
+	}
+      return __real_fwrite(ptr, size, count, fp);
+    }
+  const char *src = (const char *)ptr;
+  size_t left = nbytes;
+  while (left > 0)
+    {
+      size_t n = block_size - wb->fill;
+      if (n > left)
+	n = left;
+      memcpy(wb->data + wb->fill, src, n);
+      wb->fill += n;
+      src += n;
+      left -= n;
+      if (wb->fill == block_size)
+	{
+	  __real_fwrite(wb->data, 1, block_size, fp);
+	  wb->fill = 0;
+	}
+    }
+  return count;
+}
 
-    return x;
-  }
-      
 int __wrap_fputs ( const char * str, FILE * fp )
-  {
-    int x;
-    if (rank == MASTER) 
-      {
-	x = __real_fputs(str, fp);
-	MPI_Bcast(&x, 1, MPI_INT, MASTER, MPI_COMM_WORLD); 
-      }
-    else
-      MPI_Bcast(&x, 1, MPI_INT, MASTER, MPI_COMM_WORLD); 
+{
+  if (!enabled || !aggregate || check_fp(fp))
+    return __real_fputs(str, fp);
+  size_t len = strlen(str);
+  if (__wrap_fwrite(str, 1, len, fp) != len)
+    return EOF;
+  return 1;
+}
 
-    return x;
-  }
+int __wrap_fputc ( int character, FILE * fp )
+{
+  if (!enabled || !aggregate || check_fp(fp))
+    return __real_fputc(character, fp);
+  char c = character;
+  if (__wrap_fwrite(&c, 1, 1, fp) != 1)
+    return EOF;
+  return character;
+}
 
 int __wrap__IO_putc ( int character, FILE * fp )
-  {
-    int x;
-    if (rank == MASTER) 
-      {
-	x = __real__IO_putc(character, fp);
-	MPI_Bcast(&x, 1, MPI_INT, MASTER, MPI_COMM_WORLD); 
-      }
-    else
-      MPI_Bcast(&x, 1, MPI_INT, MASTER, MPI_COMM_WORLD); 
-    return x;
-  }
-
-size_t __wrap_fwrite ( const void * ptr, size_t size, size_t count, FILE * fp )
 {
-    int x;
-    if (rank == MASTER) 
-    {
-       x = __real_fwrite(ptr, size, count, fp);
-	MPI_Bcast(&x, 1, MPI_INT, MASTER, MPI_COMM_WORLD); 
-       }
-     else
-	MPI_Bcast(&x, 1, MPI_INT, MASTER, MPI_COMM_WORLD); 
-    return x;
-  }
-*/
+  if (!enabled || !aggregate || check_fp(fp))
+    return __real__IO_putc(character, fp);
+  char c = character;
+  if (__wrap_fwrite(&c, 1, 1, fp) != 1)
+    return EOF;
+  return character;
+}
 #endif
 #endif
 
 // Python interfaces
 PyObject* Py_enable_io_wrappers(PyObject *self, PyObject *args)
 {
+  int agg = 0;
+  if (!PyArg_ParseTuple(args, "|i", &agg))
+    return NULL;
 #ifdef PARALLEL
 #ifdef IO_WRAPPERS
   enabled = 1;
+  aggregate = agg;
 #endif
 #endif
   Py_RETURN_NONE;
@@ -585,7 +678,9 @@ PyObject* Py_disable_io_wrappers(PyObject *self, PyObject *args)
 {
 #ifdef PARALLEL
 #ifdef IO_WRAPPERS
+  flush_all_wbufs();
   enabled = 0;
+  aggregate = 0;
 #endif
 #endif
   Py_RETURN_NONE;
@@ -26,8 +26,7 @@ int __real_fstat64(int fildes, struct stat *buf);
 int __real___fxstat64(int vers, int fildes, struct stat *buf);
 //int __real_fstatvfs64(int fildes, struct statfs *buf);
 int __real_fileno( FILE *fp );
-/*
 int __real_fputc ( int character, FILE * fp );
 int __real_fputs ( const char * str, FILE * fp );
 int __real__IO_putc ( int character, FILE * fp );
-size_t __real_fwrite ( const void * ptr, size_t size, size_t count, FILE * fp );*/
+size_t __real_fwrite ( const void * ptr, size_t size, size_t count, FILE * fp );
@@ -36,6 +36,14 @@
 #  define zgttrf_ zgttrf
 #  define zgttrs_ zgttrs
 #endif
+#ifdef GPAW_NO_UNDERSCORE_LAPACK
+#  define ssygv_  ssygv
+#  define chegv_  chegv
+#endif
+#ifdef GPAW_NO_UNDERSCORE_BLAS
+#  define dtrsm_  dtrsm
+#  define ztrsm_  ztrsm
+#endif
 
 double dlamch_(char* cmach);
 
@@ -108,6 +116,49 @@ void zgttrf_(int* n, void* dl, void* d, void* du,
 void zgttrs_(char* tran, int* n, int* nrhs, void* dl,
                void* d, void* du, void* du2,
                int* ipiv, void* b, int* ldb, int* info);
+void ssygv_(int *itype, char *jobz, char *uplo, int *n,
+	    float *a, int *lda, float *b, int *ldb,
+	    float *w, float *work, int *lwork, int *info);
+void chegv_(int *itype, char *jobz, char *uplo, int *n,
+	    void *a, int *lda, void *b, int *ldb,
+	    float *w, void *work, int *lwork,
+	    float *rwork, int *info);
+void dtrsm_(char *side, char *uplo, char *transa, char *diag,
+	    int *m, int *n, double *alpha, double *a, int *lda,
+	    double *b, int *ldb);
+void ztrsm_(char *side, char *uplo, char *transa, char *diag,
+	    int *m, int *n, void *alpha, void *a, int *lda,
+	    void *b, int *ldb);
+
+/* Work-array cache for the diagonalization entry points: the
+ * eigensolvers diagonalize the same-size subspace matrix on every SCF
+ * iteration, so the work arrays are kept between calls instead of
+ * being reallocated.  Grow-only, one slot per array kind. */
+static void* lapack_work(void** buf, long* nbuf, long nbytes)
+{
+  if (nbytes > *nbuf)
+    {
+      free(*buf);
+      *buf = malloc(nbytes);
+      *nbuf = nbytes;
+    }
+  return *buf;
+}
+
+static void* work_buf = NULL;
+static long work_nbytes = 0;
+static void* rwork_buf = NULL;
+static long rwork_nbytes = 0;
+static void* iwork_buf = NULL;
+static long iwork_nbytes = 0;
+static void* isuppz_buf = NULL;
+static long isuppz_nbytes = 0;
+static void* single_a_buf = NULL;
+static long single_a_nbytes = 0;
+static void* single_b_buf = NULL;
+static long single_b_nbytes = 0;
+static void* single_w_buf = NULL;
+static long single_w_nbytes = 0;
 
 PyObject* diagonalize(PyObject *self, PyObject *args)
 {
@@ -121,22 +172,22 @@ PyObject* diagonalize(PyObject *self, PyObject *args)
   if (a->descr->type_num == PyArray_DOUBLE)
     {
       int lwork = 3 * n + 1;
-      double* work = GPAW_MALLOC(double, lwork);
+      double* work = lapack_work(&work_buf, &work_nbytes,
+				 lwork * sizeof(double));
       dsyev_("V", "U", &n, DOUBLEP(a), &lda,
 	     DOUBLEP(w), work, &lwork, &info);
-      free(work);
     }
   else
     {
       int lwork = 2 * n + 1;
       int lrwork = 3 * n + 1;
-      void* work = GPAW_MALLOC(double_complex, lwork);
-      double* rwork = GPAW_MALLOC(double, lrwork);
+      void* work = lapack_work(&work_buf, &work_nbytes,
+			       lwork * sizeof(double_complex));
+      double* rwork = lapack_work(&rwork_buf, &rwork_nbytes,
+				  lrwork * sizeof(double));
       zheev_("V", "U", &n, (void*)COMPLEXP(a), &lda,
 	     DOUBLEP(w),
 	     work, &lwork, rwork, &lrwork, &info);
-      free(work);
-      free(rwork);
     }
   return Py_BuildValue("i", info);
 }
@@ -159,22 +210,23 @@ PyObject* diagonalize_mr3(PyObject *self, PyObject *args)
   int m = n; /* assume we find all eigenvalues */ 
   int ldz = lda;
   int info = 0;
-  int* isuppz = GPAW_MALLOC(int, 2*m);
+  int* isuppz = lapack_work(&isuppz_buf, &isuppz_nbytes,
+			    2 * m * sizeof(int));
   if (a->descr->type_num == PyArray_DOUBLE)
     {
       /* Minimum workspace plus a little extra */
       int lwork = 26 * n + 1;
       int liwork = 10 * n + 1;
-      double* work = GPAW_MALLOC(double, lwork);
-      int* iwork = GPAW_MALLOC(int, liwork);
-      dsyevr_(&jobz, &range, &uplo, &n, 
+      double* work = lapack_work(&work_buf, &work_nbytes,
+				 lwork * sizeof(double));
+      int* iwork = lapack_work(&iwork_buf, &iwork_nbytes,
+			       liwork * sizeof(int));
+      dsyevr_(&jobz, &range, &uplo, &n,
 	      DOUBLEP(a), &lda,
-	      &vl, &vu, &il, &iu, &abstol, 
-	      &m, DOUBLEP(w), DOUBLEP(z), &ldz, isuppz, 
+	      &vl, &vu, &il, &iu, &abstol,
+	      &m, DOUBLEP(w), DOUBLEP(z), &ldz, isuppz,
 	      work, &lwork, iwork, &liwork,
 	      &info);
-      free(work);
-      free(iwork);
     }
   else
     {
@@ -182,21 +234,20 @@ PyObject* diagonalize_mr3(PyObject *self, PyObject *args)
       int lwork = 2 * n + 1;
       int lrwork = 24 * n + 1;
       int liwork = 10 * n + 1;
-      void* work = GPAW_MALLOC(double_complex, lwork);
-      double* rwork = GPAW_MALLOC(double, lrwork);
-      int* iwork = GPAW_MALLOC(int, liwork);
-      zheevr_(&jobz, &range, &uplo, &n, 
+      void* work = lapack_work(&work_buf, &work_nbytes,
+			       lwork * sizeof(double_complex));
+      double* rwork = lapack_work(&rwork_buf, &rwork_nbytes,
+				  lrwork * sizeof(double));
+      int* iwork = lapack_work(&iwork_buf, &iwork_nbytes,
+			       liwork * sizeof(int));
+      zheevr_(&jobz, &range, &uplo, &n,
 	      (void*)COMPLEXP(a), &lda,
-	      &vl, &vu, &il, &iu, &abstol, 
-	      &m,  DOUBLEP(w), (void*)COMPLEXP(z), &ldz, isuppz, 
+	      &vl, &vu, &il, &iu, &abstol,
+	      &m,  DOUBLEP(w), (void*)COMPLEXP(z), &ldz, isuppz,
 	      work, &lwork, rwork, &lrwork,
-	      iwork, &liwork, 
+	      iwork, &liwork,
 	      &info);
-      free(work);
-      free(rwork);
-      free(iwork);
     }
-  free(isuppz);
   // If this fails, fewer eigenvalues than request were computed
   assert (m == n);
   return Py_BuildValue("i", info);
@@ -217,28 +268,100 @@ PyObject* general_diagonalize(PyObject *self, PyObject *args)
   if (a->descr->type_num == PyArray_DOUBLE)
     {
       int lwork = 3 * n + 1;
-      double* work = GPAW_MALLOC(double, lwork);
+      double* work = lapack_work(&work_buf, &work_nbytes,
+				 lwork * sizeof(double));
       dsygv_(&itype, "V", "U", &n, DOUBLEP(a), &lda,
 	     DOUBLEP(b), &ldb, DOUBLEP(w),
 	     work, &lwork, &info);
-      free(work);
     }
   else
     {
       int lwork = 2 * n + 1;
       int lrwork = 3 * n + 1;
-      void* work = GPAW_MALLOC(double_complex, lwork);
-      double* rwork = GPAW_MALLOC(double, lrwork);
+      void* work = lapack_work(&work_buf, &work_nbytes,
+			       lwork * sizeof(double_complex));
+      double* rwork = lapack_work(&rwork_buf, &rwork_nbytes,
+				  lrwork * sizeof(double));
       zhegv_(&itype, "V", "U", &n, (void*)COMPLEXP(a), &lda,
 	     (void*)COMPLEXP(b), &lda,
 	     DOUBLEP(w),
 	     work, &lwork, rwork, &lrwork, &info);
-      free(work);
-      free(rwork);
     }
   return Py_BuildValue("i", info);
 }
 
+PyObject* general_diagonalize_single(PyObject *self, PyObject *args)
+{
+  /* Single-precision variant of general_diagonalize: the matrices are
+   * rounded to float, solved with ssygv/chegv and the eigenvectors
+   * promoted back into a.  Unlike the double version, b is left
+   * untouched, so the caller can refine the result against the
+   * original matrices. */
+  PyArrayObject* a;
+  PyArrayObject* w;
+  PyArrayObject* b;
+  if (!PyArg_ParseTuple(args, "OOO", &a, &w, &b))
+    return NULL;
+  int n = a->dimensions[0];
+  int lda = MAX(1, n);
+  int ldb = lda;
+  int itype = 1;
+  int info = 0;
+  float* sw = lapack_work(&single_w_buf, &single_w_nbytes,
+			  n * sizeof(float));
+  if (a->descr->type_num == PyArray_DOUBLE)
+    {
+      long nelem = (long)n * n;
+      float* sa = lapack_work(&single_a_buf, &single_a_nbytes,
+			      nelem * sizeof(float));
+      float* sb = lapack_work(&single_b_buf, &single_b_nbytes,
+			      nelem * sizeof(float));
+      double* ap = DOUBLEP(a);
+      double* bp = DOUBLEP(b);
+      for (long i = 0; i < nelem; i++)
+	{
+	  sa[i] = ap[i];
+	  sb[i] = bp[i];
+	}
+      int lwork = 3 * n + 1;
+      float* work = lapack_work(&work_buf, &work_nbytes,
+				lwork * sizeof(float));
+      ssygv_(&itype, "V", "U", &n, sa, &lda, sb, &ldb, sw,
+	     work, &lwork, &info);
+      for (long i = 0; i < nelem; i++)
+	ap[i] = sa[i];
+    }
+  else
+    {
+      /* One float per real component: */
+      long nelem = 2 * (long)n * n;
+      float* sa = lapack_work(&single_a_buf, &single_a_nbytes,
+			      nelem * sizeof(float));
+      float* sb = lapack_work(&single_b_buf, &single_b_nbytes,
+			      nelem * sizeof(float));
+      double* ap = (double*)COMPLEXP(a);
+      double* bp = (double*)COMPLEXP(b);
+      for (long i = 0; i < nelem; i++)
+	{
+	  sa[i] = ap[i];
+	  sb[i] = bp[i];
+	}
+      int lwork = 2 * n + 1;
+      int lrwork = 3 * n + 1;
+      void* work = lapack_work(&work_buf, &work_nbytes,
+			       lwork * 2 * sizeof(float));
+      float* rwork = lapack_work(&rwork_buf, &rwork_nbytes,
+				 lrwork * sizeof(float));
+      chegv_(&itype, "V", "U", &n, sa, &lda, sb, &ldb, sw,
+	     work, &lwork, rwork, &info);
+      for (long i = 0; i < nelem; i++)
+	ap[i] = sa[i];
+    }
+  for (int i = 0; i < n; i++)
+    DOUBLEP(w)[i] = sw[i];
+  return Py_BuildValue("i", info);
+}
+
 PyObject* inverse_cholesky(PyObject *self, PyObject *args)
 {
   PyArrayObject* a;
@@ -289,6 +412,51 @@ PyObject* inverse_cholesky(PyObject *self, PyObject *args)
   return Py_BuildValue("i", info);
 }
 
+PyObject* cholesky(PyObject *self, PyObject *args)
+{
+  PyArrayObject* a;
+  if (!PyArg_ParseTuple(args, "O", &a))
+    return NULL;
+  int n = a->dimensions[0];
+  int lda = MAX(1, n);
+  int info = 0;
+
+  if (a->descr->type_num == PyArray_DOUBLE)
+    dpotrf_("U", &n, (void*)DOUBLEP(a), &lda, &info);
+  else
+    zpotrf_("U", &n, (void*)COMPLEXP(a), &lda, &info);
+  return Py_BuildValue("i", info);
+}
+
+PyObject* cholesky_solve(PyObject *self, PyObject *args)
+{
+  PyArrayObject* a;
+  PyArrayObject* b;
+  if (!PyArg_ParseTuple(args, "OO", &a, &b))
+    return NULL;
+  int n = a->dimensions[0];
+  int lda = MAX(1, n);
+  /* One right-hand side vector per row of b: */
+  int m = 1;
+  for (int d = 1; d < b->nd; d++)
+    m *= b->dimensions[d];
+  int ldb = MAX(1, m);
+
+  if (a->descr->type_num == PyArray_DOUBLE)
+    {
+      double alpha = 1.0;
+      dtrsm_("R", "U", "N", "N", &m, &n, &alpha,
+	     DOUBLEP(a), &lda, DOUBLEP(b), &ldb);
+    }
+  else
+    {
+      double_complex alpha = 1.0;
+      ztrsm_("R", "U", "N", "N", &m, &n, &alpha,
+	     (void*)COMPLEXP(a), &lda, (void*)COMPLEXP(b), &ldb);
+    }
+  Py_RETURN_NONE;
+}
+
 void swap(double *a, double *b) {
   double tmp=*b;
   *b = *a;
@@ -10,14 +10,31 @@
 #include "lfc.h"
 #include "bmgs/spherical_harmonics.h"
 #include "bmgs/bmgs.h"
+#include "threadpool.h"
+
+#ifdef GPAW_NO_UNDERSCORE_BLAS
+#  define dgemm_  dgemm
+#endif
+void dgemm_(char *transa, char *transb, int *m, int * n,
+	    int *k, double *alpha, double *a, int *lda,
+	    double *b, int *ldb, double *beta,
+	    double *c, int *ldc);
 
 
 static void lfc_dealloc(LFCObject *self)
 {
-  if (self->bloch_boundary_conditions)
+  if (self->bloch_boundary_conditions) {
     free(self->phase_i);
+    free(self->conjphase_kW);
+  }
+  free(self->chunk_B);
+  free(self->chunk_Ga);
+  free(self->chunk_ni);
+  free(self->chunk_iW);
+  free(self->chunk_off);
   free(self->volume_i);
   free(self->work_gm);
+  free(self->scratch);
   free(self->ngm_W);
   free(self->i_W);
   free(self->volume_W);
@@ -27,6 +44,7 @@ static void lfc_dealloc(LFCObject *self)
 PyObject* calculate_potential_matrix(LFCObject *self, PyObject *args);
 PyObject* integrate(LFCObject *self, PyObject *args);
 PyObject* derivative(LFCObject *self, PyObject *args);
+PyObject* integrate_and_derivative(LFCObject *self, PyObject *args);
 PyObject* normalized_derivative(LFCObject *self, PyObject *args);
 PyObject* construct_density(LFCObject *self, PyObject *args);
 PyObject* construct_density1(LFCObject *self, PyObject *args);
@@ -34,10 +52,22 @@ PyObject* ae_valence_density_correction(LFCObject *self, PyObject *args);
 PyObject* ae_core_density_correction(LFCObject *self, PyObject *args);
 PyObject* lcao_to_grid(LFCObject *self, PyObject *args);
 PyObject* add(LFCObject *self, PyObject *args);
-PyObject* calculate_potential_matrix_derivative(LFCObject *self, 
+PyObject* transform_add(LFCObject *self, PyObject *args);
+PyObject* calculate_potential_matrix_derivative(LFCObject *self,
                                                 PyObject *args);
+PyObject* calculate_potential_matrix_derivatives(LFCObject *self,
+                                                 PyObject *args);
 PyObject* second_derivative(LFCObject *self, PyObject *args);
 PyObject* add_derivative(LFCObject *self, PyObject *args);
+PyObject* add_derivatives(LFCObject *self, PyObject *args);
+
+static PyObject* lfc_get_stats(LFCObject *self, PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+
+  return gpaw_perf_stats(&self->perf);
+}
 
 static PyMethodDef lfc_methods[] = {
     {"calculate_potential_matrix",
@@ -46,6 +76,8 @@ static PyMethodDef lfc_methods[] = {
      (PyCFunction)integrate, METH_VARARGS, 0},
     {"derivative",
      (PyCFunction)derivative, METH_VARARGS, 0},
+    {"integrate_and_derivative",
+     (PyCFunction)integrate_and_derivative, METH_VARARGS, 0},
     {"normalized_derivative",
      (PyCFunction)normalized_derivative, METH_VARARGS, 0},
     {"construct_density",
@@ -60,12 +92,20 @@ static PyMethodDef lfc_methods[] = {
      (PyCFunction)lcao_to_grid, METH_VARARGS, 0},
     {"add",
      (PyCFunction)add, METH_VARARGS, 0},
+    {"transform_add",
+     (PyCFunction)transform_add, METH_VARARGS, 0},
     {"calculate_potential_matrix_derivative",
      (PyCFunction)calculate_potential_matrix_derivative, METH_VARARGS, 0},
+    {"calculate_potential_matrix_derivatives",
+     (PyCFunction)calculate_potential_matrix_derivatives, METH_VARARGS, 0},
     {"second_derivative",
      (PyCFunction)second_derivative, METH_VARARGS, 0},
     {"add_derivative",
      (PyCFunction)add_derivative, METH_VARARGS, 0},
+    {"add_derivatives",
+     (PyCFunction)add_derivatives, METH_VARARGS, 0},
+    {"get_stats",
+     (PyCFunction)lfc_get_stats, METH_VARARGS, 0},
 #ifdef PARALLEL
     {"broadcast",
      (PyCFunction)localized_functions_broadcast, METH_VARARGS, 0},
@@ -164,14 +204,279 @@ PyObject * NewLFCObject(PyObject *obj, PyObject *args)
     if (volume->nm > nmmax)
       nmmax = volume->nm;
   }
+  self->nmmax = nmmax;
+  self->ngmax = ngmax;
   self->work_gm = GPAW_MALLOC(double, ngmax * nmmax);
+  self->scratch = NULL;
+  self->nscratch = 0;
+  memset(&self->perf, 0, sizeof(gpaw_perf_t));
+  // Totals for the streaming cost model (see perf.h):
+  self->ngmtotal = 0;
+  self->ngtotal = 0;
+  for (int W = 0; W < nW; W++) {
+    self->ngmtotal += self->ngm_W[W];
+    self->ngtotal += self->ngm_W[W] / self->volume_W[W].nm;
+  }
   self->volume_i = GPAW_MALLOC(LFVolume, nimax);
-  if (self->bloch_boundary_conditions)
+  self->nimax = nimax;
+  self->nchunks = 0;
+  self->chunk_B = NULL;
+  self->chunk_Ga = NULL;
+  self->chunk_ni = NULL;
+  self->chunk_iW = NULL;
+  self->chunk_off = NULL;
+#ifdef GPAW_OMP_MONLY
+  // Plan the chunks for the threaded grid loops.  The sweep over the
+  // segments is replayed once with integer bookkeeping only, cutting at
+  // segment boundaries whenever a fair share of the total work (grid
+  // points times active volumes) has been passed, and the active
+  // volumes with their A_gm offsets are recorded at each cut.  Several
+  // chunks per thread are planned, because they are claimed dynamically
+  // at run time - the cost per volume varies a lot between species.
+  {
+    int nplan = 8 * gpaw_threadpool_size();
+    long long total = 0;
+    ni = 0;
+    Ga = 0;
+    for (int B = 0; B < nB; B++) {
+      int nG = self->G_B[B] - Ga;
+      if (nG > 0)
+        total += (long long)nG * ni;
+      if (self->W_B[B] >= 0)
+        ni++;
+      else
+        ni--;
+      Ga = self->G_B[B];
+    }
+    if (nplan < 1 || total == 0)
+      nplan = 1;
+    self->chunk_B = GPAW_MALLOC(int, nplan + 1);
+    self->chunk_Ga = GPAW_MALLOC(int, nplan);
+    self->chunk_ni = GPAW_MALLOC(int, nplan);
+    self->chunk_iW = GPAW_MALLOC(int, nplan * (nimax > 0 ? nimax : 1));
+    self->chunk_off = GPAW_MALLOC(int, nplan * (nimax > 0 ? nimax : 1));
+    int* off_W = GPAW_MALLOC(int, nW > 0 ? nW : 1);
+    int* act_i = GPAW_MALLOC(int, nimax > 0 ? nimax : 1);
+    long long cum = 0;
+    int c = 0;
+    ni = 0;
+    Ga = 0;
+    for (int B = 0; B < nB; B++) {
+      if (c < nplan && cum * nplan >= (long long)c * total) {
+        self->chunk_B[c] = B;
+        self->chunk_Ga[c] = Ga;
+        self->chunk_ni[c] = ni;
+        for (int i = 0; i < ni; i++) {
+          self->chunk_iW[c * nimax + i] = act_i[i];
+          self->chunk_off[c * nimax + i] = off_W[act_i[i]];
+        }
+        c++;
+      }
+      int nG = self->G_B[B] - Ga;
+      if (nG > 0) {
+        cum += (long long)nG * ni;
+        for (int i = 0; i < ni; i++)
+          off_W[act_i[i]] += nG * self->volume_W[act_i[i]].nm;
+      }
+      int Wnew = self->W_B[B];
+      if (Wnew >= 0) {
+        act_i[ni] = Wnew;
+        off_W[Wnew] = 0;
+        self->i_W[Wnew] = ni;
+        ni++;
+      }
+      else {
+        int Wold = -1 - Wnew;
+        int iold = self->i_W[Wold];
+        ni--;
+        act_i[iold] = act_i[ni];
+        self->i_W[act_i[iold]] = iold;
+      }
+      Ga = self->G_B[B];
+    }
+    self->nchunks = c;
+    self->chunk_B[c] = nB;
+    free(act_i);
+    free(off_W);
+  }
+#endif
+  if (self->bloch_boundary_conditions) {
     self->phase_i = GPAW_MALLOC(complex double, nimax);
-  
+    // Cache the conjugated phase factors - one per (k-point, volume) -
+    // so the grid loops can look up exp(-ik.R) instead of conjugating:
+    int nk = phase_kW_obj->dimensions[0];
+    self->conjphase_kW = GPAW_MALLOC(complex double, nk * nW);
+    for (int q = 0; q < nk * nW; q++)
+      self->conjphase_kW[q] = conj(self->phase_kW[q]);
+  }
+
   return (PyObject*)self;
 }
 
+// Hand out n doubles of temporary storage.  The buffer lives on the
+// LFCObject and only grows, so the entry points do not go through the
+// allocator on every call - they are called many times per SCF
+// iteration per k-point, possibly from several threads each working on
+// its own LFCObject.  Each entry point must request all its temporary
+// storage in a single call and carve it up itself (like work_gm).
+static double* lfc_scratch(LFCObject *lfc, int n)
+{
+  if (n > lfc->nscratch) {
+    free(lfc->scratch);
+    lfc->scratch = GPAW_MALLOC(double, n);
+    lfc->nscratch = n;
+  }
+  return lfc->scratch;
+}
+
+#ifdef GPAW_OMP_MONLY
+// The threaded grid loops claim chunks from a shared counter instead
+// of partitioning them statically - the cost of a chunk depends on
+// which spheres it intersects and varies too much between species for
+// a static split to keep all threads busy.
+static int lfc_claim_chunk(int* counter)
+{
+  return __sync_fetch_and_add(counter, 1);
+}
+
+struct lfc_potmat_args
+{
+  LFCObject* lfc;
+  const double* vt_G;
+  double* Vt_MM;                 // output or private copy (real case)
+  double complex* Vt_MMz;        // output or private copy (Bloch case)
+  int nM;
+  int k;
+  int Mstart;
+  int Mstop;
+  double* work_gm;
+  double* block_mm;
+  LFVolume* volume_i;
+  double complex* phase_i;
+  int* i_W;
+  int* next_chunk;
+  long long nflops;
+  long long nbytes;
+};
+
+static void* lfc_potmat_worker(void* args)
+{
+  struct lfc_potmat_args* arg = (struct lfc_potmat_args*)args;
+  LFCObject* lfc = arg->lfc;
+  const double* vt_G = arg->vt_G;
+  int nM = arg->nM;
+  int Mstart = arg->Mstart;
+  int Mstop = arg->Mstop;
+  double dv = lfc->dv;
+  double* work_gm = arg->work_gm;
+  long long nflops = 0;
+  long long nbytes = 0;
+  if (arg->Vt_MM != NULL) {
+    double* Vt_MM = arg->Vt_MM;
+    for (;;) {
+      int c = lfc_claim_chunk(arg->next_chunk);
+      if (c >= lfc->nchunks)
+        break;
+      GRID_LOOP_CHUNK_START(lfc, -1, c, arg->volume_i, NULL, arg->i_W) {
+        for (int i1 = 0; i1 < ni; i1++) {
+          LFVolume* v1 = volume_i + i1;
+          int M1 = v1->M;
+          int nm1 = v1->nm;
+          int M1p = MAX(M1, Mstart);
+          int nm1p = MIN(M1 + nm1, Mstop) - M1p;
+          if (nm1p <= 0)
+            continue;
+          int gm = M1p - M1;
+          int gm1 = 0;
+          const double* A1_gm = v1->A_gm;
+          for (int G = Ga; G < Gb; G++, gm += nm1 - nm1p) {
+            double vtdv = vt_G[G] * dv;
+            for (int m1 = 0; m1 < nm1p; m1++, gm1++, gm++)
+              work_gm[gm1] = vtdv * A1_gm[gm];
+          }
+          nflops += 2LL * nm1p * nG;
+          nbytes += 8LL * nG * (nm1p + 1);
+          for (int i2 = 0; i2 < ni; i2++) {
+            LFVolume* v2 = volume_i + i2;
+            int M2 = v2->M;
+            if (M1 >= M2) {
+              int nm2 = v2->nm;
+              const double* A2_gm = v2->A_gm;
+              double* Vt_mm = Vt_MM + (M1p - Mstart) * nM + M2;
+              double one = 1.0;
+              dgemm_("n", "t", &nm2, &nm1p, &nG, &one,
+                     (double*)A2_gm, &nm2, work_gm, &nm1p, &one,
+                     Vt_mm, &nM);
+              nflops += 2LL * nm2 * nm1p * nG;
+              nbytes += 8LL * (nG * nm2 + 2 * nm1p * nm2);
+            }
+          }
+        }
+      }
+      GRID_LOOP_CHUNK_STOP(lfc, -1);
+    }
+  }
+  else {
+    double complex* Vt_MM = arg->Vt_MMz;
+    double* block_mm = arg->block_mm;
+    int k = arg->k;
+    for (;;) {
+      int c = lfc_claim_chunk(arg->next_chunk);
+      if (c >= lfc->nchunks)
+        break;
+      GRID_LOOP_CHUNK_START(lfc, k, c, arg->volume_i, arg->phase_i,
+                            arg->i_W) {
+        for (int i1 = 0; i1 < ni; i1++) {
+          LFVolume* v1 = volume_i + i1;
+          double complex conjphase1 = conj(phase_i[i1]);
+          int M1 = v1->M;
+          int nm1 = v1->nm;
+          int M1p = MAX(M1, Mstart);
+          int nm1p = MIN(M1 + nm1, Mstop) - M1p;
+          if (nm1p <= 0)
+            continue;
+          int gm = M1p - M1;
+          int gm1 = 0;
+          const double* A1_gm = v1->A_gm;
+          for (int G = Ga; G < Gb; G++, gm += nm1 - nm1p) {
+            double vtdv = vt_G[G] * dv;
+            for (int m1 = 0; m1 < nm1p; m1++, gm1++, gm++)
+              work_gm[gm1] = vtdv * A1_gm[gm];
+          }
+          nflops += 2LL * nm1p * nG;
+          nbytes += 8LL * nG * (nm1p + 1);
+          for (int i2 = 0; i2 < ni; i2++) {
+            LFVolume* v2 = volume_i + i2;
+            const double* A2_gm = v2->A_gm;
+            int M2 = v2->M;
+            if (M1 >= M2) {
+              int nm2 = v2->nm;
+              double complex phase = conjphase1 * phase_i[i2];
+              double complex* Vt_mm = Vt_MM + (M1p - Mstart) * nM + M2;
+              double one = 1.0;
+              double zero = 0.0;
+              dgemm_("n", "t", &nm2, &nm1p, &nG, &one,
+                     (double*)A2_gm, &nm2, work_gm, &nm1p, &zero,
+                     block_mm, &nm2);
+              int m1nM = 0;
+              for (int m1 = 0; m1 < nm1p; m1++, m1nM += nM)
+                for (int m2 = 0; m2 < nm2; m2++)
+                  Vt_mm[m1nM + m2] += block_mm[m1 * nm2 + m2] * phase;
+              nflops += (2LL * nG + 4) * nm1p * nm2;
+              nbytes += 8LL * (nG * nm2 + 5 * nm1p * nm2);
+            }
+          }
+        }
+      }
+      GRID_LOOP_CHUNK_STOP(lfc, k);
+    }
+  }
+  arg->nflops = nflops;
+  arg->nbytes = nbytes;
+  return NULL;
+}
+#endif // GPAW_OMP_MONLY
+
 PyObject* calculate_potential_matrix(LFCObject *lfc, PyObject *args)
 {
   const PyArrayObject* vt_G_obj;
@@ -182,13 +487,105 @@ PyObject* calculate_potential_matrix(LFCObject *lfc, PyObject *args)
 
   if (!PyArg_ParseTuple(args, "OOiii", &vt_G_obj, &Vt_MM_obj, &k,
                         &Mstart, &Mstop))
-    return NULL; 
+    return NULL;
+
+  long long counters[GPAW_PERF_NCOUNTERS];
+  double tperf = 0;
+  long long nbytes = 0;
+  long long nflops = 0;
+  if (gpaw_perf_enabled)
+    gpaw_perf_start(counters, &tperf);
 
   const double* vt_G = (const double*)vt_G_obj->data;
 
   int nM = Vt_MM_obj->dimensions[1];
   double dv = lfc->dv;
   double* work_gm = lfc->work_gm;
+#ifdef GPAW_OMP_MONLY
+  int nthds = gpaw_threadpool_size();
+  if (nthds > lfc->nchunks)
+    nthds = lfc->nchunks;
+  if (nthds > 1) {
+    // Threaded sweep: each thread gets its own scratch and active-volume
+    // arrays.  Thread 0 updates the output matrix directly; the others
+    // accumulate into zeroed private copies that are summed afterwards.
+    bool cplx = lfc->bloch_boundary_conditions;
+    int myM = Vt_MM_obj->dimensions[0];
+    int ngm = lfc->ngmax * lfc->nmmax;
+    int nmm = lfc->nmmax * lfc->nmmax;
+    int csize = (cplx ? 2 : 1);
+    int next_chunk = 0;
+    struct lfc_potmat_args* arg_n = GPAW_MALLOC(struct lfc_potmat_args,
+                                                nthds);
+    double* work_ngm = GPAW_MALLOC(double, nthds * ngm);
+    LFVolume* volume_ni = GPAW_MALLOC(LFVolume, nthds * lfc->nimax);
+    int* iW_nW = GPAW_MALLOC(int, nthds * lfc->nW);
+    double complex* phase_ni = NULL;
+    double* block_nmm = NULL;
+    if (cplx) {
+      phase_ni = GPAW_MALLOC(double complex, nthds * lfc->nimax);
+      block_nmm = GPAW_MALLOC(double, nthds * nmm);
+    }
+    double* priv = GPAW_MALLOC(double, csize * (nthds - 1) * myM * nM);
+    memset(priv, 0, csize * (nthds - 1) * myM * nM * sizeof(double));
+    for (int n = 0; n < nthds; n++) {
+      struct lfc_potmat_args* arg = &arg_n[n];
+      arg->lfc = lfc;
+      arg->vt_G = vt_G;
+      if (cplx) {
+        arg->Vt_MM = NULL;
+        arg->Vt_MMz = (n == 0 ? (double complex*)Vt_MM_obj->data
+                       : (double complex*)priv + (n - 1) * myM * nM);
+        arg->block_mm = block_nmm + n * nmm;
+        arg->phase_i = phase_ni + n * lfc->nimax;
+      }
+      else {
+        arg->Vt_MM = (n == 0 ? (double*)Vt_MM_obj->data
+                      : priv + (n - 1) * myM * nM);
+        arg->Vt_MMz = NULL;
+        arg->block_mm = NULL;
+        arg->phase_i = NULL;
+      }
+      arg->nM = nM;
+      arg->k = k;
+      arg->Mstart = Mstart;
+      arg->Mstop = Mstop;
+      arg->work_gm = work_ngm + n * ngm;
+      arg->volume_i = volume_ni + n * lfc->nimax;
+      arg->i_W = iW_nW + n * lfc->nW;
+      arg->next_chunk = &next_chunk;
+      arg->nflops = 0;
+      arg->nbytes = 0;
+    }
+    gpaw_threadpool_run(lfc_potmat_worker, arg_n,
+                        sizeof(struct lfc_potmat_args), nthds);
+    if (cplx) {
+      double complex* Vt_MM = (double complex*)Vt_MM_obj->data;
+      const double complex* p = (const double complex*)priv;
+      for (int n = 1; n < nthds; n++)
+        for (int q = 0; q < myM * nM; q++)
+          Vt_MM[q] += p[(n - 1) * myM * nM + q];
+    }
+    else {
+      double* Vt_MM = (double*)Vt_MM_obj->data;
+      for (int n = 1; n < nthds; n++)
+        for (int q = 0; q < myM * nM; q++)
+          Vt_MM[q] += priv[(n - 1) * myM * nM + q];
+    }
+    for (int n = 0; n < nthds; n++) {
+      nflops += arg_n[n].nflops;
+      nbytes += arg_n[n].nbytes;
+    }
+    free(priv);
+    free(block_nmm);
+    free(phase_ni);
+    free(iW_nW);
+    free(volume_ni);
+    free(work_ngm);
+    free(arg_n);
+  }
+  else
+#endif
   if (!lfc->bloch_boundary_conditions) {
     double* Vt_MM = (double*)Vt_MM_obj->data;
     GRID_LOOP_START(lfc, -1) { // ORDINARY/GAMMA-POINT
@@ -208,6 +605,8 @@ PyObject* calculate_potential_matrix(LFCObject *lfc, PyObject *args)
 	  for (int m1 = 0; m1 < nm1p; m1++, gm1++, gm++)
 	    work_gm[gm1] = vtdv * A1_gm[gm];
 	}
+	nflops += 2LL * nm1p * nG;
+	nbytes += 8LL * nG * (nm1p + 1);
 	for (int i2 = 0; i2 < ni; i2++) {
 	  LFVolume* v2 = volume_i + i2;
 	  int M2 = v2->M;
@@ -215,15 +614,15 @@ PyObject* calculate_potential_matrix(LFCObject *lfc, PyObject *args)
 	    int nm2 = v2->nm;
 	    const double* A2_gm = v2->A_gm;
 	    double* Vt_mm = Vt_MM + (M1p - Mstart) * nM + M2;
-	    for (int g = 0; g < nG; g++){
-	      int gnm1 = g * nm1p;
-	      int gnm2 = g * nm2;
-	      for (int m1 = 0; m1 < nm1p; m1++) {
-		int m1nM = m1 * nM;
-		for (int m2 = 0; m2 < nm2; m2++)
-		  Vt_mm[m2 + m1nM] += A2_gm[gnm2 + m2] * work_gm[gnm1 + m1];
-	      }
-	    }
+	    // Vt_mm(m1, m2) += work_gm(g, m1) * A2_gm(g, m2) as a single
+	    // rank-nG update over the grid strip (column-major dgemm on
+	    // the transposed matrices):
+	    double one = 1.0;
+	    dgemm_("n", "t", &nm2, &nm1p, &nG, &one,
+		   (double*)A2_gm, &nm2, work_gm, &nm1p, &one,
+		   Vt_mm, &nM);
+	    nflops += 2LL * nm2 * nm1p * nG;
+	    nbytes += 8LL * (nG * nm2 + 2 * nm1p * nm2);
 	  }
 	}
       }
@@ -232,6 +631,7 @@ PyObject* calculate_potential_matrix(LFCObject *lfc, PyObject *args)
   }
   else {
     complex double* Vt_MM = (complex double*)Vt_MM_obj->data;
+    double* block_mm = lfc_scratch(lfc, lfc->nmmax * lfc->nmmax);
     GRID_LOOP_START(lfc, k) {  // KPOINT CALC POT MATRIX
       for (int i1 = 0; i1 < ni; i1++) {
         LFVolume* v1 = volume_i + i1;
@@ -250,6 +650,8 @@ PyObject* calculate_potential_matrix(LFCObject *lfc, PyObject *args)
           for (int m1 = 0; m1 < nm1p; m1++, gm1++, gm++)
             work_gm[gm1] = vtdv * A1_gm[gm];
         }
+        nflops += 2LL * nm1p * nG;
+        nbytes += 8LL * nG * (nm1p + 1);
         for (int i2 = 0; i2 < ni; i2++) {
           LFVolume* v2 = volume_i + i2;
           const double* A2_gm = v2->A_gm;
@@ -258,26 +660,148 @@ PyObject* calculate_potential_matrix(LFCObject *lfc, PyObject *args)
             int nm2 = v2->nm;
             double complex phase = conjphase1 * phase_i[i2];
             double complex* Vt_mm = Vt_MM + (M1p - Mstart) * nM + M2;
-            for (int g = 0; g < nG; g++) {
-              int gnm1 = g * nm1p;
-              int gnm2 = g * nm2;
-              int m1nM = 0;
-              for (int m1 = 0; m1 < nm1p; m1++, m1nM += nM) {
-                complex double wphase = work_gm[gnm1 + m1] * phase;
-                for (int m2 = 0; m2 < nm2; m2++) {
-                  Vt_mm[m1nM + m2] += A2_gm[gnm2 + m2] * wphase;
-                }
-              }
-            }
+            // Contract the real factors over the grid strip with a
+            // single rank-nG update and apply the constant phase of
+            // this volume pair afterwards:
+            double one = 1.0;
+            double zero = 0.0;
+            dgemm_("n", "t", &nm2, &nm1p, &nG, &one,
+                   (double*)A2_gm, &nm2, work_gm, &nm1p, &zero,
+                   block_mm, &nm2);
+            int m1nM = 0;
+            for (int m1 = 0; m1 < nm1p; m1++, m1nM += nM)
+              for (int m2 = 0; m2 < nm2; m2++)
+                Vt_mm[m1nM + m2] += block_mm[m1 * nm2 + m2] * phase;
+            nflops += (2LL * nG + 4) * nm1p * nm2;
+            nbytes += 8LL * (nG * nm2 + 5 * nm1p * nm2);
           }
         }
       }
     }
     GRID_LOOP_STOP(lfc, k);
   }
+  if (gpaw_perf_enabled) {
+    gpaw_perf_stop(&lfc->perf, counters, tperf);
+    gpaw_perf_model(&lfc->perf, nbytes, nflops);
+  }
   Py_RETURN_NONE;
 }
 
+#ifdef GPAW_OMP_MONLY
+struct lfc_integrate_args
+{
+  LFCObject* lfc;
+  const void* a_xG;
+  void* c_xM;                    // output, or a private zeroed copy
+  int nx;
+  int nG;
+  int nM;
+  int q;
+  int xmode;                     // claim whole x indices, not chunks
+  LFVolume* volume_i;
+  double complex* phase_i;
+  int* i_W;
+  int* next;
+};
+
+static void* lfc_integrate_worker(void* args)
+{
+  struct lfc_integrate_args* arg = (struct lfc_integrate_args*)args;
+  LFCObject* lfc = arg->lfc;
+  double dv = lfc->dv;
+  int nchunks = lfc->nchunks;
+  if (!lfc->bloch_boundary_conditions) {
+    const double* a_xG = (const double*)arg->a_xG;
+    double* c_xM = (double*)arg->c_xM;
+    for (;;) {
+      int t = lfc_claim_chunk(arg->next);
+      int x, c0, c1;
+      if (arg->xmode) {
+        // One task per x: all rows written here belong to this task.
+        if (t >= arg->nx)
+          break;
+        x = t;
+        c0 = 0;
+        c1 = nchunks;
+      }
+      else {
+        // One task per (x, chunk) pair, accumulating into c_xM, which
+        // is a private copy for all threads but the first.
+        if (t >= arg->nx * nchunks)
+          break;
+        x = t / nchunks;
+        c0 = t % nchunks;
+        c1 = c0 + 1;
+      }
+      const double* a_G = a_xG + x * arg->nG;
+      double* c_M = c_xM + x * arg->nM;
+      for (int c = c0; c < c1; c++) {
+        GRID_LOOP_CHUNK_START(lfc, -1, c, arg->volume_i, NULL, arg->i_W) {
+          for (int i = 0; i < ni; i++) {
+            LFVolume* v = volume_i + i;
+            const double* A_gm = v->A_gm;
+            int nm = v->nm;
+            double* c_M1 = c_M + v->M;
+            for (int gm = 0, G = Ga; G < Gb; G++){
+              double av = a_G[G] * dv;
+              for (int m = 0; m < nm; m++, gm++){
+                c_M1[m] += av * A_gm[gm];
+              }
+            }
+          }
+        }
+        GRID_LOOP_CHUNK_STOP(lfc, -1);
+      }
+    }
+  }
+  else {
+    const complex double* a_xG = (const complex double*)arg->a_xG;
+    complex double* c_xM = (complex double*)arg->c_xM;
+    int q = arg->q;
+    for (;;) {
+      int t = lfc_claim_chunk(arg->next);
+      int x, c0, c1;
+      if (arg->xmode) {
+        if (t >= arg->nx)
+          break;
+        x = t;
+        c0 = 0;
+        c1 = nchunks;
+      }
+      else {
+        if (t >= arg->nx * nchunks)
+          break;
+        x = t / nchunks;
+        c0 = t % nchunks;
+        c1 = c0 + 1;
+      }
+      const complex double* a_G = a_xG + x * arg->nG;
+      complex double* c_M = c_xM + x * arg->nM;
+      for (int c = c0; c < c1; c++) {
+        GRID_LOOP_CHUNK_START(lfc, q, c, arg->volume_i, arg->phase_i,
+                              arg->i_W) {
+          for (int i = 0; i < ni; i++) {
+            LFVolume* v = volume_i + i;
+            int nm = v->nm;
+            complex double* c_M1 = c_M + v->M;
+            const double* A_gm = v->A_gm;
+            double complex vphase = phase_i[i] * dv;
+            for (int gm = 0, G = Ga; G < Gb; G++){
+              double complex avphase = a_G[G] * vphase;
+              for (int m = 0; m < nm; m++, gm++){
+                c_M1[m] += avphase * A_gm[gm];
+              }
+            }
+          }
+        }
+        GRID_LOOP_CHUNK_STOP(lfc, q);
+      }
+    }
+  }
+  return NULL;
+}
+#endif // GPAW_OMP_MONLY
+
 PyObject* integrate(LFCObject *lfc, PyObject *args)
 {
   const PyArrayObject* a_xG_obj;
@@ -285,7 +809,12 @@ PyObject* integrate(LFCObject *lfc, PyObject *args)
   int q;
 
   if (!PyArg_ParseTuple(args, "OOi", &a_xG_obj, &c_xM_obj, &q))
-    return NULL; 
+    return NULL;
+
+  long long counters[GPAW_PERF_NCOUNTERS];
+  double tperf = 0;
+  if (gpaw_perf_enabled)
+    gpaw_perf_start(counters, &tperf);
 
   int nd = a_xG_obj->nd;
   npy_intp* dims = a_xG_obj->dimensions;
@@ -294,6 +823,65 @@ PyObject* integrate(LFCObject *lfc, PyObject *args)
   int nM = c_xM_obj->dimensions[c_xM_obj->nd - 1];
   double dv = lfc->dv;
 
+#ifdef GPAW_OMP_MONLY
+  int nthds = gpaw_threadpool_size();
+  if ((long long)nthds > (long long)nx * lfc->nchunks)
+    nthds = nx * lfc->nchunks;
+  if (nthds > 1) {
+    // With enough functions a_xG, each thread takes whole x indices and
+    // owns the rows it writes.  Otherwise the (x, chunk) pairs are
+    // shared out and every thread but the first accumulates into a
+    // zeroed private copy of c_xM, summed below.
+    bool cplx = lfc->bloch_boundary_conditions;
+    int xmode = (nx >= nthds);
+    int csize = (cplx ? 2 : 1);
+    int next = 0;
+    struct lfc_integrate_args* arg_n = GPAW_MALLOC(struct lfc_integrate_args,
+                                                   nthds);
+    LFVolume* volume_ni = GPAW_MALLOC(LFVolume, nthds * lfc->nimax);
+    int* iW_nW = GPAW_MALLOC(int, nthds * lfc->nW);
+    double complex* phase_ni = NULL;
+    if (cplx)
+      phase_ni = GPAW_MALLOC(double complex, nthds * lfc->nimax);
+    double* priv = NULL;
+    if (!xmode) {
+      priv = GPAW_MALLOC(double, csize * (nthds - 1) * nx * nM);
+      memset(priv, 0, csize * (nthds - 1) * nx * nM * sizeof(double));
+    }
+    for (int n = 0; n < nthds; n++) {
+      struct lfc_integrate_args* arg = &arg_n[n];
+      arg->lfc = lfc;
+      arg->a_xG = a_xG_obj->data;
+      if (xmode || n == 0)
+        arg->c_xM = c_xM_obj->data;
+      else
+        arg->c_xM = priv + csize * (n - 1) * nx * nM;
+      arg->nx = nx;
+      arg->nG = nG;
+      arg->nM = nM;
+      arg->q = q;
+      arg->xmode = xmode;
+      arg->volume_i = volume_ni + n * lfc->nimax;
+      arg->phase_i = (cplx ? phase_ni + n * lfc->nimax : NULL);
+      arg->i_W = iW_nW + n * lfc->nW;
+      arg->next = &next;
+    }
+    gpaw_threadpool_run(lfc_integrate_worker, arg_n,
+                        sizeof(struct lfc_integrate_args), nthds);
+    if (priv != NULL) {
+      double* c_M = (double*)c_xM_obj->data;
+      for (int n = 1; n < nthds; n++)
+        for (int v = 0; v < csize * nx * nM; v++)
+          c_M[v] += priv[csize * (n - 1) * nx * nM + v];
+      free(priv);
+    }
+    free(phase_ni);
+    free(iW_nW);
+    free(volume_ni);
+    free(arg_n);
+  }
+  else
+#endif
   if (!lfc->bloch_boundary_conditions) {
     const double* a_G = (const double*)a_xG_obj->data;
     double* c_M = (double*)c_xM_obj->data;
@@ -341,9 +929,184 @@ PyObject* integrate(LFCObject *lfc, PyObject *args)
       a_G += nG;
     }
   }
+  if (gpaw_perf_enabled) {
+    gpaw_perf_stop(&lfc->perf, counters, tperf);
+    // Streaming model: one A_gm read and one multiply-add per (g, m)
+    // product, one grid read per covered point (doubled for complex):
+    long long cplx = lfc->bloch_boundary_conditions ? 2 : 1;
+    gpaw_perf_model(&lfc->perf,
+                    8 * nx * (lfc->ngmtotal + cplx * lfc->ngtotal),
+                    2 * cplx * nx * lfc->ngmtotal);
+  }
   Py_RETURN_NONE;
 }
 
+#ifdef GPAW_OMP_MONLY
+struct lfc_density_args
+{
+  LFCObject* lfc;
+  const double* rho_MM;          // real case
+  const double complex* rho_MMz; // Bloch case
+  double* nt_G;
+  int nM;
+  int k;
+  int Mstart;
+  int Mstop;
+  double* work_gm;
+  LFVolume* volume_i;
+  double complex* phase_i;
+  int* i_W;
+  int* next_chunk;
+  long long nflops;
+  long long nbytes;
+};
+
+// The grid points of different chunks are disjoint, so the threads can
+// add to nt_G without synchronization; only work_gm must be private.
+static void* lfc_density_worker(void* args)
+{
+  struct lfc_density_args* arg = (struct lfc_density_args*)args;
+  LFCObject* lfc = arg->lfc;
+  double* nt_G = arg->nt_G;
+  int nM = arg->nM;
+  int Mstart = arg->Mstart;
+  int Mstop = arg->Mstop;
+  double* work_gm = arg->work_gm;
+  long long nflops = 0;
+  long long nbytes = 0;
+  if (arg->rho_MM != NULL) {
+    const double* rho_MM = arg->rho_MM;
+    for (;;) {
+      int c = lfc_claim_chunk(arg->next_chunk);
+      if (c >= lfc->nchunks)
+        break;
+      GRID_LOOP_CHUNK_START(lfc, -1, c, arg->volume_i, NULL, arg->i_W) {
+        for (int i1 = 0; i1 < ni; i1++) {
+          LFVolume* v1 = volume_i + i1;
+          int M1 = v1->M;
+          int nm1 = v1->nm;
+
+          int M1p = MAX(M1, Mstart);
+          int nm1p = MIN(M1 + nm1, Mstop) - M1p;
+          if (nm1p <= 0)
+            continue;
+
+          memset(work_gm, 0, nG * nm1 * sizeof(double));
+          double factor = 1.0;
+
+          int m1start = MAX(0, Mstart - M1);
+
+          double one = 1.0;
+          for (int i2 = i1; i2 < ni; i2++) {
+            LFVolume* v2 = volume_i + i2;
+            int M2 = v2->M;
+            int nm2 = v2->nm;
+            const double* rho_mm = rho_MM + (M1p - Mstart) * nM + M2;
+            dgemm_("t", "n", &nm1p, &nG, &nm2, &factor,
+                   (double*)rho_mm, &nM,
+                   (double*)v2->A_gm, &nm2, &one,
+                   work_gm + m1start, &nm1);
+            factor = 2.0;
+            nflops += 2LL * nm1p * nG * nm2;
+            nbytes += 8LL * (nG * nm2 + nm1p * nm2);
+          }
+          int gm1 = 0;
+          for (int G = Ga; G < Gb; G++) {
+            double nt = 0.0;
+            for (int m1 = 0; m1 < nm1; m1++, gm1++) {
+              nt += v1->A_gm[gm1] * work_gm[gm1];
+            }
+            nt_G[G] += nt;
+          }
+          nflops += 2LL * nG * nm1;
+          nbytes += 8LL * nG * (nm1 + 2);
+        }
+      }
+      GRID_LOOP_CHUNK_STOP(lfc, -1);
+    }
+  }
+  else {
+    const double complex* rho_MM = arg->rho_MMz;
+    int k = arg->k;
+    for (;;) {
+      int c = lfc_claim_chunk(arg->next_chunk);
+      if (c >= lfc->nchunks)
+        break;
+      GRID_LOOP_CHUNK_START(lfc, k, c, arg->volume_i, arg->phase_i,
+                            arg->i_W) {
+        for (int i1 = 0; i1 < ni; i1++) {
+          LFVolume* v1 = volume_i + i1;
+          int M1 = v1->M;
+          int nm1 = v1->nm;
+
+          int M1p = MAX(M1, Mstart);
+          int nm1p = MIN(M1 + nm1, Mstop) - M1p;
+          if (nm1p <= 0)
+            continue;
+
+          memset(work_gm, 0, nG * nm1 * sizeof(double));
+          double complex factor = 1.0;
+
+          int m1end = MIN(nm1, Mstop - M1);
+          int m1start = MAX(0, Mstart - M1);
+
+          for (int i2 = i1; i2 < ni; i2++) {
+            if (i2 > i1)
+              factor = 2.0 * phase_i[i1] * conj(phase_i[i2]);
+
+            double rfactor = creal(factor);
+            double ifactor = cimag(factor);
+
+            LFVolume* v2 = volume_i + i2;
+            const double* A2_gm = v2->A_gm;
+            int M2 = v2->M;
+            int nm2 = v2->nm;
+            const double complex* rho_mm = rho_MM + (M1p - Mstart) * nM + M2;
+            double rrho, irho, rwork, iwork;
+            complex double rho;
+            for (int g = 0; g < nG; g++) {
+              int gnm1 = g * nm1;
+              int gnm2 = g * nm2;
+              int m1pnM = 0;
+              for (int m1 = m1start, m1p=0; m1 < m1end; m1++, m1p++) {
+                m1pnM = m1p * nM;
+                iwork = 0;
+                rwork = 0;
+                for (int m2 = 0; m2 < nm2; m2++) {
+                  rho = rho_mm[m1pnM + m2];
+                  rrho = creal(rho);
+                  irho = cimag(rho);
+                  rwork += A2_gm[gnm2 + m2] * rrho;
+                  iwork += A2_gm[gnm2 + m2] * irho;
+                }
+                work_gm[m1 + gnm1] += rwork * rfactor - iwork * ifactor;
+              }
+            }
+            nflops += 6LL * nG * (m1end - m1start) * nm2;
+            nbytes += 8LL * (nG * nm2 + 2 * nm1p * nm2);
+          }
+          int gm1 = 0;
+          const double* A1_gm = v1->A_gm;
+          for (int G = Ga; G < Gb; G++) {
+            double nt = 0.0;
+            for (int m1 = 0; m1 < nm1; m1++, gm1++) {
+              nt += A1_gm[gm1] * work_gm[gm1];
+            }
+            nt_G[G] += nt;
+          }
+          nflops += 2LL * nG * nm1;
+          nbytes += 8LL * nG * (nm1 + 2);
+        }
+      }
+      GRID_LOOP_CHUNK_STOP(lfc, k);
+    }
+  }
+  arg->nflops = nflops;
+  arg->nbytes = nbytes;
+  return NULL;
+}
+#endif // GPAW_OMP_MONLY
+
 PyObject* construct_density(LFCObject *lfc, PyObject *args)
 {
   const PyArrayObject* rho_MM_obj;
@@ -353,14 +1116,75 @@ PyObject* construct_density(LFCObject *lfc, PyObject *args)
 
   if (!PyArg_ParseTuple(args, "OOiii", &rho_MM_obj, &nt_G_obj, &k,
                         &Mstart, &Mstop))
-    return NULL; 
-  
+    return NULL;
+
+  long long counters[GPAW_PERF_NCOUNTERS];
+  double tperf = 0;
+  long long nbytes = 0;
+  long long nflops = 0;
+  if (gpaw_perf_enabled)
+    gpaw_perf_start(counters, &tperf);
+
   double* nt_G = (double*)nt_G_obj->data;
   
   int nM = rho_MM_obj->dimensions[1];
   
   double* work_gm = lfc->work_gm;
 
+#ifdef GPAW_OMP_MONLY
+  int nthds = gpaw_threadpool_size();
+  if (nthds > lfc->nchunks)
+    nthds = lfc->nchunks;
+  if (nthds > 1) {
+    bool cplx = lfc->bloch_boundary_conditions;
+    int ngm = lfc->ngmax * lfc->nmmax;
+    int next_chunk = 0;
+    struct lfc_density_args* arg_n = GPAW_MALLOC(struct lfc_density_args,
+                                                 nthds);
+    double* work_ngm = GPAW_MALLOC(double, nthds * ngm);
+    LFVolume* volume_ni = GPAW_MALLOC(LFVolume, nthds * lfc->nimax);
+    int* iW_nW = GPAW_MALLOC(int, nthds * lfc->nW);
+    double complex* phase_ni = NULL;
+    if (cplx)
+      phase_ni = GPAW_MALLOC(double complex, nthds * lfc->nimax);
+    for (int n = 0; n < nthds; n++) {
+      struct lfc_density_args* arg = &arg_n[n];
+      arg->lfc = lfc;
+      if (cplx) {
+        arg->rho_MM = NULL;
+        arg->rho_MMz = (const double complex*)rho_MM_obj->data;
+      }
+      else {
+        arg->rho_MM = (const double*)rho_MM_obj->data;
+        arg->rho_MMz = NULL;
+      }
+      arg->nt_G = nt_G;
+      arg->nM = nM;
+      arg->k = k;
+      arg->Mstart = Mstart;
+      arg->Mstop = Mstop;
+      arg->work_gm = work_ngm + n * ngm;
+      arg->volume_i = volume_ni + n * lfc->nimax;
+      arg->phase_i = (cplx ? phase_ni + n * lfc->nimax : NULL);
+      arg->i_W = iW_nW + n * lfc->nW;
+      arg->next_chunk = &next_chunk;
+      arg->nflops = 0;
+      arg->nbytes = 0;
+    }
+    gpaw_threadpool_run(lfc_density_worker, arg_n,
+                        sizeof(struct lfc_density_args), nthds);
+    for (int n = 0; n < nthds; n++) {
+      nflops += arg_n[n].nflops;
+      nbytes += arg_n[n].nbytes;
+    }
+    free(phase_ni);
+    free(iW_nW);
+    free(volume_ni);
+    free(work_ngm);
+    free(arg_n);
+  }
+  else
+#endif
   if (!lfc->bloch_boundary_conditions) {
     const double* rho_MM = (const double*)rho_MM_obj->data;
     GRID_LOOP_START(lfc, -1) {
@@ -377,25 +1201,25 @@ PyObject* construct_density(LFCObject *lfc, PyObject *args)
         memset(work_gm, 0, nG * nm1 * sizeof(double));
         double factor = 1.0;
 
-        int m1end = MIN(nm1, Mstop - M1);
         int m1start = MAX(0, Mstart - M1);
 
+        double one = 1.0;
         for (int i2 = i1; i2 < ni; i2++) {
           LFVolume* v2 = volume_i + i2;
           int M2 = v2->M;
           int nm2 = v2->nm;
           const double* rho_mm = rho_MM + (M1p - Mstart) * nM + M2;
           //assert(M1 - Mstart + m1start >= 0);
-          for (int g = 0; g < nG; g++) {
-            for (int m1 = m1start, m1p = 0; m1 < m1end; m1++, m1p++) {
-              for (int m2 = 0; m2 < nm2; m2++) {
-                work_gm[g * nm1 + m1] += (v2->A_gm[g * nm2 + m2] * 
-                                          rho_mm[m1p * nM + m2] *
-                                          factor);
-              }
-            }
-          }
+          // work_gm(g, m1) += factor * rho_mm(m1, m2) * A_gm(g, m2)
+          // as a single matrix multiply over the contiguous function
+          // values (column-major dgemm on the transposed matrices):
+          dgemm_("t", "n", &nm1p, &nG, &nm2, &factor,
+                 (double*)rho_mm, &nM,
+                 (double*)v2->A_gm, &nm2, &one,
+                 work_gm + m1start, &nm1);
           factor = 2.0;
+          nflops += 2LL * nm1p * nG * nm2;
+          nbytes += 8LL * (nG * nm2 + nm1p * nm2);
         }
         int gm1 = 0;
         for (int G = Ga; G < Gb; G++) {
@@ -405,6 +1229,8 @@ PyObject* construct_density(LFCObject *lfc, PyObject *args)
           }
           nt_G[G] += nt;
         }
+        nflops += 2LL * nG * nm1;
+        nbytes += 8LL * nG * (nm1 + 2);
       }
     }
     GRID_LOOP_STOP(lfc, -1);
@@ -465,6 +1291,8 @@ PyObject* construct_density(LFCObject *lfc, PyObject *args)
               work_gm[m1 + gnm1] += rwork * rfactor - iwork * ifactor;
             }
           }
+          nflops += 6LL * nG * (m1end - m1start) * nm2;
+          nbytes += 8LL * (nG * nm2 + 2 * nm1p * nm2);
         }
         int gm1 = 0;
         const double* A1_gm = v1->A_gm;
@@ -475,10 +1303,16 @@ PyObject* construct_density(LFCObject *lfc, PyObject *args)
           }
           nt_G[G] += nt;
         }
+        nflops += 2LL * nG * nm1;
+        nbytes += 8LL * nG * (nm1 + 2);
       }
     }
     GRID_LOOP_STOP(lfc, k);
   }
+  if (gpaw_perf_enabled) {
+    gpaw_perf_stop(&lfc->perf, counters, tperf);
+    gpaw_perf_model(&lfc->perf, nbytes, nflops);
+  }
   Py_RETURN_NONE;
 }
 
@@ -551,18 +1385,32 @@ PyObject* lcao_to_grid(LFCObject *lfc, PyObject *args)
   else {
     const double complex* c_M = (const double complex*)c_M_obj->data;
     double complex* psit_G = (double complex*)psit_G_obj->data;
+    // Fold the cached phase factor into the coefficients once per
+    // volume and split them into real and imaginary parts, so that the
+    // accumulation over the grid runs on plain contiguous double
+    // arrays that the compiler can vectorize:
+    double* cre_m = lfc_scratch(lfc, 2 * lfc->nmmax);
+    double* cim_m = cre_m + lfc->nmmax;
     GRID_LOOP_START(lfc, k) {
       for (int i = 0; i < ni; i++) {
         LFVolume* v = volume_i + i;
-        double complex conjphase = conj(phase_i[i]);
+        int nm = v->nm;
+        double complex conjphase = lfc->conjphase_kW[k * lfc->nW + v->W];
         const double* A_gm = v->A_gm;
         const double complex* c_M1 = c_M + v->M;
-        for (int gm = 0, G = Ga; G < Gb; G++) {
-          double complex psit = 0.0;
-          for (int m = 0; m < v->nm; m++, gm++) {
-            psit += A_gm[gm] * c_M1[m];
+        for (int m = 0; m < nm; m++) {
+          double complex c = c_M1[m] * conjphase;
+          cre_m[m] = creal(c);
+          cim_m[m] = cimag(c);
+        }
+        for (int gm = 0, G = Ga; G < Gb; G++, gm += nm) {
+          double re = 0.0;
+          double im = 0.0;
+          for (int m = 0; m < nm; m++) {
+            re += A_gm[gm + m] * cre_m[m];
+            im += A_gm[gm + m] * cim_m[m];
           }
-          psit_G[G] += psit * conjphase;
+          psit_G[G] += re + I * im;
         }
       }
     }
@@ -578,7 +1426,12 @@ PyObject* add(LFCObject *lfc, PyObject *args)
   int q;
 
   if (!PyArg_ParseTuple(args, "OOi", &c_xM_obj, &a_xG_obj, &q))
-    return NULL; 
+    return NULL;
+
+  long long counters[GPAW_PERF_NCOUNTERS];
+  double tperf = 0;
+  if (gpaw_perf_enabled)
+    gpaw_perf_start(counters, &tperf);
 
   int nd = a_xG_obj->nd;
   npy_intp* dims = a_xG_obj->dimensions;
@@ -629,54 +1482,181 @@ PyObject* add(LFCObject *lfc, PyObject *args)
       a_G += nG;
     }
   }
+  if (gpaw_perf_enabled) {
+    gpaw_perf_stop(&lfc->perf, counters, tperf);
+    // Streaming model: one A_gm read and one multiply-add per (g, m)
+    // product, one grid read and write per covered point:
+    long long cplx = lfc->bloch_boundary_conditions ? 2 : 1;
+    gpaw_perf_model(&lfc->perf,
+                    8 * nx * (lfc->ngmtotal + 2 * cplx * lfc->ngtotal),
+                    2 * cplx * nx * lfc->ngmtotal);
+  }
   Py_RETURN_NONE;
 }
 
-PyObject* spline_to_grid(PyObject *self, PyObject *args)
+/* Block-diagonal transform of the coefficients followed by add() in
+ * one call.  ni_b holds the block sizes in c_xM order and dO_p the
+ * matching real ni x ni matrices (e.g. the PAW overlap corrections
+ * dO^a_ij) packed one after the other:
+ *
+ *   c_xM[..., M1 + i] <- sum_j c_xM[..., M1 + j] dO_ji  (in place),
+ *   a_xG += sum_M c_xM Phi_M
+ *
+ * so that applying an overlap-like operator needs no per-atom Python
+ * pass between integrate() and add(). */
+PyObject* transform_add(LFCObject *lfc, PyObject *args)
 {
-  const SplineObject* spline_obj;
-  PyArrayObject* beg_c_obj;
-  PyArrayObject* end_c_obj;
-  PyArrayObject* pos_v_obj;
-  PyArrayObject* h_cv_obj;
-  PyArrayObject* n_c_obj;
-  PyArrayObject* gdcorner_c_obj;
-  if (!PyArg_ParseTuple(args, "OOOOOOO", &spline_obj,
-                        &beg_c_obj, &end_c_obj, &pos_v_obj, &h_cv_obj,
-                        &n_c_obj, &gdcorner_c_obj))
-    return NULL; 
-
-  const bmgsspline* spline = (const bmgsspline*)(&(spline_obj->spline));
-  long* beg_c = LONGP(beg_c_obj);
-  long* end_c = LONGP(end_c_obj);
-  double* pos_v = DOUBLEP(pos_v_obj);
-  double* h_cv = DOUBLEP(h_cv_obj);
-  long* n_c = LONGP(n_c_obj);
-  long* gdcorner_c = LONGP(gdcorner_c_obj);
+  PyArrayObject* c_xM_obj;
+  PyArrayObject* a_xG_obj;
+  const PyArrayObject* ni_b_obj;
+  const PyArrayObject* dO_obj;
+  int q;
 
-  int l = spline_obj->spline.l;
-  int nm = 2 * l + 1;
-  double rcut = spline->dr * spline->nbins;
+  if (!PyArg_ParseTuple(args, "OOOOi", &c_xM_obj, &a_xG_obj,
+                        &ni_b_obj, &dO_obj, &q))
+    return NULL;
 
-  int ngmax = ((end_c[0] - beg_c[0]) *
-               (end_c[1] - beg_c[1]) *
-               (end_c[2] - beg_c[2]));
-  double* A_gm = GPAW_MALLOC(double, ngmax * nm);
-  
-  int nBmax = ((end_c[0] - beg_c[0]) *
-               (end_c[1] - beg_c[1]));
-  int* G_B = GPAW_MALLOC(int, 2 * nBmax);
+  int nd = a_xG_obj->nd;
+  npy_intp* dims = a_xG_obj->dimensions;
+  int nx = PyArray_MultiplyList(dims, nd - 3);
+  int nG = PyArray_MultiplyList(dims + nd - 3, 3);
+  int nM = c_xM_obj->dimensions[c_xM_obj->nd - 1];
+
+  int nb = ni_b_obj->dimensions[0];
+  const long* ni_b = LONGP(ni_b_obj);
+  const double* dO_p = DOUBLEP(dO_obj);
+
+  int nimax = 0;
+  for (int b = 0; b < nb; b++)
+    if (ni_b[b] > nimax)
+      nimax = ni_b[b];
+
+  if (!lfc->bloch_boundary_conditions) {
+    double* c_M = (double*)c_xM_obj->data;
+    double* a_G = (double*)a_xG_obj->data;
+    double* t_i = lfc_scratch(lfc, nimax);
+    for (int x = 0; x < nx; x++) {
+      const double* dO_ii = dO_p;
+      double* c_M1 = c_M;
+      for (int b = 0; b < nb; b++) {
+        int ni = ni_b[b];
+        for (int i = 0; i < ni; i++) {
+          double t = 0.0;
+          for (int j = 0; j < ni; j++)
+            t += c_M1[j] * dO_ii[j * ni + i];
+          t_i[i] = t;
+        }
+        for (int i = 0; i < ni; i++)
+          c_M1[i] = t_i[i];
+        c_M1 += ni;
+        dO_ii += ni * ni;
+      }
+      GRID_LOOP_START(lfc, -1) {
+        for (int i = 0; i < ni; i++) {
+          LFVolume* v = volume_i + i;
+          for (int gm = 0, G = Ga; G < Gb; G++) {
+            for (int m = 0; m < v->nm; m++, gm++) {
+              a_G[G] += v->A_gm[gm] * c_M[v->M + m];
+            }
+          }
+        }
+      }
+      GRID_LOOP_STOP(lfc, -1);
+      c_M += nM;
+      a_G += nG;
+    }
+  }
+  else {
+    double complex* c_M = (double complex*)c_xM_obj->data;
+    double complex* a_G = (double complex*)a_xG_obj->data;
+    double complex* t_i = (double complex*)lfc_scratch(lfc, 2 * nimax);
+    for (int x = 0; x < nx; x++) {
+      const double* dO_ii = dO_p;
+      double complex* c_M1 = c_M;
+      for (int b = 0; b < nb; b++) {
+        int ni = ni_b[b];
+        for (int i = 0; i < ni; i++) {
+          double complex t = 0.0;
+          for (int j = 0; j < ni; j++)
+            t += c_M1[j] * dO_ii[j * ni + i];
+          t_i[i] = t;
+        }
+        for (int i = 0; i < ni; i++)
+          c_M1[i] = t_i[i];
+        c_M1 += ni;
+        dO_ii += ni * ni;
+      }
+      GRID_LOOP_START(lfc, q) {
+        for (int i = 0; i < ni; i++) {
+          double complex conjphase = conj(phase_i[i]);
+          LFVolume* v = volume_i + i;
+          const double complex* c_M2 = c_M + v->M;
+          const double* A_gm = v->A_gm;
+          for (int gm = 0, G = Ga; G < Gb; G++) {
+            double complex a = 0.0;
+            for (int m = 0; m < v->nm; m++, gm++) {
+              a += A_gm[gm] * c_M2[m];
+            }
+            a_G[G] += a * conjphase;
+          }
+        }
+      }
+      GRID_LOOP_STOP(lfc, q);
+      c_M += nM;
+      a_G += nG;
+    }
+  }
+  Py_RETURN_NONE;
+}
+
+// One task of the threaded rasterization: a contiguous slab
+// [g0a, g0b) of the outer loop of spline_to_grid, writing into its own
+// section of the output arrays.
+struct stg_args
+{
+  const bmgsspline* spline;
+  int l;
+  double rcut;
+  const double* pos_v;
+  const double* h_cv;
+  const long* n_c;
+  const long* beg_c;
+  const long* end_c;
+  const long* gdcorner_c;
+  long g0a;
+  long g0b;
+  double* A_gm;  // output: function values for this slab
+  int* G_B;      // output: boundary grid points for this slab
+  int ngm;       // output: number of values written
+  int nB;        // output: number of boundary points written
+};
+
+static void* spline_to_grid_worker(void* vargs)
+{
+  struct stg_args* wargs = (struct stg_args*)vargs;
+  const bmgsspline* spline = wargs->spline;
+  int l = wargs->l;
+  int nm = 2 * l + 1;
+  double rcut = wargs->rcut;
+  const double* pos_v = wargs->pos_v;
+  const double* h_cv = wargs->h_cv;
+  const long* n_c = wargs->n_c;
+  const long* beg_c = wargs->beg_c;
+  const long* end_c = wargs->end_c;
+  const long* gdcorner_c = wargs->gdcorner_c;
+  double* A_gm = wargs->A_gm;
+  int* G_B = wargs->G_B;
 
   int nB = 0;
   int ngm = 0;
-  int G = -gdcorner_c[2] + n_c[2] * (beg_c[1] - gdcorner_c[1] + n_c[1] 
-                    * (beg_c[0] - gdcorner_c[0]));
+  int G = -gdcorner_c[2] + n_c[2] * (beg_c[1] - gdcorner_c[1] + n_c[1]
+                    * (wargs->g0a - gdcorner_c[0]));
 
-  for (int g0 = beg_c[0]; g0 < end_c[0]; g0++) {
-    for (int g1 = beg_c[1]; g1 < end_c[1]; g1++) {
+  for (long g0 = wargs->g0a; g0 < wargs->g0b; g0++) {
+    for (long g1 = beg_c[1]; g1 < end_c[1]; g1++) {
       int g2_beg = -1; // function boundary coordinates
       int g2_end = -1;
-      for (int g2 = beg_c[2]; g2 < end_c[2]; g2++) {
+      for (long g2 = beg_c[2]; g2 < end_c[2]; g2++) {
         double x = h_cv[0] * g0 + h_cv[3] * g1 + h_cv[6] * g2 - pos_v[0];
         double y = h_cv[1] * g0 + h_cv[4] * g1 + h_cv[7] * g2 - pos_v[1];
         double z = h_cv[2] * g0 + h_cv[5] * g1 + h_cv[8] * g2 - pos_v[2];
@@ -688,9 +1668,9 @@ PyObject* spline_to_grid(PyObject *self, PyObject *args)
           g2_end = g2;
           double A = bmgs_splinevalue(spline, r);
           double* p = A_gm + ngm;
-          
+
           spherical_harmonics(l, A, x, y, z, r2, p);
-          
+
           ngm += nm;
         }
       }
@@ -703,18 +1683,106 @@ PyObject* spline_to_grid(PyObject *self, PyObject *args)
     }
     G += n_c[2] * (n_c[1] - end_c[1] + beg_c[1]);
   }
-  npy_intp gm_dims[2] = {ngm / (2 * l + 1), 2 * l + 1};
-  PyArrayObject* A_gm_obj = (PyArrayObject*)PyArray_SimpleNew(2, gm_dims, 
+  wargs->ngm = ngm;
+  wargs->nB = nB;
+  return NULL;
+}
+
+PyObject* spline_to_grid(PyObject *self, PyObject *args)
+{
+  const SplineObject* spline_obj;
+  PyArrayObject* beg_c_obj;
+  PyArrayObject* end_c_obj;
+  PyArrayObject* pos_v_obj;
+  PyArrayObject* h_cv_obj;
+  PyArrayObject* n_c_obj;
+  PyArrayObject* gdcorner_c_obj;
+  if (!PyArg_ParseTuple(args, "OOOOOOO", &spline_obj,
+                        &beg_c_obj, &end_c_obj, &pos_v_obj, &h_cv_obj,
+                        &n_c_obj, &gdcorner_c_obj))
+    return NULL; 
+
+  const bmgsspline* spline = (const bmgsspline*)(&(spline_obj->spline));
+  long* beg_c = LONGP(beg_c_obj);
+  long* end_c = LONGP(end_c_obj);
+  double* pos_v = DOUBLEP(pos_v_obj);
+  double* h_cv = DOUBLEP(h_cv_obj);
+  long* n_c = LONGP(n_c_obj);
+  long* gdcorner_c = LONGP(gdcorner_c_obj);
+
+  int l = spline_obj->spline.l;
+  int nm = 2 * l + 1;
+  double rcut = spline->dr * spline->nbins;
+
+  int nyz = (end_c[1] - beg_c[1]) * (end_c[2] - beg_c[2]);
+  long nslab = end_c[0] - beg_c[0];
+  int ngmax = nslab * nyz;
+  double* A_gm = GPAW_MALLOC(double, ngmax * nm);
+
+  int nBmax = nslab * (end_c[1] - beg_c[1]);
+  int* G_B = GPAW_MALLOC(int, 2 * nBmax);
+
+  // Rasterize the box in slabs of the outer grid index, one task per
+  // worker thread; each task fills its own section of the output
+  // arrays and the used parts are compacted afterwards:
+  int nthds = 1;
+#ifdef GPAW_OMP_MONLY
+  nthds = gpaw_threadpool_size();
+  if (nthds > nslab)
+    nthds = (nslab > 0) ? nslab : 1;
+#endif
+  struct stg_args* wargs = GPAW_MALLOC(struct stg_args, nthds);
+  long g0 = beg_c[0];
+  for (int thd = 0; thd < nthds; thd++) {
+    struct stg_args* arg = wargs + thd;
+    arg->spline = spline;
+    arg->l = l;
+    arg->rcut = rcut;
+    arg->pos_v = pos_v;
+    arg->h_cv = h_cv;
+    arg->n_c = n_c;
+    arg->beg_c = beg_c;
+    arg->end_c = end_c;
+    arg->gdcorner_c = gdcorner_c;
+    arg->g0a = g0;
+    g0 += nslab / nthds + (thd < nslab % nthds ? 1 : 0);
+    arg->g0b = g0;
+    arg->A_gm = A_gm + (arg->g0a - beg_c[0]) * nyz * nm;
+    arg->G_B = G_B + 2 * (arg->g0a - beg_c[0]) * (end_c[1] - beg_c[1]);
+  }
+#ifdef GPAW_OMP_MONLY
+  gpaw_threadpool_run(spline_to_grid_worker, wargs,
+                      sizeof(struct stg_args), nthds);
+#else
+  spline_to_grid_worker(wargs);
+#endif
+
+  int ngm = 0;
+  int nB = 0;
+  for (int thd = 0; thd < nthds; thd++) {
+    ngm += wargs[thd].ngm;
+    nB += wargs[thd].nB;
+  }
+  npy_intp gm_dims[2] = {ngm / nm, nm};
+  PyArrayObject* A_gm_obj = (PyArrayObject*)PyArray_SimpleNew(2, gm_dims,
                                                               NPY_DOUBLE);
-  
-  memcpy(A_gm_obj->data, A_gm, ngm * sizeof(double));
+  double* A_out = (double*)A_gm_obj->data;
+  for (int thd = 0; thd < nthds; thd++) {
+    memcpy(A_out, wargs[thd].A_gm, wargs[thd].ngm * sizeof(double));
+    A_out += wargs[thd].ngm;
+  }
   free(A_gm);
-  
+
   npy_intp B_dims[1] = {nB};
   PyArrayObject* G_B_obj = (PyArrayObject*)PyArray_SimpleNew(1, B_dims,
                                                              NPY_INT);
-  memcpy(G_B_obj->data, G_B, nB * sizeof(int));
+  int* B_out = (int*)G_B_obj->data;
+  for (int thd = 0; thd < nthds; thd++) {
+    memcpy(B_out, wargs[thd].G_B, wargs[thd].nB * sizeof(int));
+    B_out += wargs[thd].nB;
+  }
   free(G_B);
+  free(wargs);
 
   // PyObjects created in the C code will be initialized with a refcount
   // of 1, for which reason we'll have to decref them when done here
@@ -955,6 +2023,211 @@ PyObject* calculate_potential_matrix_derivative(LFCObject *lfc, PyObject *args)
   Py_RETURN_NONE;
 }
 
+// Fused version of calculate_potential_matrix_derivative: all three
+// Cartesian components in one traversal of the grid.  The distances,
+// spline values and radial derivatives of the row functions are
+// computed once per grid point and shared between the components, and
+// the contractions with the column functions run as rank-nG updates
+// like in calculate_potential_matrix.
+PyObject* calculate_potential_matrix_derivatives(LFCObject *lfc,
+                                                 PyObject *args)
+{
+  const PyArrayObject* vt_G_obj;
+  PyArrayObject* DVt_vMM_obj;
+  PyArrayObject* h_cv_obj;
+  PyArrayObject* n_c_obj;
+  int k;
+  PyArrayObject* spline_obj_M_obj;
+  PyArrayObject* beg_c_obj;
+  PyArrayObject* pos_Wc_obj;
+  int Mstart, Mstop;
+
+  if (!PyArg_ParseTuple(args, "OOOOiOOOii", &vt_G_obj, &DVt_vMM_obj,
+                        &h_cv_obj, &n_c_obj, &k,
+                        &spline_obj_M_obj, &beg_c_obj,
+                        &pos_Wc_obj, &Mstart, &Mstop))
+    return NULL;
+
+  const double* vt_G = (const double*)vt_G_obj->data;
+  const double* h_cv = (const double*)h_cv_obj->data;
+  const long* n_c = (const long*)n_c_obj->data;
+  const SplineObject** spline_obj_M = \
+    (const SplineObject**)spline_obj_M_obj->data;
+  const double (*pos_Wc)[3] = (const double (*)[3])pos_Wc_obj->data;
+
+  long* beg_c = LONGP(beg_c_obj);
+  int nM = DVt_vMM_obj->dimensions[2];
+  int nvMM = DVt_vMM_obj->dimensions[1] * nM;  // component stride
+  double dv = lfc->dv;
+
+  // One (nG, nm1p) work matrix per component plus a block buffer for
+  // the phase multiplication in the k-point branch:
+  int ngm = lfc->ngmax * lfc->nmmax;
+  double* work_vgm = lfc_scratch(lfc, 3 * ngm + lfc->nmmax * lfc->nmmax);
+  double* block_mm = work_vgm + 3 * ngm;
+
+  if (!lfc->bloch_boundary_conditions) {
+    double* DVt_vMM = (double*)DVt_vMM_obj->data;
+    GRID_LOOP_START(lfc, -1) {
+      // In one grid loop iteration, only z changes.
+      int iza = Ga % n_c[2] + beg_c[2];
+      int iy = (Ga / n_c[2]) % n_c[1] + beg_c[1];
+      int ix = Ga / (n_c[2] * n_c[1]) + beg_c[0];
+
+      for (int i1 = 0; i1 < ni; i1++) {
+        int iz = iza;
+        LFVolume* v1 = volume_i + i1;
+        int M1 = v1->M;
+        const SplineObject* spline_obj = spline_obj_M[M1];
+        const bmgsspline* spline = \
+          (const bmgsspline*)(&(spline_obj->spline));
+
+        int nm1 = v1->nm;
+
+        int M1p = MAX(M1, Mstart);
+        int nm1p = MIN(M1 + nm1, Mstop) - M1p;
+        if (nm1p <= 0)
+          continue;
+
+        double fdYdv_vm[3][nm1];
+        double rlYdfdr_m[nm1];
+        double f, dfdr;
+        int l = (nm1 - 1) / 2;
+        const double* pos_c = pos_Wc[v1->W];
+        int gm1 = 0;
+        for (int G = Ga; G < Gb; G++, iz++) {
+          double x = h_cv[0] * ix + h_cv[3] * iy + h_cv[6] * iz - pos_c[0];
+          double y = h_cv[1] * ix + h_cv[4] * iy + h_cv[7] * iz - pos_c[1];
+          double z = h_cv[2] * ix + h_cv[5] * iy + h_cv[8] * iz - pos_c[2];
+          double vtdv = vt_G[G] * dv;
+
+          double R_v[] = {x, y, z};
+
+          double r2 = x * x + y * y + z * z;
+          double r = sqrt(r2);
+
+          bmgs_get_value_and_derivative(spline, r, &f, &dfdr);
+
+          spherical_harmonics_derivative_x(l, f, x, y, z, r2, fdYdv_vm[0]);
+          spherical_harmonics_derivative_y(l, f, x, y, z, r2, fdYdv_vm[1]);
+          spherical_harmonics_derivative_z(l, f, x, y, z, r2, fdYdv_vm[2]);
+          if (r > 1e-15)
+            spherical_harmonics(l, dfdr / r, x, y, z, r2, rlYdfdr_m);
+          else
+            for (int m = 0; m < nm1; m++)
+              rlYdfdr_m[m] = 0.0;
+
+          int m1start = M1 < Mstart ? nm1 - nm1p : 0;
+          for (int m1 = 0; m1 < nm1p; m1++, gm1++) {
+            double rlYdfdr = rlYdfdr_m[m1 + m1start];
+            for (int v = 0; v < 3; v++)
+              work_vgm[v * ngm + gm1] = vtdv * (fdYdv_vm[v][m1 + m1start]
+                                                + rlYdfdr * R_v[v]);
+          }
+        } // end loop over G
+        for (int i2 = 0; i2 < ni; i2++) {
+          LFVolume* v2 = volume_i + i2;
+          int nm2 = v2->nm;
+          const double* A2_gm = v2->A_gm;
+          double* DVt_mm = DVt_vMM + (M1p - Mstart) * nM + v2->M;
+          double one = 1.0;
+          // DVt_mm(m1, m2) += work_vgm(v, g, m1) * A2_gm(g, m2) as one
+          // rank-nG update per component:
+          for (int v = 0; v < 3; v++)
+            dgemm_("n", "t", &nm2, &nm1p, &nG, &one,
+                   (double*)A2_gm, &nm2, work_vgm + v * ngm, &nm1p, &one,
+                   DVt_mm + v * nvMM, &nM);
+        } // i2 loop
+      } // i1 loop
+    }
+    GRID_LOOP_STOP(lfc, -1);
+  }
+  else {
+    complex double* DVt_vMM = (complex double*)DVt_vMM_obj->data;
+    GRID_LOOP_START(lfc, k) {
+      // In one grid loop iteration, only z changes.
+      int iza = Ga % n_c[2] + beg_c[2];
+      int iy = (Ga / n_c[2]) % n_c[1] + beg_c[1];
+      int ix = Ga / (n_c[2] * n_c[1]) + beg_c[0];
+
+      for (int i1 = 0; i1 < ni; i1++) {
+        int iz = iza;
+        LFVolume* v1 = volume_i + i1;
+        int M1 = v1->M;
+        const SplineObject* spline_obj = spline_obj_M[M1];
+        const bmgsspline* spline = \
+          (const bmgsspline*)(&(spline_obj->spline));
+
+        int nm1 = v1->nm;
+
+        int M1p = MAX(M1, Mstart);
+        int nm1p = MIN(M1 + nm1, Mstop) - M1p;
+        if (nm1p <= 0)
+          continue;
+
+        double fdYdv_vm[3][nm1];
+        double rlYdfdr_m[nm1];
+        double f, dfdr;
+        int l = (nm1 - 1) / 2;
+        const double* pos_c = pos_Wc[v1->W];
+        int gm1 = 0;
+        for (int G = Ga; G < Gb; G++, iz++) {
+          double x = h_cv[0] * ix + h_cv[3] * iy + h_cv[6] * iz - pos_c[0];
+          double y = h_cv[1] * ix + h_cv[4] * iy + h_cv[7] * iz - pos_c[1];
+          double z = h_cv[2] * ix + h_cv[5] * iy + h_cv[8] * iz - pos_c[2];
+          double vtdv = vt_G[G] * dv;
+
+          double R_v[] = {x, y, z};
+
+          double r2 = x * x + y * y + z * z;
+          double r = sqrt(r2);
+
+          bmgs_get_value_and_derivative(spline, r, &f, &dfdr);
+
+          spherical_harmonics_derivative_x(l, f, x, y, z, r2, fdYdv_vm[0]);
+          spherical_harmonics_derivative_y(l, f, x, y, z, r2, fdYdv_vm[1]);
+          spherical_harmonics_derivative_z(l, f, x, y, z, r2, fdYdv_vm[2]);
+          if (r > 1e-15)
+            spherical_harmonics(l, dfdr / r, x, y, z, r2, rlYdfdr_m);
+          else
+            for (int m = 0; m < nm1; m++)
+              rlYdfdr_m[m] = 0.0;
+
+          int m1start = M1 < Mstart ? nm1 - nm1p : 0;
+          for (int m1 = 0; m1 < nm1p; m1++, gm1++) {
+            double rlYdfdr = rlYdfdr_m[m1 + m1start];
+            for (int v = 0; v < 3; v++)
+              work_vgm[v * ngm + gm1] = vtdv * (fdYdv_vm[v][m1 + m1start]
+                                                + rlYdfdr * R_v[v]);
+          }
+        } // end loop over G
+        for (int i2 = 0; i2 < ni; i2++) {
+          LFVolume* v2 = volume_i + i2;
+          int nm2 = v2->nm;
+          const double* A2_gm = v2->A_gm;
+          double complex phase = conj(phase_i[i1]) * phase_i[i2];
+          double complex* DVt_mm = DVt_vMM + (M1p - Mstart) * nM + v2->M;
+          double one = 1.0;
+          double zero = 0.0;
+          // Contract the real factors over the grid strip and apply
+          // the constant phase of this volume pair afterwards:
+          for (int v = 0; v < 3; v++) {
+            dgemm_("n", "t", &nm2, &nm1p, &nG, &one,
+                   (double*)A2_gm, &nm2, work_vgm + v * ngm, &nm1p, &zero,
+                   block_mm, &nm2);
+            double complex* DVtv_mm = DVt_mm + v * nvMM;
+            for (int m1 = 0; m1 < nm1p; m1++)
+              for (int m2 = 0; m2 < nm2; m2++)
+                DVtv_mm[m1 * nM + m2] += block_mm[m1 * nm2 + m2] * phase;
+          }
+        } // i2 loop
+      } // i1 loop
+    }
+    GRID_LOOP_STOP(lfc, k);
+  }
+  Py_RETURN_NONE;
+}
+
 PyObject* derivative(LFCObject *lfc, PyObject *args)
 {
   const PyArrayObject* a_xG_obj;
@@ -1109,6 +2382,178 @@ PyObject* derivative(LFCObject *lfc, PyObject *args)
   Py_RETURN_NONE;
 }
 
+PyObject* integrate_and_derivative(LFCObject *lfc, PyObject *args)
+{
+  // Fused integrate() + derivative(): one traversal of the grid and
+  // the localized volumes gives both the integrals (from the stored
+  // function values) and their derivatives (reusing the spline
+  // evaluations), instead of sweeping the array twice.
+  const PyArrayObject* a_xG_obj;
+  PyArrayObject* c_xM_obj;
+  PyArrayObject* c_xMv_obj;
+  PyArrayObject* h_cv_obj;
+  PyArrayObject* n_c_obj;
+  PyObject* spline_M_obj;
+  PyArrayObject* beg_c_obj;
+  PyArrayObject* pos_Wc_obj;
+  int q;
+
+  if (!PyArg_ParseTuple(args, "OOOOOOOOi", &a_xG_obj, &c_xM_obj, &c_xMv_obj,
+                        &h_cv_obj, &n_c_obj,
+                        &spline_M_obj, &beg_c_obj,
+                        &pos_Wc_obj, &q))
+    return NULL;
+
+  int nd = a_xG_obj->nd;
+  npy_intp* dims = a_xG_obj->dimensions;
+  int nx = PyArray_MultiplyList(dims, nd - 3);
+  int nG = PyArray_MultiplyList(dims + nd - 3, 3);
+  int nM = c_xMv_obj->dimensions[c_xMv_obj->nd - 2];
+
+  const double* h_cv = (const double*)h_cv_obj->data;
+  const long* n_c = (const long*)n_c_obj->data;
+  const double (*pos_Wc)[3] = (const double (*)[3])pos_Wc_obj->data;
+
+  long* beg_c = LONGP(beg_c_obj);
+
+  if (!lfc->bloch_boundary_conditions) {
+    const double* a_G = (const double*)a_xG_obj->data;
+    double* c_M = (double*)c_xM_obj->data;
+    double* c_Mv = (double*)c_xMv_obj->data;
+    for (int x = 0; x < nx; x++) {
+      GRID_LOOP_START(lfc, -1) {
+        // In one grid loop iteration, only i2 changes.
+        int i2 = Ga % n_c[2] + beg_c[2];
+        int i1 = (Ga / n_c[2]) % n_c[1] + beg_c[1];
+        int i0 = Ga / (n_c[2] * n_c[1]) + beg_c[0];
+        double xG = h_cv[0] * i0 + h_cv[3] * i1 + h_cv[6] * i2;
+        double yG = h_cv[1] * i0 + h_cv[4] * i1 + h_cv[7] * i2;
+        double zG = h_cv[2] * i0 + h_cv[5] * i1 + h_cv[8] * i2;
+        for (int G = Ga; G < Gb; G++) {
+          double adv = a_G[G] * lfc->dv;
+          for (int i = 0; i < ni; i++) {
+            LFVolume* vol = volume_i + i;
+            int M = vol->M;
+            double* c_m = c_M + M;
+            double* c_mv = c_Mv + 3 * M;
+            const bmgsspline* spline = (const bmgsspline*) \
+              &((const SplineObject*)PyList_GetItem(spline_M_obj, M))->spline;
+
+            int nm = vol->nm;
+            int l = (nm - 1) / 2;
+            const double* A_gm = vol->A_gm + (G - Ga) * nm;
+            for (int m = 0; m < nm; m++)
+              c_m[m] += adv * A_gm[m];
+            double x = xG - pos_Wc[vol->W][0];
+            double y = yG - pos_Wc[vol->W][1];
+            double z = zG - pos_Wc[vol->W][2];
+            double R_c[] = {x, y, z};
+            double r2 = x * x + y * y + z * z;
+            double r = sqrt(r2);
+            double af;
+            double dfdr;
+            bmgs_get_value_and_derivative(spline, r, &af, &dfdr);
+            af *= adv;
+            double afdrlYdx_m[nm];  // a * f * d(r^l * Y)/dx
+            spherical_harmonics_derivative_x(l, af, x, y, z, r2, afdrlYdx_m);
+            for (int m = 0; m < nm; m++)
+              c_mv[3 * m] += afdrlYdx_m[m];
+            spherical_harmonics_derivative_y(l, af, x, y, z, r2, afdrlYdx_m);
+            for (int m = 0; m < nm; m++)
+              c_mv[3 * m + 1] += afdrlYdx_m[m];
+            spherical_harmonics_derivative_z(l, af, x, y, z, r2, afdrlYdx_m);
+            for (int m = 0; m < nm; m++)
+              c_mv[3 * m + 2] += afdrlYdx_m[m];
+            if (r > 1e-15) {
+              double arlm1Ydfdr_m[nm]; // a * r^(l-1) * Y * df/dr
+              double arm1dfdr = adv / r * dfdr;
+              spherical_harmonics(l, arm1dfdr, x, y, z, r2, arlm1Ydfdr_m);
+              for (int m = 0; m < nm; m++)
+                for (int v = 0; v < 3; v++)
+                  c_mv[m * 3 + v] += arlm1Ydfdr_m[m] * R_c[v];
+            }
+          }
+          xG += h_cv[6];
+          yG += h_cv[7];
+          zG += h_cv[8];
+        }
+      }
+      GRID_LOOP_STOP(lfc, -1);
+      c_M += nM;
+      c_Mv += 3 * nM;
+      a_G += nG;
+    }
+  }
+  else {
+    const complex double* a_G = (const complex double*)a_xG_obj->data;
+    complex double* c_M = (complex double*)c_xM_obj->data;
+    complex double* c_Mv = (complex double*)c_xMv_obj->data;
+    for (int x = 0; x < nx; x++) {
+      GRID_LOOP_START(lfc, q) {
+        // In one grid loop iteration, only i2 changes.
+        int i2 = Ga % n_c[2] + beg_c[2];
+        int i1 = (Ga / n_c[2]) % n_c[1] + beg_c[1];
+        int i0 = Ga / (n_c[2] * n_c[1]) + beg_c[0];
+        double xG = h_cv[0] * i0 + h_cv[3] * i1 + h_cv[6] * i2;
+        double yG = h_cv[1] * i0 + h_cv[4] * i1 + h_cv[7] * i2;
+        double zG = h_cv[2] * i0 + h_cv[5] * i1 + h_cv[8] * i2;
+        for (int G = Ga; G < Gb; G++) {
+          for (int i = 0; i < ni; i++) {
+            LFVolume* vol = volume_i + i;
+            int M = vol->M;
+            complex double* c_m = c_M + M;
+            complex double* c_mv = c_Mv + 3 * M;
+            const bmgsspline* spline = (const bmgsspline*) \
+              &((const SplineObject*)PyList_GetItem(spline_M_obj, M))->spline;
+
+            int nm = vol->nm;
+            int l = (nm - 1) / 2;
+            complex double ap = a_G[G] * phase_i[i] * lfc->dv;
+            const double* A_gm = vol->A_gm + (G - Ga) * nm;
+            for (int m = 0; m < nm; m++)
+              c_m[m] += ap * A_gm[m];
+            double x = xG - pos_Wc[vol->W][0];
+            double y = yG - pos_Wc[vol->W][1];
+            double z = zG - pos_Wc[vol->W][2];
+            double R_c[] = {x, y, z};
+            double r2 = x * x + y * y + z * z;
+            double r = sqrt(r2);
+            double f;
+            double dfdr;
+            bmgs_get_value_and_derivative(spline, r, &f, &dfdr);
+            double fdrlYdx_m[nm];  // f * d(r^l * Y)/dx
+            spherical_harmonics_derivative_x(l, f, x, y, z, r2, fdrlYdx_m);
+            for (int m = 0; m < nm; m++)
+              c_mv[3 * m    ] += ap * fdrlYdx_m[m];
+            spherical_harmonics_derivative_y(l, f, x, y, z, r2, fdrlYdx_m);
+            for (int m = 0; m < nm; m++)
+              c_mv[3 * m + 1] += ap * fdrlYdx_m[m];
+            spherical_harmonics_derivative_z(l, f, x, y, z, r2, fdrlYdx_m);
+            for (int m = 0; m < nm; m++)
+              c_mv[3 * m + 2] += ap * fdrlYdx_m[m];
+            if (r > 1e-15) {
+              double rlm1Ydfdr_m[nm];  // r^(l-1) * Y * df/dr
+              double rm1dfdr = dfdr / r;
+              spherical_harmonics(l, rm1dfdr, x, y, z, r2, rlm1Ydfdr_m);
+              for (int m = 0; m < nm; m++)
+                for (int v = 0; v < 3; v++)
+                  c_mv[m * 3 + v] += ap * rlm1Ydfdr_m[m] * R_c[v];
+            }
+          }
+          xG += h_cv[6];
+          yG += h_cv[7];
+          zG += h_cv[8];
+        }
+      }
+      GRID_LOOP_STOP(lfc, q);
+      c_M += nM;
+      c_Mv += 3 * nM;
+      a_G += nG;
+    }
+  }
+  Py_RETURN_NONE;
+}
+
 PyObject* normalized_derivative(LFCObject *lfc, PyObject *args)
 {
   const PyArrayObject* a_G_obj;
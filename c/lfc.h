@@ -6,6 +6,7 @@
 #define LFC_H
 
 #include <Python.h>
+#include "perf.h"
 
 typedef struct
 {
@@ -22,7 +23,11 @@ typedef struct
   double dv;                 // volume per grid point
   int nW;                    // number of volumes
   int nB;                    // number of boundary points
+  int nmmax;                 // maximum number of functions in a volume
+  int ngmax;                 // maximum number of grid points in a strip
   double* work_gm;           // work space
+  double* scratch;           // extra work space, grown on demand
+  int nscratch;              // current size of scratch
   LFVolume* volume_W;        // pointers to volumes
   LFVolume* volume_i;        // pointers to volumes at current grid point
   int* G_B;                  // boundary grid points
@@ -31,7 +36,21 @@ typedef struct
   int* ngm_W;                // number of grid points per volume
   bool bloch_boundary_conditions;  // Gamma-point calculation?
   complex double* phase_kW;  // phase factors: exp(ik.R)
+  complex double* conjphase_kW;  // conjugated phase factors: exp(-ik.R)
   complex double* phase_i;   // phase factors for current volumes
+  gpaw_perf_t perf;          // counter totals for integrate/add (see perf.h)
+  long long ngmtotal;        // sum of (point, function) products per sweep
+  long long ngtotal;         // sum of covered grid points per sweep
+  int nimax;                 // maximum number of active volumes
+  // Chunk plan for the threaded grid loops: the segment sweep is cut
+  // into pieces of roughly equal work and the sweep state at each cut
+  // is recorded, so that a thread can start a sweep in the middle:
+  int nchunks;               // number of chunks (0 in serial builds)
+  int* chunk_B;              // (nchunks + 1) segment range of each chunk
+  int* chunk_Ga;             // first grid index of each chunk
+  int* chunk_ni;             // number of active volumes at each chunk start
+  int* chunk_iW;             // (nchunks, nimax) active volume numbers
+  int* chunk_off;            // (nchunks, nimax) A_gm offsets at chunk start
 } LFCObject;
 
 
@@ -86,4 +105,69 @@ typedef struct
     volume_W[W].A_gm -= lfc->ngm_W[W];                             \
 }
 
+// Like GRID_LOOP_START/STOP, but covering only the segments of chunk c
+// from the plan recorded in NewLFCObject.  The active-volume arrays are
+// supplied by the caller so that several threads can sweep different
+// chunks of the same LFCObject at once; volume_W is never modified -
+// the recorded A_gm offsets replace the pointer bookkeeping of the
+// serial loop.  The body sees the same Ga, Gb, nG, ni, volume_i and
+// phase_i as the serial loop.
+#define GRID_LOOP_CHUNK_START(lfc, k, c, vol_i, ph_i, iW)          \
+{                                                                  \
+  int* G_B = lfc->G_B;                                             \
+  int* W_B = lfc->W_B;                                             \
+  LFVolume* volume_W = lfc->volume_W;                              \
+  double complex* phase_W = ((k) >= 0 ?                            \
+                             lfc->phase_kW + (k) * lfc->nW : NULL);\
+  LFVolume* volume_i = (vol_i);                                    \
+  double complex* phase_i = (ph_i);                                \
+  int* i_W = (iW);                                                 \
+  int ni = lfc->chunk_ni[c];                                       \
+  for (int i = 0; i < ni; i++)                                     \
+    {                                                              \
+      int W = lfc->chunk_iW[(c) * lfc->nimax + i];                 \
+      volume_i[i] = volume_W[W];                                   \
+      volume_i[i].A_gm += lfc->chunk_off[(c) * lfc->nimax + i];    \
+      if ((k) >= 0)                                                \
+        phase_i[i] = phase_W[W];                                   \
+      i_W[W] = i;                                                  \
+    }                                                              \
+  int Ga = lfc->chunk_Ga[c];                                       \
+  for (int B = lfc->chunk_B[c]; B < lfc->chunk_B[(c) + 1]; B++)    \
+    {                                                              \
+      int Gb = G_B[B];                                             \
+      int nG = Gb - Ga;                                            \
+      if (nG > 0)                                                  \
+        {
+
+#define GRID_LOOP_CHUNK_STOP(lfc, k)                               \
+          for (int i = 0; i < ni; i++)                             \
+            volume_i[i].A_gm += nG * volume_i[i].nm;               \
+        }                                                          \
+      int Wnew = W_B[B];                                           \
+      if (Wnew >= 0)                                               \
+        {                                                          \
+          /* Entering new sphere: */                               \
+          volume_i[ni] = volume_W[Wnew];                           \
+          if ((k) >= 0)                                            \
+            phase_i[ni] = phase_W[Wnew];                           \
+          i_W[Wnew] = ni;                                          \
+          ni++;                                                    \
+        }                                                          \
+      else                                                         \
+        {                                                          \
+          /* Leaving sphere: */                                    \
+          int Wold = -1 - Wnew;                                    \
+          int iold = i_W[Wold];                                    \
+          ni--;                                                    \
+          volume_i[iold] = volume_i[ni];                           \
+          if ((k) >= 0)                                            \
+            phase_i[iold] = phase_i[ni];                           \
+          int Wlast = volume_i[iold].W;                            \
+          i_W[Wlast] = iold;                                       \
+        }                                                          \
+      Ga = Gb;                                                     \
+    }                                                              \
+}
+
 #endif
@@ -362,3 +362,178 @@ PyObject* add_derivative(LFCObject *lfc, PyObject *args)
   }
   Py_RETURN_NONE;
 }
+
+// Fused version of add_derivative: accumulate all three Cartesian
+// derivative components of all localized functions in a single
+// traversal of the grid, sharing the distance and spline evaluations
+// between the components.  The coefficients come as one (nM, 3) array.
+PyObject* add_derivatives(LFCObject *lfc, PyObject *args)
+{
+  const PyArrayObject* c_xMv_obj;
+  PyArrayObject* a_xG_obj;
+  PyArrayObject* h_cv_obj;
+  PyArrayObject* n_c_obj;
+  PyObject* spline_M_obj;
+  PyArrayObject* beg_c_obj;
+  PyArrayObject* pos_Wc_obj;
+  // k-point index
+  int q;
+
+  if (!PyArg_ParseTuple(args, "OOOOOOOi", &c_xMv_obj, &a_xG_obj,
+                        &h_cv_obj, &n_c_obj, &spline_M_obj, &beg_c_obj,
+                        &pos_Wc_obj, &q))
+    return NULL;
+
+  int nd = a_xG_obj->nd;
+  npy_intp* dims = a_xG_obj->dimensions;
+  int nx = PyArray_MultiplyList(dims, nd - 3);
+  int nG = PyArray_MultiplyList(dims + nd - 3, 3);
+  // Number of lfc's
+  int nM = c_xMv_obj->dimensions[c_xMv_obj->nd - 2];
+
+  const double* h_cv = (const double*)h_cv_obj->data;
+  const long* n_c = (const long*)n_c_obj->data;
+  const double (*pos_Wc)[3] = (const double (*)[3])pos_Wc_obj->data;
+
+  long* beg_c = LONGP(beg_c_obj);
+
+  if (!lfc->bloch_boundary_conditions) {
+    const double* c_Mv = (const double*)c_xMv_obj->data;
+    double* a_G = (double*)a_xG_obj->data;
+    for (int x = 0; x < nx; x++) {
+      GRID_LOOP_START(lfc, -1) {
+        // In one grid loop iteration, only i2 changes.
+        int i2 = Ga % n_c[2] + beg_c[2];
+        int i1 = (Ga / n_c[2]) % n_c[1] + beg_c[1];
+        int i0 = Ga / (n_c[2] * n_c[1]) + beg_c[0];
+        double xG = h_cv[0] * i0 + h_cv[3] * i1 + h_cv[6] * i2;
+        double yG = h_cv[1] * i0 + h_cv[4] * i1 + h_cv[7] * i2;
+        double zG = h_cv[2] * i0 + h_cv[5] * i1 + h_cv[8] * i2;
+        for (int G = Ga; G < Gb; G++) {
+          for (int i = 0; i < ni; i++) {
+            LFVolume* vol = volume_i + i;
+            int M = vol->M;
+            int W = vol->W;
+            int nm = vol->nm;
+            int l = (nm - 1) / 2;
+
+            const bmgsspline* spline = (const bmgsspline*)              \
+              &((const SplineObject*)PyList_GetItem(spline_M_obj, M))->spline;
+
+            double x = xG - pos_Wc[W][0];
+            double y = yG - pos_Wc[W][1];
+            double z = zG - pos_Wc[W][2];
+            double R_c[] = {x, y, z};
+            double r2 = x * x + y * y + z * z;
+            double r = sqrt(r2);
+            double f;
+            double dfdr;
+
+            bmgs_get_value_and_derivative(spline, r, &f, &dfdr);
+
+            // First contribution: f * d(r^l * Y)/dv for all three v:
+            double fdrlYdv_vm[3][nm];
+            spherical_harmonics_derivative_x(l, f, x, y, z, r2,
+                                             fdrlYdv_vm[0]);
+            spherical_harmonics_derivative_y(l, f, x, y, z, r2,
+                                             fdrlYdv_vm[1]);
+            spherical_harmonics_derivative_z(l, f, x, y, z, r2,
+                                             fdrlYdv_vm[2]);
+
+            // Second contribution: r^(l-1) * Y * df/dr * R_v - the
+            // radial part is shared between the three components:
+            double rlm1Ydfdr_m[nm];
+            if (r > 1e-15)
+              spherical_harmonics(l, dfdr / r, x, y, z, r2, rlm1Ydfdr_m);
+            else
+              for (int m = 0; m < nm; m++)
+                rlm1Ydfdr_m[m] = 0.0;
+
+            const double* c_mv = c_Mv + 3 * M;
+            double a = 0.0;
+            for (int m = 0; m < nm; m++)
+              for (int v = 0; v < 3; v++)
+                a += ((fdrlYdv_vm[v][m] + rlm1Ydfdr_m[m] * R_c[v]) *
+                      c_mv[3 * m + v]);
+            a_G[G] += a;
+          }
+          xG += h_cv[6];
+          yG += h_cv[7];
+          zG += h_cv[8];
+        }
+      }
+      GRID_LOOP_STOP(lfc, -1);
+      c_Mv += 3 * nM;
+      a_G += nG;
+    }
+  }
+  else {
+    const double complex* c_Mv = (const double complex*)c_xMv_obj->data;
+    double complex* a_G = (double complex*)a_xG_obj->data;
+    for (int x = 0; x < nx; x++) {
+      GRID_LOOP_START(lfc, q) {
+        // In one grid loop iteration, only i2 changes.
+        int i2 = Ga % n_c[2] + beg_c[2];
+        int i1 = (Ga / n_c[2]) % n_c[1] + beg_c[1];
+        int i0 = Ga / (n_c[2] * n_c[1]) + beg_c[0];
+        double xG = h_cv[0] * i0 + h_cv[3] * i1 + h_cv[6] * i2;
+        double yG = h_cv[1] * i0 + h_cv[4] * i1 + h_cv[7] * i2;
+        double zG = h_cv[2] * i0 + h_cv[5] * i1 + h_cv[8] * i2;
+        for (int G = Ga; G < Gb; G++) {
+          for (int i = 0; i < ni; i++) {
+            double complex conjphase = conj(phase_i[i]);
+            LFVolume* vol = volume_i + i;
+            int M = vol->M;
+            int W = vol->W;
+            int nm = vol->nm;
+            int l = (nm - 1) / 2;
+
+            const bmgsspline* spline = (const bmgsspline*)              \
+              &((const SplineObject*)PyList_GetItem(spline_M_obj, M))->spline;
+
+            double x = xG - pos_Wc[W][0];
+            double y = yG - pos_Wc[W][1];
+            double z = zG - pos_Wc[W][2];
+            double R_c[] = {x, y, z};
+            double r2 = x * x + y * y + z * z;
+            double r = sqrt(r2);
+            double f;
+            double dfdr;
+
+            bmgs_get_value_and_derivative(spline, r, &f, &dfdr);
+
+            double fdrlYdv_vm[3][nm];
+            spherical_harmonics_derivative_x(l, f, x, y, z, r2,
+                                             fdrlYdv_vm[0]);
+            spherical_harmonics_derivative_y(l, f, x, y, z, r2,
+                                             fdrlYdv_vm[1]);
+            spherical_harmonics_derivative_z(l, f, x, y, z, r2,
+                                             fdrlYdv_vm[2]);
+
+            double rlm1Ydfdr_m[nm];
+            if (r > 1e-15)
+              spherical_harmonics(l, dfdr / r, x, y, z, r2, rlm1Ydfdr_m);
+            else
+              for (int m = 0; m < nm; m++)
+                rlm1Ydfdr_m[m] = 0.0;
+
+            const double complex* c_mv = c_Mv + 3 * M;
+            double complex a = 0.0;
+            for (int m = 0; m < nm; m++)
+              for (int v = 0; v < 3; v++)
+                a += ((fdrlYdv_vm[v][m] + rlm1Ydfdr_m[m] * R_c[v]) *
+                      c_mv[3 * m + v]);
+            a_G[G] += a * conjphase;
+          }
+          xG += h_cv[6];
+          yG += h_cv[7];
+          zG += h_cv[8];
+        }
+      }
+      GRID_LOOP_STOP(lfc, q);
+      c_Mv += 3 * nM;
+      a_G += nG;
+    }
+  }
+  Py_RETURN_NONE;
+}
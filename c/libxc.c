@@ -9,6 +9,7 @@
 #include <assert.h>
 #include "xc_gpaw.h"
 #include "extensions.h"
+#include "threadpool.h"
 #include "libxc/src/xc.h"
 
 //
@@ -442,97 +443,18 @@ lxcXCFunctional_is_mgga(lxcXCFunctionalObject *self, PyObject *args)
   return Py_BuildValue("i", success);
 }
 
-static PyObject*
-lxcXCFunctional_CalculateSpinPaired(lxcXCFunctionalObject *self, PyObject *args)
+/* Evaluate the functional on the grid points [gstart, gend).  The
+   points are independent and the libxc evaluators only read the
+   functional structs (the family dispatch pointers are assigned before
+   the workers start), so disjoint slabs of the grid can be handed to
+   the worker threads; e_g and v_g are per-point arrays, so no
+   cross-thread reduction is needed. */
+static void lxc_paired_slab(lxcXCFunctionalObject* self, int gstart, int gend,
+                            double* e_g, const double* n_g, double* v_g,
+                            const double* a2_g, double* tau_g,
+                            double* dEda2_g, double* dEdtau_g)
 {
-  PyArrayObject* e_array;             /* energy per particle*/
-  PyArrayObject* n_array;             /* rho */
-  PyArrayObject* v_array;             /* dE/drho */
-  PyArrayObject* a2_array = 0;         /* |nabla rho|^2*/
-  PyArrayObject* dEda2_array = 0;      /* dE/d|nabla rho|^2 */
-  PyArrayObject* tau_array = 0;        /* tau*/
-  PyArrayObject* dEdtau_array = 0;     /* dE/dtau */
-  if (!PyArg_ParseTuple(args, "OOO|OOOO", &e_array, &n_array, &v_array, /* object | optional objects*/
-			&a2_array, &dEda2_array, &tau_array, &dEdtau_array))
-    return NULL;
-
-  /* find nspin */
-  int nspin = self->nspin;
-
-  assert(nspin == XC_UNPOLARIZED); /* we are spinpaired */
-
-  int ng = e_array->dimensions[0]; /* number of grid points */
-
-  double* e_g = DOUBLEP(e_array); /* e on the grid */
-  const double* n_g = DOUBLEP(n_array); /* density on the grid */
-  double* v_g = DOUBLEP(v_array); /* v on the grid */
-
-  const double* a2_g = 0; /* a2 on the grid */
-  double* tau_g = 0;      /* tau on the grid */
-  double* dEda2_g = 0;    /* dEda2 on the grid */
-  double* dEdtau_g= 0;    /* dEdt on the grid */
-
-  if (((self->x_functional.family == XC_FAMILY_GGA) ||
-       (self->c_functional.family == XC_FAMILY_GGA))
-      ||
-      ((self->x_functional.family == XC_FAMILY_HYB_GGA) ||
-       (self->c_functional.family == XC_FAMILY_HYB_GGA)))
-    {
-      a2_g = DOUBLEP(a2_array);
-      dEda2_g = DOUBLEP(dEda2_array);
-    }
-
-  if ((self->x_functional.family == XC_FAMILY_MGGA) ||
-      (self->c_functional.family == XC_FAMILY_MGGA))
-    {
-      a2_g = DOUBLEP(a2_array);
-      tau_g = DOUBLEP(tau_array);
-      dEda2_g = DOUBLEP(dEda2_array);
-      dEdtau_g = DOUBLEP(dEdtau_array);
-    }
-
-  assert (self->xc_functional.family == XC_FAMILY_UNKNOWN); /* MDTMP not implemented */
-
-  /* find x functional */
-  switch(self->x_functional.family)
-    {
-    case XC_FAMILY_LDA:
-      self->get_vxc_x = get_vxc_lda;
-      break;
-    case XC_FAMILY_GGA:
-      self->get_vxc_x = get_vxc_gga;
-      break;
-    case XC_FAMILY_HYB_GGA:
-      self->get_vxc_x = get_vxc_gga;
-      break;
-    case XC_FAMILY_MGGA:
-      self->get_vxc_x = get_vxc_mgga;
-      break;
-/*     default: */
-/*       printf("lxcXCFunctional_CalculateSpinPaired: exchange functional '%d' not found\n", */
-/*	     self->x_functional.family); */
-    }
-  /* find c functional */
-  switch(self->c_functional.family)
-    {
-    case XC_FAMILY_LDA:
-      self->get_vxc_c = get_vxc_lda;
-      break;
-    case XC_FAMILY_GGA:
-      self->get_vxc_c = get_vxc_gga;
-      break;
-    case XC_FAMILY_HYB_GGA:
-      self->get_vxc_c = get_vxc_gga;
-      break;
-    case XC_FAMILY_MGGA:
-      self->get_vxc_c = get_vxc_mgga;
-      break;
-/*     default: */
-/*       printf("lxcXCFunctional_CalculateSpinPaired: correlation functional '%d' not found\n", */
-/*	     self->c_functional.family); */
-    }
-  /* ################################################################ */
-  for (int g = 0; g < ng; g++)
+  for (int g = gstart; g < gend; g++)
     {
       double n = n_g[g];
       if (n < NMIN)
@@ -623,55 +545,69 @@ lxcXCFunctional_CalculateSpinPaired(lxcXCFunctionalObject *self, PyObject *args)
       e_g[g] = n * (ex + ec);
       v_g[g] += dExdn + dEcdn;
     }
-  Py_RETURN_NONE;
+}
+
+struct lxc_paired_args{
+  int thread_id;
+  int nthds;
+  lxcXCFunctionalObject* self;
+  int ng;
+  double* e_g;
+  const double* n_g;
+  double* v_g;
+  const double* a2_g;
+  double* tau_g;
+  double* dEda2_g;
+  double* dEdtau_g;
+};
+
+static void* lxc_paired_worker(void* threadarg)
+{
+  struct lxc_paired_args *args = (struct lxc_paired_args *) threadarg;
+
+  int chunksize = args->ng / args->nthds + 1;
+  int gstart = args->thread_id * chunksize;
+  if (gstart >= args->ng)
+    return NULL;
+  int gend = gstart + chunksize;
+  if (gend > args->ng)
+    gend = args->ng;
+
+  lxc_paired_slab(args->self, gstart, gend, args->e_g, args->n_g,
+                  args->v_g, args->a2_g, args->tau_g,
+                  args->dEda2_g, args->dEdtau_g);
+  return NULL;
 }
 
 static PyObject*
-lxcXCFunctional_CalculateSpinPolarized(lxcXCFunctionalObject *self, PyObject *args)
+lxcXCFunctional_CalculateSpinPaired(lxcXCFunctionalObject *self, PyObject *args)
 {
-  PyArrayObject* e;
-  PyArrayObject* na;
-  PyArrayObject* va;
-  PyArrayObject* nb;
-  PyArrayObject* vb;
-  PyArrayObject* a2 = 0;
-  PyArrayObject* aa2 = 0;
-  PyArrayObject* ab2 = 0;
-  PyArrayObject* dEda2 = 0;
-  PyArrayObject* dEdaa2 = 0;
-  PyArrayObject* dEdab2 = 0;
-  PyArrayObject* taua = 0;          /* taua*/
-  PyArrayObject* taub = 0 ;         /* taub*/
-  PyArrayObject* dEdtaua = 0;       /* dE/dtaua */
-  PyArrayObject* dEdtaub = 0;       /* dE/dtaub */
-  if (!PyArg_ParseTuple(args, "OOOOO|OOOOOOOOOOOOOOO", &e, &na, &va, &nb, &vb,
-                        &a2, &aa2, &ab2, &dEda2, &dEdaa2, &dEdab2,
-                        &taua, &taub, &dEdtaua, &dEdtaub))
+  PyArrayObject* e_array;             /* energy per particle*/
+  PyArrayObject* n_array;             /* rho */
+  PyArrayObject* v_array;             /* dE/drho */
+  PyArrayObject* a2_array = 0;         /* |nabla rho|^2*/
+  PyArrayObject* dEda2_array = 0;      /* dE/d|nabla rho|^2 */
+  PyArrayObject* tau_array = 0;        /* tau*/
+  PyArrayObject* dEdtau_array = 0;     /* dE/dtau */
+  if (!PyArg_ParseTuple(args, "OOO|OOOO", &e_array, &n_array, &v_array, /* object | optional objects*/
+			&a2_array, &dEda2_array, &tau_array, &dEdtau_array))
     return NULL;
 
   /* find nspin */
   int nspin = self->nspin;
 
-  assert(nspin == XC_POLARIZED); /* we are spinpolarized */
+  assert(nspin == XC_UNPOLARIZED); /* we are spinpaired */
 
-  int ng = e->dimensions[0];  /* number of grid points */
+  int ng = e_array->dimensions[0]; /* number of grid points */
 
-  double* e_g = DOUBLEP(e); /* e on the grid */
-  const double* na_g = DOUBLEP(na); /* alpha density on the grid */
-  double* va_g = DOUBLEP(va); /* alpha v on the grid */
-  const double* nb_g = DOUBLEP(nb); /* beta density on the grid */
-  double* vb_g = DOUBLEP(vb); /* beta v on the grid */
+  double* e_g = DOUBLEP(e_array); /* e on the grid */
+  const double* n_g = DOUBLEP(n_array); /* density on the grid */
+  double* v_g = DOUBLEP(v_array); /* v on the grid */
 
-  const double* a2_g = 0; /* sigmaab on the grid */
-  const double* aa2_g = 0; /* sigmaaa on the grid */
-  const double* ab2_g = 0; /* sigmabb on the grid */
-  double* taua_g = 0;       /* taua on the grid */
-  double* taub_g = 0;       /* taub on the grid */
-  double* dEda2_g = 0; /* dEdsigmaab on the grid */
-  double* dEdaa2_g = 0; /* dEdsigmaaa on the grid */
-  double* dEdab2_g = 0; /* dEdsigmabb on the grid */
-  double* dEdtaua_g = 0; /* dEdta on the grid */
-  double* dEdtaub_g = 0; /* dEdtb on the grid */
+  const double* a2_g = 0; /* a2 on the grid */
+  double* tau_g = 0;      /* tau on the grid */
+  double* dEda2_g = 0;    /* dEda2 on the grid */
+  double* dEdtau_g= 0;    /* dEdt on the grid */
 
   if (((self->x_functional.family == XC_FAMILY_GGA) ||
        (self->c_functional.family == XC_FAMILY_GGA))
@@ -679,28 +615,19 @@ lxcXCFunctional_CalculateSpinPolarized(lxcXCFunctionalObject *self, PyObject *ar
       ((self->x_functional.family == XC_FAMILY_HYB_GGA) ||
        (self->c_functional.family == XC_FAMILY_HYB_GGA)))
     {
-      a2_g = DOUBLEP(a2);
-      aa2_g = DOUBLEP(aa2);
-      ab2_g = DOUBLEP(ab2);
-      dEda2_g = DOUBLEP(dEda2);
-      dEdaa2_g = DOUBLEP(dEdaa2);
-      dEdab2_g = DOUBLEP(dEdab2);
+      a2_g = DOUBLEP(a2_array);
+      dEda2_g = DOUBLEP(dEda2_array);
     }
 
   if ((self->x_functional.family == XC_FAMILY_MGGA) ||
       (self->c_functional.family == XC_FAMILY_MGGA))
     {
-      a2_g = DOUBLEP(a2);
-      aa2_g = DOUBLEP(aa2);
-      ab2_g = DOUBLEP(ab2);
-      taua_g = DOUBLEP(taua);
-      taub_g = DOUBLEP(taub);
-      dEda2_g = DOUBLEP(dEda2);
-      dEdaa2_g = DOUBLEP(dEdaa2);
-      dEdab2_g = DOUBLEP(dEdab2);
-      dEdtaua_g = DOUBLEP(dEdtaua);
-      dEdtaub_g = DOUBLEP(dEdtaub);
+      a2_g = DOUBLEP(a2_array);
+      tau_g = DOUBLEP(tau_array);
+      dEda2_g = DOUBLEP(dEda2_array);
+      dEdtau_g = DOUBLEP(dEdtau_array);
     }
+
   assert (self->xc_functional.family == XC_FAMILY_UNKNOWN); /* MDTMP not implemented */
 
   /* find x functional */
@@ -719,7 +646,7 @@ lxcXCFunctional_CalculateSpinPolarized(lxcXCFunctionalObject *self, PyObject *ar
       self->get_vxc_x = get_vxc_mgga;
       break;
 /*     default: */
-/*       printf("lxcXCFunctional_CalculateSpinPolarized: exchange functional '%d' not found\n", */
+/*       printf("lxcXCFunctional_CalculateSpinPaired: exchange functional '%d' not found\n", */
 /*	     self->x_functional.family); */
     }
   /* find c functional */
@@ -738,11 +665,55 @@ lxcXCFunctional_CalculateSpinPolarized(lxcXCFunctionalObject *self, PyObject *ar
       self->get_vxc_c = get_vxc_mgga;
       break;
 /*     default: */
-/*       printf("lxcXCFunctional_CalculateSpinPolarized: correlation functional '%d' not found\n", */
+/*       printf("lxcXCFunctional_CalculateSpinPaired: correlation functional '%d' not found\n", */
 /*	     self->c_functional.family); */
     }
   /* ################################################################ */
-  for (int g = 0; g < ng; g++)
+  int nthds = 1;
+#ifdef GPAW_OMP_MONLY
+  nthds = gpaw_threadpool_size();
+#endif
+  struct lxc_paired_args *wargs = GPAW_MALLOC(struct lxc_paired_args, nthds);
+
+  for(int i=0; i < nthds; i++)
+    {
+      (wargs+i)->thread_id = i;
+      (wargs+i)->nthds = nthds;
+      (wargs+i)->self = self;
+      (wargs+i)->ng = ng;
+      (wargs+i)->e_g = e_g;
+      (wargs+i)->n_g = n_g;
+      (wargs+i)->v_g = v_g;
+      (wargs+i)->a2_g = a2_g;
+      (wargs+i)->tau_g = tau_g;
+      (wargs+i)->dEda2_g = dEda2_g;
+      (wargs+i)->dEdtau_g = dEdtau_g;
+    }
+#ifdef GPAW_OMP_MONLY
+  gpaw_threadpool_run(lxc_paired_worker, wargs, sizeof(struct lxc_paired_args),
+                      nthds);
+#else
+  lxc_paired_worker(wargs);
+#endif
+  free(wargs);
+
+  Py_RETURN_NONE;
+}
+
+/* Spin-polarized slab evaluation (see lxc_paired_slab). */
+static void lxc_polarized_slab(lxcXCFunctionalObject* self,
+                               int gstart, int gend,
+                               double* e_g,
+                               const double* na_g, double* va_g,
+                               const double* nb_g, double* vb_g,
+                               const double* a2_g, const double* aa2_g,
+                               const double* ab2_g,
+                               double* dEda2_g, double* dEdaa2_g,
+                               double* dEdab2_g,
+                               double* taua_g, double* taub_g,
+                               double* dEdtaua_g, double* dEdtaub_g)
+{
+  for (int g = gstart; g < gend; g++)
   {
     double na = na_g[g];
     if (na < NMIN)
@@ -877,6 +848,204 @@ lxcXCFunctional_CalculateSpinPolarized(lxcXCFunctionalObject *self, PyObject *ar
     va_g[g] += dExdna + dEcdna;
     vb_g[g] += dExdnb + dEcdnb;
   }
+}
+
+struct lxc_polarized_args{
+  int thread_id;
+  int nthds;
+  lxcXCFunctionalObject* self;
+  int ng;
+  double* e_g;
+  const double* na_g;
+  double* va_g;
+  const double* nb_g;
+  double* vb_g;
+  const double* a2_g;
+  const double* aa2_g;
+  const double* ab2_g;
+  double* dEda2_g;
+  double* dEdaa2_g;
+  double* dEdab2_g;
+  double* taua_g;
+  double* taub_g;
+  double* dEdtaua_g;
+  double* dEdtaub_g;
+};
+
+static void* lxc_polarized_worker(void* threadarg)
+{
+  struct lxc_polarized_args *args = (struct lxc_polarized_args *) threadarg;
+
+  int chunksize = args->ng / args->nthds + 1;
+  int gstart = args->thread_id * chunksize;
+  if (gstart >= args->ng)
+    return NULL;
+  int gend = gstart + chunksize;
+  if (gend > args->ng)
+    gend = args->ng;
+
+  lxc_polarized_slab(args->self, gstart, gend, args->e_g,
+                     args->na_g, args->va_g, args->nb_g, args->vb_g,
+                     args->a2_g, args->aa2_g, args->ab2_g,
+                     args->dEda2_g, args->dEdaa2_g, args->dEdab2_g,
+                     args->taua_g, args->taub_g,
+                     args->dEdtaua_g, args->dEdtaub_g);
+  return NULL;
+}
+
+static PyObject*
+lxcXCFunctional_CalculateSpinPolarized(lxcXCFunctionalObject *self, PyObject *args)
+{
+  PyArrayObject* e;
+  PyArrayObject* na;
+  PyArrayObject* va;
+  PyArrayObject* nb;
+  PyArrayObject* vb;
+  PyArrayObject* a2 = 0;
+  PyArrayObject* aa2 = 0;
+  PyArrayObject* ab2 = 0;
+  PyArrayObject* dEda2 = 0;
+  PyArrayObject* dEdaa2 = 0;
+  PyArrayObject* dEdab2 = 0;
+  PyArrayObject* taua = 0;          /* taua*/
+  PyArrayObject* taub = 0 ;         /* taub*/
+  PyArrayObject* dEdtaua = 0;       /* dE/dtaua */
+  PyArrayObject* dEdtaub = 0;       /* dE/dtaub */
+  if (!PyArg_ParseTuple(args, "OOOOO|OOOOOOOOOOOOOOO", &e, &na, &va, &nb, &vb,
+                        &a2, &aa2, &ab2, &dEda2, &dEdaa2, &dEdab2,
+                        &taua, &taub, &dEdtaua, &dEdtaub))
+    return NULL;
+
+  /* find nspin */
+  int nspin = self->nspin;
+
+  assert(nspin == XC_POLARIZED); /* we are spinpolarized */
+
+  int ng = e->dimensions[0];  /* number of grid points */
+
+  double* e_g = DOUBLEP(e); /* e on the grid */
+  const double* na_g = DOUBLEP(na); /* alpha density on the grid */
+  double* va_g = DOUBLEP(va); /* alpha v on the grid */
+  const double* nb_g = DOUBLEP(nb); /* beta density on the grid */
+  double* vb_g = DOUBLEP(vb); /* beta v on the grid */
+
+  const double* a2_g = 0; /* sigmaab on the grid */
+  const double* aa2_g = 0; /* sigmaaa on the grid */
+  const double* ab2_g = 0; /* sigmabb on the grid */
+  double* taua_g = 0;       /* taua on the grid */
+  double* taub_g = 0;       /* taub on the grid */
+  double* dEda2_g = 0; /* dEdsigmaab on the grid */
+  double* dEdaa2_g = 0; /* dEdsigmaaa on the grid */
+  double* dEdab2_g = 0; /* dEdsigmabb on the grid */
+  double* dEdtaua_g = 0; /* dEdta on the grid */
+  double* dEdtaub_g = 0; /* dEdtb on the grid */
+
+  if (((self->x_functional.family == XC_FAMILY_GGA) ||
+       (self->c_functional.family == XC_FAMILY_GGA))
+      ||
+      ((self->x_functional.family == XC_FAMILY_HYB_GGA) ||
+       (self->c_functional.family == XC_FAMILY_HYB_GGA)))
+    {
+      a2_g = DOUBLEP(a2);
+      aa2_g = DOUBLEP(aa2);
+      ab2_g = DOUBLEP(ab2);
+      dEda2_g = DOUBLEP(dEda2);
+      dEdaa2_g = DOUBLEP(dEdaa2);
+      dEdab2_g = DOUBLEP(dEdab2);
+    }
+
+  if ((self->x_functional.family == XC_FAMILY_MGGA) ||
+      (self->c_functional.family == XC_FAMILY_MGGA))
+    {
+      a2_g = DOUBLEP(a2);
+      aa2_g = DOUBLEP(aa2);
+      ab2_g = DOUBLEP(ab2);
+      taua_g = DOUBLEP(taua);
+      taub_g = DOUBLEP(taub);
+      dEda2_g = DOUBLEP(dEda2);
+      dEdaa2_g = DOUBLEP(dEdaa2);
+      dEdab2_g = DOUBLEP(dEdab2);
+      dEdtaua_g = DOUBLEP(dEdtaua);
+      dEdtaub_g = DOUBLEP(dEdtaub);
+    }
+  assert (self->xc_functional.family == XC_FAMILY_UNKNOWN); /* MDTMP not implemented */
+
+  /* find x functional */
+  switch(self->x_functional.family)
+    {
+    case XC_FAMILY_LDA:
+      self->get_vxc_x = get_vxc_lda;
+      break;
+    case XC_FAMILY_GGA:
+      self->get_vxc_x = get_vxc_gga;
+      break;
+    case XC_FAMILY_HYB_GGA:
+      self->get_vxc_x = get_vxc_gga;
+      break;
+    case XC_FAMILY_MGGA:
+      self->get_vxc_x = get_vxc_mgga;
+      break;
+/*     default: */
+/*       printf("lxcXCFunctional_CalculateSpinPolarized: exchange functional '%d' not found\n", */
+/*	     self->x_functional.family); */
+    }
+  /* find c functional */
+  switch(self->c_functional.family)
+    {
+    case XC_FAMILY_LDA:
+      self->get_vxc_c = get_vxc_lda;
+      break;
+    case XC_FAMILY_GGA:
+      self->get_vxc_c = get_vxc_gga;
+      break;
+    case XC_FAMILY_HYB_GGA:
+      self->get_vxc_c = get_vxc_gga;
+      break;
+    case XC_FAMILY_MGGA:
+      self->get_vxc_c = get_vxc_mgga;
+      break;
+/*     default: */
+/*       printf("lxcXCFunctional_CalculateSpinPolarized: correlation functional '%d' not found\n", */
+/*	     self->c_functional.family); */
+    }
+  /* ################################################################ */
+  int nthds = 1;
+#ifdef GPAW_OMP_MONLY
+  nthds = gpaw_threadpool_size();
+#endif
+  struct lxc_polarized_args *wargs = GPAW_MALLOC(struct lxc_polarized_args,
+                                                 nthds);
+
+  for(int i=0; i < nthds; i++)
+    {
+      (wargs+i)->thread_id = i;
+      (wargs+i)->nthds = nthds;
+      (wargs+i)->self = self;
+      (wargs+i)->ng = ng;
+      (wargs+i)->e_g = e_g;
+      (wargs+i)->na_g = na_g;
+      (wargs+i)->va_g = va_g;
+      (wargs+i)->nb_g = nb_g;
+      (wargs+i)->vb_g = vb_g;
+      (wargs+i)->a2_g = a2_g;
+      (wargs+i)->aa2_g = aa2_g;
+      (wargs+i)->ab2_g = ab2_g;
+      (wargs+i)->dEda2_g = dEda2_g;
+      (wargs+i)->dEdaa2_g = dEdaa2_g;
+      (wargs+i)->dEdab2_g = dEdab2_g;
+      (wargs+i)->taua_g = taua_g;
+      (wargs+i)->taub_g = taub_g;
+      (wargs+i)->dEdtaua_g = dEdtaua_g;
+      (wargs+i)->dEdtaub_g = dEdtaub_g;
+    }
+#ifdef GPAW_OMP_MONLY
+  gpaw_threadpool_run(lxc_polarized_worker, wargs,
+                      sizeof(struct lxc_polarized_args), nthds);
+#else
+  lxc_polarized_worker(wargs);
+#endif
+  free(wargs);
+
   Py_RETURN_NONE;
 }
 
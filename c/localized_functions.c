@@ -59,16 +59,30 @@ static PyObject * localized_functions_integrate(LocalizedFunctionsObject *self,
   int ng0 = self->ng0;
 
   if (aa->descr->type_num == PyArray_DOUBLE)
-    for (int n = 0; n < na; n++)
-      {
-	bmgs_cut(a, self->size, self->start, w, self->size0);
-	double zero = 0.0;
-	int inc = 1;
-	dgemv_("t", &ng0, &nf, &self->dv, f, &ng0, w, &inc, &zero, b, &inc);
-
-	a += ng;
-	b += nf;
-      }
+    {
+      if (na == 1)
+	{
+	  bmgs_cut(a, self->size, self->start, w, self->size0);
+	  double zero = 0.0;
+	  int inc = 1;
+	  dgemv_("t", &ng0, &nf, &self->dv, f, &ng0, w, &inc, &zero, b, &inc);
+	}
+      else
+	{
+	  // Batch the bands: cut all windows first and contract them
+	  // against the function values in a single dgemm - these
+	  // boxes are small enough that one dgemv per band is
+	  // dominated by BLAS call overhead:
+	  double* w_ng = GPAW_MALLOC(double, na * ng0);
+	  for (int n = 0; n < na; n++)
+	    bmgs_cut(a + n * ng, self->size, self->start,
+		     w_ng + n * ng0, self->size0);
+	  double zero = 0.0;
+	  dgemm_("t", "n", &nf, &na, &ng0, &self->dv, f, &ng0,
+		 w_ng, &ng0, &zero, b, &nf);
+	  free(w_ng);
+	}
+    }
   else
     for (int n = 0; n < na; n++)
       {
@@ -105,16 +119,27 @@ static PyObject * localized_functions_derivative(
   int ng0 = self->ng0;
 
   if (aa->descr->type_num == PyArray_DOUBLE)
-    for (int n = 0; n < na; n++)
-      {
-	bmgs_cut(a, self->size, self->start, w, self->size0);
-	double zero = 0.0;
-	int inc = 1;
-	dgemv_("t", &ng0, &nf, &self->dv, f, &ng0, w, &inc, &zero, b, &inc);
-
-	a += ng;
-	b += nf;
-      }
+    {
+      if (na == 1)
+	{
+	  bmgs_cut(a, self->size, self->start, w, self->size0);
+	  double zero = 0.0;
+	  int inc = 1;
+	  dgemv_("t", &ng0, &nf, &self->dv, f, &ng0, w, &inc, &zero, b, &inc);
+	}
+      else
+	{
+	  // Batched over bands - see localized_functions_integrate:
+	  double* w_ng = GPAW_MALLOC(double, na * ng0);
+	  for (int n = 0; n < na; n++)
+	    bmgs_cut(a + n * ng, self->size, self->start,
+		     w_ng + n * ng0, self->size0);
+	  double zero = 0.0;
+	  dgemm_("t", "n", &nf, &na, &ng0, &self->dv, f, &ng0,
+		 w_ng, &ng0, &zero, b, &nf);
+	  free(w_ng);
+	}
+    }
   else
     for (int n = 0; n < na; n++)
       {
@@ -151,16 +176,29 @@ static PyObject * localized_functions_add(LocalizedFunctionsObject *self,
   double* w = self->w;
 
   if (aa->descr->type_num == PyArray_DOUBLE)
-    for (int n = 0; n < na; n++)
-      {
-	double zero = 0.0;
-	double one = 1.0;
-	int inc = 1;
-	dgemv_("n", &ng0, &nf, &one, f, &ng0, c, &inc, &zero, w, &inc);
-	bmgs_pastep(w, self->size0, a, self->size, self->start);
-	a += ng;
-	c += nf;
-      }
+    {
+      if (na == 1)
+	{
+	  double zero = 0.0;
+	  double one = 1.0;
+	  int inc = 1;
+	  dgemv_("n", &ng0, &nf, &one, f, &ng0, c, &inc, &zero, w, &inc);
+	  bmgs_pastep(w, self->size0, a, self->size, self->start);
+	}
+      else
+	{
+	  // Batched over bands - see localized_functions_integrate:
+	  double* w_ng = GPAW_MALLOC(double, na * ng0);
+	  double zero = 0.0;
+	  double one = 1.0;
+	  dgemm_("n", "n", &ng0, &na, &nf, &one, f, &ng0, c, &nf,
+		 &zero, w_ng, &ng0);
+	  for (int n = 0; n < na; n++)
+	    bmgs_pastep(w_ng + n * ng0, self->size0, a + n * ng,
+			self->size, self->start);
+	  free(w_ng);
+	}
+    }
   else
     for (int n = 0; n < na; n++)
       {
@@ -0,0 +1,130 @@
+/*  Copyright (C) 2003-2007  CAMP
+ *  Please see the accompanying LICENSE file for further information. */
+
+#include <Python.h>
+#define PY_ARRAY_UNIQUE_SYMBOL GPAW_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+#include "extensions.h"
+#include <math.h>
+
+/* Fused grid kernels for the Pulay density mixer (gpaw/mixer.py).
+ *
+ * The density and residual histories live in fixed ring buffers
+ * (preallocated 4-d numpy arrays owned by the Python mixer); the
+ * kernels walk them in cache-sized blocks so the metric-weighted
+ * residual and the new density stay resident while all history slots
+ * are visited, instead of one full-grid pass per numpy operation. */
+
+#define GPAW_MIX_BLOCK 2048
+
+/* residual(nt_G, ntold_G, R_G) -> sum(|R_G|) (local):
+   R_G = nt_G - ntold_G and the charge-sloshing sum in one pass. */
+PyObject* mixer_residual(PyObject *self, PyObject *args)
+{
+  PyArrayObject* nt;
+  PyArrayObject* ntold;
+  PyArrayObject* R;
+  if (!PyArg_ParseTuple(args, "OOO", &nt, &ntold, &R))
+    return NULL;
+
+  long ng = 1;
+  for (int d = 0; d < nt->nd; d++)
+    ng *= nt->dimensions[d];
+
+  const double* n = DOUBLEP(nt);
+  const double* no = DOUBLEP(ntold);
+  double* r = DOUBLEP(R);
+  double sum = 0.0;
+  for (long g = 0; g < ng; g++)
+    {
+      double x = n[g] - no[g];
+      r[g] = x;
+      sum += fabs(x);
+    }
+  return Py_BuildValue("d", sum);
+}
+
+/* overlap(R_xG, order_i, mR_G, a_i):
+   a_i[i] = sum(R_xG[order_i[i]] * mR_G) (local) for every history
+   slot, with mR_G read blockwise once for all slots. */
+PyObject* mixer_overlap(PyObject *self, PyObject *args)
+{
+  PyArrayObject* R_xG;
+  PyArrayObject* order_i;
+  PyArrayObject* mR_G;
+  PyArrayObject* a_i;
+  if (!PyArg_ParseTuple(args, "OOOO", &R_xG, &order_i, &mR_G, &a_i))
+    return NULL;
+
+  int ni = order_i->dimensions[0];
+  long ng = 1;
+  for (int d = 1; d < R_xG->nd; d++)
+    ng *= R_xG->dimensions[d];
+
+  const long* order = LONGP(order_i);
+  const double* rall = DOUBLEP(R_xG);
+  const double* mr = DOUBLEP(mR_G);
+  double* a = DOUBLEP(a_i);
+  for (int i = 0; i < ni; i++)
+    a[i] = 0.0;
+  for (long g0 = 0; g0 < ng; g0 += GPAW_MIX_BLOCK)
+    {
+      long g1 = MIN(g0 + GPAW_MIX_BLOCK, ng);
+      for (int i = 0; i < ni; i++)
+        {
+          const double* r = rall + order[i] * ng;
+          double sum = 0.0;
+          for (long g = g0; g < g1; g++)
+            sum += r[g] * mr[g];
+          a[i] += sum;
+        }
+    }
+  Py_RETURN_NONE;
+}
+
+/* combine(alpha_i, beta, nt_xG, ntorder_i, R_xG, rorder_i, nt_G):
+   nt_G = sum_i alpha_i[i] * (nt_xG[ntorder_i[i]]
+                              + beta * R_xG[rorder_i[i]]),
+   writing each block of the new density only once. */
+PyObject* mixer_combine(PyObject *self, PyObject *args)
+{
+  PyArrayObject* alpha_i;
+  double beta;
+  PyArrayObject* nt_xG;
+  PyArrayObject* ntorder_i;
+  PyArrayObject* R_xG;
+  PyArrayObject* rorder_i;
+  PyArrayObject* nt_G;
+  if (!PyArg_ParseTuple(args, "OdOOOOO", &alpha_i, &beta, &nt_xG,
+                        &ntorder_i, &R_xG, &rorder_i, &nt_G))
+    return NULL;
+
+  int ni = alpha_i->dimensions[0];
+  long ng = 1;
+  for (int d = 0; d < nt_G->nd; d++)
+    ng *= nt_G->dimensions[d];
+
+  const double* alpha = DOUBLEP(alpha_i);
+  const long* ntorder = LONGP(ntorder_i);
+  const long* rorder = LONGP(rorder_i);
+  const double* nall = DOUBLEP(nt_xG);
+  const double* rall = DOUBLEP(R_xG);
+  double* nt = DOUBLEP(nt_G);
+  for (long g0 = 0; g0 < ng; g0 += GPAW_MIX_BLOCK)
+    {
+      long g1 = MIN(g0 + GPAW_MIX_BLOCK, ng);
+      for (long g = g0; g < g1; g++)
+        nt[g] = 0.0;
+      for (int i = 0; i < ni; i++)
+        {
+          const double* n = nall + ntorder[i] * ng;
+          const double* r = rall + rorder[i] * ng;
+          double a = alpha[i];
+          double ab = a * beta;
+          for (long g = g0; g < g1; g++)
+            nt[g] += a * n[g] + ab * r[g];
+        }
+    }
+  Py_RETURN_NONE;
+}
@@ -9,6 +9,7 @@
 #define NO_IMPORT_ARRAY
 #include <numpy/arrayobject.h>
 #include <mpi.h>
+#include <sys/time.h>
 #include "extensions.h"
 #include <structmember.h>
 #include "mympi.h"
@@ -53,6 +54,99 @@ typedef struct {
   PyObject *buffer;
 } mpi_request;
 
+// Communication statistics layer.  When switched on at runtime with
+// _gpaw.mpi_stats_enable(), every communicator records per-operation
+// call counts, bytes and size/latency histograms (see mympi.h), which
+// comm.get_stats() hands to Python for the end-of-run report in
+// gpaw/mpi/__init__.py.  Off (the default), the cost is one branch per
+// call.
+static int mpi_stats_enabled = 0;
+
+static const char* mpi_opnames[GPAW_MPI_NOPS] =
+  {"send", "recv", "sendreceive", "reduce", "broadcast", "scatter",
+   "gather", "all_gather", "reduce_scatter", "wait", "barrier"};
+
+static double mpi_walltime(void)
+{
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 1e-6 * t.tv_usec;
+}
+
+static void mpi_stats_record(MPIObject* self, int op, long long nbytes,
+                             double time)
+{
+  gpaw_mpi_opstats* s = &self->stats[op];
+  s->count++;
+  s->nbytes += nbytes;
+  s->time += time;
+  int b = 0;
+  while ((nbytes >> (b + 1)) > 0 && b < GPAW_MPI_NSIZEBINS - 1)
+    b++;
+  s->sizehist[b]++;
+  b = 0;
+  double limit = 1e-6;
+  while (time >= limit && b < GPAW_MPI_NTIMEBINS - 1)
+    {
+      limit *= 10.0;
+      b++;
+    }
+  s->timehist[b]++;
+}
+
+// Bracket an MPI call; STATS_T0 goes before Py_BEGIN_ALLOW_THREADS:
+#define STATS_T0 \
+  double stats_t0 = (mpi_stats_enabled ? mpi_walltime() : 0.0)
+#define STATS_RECORD(self, op, nbytes) \
+  if (mpi_stats_enabled) \
+    mpi_stats_record(self, op, nbytes, mpi_walltime() - stats_t0)
+
+PyObject* mpi_stats_enable(PyObject *self, PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+  mpi_stats_enabled = 1;
+  Py_RETURN_NONE;
+}
+
+PyObject* mpi_stats_disable(PyObject *self, PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+  mpi_stats_enabled = 0;
+  Py_RETURN_NONE;
+}
+
+static PyObject * mpi_get_stats(MPIObject *self, PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+  PyObject* dict = PyDict_New();
+  if (dict == NULL)
+    return NULL;
+  for (int op = 0; op < GPAW_MPI_NOPS; op++)
+    {
+      const gpaw_mpi_opstats* s = &self->stats[op];
+      if (s->count == 0)
+        continue;
+      PyObject* sizehist = PyTuple_New(GPAW_MPI_NSIZEBINS);
+      PyObject* timehist = PyTuple_New(GPAW_MPI_NTIMEBINS);
+      for (int b = 0; b < GPAW_MPI_NSIZEBINS; b++)
+        PyTuple_SET_ITEM(sizehist, b, PyLong_FromLongLong(s->sizehist[b]));
+      for (int b = 0; b < GPAW_MPI_NTIMEBINS; b++)
+        PyTuple_SET_ITEM(timehist, b, PyLong_FromLongLong(s->timehist[b]));
+      PyObject* entry = Py_BuildValue("{s:L,s:L,s:d,s:N,s:N}",
+                                      "count", s->count,
+                                      "bytes", s->nbytes,
+                                      "time", s->time,
+                                      "size_hist", sizehist,
+                                      "time_hist", timehist);
+      PyDict_SetItemString(dict, mpi_opnames[op], entry);
+      Py_DECREF(entry);
+    }
+  return dict;
+}
+
 static void mpi_dealloc(MPIObject *obj)
 {
   if (obj->comm != MPI_COMM_WORLD)
@@ -84,9 +178,13 @@ static PyObject * mpi_sendreceive(MPIObject *self, PyObject *args, PyObject *kwa
   int nrecv = PyArray_DESCR(b)->elsize;
   for (int d = 0; d < PyArray_NDIM(b); d++)
     nrecv *= PyArray_DIM(b,d);
-  ret = MPI_Sendrecv(PyArray_BYTES(a), nsend, MPI_BYTE, dest, sendtag, 
-		     PyArray_BYTES(b), nrecv, MPI_BYTE, src, recvtag, 
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
+  ret = MPI_Sendrecv(PyArray_BYTES(a), nsend, MPI_BYTE, dest, sendtag,
+		     PyArray_BYTES(b), nrecv, MPI_BYTE, src, recvtag,
 		     self->comm, MPI_STATUS_IGNORE);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_SENDRECV, nsend + nrecv);
 #ifdef GPAW_MPI_DEBUG
       if (ret != MPI_SUCCESS)
 	{
@@ -117,8 +215,12 @@ static PyObject * mpi_receive(MPIObject *self, PyObject *args, PyObject *kwargs)
     n *= PyArray_DIM(a, d);
   if (block)
     {
+      STATS_T0;
+      Py_BEGIN_ALLOW_THREADS;
       ret = MPI_Recv(PyArray_BYTES(a), n, MPI_BYTE, src, tag, self->comm,
 	       MPI_STATUS_IGNORE);
+      Py_END_ALLOW_THREADS;
+      STATS_RECORD(self, GPAW_MPI_RECV, n);
 #ifdef GPAW_MPI_DEBUG
       if (ret != MPI_SUCCESS)
 	{
@@ -133,7 +235,9 @@ static PyObject * mpi_receive(MPIObject *self, PyObject *args, PyObject *kwargs)
       mpi_request req;
       req.buffer = a;
       Py_INCREF(req.buffer);
+      STATS_T0;
       ret = MPI_Irecv(PyArray_BYTES(a), n, MPI_BYTE, src, tag, self->comm, &(req.rq));
+      STATS_RECORD(self, GPAW_MPI_RECV, n);
 #ifdef GPAW_MPI_DEBUG
       if (ret != MPI_SUCCESS)
 	{
@@ -163,7 +267,11 @@ static PyObject * mpi_send(MPIObject *self, PyObject *args, PyObject *kwargs)
     n *= PyArray_DIM(a,d);
   if (block)
     {
+      STATS_T0;
+      Py_BEGIN_ALLOW_THREADS;
       ret = MPI_Send(PyArray_BYTES(a), n, MPI_BYTE, dest, tag, self->comm);
+      Py_END_ALLOW_THREADS;
+      STATS_RECORD(self, GPAW_MPI_SEND, n);
 #ifdef GPAW_MPI_DEBUG
       if (ret != MPI_SUCCESS)
 	{
@@ -178,8 +286,10 @@ static PyObject * mpi_send(MPIObject *self, PyObject *args, PyObject *kwargs)
       mpi_request req;
       req.buffer = a;
       Py_INCREF(a);
+      STATS_T0;
       ret = MPI_Isend(PyArray_BYTES(a), n, MPI_BYTE, dest, tag, self->comm,
 		&(req.rq));
+      STATS_RECORD(self, GPAW_MPI_SEND, n);
 #ifdef GPAW_MPI_DEBUG
       if (ret != MPI_SUCCESS)
 	{
@@ -205,7 +315,11 @@ static PyObject * mpi_ssend(MPIObject *self, PyObject *args, PyObject *kwargs)
   int n = PyArray_DESCR(a)->elsize;
   for (int d = 0; d < PyArray_NDIM(a); d++)
     n *= PyArray_DIM(a,d);
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
   MPI_Ssend(PyArray_BYTES(a), n, MPI_BYTE, dest, tag, self->comm);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_SEND, n);
   Py_RETURN_NONE;
 }
 
@@ -229,7 +343,11 @@ static PyObject * mpi_abort(MPIObject *self, PyObject *args)
 
 static PyObject * mpi_barrier(MPIObject *self)
 {
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
   MPI_Barrier(self->comm);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_BARRIER, 0);
   Py_RETURN_NONE;
 }
 
@@ -331,7 +449,11 @@ static PyObject * mpi_wait(MPIObject *self, PyObject *args)
       PyErr_SetString(PyExc_TypeError, "Invalid MPI request object.");
       return NULL;
     }
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
   ret = MPI_Wait(&(s->rq), MPI_STATUS_IGNORE); // Can this change the Python string?
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_WAIT, 0);
   Py_DECREF(s->buffer);
 #ifdef GPAW_MPI_DEBUG
   if (ret != MPI_SUCCESS)
@@ -379,7 +501,11 @@ static PyObject * mpi_waitall(MPIObject *self, PyObject *requests)
       Py_DECREF(o);
     }
   // Do the actual wait.
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
   ret = MPI_Waitall(n, rqs, MPI_STATUSES_IGNORE);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_WAIT, 0);
 #ifdef GPAW_MPI_DEBUG
   if (ret != MPI_SUCCESS)
     {
@@ -471,11 +597,15 @@ static PyObject * mpi_reduce(MPIObject *self, PyObject *args, PyObject *kwargs,
     {
       double din = PyFloat_AS_DOUBLE(obj);
       double dout;
+      STATS_T0;
+      Py_BEGIN_ALLOW_THREADS;
       if (root == -1)
         ret = MPI_Allreduce(&din, &dout, 1, MPI_DOUBLE, operation, self->comm);
       else
-        ret = MPI_Reduce(&din, &dout, 1, MPI_DOUBLE, operation, root, 
+        ret = MPI_Reduce(&din, &dout, 1, MPI_DOUBLE, operation, root,
                          self->comm);
+      Py_END_ALLOW_THREADS;
+      STATS_RECORD(self, GPAW_MPI_REDUCE, sizeof(double));
 #ifdef GPAW_MPI_DEBUG
       if (ret != MPI_SUCCESS)
         {
@@ -490,11 +620,15 @@ static PyObject * mpi_reduce(MPIObject *self, PyObject *args, PyObject *kwargs,
     {
       long din = PyInt_AS_LONG(obj);
       long dout;
+      STATS_T0;
+      Py_BEGIN_ALLOW_THREADS;
       if (root == -1)
         ret = MPI_Allreduce(&din, &dout, 1, MPI_LONG, operation, self->comm);
       else
-        ret = MPI_Reduce(&din, &dout, 1, MPI_LONG, operation, root, 
+        ret = MPI_Reduce(&din, &dout, 1, MPI_LONG, operation, root,
                          self->comm);
+      Py_END_ALLOW_THREADS;
+      STATS_RECORD(self, GPAW_MPI_REDUCE, sizeof(long));
 #ifdef GPAW_MPI_DEBUG
       if (ret != MPI_SUCCESS)
         {
@@ -511,11 +645,15 @@ static PyObject * mpi_reduce(MPIObject *self, PyObject *args, PyObject *kwargs,
       double dout[2];
       din[0] = PyComplex_RealAsDouble(obj);
       din[1] = PyComplex_ImagAsDouble(obj);
+      STATS_T0;
+      Py_BEGIN_ALLOW_THREADS;
       if (root == -1)
         ret = MPI_Allreduce(&din, &dout, 2, MPI_DOUBLE, MPI_SUM, self->comm);
       else
-        ret = MPI_Reduce(&din, &dout, 2, MPI_DOUBLE, MPI_SUM, root, 
+        ret = MPI_Reduce(&din, &dout, 2, MPI_DOUBLE, MPI_SUM, root,
                          self->comm);
+      Py_END_ALLOW_THREADS;
+      STATS_RECORD(self, GPAW_MPI_REDUCE, 2 * sizeof(double));
 #ifdef GPAW_MPI_DEBUG
       if (ret != MPI_SUCCESS)
         {
@@ -557,9 +695,13 @@ static PyObject * mpi_reduce(MPIObject *self, PyObject *args, PyObject *kwargs,
 	      return NULL;
 	    }
 	}
+      STATS_T0;
       if (root == -1)
         {
-#ifdef GPAW_MPI2
+          Py_BEGIN_ALLOW_THREADS;
+#ifndef GPAW_MPI1
+	  // Reduce directly into the caller's buffer (MPI-2 feature;
+	  // define GPAW_MPI1 for ancient libraries without it):
 	  ret = MPI_Allreduce(MPI_IN_PLACE, PyArray_BYTES(obj), n, datatype,
                         operation, self->comm);
 #else
@@ -570,39 +712,43 @@ static PyObject * mpi_reduce(MPIObject *self, PyObject *args, PyObject *kwargs,
           memcpy(PyArray_BYTES(obj), b, n * elemsize);
           free(b);
 #endif
+          Py_END_ALLOW_THREADS;
 #ifdef GPAW_MPI_DEBUG
           if (ret != MPI_SUCCESS)
 	    {
 	      PyErr_SetString(PyExc_RuntimeError, 
                               "MPI_Allreduce Array error.");
 	      return NULL;
-	    }	
+	    }
 #endif
+          STATS_RECORD(self, GPAW_MPI_REDUCE, (long long)n * elemsize);
         }
       else
         {
           int rank;
           MPI_Comm_rank(self->comm, &rank);
           char* b = 0;
+          Py_BEGIN_ALLOW_THREADS;
           if (rank == root)
             {
-#ifdef GPAW_MPI2 
-              ret = MPI_Reduce(MPI_IN_PLACE, PyArray_BYTES(obj), n, 
+#ifndef GPAW_MPI1
+              ret = MPI_Reduce(MPI_IN_PLACE, PyArray_BYTES(obj), n,
                                datatype, operation, root, self->comm);
 #else
               b = GPAW_MALLOC(char, n * elemsize);
-              ret = MPI_Reduce(PyArray_BYTES(obj), b, n, datatype, 
+              ret = MPI_Reduce(PyArray_BYTES(obj), b, n, datatype,
                                operation, root, self->comm);
 	      assert(PyArray_NBYTES(obj) == n * elemsize);
               memcpy(PyArray_BYTES(obj), b, n * elemsize);
-              free(b);               
+              free(b);
 #endif
             }
           else
             {
-              ret = MPI_Reduce(PyArray_BYTES(obj), b, n, datatype, 
+              ret = MPI_Reduce(PyArray_BYTES(obj), b, n, datatype,
                                operation, root, self->comm);
             }
+          Py_END_ALLOW_THREADS;
 #ifdef GPAW_MPI_DEBUG
           if (ret != MPI_SUCCESS)
             {
@@ -611,6 +757,7 @@ static PyObject * mpi_reduce(MPIObject *self, PyObject *args, PyObject *kwargs,
               return NULL;
 	    }
 #endif
+          STATS_RECORD(self, GPAW_MPI_REDUCE, (long long)n * elemsize);
         }
       Py_RETURN_NONE;
     }
@@ -656,8 +803,12 @@ static PyObject * mpi_scatter(MPIObject *self, PyObject *args)
   int n = PyArray_DESCR(recvobj)->elsize;
   for (int d = 0; d < PyArray_NDIM(recvobj); d++)
     n *= PyArray_DIM(recvobj,d);
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
   MPI_Scatter(source, n, MPI_BYTE, PyArray_BYTES(recvobj),
 	      n, MPI_BYTE, root, self->comm);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_SCATTER, n);
   Py_RETURN_NONE;
 }
 
@@ -675,9 +826,106 @@ static PyObject * mpi_allgather(MPIObject *self, PyObject *args)
   int n = PyArray_DESCR(a)->elsize;
   for (int d = 0; d < PyArray_NDIM(a); d++)
     n *= PyArray_DIM(a,d);
-  // What about endianness???? 
+  // What about endianness????
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
   MPI_Allgather(PyArray_BYTES(a), n, MPI_BYTE, PyArray_BYTES(b), n,
 		MPI_BYTE, self->comm);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_ALLGATHER, n);
+  Py_RETURN_NONE;
+}
+
+// Convert a Python sequence of per-rank element counts to a freshly
+// allocated int array of length size (caller frees).  Complex arrays
+// are communicated as pairs of reals, so the counts are doubled when
+// scale is 2.
+static int* get_counts(MPIObject *self, PyObject *obj, int scale)
+{
+  PyObject *counts = PyArray_ContiguousFromAny(obj, NPY_LONG, 1, 1);
+  if (counts == NULL)
+    return NULL;
+  if (PyArray_DIM(counts, 0) != self->size)
+    {
+      Py_DECREF(counts);
+      PyErr_SetString(PyExc_ValueError,
+		      "Number of counts must equal communicator size.");
+      return NULL;
+    }
+  int* icounts = GPAW_MALLOC(int, self->size);
+  for (int r = 0; r < self->size; r++)
+    icounts[r] = ((long*)PyArray_BYTES(counts))[r] * scale;
+  Py_DECREF(counts);
+  return icounts;
+}
+
+static PyObject * mpi_reduce_scatter(MPIObject *self, PyObject *args)
+{
+  PyObject* a;
+  PyObject* b;
+  PyObject* counts_obj;
+  if (!PyArg_ParseTuple(args, "OOO:reduce_scatter", &a, &b, &counts_obj))
+    return NULL;
+  CHK_ARRAY(a);
+  CHK_ARRAY(b);
+  if (PyArray_TYPE(a) != PyArray_TYPE(b))
+    {
+      PyErr_SetString(PyExc_ValueError, "Incompatible array types.");
+      return NULL;
+    }
+  MPI_Datatype datatype = get_mpi_datatype(a);
+  if (datatype == 0)
+    return NULL;
+  int* recvcounts = get_counts(self, counts_obj, PyArray_ISCOMPLEX(a) ? 2 : 1);
+  if (recvcounts == NULL)
+    return NULL;
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
+  MPI_Reduce_scatter(PyArray_BYTES(a), PyArray_BYTES(b), recvcounts,
+		     datatype, MPI_SUM, self->comm);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_REDUCE_SCATTER, PyArray_NBYTES(a));
+  free(recvcounts);
+  Py_RETURN_NONE;
+}
+
+static PyObject * mpi_allgatherv(MPIObject *self, PyObject *args)
+{
+  PyObject* a;
+  PyObject* b;
+  PyObject* counts_obj;
+  if (!PyArg_ParseTuple(args, "OOO:all_gatherv", &a, &b, &counts_obj))
+    return NULL;
+  CHK_ARRAY(a);
+  CHK_ARRAY(b);
+  if (PyArray_TYPE(a) != PyArray_TYPE(b))
+    {
+      PyErr_SetString(PyExc_ValueError, "Incompatible array types.");
+      return NULL;
+    }
+  MPI_Datatype datatype = get_mpi_datatype(a);
+  if (datatype == 0)
+    return NULL;
+  int scale = PyArray_ISCOMPLEX(a) ? 2 : 1;
+  int* recvcounts = get_counts(self, counts_obj, scale);
+  if (recvcounts == NULL)
+    return NULL;
+  int* displs = GPAW_MALLOC(int, self->size);
+  int disp = 0;
+  for (int r = 0; r < self->size; r++)
+    {
+      displs[r] = disp;
+      disp += recvcounts[r];
+    }
+  int n = PyArray_SIZE(a) * scale;
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
+  MPI_Allgatherv(PyArray_BYTES(a), n, datatype, PyArray_BYTES(b),
+		 recvcounts, displs, datatype, self->comm);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_ALLGATHER, PyArray_NBYTES(a));
+  free(displs);
+  free(recvcounts);
   Py_RETURN_NONE;
 }
 
@@ -705,10 +953,14 @@ static PyObject * mpi_gather(MPIObject *self, PyObject *args)
   int n = PyArray_DESCR(a)->elsize;
   for (int d = 0; d < PyArray_NDIM(a); d++)
     n *= PyArray_DIM(a,d);
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
   if (root != self->rank)
     MPI_Gather(PyArray_BYTES(a), n, MPI_BYTE, 0, n, MPI_BYTE, root, self->comm);
   else
     MPI_Gather(PyArray_BYTES(a), n, MPI_BYTE, PyArray_BYTES(b), n, MPI_BYTE, root, self->comm);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_GATHER, n);
   Py_RETURN_NONE;
 }
 
@@ -726,10 +978,137 @@ static PyObject * mpi_broadcast(MPIObject *self, PyObject *args)
   int n = PyArray_DESCR(buf)->elsize;
   for (int d = 0; d < PyArray_NDIM(buf); d++)
     n *= PyArray_DIM(buf,d);
+  STATS_T0;
+  Py_BEGIN_ALLOW_THREADS;
   MPI_Bcast(PyArray_BYTES(buf), n, MPI_BYTE, root, self->comm);
+  Py_END_ALLOW_THREADS;
+  STATS_RECORD(self, GPAW_MPI_BCAST, n);
   Py_RETURN_NONE;
 }
 
+// Build a request object of the kind mpi_send/mpi_receive return.
+// Steals the reference to keep (the buffer kept alive until
+// wait/waitall releases it).
+static PyObject * mpi_request_object(MPI_Request rq, PyObject *keep)
+{
+  mpi_request req;
+  req.rq = rq;
+  req.buffer = keep;
+  return Py_BuildValue("s#", &req, sizeof(req));
+}
+
+// Nonblocking collectives (MPI >= 3).  Without GPAW_MPI3 the operation
+// completes before returning and the request is trivially waitable, so
+// callers can use the overlapped code path unconditionally.
+
+static PyObject * mpi_isum(MPIObject *self, PyObject *args, PyObject *kwargs)
+{
+  PyObject* obj;
+  int root = -1;
+  static char *kwlist[] = {"a", "root", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i:isum", kwlist,
+                                   &obj, &root))
+    return NULL;
+  CHK_PROC_DEF(root);
+  CHK_ARRAY(obj);  // Scalars cannot be summed in place; use a 0-d array.
+  MPI_Datatype datatype = get_mpi_datatype(obj);
+  if (datatype == 0)
+    return NULL;
+  int n = PyArray_SIZE(obj);
+  int elemsize = PyArray_DESCR(obj)->elsize;
+  if (PyArray_ISCOMPLEX(obj))
+    {
+      n *= 2;
+      elemsize /= 2;
+    }
+  MPI_Request rq = MPI_REQUEST_NULL;
+#ifdef GPAW_MPI3
+  if (root == -1)
+    MPI_Iallreduce(MPI_IN_PLACE, PyArray_BYTES(obj), n, datatype, MPI_SUM,
+                   self->comm, &rq);
+  else if (self->rank == root)
+    MPI_Ireduce(MPI_IN_PLACE, PyArray_BYTES(obj), n, datatype, MPI_SUM,
+                root, self->comm, &rq);
+  else
+    MPI_Ireduce(PyArray_BYTES(obj), 0, n, datatype, MPI_SUM,
+                root, self->comm, &rq);
+#else
+  Py_BEGIN_ALLOW_THREADS;
+  char* b = GPAW_MALLOC(char, n * elemsize);
+  if (root == -1)
+    MPI_Allreduce(PyArray_BYTES(obj), b, n, datatype, MPI_SUM, self->comm);
+  else
+    MPI_Reduce(PyArray_BYTES(obj), b, n, datatype, MPI_SUM, root,
+               self->comm);
+  if (root == -1 || self->rank == root)
+    memcpy(PyArray_BYTES(obj), b, n * elemsize);
+  free(b);
+  Py_END_ALLOW_THREADS;
+#endif
+  Py_INCREF(obj);
+  return mpi_request_object(rq, obj);
+}
+
+static PyObject * mpi_ibroadcast(MPIObject *self, PyObject *args)
+{
+  PyObject* buf;
+  int root;
+  if (!PyArg_ParseTuple(args, "Oi:ibroadcast", &buf, &root))
+    return NULL;
+  CHK_ARRAY(buf);
+  CHK_PROC(root);
+  int n = PyArray_DESCR(buf)->elsize;
+  for (int d = 0; d < PyArray_NDIM(buf); d++)
+    n *= PyArray_DIM(buf,d);
+  MPI_Request rq = MPI_REQUEST_NULL;
+#ifdef GPAW_MPI3
+  MPI_Ibcast(PyArray_BYTES(buf), n, MPI_BYTE, root, self->comm, &rq);
+#else
+  Py_BEGIN_ALLOW_THREADS;
+  MPI_Bcast(PyArray_BYTES(buf), n, MPI_BYTE, root, self->comm);
+  Py_END_ALLOW_THREADS;
+#endif
+  Py_INCREF(buf);
+  return mpi_request_object(rq, buf);
+}
+
+static PyObject * mpi_igather(MPIObject *self, PyObject *args)
+{
+  PyObject* a;
+  int root;
+  PyObject* b = 0;
+  if (!PyArg_ParseTuple(args, "Oi|O:igather", &a, &root, &b))
+    return NULL;
+  CHK_ARRAY(a);
+  CHK_PROC(root);
+  if (root == self->rank)
+    {
+      CHK_ARRAY(b);
+      CHK_ARRAYS(a, b, self->size);
+    }
+  int n = PyArray_DESCR(a)->elsize;
+  for (int d = 0; d < PyArray_NDIM(a); d++)
+    n *= PyArray_DIM(a,d);
+  char* recv = (root == self->rank) ? PyArray_BYTES(b) : 0;
+  MPI_Request rq = MPI_REQUEST_NULL;
+#ifdef GPAW_MPI3
+  MPI_Igather(PyArray_BYTES(a), n, MPI_BYTE, recv, n, MPI_BYTE, root,
+              self->comm, &rq);
+#else
+  Py_BEGIN_ALLOW_THREADS;
+  MPI_Gather(PyArray_BYTES(a), n, MPI_BYTE, recv, n, MPI_BYTE, root,
+             self->comm);
+  Py_END_ALLOW_THREADS;
+#endif
+  // Keep both arrays alive until the request is waited on:
+  PyObject* keep;
+  if (root == self->rank)
+    keep = Py_BuildValue("(OO)", a, b);
+  else
+    keep = Py_BuildValue("(O)", a);
+  return mpi_request_object(rq, keep);
+}
+
 static PyObject * get_members(MPIObject *self, PyObject *args)
 {
   PyArrayObject *ranks;
@@ -754,6 +1133,7 @@ static PyObject * get_c_object(MPIObject *self, PyObject *args)
 // that needs MPI_getattr that needs MPI_Methods that need
 // MPI_Communicator that need ...
 static PyObject * MPICommunicator(MPIObject *self, PyObject *args);
+static PyObject * mpi_cart_create(MPIObject *self, PyObject *args);
 
 static PyMethodDef mpi_methods[] = {
     {"sendreceive",          (PyCFunction)mpi_sendreceive,
@@ -800,8 +1180,23 @@ static PyMethodDef mpi_methods[] = {
      "gather(src, root, target=None) gathers data from all tasks on root task."},
     {"all_gather",       (PyCFunction)mpi_allgather,    METH_VARARGS,
      "all_gather(src, target) gathers data from all tasks on all tasks."},
+    {"all_gatherv",      (PyCFunction)mpi_allgatherv,   METH_VARARGS,
+     "all_gatherv(src, target, counts) gathers blocks of varying size from all tasks on all tasks."},
+    {"reduce_scatter",   (PyCFunction)mpi_reduce_scatter, METH_VARARGS,
+     "reduce_scatter(src, target, counts) sums arrays and scatters blocks of the result."},
     {"broadcast",        (PyCFunction)mpi_broadcast,    METH_VARARGS,
      "broadcast(buffer, root) Broadcast data in-place from root task."},
+    {"isum",             (PyCFunction)mpi_isum,
+     METH_VARARGS|METH_KEYWORDS,
+     "isum(a, root=-1) starts a nonblocking in-place array sum; returns a request for wait()/waitall()."},
+    {"ibroadcast",       (PyCFunction)mpi_ibroadcast,   METH_VARARGS,
+     "ibroadcast(buffer, root) starts a nonblocking in-place broadcast; returns a request for wait()/waitall()."},
+    {"igather",          (PyCFunction)mpi_igather,      METH_VARARGS,
+     "igather(src, root, target=None) starts a nonblocking gather on root task; returns a request for wait()/waitall()."},
+    {"cart_create",      (PyCFunction)mpi_cart_create,  METH_VARARGS,
+     "cart_create(parsize, periods, reorder=1) creates a Cartesian communicator, possibly with reordered ranks."},
+    {"get_stats",        (PyCFunction)mpi_get_stats,    METH_VARARGS,
+     "get_stats() returns the recorded communication statistics as a dict (see _gpaw.mpi_stats_enable())."},
     {"get_members",      (PyCFunction)get_members,      METH_VARARGS, 0},
     {"get_c_object",     (PyCFunction)get_c_object,     METH_VARARGS, 0},
     {"new_communicator", (PyCFunction)MPICommunicator,  METH_VARARGS,
@@ -839,6 +1234,7 @@ static PyObject *NewMPIObject(PyTypeObject* type, PyObject *args, PyObject *kwds
     return NULL;
   for (int i=0; i<self->size; i++)
     self->members[i] = i;
+  memset(self->stats, 0, sizeof(self->stats));
 
   return (PyObject *) self;
 }
@@ -968,6 +1364,7 @@ static PyObject * MPICommunicator(MPIObject *self, PyObject *args)
         return NULL;
       memcpy(obj->members, (int *) PyArray_BYTES(iranks), obj->size*sizeof(int));
       Py_DECREF(iranks);
+      memset(obj->stats, 0, sizeof(obj->stats));
 
       // Make sure that MPI_COMM_WORLD is kept alive till the end (we
       // don't want MPI_Finalize to be called before MPI_Comm_free):
@@ -976,4 +1373,61 @@ static PyObject * MPICommunicator(MPIObject *self, PyObject *args)
       return (PyObject*)obj;
     }
 }
+
+static PyObject * mpi_cart_create(MPIObject *self, PyObject *args)
+{
+  int dims[3];
+  int periods[3];
+  int reorder = 1;
+  if (!PyArg_ParseTuple(args, "(iii)(iii)|i:cart_create",
+                        &dims[0], &dims[1], &dims[2],
+                        &periods[0], &periods[1], &periods[2], &reorder))
+    return NULL;
+  if (dims[0] * dims[1] * dims[2] != self->size)
+    {
+      PyErr_SetString(PyExc_ValueError,
+                      "dimensions do not match communicator size");
+      return NULL;
+    }
+  MPI_Comm comm;
+  // With reorder enabled the MPI library may renumber the ranks to
+  // match the machine topology, so that neighbors in the process grid
+  // end up close on the network:
+  MPI_Cart_create(self->comm, 3, dims, periods, reorder, &comm);
+#ifdef GPAW_MPI_DEBUG
+  // Default Errhandler is MPI_ERRORS_ARE_FATAL
+  MPI_Errhandler_set(comm, MPI_ERRORS_RETURN);
+#endif
+  if (comm == MPI_COMM_NULL)
+    Py_RETURN_NONE;
+  MPIObject *obj = PyObject_NEW(MPIObject, &MPIType);
+  if (obj == NULL)
+    return NULL;
+  MPI_Comm_size(comm, &(obj->size));
+  MPI_Comm_rank(comm, &(obj->rank));
+  obj->comm = comm;
+  obj->members = (int*) malloc(obj->size*sizeof(int));
+  if (obj->members == NULL)
+    return NULL;
+  memset(obj->stats, 0, sizeof(obj->stats));
+  // The ranks may have been permuted - map them back to the old ones:
+  MPI_Group group;
+  MPI_Group cartgroup;
+  MPI_Comm_group(self->comm, &group);
+  MPI_Comm_group(comm, &cartgroup);
+  int* cartranks = GPAW_MALLOC(int, obj->size);
+  for (int i = 0; i < obj->size; i++)
+    cartranks[i] = i;
+  MPI_Group_translate_ranks(cartgroup, obj->size, cartranks, group,
+                            obj->members);
+  free(cartranks);
+  MPI_Group_free(&cartgroup);
+  MPI_Group_free(&group);
+
+  // Make sure that MPI_COMM_WORLD is kept alive till the end (we
+  // don't want MPI_Finalize to be called before MPI_Comm_free):
+  Py_INCREF(self);
+  obj->parent = (PyObject*)self;
+  return (PyObject*)obj;
+}
 #endif //PARALLEL
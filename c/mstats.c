@@ -0,0 +1,157 @@
+/*  Copyright (C) 2003-2007  CAMP
+ *  Copyright (C) 2007-2008  CAMd
+ *  Please see the accompanying LICENSE file for further information. */
+
+// Allocation accounting for GPAW_MALLOC.  When the extension is
+// compiled with GPAW_MALLOC_STATS (see extensions.h), every
+// GPAW_MALLOC is tagged with its call site and every free() in code
+// that includes extensions.h is matched against the outstanding
+// allocations, so live bytes and the high-water mark are known per
+// call site.  _gpaw.memory_stats() returns the numbers as a dict
+// keyed by 'file:line'; without the accounting mode the dict is
+// empty.  Pointers from plain malloc (or Python/numpy) pass through
+// gpaw_free_tagged untouched.
+
+#include <Python.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <assert.h>
+
+// Call-site tags (linear scan - allocations are rare; the hot buffers
+// are reused through gpaw_workbuf):
+#define GPAW_MSTATS_NTAGS 512
+
+typedef struct
+{
+  const char* file;
+  int line;
+  long long live;
+  long long high_water;
+  long long calls;
+} mstats_tag;
+
+// Open-addressed table of outstanding allocations; removed entries
+// become tombstones so the probe chains stay intact:
+#define GPAW_MSTATS_NPTRS (1 << 18)
+#define MSTATS_TOMBSTONE ((void*)1)
+
+typedef struct
+{
+  void* p;
+  size_t nbytes;
+  int tag;
+} mstats_ptr;
+
+static mstats_tag tags[GPAW_MSTATS_NTAGS];
+static int ntags = 0;
+static mstats_ptr ptrs[GPAW_MSTATS_NPTRS];
+static long long nlost = 0;  // allocations dropped on table overflow
+static pthread_mutex_t mstats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int tag_index(const char* file, int line)
+{
+  for (int t = 0; t < ntags; t++)
+    if (tags[t].line == line && strcmp(tags[t].file, file) == 0)
+      return t;
+  if (ntags == GPAW_MSTATS_NTAGS)
+    return -1;
+  tags[ntags].file = file;
+  tags[ntags].line = line;
+  return ntags++;
+}
+
+static int ptr_slot(void* p)
+{
+  return (int)(((size_t)p >> 4) * 2654435761u % GPAW_MSTATS_NPTRS);
+}
+
+void* gpaw_malloc_tagged(size_t nbytes, const char* file, int line)
+{
+  void* p = malloc(nbytes);
+  assert(p != NULL);
+  pthread_mutex_lock(&mstats_lock);
+  int t = tag_index(file, line);
+  int slot = -1;
+  if (t >= 0)
+    {
+      int i = ptr_slot(p);
+      for (int probe = 0; probe < GPAW_MSTATS_NPTRS; probe++)
+        {
+          if (ptrs[i].p == NULL || ptrs[i].p == MSTATS_TOMBSTONE)
+            {
+              slot = i;
+              break;
+            }
+          i = (i + 1) % GPAW_MSTATS_NPTRS;
+        }
+    }
+  if (slot >= 0)
+    {
+      ptrs[slot].p = p;
+      ptrs[slot].nbytes = nbytes;
+      ptrs[slot].tag = t;
+      tags[t].calls++;
+      tags[t].live += nbytes;
+      if (tags[t].live > tags[t].high_water)
+        tags[t].high_water = tags[t].live;
+    }
+  else
+    nlost++;
+  pthread_mutex_unlock(&mstats_lock);
+  return p;
+}
+
+void gpaw_free_tagged(void* p)
+{
+  if (p == NULL)
+    return;
+  pthread_mutex_lock(&mstats_lock);
+  int i = ptr_slot(p);
+  for (int probe = 0; probe < GPAW_MSTATS_NPTRS; probe++)
+    {
+      if (ptrs[i].p == p)
+        {
+          tags[ptrs[i].tag].live -= ptrs[i].nbytes;
+          ptrs[i].p = MSTATS_TOMBSTONE;
+          break;
+        }
+      if (ptrs[i].p == NULL)  // not one of ours
+        break;
+      i = (i + 1) % GPAW_MSTATS_NPTRS;
+    }
+  pthread_mutex_unlock(&mstats_lock);
+  free(p);
+}
+
+PyObject* memory_stats(PyObject *self, PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+  PyObject* dict = PyDict_New();
+  if (dict == NULL)
+    return NULL;
+  char key[1024];
+  pthread_mutex_lock(&mstats_lock);
+  for (int t = 0; t < ntags; t++)
+    {
+      snprintf(key, sizeof(key), "%s:%d", tags[t].file, tags[t].line);
+      PyObject* entry = Py_BuildValue("{s:L,s:L,s:L}",
+                                      "live", tags[t].live,
+                                      "high_water", tags[t].high_water,
+                                      "calls", tags[t].calls);
+      PyDict_SetItemString(dict, key, entry);
+      Py_DECREF(entry);
+    }
+  if (nlost > 0)
+    {
+      PyObject* entry = Py_BuildValue("{s:L,s:L,s:L}",
+                                      "live", 0LL, "high_water", 0LL,
+                                      "calls", nlost);
+      PyDict_SetItemString(dict, "(untracked)", entry);
+      Py_DECREF(entry);
+    }
+  pthread_mutex_unlock(&mstats_lock);
+  return dict;
+}
@@ -1,6 +1,40 @@
 /*  Copyright (C) 2003-2007  CAMP
  *  Please see the accompanying LICENSE file for further information. */
 
+// Communication statistics, recorded per communicator and operation
+// type when enabled at runtime (see mpi_stats_enable in mpi.c).  The
+// size histogram bins are log2(message bytes) with the last bin
+// collecting everything larger; the latency bins are decades from
+// less than 1 us to 1 s and more.
+#define GPAW_MPI_NSIZEBINS 22
+#define GPAW_MPI_NTIMEBINS 8
+
+typedef struct
+{
+  long long count;
+  long long nbytes;
+  double time;
+  long long sizehist[GPAW_MPI_NSIZEBINS];
+  long long timehist[GPAW_MPI_NTIMEBINS];
+} gpaw_mpi_opstats;
+
+// Operation types with separately recorded statistics:
+enum
+{
+  GPAW_MPI_SEND,
+  GPAW_MPI_RECV,
+  GPAW_MPI_SENDRECV,
+  GPAW_MPI_REDUCE,
+  GPAW_MPI_BCAST,
+  GPAW_MPI_SCATTER,
+  GPAW_MPI_GATHER,
+  GPAW_MPI_ALLGATHER,
+  GPAW_MPI_REDUCE_SCATTER,
+  GPAW_MPI_WAIT,
+  GPAW_MPI_BARRIER,
+  GPAW_MPI_NOPS
+};
+
 typedef struct
 {
   PyObject_HEAD
@@ -9,5 +43,6 @@ typedef struct
   MPI_Comm comm;
   PyObject* parent;
   int* members;
+  gpaw_mpi_opstats stats[GPAW_MPI_NOPS];
 } MPIObject;
 
@@ -18,17 +18,23 @@
 #include <numpy/arrayobject.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sys/time.h>
 #include "extensions.h"
+#include "threadpool.h"
 #include "bc.h"
 #include "mympi.h"
+#include "perf.h"
 
-#ifdef GPAW_ASYNC
-  #define GPAW_ASYNC3 3
-  #define GPAW_ASYNC2 2
-#else
-  #define GPAW_ASYNC3 1
-  #define GPAW_ASYNC2 1
-#endif
+// Buffer replication factors for the overlapping workers: three axes
+// in flight at once, double-buffered over chunks.  Whether the
+// overlapping path is used is a runtime property of each operator
+// (self->async); GPAW_ASYNC only selects the default.
+#define GPAW_ASYNC3 3
+#define GPAW_ASYNC2 2
+// Default number of bands whose halos are exchanged together (one
+// message set per chunk instead of one per band); GPAW_CHUNK_SIZE in
+// the environment overrides it:
+#define GPAW_CHUNK_DEFAULT 10
 
 typedef struct
 {
@@ -37,15 +43,111 @@ typedef struct
   boundary_conditions* bc;
   MPI_Request recvreq[2];
   MPI_Request sendreq[2];
+  int async;
+  // Work buffers reused between apply/relax calls (gpaw_workbuf):
+  double* work_buf;
+  double* work_send;
+  double* work_recv;
+  long nwork_buf;
+  long nwork_send;
+  long nwork_recv;
+  // Counter totals for apply/relax calls (see perf.h):
+  gpaw_perf_t perf;
 } OperatorObject;
 
 static void Operator_dealloc(OperatorObject *self)
 {
+  free(self->work_recv);
+  free(self->work_send);
+  free(self->work_buf);
   free(self->bc);
   PyObject_DEL(self);
 }
 
 
+/* Construction-time autotuning of the stencil traversal.  The best i1
+ * tile size differs between CPU generations, so on the first operator
+ * built for a given (grid, stencil) shape we time a few candidates on
+ * scratch arrays and cache the winner for the rest of the process.
+ * Set GPAW_AUTOTUNE=0 to keep the cache-size heuristic. */
+
+#define GPAW_NTUNED 32
+static struct
+{
+  long n0, n1, n2, j2;
+  int ncoefs;
+  long tile0;
+} tuned_shapes[GPAW_NTUNED];
+static int ntuned = 0;
+
+static double tune_walltime(void)
+{
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 1e-6 * t.tv_usec;
+}
+
+static void autotune_stencil(bmgsstencil* s)
+{
+  if (getenv("GPAW_AUTOTUNE") != NULL && atoi(getenv("GPAW_AUTOTUNE")) == 0)
+    return;
+  long ngrid = s->n[0] * s->n[1] * s->n[2];
+  if (ngrid < 32 * 32 * 32)
+    return;     // too small to time reliably; the heuristic is fine
+  for (int i = 0; i < ntuned; i++)
+    if (tuned_shapes[i].n0 == s->n[0] && tuned_shapes[i].n1 == s->n[1] &&
+        tuned_shapes[i].n2 == s->n[2] && tuned_shapes[i].j2 == s->j[2] &&
+        tuned_shapes[i].ncoefs == s->ncoefs)
+      {
+        s->tile[0] = tuned_shapes[i].tile0;
+        return;
+      }
+
+  long next = s->j[0] + s->n[0] * (s->j[1] + s->n[1] * (s->j[2] + s->n[2]));
+  double* a = (double*)calloc(next, sizeof(double));
+  double* b = (double*)malloc(ngrid * sizeof(double));
+  if (a == NULL || b == NULL)
+    {
+      free(a);
+      free(b);
+      return;
+    }
+  long candidates[3] = {s->tile[0], (s->tile[0] + s->n[1]) / 2, s->n[1]};
+  long best = s->tile[0];
+  double tbest = 1e30;
+  for (int v = 0; v < 3; v++)
+    {
+      s->tile[0] = candidates[v];
+      bmgs_fd(s, a, b);   // warm up caches for this variant
+      double t0 = tune_walltime();
+      bmgs_fd(s, a, b);
+      double t = tune_walltime() - t0;
+      if (t < tbest)
+        {
+          tbest = t;
+          best = candidates[v];
+        }
+    }
+  free(a);
+  free(b);
+  s->tile[0] = best;
+  if (ntuned < GPAW_NTUNED)
+    {
+      tuned_shapes[ntuned].n0 = s->n[0];
+      tuned_shapes[ntuned].n1 = s->n[1];
+      tuned_shapes[ntuned].n2 = s->n[2];
+      tuned_shapes[ntuned].j2 = s->j[2];
+      tuned_shapes[ntuned].ncoefs = s->ncoefs;
+      tuned_shapes[ntuned].tile0 = best;
+      ntuned++;
+    }
+}
+
+
+/* Relax one or several functions (3-d or 4-d arrays).  With several
+ * right-hand sides the halos of all functions travel in one message
+ * set per axis and sweep, and the reused work buffers are shared, so
+ * relaxing n fields costs the latency of relaxing one. */
 static PyObject * Operator_relax(OperatorObject *self,
                                  PyObject *args)
 {
@@ -58,36 +160,62 @@ static PyObject * Operator_relax(OperatorObject *self,
                         &nrelax, &w))
     return NULL;
 
+  long long counters[GPAW_PERF_NCOUNTERS];
+  double tperf = 0;
+  if (gpaw_perf_enabled)
+    gpaw_perf_start(counters, &tperf);
+
   const boundary_conditions* bc = self->bc;
 
+  int nin = 1;
+  if (func->nd == 4)
+    nin = func->dimensions[0];
+
   double* fun = DOUBLEP(func);
   const double* src = DOUBLEP(source);
   const double_complex* ph;
 
+  const int* size1 = bc->size1;
   const int* size2 = bc->size2;
-  double* buf = GPAW_MALLOC(double, size2[0] * size2[1] * size2[2] *
-                            bc->ndouble);
-  double* sendbuf = GPAW_MALLOC(double, bc->maxsend);
-  double* recvbuf = GPAW_MALLOC(double, bc->maxrecv);
+  int ng = bc->ndouble * size1[0] * size1[1] * size1[2];
+  int ng2 = bc->ndouble * size2[0] * size2[1] * size2[2];
+  double* buf = gpaw_workbuf(&self->work_buf, &self->nwork_buf,
+                             (long)ng2 * nin);
+  double* sendbuf = gpaw_workbuf(&self->work_send, &self->nwork_send,
+                                 (long)bc->maxsend * nin);
+  double* recvbuf = gpaw_workbuf(&self->work_recv, &self->nwork_recv,
+                                 (long)bc->maxrecv * nin);
 
   ph = 0;
 
+  // Residual norm as seen during the final sweep - a free convergence
+  // measure for the multigrid driver (local part; callers reduce):
+  double norm = 0.0;
   for (int n = 0; n < nrelax; n++ )
     {
       for (int i = 0; i < 3; i++)
         {
           bc_unpack1(bc, fun, buf, i,
                self->recvreq, self->sendreq,
-               recvbuf, sendbuf, ph + 2 * i, 0, 1);
+               recvbuf, sendbuf, ph + 2 * i, 0, nin);
           bc_unpack2(bc, buf, i,
-               self->recvreq, self->sendreq, recvbuf, 1);
+               self->recvreq, self->sendreq, recvbuf, 0, nin);
         }
-      bmgs_relax(relax_method, &self->stencil, buf, fun, src, w);
+      norm = 0.0;
+      for (int m = 0; m < nin; m++)
+        norm += bmgs_relax(relax_method, &self->stencil, buf + m * ng2,
+                           fun + m * ng, src + m * ng, w);
     }
-  free(recvbuf);
-  free(sendbuf);
-  free(buf);
-  Py_RETURN_NONE;
+  if (gpaw_perf_enabled) {
+    gpaw_perf_stop(&self->perf, counters, tperf);
+    // Streaming model per sweep: padded read, source read, field
+    // read/write, 2 * ncoefs + 6 flops per point (see perf.h):
+    const long* n = self->stencil.n;
+    long long ngint = (long long)n[0] * n[1] * n[2];
+    gpaw_perf_model(&self->perf, 32LL * nrelax * nin * ngint,
+                    (2LL * self->stencil.ncoefs + 6) * nrelax * nin * ngint);
+  }
+  return PyFloat_FromDouble(norm);
 }
 
 struct apply_args{
@@ -103,8 +231,89 @@ struct apply_args{
   double* out;
   int real;
   const double_complex* ph;
+  const double* eps;
+  // This thread's slices of the operator's reused work buffers:
+  double* buf;
+  double* sendbuf;
+  double* recvbuf;
 };
 
+//Worker for the fused apply-and-subtract entry point: computes
+//out = (stencil - eps_n) in for each band by folding eps_n into the
+//central stencil coefficient, so the residual costs a single pass
+//over the grid instead of an apply followed by an axpy.
+void *residual_worker(void *threadarg)
+{
+  struct apply_args *args = (struct apply_args *) threadarg;
+  boundary_conditions* bc = args->self->bc;
+  MPI_Request recvreq[2];
+  MPI_Request sendreq[2];
+
+  int chunksize = args->nin / args->nthds;
+  if (!chunksize)
+    chunksize = 1;
+  int nstart = args->thread_id * chunksize;
+  if (nstart >= args->nin)
+    return NULL;
+  int nend = nstart + chunksize;
+  if (nend > args->nin)
+    nend = args->nin;
+  if (chunksize > args->chunksize)
+    chunksize = args->chunksize;
+
+  double* sendbuf = args->sendbuf;
+  double* recvbuf = args->recvbuf;
+  double* buf = args->buf;
+
+  // Thread-private stencil copy whose central coefficient is patched
+  // per band (the coefficient array is shared between threads):
+  bmgsstencil stencil = args->self->stencil;
+  double* coefs = GPAW_MALLOC(double, stencil.ncoefs);
+  memcpy(coefs, stencil.coefs, stencil.ncoefs * sizeof(double));
+  stencil.coefs = coefs;
+  int icenter = -1;
+  for (int c = 0; c < stencil.ncoefs; c++)
+    if (stencil.offsets[c] == 0)
+      icenter = c;
+  double coef0 = (icenter >= 0) ? coefs[icenter] : 0.0;
+  double lcoef0 = stencil.lcoefs[0];
+
+  for (int n = nstart; n < nend; n += chunksize)
+    {
+      if (n + chunksize >= nend && chunksize > 1)
+        chunksize = nend - n;
+      const double* in = args->in + n * args->ng;
+      double* out = args->out + n * args->ng;
+      for (int i = 0; i < 3; i++)
+        {
+          bc_unpack1(bc, in, buf, i,
+                     recvreq, sendreq,
+                     recvbuf, sendbuf, args->ph + 2 * i,
+                     args->thread_id, chunksize);
+          bc_unpack2(bc, buf, i, recvreq, sendreq, recvbuf,
+                     args->thread_id, chunksize);
+        }
+      for (int m = 0; m < chunksize; m++)
+        {
+          double eps = args->eps[n + m];
+          if (icenter >= 0)
+            coefs[icenter] = coef0 - eps;
+          stencil.lcoefs[0] = lcoef0 - eps;
+          if (args->real)
+            bmgs_fd(&stencil, buf + m * args->ng2, out + m * args->ng);
+          else
+            bmgs_fdz(&stencil, (const double_complex*) (buf + m * args->ng2),
+                               (double_complex*) (out + m * args->ng));
+          if (icenter < 0 && stencil.range == 0)
+            // Stencil without a central point: subtract explicitly.
+            for (int g = 0; g < args->ng; g++)
+              out[m * args->ng + g] -= eps * in[m * args->ng + g];
+        }
+    }
+  free(coefs);
+  return NULL;
+}
+
 //Plain worker
 void *apply_worker(void *threadarg)
 {
@@ -125,9 +334,9 @@ void *apply_worker(void *threadarg)
   if (chunksize > args->chunksize)
     chunksize = args->chunksize;
 
-  double* sendbuf = GPAW_MALLOC(double, bc->maxsend * args->chunksize);
-  double* recvbuf = GPAW_MALLOC(double, bc->maxrecv * args->chunksize);
-  double* buf = GPAW_MALLOC(double, args->ng2 * args->chunksize);
+  double* sendbuf = args->sendbuf;
+  double* recvbuf = args->recvbuf;
+  double* buf = args->buf;
 
   for (int n = nstart; n < nend; n += chunksize)
     {
@@ -141,18 +350,17 @@ void *apply_worker(void *threadarg)
                      recvreq, sendreq,
                      recvbuf, sendbuf, args->ph + 2 * i,
                      args->thread_id, chunksize);
-          bc_unpack2(bc, buf, i, recvreq, sendreq, recvbuf, chunksize);
+          bc_unpack2(bc, buf, i, recvreq, sendreq, recvbuf,
+                     args->thread_id, chunksize);
         }
-      for (int m = 0; m < chunksize; m++)
-        if (args->real)
-          bmgs_fd(&args->self->stencil, buf + m * args->ng2, out + m * args->ng);
-        else
-          bmgs_fdz(&args->self->stencil, (const double_complex*) (buf + m * args->ng2),
-                                         (double_complex*) (out + m * args->ng));
+      if (args->real)
+        bmgs_fdm(&args->self->stencil, chunksize, args->ng2, args->ng,
+                 buf, out);
+      else
+        bmgs_fdmz(&args->self->stencil, chunksize, args->ng2 / 2,
+                  args->ng / 2,
+                  (const double_complex*) buf, (double_complex*) out);
     }
-  free(buf);
-  free(recvbuf);
-  free(sendbuf);
   return NULL;
 }
 
@@ -176,11 +384,9 @@ void *apply_worker_cfd_async(void *threadarg)
   if (chunksize > args->chunksize)
     chunksize = args->chunksize;
 
-  double* sendbuf = GPAW_MALLOC(double, bc->maxsend * GPAW_ASYNC3 *
-                                args->chunksize);
-  double* recvbuf = GPAW_MALLOC(double, bc->maxrecv * GPAW_ASYNC3 *
-                                args->chunksize);
-  double* buf = GPAW_MALLOC(double, args->ng2 * args->chunksize);
+  double* sendbuf = args->sendbuf;
+  double* recvbuf = args->recvbuf;
+  double* buf = args->buf;
 
   for (int n = nstart; n < nend; n += chunksize)
     {
@@ -200,18 +406,17 @@ void *apply_worker_cfd_async(void *threadarg)
         {
           bc_unpack2(bc, buf, i,
                      recvreq + i * 2, sendreq + i * 2,
-                     recvbuf + i * bc->maxrecv * chunksize, chunksize);
+                     recvbuf + i * bc->maxrecv * chunksize,
+                     args->thread_id, chunksize);
         }
-      for (int m = 0; m < chunksize; m++)
-        if (args->real)
-          bmgs_fd(&args->self->stencil, buf + m * args->ng2, out + m * args->ng);
-        else
-          bmgs_fdz(&args->self->stencil, (const double_complex*) (buf + m * args->ng2),
-                                         (double_complex*) (out + m * args->ng));
+      if (args->real)
+        bmgs_fdm(&args->self->stencil, chunksize, args->ng2, args->ng,
+                 buf, out);
+      else
+        bmgs_fdmz(&args->self->stencil, chunksize, args->ng2 / 2,
+                  args->ng / 2,
+                  (const double_complex*) buf, (double_complex*) out);
     }
-  free(buf);
-  free(recvbuf);
-  free(sendbuf);
   return NULL;
 }
 
@@ -236,14 +441,12 @@ void *apply_worker_cfd(void *threadarg)
     chunksize = args->chunksize;
 
   int chunk = args->chunkinc;
-  if (chunk > chunksize);
+  if (chunk > chunksize)
     chunk = chunksize;
 
-  double* sendbuf = GPAW_MALLOC(double, bc->maxsend * args->chunksize
-                                * GPAW_ASYNC3 * GPAW_ASYNC2);
-  double* recvbuf = GPAW_MALLOC(double, bc->maxrecv * args->chunksize
-                                * GPAW_ASYNC3 * GPAW_ASYNC2);
-  double* buf = GPAW_MALLOC(double, args->ng2 * args->chunksize * GPAW_ASYNC2);
+  double* sendbuf = args->sendbuf;
+  double* recvbuf = args->recvbuf;
+  double* buf = args->buf;
 
   int odd = 0;
   const double* in = args->in + nstart * args->ng;
@@ -259,7 +462,7 @@ void *apply_worker_cfd(void *threadarg)
   for (int n = nstart+chunk; n < nend; n += chunk)
     {
       last_chunk += args->chunkinc;
-      if (last_chunk > chunksize);
+      if (last_chunk > chunksize)
         last_chunk = chunksize;
 
       if (n + last_chunk >= nend && last_chunk > 1)
@@ -279,15 +482,16 @@ void *apply_worker_cfd(void *threadarg)
         {
           bc_unpack2(bc, buf + odd * args->ng2 * chunksize, i,
                      recvreq + odd * 2 + i * 4, sendreq + odd * 2 + i * 4,
-                     recvbuf + odd * bc->maxrecv * chunksize + i * bc->maxrecv * chunksize * GPAW_ASYNC2, chunk);
+                     recvbuf + odd * bc->maxrecv * chunksize + i * bc->maxrecv * chunksize * GPAW_ASYNC2,
+                     args->thread_id, chunk);
         }
-      for (int m = 0; m < chunk; m++)
-        if (args->real)
-          bmgs_fd(&args->self->stencil, buf + m * args->ng2 + odd * args->ng2 * chunksize,
-                                        out + m * args->ng);
-        else
-          bmgs_fdz(&args->self->stencil, (const double_complex*) (buf + m * args->ng2 + odd * args->ng2 * chunksize),
-                                         (double_complex*) (out + m * args->ng));
+      if (args->real)
+        bmgs_fdm(&args->self->stencil, chunk, args->ng2, args->ng,
+                 buf + odd * args->ng2 * chunksize, out);
+      else
+        bmgs_fdmz(&args->self->stencil, chunk, args->ng2 / 2, args->ng / 2,
+                  (const double_complex*) (buf + odd * args->ng2 * chunksize),
+                  (double_complex*) out);
       chunk = last_chunk;
     }
 
@@ -297,22 +501,97 @@ void *apply_worker_cfd(void *threadarg)
     {
       bc_unpack2(bc, buf + odd * args->ng2 * chunksize, i,
                  recvreq + odd * 2 + i * 4, sendreq + odd * 2 + i * 4,
-                 recvbuf + odd * bc->maxrecv * chunksize + i * bc->maxrecv * chunksize * GPAW_ASYNC2, last_chunk);
+                 recvbuf + odd * bc->maxrecv * chunksize + i * bc->maxrecv * chunksize * GPAW_ASYNC2,
+                 args->thread_id, last_chunk);
     }
-  for (int m = 0; m < last_chunk; m++)
-    if (args->real)
-      bmgs_fd(&args->self->stencil, buf + m * args->ng2 + odd * args->ng2 * chunksize,
-                                    out + m * args->ng);
-    else
-      bmgs_fdz(&args->self->stencil, (const double_complex*) (buf + m * args->ng2 + odd * args->ng2 * chunksize),
-                                     (double_complex*) (out + m * args->ng));
-
-  free(buf);
-  free(recvbuf);
-  free(sendbuf);
+  if (args->real)
+    bmgs_fdm(&args->self->stencil, last_chunk, args->ng2, args->ng,
+             buf + odd * args->ng2 * chunksize, out);
+  else
+    bmgs_fdmz(&args->self->stencil, last_chunk, args->ng2 / 2, args->ng / 2,
+              (const double_complex*) (buf + odd * args->ng2 * chunksize),
+              (double_complex*) out);
+
   return NULL;
 }
 
+// Raw apply entry point for C callers (declared in extensions.h); the
+// Python method below is a thin wrapper around it.
+void Operator_apply_raw(PyObject* opobj, int nin, int real,
+                        const double_complex* ph,
+                        const double* in, double* out)
+{
+  OperatorObject *self = (OperatorObject*)opobj;
+  boundary_conditions* bc = self->bc;
+  const int* size1 = bc->size1;
+  const int* size2 = bc->size2;
+  int ng = bc->ndouble * size1[0] * size1[1] * size1[2];
+  int ng2 = bc->ndouble * size2[0] * size2[1] * size2[2];
+
+  int chunksize = MIN(nin, GPAW_CHUNK_DEFAULT);
+  if (getenv("GPAW_CHUNK_SIZE") != NULL)
+    chunksize = atoi(getenv("GPAW_CHUNK_SIZE"));
+
+  int chunkinc = chunksize;
+  if (getenv("GPAW_CHUNK_INC") != NULL)
+    chunkinc = atoi(getenv("GPAW_CHUNK_INC"));
+
+  int nthds = 1;
+#ifdef GPAW_OMP
+  nthds = gpaw_threadpool_size();
+#endif
+  struct apply_args *wargs = GPAW_MALLOC(struct apply_args, nthds);
+
+  void *(*worker)(void*);
+  if (bc->cfd == 0 || !self->async)
+    worker = apply_worker;
+  else
+    worker = apply_worker_cfd;
+
+  // Per-thread slices of the reused work buffers (the overlapping
+  // worker keeps all three axes in flight, double-buffered):
+  long sper = (long)bc->maxsend * chunksize;
+  long rper = (long)bc->maxrecv * chunksize;
+  long bper = (long)ng2 * chunksize;
+  if (worker == apply_worker_cfd)
+    {
+      sper *= GPAW_ASYNC3 * GPAW_ASYNC2;
+      rper *= GPAW_ASYNC3 * GPAW_ASYNC2;
+      bper *= GPAW_ASYNC2;
+    }
+  double* sendbuf = gpaw_workbuf(&self->work_send, &self->nwork_send,
+                                 sper * nthds);
+  double* recvbuf = gpaw_workbuf(&self->work_recv, &self->nwork_recv,
+                                 rper * nthds);
+  double* buf = gpaw_workbuf(&self->work_buf, &self->nwork_buf,
+                             bper * nthds);
+
+  for(int i=0; i < nthds; i++)
+    {
+      (wargs+i)->thread_id = i;
+      (wargs+i)->nthds = nthds;
+      (wargs+i)->chunksize = chunksize;
+      (wargs+i)->chunkinc = chunkinc;
+      (wargs+i)->self = self;
+      (wargs+i)->ng = ng;
+      (wargs+i)->ng2 = ng2;
+      (wargs+i)->nin = nin;
+      (wargs+i)->in = in;
+      (wargs+i)->out = out;
+      (wargs+i)->real = real;
+      (wargs+i)->ph = ph;
+      (wargs+i)->sendbuf = sendbuf + i * sper;
+      (wargs+i)->recvbuf = recvbuf + i * rper;
+      (wargs+i)->buf = buf + i * bper;
+    }
+#ifdef GPAW_OMP
+  gpaw_threadpool_run(worker, wargs, sizeof(struct apply_args), nthds);
+#else
+  worker(wargs);
+#endif
+  free(wargs);
+}
+
 static PyObject * Operator_apply(OperatorObject *self,
                                  PyObject *args)
 {
@@ -326,6 +605,46 @@ static PyObject * Operator_apply(OperatorObject *self,
   if (input->nd == 4)
     nin = input->dimensions[0];
 
+  bool real = (input->descr->type_num == PyArray_DOUBLE);
+  const double_complex* ph = (real ? 0 : COMPLEXP(phases));
+
+  long long counters[GPAW_PERF_NCOUNTERS];
+  double tperf = 0;
+  if (gpaw_perf_enabled)
+    gpaw_perf_start(counters, &tperf);
+
+  Operator_apply_raw((PyObject*)self, nin, real, ph,
+                     DOUBLEP(input), DOUBLEP(output));
+
+  if (gpaw_perf_enabled) {
+    gpaw_perf_stop(&self->perf, counters, tperf);
+    // Streaming model from the stencil shape: one padded read, one
+    // write and 2 * ncoefs flops per interior point (see perf.h):
+    const long* n = self->stencil.n;
+    long long ng = (long long)n[0] * n[1] * n[2];
+    long long cplx = (real ? 1 : 2);
+    gpaw_perf_model(&self->perf, 16 * cplx * nin * ng,
+                    2 * cplx * self->stencil.ncoefs * nin * ng);
+  }
+
+  Py_RETURN_NONE;
+}
+
+
+static PyObject * Operator_apply_and_subtract(OperatorObject *self,
+                                              PyObject *args)
+{
+  PyArrayObject* input;
+  PyArrayObject* output;
+  PyArrayObject* eps;
+  PyArrayObject* phases = 0;
+  if (!PyArg_ParseTuple(args, "OOO|O", &input, &output, &eps, &phases))
+    return NULL;
+
+  int nin = 1;
+  if (input->nd == 4)
+    nin = input->dimensions[0];
+
   boundary_conditions* bc = self->bc;
   const int* size1 = bc->size1;
   const int* size2 = bc->size2;
@@ -343,28 +662,37 @@ static PyObject * Operator_apply(OperatorObject *self,
   else
     ph = COMPLEXP(phases);
 
-  int chunksize = 1;
+  int chunksize = MIN(nin, GPAW_CHUNK_DEFAULT);
   if (getenv("GPAW_CHUNK_SIZE") != NULL)
     chunksize = atoi(getenv("GPAW_CHUNK_SIZE"));
 
-  int chunkinc = chunksize;
-  if (getenv("GPAW_CHUNK_INC") != NULL)
-    chunkinc = atoi(getenv("GPAW_CHUNK_INC"));
+  long long counters[GPAW_PERF_NCOUNTERS];
+  double tperf = 0;
+  if (gpaw_perf_enabled)
+    gpaw_perf_start(counters, &tperf);
 
   int nthds = 1;
 #ifdef GPAW_OMP
-  if (getenv("OMP_NUM_THREADS") != NULL)
-    nthds = atoi(getenv("OMP_NUM_THREADS"));
+  nthds = gpaw_threadpool_size();
 #endif
   struct apply_args *wargs = GPAW_MALLOC(struct apply_args, nthds);
-  pthread_t *thds = GPAW_MALLOC(pthread_t, nthds);
+
+  long sper = (long)bc->maxsend * chunksize;
+  long rper = (long)bc->maxrecv * chunksize;
+  long bper = (long)ng2 * chunksize;
+  double* sendbuf = gpaw_workbuf(&self->work_send, &self->nwork_send,
+                                 sper * nthds);
+  double* recvbuf = gpaw_workbuf(&self->work_recv, &self->nwork_recv,
+                                 rper * nthds);
+  double* buf = gpaw_workbuf(&self->work_buf, &self->nwork_buf,
+                             bper * nthds);
 
   for(int i=0; i < nthds; i++)
     {
       (wargs+i)->thread_id = i;
       (wargs+i)->nthds = nthds;
       (wargs+i)->chunksize = chunksize;
-      (wargs+i)->chunkinc = chunkinc;
+      (wargs+i)->chunkinc = chunksize;
       (wargs+i)->self = self;
       (wargs+i)->ng = ng;
       (wargs+i)->ng2 = ng2;
@@ -373,33 +701,28 @@ static PyObject * Operator_apply(OperatorObject *self,
       (wargs+i)->out = out;
       (wargs+i)->real = real;
       (wargs+i)->ph = ph;
-    }
-#ifndef GPAW_ASYNC
-  if (1)
-#else
-  if (bc->cfd == 0)
-#endif
-    {
-    #ifdef GPAW_OMP
-      for(int i=1; i < nthds; i++)
-        pthread_create(thds + i, NULL, apply_worker, (void*) (wargs+i));
-    #endif
-      apply_worker(wargs);
-    }
-  else
-    {
-    #ifdef GPAW_OMP
-      for(int i=1; i < nthds; i++)
-        pthread_create(thds + i, NULL, apply_worker_cfd, (void*) (wargs+i));
-    #endif
-      apply_worker_cfd(wargs);
+      (wargs+i)->eps = DOUBLEP(eps);
+      (wargs+i)->sendbuf = sendbuf + i * sper;
+      (wargs+i)->recvbuf = recvbuf + i * rper;
+      (wargs+i)->buf = buf + i * bper;
     }
 #ifdef GPAW_OMP
-  for(int i=1; i < nthds; i++)
-    pthread_join(*(thds+i), NULL);
+  gpaw_threadpool_run(residual_worker, wargs, sizeof(struct apply_args), nthds);
+#else
+  residual_worker(wargs);
 #endif
   free(wargs);
-  free(thds);
+
+  if (gpaw_perf_enabled) {
+    gpaw_perf_stop(&self->perf, counters, tperf);
+    // Streaming model: stencil apply plus the fused eps subtraction
+    // (padded read, source read, write; see perf.h):
+    const long* n = self->stencil.n;
+    long long ng = (long long)n[0] * n[1] * n[2];
+    long long cplx = (real ? 1 : 2);
+    gpaw_perf_model(&self->perf, 24 * cplx * nin * ng,
+                    (2 * self->stencil.ncoefs + 2) * cplx * nin * ng);
+  }
 
   Py_RETURN_NONE;
 }
@@ -420,27 +743,474 @@ static PyObject * Operator_get_diagonal_element(OperatorObject *self,
   return Py_BuildValue("d", d);
 }
 
+static PyObject * Operator_get_kernel_info(OperatorObject *self,
+                                           PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+
+  // (separable range, i1 tile size, i2 tile size) of the selected kernel:
+  return Py_BuildValue("(ill)", self->stencil.range,
+                       self->stencil.tile[0], self->stencil.tile[1]);
+}
+
 static PyObject * Operator_get_async_sizes(OperatorObject *self, PyObject *args)
 {
   if (!PyArg_ParseTuple(args, ""))
     return NULL;
 
-#ifdef GPAW_ASYNC
-  return Py_BuildValue("(iii)", 1, GPAW_ASYNC2, GPAW_ASYNC3);
+  return Py_BuildValue("(iii)", self->async, GPAW_ASYNC2, GPAW_ASYNC3);
+}
+
+static PyObject * Operator_get_stats(OperatorObject *self, PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+
+  return gpaw_perf_stats(&self->perf);
+}
+
+/* Fused residual + restriction for one multigrid level of the Poisson
+ * solver: coarse = restrict(stencil(phi) - rho).  The residual is
+ * formed in a single pass with bmgs_fd_sub and handed straight to the
+ * restrictor, so neither the subtraction nor the Python-level residual
+ * temporary costs an extra sweep over the fine grid.  Takes one field
+ * (3-d arrays) or a stack of independent fields (4-d arrays); like
+ * relax, a stack exchanges the halos of all fields in one message set
+ * per axis.  Real arrays only (the Hartree problem is real). */
+PyObject* mg_restrict_residual(PyObject *self, PyObject *args)
+{
+  PyObject* opobj;
+  PyObject* trobj;
+  PyArrayObject* phi;
+  PyArrayObject* rho;
+  PyArrayObject* work;
+  PyArrayObject* coarse;
+  if (!PyArg_ParseTuple(args, "OOOOOO", &opobj, &trobj, &phi, &rho,
+                        &work, &coarse))
+    return NULL;
+
+  OperatorObject* op = (OperatorObject*)opobj;
+  boundary_conditions* bc = op->bc;
+  const int* size1 = bc->size1;
+  const int* size2 = bc->size2;
+
+  int nin = 1;
+  if (phi->nd == 4)
+    nin = phi->dimensions[0];
+
+  long ng = bc->ndouble * size1[0] * size1[1] * size1[2];
+  long ng2 = bc->ndouble * size2[0] * size2[1] * size2[2];
+  double* buf = gpaw_workbuf(&op->work_buf, &op->nwork_buf, ng2 * nin);
+  double* sendbuf = gpaw_workbuf(&op->work_send, &op->nwork_send,
+                                 (long)bc->maxsend * nin);
+  double* recvbuf = gpaw_workbuf(&op->work_recv, &op->nwork_recv,
+                                 (long)bc->maxrecv * nin);
+  const double_complex* ph = 0;
+
+  for (int i = 0; i < 3; i++)
+    {
+      bc_unpack1(bc, DOUBLEP(phi), buf, i,
+                 op->recvreq, op->sendreq,
+                 recvbuf, sendbuf, ph + 2 * i, 0, nin);
+      bc_unpack2(bc, buf, i,
+                 op->recvreq, op->sendreq, recvbuf, 0, nin);
+    }
+  for (int m = 0; m < nin; m++)
+    bmgs_fd_sub(&op->stencil, buf + m * ng2, DOUBLEP(rho) + m * ng,
+                DOUBLEP(work) + m * ng);
+
+  Transformer_apply_raw(trobj, nin, 1, 0, DOUBLEP(work), DOUBLEP(coarse));
+
+  Py_RETURN_NONE;
+}
+
+/* Fused GGA gradient evaluation: apply three gradient operators (one
+ * per Cartesian direction) to n and accumulate sigma += |grad n|^2 in
+ * the same traversal.  The operators are built on the same grid with
+ * the same padding, so one halo exchange of n (through op0) serves all
+ * three stencils, and the squaring and summing cost no extra passes.
+ * Real arrays only (densities are real). */
+PyObject* apply_gradients(PyObject *self, PyObject *args)
+{
+  PyObject* opobj0;
+  PyObject* opobj1;
+  PyObject* opobj2;
+  PyArrayObject* n_obj;
+  PyArrayObject* gradn_obj;
+  PyArrayObject* sigma_obj;
+  if (!PyArg_ParseTuple(args, "OOOOOO", &opobj0, &opobj1, &opobj2,
+                        &n_obj, &gradn_obj, &sigma_obj))
+    return NULL;
+
+  OperatorObject* op0 = (OperatorObject*)opobj0;
+  const bmgsstencil* s0 = &op0->stencil;
+  const bmgsstencil* s1 = &((OperatorObject*)opobj1)->stencil;
+  const bmgsstencil* s2 = &((OperatorObject*)opobj2)->stencil;
+  boundary_conditions* bc = op0->bc;
+  const int* size2 = bc->size2;
+  long ng = s0->n[0] * s0->n[1] * s0->n[2];
+  double* buf = gpaw_workbuf(&op0->work_buf, &op0->nwork_buf,
+                             (long)size2[0] * size2[1] * size2[2]);
+  double* sendbuf = gpaw_workbuf(&op0->work_send, &op0->nwork_send,
+                                 bc->maxsend);
+  double* recvbuf = gpaw_workbuf(&op0->work_recv, &op0->nwork_recv,
+                                 bc->maxrecv);
+  const double_complex* ph = 0;
+
+  for (int i = 0; i < 3; i++)
+    {
+      bc_unpack1(bc, DOUBLEP(n_obj), buf, i,
+                 op0->recvreq, op0->sendreq,
+                 recvbuf, sendbuf, ph + 2 * i, 0, 1);
+      bc_unpack2(bc, buf, i,
+                 op0->recvreq, op0->sendreq, recvbuf, 0, 1);
+    }
+
+  const double* a = buf + (s0->j[0] + s0->j[1] + s0->j[2]) / 2;
+  double* g0 = DOUBLEP(gradn_obj);
+  double* g1 = g0 + ng;
+  double* g2 = g1 + ng;
+  double* sigma = DOUBLEP(sigma_obj);
+  for (int i0 = 0; i0 < s0->n[0]; i0++)
+    for (long i1 = 0; i1 < s0->n[1]; i1++)
+      {
+        const double* aa = a + i0 * (s0->j[1] + s0->n[1] *
+                                     (s0->j[2] + s0->n[2]))
+                             + i1 * (s0->j[2] + s0->n[2]);
+        long rb = (i0 * s0->n[1] + i1) * s0->n[2];
+        for (int i2 = 0; i2 < s0->n[2]; i2++)
+          {
+            double x0 = 0.0;
+            for (int c = 0; c < s0->ncoefs; c++)
+              x0 += aa[i2 + s0->offsets[c]] * s0->coefs[c];
+            double x1 = 0.0;
+            for (int c = 0; c < s1->ncoefs; c++)
+              x1 += aa[i2 + s1->offsets[c]] * s1->coefs[c];
+            double x2 = 0.0;
+            for (int c = 0; c < s2->ncoefs; c++)
+              x2 += aa[i2 + s2->offsets[c]] * s2->coefs[c];
+            g0[rb + i2] = x0;
+            g1[rb + i2] = x1;
+            g2[rb + i2] = x2;
+            sigma[rb + i2] += x0 * x0 + x1 * x1 + x2 * x2;
+          }
+      }
+
+  Py_RETURN_NONE;
+}
+
+/* Fused divergence for the GGA potential:
+ *
+ *   v += coef * sum_v d (dedsigma gradn ) / dx
+ *                           v         v      v
+ *
+ * The three products are formed once, their halos travel as three
+ * bands in a single message set, and the three stencils and the
+ * accumulation into v share one traversal. */
+PyObject* gradient_correction(PyObject *self, PyObject *args)
+{
+  PyObject* opobj0;
+  PyObject* opobj1;
+  PyObject* opobj2;
+  PyArrayObject* gradn_obj;
+  PyArrayObject* dedsigma_obj;
+  PyArrayObject* v_obj;
+  double coef;
+  if (!PyArg_ParseTuple(args, "OOOOOOd", &opobj0, &opobj1, &opobj2,
+                        &gradn_obj, &dedsigma_obj, &v_obj, &coef))
+    return NULL;
+
+  OperatorObject* op0 = (OperatorObject*)opobj0;
+  const bmgsstencil* s0 = &op0->stencil;
+  const bmgsstencil* s1 = &((OperatorObject*)opobj1)->stencil;
+  const bmgsstencil* s2 = &((OperatorObject*)opobj2)->stencil;
+  boundary_conditions* bc = op0->bc;
+  const int* size2 = bc->size2;
+  long ng = s0->n[0] * s0->n[1] * s0->n[2];
+  long ng2 = (long)size2[0] * size2[1] * size2[2];
+  double* buf = gpaw_workbuf(&op0->work_buf, &op0->nwork_buf, 3 * ng2);
+  double* sendbuf = gpaw_workbuf(&op0->work_send, &op0->nwork_send,
+                                 (long)bc->maxsend * 3);
+  double* recvbuf = gpaw_workbuf(&op0->work_recv, &op0->nwork_recv,
+                                 (long)bc->maxrecv * 3);
+  const double_complex* ph = 0;
+
+  const double* gradn = DOUBLEP(gradn_obj);
+  const double* dedsigma = DOUBLEP(dedsigma_obj);
+  double* p = GPAW_MALLOC(double, 3 * ng);
+  for (int v = 0; v < 3; v++)
+    for (long g = 0; g < ng; g++)
+      p[v * ng + g] = dedsigma[g] * gradn[v * ng + g];
+
+  for (int i = 0; i < 3; i++)
+    {
+      bc_unpack1(bc, p, buf, i,
+                 op0->recvreq, op0->sendreq,
+                 recvbuf, sendbuf, ph + 2 * i, 0, 3);
+      bc_unpack2(bc, buf, i,
+                 op0->recvreq, op0->sendreq, recvbuf, 0, 3);
+    }
+  free(p);
+
+  long half = (s0->j[0] + s0->j[1] + s0->j[2]) / 2;
+  const double* a0 = buf + half;
+  const double* a1 = buf + ng2 + half;
+  const double* a2 = buf + 2 * ng2 + half;
+  double* v_g = DOUBLEP(v_obj);
+  for (int i0 = 0; i0 < s0->n[0]; i0++)
+    for (long i1 = 0; i1 < s0->n[1]; i1++)
+      {
+        long ra = i0 * (s0->j[1] + s0->n[1] * (s0->j[2] + s0->n[2]))
+                + i1 * (s0->j[2] + s0->n[2]);
+        long rb = (i0 * s0->n[1] + i1) * s0->n[2];
+        for (int i2 = 0; i2 < s0->n[2]; i2++)
+          {
+            double x = 0.0;
+            for (int c = 0; c < s0->ncoefs; c++)
+              x += a0[ra + i2 + s0->offsets[c]] * s0->coefs[c];
+            for (int c = 0; c < s1->ncoefs; c++)
+              x += a1[ra + i2 + s1->offsets[c]] * s1->coefs[c];
+            for (int c = 0; c < s2->ncoefs; c++)
+              x += a2[ra + i2 + s2->offsets[c]] * s2->coefs[c];
+            v_g[rb + i2] += coef * x;
+          }
+      }
+
+  Py_RETURN_NONE;
+}
+
+/* Kinetic energy density from a block of bands:
+ *
+ *   taut += 0.5 sum_n f_n |grad psit_n|^2
+ *
+ * One halo exchange per chunk of bands (all bands of the chunk travel
+ * in one message set per axis, like Operator.apply) serves all three
+ * gradient stencils, and the three stencils, the squaring and the
+ * occupation-weighted accumulation share a single traversal, so no
+ * gradient array is ever written to memory.  The bands are divided
+ * over the thread pool; each thread accumulates into a private copy
+ * of taut which is reduced at the end. */
+
+struct tau_args{
+  int thread_id;
+  int nthds;
+  int chunksize;
+  OperatorObject *op0;
+  const bmgsstencil *s1;
+  const bmgsstencil *s2;
+  int nin;
+  long ng;
+  long ng2;
+  const double* in;
+  const double* f_n;
+  double* taut;  // this thread's private accumulator (ngpts doubles)
+  int real;
+  const double_complex* ph;
+  // This thread's slices of the operator's reused work buffers:
+  double* buf;
+  double* sendbuf;
+  double* recvbuf;
+};
+
+static void *tau_worker(void *threadarg)
+{
+  struct tau_args *args = (struct tau_args *) threadarg;
+  OperatorObject *op0 = args->op0;
+  boundary_conditions* bc = op0->bc;
+  const bmgsstencil* s0 = &op0->stencil;
+  const bmgsstencil* s1 = args->s1;
+  const bmgsstencil* s2 = args->s2;
+  MPI_Request recvreq[2];
+  MPI_Request sendreq[2];
+
+  int nper = (args->nin + args->nthds - 1) / args->nthds;
+  int nstart = args->thread_id * nper;
+  if (nstart >= args->nin)
+    return NULL;
+  int nend = nstart + nper;
+  if (nend > args->nin)
+    nend = args->nin;
+  int chunksize = args->chunksize;
+
+  long half = (s0->j[0] + s0->j[1] + s0->j[2]) / 2;
+
+  for (int n = nstart; n < nend; n += chunksize)
+    {
+      if (n + chunksize > nend)
+        chunksize = nend - n;
+      const double* in = args->in + n * args->ng;
+      for (int i = 0; i < 3; i++)
+        {
+          bc_unpack1(bc, in, args->buf, i,
+                     recvreq, sendreq,
+                     args->recvbuf, args->sendbuf, args->ph + 2 * i,
+                     args->thread_id, chunksize);
+          bc_unpack2(bc, args->buf, i, recvreq, sendreq, args->recvbuf,
+                     args->thread_id, chunksize);
+        }
+      for (int m = 0; m < chunksize; m++)
+        {
+          double w = 0.5 * args->f_n[n + m];
+          if (w == 0.0)
+            continue;
+          for (int i0 = 0; i0 < s0->n[0]; i0++)
+            for (long i1 = 0; i1 < s0->n[1]; i1++)
+              {
+                long ra = i0 * (s0->j[1] + s0->n[1] *
+                                (s0->j[2] + s0->n[2]))
+                        + i1 * (s0->j[2] + s0->n[2]);
+                long rb = (i0 * s0->n[1] + i1) * s0->n[2];
+                if (args->real)
+                  {
+                    const double* a = args->buf + m * args->ng2 + half;
+                    for (int i2 = 0; i2 < s0->n[2]; i2++)
+                      {
+                        double x0 = 0.0;
+                        for (int c = 0; c < s0->ncoefs; c++)
+                          x0 += a[ra + i2 + s0->offsets[c]] * s0->coefs[c];
+                        double x1 = 0.0;
+                        for (int c = 0; c < s1->ncoefs; c++)
+                          x1 += a[ra + i2 + s1->offsets[c]] * s1->coefs[c];
+                        double x2 = 0.0;
+                        for (int c = 0; c < s2->ncoefs; c++)
+                          x2 += a[ra + i2 + s2->offsets[c]] * s2->coefs[c];
+                        args->taut[rb + i2] += w * (x0 * x0 + x1 * x1 +
+                                                    x2 * x2);
+                      }
+                  }
+                else
+                  {
+                    const double_complex* a =
+                      (const double_complex*)(args->buf + m * args->ng2)
+                      + half;
+                    for (int i2 = 0; i2 < s0->n[2]; i2++)
+                      {
+                        double_complex x0 = 0.0;
+                        for (int c = 0; c < s0->ncoefs; c++)
+                          x0 += a[ra + i2 + s0->offsets[c]] * s0->coefs[c];
+                        double_complex x1 = 0.0;
+                        for (int c = 0; c < s1->ncoefs; c++)
+                          x1 += a[ra + i2 + s1->offsets[c]] * s1->coefs[c];
+                        double_complex x2 = 0.0;
+                        for (int c = 0; c < s2->ncoefs; c++)
+                          x2 += a[ra + i2 + s2->offsets[c]] * s2->coefs[c];
+                        args->taut[rb + i2] += w * (creal(x0) * creal(x0) +
+                                                    cimag(x0) * cimag(x0) +
+                                                    creal(x1) * creal(x1) +
+                                                    cimag(x1) * cimag(x1) +
+                                                    creal(x2) * creal(x2) +
+                                                    cimag(x2) * cimag(x2));
+                      }
+                  }
+              }
+        }
+    }
+  return NULL;
+}
+
+PyObject* add_kinetic_energy_density(PyObject *self, PyObject *args)
+{
+  PyObject* opobj0;
+  PyObject* opobj1;
+  PyObject* opobj2;
+  PyArrayObject* psit_obj;
+  PyArrayObject* f_obj;
+  PyArrayObject* taut_obj;
+  PyArrayObject* phases = 0;
+  if (!PyArg_ParseTuple(args, "OOOOOO|O", &opobj0, &opobj1, &opobj2,
+                        &psit_obj, &f_obj, &taut_obj, &phases))
+    return NULL;
+
+  OperatorObject* op0 = (OperatorObject*)opobj0;
+  boundary_conditions* bc = op0->bc;
+  const int* size1 = bc->size1;
+  const int* size2 = bc->size2;
+  long ngpts = (long)size1[0] * size1[1] * size1[2];
+  long ng = bc->ndouble * ngpts;
+  long ng2 = (long)bc->ndouble * size2[0] * size2[1] * size2[2];
+
+  int nin = 1;
+  if (psit_obj->nd == 4)
+    nin = psit_obj->dimensions[0];
+
+  bool real = (psit_obj->descr->type_num == PyArray_DOUBLE);
+  const double_complex* ph = (real ? 0 : COMPLEXP(phases));
+
+  int chunksize = MIN(nin, GPAW_CHUNK_DEFAULT);
+  if (getenv("GPAW_CHUNK_SIZE") != NULL)
+    chunksize = atoi(getenv("GPAW_CHUNK_SIZE"));
+
+  int nthds = 1;
+#ifdef GPAW_OMP
+  nthds = gpaw_threadpool_size();
+#endif
+  struct tau_args *wargs = GPAW_MALLOC(struct tau_args, nthds);
+
+  long sper = (long)bc->maxsend * chunksize;
+  long rper = (long)bc->maxrecv * chunksize;
+  long bper = ng2 * chunksize;
+  double* sendbuf = gpaw_workbuf(&op0->work_send, &op0->nwork_send,
+                                 sper * nthds);
+  double* recvbuf = gpaw_workbuf(&op0->work_recv, &op0->nwork_recv,
+                                 rper * nthds);
+  double* buf = gpaw_workbuf(&op0->work_buf, &op0->nwork_buf,
+                             bper * nthds);
+  double* tbuf = GPAW_MALLOC(double, ngpts * nthds);
+  memset(tbuf, 0, ngpts * nthds * sizeof(double));
+
+  for(int i=0; i < nthds; i++)
+    {
+      (wargs+i)->thread_id = i;
+      (wargs+i)->nthds = nthds;
+      (wargs+i)->chunksize = chunksize;
+      (wargs+i)->op0 = op0;
+      (wargs+i)->s1 = &((OperatorObject*)opobj1)->stencil;
+      (wargs+i)->s2 = &((OperatorObject*)opobj2)->stencil;
+      (wargs+i)->nin = nin;
+      (wargs+i)->ng = ng;
+      (wargs+i)->ng2 = ng2;
+      (wargs+i)->in = DOUBLEP(psit_obj);
+      (wargs+i)->f_n = DOUBLEP(f_obj);
+      (wargs+i)->taut = tbuf + i * ngpts;
+      (wargs+i)->real = real;
+      (wargs+i)->ph = ph;
+      (wargs+i)->sendbuf = sendbuf + i * sper;
+      (wargs+i)->recvbuf = recvbuf + i * rper;
+      (wargs+i)->buf = buf + i * bper;
+    }
+#ifdef GPAW_OMP
+  gpaw_threadpool_run(tau_worker, wargs, sizeof(struct tau_args), nthds);
 #else
-  return Py_BuildValue("(iii)", 0, GPAW_ASYNC2, GPAW_ASYNC3);
+  tau_worker(wargs);
 #endif
+
+  double* taut = DOUBLEP(taut_obj);
+  for (int i = 0; i < nthds; i++)
+    for (long g = 0; g < ngpts; g++)
+      taut[g] += tbuf[i * ngpts + g];
+
+  free(tbuf);
+  free(wargs);
+
+  Py_RETURN_NONE;
 }
 
 static PyMethodDef Operator_Methods[] = {
     {"apply",
      (PyCFunction)Operator_apply, METH_VARARGS, NULL},
+    {"apply_and_subtract",
+     (PyCFunction)Operator_apply_and_subtract, METH_VARARGS, NULL},
     {"relax",
      (PyCFunction)Operator_relax, METH_VARARGS, NULL},
     {"get_diagonal_element",
      (PyCFunction)Operator_get_diagonal_element, METH_VARARGS, NULL},
     {"get_async_sizes",
      (PyCFunction)Operator_get_async_sizes, METH_VARARGS, NULL},
+    {"get_kernel_info",
+     (PyCFunction)Operator_get_kernel_info, METH_VARARGS, NULL},
+    {"get_stats",
+     (PyCFunction)Operator_get_stats, METH_VARARGS, NULL},
     {NULL, NULL, 0, NULL}
 
 };
@@ -472,17 +1242,31 @@ PyObject * NewOperatorObject(PyObject *obj, PyObject *args)
   int real;
   PyObject* comm_obj;
   int cfd;
-  if (!PyArg_ParseTuple(args, "OOOiOiOi",
+#ifdef GPAW_ASYNC
+  int async = 1;
+#else
+  int async = 0;
+#endif
+  if (!PyArg_ParseTuple(args, "OOOiOiOi|i",
                         &coefs, &offsets, &size, &range, &neighbors,
-                        &real, &comm_obj, &cfd))
+                        &real, &comm_obj, &cfd, &async))
     return NULL;
 
   OperatorObject *self = PyObject_NEW(OperatorObject, &OperatorType);
   if (self == NULL)
     return NULL;
+  self->async = async;
+  self->work_buf = NULL;
+  self->work_send = NULL;
+  self->work_recv = NULL;
+  self->nwork_buf = 0;
+  self->nwork_send = 0;
+  self->nwork_recv = 0;
+  memset(&self->perf, 0, sizeof(gpaw_perf_t));
 
   self->stencil = bmgs_stencil(coefs->dimensions[0], DOUBLEP(coefs),
                                LONGP(offsets), range, LONGP(size));
+  autotune_stencil(&self->stencil);
 
   const long (*nb)[2] = (const long (*)[2])LONGP(neighbors);
   const long padding[3][2] = {{range, range},
@@ -0,0 +1,97 @@
+#include "extensions.h"
+#include "threadpool.h"
+
+// Form a block of pair densities in one call.  The band pairs are
+// given by index arrays, so a block with fixed n1 streams that band
+// from cache while the n2 bands stream through once each; the deep
+// pair loops of the response and exact-exchange code pay the Python
+// and dispatch overhead once per block instead of once per pair.
+// The pairs are split over the thread pool.
+
+struct pd_args {
+  int thread_id;
+  int nthds;
+  int nx;
+  long ng;
+  int real;
+  const double* psit1;
+  const double* psit2;
+  const long* n1_x;
+  const long* n2_x;
+  double* nt;
+};
+
+static void* pd_worker(void* argsptr)
+{
+  struct pd_args* args = (struct pd_args*)argsptr;
+  int chunk = (args->nx + args->nthds - 1) / args->nthds;
+  int xa = args->thread_id * chunk;
+  int xb = MIN(xa + chunk, args->nx);
+  long ng = args->ng;
+  for (int x = xa; x < xb; x++) {
+    if (args->real) {
+      const double* p1 = args->psit1 + args->n1_x[x] * ng;
+      const double* p2 = args->psit2 + args->n2_x[x] * ng;
+      double* nt = args->nt + x * ng;
+      for (long g = 0; g < ng; g++)
+        nt[g] = p1[g] * p2[g];
+    } else {
+      const double_complex* p1 = (const double_complex*)args->psit1
+                                 + args->n1_x[x] * ng;
+      const double_complex* p2 = (const double_complex*)args->psit2
+                                 + args->n2_x[x] * ng;
+      double_complex* nt = (double_complex*)args->nt + x * ng;
+      for (long g = 0; g < ng; g++)
+        nt[g] = conj(p1[g]) * p2[g];
+    }
+  }
+  return NULL;
+}
+
+PyObject *pair_densities(PyObject *self, PyObject *args)
+{
+  PyArrayObject* psit1_nG;
+  PyArrayObject* psit2_nG;
+  PyArrayObject* n1_x;
+  PyArrayObject* n2_x;
+  PyArrayObject* nt_xG;
+  if (!PyArg_ParseTuple(args, "OOOOO", &psit1_nG, &psit2_nG,
+                        &n1_x, &n2_x, &nt_xG))
+    return NULL;
+
+  int real = (psit1_nG->descr->type_num == PyArray_DOUBLE);
+  int nx = n1_x->dimensions[0];
+  long ng = 1;
+  for (int d = 1; d < psit1_nG->nd; d++)
+    ng *= psit1_nG->dimensions[d];
+
+  struct pd_args a;
+  a.nx = nx;
+  a.ng = ng;
+  a.real = real;
+  a.psit1 = DOUBLEP(psit1_nG);
+  a.psit2 = DOUBLEP(psit2_nG);
+  a.n1_x = LONGP(n1_x);
+  a.n2_x = LONGP(n2_x);
+  a.nt = DOUBLEP(nt_xG);
+
+  int nthds = 1;
+#ifdef GPAW_OMP
+  nthds = gpaw_threadpool_size();
+  if (nthds > nx)
+    nthds = nx;
+#endif
+  struct pd_args* wargs = GPAW_MALLOC(struct pd_args, nthds);
+  for (int t = 0; t < nthds; t++) {
+    wargs[t] = a;
+    wargs[t].thread_id = t;
+    wargs[t].nthds = nthds;
+  }
+#ifdef GPAW_OMP
+  gpaw_threadpool_run(pd_worker, wargs, sizeof(struct pd_args), nthds);
+#else
+  pd_worker(wargs);
+#endif
+  free(wargs);
+  Py_RETURN_NONE;
+}
@@ -27,6 +27,52 @@ double pbe_exchange(const xc_parameters* par,
   return e;
 }
 
+/* Chunked form: the loop lives here so that the per-point function is
+   inlined into it and the indirect call from the XC driver is paid once
+   per chunk instead of once per grid point.  The loop bodies are
+   written out as straight-line array code over restrict pointers so
+   the compiler can vectorize them; with rs precomputed by the driver
+   the PBE exchange contains no transcendentals at all. */
+void pbe_exchange_n(const xc_parameters* par, int np,
+		    const double* n_g, const double* rs_g, const double* a2_g,
+		    double* e_g, double* dedrs_g, double* deda2_g)
+{
+  const double* restrict rs_p = rs_g;
+  double* restrict e_p = e_g;
+  double* restrict dedrs_p = dedrs_g;
+  if (par->gga)
+    {
+      const double kappa = par->kappa;
+      const double* restrict n_p = n_g;
+      const double* restrict a2_p = a2_g;
+      double* restrict deda2_p = deda2_g;
+      for (int g = 0; g < np; g++)
+	{
+	  double rs = rs_p[g];
+	  double a2 = a2_p[g];
+	  double e = C1 / rs;
+	  double dedrs = -e / rs;
+	  double c = C2 * rs / n_p[g];
+	  c *= c;
+	  double s2 = a2 * c;
+	  double x = 1.0 + MU * s2 / kappa;
+	  double Fx = 1.0 + kappa - kappa / x;
+	  double dFxds2 = MU / (x * x);
+	  double ds2drs = 8.0 * c * a2 / rs;
+	  dedrs_p[g] = dedrs * Fx + e * dFxds2 * ds2drs;
+	  deda2_p[g] = e * dFxds2 * c;
+	  e_p[g] = e * Fx;
+	}
+    }
+  else
+    for (int g = 0; g < np; g++)
+      {
+	double e = C1 / rs_p[g];
+	e_p[g] = e;
+	dedrs_p[g] = -e / rs_p[g];
+      }
+}
+
 /* inline */ double G(double rtrs, double A, double alpha1,
                 double beta1, double beta2, double beta3, double beta4,
                 double* dGdrs)
@@ -162,3 +208,157 @@ double pbe_correlation(double n, double rs, double zeta, double a2,
     }
   return e;
 }
+
+/* Chunked form of the correlation (see pbe_exchange_n); zeta_g,
+   dedzeta_g and the gradient arrays may be 0 as in the per-point
+   function.  The spin-paired case - the production path - is written
+   as array loops whose transcendentals (sqrt, log, exp) sit in
+   straight-line bodies that a vectorizing libm can handle; the
+   spin-polarized case keeps the per-point calls. */
+void pbe_correlation_n(int np, const double* n_g, const double* rs_g,
+		       const double* zeta_g, const double* a2_g,
+		       bool gga, bool spinpol,
+		       double* e_g, double* dedrs_g, double* dedzeta_g,
+		       double* deda2_g)
+{
+  if (spinpol)
+    {
+      for (int g = 0; g < np; g++)
+	e_g[g] = pbe_correlation(n_g[g], rs_g[g],
+				 (zeta_g != 0) ? zeta_g[g] : 0.0,
+				 (a2_g != 0) ? a2_g[g] : 0.0,
+				 gga, spinpol,
+				 dedrs_g + g,
+				 (dedzeta_g != 0) ? dedzeta_g + g : 0,
+				 (deda2_g != 0) ? deda2_g + g : 0);
+      return;
+    }
+  const double* restrict rs_p = rs_g;
+  double* restrict e_p = e_g;
+  double* restrict dedrs_p = dedrs_g;
+  for (int g = 0; g < np; g++)
+    {
+      double de0drs;
+      e_p[g] = G(sqrt(rs_p[g]), GAMMA, 0.21370, 7.5957, 3.5876, 1.6382,
+		 0.49294, &de0drs);
+      dedrs_p[g] = de0drs;
+    }
+  if (gga)
+    {
+      const double* restrict n_p = n_g;
+      const double* restrict a2_p = a2_g;
+      double* restrict deda2_p = deda2_g;
+      for (int g = 0; g < np; g++)
+	{
+	  double e = e_p[g];
+	  double rs = rs_p[g];
+	  double n2 = n_p[g] * n_p[g];
+	  double t2 = C3 * a2_p[g] * rs / n2;
+	  double y = -e / GAMMA;
+	  double x = exp(y);
+	  double A;
+	  if (x != 1.0)
+	    A = BETA / (GAMMA * (x - 1.0));
+	  else
+	    A = BETA / (GAMMA * y);
+	  double At2 = A * t2;
+	  double nom = 1.0 + At2;
+	  double denom = nom + At2 * At2;
+	  double H = GAMMA * log(1.0 + BETA * t2 * nom / (denom * GAMMA));
+	  double tmp = (GAMMA * BETA /
+			(denom * (BETA * t2 * nom + GAMMA * denom)));
+	  double tmp2 = A * A * x / BETA;
+	  double dAdrs = tmp2 * dedrs_p[g];
+	  double dHdt2 = (1.0 + 2.0 * At2) * tmp;
+	  double dHdA = -At2 * t2 * t2 * (2.0 + At2) * tmp;
+	  dedrs_p[g] += dHdt2 * 7 * t2 / rs + dHdA * dAdrs;
+	  deda2_p[g] = dHdt2 * C3 * rs / n2;
+	  e_p[g] = e + H;
+	}
+    }
+}
+
+/* Fused spin-paired exchange + correlation in a single pass over the
+   chunk.  The exchange and correlation of a point share the n, rs and
+   a2 loads and the final assembly of the energy density, potential and
+   gradient derivative happens in the same loop body, so the driver
+   needs no intermediate ex/ec/dedrs arrays and only two dispatches per
+   chunk become one.  v_g is accumulated into, like in the driver.  The
+   exchange enhancement is the kappa-parametrized PBE form, so this is
+   used for LDA, PBE and revPBE; RPBE and PW91 keep the split path. */
+void pbe_exchange_correlation_n(const xc_parameters* par, int np,
+				const double* n_g, const double* rs_g,
+				const double* a2_g, bool gga,
+				double* e_g, double* v_g, double* dedsigma_g)
+{
+  const double* restrict n_p = n_g;
+  const double* restrict rs_p = rs_g;
+  double* restrict e_p = e_g;
+  double* restrict v_p = v_g;
+  if (gga)
+    {
+      const double kappa = par->kappa;
+      const double* restrict a2_p = a2_g;
+      double* restrict dedsigma_p = dedsigma_g;
+      for (int g = 0; g < np; g++)
+	{
+	  double n = n_p[g];
+	  double rs = rs_p[g];
+	  double a2 = a2_p[g];
+	  // Exchange:
+	  double ex = C1 / rs;
+	  double dexdrs = -ex / rs;
+	  double c = C2 * rs / n;
+	  c *= c;
+	  double s2 = a2 * c;
+	  double xx = 1.0 + MU * s2 / kappa;
+	  double Fx = 1.0 + kappa - kappa / xx;
+	  double dFxds2 = MU / (xx * xx);
+	  double ds2drs = 8.0 * c * a2 / rs;
+	  double dexda2 = ex * dFxds2 * c;
+	  dexdrs = dexdrs * Fx + ex * dFxds2 * ds2drs;
+	  ex *= Fx;
+	  // Correlation:
+	  double decdrs;
+	  double ec = G(sqrt(rs), GAMMA, 0.21370, 7.5957, 3.5876, 1.6382,
+			0.49294, &decdrs);
+	  double n2 = n * n;
+	  double t2 = C3 * a2 * rs / n2;
+	  double y = -ec / GAMMA;
+	  double x = exp(y);
+	  double A;
+	  if (x != 1.0)
+	    A = BETA / (GAMMA * (x - 1.0));
+	  else
+	    A = BETA / (GAMMA * y);
+	  double At2 = A * t2;
+	  double nom = 1.0 + At2;
+	  double denom = nom + At2 * At2;
+	  double H = GAMMA * log(1.0 + BETA * t2 * nom / (denom * GAMMA));
+	  double tmp = (GAMMA * BETA /
+			(denom * (BETA * t2 * nom + GAMMA * denom)));
+	  double dAdrs = A * A * x / BETA * decdrs;
+	  double dHdt2 = (1.0 + 2.0 * At2) * tmp;
+	  double dHdA = -At2 * t2 * t2 * (2.0 + At2) * tmp;
+	  decdrs += dHdt2 * 7 * t2 / rs + dHdA * dAdrs;
+	  double decda2 = dHdt2 * C3 * rs / n2;
+	  ec += H;
+	  // Assemble:
+	  e_p[g] = n * (ex + ec);
+	  v_p[g] += ex + ec - rs * (dexdrs + decdrs) / 3.0;
+	  dedsigma_p[g] = n * (dexda2 + decda2);
+	}
+    }
+  else
+    for (int g = 0; g < np; g++)
+      {
+	double rs = rs_p[g];
+	double ex = C1 / rs;
+	double dexdrs = -ex / rs;
+	double decdrs;
+	double ec = G(sqrt(rs), GAMMA, 0.21370, 7.5957, 3.5876, 1.6382,
+		      0.49294, &decdrs);
+	e_p[g] = n_p[g] * (ex + ec);
+	v_p[g] += ex + ec - rs * (dexdrs + decdrs) / 3.0;
+      }
+}
@@ -0,0 +1,125 @@
+/*  Copyright (C) 2003-2007  CAMP
+ *  Copyright (C) 2007-2008  CAMd
+ *  Please see the accompanying LICENSE file for further information. */
+
+#include <Python.h>
+#include <string.h>
+#include <sys/time.h>
+#include "perf.h"
+
+int gpaw_perf_enabled = 0;
+
+static double perf_walltime(void)
+{
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 1e-6 * t.tv_usec;
+}
+
+#ifdef GPAW_PAPI
+#include <papi.h>
+
+static int perf_eventset = PAPI_NULL;
+
+/* Create and start the event set on first use.  All counters must fit
+   together; if one of them is unavailable on this machine we fall
+   back to time-only collection rather than reporting shifted
+   values. */
+static int perf_papi_up(void)
+{
+  if (perf_eventset != PAPI_NULL)
+    return 0;
+  int events[GPAW_PERF_NCOUNTERS] = {PAPI_TOT_CYC, PAPI_L2_TCM,
+                                     PAPI_L3_TCM, PAPI_FP_OPS};
+  if (PAPI_is_initialized() == PAPI_NOT_INITED &&
+      PAPI_library_init(PAPI_VER_CURRENT) != PAPI_VER_CURRENT)
+    return -1;
+  int eventset = PAPI_NULL;
+  if (PAPI_create_eventset(&eventset) != PAPI_OK)
+    return -1;
+  for (int i = 0; i < GPAW_PERF_NCOUNTERS; i++)
+    if (PAPI_add_event(eventset, events[i]) != PAPI_OK)
+      {
+        PAPI_destroy_eventset(&eventset);
+        return -1;
+      }
+  if (PAPI_start(eventset) != PAPI_OK)
+    {
+      PAPI_destroy_eventset(&eventset);
+      return -1;
+    }
+  perf_eventset = eventset;
+  return 0;
+}
+#endif
+
+void gpaw_perf_start(long long counters[GPAW_PERF_NCOUNTERS], double* t0)
+{
+  *t0 = perf_walltime();
+#ifdef GPAW_PAPI
+  if (perf_eventset != PAPI_NULL)
+    {
+      PAPI_read(perf_eventset, (long_long*)counters);
+      return;
+    }
+#endif
+  memset(counters, 0, GPAW_PERF_NCOUNTERS * sizeof(long long));
+}
+
+void gpaw_perf_stop(gpaw_perf_t* perf,
+                    const long long counters[GPAW_PERF_NCOUNTERS],
+                    double t0)
+{
+  perf->calls++;
+  perf->time += perf_walltime() - t0;
+#ifdef GPAW_PAPI
+  if (perf_eventset != PAPI_NULL)
+    {
+      long_long now[GPAW_PERF_NCOUNTERS];
+      PAPI_read(perf_eventset, now);
+      perf->cycles += now[0] - counters[0];
+      perf->l2_misses += now[1] - counters[1];
+      perf->l3_misses += now[2] - counters[2];
+      perf->flops += now[3] - counters[3];
+    }
+#endif
+}
+
+// Accumulate the statically derived cost of a call (see perf.h):
+void gpaw_perf_model(gpaw_perf_t* perf, long long nbytes, long long nflops)
+{
+  perf->model_bytes += nbytes;
+  perf->model_flops += nflops;
+}
+
+PyObject* gpaw_perf_stats(const gpaw_perf_t* perf)
+{
+  return Py_BuildValue("{s:L,s:d,s:L,s:L,s:L,s:L,s:L,s:L}",
+                       "calls", perf->calls,
+                       "time", perf->time,
+                       "cycles", perf->cycles,
+                       "l2_misses", perf->l2_misses,
+                       "l3_misses", perf->l3_misses,
+                       "flops", perf->flops,
+                       "model_bytes", perf->model_bytes,
+                       "model_flops", perf->model_flops);
+}
+
+PyObject* perf_enable(PyObject *self, PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+#ifdef GPAW_PAPI
+  perf_papi_up();   // failure means time-only collection
+#endif
+  gpaw_perf_enabled = 1;
+  Py_RETURN_NONE;
+}
+
+PyObject* perf_disable(PyObject *self, PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+  gpaw_perf_enabled = 0;
+  Py_RETURN_NONE;
+}
@@ -0,0 +1,57 @@
+/*  Copyright (C) 2003-2007  CAMP
+ *  Copyright (C) 2007-2008  CAMd
+ *  Please see the accompanying LICENSE file for further information. */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <Python.h>
+
+/* Per-object hardware-counter accumulation.
+ *
+ * Hot objects (OperatorObject, TransformerObject, LFCObject) embed a
+ * gpaw_perf_t, bracket their apply-type calls with gpaw_perf_start /
+ * gpaw_perf_stop and expose the totals to Python through
+ * gpaw_perf_stats() as a dict.  Collection only happens after
+ * _gpaw.perf_enable() has been called.
+ *
+ * With GPAW_PAPI the per-call deltas are cycles, L2/L3 total cache
+ * misses and floating point operations; without it only the call
+ * count and wall time are collected, so the Python surface is the
+ * same either way.  (The whole-run PAPI report lives in
+ * c/utilities.c; this is the per-object counterpart.)
+ *
+ * model_bytes/model_flops hold a static streaming cost model fed by
+ * gpaw_perf_model(): bytes and flops derived from box sizes and
+ * stencil shapes, counting every array as read or written once per
+ * pass.  Dividing by the measured time gives achieved bandwidth and
+ * throughput for roofline-style reports
+ * (gpaw/utilities/roofline.py). */
+
+typedef struct
+{
+  long long calls;
+  double time;
+  long long cycles;
+  long long l2_misses;
+  long long l3_misses;
+  long long flops;
+  long long model_bytes;
+  long long model_flops;
+} gpaw_perf_t;
+
+#define GPAW_PERF_NCOUNTERS 4
+
+extern int gpaw_perf_enabled;
+
+void gpaw_perf_start(long long counters[GPAW_PERF_NCOUNTERS], double* t0);
+void gpaw_perf_stop(gpaw_perf_t* perf,
+                    const long long counters[GPAW_PERF_NCOUNTERS],
+                    double t0);
+void gpaw_perf_model(gpaw_perf_t* perf, long long nbytes, long long nflops);
+PyObject* gpaw_perf_stats(const gpaw_perf_t* perf);
+
+PyObject* perf_enable(PyObject *self, PyObject *args);
+PyObject* perf_disable(PyObject *self, PyObject *args);
+
+#endif
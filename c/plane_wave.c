@@ -1,5 +1,94 @@
 #include "extensions.h"
+#include "threadpool.h"
 #include <stdlib.h>
+#include <math.h>
+
+// exp(i k.(r - r0)) on the grid.  The phase is separable,
+// exp(i kx x) exp(i ky y) exp(i kz z), so the grid is built from
+// per-axis 1D phase tables: one complex exponential per grid line
+// instead of one per grid point, leaving a single complex multiply
+// per point.  The outer axis is split over the thread pool, and
+// plane_wave_grids() fills the grids of many k-vectors in one call
+// for the response-function and STM post-processing paths that
+// generate thousands of them.
+
+struct pw_args {
+  int thread_id;
+  int nthds;
+  const int* n;
+  const double_complex* e0;
+  const double_complex* e1;
+  const double_complex* e2;
+  double_complex* pw;
+};
+
+static void pw_tables(const long* beg, const int* n, const double* h,
+                      const double* vk, const double* vr0,
+                      double_complex* e0, double_complex* e1,
+                      double_complex* e2)
+{
+  // The -k.r0 phase is folded into the axis-0 table:
+  double kr0 = vk[0] * vr0[0] + vk[1] * vr0[1] + vk[2] * vr0[2];
+  for (int i = 0; i < n[0]; i++) {
+    double kr = vk[0] * h[0] * (beg[0] + i) - kr0;
+    e0[i] = cos(kr) + I * sin(kr);
+  }
+  for (int j = 0; j < n[1]; j++) {
+    double kr = vk[1] * h[1] * (beg[1] + j);
+    e1[j] = cos(kr) + I * sin(kr);
+  }
+  for (int k = 0; k < n[2]; k++) {
+    double kr = vk[2] * h[2] * (beg[2] + k);
+    e2[k] = cos(kr) + I * sin(kr);
+  }
+}
+
+static void* pw_worker(void* argsptr)
+{
+  struct pw_args* args = (struct pw_args*)argsptr;
+  int n1 = args->n[1];
+  int n2 = args->n[2];
+  int chunk = (args->n[0] + args->nthds - 1) / args->nthds;
+  int ia = args->thread_id * chunk;
+  int ib = MIN(ia + chunk, args->n[0]);
+  const double_complex* e2 = args->e2;
+  for (int i = ia; i < ib; i++)
+    for (int j = 0; j < n1; j++) {
+      double_complex eij = args->e0[i] * args->e1[j];
+      double_complex* pw = args->pw + ((long)i * n1 + j) * n2;
+      for (int k = 0; k < n2; k++)
+        pw[k] = eij * e2[k];
+    }
+  return NULL;
+}
+
+static void pw_fill(const int* n, const double_complex* e0,
+                    const double_complex* e1, const double_complex* e2,
+                    double_complex* pw)
+{
+  int nthds = 1;
+#ifdef GPAW_OMP
+  nthds = gpaw_threadpool_size();
+  if (nthds > n[0])
+    nthds = n[0];
+#endif
+  struct pw_args* wargs = GPAW_MALLOC(struct pw_args, nthds);
+  for (int t = 0; t < nthds; t++) {
+    (wargs + t)->thread_id = t;
+    (wargs + t)->nthds = nthds;
+    (wargs + t)->n = n;
+    (wargs + t)->e0 = e0;
+    (wargs + t)->e1 = e1;
+    (wargs + t)->e2 = e2;
+    (wargs + t)->pw = pw;
+  }
+#ifdef GPAW_OMP
+  gpaw_threadpool_run(pw_worker, wargs, sizeof(struct pw_args), nthds);
+#else
+  pw_worker(wargs);
+#endif
+  free(wargs);
+}
 
 PyObject *plane_wave_grid(PyObject *self, PyObject *args)
 {
@@ -9,7 +98,7 @@ PyObject *plane_wave_grid(PyObject *self, PyObject *args)
   PyArrayObject* k_c;
   PyArrayObject* r0_c;
   PyArrayObject* pw_g;
-  if (!PyArg_ParseTuple(args, "OOOOOO", &beg_c, &end_c, &h_c, 
+  if (!PyArg_ParseTuple(args, "OOOOOO", &beg_c, &end_c, &h_c,
 			&k_c, &r0_c, &pw_g))
     return NULL;
 
@@ -20,24 +109,56 @@ PyObject *plane_wave_grid(PyObject *self, PyObject *args)
   double *vr0 = DOUBLEP(r0_c);
   double_complex *pw = COMPLEXP(pw_g);
 
-  double kr[3], kr0[3];
-  int n[3], ij;
-  for (int c = 0; c < 3; c++) { 
+  int n[3];
+  for (int c = 0; c < 3; c++)
     n[c] = end[c] - beg[c];
-    kr0[c] = vk[c] * vr0[c];
-  }
-  for (int i = 0; i < n[0]; i++) {
-    kr[0] = vk[0] * h[0] * (beg[0] + i) - kr0[0];
-    for (int j = 0; j < n[1]; j++) {
-      kr[1] = kr[0] + vk[1] * h[1] * (beg[1] + j) - kr0[1];
-      ij = (i*n[1] + j)*n[2];
-      for (int k = 0; k < n[2]; k++) {
-	kr[2] = kr[1] + vk[2] * h[2] * (beg[2] + k) - kr0[2];
-	pw[ij + k] = cos(kr[2]) + I * sin(kr[2]);
-      }
-    }
-  }
+
+  double_complex* e0 = GPAW_MALLOC(double_complex, n[0] + n[1] + n[2]);
+  double_complex* e1 = e0 + n[0];
+  double_complex* e2 = e1 + n[1];
+  pw_tables(beg, n, h, vk, vr0, e0, e1, e2);
+  pw_fill(n, e0, e1, e2, pw);
+  free(e0);
   Py_RETURN_NONE;
 }
 
+// Batch version: k_qc is a (nq, 3) array of k-vectors and pw_qg the
+// matching (nq, n0, n1, n2) output array; one call amortizes the
+// Python and table-setup overhead over all grids.
+PyObject *plane_wave_grids(PyObject *self, PyObject *args)
+{
+  PyArrayObject* beg_c;
+  PyArrayObject* end_c;
+  PyArrayObject* h_c;
+  PyArrayObject* k_qc;
+  PyArrayObject* r0_c;
+  PyArrayObject* pw_qg;
+  if (!PyArg_ParseTuple(args, "OOOOOO", &beg_c, &end_c, &h_c,
+			&k_qc, &r0_c, &pw_qg))
+    return NULL;
 
+  long *beg = LONGP(beg_c);
+  long *end = LONGP(end_c);
+  double *h = DOUBLEP(h_c);
+  double *vr0 = DOUBLEP(r0_c);
+  double_complex *pw = COMPLEXP(pw_qg);
+
+  int nq = k_qc->dimensions[0];
+  int n[3];
+  long ng = 1;
+  for (int c = 0; c < 3; c++) {
+    n[c] = end[c] - beg[c];
+    ng *= n[c];
+  }
+
+  double_complex* e0 = GPAW_MALLOC(double_complex, n[0] + n[1] + n[2]);
+  double_complex* e1 = e0 + n[0];
+  double_complex* e2 = e1 + n[1];
+  for (int q = 0; q < nq; q++) {
+    double* vk = DOUBLEP(k_qc) + 3 * q;
+    pw_tables(beg, n, h, vk, vr0, e0, e1, e2);
+    pw_fill(n, e0, e1, e2, pw + q * ng);
+  }
+  free(e0);
+  Py_RETURN_NONE;
+}
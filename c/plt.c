@@ -53,6 +53,11 @@ if(Items < 1) {\
   printf("?ERROR - in writing contour file (*)\n");\
   return(1);}}
 
+/* Conversion buffer: grid values are converted to float in blocks of
+   PLT_BLOCK values and written with one fwrite per block instead of
+   one fwrite per value. */
+#define PLT_BLOCK 262144  /* 1 MB of floats */
+
 int write_plt_file(char *fname,
 		   int nx, int ny, int nz,
 		   double x0, double y0, double z0,
@@ -62,11 +67,12 @@ int write_plt_file(char *fname,
   static int Items;
   float scale,zmin,zmax,ymin,ymax,xmin,xmax,val;
   int rank,TypeOfSurface;
-  int ix,iy,iz,indx;
+  int nfill;
+  long i,ng;
   double norm,sum,dV;
 
   Output_p = fopen(fname,"wb");
-  
+
   /* see http://www.csc.fi/gopenmol/developers/plt_format.phtml */
 
 #define au_A 0.52917725
@@ -94,26 +100,158 @@ int write_plt_file(char *fname,
   /* float xmax=(float) x0+nx*dx; */
   FWRITE(xmin , sizeof(float));
   FWRITE(xmax , sizeof(float));
-      
-  indx=0;
+
+  float* buf = GPAW_MALLOC(float, PLT_BLOCK);
+  nfill = 0;
   norm = 0;
-  sum=0;
-  dV=dx*dy*dz;
-  for(iz=0;iz<nz;iz++)
-    for(iy=0;iy<ny;iy++)
-      for(ix=0;ix<nx;ix++) {
-	val = (float) grid[indx];
-	sum += val;
-	norm += val*val;
-	FWRITE(val , sizeof(float));
-	indx++;
+  sum = 0;
+  dV = dx*dy*dz;
+  ng = (long)nx * ny * nz;
+  for(i=0;i<ng;i++) {
+    val = (float) grid[i];
+    sum += val;
+    norm += val*val;
+    buf[nfill++] = val;
+    if (nfill == PLT_BLOCK) {
+      Items = fwrite(buf, sizeof(float), nfill, Output_p);
+      if (Items < nfill) {
+	printf("?ERROR - in writing contour file (*)\n");
+	free(buf);
+	return(1);
       }
+      nfill = 0;
+    }
+  }
+  if (nfill > 0) {
+    Items = fwrite(buf, sizeof(float), nfill, Output_p);
+    if (Items < nfill) {
+      printf("?ERROR - in writing contour file (*)\n");
+      free(buf);
+      return(1);
+    }
+  }
+  free(buf);
 
   fclose(Output_p);
 
   printf("#<write_plt_file> %s written (sum=%g,norm=%g)\n",
 	 fname,sum*dV,norm*dV);
-  
+
   return 0;
 }
 
+/* Batch variant: write a set of fields (e.g. a band/spin batch from a
+ * TDDFT run) to one file each with a single call.  The header values
+ * are taken as given - no unit conversion - and the fields are
+ * expected in C order (z fastest), which is transposed into the
+ * x-fastest order of the plt format during the buffered conversion.
+ */
+static int write_plt_field(FILE *Output_p, float *buf,
+			   int nx, int ny, int nz,
+			   double x0, double y0, double z0,
+			   double dx, double dy, double dz,
+			   int typ, const double *grid)
+{
+  static int Items;
+  float zmin,zmax,ymin,ymax,xmin,xmax,val;
+  int rank,TypeOfSurface;
+  int ix,iy,iz,nfill;
+
+  rank=3; /* always 3 */
+  FWRITE(rank , sizeof(int));
+  TypeOfSurface=typ;
+  FWRITE(TypeOfSurface , sizeof(int));
+  FWRITE(nz , sizeof(int));
+  FWRITE(ny , sizeof(int));
+  FWRITE(nx , sizeof(int));
+  zmin= (float) z0;
+  zmax= (float) (z0+(nz-1)*dz);
+  FWRITE(zmin , sizeof(float));
+  FWRITE(zmax , sizeof(float));
+  ymin= (float) y0;
+  ymax= (float) (y0+(ny-1)*dy);
+  FWRITE(ymin , sizeof(float));
+  FWRITE(ymax , sizeof(float));
+  xmin= (float) x0;
+  xmax= (float) (x0+(nx-1)*dx);
+  FWRITE(xmin , sizeof(float));
+  FWRITE(xmax , sizeof(float));
+
+  nfill = 0;
+  for(iz=0;iz<nz;iz++)
+    for(iy=0;iy<ny;iy++)
+      for(ix=0;ix<nx;ix++) {
+	val = (float) grid[((long)ix * ny + iy) * nz + iz];
+	buf[nfill++] = val;
+	if (nfill == PLT_BLOCK) {
+	  Items = fwrite(buf, sizeof(float), nfill, Output_p);
+	  if (Items < nfill) {
+	    printf("?ERROR - in writing contour file (*)\n");
+	    return(1);
+	  }
+	  nfill = 0;
+	}
+      }
+  if (nfill > 0) {
+    Items = fwrite(buf, sizeof(float), nfill, Output_p);
+    if (Items < nfill) {
+      printf("?ERROR - in writing contour file (*)\n");
+      return(1);
+    }
+  }
+  return 0;
+}
+
+/* write a batch of fields to plt files, one file per field */
+PyObject* WritePLTs(PyObject *self, PyObject *args)
+{
+  char* template;     /* file name template with one %d */
+  PyArrayObject* oo;  /* origin */
+  PyArrayObject* ho;  /* grid spacings */
+  PyArrayObject* go;  /* fields to write */
+  int typ = 4;
+  if (!PyArg_ParseTuple(args, "sOOO|i", &template, &oo, &ho, &go, &typ))
+    return NULL;
+
+  /* must be a batch of 3D fields */
+  if (go->nd != 4) {
+    PyErr_SetString(PyExc_ValueError, "fields must be a 4-d array");
+    return NULL;
+  }
+
+  const double* g = DOUBLEP(go);
+  const double* o = DOUBLEP(oo);
+  const double* h = DOUBLEP(ho);
+  int nfields = go->dimensions[0];
+  int nx = go->dimensions[1];
+  int ny = go->dimensions[2];
+  int nz = go->dimensions[3];
+  long ng = (long)nx * ny * nz;
+
+  float* buf = GPAW_MALLOC(float, PLT_BLOCK);
+  char* fname = GPAW_MALLOC(char, strlen(template) + 64);
+  for (int i = 0; i < nfields; i++) {
+    snprintf(fname, strlen(template) + 64, template, i);
+    FILE* fp = fopen(fname, "wb");
+    if (fp == NULL) {
+      PyErr_SetFromErrnoWithFilename(PyExc_IOError, fname);
+      free(fname);
+      free(buf);
+      return NULL;
+    }
+    int error = write_plt_field(fp, buf, nx, ny, nz,
+				o[0], o[1], o[2], h[0], h[1], h[2],
+				typ, g + i * ng);
+    fclose(fp);
+    if (error) {
+      free(fname);
+      free(buf);
+      PyErr_SetString(PyExc_IOError, "failed to write plt file");
+      return NULL;
+    }
+  }
+  free(fname);
+  free(buf);
+  Py_RETURN_NONE;
+}
+
@@ -0,0 +1,191 @@
+/*  Copyright (C) 2003-2007  CAMP
+ *  Please see the accompanying LICENSE file for further information. */
+
+#include <Python.h>
+#define PY_ARRAY_UNIQUE_SYMBOL GPAW_ARRAY_API
+#define NO_IMPORT_ARRAY
+#include <numpy/arrayobject.h>
+#include "extensions.h"
+
+/* Fused multigrid V-cycle preconditioner.
+ *
+ * Holds the whole level hierarchy - the three Laplacians and the four
+ * transformers built by gpaw/preconditioner.py - and runs the V-cycle
+ * in a single C call through the raw apply entry points, with the
+ * intermediate level arrays kept in reused work buffers instead of
+ * numpy temporaries created per call. */
+
+typedef struct
+{
+  PyObject_HEAD
+  PyObject* kin0;
+  PyObject* kin1;
+  PyObject* kin2;
+  PyObject* restrictor0;
+  PyObject* restrictor1;
+  PyObject* interpolator2;
+  PyObject* interpolator1;
+  double step;
+  long ng0;            /* grid points per band on each level */
+  long ng1;
+  long ng2;
+  /* Level scratch arrays reused between calls (gpaw_workbuf): */
+  double* work0;       /* q0 */
+  double* work1;       /* r1, d1, q1 */
+  double* work2;       /* r2, d2, q2 */
+  long nwork0;
+  long nwork1;
+  long nwork2;
+} PrecondObject;
+
+static void Precond_dealloc(PrecondObject* self)
+{
+  free(self->work2);
+  free(self->work1);
+  free(self->work0);
+  Py_XDECREF(self->interpolator1);
+  Py_XDECREF(self->interpolator2);
+  Py_XDECREF(self->restrictor1);
+  Py_XDECREF(self->restrictor0);
+  Py_XDECREF(self->kin2);
+  Py_XDECREF(self->kin1);
+  Py_XDECREF(self->kin0);
+  PyObject_DEL(self);
+}
+
+static PyObject* Precond_apply(PrecondObject* self, PyObject* args)
+{
+  PyArrayObject* residuals;
+  PyArrayObject* output;
+  PyArrayObject* phases = 0;
+  if (!PyArg_ParseTuple(args, "OO|O", &residuals, &output, &phases))
+    return NULL;
+
+  int nin = 1;
+  if (residuals->nd == 4)
+    nin = residuals->dimensions[0];
+
+  int real = (residuals->descr->type_num == PyArray_DOUBLE);
+  const double_complex* ph = (real ? 0 : COMPLEXP(phases));
+
+  const double* res = DOUBLEP(residuals);
+  double* d0 = DOUBLEP(output);
+
+  /* All scalars in the cycle are real, so complex arrays are handled
+   * as interleaved doubles: */
+  int nd = (real ? 1 : 2);
+  long n0 = self->ng0 * nd * nin;
+  long n1 = self->ng1 * nd * nin;
+  long n2 = self->ng2 * nd * nin;
+  double step = self->step;
+
+  double* q0 = gpaw_workbuf(&self->work0, &self->nwork0, n0);
+  double* w1 = gpaw_workbuf(&self->work1, &self->nwork1, 3 * n1);
+  double* w2 = gpaw_workbuf(&self->work2, &self->nwork2, 3 * n2);
+  double* r1 = w1;
+  double* d1 = w1 + n1;
+  double* q1 = w1 + 2 * n1;
+  double* r2 = w2;
+  double* d2 = w2 + n2;
+  double* q2 = w2 + 2 * n2;
+
+  for (long g = 0; g < n0; g++)
+    q0[g] = -res[g];
+  Transformer_apply_raw(self->restrictor0, nin, real, ph, q0, r1);
+  for (long g = 0; g < n1; g++)
+    d1[g] = 4.0 * step * r1[g];
+  Operator_apply_raw(self->kin1, nin, real, ph, d1, q1);
+  for (long g = 0; g < n1; g++)
+    q1[g] -= r1[g];
+  Transformer_apply_raw(self->restrictor1, nin, real, ph, q1, r2);
+  for (long g = 0; g < n2; g++)
+    d2[g] = 16.0 * step * r2[g];
+  Operator_apply_raw(self->kin2, nin, real, ph, d2, q2);
+  for (long g = 0; g < n2; g++)
+    d2[g] -= 16.0 * step * (q2[g] - r2[g]);
+  Transformer_apply_raw(self->interpolator2, nin, real, ph, d2, q1);
+  for (long g = 0; g < n1; g++)
+    d1[g] -= q1[g];
+  Operator_apply_raw(self->kin1, nin, real, ph, d1, q1);
+  for (long g = 0; g < n1; g++)
+    d1[g] = 4.0 * step * (q1[g] - r1[g]) - d1[g];
+  Transformer_apply_raw(self->interpolator1, nin, real, ph, d1, d0);
+  Operator_apply_raw(self->kin0, nin, real, ph, d0, q0);
+  for (long g = 0; g < n0; g++)
+    d0[g] = step * (q0[g] - res[g]) - d0[g];
+
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef Precond_Methods[] = {
+    {"apply", (PyCFunction)Precond_apply, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyObject* Precond_getattr(PyObject* obj, char* name)
+{
+    return Py_FindMethod(Precond_Methods, obj, name);
+}
+
+static PyTypeObject PrecondType = {
+  PyObject_HEAD_INIT(&PyType_Type)
+  0,
+  "Precondition",
+  sizeof(PrecondObject),
+  0,
+  (destructor)Precond_dealloc,
+  0,
+  Precond_getattr
+};
+
+PyObject* NewPrecondObject(PyObject* obj, PyObject* args)
+{
+  PyObject* kin0;
+  PyObject* kin1;
+  PyObject* kin2;
+  PyObject* restrictor0;
+  PyObject* restrictor1;
+  PyObject* interpolator2;
+  PyObject* interpolator1;
+  double step;
+  long ng0;
+  long ng1;
+  long ng2;
+  if (!PyArg_ParseTuple(args, "OOOOOOOdlll",
+                        &kin0, &kin1, &kin2,
+                        &restrictor0, &restrictor1,
+                        &interpolator2, &interpolator1,
+                        &step, &ng0, &ng1, &ng2))
+    return NULL;
+
+  PrecondObject* self = PyObject_NEW(PrecondObject, &PrecondType);
+  if (self == NULL)
+    return NULL;
+
+  Py_INCREF(kin0);
+  Py_INCREF(kin1);
+  Py_INCREF(kin2);
+  Py_INCREF(restrictor0);
+  Py_INCREF(restrictor1);
+  Py_INCREF(interpolator2);
+  Py_INCREF(interpolator1);
+  self->kin0 = kin0;
+  self->kin1 = kin1;
+  self->kin2 = kin2;
+  self->restrictor0 = restrictor0;
+  self->restrictor1 = restrictor1;
+  self->interpolator2 = interpolator2;
+  self->interpolator1 = interpolator1;
+  self->step = step;
+  self->ng0 = ng0;
+  self->ng1 = ng1;
+  self->ng2 = ng2;
+  self->work0 = NULL;
+  self->work1 = NULL;
+  self->work2 = NULL;
+  self->nwork0 = 0;
+  self->nwork1 = 0;
+  self->nwork2 = 0;
+
+  return (PyObject*)self;
+}
@@ -0,0 +1,78 @@
+/*  Copyright (C) 2003-2007  CAMP
+ *  Copyright (C) 2007-2008  CAMd
+ *  Please see the accompanying LICENSE file for further information. */
+
+// Generic profiler-region annotations.  _gpaw.region_begin(name) and
+// _gpaw.region_end(name) mark a named region for whatever profiling
+// backend the extension was compiled against: CrayPAT (GPAW_CRAYPAT),
+// IBM HPM (GPAW_HPM), and - always - a pair of weak hook functions
+// that an LD_PRELOADed shim can override to forward the marks to
+// NVTX, ITT or any other tool.  Without a backend the calls reduce to
+// an empty function call, so the instrumentation in gpaw/scf.py and
+// the eigensolvers can stay unconditional.
+
+#include <Python.h>
+#include <string.h>
+
+#ifdef GPAW_CRAYPAT
+#include <pat_api.h>
+
+// PAT regions are numbered, so names are assigned ids on first sight:
+#define GPAW_NREGIONS 128
+static const char* region_names[GPAW_NREGIONS];
+static int nregions = 0;
+
+static int region_id(const char* name)
+{
+  for (int i = 0; i < nregions; i++)
+    if (strcmp(region_names[i], name) == 0)
+      return i + 1;
+  if (nregions == GPAW_NREGIONS)
+    return 0;  // out of ids: skip the region rather than fail
+  region_names[nregions] = strdup(name);
+  return ++nregions;
+}
+#endif
+
+#ifdef GPAW_HPM
+void HPM_Start(char *);
+void HPM_Stop(char *);
+#endif
+
+// The default hooks do nothing; a profiling shim overrides them:
+void __attribute__((weak)) gpaw_region_begin_hook(const char* name) {}
+void __attribute__((weak)) gpaw_region_end_hook(const char* name) {}
+
+PyObject* region_begin(PyObject *self, PyObject *args)
+{
+  char* name;
+  if (!PyArg_ParseTuple(args, "s", &name))
+    return NULL;
+#ifdef GPAW_CRAYPAT
+  int id = region_id(name);
+  if (id > 0)
+    PAT_region_begin(id, name);
+#endif
+#ifdef GPAW_HPM
+  HPM_Start(name);
+#endif
+  gpaw_region_begin_hook(name);
+  Py_RETURN_NONE;
+}
+
+PyObject* region_end(PyObject *self, PyObject *args)
+{
+  char* name;
+  if (!PyArg_ParseTuple(args, "s", &name))
+    return NULL;
+#ifdef GPAW_CRAYPAT
+  int id = region_id(name);
+  if (id > 0)
+    PAT_region_end(id);
+#endif
+#ifdef GPAW_HPM
+  HPM_Stop(name);
+#endif
+  gpaw_region_end_hook(name);
+  Py_RETURN_NONE;
+}
@@ -25,3 +25,44 @@ double rpbe_exchange(const xc_parameters* par,
     }
   return e;
 }
+
+/* Chunked form (see pbe_exchange_n in pbe.c): array loops over
+   restrict pointers so the exp can come from a vectorizing libm. */
+void rpbe_exchange_n(const xc_parameters* par, int np,
+		     const double* n_g, const double* rs_g, const double* a2_g,
+		     double* e_g, double* dedrs_g, double* deda2_g)
+{
+  const double* restrict rs_p = rs_g;
+  double* restrict e_p = e_g;
+  double* restrict dedrs_p = dedrs_g;
+  if (par->gga)
+    {
+      const double* restrict n_p = n_g;
+      const double* restrict a2_p = a2_g;
+      double* restrict deda2_p = deda2_g;
+      for (int g = 0; g < np; g++)
+	{
+	  double rs = rs_p[g];
+	  double a2 = a2_p[g];
+	  double e = C1 / rs;
+	  double dedrs = -e / rs;
+	  double c = C2 * rs / n_p[g];
+	  c *= c;
+	  double s2 = a2 * c;
+	  double x = exp(-MU * s2 / 0.804);
+	  double Fx = 1.0 + 0.804 * (1 - x);
+	  double dFxds2 = MU * x;
+	  double ds2drs = 8.0 * c * a2 / rs;
+	  dedrs_p[g] = dedrs * Fx + e * dFxds2 * ds2drs;
+	  deda2_p[g] = e * dFxds2 * c;
+	  e_p[g] = e * Fx;
+	}
+    }
+  else
+    for (int g = 0; g < np; g++)
+      {
+	double e = C1 / rs_p[g];
+	e_p[g] = e;
+	dedrs_p[g] = -e / rs_p[g];
+      }
+}
@@ -35,6 +35,24 @@ static PyObject * spline_get_value_and_derivative(SplineObject *obj,
 }
 
 
+// Evaluate the radial function for an array of radii
+static PyObject * spline_map(SplineObject *obj, PyObject *args)
+{
+  PyArrayObject* r_obj;
+  if (!PyArg_ParseTuple(args, "O", &r_obj))
+    return NULL;
+  int ng = r_obj->dimensions[0];
+  npy_intp dims[1] = {ng};
+  PyArrayObject* f_obj = (PyArrayObject*)PyArray_SimpleNew(1, dims,
+                                                           NPY_DOUBLE);
+  const double* r_g = DOUBLEP(r_obj);
+  double* f_g = DOUBLEP(f_obj);
+  for (int g = 0; g < ng; g++)
+    f_g[g] = bmgs_splinevalue(&obj->spline, r_g[g]);
+  return (PyObject*)f_obj;
+}
+
+
 // Convert boundary point z-ranges to grid indices for the 2*l+1 boxes
 static PyObject * spline_get_indices_from_zranges(SplineObject *self,
                                                       PyObject *args)
@@ -86,8 +104,10 @@ static PyMethodDef spline_methods[] = {
      (PyCFunction)spline_get_cutoff, METH_VARARGS, 0},
     {"get_angular_momentum_number", 
      (PyCFunction)spline_get_angular_momentum_number, METH_VARARGS, 0},
-    {"get_value_and_derivative", 
+    {"get_value_and_derivative",
      (PyCFunction)spline_get_value_and_derivative, METH_VARARGS, 0},
+    {"map",
+     (PyCFunction)spline_map, METH_VARARGS, 0},
     {"get_indices_from_zranges", 
      (PyCFunction)spline_get_indices_from_zranges, METH_VARARGS, 0},
     {NULL, NULL, 0, NULL}
@@ -116,6 +136,31 @@ static PyTypeObject SplineType = {
   (ternaryfunc)spline_call
 };
 
+// Evaluate a whole set of splines at a shared array of radii.  One
+// call and one tight pass over the radii per spline, instead of a
+// Python-level loop dispatching per (spline, radius) pair.
+PyObject * splines_map(PyObject *self, PyObject *args)
+{
+  PyObject* spline_list;
+  PyArrayObject* r_obj;
+  if (!PyArg_ParseTuple(args, "OO", &spline_list, &r_obj))
+    return NULL;
+  int ns = PyList_Size(spline_list);
+  int ng = r_obj->dimensions[0];
+  npy_intp dims[2] = {ns, ng};
+  PyArrayObject* f_obj = (PyArrayObject*)PyArray_SimpleNew(2, dims,
+                                                           NPY_DOUBLE);
+  const double* r_g = DOUBLEP(r_obj);
+  double* f_sg = DOUBLEP(f_obj);
+  for (int s = 0; s < ns; s++) {
+    const bmgsspline* spline =
+      &((SplineObject*)PyList_GetItem(spline_list, s))->spline;
+    for (int g = 0; g < ng; g++)
+      f_sg[s * ng + g] = bmgs_splinevalue(spline, r_g[g]);
+  }
+  return (PyObject*)f_obj;
+}
+
 PyObject * NewSplineObject(PyObject *self, PyObject *args)
 {
   int l;
@@ -1,6 +1,7 @@
 /*  Copyright (C) 2010 CAMd
  *  Please see the accompanying LICENSE file for further information. */
 #include "extensions.h"
+#include "threadpool.h"
 
 //
 // Apply symmetry operation op_cc to a and add result to b:
@@ -29,15 +30,135 @@ PyObject* symmetrize(PyObject *self, PyObject *args)
 
   const double* a_g = (const double*)a_g_obj->data;
   double* b_g = (double*)b_g_obj->data;
+  // The mapped index is affine in g, so step it along the inner loop
+  // with wrap-around instead of recomputing three multiplies and a
+  // division-based modulo per component and point:
   for (int g0 = 0; g0 < ng0; g0++)
-    for (int g1 = 0; g1 < ng1; g1++)
+    for (int g1 = 0; g1 < ng1; g1++) {
+      int p0 = ((C[0] * g0 + C[3] * g1) % ng0 + ng0) % ng0;
+      int p1 = ((C[1] * g0 + C[4] * g1) % ng1 + ng1) % ng1;
+      int p2 = ((C[2] * g0 + C[5] * g1) % ng2 + ng2) % ng2;
+      int d0 = ((C[6] % ng0) + ng0) % ng0;
+      int d1 = ((C[7] % ng1) + ng1) % ng1;
+      int d2 = ((C[8] % ng2) + ng2) % ng2;
       for (int g2 = 0; g2 < ng2; g2++) {
-        int p0 = ((C[0] * g0 + C[3] * g1 + C[6] * g2) % ng0 + ng0) % ng0;
-        int p1 = ((C[1] * g0 + C[4] * g1 + C[7] * g2) % ng1 + ng1) % ng1;
-        int p2 = ((C[2] * g0 + C[5] * g1 + C[8] * g2) % ng2 + ng2) % ng2;
         b_g[(p0 * ng1 + p1) * ng2 + p2] += *a_g++;
+        p0 += d0;
+        if (p0 >= ng0)
+          p0 -= ng0;
+        p1 += d1;
+        if (p1 >= ng1)
+          p1 -= ng1;
+        p2 += d2;
+        if (p2 >= ng2)
+          p2 -= ng2;
+      }
+    }
+
+  Py_RETURN_NONE;
+}
+
+
+// Apply the whole set of symmetry operations in one call, written as
+// a gather:
+//
+//     _   ---    =T_
+//   b(g) = >   a(U g).
+//          ---    s
+//           s
+//
+// The operations form a group, so replacing each one by its inverse
+// leaves the sum unchanged and this equals the sum of the scattered
+// updates that per-operation symmetrize calls accumulate.  Every
+// output row is written once, sequentially, and stays cache resident
+// while all operations read into it - instead of one strided pass
+// over the full grid per operation - and the rows are independent, so
+// slabs of them are handed to the thread pool.
+struct symall_args {
+  const double* a_g;
+  double* b_g;
+  const long* C_s;
+  int nop;
+  int ng0, ng1, ng2;
+  int g0a, g0b;
+};
+
+static void* symmetrize_all_worker(void* argp)
+{
+  struct symall_args* arg = (struct symall_args*)argp;
+  int ng0 = arg->ng0;
+  int ng1 = arg->ng1;
+  int ng2 = arg->ng2;
+  const double* a_g = arg->a_g;
+  for (int g0 = arg->g0a; g0 < arg->g0b; g0++)
+    for (int g1 = 0; g1 < ng1; g1++) {
+      double* b_G = arg->b_g + ((size_t)g0 * ng1 + g1) * ng2;
+      for (int s = 0; s < arg->nop; s++) {
+        const long* C = arg->C_s + 9 * s;
+        int p0 = ((C[0] * g0 + C[3] * g1) % ng0 + ng0) % ng0;
+        int p1 = ((C[1] * g0 + C[4] * g1) % ng1 + ng1) % ng1;
+        int p2 = ((C[2] * g0 + C[5] * g1) % ng2 + ng2) % ng2;
+        int d0 = ((C[6] % ng0) + ng0) % ng0;
+        int d1 = ((C[7] % ng1) + ng1) % ng1;
+        int d2 = ((C[8] % ng2) + ng2) % ng2;
+        for (int g2 = 0; g2 < ng2; g2++) {
+          b_G[g2] += a_g[((size_t)p0 * ng1 + p1) * ng2 + p2];
+          p0 += d0;
+          if (p0 >= ng0)
+            p0 -= ng0;
+          p1 += d1;
+          if (p1 >= ng1)
+            p1 -= ng1;
+          p2 += d2;
+          if (p2 >= ng2)
+            p2 -= ng2;
+        }
       }
+    }
+  return NULL;
+}
+
+PyObject* symmetrize_all(PyObject *self, PyObject *args)
+{
+  PyArrayObject* a_g_obj;
+  PyArrayObject* b_g_obj;
+  PyArrayObject* op_scc_obj;
+  if (!PyArg_ParseTuple(args, "OOO", &a_g_obj, &b_g_obj, &op_scc_obj))
+    return NULL;
+
+  int nop = op_scc_obj->dimensions[0];
+  int ng0 = a_g_obj->dimensions[0];
+  int ng1 = a_g_obj->dimensions[1];
+  int ng2 = a_g_obj->dimensions[2];
 
+  int nthds = 1;
+#ifdef GPAW_OMP_MONLY
+  nthds = gpaw_threadpool_size();
+  if (nthds > ng0)
+    nthds = (ng0 > 0) ? ng0 : 1;
+#endif
+  struct symall_args* wargs = GPAW_MALLOC(struct symall_args, nthds);
+  int g0 = 0;
+  for (int thd = 0; thd < nthds; thd++) {
+    struct symall_args* arg = wargs + thd;
+    arg->a_g = (const double*)a_g_obj->data;
+    arg->b_g = (double*)b_g_obj->data;
+    arg->C_s = (const long*)op_scc_obj->data;
+    arg->nop = nop;
+    arg->ng0 = ng0;
+    arg->ng1 = ng1;
+    arg->ng2 = ng2;
+    arg->g0a = g0;
+    g0 += ng0 / nthds + (thd < ng0 % nthds ? 1 : 0);
+    arg->g0b = g0;
+  }
+#ifdef GPAW_OMP_MONLY
+  gpaw_threadpool_run(symmetrize_all_worker, wargs,
+                      sizeof(struct symall_args), nthds);
+#else
+  symmetrize_all_worker(wargs);
+#endif
+  free(wargs);
   Py_RETURN_NONE;
 }
 
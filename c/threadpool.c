@@ -0,0 +1,129 @@
+/*  Copyright (C) 2010  CAMd
+ *  Please see the accompanying LICENSE file for further information. */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "threadpool.h"
+
+/* The workers sleep on a condition variable between jobs.  A job is
+ * published by bumping a generation counter; each worker with an index
+ * below the number of tasks runs its task and the last one to finish
+ * wakes the submitting thread. */
+
+static int tp_size = 0;            // total threads, including the caller
+static int tp_limit = 0;           // threads currently in use (<= tp_size)
+static pthread_t* tp_threads = NULL;
+static pthread_mutex_t tp_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tp_go = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t tp_done = PTHREAD_COND_INITIALIZER;
+static long tp_generation = 0;
+static int tp_active = 0;
+static gpaw_task_t tp_func;
+static char* tp_args;
+static long tp_argsize;
+static int tp_ntasks;
+// Set while a thread is executing pool tasks: nested submissions (e.g. a
+// threaded bmgs kernel called from a threaded operator worker) then run
+// serially on the calling thread instead of deadlocking the pool.
+static __thread int tp_busy = 0;
+
+static void* tp_worker(void* arg)
+{
+  long id = (long)arg;
+  long generation = 0;
+  for (;;)
+    {
+      pthread_mutex_lock(&tp_mutex);
+      while (tp_generation == generation)
+        pthread_cond_wait(&tp_go, &tp_mutex);
+      generation = tp_generation;
+      pthread_mutex_unlock(&tp_mutex);
+
+      tp_busy = 1;
+      for (long i = id; i < tp_ntasks; i += tp_size)
+        tp_func(tp_args + i * tp_argsize);
+      tp_busy = 0;
+
+      pthread_mutex_lock(&tp_mutex);
+      if (--tp_active == 0)
+        pthread_cond_signal(&tp_done);
+      pthread_mutex_unlock(&tp_mutex);
+    }
+  return NULL;
+}
+
+void gpaw_threadpool_init(void)
+{
+  if (tp_size > 0)
+    return;
+  int n = 1;
+  if (getenv("OMP_NUM_THREADS") != NULL)
+    n = atoi(getenv("OMP_NUM_THREADS"));
+  tp_size = 1;
+  tp_limit = 1;
+  gpaw_threadpool_set_size(n);
+}
+
+// Set the number of threads in use.  Growing beyond the current pool
+// starts new workers; shrinking just caps how many tasks the kernels
+// create (the extra workers sleep).  Must not be called while a job
+// is running.
+void gpaw_threadpool_set_size(int n)
+{
+  gpaw_threadpool_init();
+  if (n < 1)
+    n = 1;
+  if (n > tp_size)
+    {
+      tp_threads = (pthread_t*)realloc(tp_threads,
+                                       (n - 1) * sizeof(pthread_t));
+      for (long id = tp_size; id < n; id++)
+        if (pthread_create(tp_threads + id - 1, NULL, tp_worker,
+                           (void*)id) != 0)
+          {
+            // Could not start all workers; run with what we got.
+            n = id;
+            break;
+          }
+      tp_size = n;
+    }
+  tp_limit = n;
+}
+
+int gpaw_threadpool_size(void)
+{
+  gpaw_threadpool_init();
+  return tp_limit;
+}
+
+void gpaw_threadpool_run(gpaw_task_t func, void* args, long argsize,
+                         int ntasks)
+{
+  gpaw_threadpool_init();
+  if (tp_limit == 1 || ntasks == 1 || tp_busy)
+    {
+      for (int i = 0; i < ntasks; i++)
+        func((char*)args + i * argsize);
+      return;
+    }
+  pthread_mutex_lock(&tp_mutex);
+  tp_func = func;
+  tp_args = (char*)args;
+  tp_argsize = argsize;
+  tp_ntasks = ntasks;
+  tp_active = tp_size - 1;
+  tp_generation++;
+  pthread_cond_broadcast(&tp_go);
+  pthread_mutex_unlock(&tp_mutex);
+
+  // Tasks 0, tp_size, 2 * tp_size, ... run on the calling thread:
+  tp_busy = 1;
+  for (long i = 0; i < ntasks; i += tp_size)
+    func((char*)args + i * argsize);
+  tp_busy = 0;
+
+  pthread_mutex_lock(&tp_mutex);
+  while (tp_active > 0)
+    pthread_cond_wait(&tp_done, &tp_mutex);
+  pthread_mutex_unlock(&tp_mutex);
+}
@@ -0,0 +1,25 @@
+/*  Copyright (C) 2010  CAMd
+ *  Please see the accompanying LICENSE file for further information. */
+
+#ifndef H_THREADPOOL
+#define H_THREADPOOL
+
+/* Process-lifetime pool of worker threads shared by the threaded C
+ * kernels (stencil application, transfers, ...).  The pool is created
+ * once - either explicitly from the module initialization or lazily on
+ * first use - with OMP_NUM_THREADS workers, replacing the per-call
+ * pthread_create/pthread_join pattern.
+ *
+ * gpaw_threadpool_run(func, args, argsize, ntasks) calls
+ * func(args + i * argsize) for i = 0, ..., ntasks - 1; task 0 runs on
+ * the calling thread and the call returns when all tasks are done. */
+
+typedef void* (*gpaw_task_t)(void*);
+
+void gpaw_threadpool_init(void);
+void gpaw_threadpool_set_size(int n);
+int gpaw_threadpool_size(void);
+void gpaw_threadpool_run(gpaw_task_t func, void* args, long argsize,
+                         int ntasks);
+
+#endif // H_THREADPOOL
@@ -9,8 +9,10 @@
 #define NO_IMPORT_ARRAY
 #include <numpy/arrayobject.h>
 #include "extensions.h"
+#include "threadpool.h"
 #include "bc.h"
 #include "mympi.h"
+#include "perf.h"
 #include "bmgs/bmgs.h"
 
 #ifdef GPAW_ASYNC
@@ -19,6 +21,8 @@
   #define GPAW_ASYNC_D 1
 #endif
 
+#define GPAW_CHUNK_DEFAULT 10
+
 typedef struct
 {
   PyObject_HEAD
@@ -26,14 +30,30 @@ typedef struct
   int p;
   int k;
   bool interpolate;
+  // Overlap the halo exchange of the next band chunk with the
+  // transformation of the current one (self->async); GPAW_ASYNC only
+  // selects the default.
+  int async;
   MPI_Request recvreq[2];
   MPI_Request sendreq[2];
   int skip[3][2];
   int size_out[3];          /* Size of the output grid */
+  // Work buffers reused between apply calls (gpaw_workbuf):
+  double* work_buf;
+  double* work_send;
+  double* work_recv;
+  long nwork_buf;
+  long nwork_send;
+  long nwork_recv;
+  // Counter totals for apply calls (see perf.h):
+  gpaw_perf_t perf;
 } TransformerObject;
 
 static void Transformer_dealloc(TransformerObject *self)
 {
+  free(self->work_recv);
+  free(self->work_send);
+  free(self->work_buf);
   free(self->bc);
   PyObject_DEL(self);
 }
@@ -45,28 +65,56 @@ struct transapply_args{
   int ng2;
   int nin;
   int nthds;
+  int chunksize;
   const double* in;
   double* out;
   int real;
   const double_complex* ph;
+  // This thread's slices of the transformer's reused work buffers
+  // (buf2 follows the staging area(s) in the same slice):
+  double* buf;
+  double* sendbuf;
+  double* recvbuf;
 };
 
+// Transform one band from the extended staging array:
+static void transform1(TransformerObject* self, int real,
+                       const double* buf, double* out, double* buf2)
+{
+  boundary_conditions* bc = self->bc;
+  if (real)
+    {
+      if (self->interpolate)
+        bmgs_interpolate(self->k, self->skip, buf, bc->size2,
+                         out, buf2);
+      else
+        bmgs_restrict(self->k, (double*)buf, bc->size2,
+                      out, buf2);
+    }
+  else
+    {
+      if (self->interpolate)
+        bmgs_interpolatez(self->k, self->skip, (const double_complex*)buf,
+                          bc->size2, (double_complex*)out,
+                          (double_complex*) buf2);
+      else
+        bmgs_restrictz(self->k, (double_complex*) buf,
+                       bc->size2, (double_complex*)out,
+                       (double_complex*) buf2);
+    }
+}
+
 void *transapply_worker(void *threadarg)
 {
   struct transapply_args *args = (struct transapply_args *) threadarg;
   boundary_conditions* bc = args->self->bc;
   TransformerObject *self = args->self;
-  double* sendbuf = GPAW_MALLOC(double, bc->maxsend * GPAW_ASYNC_D);
-  double* recvbuf = GPAW_MALLOC(double, bc->maxrecv * GPAW_ASYNC_D);
-  double* buf = GPAW_MALLOC(double, args->ng2);
-  int buf2size = args->ng2;
-  if (self->interpolate)
-    buf2size *= 16;
-  else
-    buf2size /= 2;
-  double* buf2 = GPAW_MALLOC(double, buf2size);
-  MPI_Request recvreq[2 * GPAW_ASYNC_D];
-  MPI_Request sendreq[2 * GPAW_ASYNC_D];
+  double* sendbuf = args->sendbuf;
+  double* recvbuf = args->recvbuf;
+  double* buf = args->buf;
+  double* buf2 = buf + (long)args->ng2 * args->chunksize;
+  MPI_Request recvreq[2];
+  MPI_Request sendreq[2];
 
   int chunksize = args->nin / args->nthds;
   if (!chunksize)
@@ -77,88 +125,171 @@ void *transapply_worker(void *threadarg)
   int nend = nstart + chunksize;
   if (nend > args->nin)
     nend = args->nin;
+  if (chunksize > args->chunksize)
+    chunksize = args->chunksize;
 
   int out_ng = bc->ndouble * self->size_out[0] * self->size_out[1]
                * self->size_out[2];
 
-  for (int n = nstart; n < nend; n++)
+  for (int n = nstart; n < nend; n += chunksize)
     {
+      if (n + chunksize >= nend && chunksize > 1)
+        chunksize = nend - n;
       const double* in = args->in + n * args->ng;
       double* out = args->out + n * out_ng;
+      // One exchange per axis for the whole chunk of bands:
       for (int i = 0; i < 3; i++)
         {
           bc_unpack1(bc, in, buf, i,
                      recvreq, sendreq,
                      recvbuf, sendbuf, args->ph + 2 * i,
-                     args->thread_id, 1);
+                     args->thread_id, chunksize);
           bc_unpack2(bc, buf, i,
-                     recvreq, sendreq, recvbuf, 1);
+                     recvreq, sendreq, recvbuf, args->thread_id, chunksize);
         }
-      if (args->real)
-        {
-          if (self->interpolate)
-            bmgs_interpolate(self->k, self->skip, buf, bc->size2,
-                             out, buf2);
-          else
-            bmgs_restrict(self->k, buf, bc->size2,
-                          out, buf2);
-        }
-      else
+      for (int m = 0; m < chunksize; m++)
+        transform1(self, args->real, buf + m * args->ng2,
+                   out + m * out_ng, buf2);
+    }
+  return NULL;
+}
+
+// Double-buffering worker: the first-axis exchange of the next band
+// chunk is posted before the remaining exchanges and the transformation
+// of the current chunk, hiding one message latency per chunk.  The
+// axes stay sequential within a chunk - unlike the finite-difference
+// stencils, the transformation stencils need the corner values, so the
+// second-axis faces include halos received along the first axis.
+void *transapply_worker_async(void *threadarg)
+{
+  struct transapply_args *args = (struct transapply_args *) threadarg;
+  boundary_conditions* bc = args->self->bc;
+  TransformerObject *self = args->self;
+  long sstride = (long)bc->maxsend * args->chunksize;
+  long rstride = (long)bc->maxrecv * args->chunksize;
+  long bstride = (long)args->ng2 * args->chunksize;
+  double* buf2 = args->buf + 2 * bstride;
+  MPI_Request recvreq[4];
+  MPI_Request sendreq[4];
+
+  int chunksize = args->nin / args->nthds;
+  if (!chunksize)
+    chunksize = 1;
+  int nstart = args->thread_id * chunksize;
+  if (nstart >= args->nin)
+    return NULL;
+  int nend = nstart + chunksize;
+  if (nend > args->nin)
+    nend = args->nin;
+  if (chunksize > args->chunksize)
+    chunksize = args->chunksize;
+
+  int out_ng = bc->ndouble * self->size_out[0] * self->size_out[1]
+               * self->size_out[2];
+
+  int odd = 0;
+  int chunk = chunksize;
+  if (chunk > nend - nstart)
+    chunk = nend - nstart;
+  bc_unpack1(bc, args->in + (long)nstart * args->ng, args->buf, 0,
+             recvreq, sendreq, args->recvbuf, args->sendbuf,
+             args->ph, args->thread_id, chunk);
+  for (int n = nstart; n < nend; odd ^= 1)
+    {
+      int next = n + chunk;
+      int nextchunk = chunksize;
+      if (next + nextchunk > nend)
+        nextchunk = nend - next;
+      if (next < nend)
+        // Start the first-axis exchange of the next chunk (the matching
+        // receives were/are posted in the same chunk order on the
+        // neighbor, so same-tag messages pair up correctly):
+        bc_unpack1(bc, args->in + (long)next * args->ng,
+                   args->buf + (1 - odd) * bstride, 0,
+                   recvreq + (1 - odd) * 2, sendreq + (1 - odd) * 2,
+                   args->recvbuf + (1 - odd) * rstride,
+                   args->sendbuf + (1 - odd) * sstride,
+                   args->ph, args->thread_id, nextchunk);
+      double* buf = args->buf + odd * bstride;
+      bc_unpack2(bc, buf, 0, recvreq + odd * 2, sendreq + odd * 2,
+                 args->recvbuf + odd * rstride, args->thread_id, chunk);
+      for (int i = 1; i < 3; i++)
         {
-          if (self->interpolate)
-            bmgs_interpolatez(self->k, self->skip, (double_complex*)buf,
-                              bc->size2, (double_complex*)out,
-                              (double_complex*) buf2);
-          else
-            bmgs_restrictz(self->k, (double_complex*) buf,
-                           bc->size2, (double_complex*)out,
-                           (double_complex*) buf2);
+          bc_unpack1(bc, args->in + (long)n * args->ng, buf, i,
+                     recvreq + odd * 2, sendreq + odd * 2,
+                     args->recvbuf + odd * rstride,
+                     args->sendbuf + odd * sstride, args->ph + 2 * i,
+                     args->thread_id, chunk);
+          bc_unpack2(bc, buf, i, recvreq + odd * 2, sendreq + odd * 2,
+                     args->recvbuf + odd * rstride, args->thread_id, chunk);
         }
+      double* out = args->out + (long)n * out_ng;
+      for (int m = 0; m < chunk; m++)
+        transform1(self, args->real, buf + m * args->ng2,
+                   out + m * out_ng, buf2);
+      n = next;
+      chunk = nextchunk;
     }
-  free(buf2);
-  free(buf);
-  free(recvbuf);
-  free(sendbuf);
   return NULL;
 }
 
 
 
-static PyObject* Transformer_apply(TransformerObject *self, PyObject *args)
+// Raw apply entry point for C callers (declared in extensions.h); the
+// Python method below is a thin wrapper around it.
+void Transformer_apply_raw(PyObject* trobj, int nin, int real,
+                           const double_complex* ph,
+                           const double* in, double* out)
 {
-  PyArrayObject* input;
-  PyArrayObject* output;
-  PyArrayObject* phases = 0;
-  if (!PyArg_ParseTuple(args, "OO|O", &input, &output, &phases))
-    return NULL;
-
-  int nin = 1;
-  if (input->nd == 4)
-    nin = input->dimensions[0];
-
+  TransformerObject* self = (TransformerObject*)trobj;
   boundary_conditions* bc = self->bc;
   const int* size1 = bc->size1;
   const int* size2 = bc->size2;
   int ng = bc->ndouble * size1[0] * size1[1] * size1[2];
   int ng2 = bc->ndouble * size2[0] * size2[1] * size2[2];
 
-  const double* in = DOUBLEP(input);
-  double* out = DOUBLEP(output);
-  bool real = (input->descr->type_num == PyArray_DOUBLE);
-  const double_complex* ph = (real ? 0 : COMPLEXP(phases));
+  int chunksize = MIN(nin, GPAW_CHUNK_DEFAULT);
+  if (getenv("GPAW_CHUNK_SIZE") != NULL)
+    chunksize = atoi(getenv("GPAW_CHUNK_SIZE"));
 
   int nthds = 1;
 #ifdef GPAW_OMP
-  if (getenv("OMP_NUM_THREADS") != NULL)
-    nthds = atoi(getenv("OMP_NUM_THREADS"));
+  nthds = gpaw_threadpool_size();
 #endif
   struct transapply_args *wargs = GPAW_MALLOC(struct transapply_args, nthds);
-  pthread_t *thds = GPAW_MALLOC(pthread_t, nthds);
+
+  // Overlapping pays off only with more than one chunk in flight:
+  void *(*worker)(void*) = transapply_worker;
+  int nstage = 1;
+  if (self->async && chunksize > 1 && nin > chunksize)
+    {
+      worker = transapply_worker_async;
+      nstage = 2;
+    }
+
+  // Per-thread slices of the reused work buffers; the interpolation
+  // scratch array (buf2) lives in the same slice right after the
+  // staging area(s):
+  long buf2size = ng2;
+  if (self->interpolate)
+    buf2size *= 16;
+  else
+    buf2size /= 2;
+  long sper = (long)bc->maxsend * chunksize * nstage;
+  long rper = (long)bc->maxrecv * chunksize * nstage;
+  long bper = (long)ng2 * chunksize * nstage + buf2size;
+  double* sendbuf = gpaw_workbuf(&self->work_send, &self->nwork_send,
+                                 sper * nthds);
+  double* recvbuf = gpaw_workbuf(&self->work_recv, &self->nwork_recv,
+                                 rper * nthds);
+  double* buf = gpaw_workbuf(&self->work_buf, &self->nwork_buf,
+                             bper * nthds);
 
   for(int i=0; i < nthds; i++)
     {
       (wargs+i)->thread_id = i;
       (wargs+i)->nthds = nthds;
+      (wargs+i)->chunksize = chunksize;
       (wargs+i)->self = self;
       (wargs+i)->ng = ng;
       (wargs+i)->ng2 = ng2;
@@ -167,19 +298,53 @@ static PyObject* Transformer_apply(TransformerObject *self, PyObject *args)
       (wargs+i)->out = out;
       (wargs+i)->real = real;
       (wargs+i)->ph = ph;
+      (wargs+i)->sendbuf = sendbuf + i * sper;
+      (wargs+i)->recvbuf = recvbuf + i * rper;
+      (wargs+i)->buf = buf + i * bper;
     }
 
 #ifdef GPAW_OMP
-  for(int i=1; i < nthds; i++)
-    pthread_create(thds + i, NULL, transapply_worker, (void*) (wargs+i));
-#endif
-  transapply_worker(wargs);
-#ifdef GPAW_OMP
-  for(int i=1; i < nthds; i++)
-    pthread_join(*(thds+i), NULL);
+  gpaw_threadpool_run(worker, wargs, sizeof(*wargs), nthds);
+#else
+  worker(wargs);
 #endif
   free(wargs);
-  free(thds);
+}
+
+static PyObject* Transformer_apply(TransformerObject *self, PyObject *args)
+{
+  PyArrayObject* input;
+  PyArrayObject* output;
+  PyArrayObject* phases = 0;
+  if (!PyArg_ParseTuple(args, "OO|O", &input, &output, &phases))
+    return NULL;
+
+  int nin = 1;
+  if (input->nd == 4)
+    nin = input->dimensions[0];
+
+  bool real = (input->descr->type_num == PyArray_DOUBLE);
+  const double_complex* ph = (real ? 0 : COMPLEXP(phases));
+
+  long long counters[GPAW_PERF_NCOUNTERS];
+  double tperf = 0;
+  if (gpaw_perf_enabled)
+    gpaw_perf_start(counters, &tperf);
+
+  Transformer_apply_raw((PyObject*)self, nin, real, ph,
+                        DOUBLEP(input), DOUBLEP(output));
+
+  if (gpaw_perf_enabled) {
+    gpaw_perf_stop(&self->perf, counters, tperf);
+    // Streaming model: read input, write output, a k-tap filter per
+    // axis pass (see perf.h):
+    const int* n = self->size_out;
+    long long ngout = (long long)n[0] * n[1] * n[2];
+    long long ngin = (self->interpolate ? ngout / 8 : 8 * ngout);
+    long long cplx = (real ? 1 : 2);
+    gpaw_perf_model(&self->perf, 8 * cplx * nin * (ngin + ngout),
+                    2LL * self->k * cplx * nin * (ngin + 2 * ngout));
+  }
 
   Py_RETURN_NONE;
 }
@@ -189,17 +354,24 @@ static PyObject * Transformer_get_async_sizes(TransformerObject *self, PyObject
   if (!PyArg_ParseTuple(args, ""))
     return NULL;
 
-#ifdef GPAW_ASYNC
-  return Py_BuildValue("(ii)", 1, GPAW_ASYNC_D);
-#else
-  return Py_BuildValue("(ii)", 0, GPAW_ASYNC_D);
-#endif
+  return Py_BuildValue("(ii)", self->async, GPAW_ASYNC_D);
+}
+
+static PyObject * Transformer_get_stats(TransformerObject *self,
+                                        PyObject *args)
+{
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+
+  return gpaw_perf_stats(&self->perf);
 }
 
 static PyMethodDef Transformer_Methods[] = {
     {"apply", (PyCFunction)Transformer_apply, METH_VARARGS, NULL},
     {"get_async_sizes",
      (PyCFunction)Transformer_get_async_sizes, METH_VARARGS, NULL},
+    {"get_stats",
+     (PyCFunction)Transformer_get_stats, METH_VARARGS, NULL},
     {NULL, NULL, 0, NULL}
 };
 
@@ -231,10 +403,15 @@ PyObject * NewTransformerObject(PyObject *obj, PyObject *args)
   int real;
   PyObject* comm_obj;
   int interpolate;
-  if (!PyArg_ParseTuple(args, "OOiOOOOiOi",
+#ifdef GPAW_ASYNC
+  int async = 1;
+#else
+  int async = 0;
+#endif
+  if (!PyArg_ParseTuple(args, "OOiOOOOiOi|i",
                         &size_in, &size_out, &k, &paddings, &npaddings, &skip,
                         &neighbors, &real, &comm_obj,
-                        &interpolate))
+                        &interpolate, &async))
     return NULL;
 
   TransformerObject* self = PyObject_NEW(TransformerObject, &TransformerType);
@@ -243,6 +420,14 @@ PyObject * NewTransformerObject(PyObject *obj, PyObject *args)
 
   self->k = k;
   self->interpolate = interpolate;
+  self->async = async;
+  self->work_buf = NULL;
+  self->work_send = NULL;
+  self->work_recv = NULL;
+  self->nwork_buf = 0;
+  self->nwork_send = 0;
+  self->nwork_recv = 0;
+  memset(&self->perf, 0, sizeof(gpaw_perf_t));
 
   MPI_Comm comm = MPI_COMM_NULL;
   if (comm_obj != Py_None)
@@ -261,5 +446,26 @@ PyObject * NewTransformerObject(PyObject *obj, PyObject *args)
     for (int d = 0; d < 2; d++)
       self->skip[c][d] = (int)skp[c][d];
 
+  // Allocate the work buffers for the common single-band apply up
+  // front, so the first call inside the SCF loop does not hit malloc;
+  // gpaw_workbuf grows them if a larger batch comes along:
+  const boundary_conditions* bc = self->bc;
+  long ng2 = (long)bc->ndouble * bc->size2[0] * bc->size2[1] * bc->size2[2];
+  long buf2size = ng2;
+  if (self->interpolate)
+    buf2size *= 16;
+  else
+    buf2size /= 2;
+  int nthds = 1;
+#ifdef GPAW_OMP
+  nthds = gpaw_threadpool_size();
+#endif
+  gpaw_workbuf(&self->work_send, &self->nwork_send,
+               (long)bc->maxsend * nthds);
+  gpaw_workbuf(&self->work_recv, &self->nwork_recv,
+               (long)bc->maxrecv * nthds);
+  gpaw_workbuf(&self->work_buf, &self->nwork_buf,
+               (ng2 + buf2size) * nthds);
+
   return (PyObject*)self;
 }
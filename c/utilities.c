@@ -8,6 +8,7 @@
 #define NO_IMPORT_ARRAY
 #include <numpy/arrayobject.h>
 #include "extensions.h"
+#include "threadpool.h"
 #include <math.h>
 
 #ifdef GPAW_HPM
@@ -272,6 +273,141 @@ PyObject* elementwise_multiply_add(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
+/* scaled elementwise multiply and add:
+ *
+ * c[i] += s * a[i] * b[i]
+ */
+PyObject* scaled_elementwise_multiply_add(PyObject *self, PyObject *args)
+{
+  PyArrayObject* aa;
+  PyArrayObject* bb;
+  double s;
+  PyArrayObject* cc;
+  if (!PyArg_ParseTuple(args, "OOdO", &aa, &bb, &s, &cc))
+    return NULL;
+  const double* const a = DOUBLEP(aa);
+  const double* const b = DOUBLEP(bb);
+  double* const c = DOUBLEP(cc);
+  int n = PyArray_MultiplyList(aa->dimensions, aa->nd);
+  for (int i = 0; i < n; i++)
+    {
+      c[i] += s * a[i] * b[i];
+    }
+  Py_RETURN_NONE;
+}
+
+/* fused scale and accumulate:
+ *
+ * y[i] = a * x[i] + b * y[i]
+ *
+ * One pass over both operands instead of a scaling pass followed by
+ * an axpy.
+ */
+PyObject* axpby(PyObject *self, PyObject *args)
+{
+  double a;
+  PyArrayObject* xx;
+  double b;
+  PyArrayObject* yy;
+  if (!PyArg_ParseTuple(args, "dOdO", &a, &xx, &b, &yy))
+    return NULL;
+  const double* const x = DOUBLEP(xx);
+  double* const y = DOUBLEP(yy);
+  int n = PyArray_MultiplyList(xx->dimensions, xx->nd);
+  if (xx->descr->type_num != PyArray_DOUBLE)
+    n *= 2;
+  for (int i = 0; i < n; i++)
+    {
+      y[i] = a * x[i] + b * y[i];
+    }
+  Py_RETURN_NONE;
+}
+
+/* occupation-weighted density accumulation:
+ *
+ *               2
+ * nt[g] += f |psit [g]| ,  summed over all bands n,
+ *          n     n
+ *
+ * without forming the squared band as a temporary array.  Each thread
+ * owns a contiguous range of grid points and runs it through all
+ * bands, so the accumulator chunk stays in cache.
+ */
+struct add_density_args {
+  const double* psit_nG;
+  const double* f_n;
+  double* nt_G;
+  int nbands;
+  npy_intp ng;
+  int iscomplex;
+  npy_intp ga, gb;
+};
+
+static void* add_density_worker(void* argp)
+{
+  struct add_density_args* arg = (struct add_density_args*)argp;
+  for (int n = 0; n < arg->nbands; n++) {
+    double f = arg->f_n[n];
+    if (f == 0.0)
+      continue;
+    if (arg->iscomplex) {
+      const double* psit_G = arg->psit_nG + 2 * (n * arg->ng + arg->ga);
+      for (npy_intp g = arg->ga; g < arg->gb; g++) {
+        arg->nt_G[g] += f * (psit_G[0] * psit_G[0] + psit_G[1] * psit_G[1]);
+        psit_G += 2;
+      }
+    }
+    else {
+      const double* psit_G = arg->psit_nG + n * arg->ng;
+      for (npy_intp g = arg->ga; g < arg->gb; g++)
+        arg->nt_G[g] += f * psit_G[g] * psit_G[g];
+    }
+  }
+  return NULL;
+}
+
+PyObject* add_density(PyObject *self, PyObject *args)
+{
+  PyArrayObject* psit_nG_obj;
+  PyArrayObject* f_n_obj;
+  PyArrayObject* nt_G_obj;
+  if (!PyArg_ParseTuple(args, "OOO", &psit_nG_obj, &f_n_obj, &nt_G_obj))
+    return NULL;
+
+  int nbands = f_n_obj->dimensions[0];
+  npy_intp ng = PyArray_MultiplyList(nt_G_obj->dimensions, nt_G_obj->nd);
+
+  int nthds = 1;
+#ifdef GPAW_OMP_MONLY
+  nthds = gpaw_threadpool_size();
+  if (nthds > ng)
+    nthds = (ng > 0) ? ng : 1;
+#endif
+  struct add_density_args* wargs = GPAW_MALLOC(struct add_density_args,
+                                               nthds);
+  npy_intp g = 0;
+  for (int thd = 0; thd < nthds; thd++) {
+    struct add_density_args* arg = wargs + thd;
+    arg->psit_nG = (const double*)psit_nG_obj->data;
+    arg->f_n = (const double*)f_n_obj->data;
+    arg->nt_G = (double*)nt_G_obj->data;
+    arg->nbands = nbands;
+    arg->ng = ng;
+    arg->iscomplex = (psit_nG_obj->descr->type_num != PyArray_DOUBLE);
+    arg->ga = g;
+    g += ng / nthds + (thd < ng % nthds ? 1 : 0);
+    arg->gb = g;
+  }
+#ifdef GPAW_OMP_MONLY
+  gpaw_threadpool_run(add_density_worker, wargs,
+                      sizeof(struct add_density_args), nthds);
+#else
+  add_density_worker(wargs);
+#endif
+  free(wargs);
+  Py_RETURN_NONE;
+}
+
 
 PyObject* utilities_gaussian_wave(PyObject *self, PyObject *args)
 {
@@ -496,6 +632,64 @@ PyObject* hartree(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
+// Batched version of hartree: solve the radial Poisson equation for
+// many densities with the same l in one call.  The recurrences are
+// interleaved so that the grid geometry (r, r^l and the inverse) is
+// computed once per radial point and shared between the densities,
+// and the Python-C boundary is crossed once per batch instead of once
+// per (density, l) pair.
+PyObject* hartree_batch(PyObject *self, PyObject *args)
+{
+  int l;
+  PyArrayObject* nrdr_xg_array;
+  double b;
+  int N;
+  PyArrayObject* vr_xg_array;
+  if (!PyArg_ParseTuple(args, "iOdiO", &l, &nrdr_xg_array, &b, &N,
+                        &vr_xg_array))
+    return NULL;
+  const int nx = nrdr_xg_array->dimensions[0];
+  const int M = nrdr_xg_array->dimensions[1];
+  const double* nrdr_xg = DOUBLEP(nrdr_xg_array);
+  double* vr_xg = DOUBLEP(vr_xg_array);
+  double* p_x = GPAW_MALLOC(double, 2 * nx);
+  double* q_x = p_x + nx;
+  for (int x = 0; x < nx; x++)
+    {
+      p_x[x] = 0.0;
+      q_x[x] = 0.0;
+    }
+  for (int g = M - 1; g > 0; g--)
+    {
+      double r = b * g / (N - g);
+      double rl = pow(r, l);
+      double rlp1 = rl * r;
+      double invrl = 1.0 / rl;
+      for (int x = 0; x < nx; x++)
+        {
+          double nrdr = nrdr_xg[x * M + g];
+          double dp = nrdr * invrl;
+          double dq = nrdr * rlp1;
+          vr_xg[x * M + g] = ((p_x[x] + 0.5 * dp) * rlp1 -
+                              (q_x[x] + 0.5 * dq) * invrl);
+          p_x[x] += dp;
+          q_x[x] += dq;
+        }
+    }
+  double f = 4.0 * M_PI / (2 * l + 1);
+  for (int x = 0; x < nx; x++)
+    vr_xg[x * M] = 0.0;
+  for (int g = 1; g < M; g++)
+    {
+      double r = b * g / (N - g);
+      double invrl = 1.0 / pow(r, l);
+      for (int x = 0; x < nx; x++)
+        vr_xg[x * M + g] = f * (vr_xg[x * M + g] + q_x[x] * invrl);
+    }
+  free(p_x);
+  Py_RETURN_NONE;
+}
+
 PyObject* localize(PyObject *self, PyObject *args)
 {
   PyArrayObject* Z_nnc;
@@ -677,3 +871,92 @@ PyObject* spherical_harmonics(PyObject *self, PyObject *args)
     }
   Py_RETURN_NONE;
 }
+
+
+/* Batched Ewald lattice sums.
+ *
+ * Evaluates, for every vector r of r_xv, the real space sum
+ *
+ *   Er(r) = sum_{l != 0} erfc(G |l - r|) / |l - r|
+ *
+ * over the lattice vectors l = i a1 + j a2 + k a3 with
+ * |i|, |j|, |k| <= Nl_c, and the (unscaled) reciprocal space sum
+ *
+ *   Eg(r) = sum_{g != 0} exp(-g^2 / 4G^2) cos(g.r) / (g^2 / 4G^2)
+ *
+ * over g = 2 pi (i b1 + j b2 + k b3) with |i|, |j|, |k| <= Ng_c.
+ * Each lattice vector is set up once and streamed over the whole
+ * batch of r vectors, so batches of charge positions (or of whole
+ * charge configurations sharing one lattice) cost one pass over the
+ * shells instead of one per point. */
+PyObject* ewald_sums(PyObject *self, PyObject *args)
+{
+  PyArrayObject* cell_cv_obj;
+  PyArrayObject* recip_cv_obj;
+  double G;
+  PyArrayObject* r_xv_obj;
+  PyArrayObject* Nl_c_obj;
+  PyArrayObject* Ng_c_obj;
+  PyArrayObject* Er_x_obj;
+  PyArrayObject* Eg_x_obj;
+  if (!PyArg_ParseTuple(args, "OOdOOOOO", &cell_cv_obj, &recip_cv_obj, &G,
+                        &r_xv_obj, &Nl_c_obj, &Ng_c_obj,
+                        &Er_x_obj, &Eg_x_obj))
+    return NULL;
+
+  const double* cell_cv = DOUBLEP(cell_cv_obj);
+  const double* recip_cv = DOUBLEP(recip_cv_obj);
+  const double* r_xv = DOUBLEP(r_xv_obj);
+  const long* Nl_c = LONGP(Nl_c_obj);
+  const long* Ng_c = LONGP(Ng_c_obj);
+  double* Er_x = DOUBLEP(Er_x_obj);
+  double* Eg_x = DOUBLEP(Eg_x_obj);
+  int nx = PyArray_DIM(r_xv_obj, 0);
+
+  for (int x = 0; x < nx; x++) {
+    Er_x[x] = 0.0;
+    Eg_x[x] = 0.0;
+  }
+
+  // Real space shells:
+  for (long i = -Nl_c[0]; i <= Nl_c[0]; i++)
+    for (long j = -Nl_c[1]; j <= Nl_c[1]; j++)
+      for (long k = -Nl_c[2]; k <= Nl_c[2]; k++) {
+        double l_v[3];
+        for (int v = 0; v < 3; v++)
+          l_v[v] = (i * cell_cv[v] + j * cell_cv[3 + v] +
+                    k * cell_cv[6 + v]);
+        double l2 = l_v[0] * l_v[0] + l_v[1] * l_v[1] + l_v[2] * l_v[2];
+        if (l2 <= 1e-10)  // exclude l=0 (|l| <= 1e-5)
+          continue;
+        for (int x = 0; x < nx; x++) {
+          double dx = l_v[0] - r_xv[3 * x];
+          double dy = l_v[1] - r_xv[3 * x + 1];
+          double dz = l_v[2] - r_xv[3 * x + 2];
+          double lr = sqrt(dx * dx + dy * dy + dz * dz);
+          Er_x[x] += erfc(G * lr) / lr;
+        }
+      }
+
+  // Reciprocal space shells:
+  for (long i = -Ng_c[0]; i <= Ng_c[0]; i++)
+    for (long j = -Ng_c[1]; j <= Ng_c[1]; j++)
+      for (long k = -Ng_c[2]; k <= Ng_c[2]; k++) {
+        double g_v[3];
+        for (int v = 0; v < 3; v++)
+          g_v[v] = 2.0 * M_PI * (i * recip_cv[v] + j * recip_cv[3 + v] +
+                                 k * recip_cv[6 + v]);
+        double g2 = g_v[0] * g_v[0] + g_v[1] * g_v[1] + g_v[2] * g_v[2];
+        if (g2 <= 1e-10)  // exclude g=0
+          continue;
+        double y = 0.25 * g2 / (G * G);
+        double w = exp(-y) / y;
+        for (int x = 0; x < nx; x++) {
+          double gr = (g_v[0] * r_xv[3 * x] + g_v[1] * r_xv[3 * x + 1] +
+                       g_v[2] * r_xv[3 * x + 2]);
+          Eg_x[x] += w * cos(gr);
+        }
+      }
+
+  Py_RETURN_NONE;
+}
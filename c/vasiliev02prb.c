@@ -714,3 +714,72 @@ double *a, *b, *cvas, *d__, *x, *gamma, *beta1, *beta2;
 /*<       end >*/
 } /* ldavasiu_ */
 
+/* Chunked kernels (cf. xc.c): the grid loop lives in the functional
+   file, so the LDA parameter sets and the spin branch selection are
+   fetched once per call instead of once per grid point. */
+
+/* spin-paired fast path - only the unpolarised parametrisation is
+   evaluated and all polarised branches are skipped */
+void d2excdn2_u_n(int np, const double *den_p, double *res_p)
+{
+  double a, b, cvas, d, x, gamma, beta1, beta2;
+  ldavasiu_(&a, &b, &cvas, &d, &x, &gamma, &beta1, &beta2);
+  for (int i = 0; i < np; i++) {
+    double n = den_p[i];
+    res_p[i] = d2exdn2_(n);
+    if (n > 0.)
+      res_p[i] += d2ecdrho2_(&n, &a, &b, &cvas, &d, &x,
+			     &gamma, &beta1, &beta2);
+  }
+}
+
+/* spin-polarised, eqs. (34) and (42) for one (is,ks) pair */
+void d2excdnsdnt_n(int np, double *dup_p, double *ddn_p,
+		   int is, int ks, double *res_p)
+{
+  double au, bu, cu, du, xu, gu, b1u, b2u;
+  double ap, bp, cp, dp, xp, gp, b1p, b2p;
+  double (*dxins_f)(double*, double*);
+  double (*dxint_f)(double*, double*);
+  double (*d2xi_f)(double*, double*);
+
+  ldavasiu_(&au, &bu, &cu, &du, &xu, &gu, &b1u, &b2u);
+  ldavasip_(&ap, &bp, &cp, &dp, &xp, &gp, &b1p, &b2p);
+  dxins_f = (is == 1) ? dxidnu_ : dxidnd_;
+  dxint_f = (ks == 1) ? dxidnu_ : dxidnd_;
+  if (is != ks)
+    d2xi_f = d2xidnudnd_;
+  else if (is == 1)
+    d2xi_f = d2xidnu2_;
+  else
+    d2xi_f = d2xidnd2_;
+
+  for (int i = 0; i < np; i++) {
+    double nu = dup_p[i];
+    double nd = ddn_p[i];
+    /* exchange, eq. (34) - sees the unclamped densities */
+    double ex = 0.;
+    if (is == ks) {
+      double n2 = (is == 1) ? nu * nu : nd * nd;
+      if (n2 != 0.)
+	ex = -pow(2. / (PI * 9. * n2), 1./3.);
+    }
+    /* the scalar code clamps the densities in place - keep that */
+    if (nu <= 0.)
+      nu = dup_p[i] = 1e-99;
+    if (nd <= 0.)
+      nd = ddn_p[i] = 1e-99;
+    /* correlation, eq. (42) */
+    double n = nu + nd;
+    double ecu = ecorltn_(&n, &au, &bu, &cu, &du, &xu, &gu, &b1u, &b2u);
+    double ecp = ecorltn_(&n, &ap, &bp, &cp, &dp, &xp, &gp, &b1p, &b2p);
+    double dcu = decdrho_(&n, &au, &bu, &cu, &du, &xu, &gu, &b1u, &b2u);
+    double dcp = decdrho_(&n, &ap, &bp, &cp, &dp, &xp, &gp, &b1p, &b2p);
+    double d2cu = d2ecdrho2_(&n, &au, &bu, &cu, &du, &xu, &gu, &b1u, &b2u);
+    double d2cp = d2ecdrho2_(&n, &ap, &bp, &cp, &dp, &xp, &gp, &b1p, &b2p);
+    res_p[i] = ex + d2cu + xi_vasi__(&nu, &nd) * (d2cp - d2cu)
+      + (dxins_f(&nu, &nd) + dxint_f(&nu, &nd)) * (dcp - dcu)
+      + d2xi_f(&nu, &nd) * n * (ecp - ecu);
+  }
+}
+
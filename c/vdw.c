@@ -160,33 +160,49 @@ PyObject * vdw(PyObject* self, PyObject *args)
   return PyFloat_FromDouble(energy);
 }
 
+/* One output channel of the Roman-Perez/Soler convolution:
+ *
+ *   F(k) += sum_b phi   (k) theta (k)
+ *                    ab        b
+ *
+ * for all nb locally stored b channels in a single pass over the
+ * k-points, so the spline index j_k, the offset dk_k and the F_k
+ * accumulator are loaded once per k instead of once per channel.
+ * phi_bjp holds the nb kernel splines stacked, theta_bk the nb theta
+ * arrays stacked. */
 PyObject * vdw2(PyObject* self, PyObject *args)
 {
-  const PyArrayObject* phi_jp_obj;
+  const PyArrayObject* phi_bjp_obj;
   const PyArrayObject* j_k_obj;
   const PyArrayObject* dk_k_obj;
-  const PyArrayObject* theta_k_obj;
+  const PyArrayObject* theta_bk_obj;
   const PyArrayObject* F_k_obj;
-  if (!PyArg_ParseTuple(args, "OOOOO", &phi_jp_obj, &j_k_obj, &dk_k_obj,
-			&theta_k_obj, &F_k_obj))
+  if (!PyArg_ParseTuple(args, "OOOOO", &phi_bjp_obj, &j_k_obj, &dk_k_obj,
+			&theta_bk_obj, &F_k_obj))
     return NULL;
 
-  const double* phi_jp = (const double*)phi_jp_obj->data;
+  const double* phi_bjp = (const double*)phi_bjp_obj->data;
   const long* j_k = (const long*)j_k_obj->data;
   const double* dk_k = (const double*)dk_k_obj->data;
-  const complex double* theta_k = (const complex double*)theta_k_obj->data;
+  const complex double* theta_bk = (const complex double*)theta_bk_obj->data;
   complex double* F_k = (complex double*)F_k_obj->data;
 
   int nk = PyArray_SIZE(j_k_obj);
+  int nb = PyArray_SIZE(theta_bk_obj) / nk;
+  long nphi = PyArray_SIZE(phi_bjp_obj) / nb;
   for (int k = 0; k < nk; k++)
     {
-      const double* phi_p = phi_jp + 4 * j_k[k];
-      double a = phi_p[0];
-      double b = phi_p[1];
-      double c = phi_p[2];
-      double d = phi_p[3];
+      long j4 = 4 * j_k[k];
       double x = dk_k[k];
-      F_k[k] += theta_k[k] * (a + x * (b + x * (c + x * d)));
+      complex double f = 0.0;
+      for (int b = 0; b < nb; b++)
+	{
+	  const double* phi_p = phi_bjp + b * nphi + j4;
+	  f += theta_bk[b * nk + k] * (phi_p[0] +
+				       x * (phi_p[1] +
+					    x * (phi_p[2] + x * phi_p[3])));
+	}
+      F_k[k] += f;
     }
   Py_RETURN_NONE;
 }
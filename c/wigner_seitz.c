@@ -1,4 +1,5 @@
 #include "extensions.h"
+#include "threadpool.h"
 #include <stdlib.h>
 
 double distance(double *a, double *b);
@@ -16,6 +17,44 @@ double distance3d2_di(double *a, int *b)
   return sum;
 } 
 
+struct eed_args {
+  long* aindex;
+  double* atom_c;
+  double* vdWradius;
+  int natoms;
+  long* beg;
+  double* h_c;
+  int n[3];
+  int ia, ib;          // range of first-axis indices for this thread
+};
+
+static void* eed_region_worker(void* argp)
+{
+  struct eed_args* arg = (struct eed_args*)argp;
+  const int* n = arg->n;
+  double pos[3];
+  for (int i = arg->ia; i < arg->ib; i++) {
+    pos[0] = (arg->beg[0] + i) * arg->h_c[0];
+    for (int j = 0; j < n[1]; j++) {
+      pos[1] = (arg->beg[1] + j) * arg->h_c[1];
+      int ij = (i*n[1] + j)*n[2];
+      for (int k = 0; k < n[2]; k++) {
+	pos[2] = (arg->beg[2] + k) * arg->h_c[2];
+	arg->aindex[ij + k] = (long) 1; /* assume outside the structure */
+	// loop over all atoms
+	for (int a=0; a < arg->natoms; a++) {
+	  double d = distance(arg->atom_c + a*3, pos);
+	  if (d < arg->vdWradius[a]) {
+	    arg->aindex[ij + k] = (long) 0; /* this is inside */
+	    a = arg->natoms;
+	  }
+	}
+      }
+    }
+  }
+  return NULL;
+}
+
 PyObject *exterior_electron_density_region(PyObject *self, PyObject *args)
 {
   PyArrayObject* ai;
@@ -36,29 +75,41 @@ PyObject *exterior_electron_density_region(PyObject *self, PyObject *args)
   double *h_c = DOUBLEP(hh_c);
   double *vdWradius = DOUBLEP(vdWrad);
 
-  int n[3], ij;
-  double pos[3];
+  int n[3];
   for (int c = 0; c < 3; c++) { n[c] = end[c] - beg[c]; }
-  // loop over all points
-  for (int i = 0; i < n[0]; i++) {
-    pos[0] = (beg[0] + i) * h_c[0];
-    for (int j = 0; j < n[1]; j++) {
-      pos[1] = (beg[1] + j) * h_c[1];
-      ij = (i*n[1] + j)*n[2];
-      for (int k = 0; k < n[2]; k++) {
-	pos[2] = (beg[2] + k) * h_c[2];
-	aindex[ij + k] = (long) 1; /* assume outside the structure */
-	// loop over all atoms
-	for (int a=0; a < natoms; a++) {
-	  double d = distance(atom_c + a*3, pos);
-	  if (d < vdWradius[a]) {
-	    aindex[ij + k] = (long) 0; /* this is inside */
-	    a = natoms;
-	  }
-	}
-      }
-    }
+
+  // Grid points are classified independently, so hand slabs of the
+  // (already domain-local) grid to the thread pool:
+  int nthds = 1;
+#ifdef GPAW_OMP_MONLY
+  nthds = gpaw_threadpool_size();
+  if (nthds > n[0])
+    nthds = (n[0] > 0) ? n[0] : 1;
+#endif
+  struct eed_args* wargs = GPAW_MALLOC(struct eed_args, nthds);
+  int i = 0;
+  for (int thd = 0; thd < nthds; thd++) {
+    struct eed_args* arg = wargs + thd;
+    arg->aindex = aindex;
+    arg->atom_c = atom_c;
+    arg->vdWradius = vdWradius;
+    arg->natoms = natoms;
+    arg->beg = beg;
+    arg->h_c = h_c;
+    arg->n[0] = n[0];
+    arg->n[1] = n[1];
+    arg->n[2] = n[2];
+    arg->ia = i;
+    i += n[0] / nthds + (thd < n[0] % nthds ? 1 : 0);
+    arg->ib = i;
   }
+#ifdef GPAW_OMP_MONLY
+  gpaw_threadpool_run(eed_region_worker, wargs,
+                      sizeof(struct eed_args), nthds);
+#else
+  eed_region_worker(wargs);
+#endif
+  free(wargs);
 
   Py_RETURN_NONE;
 }
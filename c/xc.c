@@ -8,6 +8,7 @@
 #include <numpy/arrayobject.h>
 #include "xc_gpaw.h"
 #include "extensions.h"
+#include "threadpool.h"
 
 //
 //          __  2
@@ -42,6 +43,31 @@ double rpbe_exchange(const xc_parameters* par,
 double bee1_exchange(const xc_parameters* par,
 		     double n, double rs, double a2,
 		     double* dedrs, double* deda2);
+// Chunked kernels: the grid loop lives inside the functional file, so
+// the per-point math inlines into it and the indirect dispatch is paid
+// once per chunk instead of once per point:
+void pbe_exchange_n(const xc_parameters* par, int np,
+		    const double* n_g, const double* rs_g, const double* a2_g,
+		    double* e_g, double* dedrs_g, double* deda2_g);
+void rpbe_exchange_n(const xc_parameters* par, int np,
+		     const double* n_g, const double* rs_g, const double* a2_g,
+		     double* e_g, double* dedrs_g, double* deda2_g);
+void pbe_correlation_n(int np, const double* n_g, const double* rs_g,
+		       const double* zeta_g, const double* a2_g,
+		       bool gga, bool spinpol,
+		       double* e_g, double* dedrs_g, double* dedzeta_g,
+		       double* deda2_g);
+// Fused spin-paired exchange + correlation writing the final energy
+// density, potential and gradient derivative in one loop:
+void pbe_exchange_correlation_n(const xc_parameters* par, int np,
+				const double* n_g, const double* rs_g,
+				const double* a2_g, bool gga,
+				double* e_g, double* v_g,
+				double* dedsigma_g);
+
+// Number of grid points handed to a chunked kernel per dispatch; the
+// chunk's work buffers stay cache-resident between the kernels.
+#define GPAW_XC_CHUNK 1024
 
 typedef struct 
 {
@@ -52,6 +78,25 @@ typedef struct
   double (*correlation)(double n, double rs, double zeta, double a2, 
 			bool gga, bool spinpol,
 			double* dedrs, double* dedzeta, double* deda2);
+  // Chunked forms (0 for functionals that only have the per-point
+  // version; the driver then falls back to the point loop):
+  void (*exchange_n)(const xc_parameters* par, int np,
+		     const double* n_g, const double* rs_g,
+		     const double* a2_g,
+		     double* e_g, double* dedrs_g, double* deda2_g);
+  void (*correlation_n)(int np, const double* n_g, const double* rs_g,
+			const double* zeta_g, const double* a2_g,
+			bool gga, bool spinpol,
+			double* e_g, double* dedrs_g, double* dedzeta_g,
+			double* deda2_g);
+  // Fused spin-paired form (0 when exchange and correlation do not
+  // come from the same functional family; the driver then combines
+  // the two chunked kernels itself):
+  void (*exchange_correlation_n)(const xc_parameters* par, int np,
+				 const double* n_g, const double* rs_g,
+				 const double* a2_g, bool gga,
+				 double* e_g, double* v_g,
+				 double* dedsigma_g);
   xc_parameters par;
 } XCFunctionalObject;
 
@@ -60,38 +105,96 @@ static void XCFunctional_dealloc(XCFunctionalObject *self)
   PyObject_DEL(self);
 }
 
-static PyObject* 
-XCFunctional_calculate(XCFunctionalObject *self, PyObject *args)
+// Evaluate the functional on the grid points [gstart, gend).  Every
+// point is independent, so the driver below can hand disjoint slabs of
+// the grid to the worker threads; e_g and v_g are per-point arrays, so
+// no cross-thread reduction is needed.
+static void xc_calculate_slab(XCFunctionalObject* self, int nspins, int ng,
+                              int gstart, int gend,
+                              double* e_g, const double* n_g, double* v_g,
+                              const double* sigma_g, double* dedsigma_g)
 {
-  PyArrayObject* e_array;
-  PyArrayObject* n_array;
-  PyArrayObject* v_array;
-  PyArrayObject* sigma_array = 0;
-  PyArrayObject* dedsigma_array = 0;
-  if (!PyArg_ParseTuple(args, "OOO|OO", &e_array, &n_array, &v_array,
-			&sigma_array, &dedsigma_array))
-    return NULL;
-
-  int ng = 1;
-  for (int d = 0; d < PyArray_NDIM(e_array); d++)
-    ng *= PyArray_DIM(e_array, d);
-
   const xc_parameters* par = &self->par;
 
-  double* e_g = DOUBLEP(e_array);
-  const double* n_g = DOUBLEP(n_array);
-  double* v_g = DOUBLEP(v_array);
-
-  const double* sigma_g = 0;
-  double* dedsigma_g = 0;
-  if (par->gga)
+  if (nspins == 1 && self->exchange_correlation_n != 0)
     {
-      sigma_g = DOUBLEP(sigma_array);
-      dedsigma_g = DOUBLEP(dedsigma_array);
+      // Fused evaluation: exchange and correlation of a chunk in one
+      // pass, with the final assembly inside the kernel, so only the
+      // density and rs buffers are needed here:
+      double* buf = GPAW_MALLOC(double, 2 * GPAW_XC_CHUNK);
+      double* nb_p = buf;
+      double* rs_p = buf + GPAW_XC_CHUNK;
+      for (int g0 = gstart; g0 < gend; g0 += GPAW_XC_CHUNK)
+        {
+          int np = MIN(GPAW_XC_CHUNK, gend - g0);
+          for (int i = 0; i < np; i++)
+            {
+              double n = n_g[g0 + i];
+              if (n < NMIN)
+                n = NMIN;
+              nb_p[i] = n;
+              rs_p[i] = pow(C0I / n, THIRD);
+            }
+          if (par->gga)
+            self->exchange_correlation_n(par, np, nb_p, rs_p, sigma_g + g0,
+                                         1, e_g + g0, v_g + g0,
+                                         dedsigma_g + g0);
+          else
+            self->exchange_correlation_n(par, np, nb_p, rs_p, 0,
+                                         0, e_g + g0, v_g + g0, 0);
+        }
+      free(buf);
     }
-
-  if (PyArray_DIM(n_array, 0) == 1)
-    for (int g = 0; g < ng; g++)
+  else if (nspins == 1 && self->exchange_n != 0)
+    {
+      // Chunked evaluation: one indirect dispatch per chunk, with the
+      // exchange-correlation loops inside the functional kernels:
+      double* buf = GPAW_MALLOC(double, 8 * GPAW_XC_CHUNK);
+      double* nb_p = buf;
+      double* rs_p = buf + GPAW_XC_CHUNK;
+      double* ex_p = buf + 2 * GPAW_XC_CHUNK;
+      double* dexdrs_p = buf + 3 * GPAW_XC_CHUNK;
+      double* dexda2_p = buf + 4 * GPAW_XC_CHUNK;
+      double* ec_p = buf + 5 * GPAW_XC_CHUNK;
+      double* decdrs_p = buf + 6 * GPAW_XC_CHUNK;
+      double* decda2_p = buf + 7 * GPAW_XC_CHUNK;
+      for (int g0 = gstart; g0 < gend; g0 += GPAW_XC_CHUNK)
+        {
+          int np = MIN(GPAW_XC_CHUNK, gend - g0);
+          for (int i = 0; i < np; i++)
+            {
+              double n = n_g[g0 + i];
+              if (n < NMIN)
+                n = NMIN;
+              nb_p[i] = n;
+              rs_p[i] = pow(C0I / n, THIRD);
+            }
+          if (par->gga)
+            {
+              self->exchange_n(par, np, nb_p, rs_p, sigma_g + g0,
+                               ex_p, dexdrs_p, dexda2_p);
+              self->correlation_n(np, nb_p, rs_p, 0, sigma_g + g0, 1, 0,
+                                  ec_p, decdrs_p, 0, decda2_p);
+              for (int i = 0; i < np; i++)
+                dedsigma_g[g0 + i] = nb_p[i] * (dexda2_p[i] + decda2_p[i]);
+            }
+          else
+            {
+              self->exchange_n(par, np, nb_p, rs_p, 0, ex_p, dexdrs_p, 0);
+              self->correlation_n(np, nb_p, rs_p, 0, 0, 0, 0,
+                                  ec_p, decdrs_p, 0, 0);
+            }
+          for (int i = 0; i < np; i++)
+            {
+              e_g[g0 + i] = nb_p[i] * (ex_p[i] + ec_p[i]);
+              v_g[g0 + i] += (ex_p[i] + ec_p[i] -
+                              rs_p[i] * (dexdrs_p[i] + decdrs_p[i]) / 3.0);
+            }
+        }
+      free(buf);
+    }
+  else if (nspins == 1)
+    for (int g = gstart; g < gend; g++)
       {
         double n = n_g[g];
         if (n < NMIN)
@@ -132,7 +235,6 @@ XCFunctional_calculate(XCFunctionalObject *self, PyObject *args)
       double* dedsigma1_g = 0;
       double* dedsigma2_g = 0;
 
-      const xc_parameters* par = &self->par;
       if (par->gga)
         {
           sigma0_g = sigma_g;
@@ -143,7 +245,104 @@ XCFunctional_calculate(XCFunctionalObject *self, PyObject *args)
           dedsigma2_g = dedsigma1_g + ng;
         }
 
-      for (int g = 0; g < ng; g++)
+      if (self->exchange_n != 0)
+        {
+          // Chunked spin-polarized evaluation; the exchange kernel is
+          // dispatched once per chunk and channel:
+          double* buf = GPAW_MALLOC(double, 19 * GPAW_XC_CHUNK);
+          double* na_p = buf;
+          double* nb_p = buf + GPAW_XC_CHUNK;
+          double* rsa_p = buf + 2 * GPAW_XC_CHUNK;
+          double* rsb_p = buf + 3 * GPAW_XC_CHUNK;
+          double* n_p = buf + 4 * GPAW_XC_CHUNK;
+          double* rs_p = buf + 5 * GPAW_XC_CHUNK;
+          double* zeta_p = buf + 6 * GPAW_XC_CHUNK;
+          double* a2a_p = buf + 7 * GPAW_XC_CHUNK;
+          double* a2b_p = buf + 8 * GPAW_XC_CHUNK;
+          double* a2_p = buf + 9 * GPAW_XC_CHUNK;
+          double* exa_p = buf + 10 * GPAW_XC_CHUNK;
+          double* exb_p = buf + 11 * GPAW_XC_CHUNK;
+          double* dexadrs_p = buf + 12 * GPAW_XC_CHUNK;
+          double* dexbdrs_p = buf + 13 * GPAW_XC_CHUNK;
+          double* dexada2_p = buf + 14 * GPAW_XC_CHUNK;
+          double* dexbda2_p = buf + 15 * GPAW_XC_CHUNK;
+          double* ec_p = buf + 16 * GPAW_XC_CHUNK;
+          double* decdrs_p = buf + 17 * GPAW_XC_CHUNK;
+          double* decdzeta_p = buf + 18 * GPAW_XC_CHUNK;
+          double* decda2_p = a2a_p;  // reused after the exchange calls
+          for (int g0 = gstart; g0 < gend; g0 += GPAW_XC_CHUNK)
+            {
+              int np = MIN(GPAW_XC_CHUNK, gend - g0);
+              for (int i = 0; i < np; i++)
+                {
+                  double na = 2.0 * na_g[g0 + i];
+                  if (na < NMIN)
+                    na = NMIN;
+                  double nb = 2.0 * nb_g[g0 + i];
+                  if (nb < NMIN)
+                    nb = NMIN;
+                  double n = 0.5 * (na + nb);
+                  na_p[i] = na;
+                  nb_p[i] = nb;
+                  n_p[i] = n;
+                  rsa_p[i] = pow(C0I / na, THIRD);
+                  rsb_p[i] = pow(C0I / nb, THIRD);
+                  rs_p[i] = pow(C0I / n, THIRD);
+                  zeta_p[i] = 0.5 * (na - nb) / n;
+                }
+              if (par->gga)
+                {
+                  for (int i = 0; i < np; i++)
+                    {
+                      a2a_p[i] = 4.0 * sigma0_g[g0 + i];
+                      a2b_p[i] = 4.0 * sigma2_g[g0 + i];
+                      a2_p[i] = (sigma0_g[g0 + i] + 2 * sigma1_g[g0 + i] +
+                                 sigma2_g[g0 + i]);
+                    }
+                  self->exchange_n(par, np, na_p, rsa_p, a2a_p,
+                                   exa_p, dexadrs_p, dexada2_p);
+                  self->exchange_n(par, np, nb_p, rsb_p, a2b_p,
+                                   exb_p, dexbdrs_p, dexbda2_p);
+                  self->correlation_n(np, n_p, rs_p, zeta_p, a2_p, 1, 1,
+                                      ec_p, decdrs_p, decdzeta_p, decda2_p);
+                  for (int i = 0; i < np; i++)
+                    {
+                      dedsigma0_g[g0 + i] = (2 * na_p[i] * dexada2_p[i] +
+                                             n_p[i] * decda2_p[i]);
+                      dedsigma1_g[g0 + i] = 2 * n_p[i] * decda2_p[i];
+                      dedsigma2_g[g0 + i] = (2 * nb_p[i] * dexbda2_p[i] +
+                                             n_p[i] * decda2_p[i]);
+                    }
+                }
+              else
+                {
+                  self->exchange_n(par, np, na_p, rsa_p, 0,
+                                   exa_p, dexadrs_p, 0);
+                  self->exchange_n(par, np, nb_p, rsb_p, 0,
+                                   exb_p, dexbdrs_p, 0);
+                  self->correlation_n(np, n_p, rs_p, zeta_p, 0, 0, 1,
+                                      ec_p, decdrs_p, decdzeta_p, 0);
+                }
+              for (int i = 0; i < np; i++)
+                {
+                  e_g[g0 + i] = (0.5 * (na_p[i] * exa_p[i] +
+                                        nb_p[i] * exb_p[i]) +
+                                 n_p[i] * ec_p[i]);
+                  va_g[g0 + i] += (exa_p[i] + ec_p[i] -
+                                   (rsa_p[i] * dexadrs_p[i] +
+                                    rs_p[i] * decdrs_p[i]) / 3.0 -
+                                   (zeta_p[i] - 1.0) * decdzeta_p[i]);
+                  vb_g[g0 + i] += (exb_p[i] + ec_p[i] -
+                                   (rsb_p[i] * dexbdrs_p[i] +
+                                    rs_p[i] * decdrs_p[i]) / 3.0 -
+                                   (zeta_p[i] + 1.0) * decdzeta_p[i]);
+                }
+            }
+          free(buf);
+          return;
+        }
+
+      for (int g = gstart; g < gend; g++)
         {
           double na = 2.0 * na_g[g];
           if (na < NMIN)
@@ -195,6 +394,96 @@ XCFunctional_calculate(XCFunctionalObject *self, PyObject *args)
                       (zeta + 1.0) * decdzeta);
         }
     }
+}
+
+struct xccalc_args{
+  int thread_id;
+  int nthds;
+  XCFunctionalObject* self;
+  int nspins;
+  int ng;
+  double* e_g;
+  const double* n_g;
+  double* v_g;
+  const double* sigma_g;
+  double* dedsigma_g;
+};
+
+static void* xc_calculate_worker(void* threadarg)
+{
+  struct xccalc_args *args = (struct xccalc_args *) threadarg;
+
+  int chunksize = args->ng / args->nthds + 1;
+  int gstart = args->thread_id * chunksize;
+  if (gstart >= args->ng)
+    return NULL;
+  int gend = gstart + chunksize;
+  if (gend > args->ng)
+    gend = args->ng;
+
+  xc_calculate_slab(args->self, args->nspins, args->ng, gstart, gend,
+                    args->e_g, args->n_g, args->v_g,
+                    args->sigma_g, args->dedsigma_g);
+  return NULL;
+}
+
+static PyObject* 
+XCFunctional_calculate(XCFunctionalObject *self, PyObject *args)
+{
+  PyArrayObject* e_array;
+  PyArrayObject* n_array;
+  PyArrayObject* v_array;
+  PyArrayObject* sigma_array = 0;
+  PyArrayObject* dedsigma_array = 0;
+  if (!PyArg_ParseTuple(args, "OOO|OO", &e_array, &n_array, &v_array,
+			&sigma_array, &dedsigma_array))
+    return NULL;
+
+  int ng = 1;
+  for (int d = 0; d < PyArray_NDIM(e_array); d++)
+    ng *= PyArray_DIM(e_array, d);
+
+  int nspins = PyArray_DIM(n_array, 0);
+
+  double* e_g = DOUBLEP(e_array);
+  const double* n_g = DOUBLEP(n_array);
+  double* v_g = DOUBLEP(v_array);
+
+  const double* sigma_g = 0;
+  double* dedsigma_g = 0;
+  if (self->par.gga)
+    {
+      sigma_g = DOUBLEP(sigma_array);
+      dedsigma_g = DOUBLEP(dedsigma_array);
+    }
+
+  int nthds = 1;
+#ifdef GPAW_OMP_MONLY
+  nthds = gpaw_threadpool_size();
+#endif
+  struct xccalc_args *wargs = GPAW_MALLOC(struct xccalc_args, nthds);
+
+  for(int i=0; i < nthds; i++)
+    {
+      (wargs+i)->thread_id = i;
+      (wargs+i)->nthds = nthds;
+      (wargs+i)->self = self;
+      (wargs+i)->nspins = nspins;
+      (wargs+i)->ng = ng;
+      (wargs+i)->e_g = e_g;
+      (wargs+i)->n_g = n_g;
+      (wargs+i)->v_g = v_g;
+      (wargs+i)->sigma_g = sigma_g;
+      (wargs+i)->dedsigma_g = dedsigma_g;
+    }
+#ifdef GPAW_OMP_MONLY
+  gpaw_threadpool_run(xc_calculate_worker, wargs, sizeof(struct xccalc_args),
+                      nthds);
+#else
+  xc_calculate_worker(wargs);
+#endif
+  free(wargs);
+
   Py_RETURN_NONE;
 }
 
@@ -235,7 +524,10 @@ PyObject * NewXCFunctionalObject(PyObject *obj, PyObject *args)
   self->par.gga = 1;
 
   self->correlation = pbe_correlation;
+  self->correlation_n = pbe_correlation_n;
+  self->exchange_n = pbe_exchange_n;
   self->exchange = pbe_exchange;
+  self->exchange_correlation_n = pbe_exchange_correlation_n;
 
   if (code == -1) {
     // LDA
@@ -247,20 +539,26 @@ PyObject * NewXCFunctionalObject(PyObject *obj, PyObject *args)
   }
   else if (code == 1) {
     // revPBE
-    self->par.kappa = 1.245; 
+    self->par.kappa = 1.245;
   }
   else if (code == 2) {
     // RPBE
     self->exchange = rpbe_exchange;
+    self->exchange_n = rpbe_exchange_n;
+    self->exchange_correlation_n = 0;
   }
   else if (code == 14) {
-    // PW91
+    // PW91 (per-point only)
     self->exchange = pw91_exchange;
+    self->exchange_n = 0;
+    self->exchange_correlation_n = 0;
   }
   else {
-    // BEE1
+    // BEE1 (per-point only)
     assert(code == 18);
     self->exchange = bee1_exchange;
+    self->exchange_n = 0;
+    self->exchange_correlation_n = 0;
     int n = PyArray_DIM(parameters, 0);
     assert(n <= 14);
     double* p = (double*)PyArray_BYTES(parameters);
@@ -453,10 +453,10 @@ def build_interpreter(define_macros, include_dirs, libraries, library_dirs,
                             '-Wl,-wrap,fstat',
                             '-Wl,-wrap,fstat64',
                             '-Wl,-wrap,fgetc',
-                            # '-Wl,-wrap,fputc',
-                            # '-Wl,-wrap,fputs',
-                            # '-Wl,-wrap,fwrite',
-                            # '-Wl,-wrap,_IO_putc',
+                            '-Wl,-wrap,fputc',
+                            '-Wl,-wrap,fputs',
+                            '-Wl,-wrap,fwrite',
+                            '-Wl,-wrap,_IO_putc',
                             '-Wl,-wrap,fopen',
                             '-Wl,-wrap,fopen64',
                             '-Wl,-wrap,fclose',
@@ -65,6 +65,7 @@ sl_diagonalize = None
 sl_inverse_cholesky = None
 sl_lcao = None
 buffer_size = None
+nthreads = None
 extra_parameters = {}
 profile = False
 i = 1
@@ -171,6 +172,9 @@ while len(sys.argv) > i:
     elif arg.startswith('--buffer_size='):
         # Buffer size for MatrixOperator in MB
         buffer_size = int(arg.split('=')[1])
+    elif arg.startswith('--threads='):
+        # Number of threads per MPI rank for the threaded C kernels
+        nthreads = int(arg.split('=')[1])
     elif arg.startswith('--gpaw='):
         extra_parameters = eval('dict(%s)' % arg[7:])
     elif arg == '--gpaw':
@@ -40,12 +40,13 @@ class WignerSeitz:
     def expand(self, density):
         """Expand a smooth density in Wigner-Seitz cells around the atoms"""
         n = len(self.atoms)
-        weights = np.empty((n,))
-        for a in range(n):
-            mask = np.where(self.atom_index == a, density, 0.0)
-            # XXX Optimize! No need to integrate in zero-region
-            weights[a] = self.gd.integrate(mask)
-
+        # One pass over the grid collects all atomic sums, and one
+        # reduction combines them over the domains:
+        sum_a = np.bincount(self.atom_index.ravel(), density.ravel())
+        weights = np.zeros(n)
+        weights[:len(sum_a)] = sum_a
+        weights *= self.gd.dv
+        self.gd.comm.sum(weights)
         return weights
 
     def expand_density(self, nt_G, s, nspins):
@@ -540,8 +540,8 @@ class BasisMaker:
             spline = Spline(bf.l, rgd.r_g[rgd.r2g_floor(bf.rc)],
                             bf.phit_g,
                             rgd.r_g, beta=rgd.beta, points=100)
-            bf.phit_g = np.array([spline(r) * r**bf.l
-                                   for r in equidistant_grid[:bf.ng]])
+            r_g = equidistant_grid[:bf.ng]
+            bf.phit_g = spline.map(r_g) * r_g**bf.l
             bf.phit_g[-1] = 0.
 
         basis = Basis(g.symbol, self.name, False)
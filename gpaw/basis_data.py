@@ -7,6 +7,7 @@ import xml.sax
 import numpy as np
 
 from gpaw import setup_paths
+from gpaw.mpi import broadcast
 from gpaw.setup_data import search_for_file
 from gpaw.grid_descriptor import EquidistantRadialGridDescriptor
 
@@ -185,6 +186,17 @@ class BasisSetXMLParser(xml.sax.handler.ContentHandler):
         the sz-part from the N.dzp.basis file."""
         
         basis = self.basis
+        if filename is None and world is not None and world.size > 1:
+            # Only rank 0 touches the disk and parses; the others get
+            # the finished attributes as a pickle broadcast:
+            if world.rank == 0:
+                self.parse()
+                state = dict(basis.__dict__)
+            else:
+                state = None
+            basis.__dict__.update(broadcast(state, 0, world))
+            return
+
         if '(' in basis.name:
             reduced, name = basis.name.split('(')
             name = name[:-1]
@@ -513,8 +513,31 @@ class Redistributor:
         
         # Switch to Fortran conventions
         uplo = {'U': 'L', 'L': 'U', 'G': 'G'}[self.uplo]
-        
-        _gpaw.scalapack_redist(srcdescriptor.asarray(), 
+
+        srcgrid = srcdescriptor.blacsgrid
+        dstgrid = dstdescriptor.blacsgrid
+        if (uplo == 'G' and ia == ja == ib == jb == 0 and
+            (subM, subN) == srcdescriptor.gshape == dstdescriptor.gshape and
+            srcgrid.comm is self.supercomm and
+            dstgrid.comm is self.supercomm):
+            # Both grids span the supercommunicator, so each rank can
+            # work out the block intersection map itself and exchange
+            # only the needed blocks point-to-point, instead of
+            # synchronizing every rank through pdgemr2d's union
+            # context.  Grid shapes are passed in the same transposed
+            # (Fortran) view as the descriptors:
+            _gpaw.scalapack_redist_p2p(srcdescriptor.asarray(),
+                                       dstdescriptor.asarray(),
+                                       src_mn, dst_mn,
+                                       subN, subM,
+                                       self.supercomm.get_c_object(),
+                                       srcgrid.npcol, srcgrid.nprow,
+                                       srcgrid.order,
+                                       dstgrid.npcol, dstgrid.nprow,
+                                       dstgrid.order)
+            return
+
+        _gpaw.scalapack_redist(srcdescriptor.asarray(),
                                dstdescriptor.asarray(),
                                src_mn, dst_mn,
                                subN, subM,
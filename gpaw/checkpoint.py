@@ -0,0 +1,164 @@
+"""In-memory checkpointing of the SCF-critical state.
+
+Disk checkpoints through gpaw.io are too slow to take every few
+iterations on large parallel runs.  The MemoryCheckpoint class snapshots
+the rank-local part of the density, the mixer history and the wave
+functions into plain arrays, and optionally replicates the pickled
+snapshot into a partner rank's memory, so a checkpoint costs a few array
+copies and one point-to-point message instead of a filesystem write.
+
+Typical use as an observer::
+
+  cp = MemoryCheckpoint(calc)
+  calc.attach(cp.save, 5)
+  ...
+  cp.restore()  # roll the calculation back to the last snapshot
+
+The partner copies make each rank's state survive the loss of its own
+node's memory, which is the expensive half of fault tolerance.  Actually
+continuing after a rank dies also needs a fault-tolerant MPI runtime
+that can deliver a shrunk communicator; with a standard MPI the whole
+job still aborts, but a freshly started job can be seeded from the
+snapshots the partners hold (see the restore docstring)."""
+
+import cPickle as pickle
+
+import numpy as np
+
+from gpaw import mpi
+
+
+def _copy_state(obj, names):
+    """Copy the named array/dict-of-array attributes of obj."""
+    state = {}
+    for name in names:
+        a = getattr(obj, name, None)
+        if isinstance(a, np.ndarray):
+            state[name] = a.copy()
+        elif isinstance(a, dict):
+            state[name] = dict([(key, b.copy()) for key, b in a.items()])
+    return state
+
+
+def _restore_state(obj, state):
+    """Write copied attributes back, in place where possible.
+
+    Arrays are filled in place so that views held elsewhere (the
+    hamiltonian, the eigensolver) keep seeing the restored data."""
+    for name, a in state.items():
+        b = getattr(obj, name, None)
+        if isinstance(a, np.ndarray):
+            if isinstance(b, np.ndarray) and b.shape == a.shape:
+                b[:] = a
+            else:
+                setattr(obj, name, a.copy())
+        else:
+            if not isinstance(b, dict):
+                b = {}
+                setattr(obj, name, b)
+            for key, c in a.items():
+                if key in b and b[key].shape == c.shape:
+                    b[key][:] = c
+                else:
+                    b[key] = c.copy()
+
+
+def _mixer_state(mixer):
+    """Snapshot the history of a mixer (recursively for spin mixers)."""
+    state = {}
+    for name, value in mixer.__dict__.items():
+        if name == 'mixers':
+            state[name] = [_mixer_state(m) for m in value]
+        elif isinstance(value, np.ndarray):
+            state[name] = value.copy()
+        elif isinstance(value, list):
+            state[name] = [[a.copy() for a in item]
+                           if isinstance(item, list) else item
+                           for item in value]
+        elif isinstance(value, (int, long, float, complex, type(None))):
+            state[name] = value
+    return state
+
+
+def _restore_mixer(mixer, state):
+    for name, value in state.items():
+        if name == 'mixers':
+            for m, s in zip(mixer.mixers, value):
+                _restore_mixer(m, s)
+        else:
+            mixer.__dict__[name] = value
+
+
+class MemoryCheckpoint:
+    """Snapshot and restore the SCF state without touching the disk."""
+
+    def __init__(self, paw, replicate=True):
+        """Create checkpointer for the PAW calculator paw.
+
+        With replicate=True (the default) every save also sends the
+        pickled snapshot to a partner rank in the far half of the world
+        communicator - on the usual rank-per-node orderings that is a
+        different node - and keeps the partner's snapshot here."""
+        self.paw = paw
+        self.replicate = replicate
+        self.state = None
+        self.partner_blob = None
+        self.niter = None
+
+        comm = paw.wfs.world
+        self.comm = comm
+        # Pair rank r with r + size/2; with an odd size the last rank
+        # keeps a local snapshot only:
+        half = comm.size // 2
+        if comm.rank < half:
+            self.partner = comm.rank + half
+        elif comm.rank < 2 * half:
+            self.partner = comm.rank - half
+        else:
+            self.partner = None
+
+    def save(self):
+        """Snapshot the SCF-critical state of this rank.
+
+        Collective over the world communicator when replicating."""
+        paw = self.paw
+        state = {'density': _copy_state(paw.density,
+                                        ['nt_sG', 'nt_sg', 'nt_g',
+                                         'rhot_g', 'D_asp', 'Q_aL']),
+                 'mixer': _mixer_state(paw.density.mixer),
+                 'kpt_u': [_copy_state(kpt, ['psit_nG', 'C_nM', 'eps_n',
+                                             'f_n', 'P_ani'])
+                           for kpt in paw.wfs.kpt_u]}
+        self.state = state
+        self.niter = len(paw.scf.energies)
+
+        if self.replicate and self.partner is not None:
+            blob = pickle.dumps((self.comm.rank, self.niter, state),
+                                pickle.HIGHEST_PROTOCOL)
+            # The lower rank of each pair sends first, the higher one
+            # receives first, so the exchange cannot deadlock:
+            if self.comm.rank < self.partner:
+                mpi.send_string(blob, self.partner, self.comm)
+                self.partner_blob = mpi.receive_string(self.partner,
+                                                       self.comm)
+            else:
+                self.partner_blob = mpi.receive_string(self.partner,
+                                                       self.comm)
+                mpi.send_string(blob, self.partner, self.comm)
+
+    def restore(self):
+        """Roll this rank back to its last snapshot.
+
+        Restores density, mixer history and wave functions and rebuilds
+        the effective potential from the restored density, after which
+        the SCF loop can simply continue.  To recover the state of a
+        rank that is gone, unpickle partner_blob on its partner; the
+        (rank, niter, state) tuple it holds is everything a replacement
+        rank needs."""
+        assert self.state is not None
+        paw = self.paw
+        _restore_state(paw.density, self.state['density'])
+        _restore_mixer(paw.density.mixer, self.state['mixer'])
+        for kpt, state in zip(paw.wfs.kpt_u, self.state['kpt_u']):
+            _restore_state(kpt, state)
+        paw.hamiltonian.update(paw.density)
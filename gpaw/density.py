@@ -158,14 +158,26 @@ class Density:
     def update(self, wfs):
         self.timer.start('Density')
         self.timer.start('Pseudo density')
-        self.calculate_pseudo_density(wfs)
+        # The two grid reductions of the pseudo density run
+        # non-blocking behind the atomic density matrices and the
+        # multipole moments, which do not depend on them:
+        flow = wfs.icalculate_density_contribution(self.nt_sG)
+        flow.next()
         self.timer.stop('Pseudo density')
         self.timer.start('Atomic density matrices')
         wfs.calculate_atomic_density_matrices(self.D_asp)
         self.timer.stop('Atomic density matrices')
+        self.timer.start('Pseudo density')
+        flow.next()
+        self.timer.stop('Pseudo density')
         self.timer.start('Multipole moments')
         comp_charge = self.calculate_multipole_moments()
         self.timer.stop('Multipole moments')
+        self.timer.start('Pseudo density')
+        for x in flow:
+            pass
+        self.nt_sG += self.nct_G
+        self.timer.stop('Pseudo density')
         
         if isinstance(wfs, LCAOWaveFunctions):
             self.timer.start('Normalize')
@@ -222,8 +234,9 @@ class Density:
         if self.nt_sg is None:
             self.nt_sg = self.finegd.empty(self.nspins)
 
-        for s in range(self.nspins):
-            self.interpolator.apply(self.nt_sG[s], self.nt_sg[s])
+        # One batched apply - a single boundary exchange per axis for
+        # all spins:
+        self.interpolator.apply(self.nt_sG, self.nt_sg)
 
         # With periodic boundary conditions, the interpolation will
         # conserve the number of electrons.
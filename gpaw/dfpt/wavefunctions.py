@@ -97,7 +97,8 @@ class WaveFunctions:
                 # KPoint from ground-state calculation
                 kpt_ = kpt_u[ik]
                 weight = 1. / kd.nbzkpts * (2 - kpt_.s)
-                phase_cd = np.exp(2j * pi * gd.sdisp_cd * k_c[:, np.newaxis])
+                kd.initialize_phases(gd.sdisp_cd)
+                phase_cd = kd.get_phases(k_c)
 
                 psit_nG = gd.empty(nbands, dtype=self.dtype)
 
@@ -11,6 +11,11 @@ import numpy as np
 UNIFORM = False# distribute grid points uniformly
                # XXX import this from gpaw.extra_parameters dict ?
 
+CARTESIAN = False# topology-aware decomposition: let MPI reorder the
+                 # ranks (Cartesian communicator) and pick parallel
+                 # sizes that minimize the halo surface area
+                 # XXX import this from gpaw.extra_parameters dict ?
+
 
 class Domain:
     """Domain class.
@@ -80,6 +85,12 @@ class Domain:
         if np.product(self.parsize_c) != self.comm.size:
             raise RuntimeError('Bad domain decomposition!')
 
+        if CARTESIAN and self.comm.size > 1:
+            # Let the MPI library renumber the ranks to match the
+            # machine topology.  The Cartesian ranks are row-major, so
+            # the stride based rank arithmetic below still applies:
+            self.comm = self.comm.cart_create(self.parsize_c, self.pbc_c)
+
         self.parpos_c = self.get_processor_position_from_rank()
         self.find_neighbor_processors()
 
@@ -182,7 +193,18 @@ def decompose_domain(ng, p):
             m1 = float(n1) / p1
             m2 = float(n2) / p2
             m3 = float(n3) / p3
-        cost = abs(m1 - m2) + abs(m2 - m3) + abs(m3 - m1)
+        if CARTESIAN:
+            # Minimize the surface area communicated in halo exchanges
+            # (only decomposed axes have halos):
+            cost = 0.0
+            if p1 > 1:
+                cost += m2 * m3
+            if p2 > 1:
+                cost += m1 * m3
+            if p3 > 1:
+                cost += m1 * m2
+        else:
+            cost = abs(m1 - m2) + abs(m2 - m3) + abs(m3 - m1)
         # A long z-axis (unit stride) is best:
         if m1 <= m2 <= m3:
             cost -= 0.1
@@ -19,6 +19,7 @@ from ase.parallel import paropen
 from ase.units import Hartree
 from gpaw import mpi
 from gpaw.utilities import devnull
+from gpaw.utilities.blas import gemv
 from gpaw.occupations import OccupationNumbers, FermiDirac
 
 def dscf_calculation(paw, orbitals, atoms):
@@ -197,30 +198,36 @@ class MolecularOrbital:
             
         c_un = []
         for u, kpt in enumerate(wfs.kpt_u):
-            Porb_n = np.zeros(wfs.nbands, dtype=complex)
+            # Projections of the local band group onto the orbital, as
+            # one matrix-vector product per atom:
+            Porb_n = np.zeros(wfs.bd.mynbands, dtype=complex)
             for a, P_ni in kpt.P_ani.items():
                 if a in self.w.keys():
-                    for i in range(len(self.w[a])):
-                        Porb_n += self.w[a][i] * P_ni[:,i]
+                    w_i = np.asarray(self.w[a])
+                    Porb_n += np.dot(P_ni[:, :len(w_i)], w_i)
             wfs.gd.comm.sum(Porb_n)
 
+            # The band window and normalization are global:
+            Porb_N = wfs.bd.collect(Porb_n, broadcast=True)
+            eps_N = wfs.bd.collect(kpt.eps_n, broadcast=True)
+
             # Starting from KS orbitals with largest overlap,
             # fill in the expansion coeffients between Estart and Eend
-            c_n = np.zeros(wfs.nbands, dtype=complex)
+            c_N = np.zeros(wfs.nbands, dtype=complex)
             nos = 0
-            bandpriority = np.argsort(abs(Porb_n)**2)[::-1]
+            bandpriority = np.argsort(abs(Porb_N)**2)[::-1]
 
             for n in bandpriority:
-                if (kpt.eps_n[n] > epsF[kpt.s] + self.Estart and
-                    kpt.eps_n[n] < epsF[kpt.s] + self.Eend):
-                    c_n[n] = Porb_n[n].conj()
+                if (eps_N[n] > epsF[kpt.s] + self.Estart and
+                    eps_N[n] < epsF[kpt.s] + self.Eend):
+                    c_N[n] = Porb_N[n].conj()
                     nos += 1
                 if nos == self.nos:
                     break
-            
+
             # Normalize expansion coefficients
-            c_n /= np.sqrt(sum(abs(c_n)**2))
-            c_un.append(c_n)
+            c_N /= np.sqrt(sum(abs(c_N)**2))
+            c_un.append(c_N[wfs.bd.get_slice()])
 
         return c_un
                     
@@ -309,43 +316,53 @@ class AEOrbital:
         p_u = []
         for u, kpt in enumerate(wfs.kpt_u):
 
-            # Inner product of pseudowavefunctions
+            # Inner product of pseudowavefunctions - one matrix-vector
+            # product over the local band block:
             wf = np.reshape(wf_u[u], -1)
             Wf_n = kpt.psit_nG
             Wf_n = np.reshape(Wf_n, (len(kpt.f_n), -1))
-            Porb_n = np.dot(Wf_n.conj(), wf) * wfs.gd.dv
+            if wf.dtype == wfs.dtype:
+                Porb_n = np.zeros(len(kpt.f_n), dtype=wfs.dtype)
+                trans = 't'
+                if wfs.dtype == complex:
+                    trans = 'c'
+                gemv(wfs.gd.dv, Wf_n, wf, 0.0, Porb_n, trans)
+                Porb_n = Porb_n.astype(complex)
+            else:
+                Porb_n = np.dot(Wf_n.conj(), wf) * wfs.gd.dv
 
-            # Correction to obtain inner product of AE wavefunctions
+            # Correction to obtain inner product of AE wavefunctions,
+            # with the PAW overlap applied to the whole band block:
             for a, p_i in p_uai[u].items():
-                for n in range(wfs.nbands):
-                    for i in range(len(p_i)):
-                        for j in range(len(p_i)):
-                            Porb_n[n] += (kpt.P_ani[a][n][i].conj() *
-                                          wfs.setups[a].dO_ii[i][j] *
-                                          p_i[j])
+                v_i = np.dot(wfs.setups[a].dO_ii, p_i)
+                Porb_n += np.dot(kpt.P_ani[a].conj(), v_i)
             wfs.gd.comm.sum(Porb_n)
 
+            # The band window and normalization are global:
+            Porb_N = wfs.bd.collect(Porb_n, broadcast=True)
+            eps_N = wfs.bd.collect(kpt.eps_n, broadcast=True)
+
             #print 'Kpt:', kpt.k, ' Spin:', kpt.s, \
-            #      ' Sum_n|<orb|nks>|^2:', sum(abs(Porb_n)**2)
-            p_u.append(np.array([sum(abs(Porb_n)**2)], dtype=float))
+            #      ' Sum_n|<orb|nks>|^2:', sum(abs(Porb_N)**2)
+            p_u.append(np.array([sum(abs(Porb_N)**2)], dtype=float))
 
             # Starting from KS orbitals with largest overlap,
             # fill in the expansion coeffients
-            c_n = np.zeros(wfs.nbands, dtype=complex)
+            c_N = np.zeros(wfs.nbands, dtype=complex)
             nos = 0
-            bandpriority = np.argsort(abs(Porb_n)**2)[::-1]
+            bandpriority = np.argsort(abs(Porb_N)**2)[::-1]
 
             for n in bandpriority:
-                if (kpt.eps_n[n] > epsF[kpt.s] + self.Estart and
-                    kpt.eps_n[n] < epsF[kpt.s] + self.Eend):
-                    c_n[n] = Porb_n[n]
+                if (eps_N[n] > epsF[kpt.s] + self.Estart and
+                    eps_N[n] < epsF[kpt.s] + self.Eend):
+                    c_N[n] = Porb_N[n]
                     nos += 1
                 if nos == self.nos:
                     break
 
             # Normalize expansion coefficients
-            c_n /= np.sqrt(sum(abs(c_n)**2))
-            c_un.append(c_n)
+            c_N /= np.sqrt(sum(abs(c_N)**2))
+            c_un.append(c_N[wfs.bd.get_slice()])
 
         for s in range(wfs.nspins):
             for k in range(wfs.nibzkpts):
@@ -3,6 +3,7 @@
 from gpaw.eigensolvers.rmm_diis import RMM_DIIS
 from gpaw.eigensolvers.cg import CG
 from gpaw.eigensolvers.davidson import Davidson
+from gpaw.eigensolvers.chebyshev import Chebyshev
 from gpaw.lcao.eigensolver import LCAO
 
 
@@ -17,12 +18,13 @@ def get_eigensolver(name, mode, convergence=None):
         eigensolver = {'rmm-diis':  RMM_DIIS,
                        'cg':        CG,
                        'dav':       Davidson,
+                       'cheby':     Chebyshev,
                        'lcao':      LCAO
                        }[name]()
     else:
         eigensolver = name
     
-    if isinstance(eigensolver, CG):
+    if convergence is not None:
         eigensolver.tolerance = convergence['eigenstates']
 
     assert isinstance(eigensolver, LCAO) == (mode == 'lcao')
@@ -0,0 +1,183 @@
+"""Module defining a Chebyshev-filtered subspace iteration eigensolver."""
+
+import numpy as np
+
+from gpaw.utilities import unpack
+from gpaw.utilities.lapack import diagonalize
+from gpaw.eigensolvers.eigensolver import Eigensolver
+
+
+class Chebyshev(Eigensolver):
+    """Chebyshev-filtered subspace iteration (CheFSI) eigensolver.
+
+    Instead of minimizing residuals band by band, each SCF step runs
+    every wave function through a degree-m Chebyshev polynomial in the
+    Hamiltonian, scaled to damp the unwanted part of the spectrum
+    [lb, ub] and amplify everything below lb.  The filter is nothing
+    but repeated Hamiltonian applications, so it consists almost
+    entirely of stencil operations and projector work that parallelize
+    over domains; the Rayleigh-Ritz step (subspace diagonalization)
+    only runs every ``rr_interval`` iterations.
+
+    Between Rayleigh-Ritz steps the eigenvalues (and hence the
+    occupations) are frozen at their last computed values - the usual
+    CheFSI approximation.  The filtered vectors are orthonormalized by
+    the ordinary machinery after each iteration.
+
+    The spectral bounds are estimated with a few Lanczos steps on a
+    random vector whenever Rayleigh-Ritz runs: ub is the largest Ritz
+    value plus the trailing residual norm, and lb is the largest
+    occupied-space eigenvalue."""
+
+    def __init__(self, degree=8, rr_interval=3, blocksize=10):
+        Eigensolver.__init__(self, keep_htpsit=False, blocksize=blocksize)
+        self.degree = degree
+        self.rr_interval = rr_interval
+        # Per k-point state (keyed by (s, k)):
+        self.step_k = {}
+        self.bounds_k = {}
+        self.error_k = {}
+
+    def __repr__(self):
+        return 'Chebyshev-filtered subspace iteration (degree=%d)' % \
+            self.degree
+
+    def apply_hamiltonian(self, hamiltonian, wfs, kpt, psit_xG, Hpsit_xG):
+        """Apply the full Hamiltonian (local plus PAW corrections)."""
+        wfs.apply_pseudo_hamiltonian(kpt, hamiltonian, psit_xG, Hpsit_xG)
+        P_axi = wfs.pt.dict(len(psit_xG))
+        wfs.pt.integrate(psit_xG, P_axi, kpt.q)
+        for a, P_xi in P_axi.items():
+            dH_ii = unpack(hamiltonian.dH_asp[a][kpt.s])
+            P_axi[a] = np.dot(P_xi, dH_ii)
+        wfs.pt.add(Hpsit_xG, P_axi, kpt.q)
+
+    def estimate_upper_bound(self, hamiltonian, wfs, kpt, nsteps=4):
+        """Upper spectral bound from a few Lanczos steps.
+
+        Returns max(Ritz values) + the trailing beta, which bounds the
+        largest eigenvalue up to the (tiny) component of the random
+        vector outside the Krylov space."""
+        gd = self.gd
+        dv = gd.dv
+        v_G = gd.empty(dtype=self.dtype)
+        w_G = gd.empty(dtype=self.dtype)
+        v_G[:] = np.random.random(v_G.shape) - 0.5
+        if self.dtype == complex:
+            v_G += 1.0j * (np.random.random(v_G.shape) - 0.5)
+        norm = np.sqrt(gd.comm.sum(np.vdot(v_G, v_G).real) * dv)
+        v_G /= norm
+        vold_G = None
+        beta = 0.0
+        alpha_i = np.zeros(nsteps)
+        beta_i = np.zeros(nsteps)
+        for i in range(nsteps):
+            self.apply_hamiltonian(hamiltonian, wfs, kpt,
+                                   v_G[np.newaxis], w_G[np.newaxis])
+            alpha = gd.comm.sum(np.vdot(v_G, w_G).real) * dv
+            w_G -= alpha * v_G
+            if vold_G is not None:
+                w_G -= beta * vold_G
+            beta = np.sqrt(gd.comm.sum(np.vdot(w_G, w_G).real) * dv)
+            alpha_i[i] = alpha
+            beta_i[i] = beta
+            if beta < 1e-12:
+                break
+            vold_G = v_G.copy()
+            v_G[:] = w_G / beta
+        T_ii = np.diag(alpha_i)
+        for i in range(nsteps - 1):
+            T_ii[i, i + 1] = T_ii[i + 1, i] = beta_i[i]
+        eps_i = np.empty(nsteps)
+        diagonalize(T_ii, eps_i)
+        return eps_i[-1] + beta_i[nsteps - 1]
+
+    def calculate_error(self, hamiltonian, wfs, kpt, work_xG):
+        """Residual-norm error of the current (Ritz) wave functions."""
+        error = 0.0
+        B = self.blocksize
+        P_axi = wfs.pt.dict(B)
+        for n1 in range(0, wfs.bd.mynbands, B):
+            n2 = min(n1 + B, wfs.bd.mynbands)
+            if n2 - n1 < B:
+                B = n2 - n1
+                P_axi = dict([(a, P_xi[:B]) for a, P_xi in P_axi.items()])
+            n_x = range(n1, n2)
+            psit_xG = kpt.psit_nG[n1:n2]
+            R_xG = work_xG[:B]
+            wfs.apply_pseudo_hamiltonian_and_subtract(
+                kpt, hamiltonian, psit_xG, kpt.eps_n[n_x], R_xG)
+            wfs.pt.integrate(psit_xG, P_axi, kpt.q)
+            self.calculate_residuals(kpt, wfs, hamiltonian, psit_xG,
+                                     P_axi, kpt.eps_n[n_x], R_xG, n_x,
+                                     eps_subtracted=True)
+            for n in n_x:
+                if kpt.f_n is None:
+                    weight = kpt.weight
+                else:
+                    weight = kpt.f_n[n]
+                if self.nbands_converge != 'occupied':
+                    if wfs.bd.global_index(n) < self.nbands_converge:
+                        weight = kpt.weight
+                    else:
+                        weight = 0.0
+                error += weight * np.vdot(R_xG[n - n1], R_xG[n - n1]).real
+        return self.gd.comm.sum(error)
+
+    def iterate_one_k_point(self, hamiltonian, wfs, kpt):
+        """One filtered subspace iteration for a single k-point."""
+        key = (kpt.s, kpt.k)
+        step = self.step_k.get(key, 0)
+        self.step_k[key] = step + 1
+
+        B = self.blocksize
+        work1_xG = self.gd.empty(B, self.dtype)
+        work2_xG = self.gd.empty(B, self.dtype)
+
+        if step % self.rr_interval == 0:
+            self.subspace_diagonalize(hamiltonian, wfs, kpt)
+            self.timer.start('CheFSI bounds')
+            ub = self.estimate_upper_bound(hamiltonian, wfs, kpt)
+            lb = kpt.eps_n.max() + 1e-3 * (ub - kpt.eps_n.max())
+            self.bounds_k[key] = (lb, ub)
+            self.timer.stop('CheFSI bounds')
+            self.error_k[key] = self.calculate_error(hamiltonian, wfs, kpt,
+                                                     work1_xG)
+        lb, ub = self.bounds_k[key]
+        a0 = min(kpt.eps_n.min(), lb - 1.0)
+
+        self.timer.start('CheFSI filter')
+        e = 0.5 * (ub - lb)
+        c = 0.5 * (ub + lb)
+        sigma1 = e / (a0 - c)
+        for n1 in range(0, wfs.bd.mynbands, B):
+            n2 = min(n1 + B, wfs.bd.mynbands)
+            nb = n2 - n1
+            # Three rotating buffers: the previous iterate, the
+            # current one and the new one.
+            psit_xG = kpt.psit_nG[n1:n2]
+            X_xG = psit_xG
+            Y_xG = work1_xG[:nb]
+            T_xG = work2_xG[:nb]
+
+            # Y = (H - c) X * sigma1 / e:
+            self.apply_hamiltonian(hamiltonian, wfs, kpt, X_xG, Y_xG)
+            Y_xG -= c * X_xG
+            Y_xG *= sigma1 / e
+
+            sigma = sigma1
+            for i in range(2, self.degree + 1):
+                sigma2 = 1.0 / (2.0 / sigma1 - sigma)
+                # T = 2 sigma2 / e (H - c) Y - sigma sigma2 X:
+                self.apply_hamiltonian(hamiltonian, wfs, kpt, Y_xG, T_xG)
+                T_xG -= c * Y_xG
+                T_xG *= 2.0 * sigma2 / e
+                T_xG -= sigma * sigma2 * X_xG
+                X_xG, Y_xG, T_xG = Y_xG, T_xG, X_xG
+                sigma = sigma2
+
+            if Y_xG is not psit_xG:
+                psit_xG[:] = Y_xG
+        self.timer.stop('CheFSI filter')
+
+        return self.error_k[key]
@@ -3,7 +3,12 @@
 import numpy as np
 
 from gpaw.utilities.blas import axpy, rk, r2k, gemm
-from gpaw.utilities.lapack import diagonalize, general_diagonalize
+from gpaw import extra_parameters
+from gpaw.band_descriptor import BandDescriptor
+from gpaw.hs_operators import MatrixOperator
+from gpaw.kohnsham_layouts import BandLayouts
+from gpaw.utilities.lapack import diagonalize, general_diagonalize, \
+    general_diagonalize_mixed
 from gpaw.utilities import unpack
 from gpaw.eigensolvers.eigensolver import Eigensolver
 
@@ -29,26 +34,53 @@ class Davidson(Eigensolver):
     def initialize(self, wfs):
         Eigensolver.initialize(self, wfs)
         self.overlap = wfs.overlap
-        # Allocate arrays
-        self.H_nn = np.zeros((self.nbands, self.nbands), self.dtype)
-        self.S_nn = np.zeros((self.nbands, self.nbands), self.dtype)
+        if self.band_comm.size > 1:
+            if self.bd.strided:
+                raise NotImplementedError('Davidson eigensolver requires '
+                                          'blocked band distribution')
+            # With band groups, the expansion space {psit_n, psit2_n} is
+            # treated as one band-parallel set of 2 * nbands states, so
+            # that the subspace matrices can be assembled through the
+            # band-group ring of hs_operators - each rank contributes
+            # its psit_nG slice followed by its preconditioned
+            # residuals:
+            bd2 = BandDescriptor(2 * self.nbands, self.band_comm)
+            self.ksl2 = BandLayouts(self.gd, bd2, self.dtype,
+                                    self.ksl.buffer_size, self.timer)
+            self.operator2 = MatrixOperator(self.ksl2)
+            self.psit_2nG = self.gd.empty(2 * self.mynbands, self.dtype)
+            self.R_nG = self.gd.empty(self.mynbands, self.dtype)
+            self.Ht_nG = self.gd.empty(self.mynbands, self.dtype)
+        else:
+            # Allocate arrays
+            self.H_nn = np.zeros((self.nbands, self.nbands), self.dtype)
+            self.S_nn = np.zeros((self.nbands, self.nbands), self.dtype)
         self.H_2n2n = np.empty((2 * self.nbands, 2 * self.nbands),
                                 self.dtype)
         self.S_2n2n = np.empty((2 * self.nbands, 2 * self.nbands),
-                                self.dtype)        
+                                self.dtype)
         self.eps_2n = np.empty(2 * self.nbands)
 
     def estimate_memory(self, mem, gd, dtype, mynbands, nbands):
         Eigensolver.estimate_memory(self, mem, gd, dtype, mynbands, nbands)
         itemsize = mem.itemsize[dtype]
-        mem.subnode('H_nn', nbands * nbands * mem.itemsize[dtype])
-        mem.subnode('S_nn', nbands * nbands * mem.itemsize[dtype])
+        if mynbands != nbands:
+            # Band-parallel work arrays (see initialize):
+            mem.subnode('psit_2nG', 2 * mynbands * gd.bytecount(dtype))
+            mem.subnode('R_nG', mynbands * gd.bytecount(dtype))
+            mem.subnode('Ht_nG', mynbands * gd.bytecount(dtype))
+        else:
+            mem.subnode('H_nn', nbands * nbands * mem.itemsize[dtype])
+            mem.subnode('S_nn', nbands * nbands * mem.itemsize[dtype])
         mem.subnode('H_2n2n', 4 * nbands * nbands * mem.itemsize[dtype])
         mem.subnode('S_2n2n', 4 * nbands * nbands * mem.itemsize[dtype])
         mem.subnode('eps_2n', 2 * nbands * mem.floatsize)
 
     def iterate_one_k_point(self, hamiltonian, wfs, kpt):
         """Do Davidson iterations for the kpoint"""
+        if self.band_comm.size > 1:
+            return self.iterate_one_k_point_distributed(hamiltonian, wfs, kpt)
+
         niter = self.niter
         nbands = self.nbands
 
@@ -133,8 +165,22 @@ class Davidson(Eigensolver):
             self.gd.comm.sum(self.S_nn, 0)
             S_2n2n[nbands:, nbands:] = self.S_nn
 
-            if self.gd.comm.rank == 0:
-                general_diagonalize(H_2n2n, eps_2n, S_2n2n)
+            if self.ksl.using_blacs:
+                # Scatter the replicated subspace problem onto the
+                # BLACS grid instead of duplicating the O(nbands^3)
+                # solve on every rank; the eigenvectors land on
+                # domain rank 0 as in the serial path.
+                self.ksl.general_diagonalize(H_2n2n, eps_2n, S_2n2n)
+            elif self.gd.comm.rank == 0:
+                # While the residuals are still large, full double
+                # precision is overkill for the subspace problem - the
+                # mixed-precision solver is switched per iteration on
+                # the error from the previous one:
+                tol = extra_parameters.get('mixed_precision_subspace')
+                if tol and self.error > tol:
+                    general_diagonalize_mixed(H_2n2n, eps_2n, S_2n2n)
+                else:
+                    general_diagonalize(H_2n2n, eps_2n, S_2n2n)
 
             self.gd.comm.broadcast(H_2n2n, 0)
             self.gd.comm.broadcast(eps_2n, 0)
@@ -166,6 +212,126 @@ class Davidson(Eigensolver):
         error = self.gd.comm.sum(error)
         return error
 
+    def iterate_one_k_point_distributed(self, hamiltonian, wfs, kpt):
+        """Davidson iterations with band parallelization.
+
+        The expansion space is the band-parallel set of 2 * nbands
+        states holding each group's wave functions followed by its
+        preconditioned residuals.  The 2n x 2n subspace matrices are
+        assembled with the band-group ring of *operator2* and the
+        rotation back onto the nbands lowest states is applied per band
+        group with its matrix_multiply.  Unlike the serial path, the
+        psit-psit block is recomputed instead of taken as diagonal -
+        that keeps the assembly on the general ring code at the cost of
+        applying the Hamiltonian to the old states once more.
+        """
+        niter = self.niter
+        nbands = self.nbands
+        mynbands = self.mynbands
+        bd = self.bd
+        B = self.band_comm.size
+
+        self.subspace_diagonalize(hamiltonian, wfs, kpt)
+
+        H_2n2n = self.H_2n2n
+        S_2n2n = self.S_2n2n
+        eps_2n = self.eps_2n
+        psit_2nG = self.psit_2nG
+        R_nG = self.R_nG
+
+        self.timer.start('Davidson')
+        wfs.kin.apply(kpt.psit_nG, self.Ht_nG, kpt.phase_cd)
+        hamiltonian.apply_local_potential(kpt.psit_nG, self.Ht_nG, kpt.s)
+        R_nG[:] = self.Ht_nG
+        self.calculate_residuals(kpt, wfs, hamiltonian, kpt.psit_nG,
+                                 kpt.P_ani, kpt.eps_n, R_nG)
+
+        for nit in range(niter):
+            error = 0.0
+            for n in range(mynbands):
+                if kpt.f_n is None:
+                    weight = kpt.weight
+                else:
+                    weight = kpt.f_n[n]
+                if self.nbands_converge != 'occupied':
+                    if bd.global_index(n) < self.nbands_converge:
+                        weight = kpt.weight
+                    else:
+                        weight = 0.0
+                error += weight * np.vdot(R_nG[n], R_nG[n]).real
+
+                psit_2nG[mynbands + n] = self.preconditioner(R_nG[n], kpt)
+            psit_2nG[:mynbands] = kpt.psit_nG
+
+            # Projections of the preconditioned residuals:
+            P2_ani = wfs.pt.dict(mynbands)
+            wfs.pt.integrate(psit_2nG[mynbands:], P2_ani, kpt.q)
+            P_2ani = {}
+            for a, P_ni in kpt.P_ani.items():
+                P_2ani[a] = np.vstack((P_ni, P2_ani[a]))
+
+            # Hamiltonian and overlap matrices of the expansion space:
+            Htpsit_xG = self.operator2.suggest_temporary_buffer()
+
+            def H(psit_xG, offset=0):
+                out_xG = Htpsit_xG[offset:offset + len(psit_xG)]
+                wfs.apply_pseudo_hamiltonian(kpt, hamiltonian, psit_xG,
+                                             out_xG)
+                return Htpsit_xG
+            H.blocked = True
+
+            def dH(a, P_ni):
+                return np.dot(P_ni, unpack(hamiltonian.dH_asp[a][kpt.s]))
+
+            def S(psit_xG):
+                return psit_xG
+
+            def dS(a, P_ni):
+                return np.dot(P_ni, wfs.setups[a].dO_ii)
+
+            H_2n2n[:] = self.operator2.calculate_matrix_elements(
+                psit_2nG, P_2ani, H, dH)
+            S_2n2n[:] = self.operator2.calculate_matrix_elements(
+                psit_2nG, P_2ani, S, dS)
+
+            if self.gd.comm.rank == 0 and self.band_comm.rank == 0:
+                tol = extra_parameters.get('mixed_precision_subspace')
+                if tol and self.error > tol:
+                    general_diagonalize_mixed(H_2n2n, eps_2n, S_2n2n)
+                else:
+                    general_diagonalize(H_2n2n, eps_2n, S_2n2n)
+
+            self.ksl2.blockcomm.broadcast(H_2n2n, 0)
+            self.ksl2.blockcomm.broadcast(eps_2n, 0)
+
+            kpt.eps_n[:] = eps_2n[:nbands][bd.get_slice()]
+
+            # Rotate the lowest nbands states back onto the band groups.
+            # Band group r keeps states r * mynbands, ..., so its slots
+            # for the old wave functions receive those eigenvector rows
+            # and its residual slots are zeroed out:
+            C_2n2n = S_2n2n
+            C_2n2n[:] = 0.0
+            for r in range(B):
+                C_2n2n[2 * r * mynbands:(2 * r + 1) * mynbands] = \
+                    H_2n2n[r * mynbands:(r + 1) * mynbands]
+            self.operator2.matrix_multiply(C_2n2n, psit_2nG, P_2ani)
+            kpt.psit_nG[:] = psit_2nG[:mynbands]
+            for a, P_ni in kpt.P_ani.items():
+                P_ni[:] = P_2ani[a][:mynbands]
+
+            if nit < niter - 1:
+                wfs.kin.apply(kpt.psit_nG, self.Ht_nG, kpt.phase_cd)
+                hamiltonian.apply_local_potential(kpt.psit_nG, self.Ht_nG,
+                                                  kpt.s)
+                R_nG[:] = self.Ht_nG
+                self.calculate_residuals(kpt, wfs, hamiltonian, kpt.psit_nG,
+                                         kpt.P_ani, kpt.eps_n, R_nG)
+
+        self.timer.stop('Davidson')
+        error = self.gd.comm.sum(error)
+        return error
+
 
 
 
@@ -1,6 +1,7 @@
 """Module defining and eigensolver base-class."""
 
 from math import ceil
+from time import time
 
 import numpy as np
 
@@ -8,6 +9,7 @@ from gpaw.fd_operators import Laplace
 from gpaw.utilities.blas import axpy, r2k, gemm
 from gpaw.utilities.tools import apply_subspace_mask
 from gpaw.utilities import unpack
+from gpaw.utilities.regions import region_begin, region_end
 
 
 class Eigensolver:
@@ -16,6 +18,7 @@ class Eigensolver:
         self.initialized = False
         self.Htpsit_nG = None
         self.error = np.inf
+        self.tolerance = None
         self.blocksize = blocksize
         
     def initialize(self, wfs):
@@ -64,11 +67,20 @@ class Eigensolver:
         if not wfs.orthonormalized:
             wfs.orthonormalize()
             
+        region = 'eigensolver/' + self.__class__.__name__
+        region_begin(region)
         error = 0.0
-        for kpt in wfs.kpt_u:
+        for myu, kpt in enumerate(wfs.kpt_u):
+            t0 = time()
             error += self.iterate_one_k_point(hamiltonian, wfs, kpt)
+            # Feed the cost model used to rebalance the k-point
+            # distribution at a restart:
+            wfs.kd.register_time(myu, time() - t0)
+        region_end(region)
 
+        region_begin('eigensolver/orthonormalize')
         wfs.orthonormalize()
+        region_end('eigensolver/orthonormalize')
 
         self.error = self.band_comm.sum(self.kpt_comm.sum(error))
 
@@ -77,13 +89,17 @@ class Eigensolver:
         raise NotImplementedError
 
     def calculate_residuals(self, kpt, wfs, hamiltonian, psit_xG, P_axi, eps_x,
-                            R_xG, n_x=None, calculate_change=False):
+                            R_xG, n_x=None, calculate_change=False,
+                            eps_subtracted=False):
         """Calculate residual.
 
-        From R=Ht*psit calculate R=H*psit-eps*S*psit."""
-        
-        for R_G, eps, psit_G in zip(R_xG, eps_x, psit_xG):
-            axpy(-eps, psit_G, R_G)
+        From R=Ht*psit calculate R=H*psit-eps*S*psit.  With
+        eps_subtracted=True, R already holds Ht*psit-eps*psit (from a
+        fused apply) and only the atomic corrections are added."""
+
+        if not eps_subtracted:
+            for R_G, eps, psit_G in zip(R_xG, eps_x, psit_xG):
+                axpy(-eps, psit_G, R_G)
 
         c_axi = {}
         for a, P_xi in P_axi.items():
@@ -117,6 +133,7 @@ class Eigensolver:
             raise NotImplementedError
 
         self.timer.start('Subspace diag')
+        region_begin('eigensolver/subspace-diag')
 
         psit_nG = kpt.psit_nG
         P_ani = kpt.P_ani
@@ -126,13 +143,19 @@ class Eigensolver:
         else:
             Htpsit_xG = self.operator.suggest_temporary_buffer()
 
-        def H(psit_xG):
-            wfs.apply_pseudo_hamiltonian(kpt, hamiltonian, psit_xG,
-                                         Htpsit_xG[:len(psit_xG)])
+        def H(psit_xG, offset=0):
+            out_xG = Htpsit_xG[offset:offset + len(psit_xG)]
+            wfs.apply_pseudo_hamiltonian(kpt, hamiltonian, psit_xG, out_xG)
             hamiltonian.xc.apply_orbital_dependent_hamiltonian(
-                kpt, psit_xG, Htpsit_xG, hamiltonian.dH_asp)
+                kpt, psit_xG, out_xG, hamiltonian.dH_asp)
             return Htpsit_xG
 
+        # The offset argument lets the band-group ring apply the
+        # Hamiltonian chunk by chunk with the transfers of finished
+        # chunks in flight (see hs_operators.py).  Orbital-dependent
+        # functionals see the band set as a whole, so no chunking then:
+        H.blocked = not hamiltonian.xc.orbital_dependent
+
         def dH(a, P_ni):
             return np.dot(P_ni, unpack(hamiltonian.dH_asp[a][kpt.s]))
 
@@ -149,6 +172,7 @@ class Eigensolver:
         wfs.timer.stop(diagonalization_string)
 
         if not rotate:
+            region_end('eigensolver/subspace-diag')
             self.timer.stop('Subspace diag')
             return
 
@@ -162,6 +186,7 @@ class Eigensolver:
 
         self.timer.stop('rotate_psi')
 
+        region_end('eigensolver/subspace-diag')
         self.timer.stop('Subspace diag')
 
     def estimate_memory(self, mem, gd, dtype, mynbands, nbands):
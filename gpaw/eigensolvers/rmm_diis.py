@@ -2,7 +2,7 @@
 
 import numpy as np
 
-from gpaw.utilities.blas import axpy
+from gpaw.utilities.blas import multi_axpy, multi_dotc
 from gpaw.eigensolvers.eigensolver import Eigensolver
 from gpaw.utilities import unpack
 from gpaw.mpi import run
@@ -20,10 +20,23 @@ class RMM_DIIS(Eigensolver):
     * Subspace diagonalization
     * Calculation of residuals
     * Improvement of wave functions:  psi' = psi + lambda PR + lambda PR'
-    * Orthonormalization"""
+    * Orthonormalization
 
-    def __init__(self, keep_htpsit=True, blocksize=1):
+    Bands whose residual norms have dropped ``dropout`` times below the
+    eigenstates convergence criterion (per band) skip the expensive
+    precondition/apply/step path - they are still carried along in the
+    subspace diagonalization and the orthonormalization.  The skip list
+    is rebuilt from actual residuals every ``recheck`` iterations."""
+
+    def __init__(self, keep_htpsit=True, blocksize=10, dropout=0.01,
+                 recheck=5):
         Eigensolver.__init__(self, keep_htpsit, blocksize)
+        self.dropout = dropout
+        self.recheck = recheck
+        # Per k-point dropout state (keyed by (s, k)):
+        self.step_k = {}
+        self.converged_k = {}
+        self.error_k = {}
 
     def iterate_one_k_point(self, hamiltonian, wfs, kpt):
         """Do a single RMM-DIIS iteration for the kpoint"""
@@ -31,46 +44,89 @@ class RMM_DIIS(Eigensolver):
         self.subspace_diagonalize(hamiltonian, wfs, kpt)
 
         self.timer.start('RMM-DIIS')
+        mynbands = wfs.bd.mynbands
+
         if self.keep_htpsit:
             R_nG = self.Htpsit_nG
             self.calculate_residuals(kpt, wfs, hamiltonian, kpt.psit_nG,
                                      kpt.P_ani, kpt.eps_n, R_nG)
 
-        B = self.blocksize
-        dR_xG = self.gd.empty(B, wfs.dtype)
-        P_axi = wfs.pt.dict(B)
-        error = 0.0
-        for n1 in range(0, wfs.bd.mynbands, B):
-            n2 = n1 + B
-            if n2 > wfs.bd.mynbands:
-                n2 = wfs.bd.mynbands
-                B = n2 - n1
-                P_axi = dict([(a, P_xi[:B]) for a, P_xi in P_axi.items()])
-                dR_xG = dR_xG[:B]
-                
-            n_x = range(n1, n2)
-            
+        weight_n = np.empty(mynbands)
+        for n in range(mynbands):
+            if kpt.f_n is None:
+                weight = kpt.weight
+            else:
+                weight = kpt.f_n[n]
+            if self.nbands_converge != 'occupied':
+                if wfs.bd.global_index(n) < self.nbands_converge:
+                    weight = kpt.weight
+                else:
+                    weight = 0.0
+            weight_n[n] = weight
+
+        dropout = self.dropout
+        if self.tolerance is None:
+            dropout = None
+        else:
+            threshold = dropout * self.tolerance / self.nbands
+        key = (kpt.s, kpt.k)
+        step = self.step_k.get(key, 0)
+        self.step_k[key] = step + 1
+        if (key not in self.converged_k or dropout is None or
+            step % self.recheck == 0):
+            self.converged_k[key] = np.zeros(mynbands, bool)
+            self.error_k[key] = np.zeros(mynbands)
+        converged_n = self.converged_k[key]
+        # Per-band error contributions (summed over domains already):
+        errband_n = self.error_k[key]
+
+        if self.keep_htpsit:
+            # Residuals for all bands are at hand, so the skip list can
+            # be refreshed for free:
+            RR_n = np.empty(mynbands, wfs.dtype)
+            multi_dotc(R_nG, R_nG, RR_n)
+            RR_n = np.ascontiguousarray(RR_n.real)
+            self.gd.comm.sum(RR_n)
+            errband_n[:] = weight_n * RR_n
+            if dropout is not None:
+                # Unoccupied bands get the full k-point weight here -
+                # they still have to be good enough for the subspace:
+                converged_n |= kpt.weight * RR_n < threshold
+
+        B0 = self.blocksize
+        dR0_xG = self.gd.empty(B0, wfs.dtype)
+        P0_axi = wfs.pt.dict(B0)
+        for n1 in range(0, mynbands, B0):
+            n2 = min(n1 + B0, mynbands)
+            n_x = [n for n in range(n1, n2) if not converged_n[n]]
+            B = len(n_x)
+            if B == 0:
+                continue
+            if B < B0:
+                P_axi = dict([(a, P_xi[:B]) for a, P_xi in P0_axi.items()])
+                dR_xG = dR0_xG[:B]
+            else:
+                P_axi = P0_axi
+                dR_xG = dR0_xG
+
             if self.keep_htpsit:
                 R_xG = R_nG[n_x]
             else:
                 R_xG = self.gd.empty(B, wfs.dtype)
                 psit_xG = kpt.psit_nG[n_x]
-                wfs.apply_pseudo_hamiltonian(kpt, hamiltonian, psit_xG, R_xG)
+                wfs.apply_pseudo_hamiltonian_and_subtract(
+                    kpt, hamiltonian, psit_xG, kpt.eps_n[n_x], R_xG)
                 wfs.pt.integrate(psit_xG, P_axi, kpt.q)
                 self.calculate_residuals(kpt, wfs, hamiltonian, psit_xG,
-                                         P_axi, kpt.eps_n[n_x], R_xG, n_x)
-
-            for n in n_x:
-                if kpt.f_n is None:
-                    weight = kpt.weight
-                else:
-                    weight = kpt.f_n[n]
-                if self.nbands_converge != 'occupied':
-                    if wfs.bd.global_index(n) < self.nbands_converge:
-                        weight = kpt.weight
-                    else:
-                        weight = 0.0
-                error += weight * np.vdot(R_xG[n - n1], R_xG[n - n1]).real
+                                         P_axi, kpt.eps_n[n_x], R_xG, n_x,
+                                         eps_subtracted=True)
+                RR_x = np.empty(B, wfs.dtype)
+                multi_dotc(R_xG, R_xG, RR_x)
+                RR_x = np.ascontiguousarray(RR_x.real)
+                self.gd.comm.sum(RR_x)
+                errband_n[n_x] = weight_n[n_x] * RR_x
+                if dropout is not None:
+                    converged_n[n_x] |= kpt.weight * RR_x < threshold
 
             # Precondition the residual:
             self.timer.start('precondition')
@@ -78,30 +134,33 @@ class RMM_DIIS(Eigensolver):
             self.timer.stop('precondition')
 
             # Calculate the residual of dpsit_G, dR_G = (H - e S) dpsit_G:
-            wfs.apply_pseudo_hamiltonian(kpt, hamiltonian, dpsit_xG, dR_xG)
+            wfs.apply_pseudo_hamiltonian_and_subtract(
+                kpt, hamiltonian, dpsit_xG, kpt.eps_n[n_x], dR_xG)
             wfs.pt.integrate(dpsit_xG, P_axi, kpt.q)
             self.calculate_residuals(kpt, wfs, hamiltonian, dpsit_xG,
                                      P_axi, kpt.eps_n[n_x], dR_xG, n_x,
-                                     calculate_change=True)
+                                     calculate_change=True,
+                                     eps_subtracted=True)
             
             # Find lam that minimizes the norm of R'_G = R_G + lam dR_G
-            RdR_x = np.array([np.vdot(dR_G, R_G).real
-                              for R_G, dR_G in zip(R_xG, dR_xG)])
-            dRdR_x = np.array([np.vdot(dR_G, dR_G).real for dR_G in dR_xG])
+            dRR_x = np.empty(B, wfs.dtype)
+            dRdR_x = np.empty(B, wfs.dtype)
+            multi_dotc(dR_xG, R_xG, dRR_x)
+            multi_dotc(dR_xG, dR_xG, dRdR_x)
+            RdR_x = np.ascontiguousarray(dRR_x.real)
+            dRdR_x = np.ascontiguousarray(dRdR_x.real)
             self.gd.comm.sum(RdR_x)
             self.gd.comm.sum(dRdR_x)
 
             lam_x = -RdR_x / dRdR_x
             # Calculate new psi'_G = psi_G + lam pR_G + lam pR'_G
             #                      = psi_G + p(2 lam R_G + lam**2 dR_G)
-            for lam, R_G, dR_G in zip(lam_x, R_xG, dR_xG):
-                R_G *= 2.0 * lam
-                axpy(lam**2, dR_G, R_G)  # R_G += lam**2 * dR_G
-                
+            R_xG *= (2.0 * lam_x)[:, np.newaxis, np.newaxis, np.newaxis]
+            multi_axpy(lam_x**2, dR_xG, R_xG)  # R_xG += lam_x**2 * dR_xG
+
             self.timer.start('precondition')
-            kpt.psit_nG[n1:n2] += self.preconditioner(R_xG, kpt)
+            kpt.psit_nG[n_x] += self.preconditioner(R_xG, kpt)
             self.timer.stop('precondition')
-            
+
         self.timer.stop('RMM-DIIS')
-        error = self.gd.comm.sum(error)
-        return error
+        return errband_n.sum()
@@ -96,7 +96,7 @@ class ELF:
                                             self.nt_grad2_sg[s])
 
     def update(self, wfs):
-        ddr_v = [Gradient(self.gd, v).apply for v in range(3)]
+        ddr_v = [Gradient(self.gd, v) for v in range(3)]
         assert self.nspins == 1
         self.taut_sG[:] = wfs.calculate_kinetic_energy_density(
             self.taut_sG[:1], ddr_v)
@@ -114,7 +114,7 @@ class ELF:
 
         for s in range(self.nspins):
             for v in range(3):
-                ddr_v[v](self.density.nt_sG[s], d_G)
+                ddr_v[v].apply(self.density.nt_sG[s], d_G)
                 self.nt_grad2_sG[s] += d_G**2.0
 
         #TODO are nct from setups usable for nt_grad2_sG ?
@@ -19,9 +19,12 @@ import _gpaw
 
 class FDOperator:
     def __init__(self, coef_p, offset_pc, gd, dtype=float,
-                 allocate=True):
+                 allocate=True, async=None):
         """FDOperator(coefs, offsets, gd, dtype) -> FDOperator object.
-        """
+
+        async: overlap halo communication of one chunk of bands with
+        stencil computation on the previous chunk (parallel central
+        stencils only).  None means use the compile-time default."""
 
         # Is this a central finite-difference type of stencil?
         cfd = True
@@ -57,6 +60,8 @@ class FDOperator:
         self.args = [coef_p, offset_p, n_c, mp,
                      neighbor_cd, dtype == float,
                      comm, cfd]
+        if async is not None:
+            self.args.append(int(async))
         self.mp = mp # padding
         self.gd = gd
         self.npoints = len(coef_p)
@@ -80,8 +85,21 @@ class FDOperator:
     def apply(self, in_xg, out_xg, phase_cd=None):
         self.operator.apply(in_xg, out_xg, phase_cd)
 
+    def apply_and_subtract(self, in_xg, out_xg, eps_x, phase_cd=None):
+        """Apply stencil and subtract eps_x * in_xg in a single pass.
+
+        The eigenvalues are folded into the central stencil coefficient,
+        so no intermediate full-grid array is needed."""
+        self.operator.apply_and_subtract(in_xg, out_xg,
+                                         np.ascontiguousarray(eps_x, float),
+                                         phase_cd)
+
     def relax(self, relax_method, f_g, s_g, n, w=None):
-        self.operator.relax(relax_method, f_g, s_g, n, w)
+        """Relax f_g towards the solution of ``operator f_g = s_g``.
+
+        Returns the local squared residual norm seen during the final
+        sweep (sum over this domain; not volume-scaled)."""
+        return self.operator.relax(relax_method, f_g, s_g, n, w)
 
     def get_diagonal_element(self):
         return self.operator.get_diagonal_element()
@@ -89,6 +107,10 @@ class FDOperator:
     def get_async_sizes(self):
         return self.operator.get_async_sizes()
 
+    def get_kernel_info(self):
+        """Return (separable range, i1 tile, i2 tile) of the C kernel."""
+        return self.operator.get_kernel_info()
+
     def estimate_memory(self, mem):
         bufsize_c = np.array(self.gd.n_c) + 2 * self.mp
         itemsize = mem.itemsize[self.dtype]
@@ -111,14 +133,14 @@ if debug:
             _FDOperator.apply(self, in_xg, out_xg, phase_cd)
 
         def relax(self, relax_method, f_g, s_g, n, w=None):
-            assert f_g.shape == self.shape
-            assert s_g.shape == self.shape
+            assert f_g.shape == s_g.shape
+            assert f_g.shape[-3:] == self.shape
             assert f_g.flags.contiguous
             assert f_g.dtype == float
             assert s_g.flags.contiguous
             assert s_g.dtype == float
             assert self.dtype == float
-            _FDOperator.relax(self, relax_method, f_g, s_g, n, w)
+            return _FDOperator.relax(self, relax_method, f_g, s_g, n, w)
 
 class Gradient(FDOperator):
     def __init__(self, gd, v, scale=1.0, n=1, dtype=float, allocate=True):
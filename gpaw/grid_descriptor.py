@@ -330,8 +330,7 @@ class GridDescriptor(Domain):
         A_g = self.collect(a_g)
         if self.comm.rank == 0:
             B_g = np.zeros_like(A_g)
-            for op_cc in op_scc:
-                _gpaw.symmetrize(A_g, B_g, op_cc)
+            _gpaw.symmetrize_all(A_g, B_g, np.ascontiguousarray(op_scc))
         else:
             B_g = None
         self.distribute(B_g, a_g)
@@ -416,6 +415,94 @@ class GridDescriptor(Domain):
             for request, a_xg in requests:
                 self.comm.wait(request)
         
+    def redistribute(self, gd2, a_xg, b_xg=None):
+        """Redistribute array from this decomposition to that of gd2.
+
+        a_xg is laid out according to this descriptor and the returned
+        array (b_xg, allocated here if not given) according to gd2.
+        Both descriptors must describe the same global grid, with the
+        same number of ranks.  Every rank exchanges just the overlaps
+        of its own blocks with the blocks of the other layout, using
+        non-blocking sends and receives - the array never passes
+        through a full gather on one rank like collect/distribute."""
+
+        assert (gd2.N_c == self.N_c).all()
+        assert (gd2.pbc_c == self.pbc_c).all()
+        assert gd2.comm.size == self.comm.size
+
+        xshape = a_xg.shape[:-3]
+        if b_xg is None:
+            b_xg = gd2.empty(xshape, a_xg.dtype)
+
+        if self.comm.size == 1:
+            b_xg[:] = a_xg
+            return b_xg
+
+        def overlap(gda, gdb, rank):
+            # Global overlap of our block in gda with rank's block in gdb:
+            parpos_c = gdb.get_processor_position_from_rank(rank)
+            beg_c = np.array([gdb.n_cp[c][parpos_c[c]] for c in range(3)])
+            end_c = np.array([gdb.n_cp[c][parpos_c[c] + 1] for c in range(3)])
+            return np.maximum(beg_c, gda.beg_c), np.minimum(end_c, gda.end_c)
+
+        # Post all receives into the new layout first:
+        requests = []
+        rblocks = []
+        for rank in range(self.comm.size):
+            beg_c, end_c = overlap(gd2, self, rank)
+            if (end_c > beg_c).all() and rank != self.comm.rank:
+                block_xg = np.empty(xshape + tuple(end_c - beg_c),
+                                    a_xg.dtype)
+                requests.append(self.comm.receive(block_xg, rank, 131,
+                                                  False))
+                rblocks.append((beg_c - gd2.beg_c, end_c - gd2.beg_c,
+                                block_xg))
+
+        # ... then send our old blocks where they belong:
+        sendbufs = []
+        for rank in range(self.comm.size):
+            beg_c, end_c = overlap(self, gd2, rank)
+            if (end_c > beg_c).all():
+                b_c = beg_c - self.beg_c
+                e_c = end_c - self.beg_c
+                block_xg = np.ascontiguousarray(
+                    a_xg[..., b_c[0]:e_c[0], b_c[1]:e_c[1], b_c[2]:e_c[2]])
+                if rank == self.comm.rank:
+                    b_c = beg_c - gd2.beg_c
+                    e_c = end_c - gd2.beg_c
+                    b_xg[..., b_c[0]:e_c[0],
+                         b_c[1]:e_c[1], b_c[2]:e_c[2]] = block_xg
+                else:
+                    requests.append(self.comm.send(block_xg, rank, 131,
+                                                   False))
+                    # Keep the send buffer alive until waitall:
+                    sendbufs.append(block_xg)
+
+        self.comm.waitall(requests)
+        for b_c, e_c, block_xg in rblocks:
+            b_xg[..., b_c[0]:e_c[0], b_c[1]:e_c[1], b_c[2]:e_c[2]] = block_xg
+        return b_xg
+
+    def sub_box(self, a_xg, beg_c, end_c):
+        """Zero-copy view of the part of a_xg inside a global box.
+
+        beg_c and end_c are global grid indices; the view covers the
+        intersection of the box with this domain and can be empty.
+        Basic slicing only, so no data is copied - writing through the
+        view modifies a_xg."""
+        b_c = np.clip(beg_c - self.beg_c, 0, self.n_c)
+        e_c = np.clip(end_c - self.beg_c, 0, self.n_c)
+        return a_xg[..., b_c[0]:e_c[0], b_c[1]:e_c[1], b_c[2]:e_c[2]]
+
+    def plane(self, a_xg, c, g):
+        """Zero-copy view of the grid plane with global index g along axis c.
+
+        Returns None when the plane does not intersect this domain."""
+        g -= self.beg_c[c]
+        if g < 0 or g >= self.n_c[c]:
+            return None
+        return a_xg[(Ellipsis,) + (slice(None),) * c + (g,)]
+
     def zero_pad(self, a_xg):
         """Pad array with zeros as first element along non-periodic directions.
 
@@ -274,8 +274,11 @@ class Hamiltonian:
             setup = self.setups[a]
 
             D_p = D_sp.sum(0)
-            dH_p = (setup.K_p + setup.M_p +
-                    setup.MB_p + 2.0 * np.dot(setup.M_pp, D_p) +
+            if not hasattr(setup, 'dH0_p'):
+                # Setup-like objects (ghosts, pseudopotentials) that
+                # don't precalculate the constant part:
+                setup.dH0_p = setup.K_p + setup.M_p + setup.MB_p
+            dH_p = (setup.dH0_p + 2.0 * np.dot(setup.M_pp, D_p) +
                     np.dot(setup.Delta_pL, W_L))
             Ekin += np.dot(setup.K_p, D_p) + setup.Kc
             Ebar += setup.MB + np.dot(setup.MB_p, D_p)
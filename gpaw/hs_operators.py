@@ -26,6 +26,10 @@ class MatrixOperator:
     async = True
     hermitian = True
 
+    # Number of band chunks the pipelined first ring cycle splits the
+    # operator application into (see _start_pipelined_cycle):
+    pipeline_chunks = 4
+
     def __init__(self, ksl, nblocks=None, async=None, hermitian=None):
         """The constructor now calculates the work array sizes, but does not
         allocate them. Here is a summary of the relevant variables and the
@@ -85,9 +89,14 @@ class MatrixOperator:
         # default for work spaces
         self.work1_xG = None
         self.work2_xG = None
+        self.work3_xG = None
         self.A_qnn = None
         self.A_nn = None
 
+        # Send requests still in flight in the band-group ring (see
+        # _initialize_cycle).
+        self.sreqs = []
+
         mynbands = self.bd.mynbands
         ngroups = self.bd.comm.size
         G = self.gd.n_c.prod()
@@ -139,6 +148,10 @@ class MatrixOperator:
             self.work1_xG = self.gd.zeros(self.X, dtype)
             self.work2_xG = self.gd.zeros(self.X, dtype)
             if ngroups > 1:
+                # Third block buffer for the band-group ring: allows a
+                # block to be received while the previously sent block
+                # is still in flight (see _initialize_cycle).
+                self.work3_xG = self.gd.zeros(self.X, dtype)
                 self.A_qnn = np.zeros((self.Q, mynbands, mynbands), dtype)
         self.A_nn = self.bmd.zeros(dtype=dtype)
 
@@ -156,6 +169,8 @@ class MatrixOperator:
         else:
             mem.subnode('work1_xG', self.X * gdbytes)
             mem.subnode('work2_xG', self.X * gdbytes)
+            if ngroups > 1:
+                mem.subnode('work3_xG', self.X * gdbytes)
             mem.subnode('A_qnn', count * mem.itemsize[dtype])
 
         self.bmd.estimate_memory(mem.subnode('Band Matrices'), dtype)
@@ -229,8 +244,14 @@ class MatrixOperator:
         self.req, self.req2 = [], []
 
         # If asyncronous, non-blocking send/receives of psit_nG's start here.
+        # Sends are left in flight across cycles (the buffers rotate
+        # through three slots, so a buffer is not reused for receiving
+        # until two cycles after it was sent) - only the send posted
+        # two cycles ago must be complete before its buffer is reused:
         if self.async:
-            self.req.append(band_comm.send(sbuf_mG, rankm, 11, False))
+            if len(self.sreqs) == 2:
+                band_comm.waitall(self.sreqs.pop(0))
+            self.sreqs.append([band_comm.send(sbuf_mG, rankm, 11, False)])
             self.req.append(band_comm.receive(rbuf_mG, rankp, 11, False))
 
         # Auxiliary asyncronous cycle, also send/receive of P_ani's.
@@ -238,13 +259,14 @@ class MatrixOperator:
             self.req2.append(band_comm.send(sbuf_In, rankm, 31, False))
             self.req2.append(band_comm.receive(rbuf_In, rankp, 31, False))
 
-    def _finish_cycle(self, sbuf_mG, rbuf_mG, sbuf_In, rbuf_In, auxiliary):
+    def _finish_cycle(self, sbuf_mG, rbuf_mG, spare_mG, sbuf_In, rbuf_In,
+                      auxiliary):
         """Completes a send/receive cycle of pseudo wave functions, as well as
         an optional auxiliary send/receive cycle of corresponding projections.
         Low-level helper function. Results in the following communications::
 
                         Rank below            This rank            Rank above
-          Asynchronous: ... w/w  <-- sbuf_mG --  w/w  <-- rbuf_mG --  w/w ...
+          Asynchronous: ...  w   <-- sbuf_mG --   w   <-- rbuf_mG --   w  ...
           Synchronous:  ... O/I  <-- sbuf_mG --  O/I  <-- rbuf_mG --  O/I ...
 
           Auxiliary:    ... w/w  <-- sbuf_In --  w/w  <-- rbuf_In --  w/w ...
@@ -252,17 +274,27 @@ class MatrixOperator:
         A letter 'w' signifies wait for initialized non-blocking communication.
         The letter 'O' signifies a blocking send and 'I' a matching receive.
 
+        Only the receive is waited for here; the send stays in flight
+        while the next block is processed and is completed by a later
+        call to _initialize_cycle (or _drain_cycle).  The three
+        buffers rotate so that the just-sent buffer is not reused for
+        receiving until two cycles later.
 
         Parameters:
 
-        Same as _initialize_cycle.
+        Same as _initialize_cycle, plus:
+
+        spare_mG: ndarray
+            Idle buffer, receive target of the next cycle.
 
         Returns:
 
         sbuf_mG: ndarray
             New send buffer with the received set of pseudo wave functions.
         rbuf_mG: ndarray
-            New receive buffer (has the sent set of pseudo wave functions).
+            New receive buffer (the previously idle buffer).
+        spare_mG: ndarray
+            New idle buffer (has the sent set of pseudo wave functions).
         sbuf_In: ndarray, same as input if not auxiliary
             New send buffer with the received set of atomic projector overlaps.
         rbuf_In: ndarray, same as input if not auxiliary
@@ -275,12 +307,12 @@ class MatrixOperator:
 
         # If syncronous, blocking send/receives of psit_nG's carried out here.
         if self.async:
-            assert len(self.req) == 2, 'Expected asynchronous request pairs.'
+            assert self.req, 'Expected asynchronous receive request(s).'
             band_comm.waitall(self.req)
         else:
             assert len(self.req) == 0, 'Got unexpected asynchronous requests.'
             band_comm.sendreceive(sbuf_mG, rankm, rbuf_mG, rankp, 11, 11)
-        sbuf_mG, rbuf_mG = rbuf_mG, sbuf_mG
+        sbuf_mG, rbuf_mG, spare_mG = rbuf_mG, spare_mG, sbuf_mG
 
         # Auxiliary asyncronous cycle, also wait for P_ani's.
         if auxiliary:
@@ -288,7 +320,55 @@ class MatrixOperator:
             band_comm.waitall(self.req2)
             sbuf_In, rbuf_In = rbuf_In, sbuf_In
 
-        return sbuf_mG, rbuf_mG, sbuf_In, rbuf_In
+        return sbuf_mG, rbuf_mG, spare_mG, sbuf_In, rbuf_In
+
+    def _drain_cycle(self):
+        """Complete any sends still in flight in the band-group ring.
+
+        Must be called before the rotating buffers are reused outside
+        the ring, i.e. at the end of each block slice."""
+        while self.sreqs:
+            self.bd.comm.waitall(self.sreqs.pop(0))
+
+    def _start_pipelined_cycle(self, A, psit_mG, rbuf_mG):
+        """Apply A to a band slice in chunks, overlapping the transfers.
+
+        The first cycle of the band-group ring normally waits for the
+        operator to be applied to the whole slice before any data can
+        move.  Here the slice is applied chunk by chunk and the
+        nonblocking send of each chunk is posted as soon as it has
+        been computed, with the matching chunked receives posted up
+        front, so the stencil work of the later chunks hides the
+        transfer of the earlier ones.  Requires an A that takes a band
+        offset (A.blocked, see calculate_matrix_elements).  Returns
+        the operator output buffer; the chunk receive requests are
+        left in self.req for _finish_cycle."""
+
+        band_comm = self.bd.comm
+        rankm = (band_comm.rank - 1) % band_comm.size
+        rankp = (band_comm.rank + 1) % band_comm.size
+        M = len(psit_mG)
+        nchunks = min(self.pipeline_chunks, M)
+
+        if len(self.sreqs) == 2:
+            band_comm.waitall(self.sreqs.pop(0))
+
+        self.req = []
+        for c in range(nchunks):
+            m1 = M * c // nchunks
+            m2 = M * (c + 1) // nchunks
+            self.req.append(band_comm.receive(rbuf_mG[m1:m2], rankp,
+                                              41 + c, False))
+        creqs = []
+        temp_mG = None
+        for c in range(nchunks):
+            m1 = M * c // nchunks
+            m2 = M * (c + 1) // nchunks
+            temp_mG = A(psit_mG[m1:m2], m1)
+            creqs.append(band_comm.send(temp_mG[m1:m2], rankm,
+                                        41 + c, False))
+        self.sreqs.append(creqs)
+        return temp_mG
 
     def suggest_temporary_buffer(self):
         """Return a *suggested* buffer for calculating A(psit_nG) during
@@ -343,6 +423,13 @@ class MatrixOperator:
             index a and P_ni and return an ndarray with the same shape
             as P_ni, thus representing P_ni multiplied by dA_ii.
 
+        If A has a true ``blocked`` attribute, it must also accept a
+        band offset as second argument and write the result of each
+        call at that offset of one output buffer, returning the
+        buffer.  The band-group ring then applies the operator chunk
+        by chunk, overlapping the stencil work with the transfer of
+        the chunks already processed (see _start_pipelined_cycle).
+
         """
         band_comm = self.bd.comm
         domain_comm = self.gd.comm
@@ -394,6 +481,13 @@ class MatrixOperator:
         if J*M == N + M: # remove extra slice
             J -= 1
 
+        # Pipelined first cycle: apply A chunk by chunk with the
+        # chunk transfers in flight (all ranks agree, since A is the
+        # same function everywhere):
+        pipeline = self.async and B > 1 and getattr(A, 'blocked', False)
+        rankm = (band_comm.rank - 1) % B
+        rankp = (band_comm.rank + 1) % B
+
         for j in range(J):
             n1 = j * M
             n2 = n1 + M
@@ -401,9 +495,15 @@ class MatrixOperator:
                 n2 = N
                 M = n2 - n1
             psit_mG = psit_nG[n1:n2]
-            temp_mG = A(psit_mG) 
-            sbuf_mG = temp_mG[:M] # necessary only for last slice
             rbuf_mG = self.work2_xG[:M]
+            if pipeline:
+                temp_mG = self._start_pipelined_cycle(A, psit_mG, rbuf_mG)
+            else:
+                temp_mG = A(psit_mG)
+            sbuf_mG = temp_mG[:M] # necessary only for last slice
+            spare_mG = None
+            if B > 1:
+                spare_mG = self.work3_xG[:M]
             cycle_P_ani = (j == J - 1 and P_ani)
 
             for q in range(Q):
@@ -414,8 +514,20 @@ class MatrixOperator:
                 # and receiving next set of kets from rank above us.
                 # If we're at the last slice, start cycling P_ani too.
                 if q < Q - 1:
-                    self._initialize_cycle(sbuf_mG, rbuf_mG,
-                                           sbuf_In, rbuf_In, cycle_P_ani)
+                    if pipeline and q == 0:
+                        # The chunked transfers are already in flight
+                        # (_start_pipelined_cycle); only the auxiliary
+                        # P_ani cycle remains to be started.
+                        self.req2 = []
+                        if cycle_P_ani:
+                            self.req2.append(band_comm.send(
+                                sbuf_In, rankm, 31, False))
+                            self.req2.append(band_comm.receive(
+                                rbuf_In, rankp, 31, False))
+                    else:
+                        self._initialize_cycle(sbuf_mG, rbuf_mG,
+                                               sbuf_In, rbuf_In,
+                                               cycle_P_ani)
 
                 # Calculate pseudo-braket contributions for the current slice
                 # of bands in the current mynbands x mynbands matrix block.
@@ -438,16 +550,25 @@ class MatrixOperator:
                              1.0, A_nn, 'c')
                         I1 = I2
 
-                # Wait for all send/receives to finish before next iteration.
-                # Swap send and receive buffer such that next becomes current.
-                # If we're at the last slice, also finishes the P_ani cycle.
+                # Wait for the receive to finish before next iteration;
+                # the send stays in flight while the next block is
+                # processed.  Rotate the buffers so the received set
+                # becomes current.  If we're at the last slice, also
+                # finishes the P_ani cycle.
                 if q < Q - 1:
-                    sbuf_mG, rbuf_mG, sbuf_In, rbuf_In = self._finish_cycle(
-                        sbuf_mG, rbuf_mG, sbuf_In, rbuf_In, cycle_P_ani)
+                    (sbuf_mG, rbuf_mG, spare_mG, sbuf_In,
+                     rbuf_In) = self._finish_cycle(
+                        sbuf_mG, rbuf_mG, spare_mG, sbuf_In, rbuf_In,
+                        cycle_P_ani)
 
-                # First iteration was special because we had the ket to ourself
+                # First iteration was special because we had the ket to
+                # ourself; take the operator's buffer out of the rotation:
                 if q == 0:
-                    rbuf_mG = self.work1_xG[:M]
+                    spare_mG = self.work1_xG[:M]
+
+            # Complete outstanding sends before the buffers are reused
+            # for the next slice:
+            self._drain_cycle()
 
         domain_comm.sum(A_qnn, 0)
 
@@ -543,6 +664,9 @@ class MatrixOperator:
                 g = G2 - G1
             sbuf_ng = self.work1_xG.reshape(-1)[:N * g].reshape(N, g)
             rbuf_ng = self.work2_xG.reshape(-1)[:N * g].reshape(N, g)
+            spare_ng = None
+            if B > 1:
+                spare_ng = self.work3_xG.reshape(-1)[:N * g].reshape(N, g)
             sbuf_ng[:] = psit_nG[:, G1:G2]
             beta = 0.0
             cycle_P_ani = (j == J - 1 and P_ani)
@@ -567,17 +691,25 @@ class MatrixOperator:
                         gemm(1.0, sbuf_In[I1:I2].T.copy(), C_nn, beta, P_ni)
                         I1 = I2
 
-                # Wait for all send/receives to finish before next iteration.
-                # Swap send and receive buffer such that next becomes current.
-                # If we're at the last slice, also finishes the P_ani cycle.
+                # Wait for the receive to finish before next iteration;
+                # the send stays in flight while the next block is
+                # processed.  Rotate the buffers so the received set
+                # becomes current.  If we're at the last slice, also
+                # finishes the P_ani cycle.
                 if q < Q - 1:
-                    sbuf_ng, rbuf_ng, sbuf_In, rbuf_In = self._finish_cycle(
-                        sbuf_ng, rbuf_ng, sbuf_In, rbuf_In, cycle_P_ani)
+                    (sbuf_ng, rbuf_ng, spare_ng, sbuf_In,
+                     rbuf_In) = self._finish_cycle(
+                        sbuf_ng, rbuf_ng, spare_ng, sbuf_In, rbuf_In,
+                        cycle_P_ani)
 
                 # First iteration was special because we initialized the kets
                 if q == 0:
                     beta = 1.0
 
+            # Complete outstanding sends before the buffers are reused
+            # for the next slice:
+            self._drain_cycle()
+
         psit_nG.shape = shape
         return psit_nG
 
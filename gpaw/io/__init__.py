@@ -16,7 +16,8 @@ import numpy as np
 import gpaw.mpi as mpi
 import os,time,tempfile
 
-def open(filename, mode='r', comm=mpi.world):
+def open(filename, mode='r', comm=mpi.world, background=False):
+    tar = False
     if filename.endswith('.nc'):
         import gpaw.io.netcdf as io
     elif filename.endswith('.db'):
@@ -27,14 +28,37 @@ def open(filename, mode='r', comm=mpi.world):
         if not filename.endswith('.gpw'):
             filename += '.gpw'
         import gpaw.io.tar as io
+        tar = True
 
     if mode == 'r':
         return io.Reader(filename, comm)
     elif mode == 'w':
+        if tar:
+            # Only the tar writer can drain to disk in the background:
+            return io.Writer(filename, comm, background)
         return io.Writer(filename, comm)
     else:
         raise ValueError("Illegal mode!  Use 'r' or 'w'.")
 
+
+class FileReference:
+    """Common base class for on-demand references to wave functions.
+
+    Readers can return an object of this type instead of a full ndarray
+    for the big wave-function arrays, so that a restart only reads the
+    bands that are actually dereferenced.  Subclasses must provide
+    shape, dtype and indexing with [int] or [:]."""
+
+    def __len__(self):
+        return self.shape[0]
+
+    def __iter__(self):
+        for i in range(len(self)):
+            yield self[i]
+
+    def __array__(self):
+        return self[::]
+
 def wave_function_name_template(mode):
     try:
         ftype, template = mode.split(':')
@@ -43,9 +67,27 @@ def wave_function_name_template(mode):
         template = 'wfs/psit_Gs%dk%dn%d'
     return ftype, template
 
-def write(paw, filename, mode, cmr_params=None, **kwargs):
+def write(paw, filename, mode, cmr_params=None, background=False,
+          compress=False, delta=None, **kwargs):
     """Write state to file.
-    
+
+    With background=True (gpw files only) the state is serialized into
+    a memory buffer as usual, but the buffer is written to disk by a
+    background thread on the master, so the calculation only blocks for
+    the time it takes to collect the arrays.  The checkpoint is
+    guaranteed to be on disk before the next write and at interpreter
+    exit.
+
+    The delta argument (gpw files only) must be a
+    gpaw.io.delta.DeltaCheckpointer, which decides whether this
+    snapshot becomes a full dump or a delta storing only the arrays
+    that changed since the last full dump.  Normally used through the
+    checkpointer's own write method.
+
+    With compress=True (gpw files only) the wave functions are stored
+    band by band in 32-bit precision with zlib compression; restarting
+    from such a file typically costs one extra SCF iteration.
+
     The `mode` argument should be one of:
 
     ``''``:
@@ -86,8 +128,11 @@ def write(paw, filename, mode, cmr_params=None, **kwargs):
     hdf5 = filename.endswith('.hdf5')
 
     if master or hdf5:
-        w = open(filename, 'w', world)
-        
+        if delta is not None:
+            w = delta.open(filename, world, background)
+        else:
+            w = open(filename, 'w', world, background)
+
         w['history'] = 'GPAW restart file'
         w['version'] = '0.8'
         w['lengthunit'] = 'Bohr'
@@ -357,7 +402,7 @@ def write(paw, filename, mode, cmr_params=None, **kwargs):
     hamiltonian.xc.write(w, natoms)
 
     if mode == 'all':
-        wfs.write_wave_functions(w)
+        wfs.write_wave_functions(w, compress)
     elif mode != '':
         # Write the wave functions as seperate files
 
@@ -476,7 +521,7 @@ def read(paw, reader):
     nt_sG = wfs.gd.empty(density.nspins)
     if hdf5:
         indices = [slice(0, density.nspins),] + wfs.gd.get_slice()
-        nt_sG[:] = r.get('PseudoElectronDensity', *indices)
+        nt_sG[:] = r.get('PseudoElectronDensity', parallel=True, *indices)
     else:
         for s in range(density.nspins):
             wfs.gd.distribute(r.get('PseudoElectronDensity', s), nt_sG[s])
@@ -494,7 +539,8 @@ def read(paw, reader):
         hamiltonian.vt_sG = wfs.gd.empty(hamiltonian.nspins)
         if hdf5:
             indices = [slice(0, hamiltonian.nspins), ] + wfs.gd.get_slice()
-            hamiltonian.vt_sG[:] = r.get('PseudoPotential', *indices)
+            hamiltonian.vt_sG[:] = r.get('PseudoPotential', parallel=True,
+                                         *indices)
         else:
             for s in range(hamiltonian.nspins):
                 wfs.gd.distribute(r.get('PseudoPotential', s),
@@ -609,10 +655,12 @@ def read(paw, reader):
         if (r.has_array('PseudoWaveFunctions') and
             paw.input_parameters.mode == 'fd'):
             
-            if band_comm.size == 1 and not hdf5:
+            if band_comm.size == 1 and (not hdf5 or world.size == 1):
                 # We may not be able to keep all the wave
                 # functions in memory - so psit_nG will be a special type of
-                # array that is really just a reference to a file:
+                # array that is really just a reference to a file.  In
+                # parallel, hdf5 still reads eagerly through the
+                # collective path below:
                 for kpt in wfs.kpt_u:
                     kpt.psit_nG = r.get_reference('PseudoWaveFunctions',
                                                   kpt.s, kpt.k)
@@ -624,7 +672,8 @@ def read(paw, reader):
                         indices = [kpt.s, kpt.k]
                         indices.append(wfs.bd.get_slice())
                         indices += wfs.gd.get_slice()
-                        kpt.psit_nG[:] = r.get('PseudoWaveFunctions', *indices)
+                        kpt.psit_nG[:] = r.get('PseudoWaveFunctions',
+                                               parallel=True, *indices)
                     else:
                         # Read band by band to save memory
                         for myn, psit_G in enumerate(kpt.psit_nG):
@@ -0,0 +1,137 @@
+"""Incremental delta checkpoints between full restart dumps.
+
+A delta checkpoint is an ordinary gpw tar file, except that arrays
+whose md5 checksum did not change since the last full dump are not
+stored: their info.xml entry is marked stored="base" and the DeltaBase
+parameter holds the name of the full dump.  gpaw.io.tar.Reader follows
+such entries transparently, so every snapshot can be read like a
+normal restart file at the cost of one extra file open.  Deltas always
+point at the last full dump - never at each other - so any snapshot
+needs only two files to reconstruct.
+
+For MD and relaxation runs, where consecutive snapshots share most of
+their arrays, this cuts the checkpoint traffic by an order of
+magnitude.  Use it through DeltaCheckpointer::
+
+    chk = DeltaCheckpointer('md%05d.gpw', interval=10)
+    for step in steps:
+        ...
+        chk.write(calc, mode='all')
+"""
+
+import os
+
+import numpy as np
+
+from gpaw.utilities.tools import md5_new
+from gpaw.io.tar import Writer as TarWriter
+
+
+class DeltaWriter(TarWriter):
+    """Tar writer that drops arrays unchanged since the base dump.
+
+    Array members are buffered until they are complete, so that their
+    checksum can be compared with the base before the tar header is
+    written.  The master therefore temporarily holds the largest array
+    in memory - the same order of overhead as background writing.  The
+    compress flag is ignored; delta members are always stored raw."""
+
+    def __init__(self, name, comm=None, base=None, checksums=None,
+                 background=False):
+        TarWriter.__init__(self, name, comm, background)
+        self.base = base
+        self.old_checksums = checksums or {}
+        self.checksums = {}
+        self.delta_name = None
+        if base is not None:
+            self['DeltaBase'] = os.path.basename(base)
+
+    def add(self, name, shape, array=None, dtype=None, units=None,
+            compress=False):
+        if array is not None:
+            array = np.asarray(array)
+
+        self.finish_delta()
+        self.dtype, type, itemsize = self.get_data_type(array, dtype)
+        self.delta_name = name
+        self.delta_type = type
+        self.delta_xmlindex = len(self.xml2)
+        self.delta_data = []
+        self.delta_md5 = md5_new()
+        self.xml2 += ['  <array name="%s" type="%s">' % (name, type)]
+        self.xml2 += ['    <dimension length="%s" name="%s"/>' %
+                      (self.dims[dim], dim)
+                      for dim in shape]
+        self.xml2 += ['  </array>']
+        self.shape = [self.dims[dim] for dim in shape]
+        if array is not None:
+            self.fill(array)
+
+    def fill(self, array, *indices):
+        string = np.asarray(array, self.dtype).tostring()
+        self.delta_md5.update(string)
+        self.delta_data.append(string)
+
+    def finish_delta(self):
+        """Write out a buffered member, or just point at the base."""
+        if self.delta_name is None:
+            return
+        name = self.delta_name
+        self.delta_name = None
+        digest = self.delta_md5.hexdigest()
+        self.checksums[name] = digest
+        if self.base is not None and self.old_checksums.get(name) == digest:
+            self.xml2[self.delta_xmlindex] = (
+                '  <array name="%s" type="%s" stored="base">' %
+                (name, self.delta_type))
+            self.delta_data = []
+            return
+        self.write_header(name, sum([len(string)
+                                     for string in self.delta_data]))
+        for string in self.delta_data:
+            self.write(string)
+        self.delta_data = []
+
+    def close(self):
+        self.finish_delta()
+        TarWriter.close(self)
+
+
+class DeltaCheckpointer:
+    """Write a sequence of restart files as full dumps plus deltas.
+
+    Every `interval` snapshots a complete restart file is written; the
+    snapshots in between only store the arrays whose checksum changed
+    since the last full dump.  All snapshots can be read back with the
+    ordinary restart machinery."""
+
+    def __init__(self, template, interval=10):
+        assert template.endswith('.gpw')
+        self.template = template
+        self.interval = interval
+        self.count = 0
+        self.base = None
+        self.checksums = None
+        self.writer = None
+
+    def open(self, filename, comm, background=False):
+        """Called back from gpaw.io.write on the master."""
+        if self.count % self.interval == 0:
+            base = None  # full dump
+        else:
+            base = self.base
+        self.writer = DeltaWriter(filename, comm, base, self.checksums,
+                                  background)
+        return self.writer
+
+    def write(self, paw, mode='all', **kwargs):
+        """Write the next snapshot."""
+        import gpaw.io
+        filename = self.template % self.count
+        gpaw.io.write(paw, filename, mode, delta=self, **kwargs)
+        if self.count % self.interval == 0:
+            if self.writer is not None:  # master only
+                self.checksums = self.writer.checksums
+            self.base = filename
+        self.writer = None
+        self.count += 1
@@ -7,22 +7,28 @@ from gpaw.wavefunctions.pw import PWDescriptor
 
 
 class ETSFWriter:
-    def __init__(self, filename='gpaw', title='gpaw'):
+    def __init__(self, filename='gpaw', title='gpaw', comm=None):
         if not filename.endswith('-etsf.nc'):
             if filename.endswith('.nc'):
                 filename = filename[:-3] + '-etsf.nc'
             else:
                 filename = filename + '-etsf.nc'
-            
-        self.nc = NetCDFFile(filename, 'w')
 
-        self.nc.file_format = 'ETSF Nanoquanta'
-        self.nc.file_format_version = np.array([3.3], dtype=np.float32)
-        self.nc.Conventions = 'http://www.etsf.eu/fileformats/'
-        self.nc.history = 'File generated by GPAW'
-        self.nc.title = title
+        self.filename = filename
+        self.comm = comm
+        self.master = comm is None or comm.rank == 0
+
+        if self.master:
+            self.nc = NetCDFFile(filename, 'w')
+
+            self.nc.file_format = 'ETSF Nanoquanta'
+            self.nc.file_format_version = np.array([3.3], dtype=np.float32)
+            self.nc.Conventions = 'http://www.etsf.eu/fileformats/'
+            self.nc.history = 'File generated by GPAW'
+            self.nc.title = title
 
-    def write(self, calc, ecut=40 * Hartree, spacegroup=1):
+    def write(self, calc, ecut=40 * Hartree, spacegroup=1,
+              distributed=False):
 
         #sg = Spacegroup(spacegroup)
         #print sg
@@ -91,8 +97,9 @@ class ETSFWriter:
             ('symbol_length', 2)]
 
         for name, size in dimensions:
-            print('%-34s %d' % (name, size))
-            self.nc.createDimension(name, size)
+            if self.master:
+                print('%-34s %d' % (name, size))
+                self.nc.createDimension(name, size)
 
         var = self.add_variable
         
@@ -166,19 +173,94 @@ class ETSFWriter:
                            'real_or_complex_coefficients'))
         
         x = atoms.get_volume()**0.5 / N_c.prod()
-        psit_Gx = np.empty((len(i_Gc), 2))
-        for s in range(wfs.nspins):
-            for k in range(kd.nibzkpts):
-                for n in range(bd.nbands):
-                    psit_G = pwd.fft(calc.get_pseudo_wave_function(n, k, s))[np.argsort(G2_Q)]
-                    psit_G *= x
-                    psit_Gx[:, 0] = psit_G.real
-                    psit_Gx[:, 1] = psit_G.imag
-                    psit_skn1G2[s, k, n, 0] = psit_Gx
-
-        self.nc.close()
-    
+        if distributed:
+            # Bypass the master gather: every rank writes its slab of
+            # the real-space wave functions to its own shard and the
+            # coefficients variable stays empty until stitch_shards()
+            # fills it from the shards:
+            if self.master:
+                self.nc.shard_name_template = (self.filename[:-3] +
+                                               '-shard%04d.nc')
+                self.nc.number_of_shards = np.array([wfs.world.size],
+                                                    np.int32)
+                self.nc.coefficients_scale = np.array([x])
+            self.write_shard(calc)
+        elif self.master:
+            psit_Gx = np.empty((len(i_Gc), 2))
+            for s in range(wfs.nspins):
+                for k in range(kd.nibzkpts):
+                    for n in range(bd.nbands):
+                        psit_G = pwd.fft(calc.get_pseudo_wave_function(n, k, s))[np.argsort(G2_Q)]
+                        psit_G *= x
+                        psit_Gx[:, 0] = psit_G.real
+                        psit_Gx[:, 1] = psit_G.imag
+                        psit_skn1G2[s, k, n, 0] = psit_Gx
+
+        if self.master:
+            self.nc.close()
+
+    def write_shard(self, calc):
+        """Write this rank's slab of the wave functions.
+
+        Each shard is self-describing: it records the global grid
+        slice, the global band indices and the (spin, k-point) pairs
+        that it covers.  Together these form the stitching index used
+        by stitch_shards()."""
+        wfs = calc.wfs
+        gd = wfs.gd
+        bd = wfs.bd
+        cmplx = (wfs.dtype == complex)
+
+        nc = NetCDFFile(self.filename[:-3] +
+                        '-shard%04d.nc' % wfs.world.rank, 'w')
+        nc.file_format = 'ETSF Nanoquanta shard'
+
+        nu = len(wfs.kpt_u)
+        nc.createDimension('number_of_local_kpoints', nu)
+        nc.createDimension('number_of_local_states', bd.mynbands)
+        nc.createDimension('number_of_cartesian_directions', 3)
+        for c in range(3):
+            nc.createDimension('number_of_grid_points_vector%d' % (c + 1),
+                               int(gd.n_c[c]))
+        if cmplx:
+            nc.createDimension('real_or_complex_coefficients', 2)
+
+        def var(name, dims, data):
+            v = nc.createVariable(name, np.asarray(data).dtype.char, dims)
+            v[:] = data
+            return v
+
+        var('grid_slice_begin', ('number_of_cartesian_directions',),
+            np.asarray(gd.beg_c, np.int32))
+        var('grid_slice_end', ('number_of_cartesian_directions',),
+            np.asarray(gd.end_c, np.int32))
+        var('spin_indices', ('number_of_local_kpoints',),
+            np.array([kpt.s for kpt in wfs.kpt_u], np.int32))
+        var('kpoint_indices', ('number_of_local_kpoints',),
+            np.array([kpt.k for kpt in wfs.kpt_u], np.int32))
+        var('band_indices', ('number_of_local_states',),
+            np.asarray(bd.get_band_indices(), np.int32))
+
+        dims = ('number_of_local_kpoints', 'number_of_local_states',
+                'number_of_grid_points_vector1',
+                'number_of_grid_points_vector2',
+                'number_of_grid_points_vector3')
+        if cmplx:
+            dims += ('real_or_complex_coefficients',)
+        psit_unR = nc.createVariable('real_space_wavefunctions', 'd', dims)
+        for u, kpt in enumerate(wfs.kpt_u):
+            for myn in range(bd.mynbands):
+                psit_R = np.asarray(kpt.psit_nG[myn])
+                if cmplx:
+                    psit_unR[u, myn, ..., 0] = psit_R.real
+                    psit_unR[u, myn, ..., 1] = psit_R.imag
+                else:
+                    psit_unR[u, myn] = psit_R
+        nc.close()
+
     def add_variable(self, name, dims, data=None, **kwargs):
+        if not self.master:
+            return None
         if data is None:
             char = 'd'
         else:
@@ -209,3 +291,64 @@ class ETSFWriter:
                 else:
                     var[:] = data
         return var
+
+
+def stitch_shards(filename):
+    """Fill in the wave-function coefficients of a distributed export.
+
+    Opens the main ETSF file written with write(calc, distributed=True)
+    and the per-rank shards next to it, reconstructs each band on the
+    full grid from the shard slices, Fourier transforms it and writes
+    coefficients_of_wavefunctions.  Pure post-processing: only the
+    files and numpy are needed, not the calculator."""
+    if not filename.endswith('-etsf.nc'):
+        if filename.endswith('.nc'):
+            filename = filename[:-3] + '-etsf.nc'
+        else:
+            filename = filename + '-etsf.nc'
+    nc = NetCDFFile(filename, 'a')
+    N_c = np.array([nc.dimensions['number_of_grid_points_vector%d' % (c + 1)]
+                    for c in range(3)])
+    nspins = nc.dimensions['number_of_spins']
+    nkpts = nc.dimensions['number_of_kpoints']
+    nbands = nc.dimensions['max_number_of_states']
+
+    # Flat fft-grid index of each (sorted) plane wave:
+    i_Gc = np.asarray(nc.variables['reduced_coordinates_of_plane_waves'][:])
+    Q_G = np.dot(i_Gc % N_c, np.array([N_c[1] * N_c[2], N_c[2], 1]))
+    scale = float(nc.coefficients_scale[0])
+
+    shards = []
+    for rank in range(int(nc.number_of_shards[0])):
+        snc = NetCDFFile(str(nc.shard_name_template) % rank)
+        shards.append((snc,
+                       np.asarray(snc.variables['spin_indices'][:]),
+                       np.asarray(snc.variables['kpoint_indices'][:]),
+                       np.asarray(snc.variables['band_indices'][:]),
+                       np.asarray(snc.variables['grid_slice_begin'][:]),
+                       np.asarray(snc.variables['grid_slice_end'][:])))
+
+    psit_skn1G2 = nc.variables['coefficients_of_wavefunctions']
+    psit_Gx = np.empty((len(Q_G), 2))
+    for s in range(nspins):
+        for k in range(nkpts):
+            for n in range(nbands):
+                psit_R = np.zeros(N_c, complex)
+                for snc, s_u, k_u, n_n, beg_c, end_c in shards:
+                    psit_unR = snc.variables['real_space_wavefunctions']
+                    for u in np.where((s_u == s) & (k_u == k))[0]:
+                        for myn in np.where(n_n == n)[0]:
+                            a = np.asarray(psit_unR[u, myn])
+                            if a.ndim == 4:
+                                a = a[..., 0] + 1.0j * a[..., 1]
+                            psit_R[beg_c[0]:end_c[0],
+                                   beg_c[1]:end_c[1],
+                                   beg_c[2]:end_c[2]] = a
+                psit_G = np.fft.fftn(psit_R).ravel()[Q_G] * scale
+                psit_Gx[:, 0] = psit_G.real
+                psit_Gx[:, 1] = psit_G.imag
+                psit_skn1G2[s, k, n, 0] = psit_Gx
+
+    for shard in shards:
+        shard[0].close()
+    nc.close()
@@ -7,6 +7,8 @@ import _gpaw
 
 import numpy as np
 
+from gpaw.io import FileReference
+
 intsize = 4
 floatsize = np.array([1], float).itemsize
 complexsize = np.array([1], complex).itemsize
@@ -150,8 +152,8 @@ class Writer:
         self.file.close()
         
 class Reader:
-    def __init__(self, name, comm=False):
-        self.file = File(name, 'r')
+    def __init__(self, name, comm=None):
+        self.file = File(name, 'r', comm)
         self.params_grp = self.file['Parameters']
         self.hdf5_reader = True
 
@@ -177,15 +179,24 @@ class Reader:
         except KeyError:
             parallel = False
 
+        dset = self.file[name]
         if parallel:
-            # Create H5P_DATASET_XFER property list
+            # Collective hyperslab read: every rank of the file
+            # communicator reads its own file-space selection in a
+            # single collective operation (the mirror image of the
+            # parallel write path in Writer.fill).
             plist = h5py.h5p.create(h5py.h5p.DATASET_XFER)
-            _gpaw.set_dxpl_mpio(plist.id)
+            _gpaw.h5_set_dxpl_mpio(plist.id)
+            mtype = None
+            selection = sel.select(dset.shape, indices)
+            mshape = selection.mshape
+            array = np.empty(mshape, dset.dtype)
+            mspace = h5py.h5s.create_simple(mshape,
+                                            (h5py.h5s.UNLIMITED,) *
+                                            len(mshape))
+            dset.id.read(mspace, selection.id, array, mtype, plist)
         else:
-            plist = None
-
-        dset = self.file[name]
-        array = dset[indices]
+            array = dset[indices]
         if array.shape == ():
             return array.item()
         else:
@@ -193,11 +204,41 @@ class Reader:
 
     def get_reference(self, name, *indices):
         dset = self.file[name]
-        array = dset[indices]
-        return array
+        return HDF5FileReference(dset, indices)
 
     def get_parameters(self):
         return self.params_grp.attrs
-    
+
     def close(self):
         self.file.close()
+
+class HDF5FileReference(FileReference):
+    """On-demand reference to part of a dataset in an HDF5 file.
+
+    The HDF5 counterpart of TarFileReference: indexing reads just the
+    requested bands from the file instead of loading the whole array."""
+
+    def __init__(self, dset, indices):
+        self.dset = dset
+        self.indices = tuple(indices)
+        self.shape = dset.shape[len(self.indices):]
+        self.dtype = dset.dtype
+        self.itemsize = self.dtype.itemsize
+
+    def __getitem__(self, indices):
+        if isinstance(indices, slice):
+            start, stop, step = indices.indices(len(self))
+            if start != 0 or step != 1 or stop != len(self):
+                raise NotImplementedError('You can only slice an HDF5 '
+                                          'reference with [:] or [int]')
+            else:
+                indices = ()
+        elif isinstance(indices, int):
+            indices = (indices,)
+        else: # Probably tuple or ellipsis
+            raise NotImplementedError('You can only slice an HDF5 '
+                                      'reference with [:] or [int]')
+
+        array = self.dset[self.indices + indices]
+        array.shape = self.shape[len(indices):]
+        return array
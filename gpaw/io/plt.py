@@ -6,6 +6,7 @@ import numpy as np
 from ase.units import Bohr
 
 import gpaw.mpi as mpi
+import _gpaw
 
 
 def read_plt(filename):
@@ -120,6 +121,36 @@ def write_plt(cell,
 
     f.close()
 
+def write_plts(cell,
+               grid_ng,
+               template,
+               origin=(0.0,0.0,0.0),
+               typ=4):
+    """Write a batch of fields to plt files in one call.
+
+    Like write_plt, but grid_ng holds a whole batch of fields (e.g. a
+    band/spin batch from a TDDFT run) and template is a filename with
+    one %d in it.  The conversion and writing happen in C with a large
+    reused buffer, so this is much faster than one write_plt call per
+    field."""
+    a0_A = Bohr
+    if hasattr(cell, '_new_array'): # this is a GridDescriptor
+        xe, ye, ze = cell.h_c * cell.N_c * a0_A # get Angstroms
+    elif len(cell.shape) == 2:
+        # Check that the cell is orthorhombic
+        assert not cell.flat[[1, 2, 3, 5, 6, 7]].any()
+        xe, ye, ze = np.diagonal(cell)
+    else:
+        xe, ye, ze = cell * a0_A # get Angstroms
+
+    grid_ng = np.ascontiguousarray(grid_ng, float)
+    if grid_ng.ndim != 4:
+        raise RuntimeError("grid_ng must be a batch of 3D fields")
+    nx, ny, nz = grid_ng.shape[1:]
+    dx, dy, dz = [ xe/(nx+1), ye/(ny+1), ze/(nz+1) ]
+    origin_c = np.array(origin) + np.array([dx,dy,dz])
+    _gpaw.WritePLTs(template, origin_c, np.array([dx,dy,dz]), grid_ng, typ)
+
 def wf2plt(paw,i,spin=0,fname=None):
     """Write a specific wavefunction as plt file"""
     kpt = paw.kpt_u[spin]
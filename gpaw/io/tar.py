@@ -1,19 +1,40 @@
 import os
 import time
+import zlib
 import tarfile
+import threading
 import xml.sax
+from cStringIO import StringIO
 
 import numpy as np
 
+from gpaw.io import FileReference
+
 
 intsize = 4
 floatsize = np.array([1], float).itemsize
 complexsize = np.array([1], complex).itemsize
 itemsizes = {'int': intsize, 'float': floatsize, 'complex': complexsize}
 
-    
+# Storage types for compressed arrays - restart accuracy does not need
+# the full 64 bits:
+compressed_dtypes = {np.dtype(float): np.dtype(np.float32),
+                     np.dtype(complex): np.dtype(np.complex64)}
+
+# Thread draining the last background checkpoint to disk (master only):
+_background_thread = None
+
+def wait_for_background_writes():
+    """Block until a previous background checkpoint is on disk."""
+    global _background_thread
+    if _background_thread is not None:
+        _background_thread.join()
+        _background_thread = None
+
+
 class Writer:
-    def __init__(self, name, comm=None):
+    def __init__(self, name, comm=None, background=False):
+        wait_for_background_writes()
         self.dims = {}
         self.files = {}
         self.xml1 = ['<gpaw_io version="0.1" endianness="%s">' %
@@ -21,8 +42,18 @@ class Writer:
         self.xml2 = []
         if os.path.isfile(name):
             os.rename(name, name[:-4] + '.old'+name[-4:])
-        self.tar = tarfile.open(name, 'w')
+        self.name = name
+        self.background = background
+        if background:
+            # Serialize into a shadow buffer; close() hands the buffer
+            # to a writer thread so that the disk traffic overlaps the
+            # calculation:
+            self.buffer = StringIO()
+            self.tar = tarfile.open(name, 'w', self.buffer)
+        else:
+            self.tar = tarfile.open(name, 'w')
         self.mtime = int(time.time())
+        self.compress = False
         
     def dimension(self, name, value):
         if name in self.dims.keys() and self.dims[name] != value:
@@ -34,11 +65,25 @@ class Writer:
         self.xml1 += ['  <parameter %-20s value="%s"/>' %
                       ('name="%s"' % name, value)]
         
-    def add(self, name, shape, array=None, dtype=None, units=None):
+    def add(self, name, shape, array=None, dtype=None, units=None,
+            compress=False):
         if array is not None:
             array = np.asarray(array)
 
+        self.finish_compressed()
         self.dtype, type, itemsize = self.get_data_type(array, dtype)
+        self.compress = compress
+        if compress:
+            # The tar header needs the final size, so the member is
+            # only written out when the next array starts (or at
+            # close); until then fill() just queues compressed chunks.
+            # The xml entry is patched with the chunk rank there:
+            self.chunk_name = name
+            self.chunk_type = type
+            self.chunk_dtype = compressed_dtypes[self.dtype]
+            self.chunk_xmlindex = len(self.xml2)
+            self.chunk_data = []
+            self.chunk_ndim = None
         self.xml2 += ['  <array name="%s" type="%s">' % (name, type)]
         self.xml2 += ['    <dimension length="%s" name="%s"/>' %
                       (self.dims[dim], dim)
@@ -46,7 +91,8 @@ class Writer:
         self.xml2 += ['  </array>']
         self.shape = [self.dims[dim] for dim in shape]
         size = itemsize * np.product([self.dims[dim] for dim in shape])
-        self.write_header(name, size)
+        if not compress:
+            self.write_header(name, size)
         if array is not None:
             self.fill(array)
 
@@ -65,7 +111,38 @@ class Writer:
         return dtype, type, dtype.itemsize
 
     def fill(self, array, *indices):
-        self.write(np.asarray(array, self.dtype).tostring())
+        if self.compress:
+            a = np.asarray(array, self.chunk_dtype)
+            if self.chunk_ndim is None:
+                self.chunk_ndim = a.ndim
+            else:
+                assert a.ndim == self.chunk_ndim
+            self.chunk_data.append(zlib.compress(a.tostring()))
+        else:
+            self.write(np.asarray(array, self.dtype).tostring())
+
+    def finish_compressed(self):
+        """Write out a queued compressed member.
+
+        The member starts with an int64 table of chunk boundaries
+        (nchunks + 1 entries, relative to the end of the table),
+        followed by the compressed chunks."""
+        if not self.compress:
+            return
+        self.compress = False
+        nchunks = len(self.chunk_data)
+        offset_q = np.zeros(nchunks + 1, np.int64)
+        offset_q[1:] = np.cumsum([len(data) for data in self.chunk_data])
+        self.xml2[self.chunk_xmlindex] = (
+            '  <array name="%s" type="%s" compressed="zlib" chunkrank="%d">'
+            % (self.chunk_name, self.chunk_type, self.chunk_ndim))
+        self.write_header(self.chunk_name,
+                          offset_q.itemsize * len(offset_q) +
+                          int(offset_q[-1]))
+        self.write(offset_q.tostring())
+        for data in self.chunk_data:
+            self.write(data)
+        self.chunk_data = []
 
     def write_header(self, name, size):
         assert name not in self.files.keys()
@@ -88,19 +165,42 @@ class Writer:
             self.tar.offset += blocks * tarfile.BLOCKSIZE
         
     def close(self):
+        self.finish_compressed()
         self.xml2 += ['</gpaw_io>\n']
         string = '\n'.join(self.xml1 + self.xml2)
         self.write_header('info.xml', len(string))
         self.write(string)
         self.tar.close()
+        if self.background:
+            global _background_thread
+            _background_thread = threading.Thread(target=self.drain)
+            _background_thread.start()
+
+    def drain(self):
+        """Write the shadow buffer to disk (runs in the writer thread).
+
+        The data goes to a temporary file which is renamed into place,
+        so readers never see a half-written checkpoint."""
+        tmpname = self.name + '.tmp'
+        f = open(tmpname, 'wb')
+        f.write(self.buffer.getvalue())
+        f.close()
+        self.buffer.close()
+        os.rename(tmpname, self.name)
 
 
 class Reader(xml.sax.handler.ContentHandler):
     def __init__(self, name, comm=None):
+        wait_for_background_writes()
         self.dims = {}
         self.shapes = {}
         self.dtypes = {}
+        self.compressed = {}
+        self.chunkranks = {}
+        self.stored = {}
+        self.base = None
         self.parameters = {}
+        self.filename = name
         xml.sax.handler.ContentHandler.__init__(self)
         self.tar = tarfile.open(name, 'r')
         f = self.tar.extractfile('info.xml')
@@ -113,6 +213,9 @@ class Reader(xml.sax.handler.ContentHandler):
         elif tag == 'array':
             name = attrs['name']
             self.dtypes[name] = attrs['type']
+            self.compressed[name] = attrs.get('compressed', None)
+            self.chunkranks[name] = int(attrs.get('chunkrank', '0'))
+            self.stored[name] = attrs.get('stored', None)
             self.shapes[name] = []
             self.name = name
         elif tag == 'dimension':
@@ -136,7 +239,21 @@ class Reader(xml.sax.handler.ContentHandler):
     def has_array(self, name):
         return name in self.shapes
     
+    def base_reader(self):
+        """Open the full dump that a delta checkpoint refers to.
+
+        Arrays marked stored="base" (see gpaw.io.delta) live in the
+        file named by the DeltaBase parameter, next to this one."""
+        if self.base is None:
+            self.base = Reader(os.path.join(os.path.dirname(self.filename),
+                                            self.parameters['DeltaBase']))
+        return self.base
+
     def get(self, name, *indices):
+        if self.stored.get(name) == 'base':
+            return self.base_reader().get(name, *indices)
+        if self.compressed.get(name):
+            return self.get_reference(name, *indices)[:]
         fileobj, shape, size, dtype = self.get_file_object(name, indices)
         array = np.fromstring(fileobj.read(size), dtype)
         if self.byteswap:
@@ -148,12 +265,21 @@ class Reader(xml.sax.handler.ContentHandler):
             return array.item()
         else:
             return array
-    
+
     def get_reference(self, name, *indices):
+        if self.stored.get(name) == 'base':
+            return self.base_reader().get_reference(name, *indices)
+        if self.compressed.get(name):
+            dtype, type, itemsize = self.get_data_type(name)
+            return CompressedTarFileReference(self.tar.extractfile(name),
+                                              self.shapes[name], dtype,
+                                              self.byteswap,
+                                              self.chunkranks[name],
+                                              indices)
         fileobj, shape, size, dtype = self.get_file_object(name, indices)
         assert dtype != np.int32
         return TarFileReference(fileobj, shape, dtype, self.byteswap)
-    
+
     def get_file_object(self, name, indices):
         dtype, type, itemsize = self.get_data_type(name)
         fileobj = self.tar.extractfile(name)
@@ -179,9 +305,11 @@ class Reader(xml.sax.handler.ContentHandler):
         return self.parameters
 
     def close(self):
+        if self.base is not None:
+            self.base.close()
         self.tar.close()
 
-class TarFileReference:
+class TarFileReference(FileReference):
     def __init__(self, fileobj, shape, dtype, byteswap):
         self.fileobj = fileobj
         self.shape = tuple(shape)
@@ -190,13 +318,6 @@ class TarFileReference:
         self.byteswap = byteswap
         self.offset = fileobj.tell()
 
-    def __len__(self):
-        return self.shape[0]
-
-    def __iter__(self):
-        for i in range(len(self)):
-            yield self[i]
-
     def __getitem__(self, indices):
         if isinstance(indices, slice):
             start, stop, step = indices.indices(len(self))
@@ -226,5 +347,69 @@ class TarFileReference:
         array.shape = self.shape[n:]
         return array
 
-    def __array__(self):
-        return self[::]
+
+class CompressedTarFileReference(FileReference):
+    """Reference to a compressed, reduced-precision tar member.
+
+    One chunk was written per fill() call (for wave functions: one
+    band), converted to 32-bit precision and deflated.  Dereferencing
+    decompresses just the requested chunks and converts them back to
+    the declared dtype."""
+
+    def __init__(self, fileobj, shape, dtype, byteswap, chunkrank,
+                 indices):
+        self.fileobj = fileobj
+        self.offset = fileobj.tell()
+        self.fullshape = tuple(shape)
+        self.dtype = dtype
+        self.itemsize = dtype.itemsize
+        self.byteswap = byteswap
+        nlead = len(self.fullshape) - chunkrank
+        assert len(indices) <= nlead
+        self.shape = self.fullshape[len(indices):]
+        self.chunkshape = self.fullshape[nlead:]
+        self.nchunks = int(np.prod(self.fullshape[:nlead], dtype=int))
+        # Flat index of the first chunk covered by indices and the
+        # number of chunks covered:
+        self.base = 0
+        for d in range(nlead):
+            i = indices[d] if d < len(indices) else 0
+            self.base = self.base * self.fullshape[d] + i
+        self.ncovered = int(np.prod(self.fullshape[len(indices):nlead],
+                                    dtype=int))
+
+    def read_chunk(self, c):
+        self.fileobj.seek(self.offset + 8 * c)
+        offset_q = np.fromstring(self.fileobj.read(16), np.int64)
+        if self.byteswap:
+            offset_q = offset_q.byteswap()
+        self.fileobj.seek(self.offset + 8 * (self.nchunks + 1) +
+                          int(offset_q[0]))
+        data = self.fileobj.read(int(offset_q[1] - offset_q[0]))
+        array = np.fromstring(zlib.decompress(data),
+                              compressed_dtypes[self.dtype])
+        if self.byteswap:
+            array = array.byteswap()
+        array = np.asarray(array, self.dtype)
+        array.shape = self.chunkshape
+        return array
+
+    def __getitem__(self, indices):
+        if isinstance(indices, slice):
+            start, stop, step = indices.indices(len(self))
+            if start != 0 or step != 1 or stop != len(self):
+                raise NotImplementedError('You can only slice a compressed '
+                                          'reference with [:] or [int]')
+            array = np.concatenate([self.read_chunk(self.base + c).ravel()
+                                    for c in range(self.ncovered)])
+            array.shape = self.shape
+            return array
+        elif isinstance(indices, int):
+            if len(self.shape) - len(self.chunkshape) != 1:
+                raise NotImplementedError('You can only index the chunk '
+                                          'dimension of a compressed '
+                                          'reference')
+            return self.read_chunk(self.base + indices)
+        else: # Probably tuple or ellipsis
+            raise NotImplementedError('You can only slice a compressed '
+                                      'reference with [:] or [int]')
@@ -1,8 +1,11 @@
 # Copyright (C) 2010  CAMd
 # Copyright (C) 2010  Argonne National Laboratory
 # Please see the accompanying LICENSE file for further information.
+from time import time
+
 import numpy as np
 
+from gpaw import extra_parameters
 from gpaw.mpi import SerialCommunicator, serial_comm
 from gpaw.matrix_descriptor import MatrixDescriptor, \
     BandMatrixDescriptor, \
@@ -12,7 +15,7 @@ from gpaw.utilities import uncamelcase
 from gpaw.utilities.blas import gemm, r2k, gemmdot
 from gpaw.utilities.lapack import diagonalize, general_diagonalize, \
     inverse_cholesky
-from gpaw.utilities.scalapack import pblas_simple_gemm
+from gpaw.utilities.scalapack import pblas_gemm
 from gpaw.utilities.tools import tri2full
 from gpaw.utilities.timing import nulltimer
 
@@ -225,7 +228,12 @@ class BlacsBandLayouts(BlacsLayouts): #XXX should derive from BandLayouts too!
         # Resulting matrix will be used in dgemm which is symmetry obvlious
         self.nn2nN = Redistributor(self.blockcomm, self.nndescriptor,
                                    self.nNdescriptor)
-        
+
+        # Layouts for replicated generalized eigenproblems (the
+        # Davidson solver's doubled subspace); built on first use
+        # since the size is not ours to know here:
+        self.replicated_N = 0
+
     def diagonalize(self, H_nn, eps_n):
         nbands = self.bd.nbands
         eps_N = np.empty(nbands)
@@ -242,9 +250,66 @@ class BlacsBandLayouts(BlacsLayouts): #XXX should derive from BandLayouts too!
         self.timer.stop('Distribute results')
 
     def _diagonalize(self, H_nn, eps_N):
-        """Parallel diagonalizer."""
-        self.nndescriptor.diagonalize_dc(H_nn.copy(), H_nn, eps_N, 'L')
+        """Parallel diagonalizer.
+
+        The divide-and-conquer driver is the safe default; the expert
+        and MRRR drivers can be selected with the
+        scalapack_diagonalizer extra parameter ('dc', 'ex' or 'mr3')."""
+        solver = extra_parameters.get('scalapack_diagonalizer', 'dc')
+        if solver == 'mr3':
+            self.nndescriptor.diagonalize_mr3(H_nn.copy(), H_nn, eps_N, 'L')
+        elif solver == 'ex':
+            self.nndescriptor.diagonalize_ex(H_nn.copy(), H_nn, eps_N, 'L')
+        else:
+            self.nndescriptor.diagonalize_dc(H_nn.copy(), H_nn, eps_N, 'L')
         
+    def general_diagonalize(self, H_NN, eps_N, S_NN):
+        """Distributed generalized eigenproblem for replicated matrices.
+
+        Used by the Davidson solver for its doubled subspace: H_NN and
+        S_NN are replicated arrays, valid (lower triangle) on blockcomm
+        rank 0.  They are scattered onto the 2D BLACS grid, solved
+        there with the parallel driver, and the eigenvectors collected
+        back into the rows of H_NN on blockcomm rank 0 - same
+        convention as the serial general_diagonalize."""
+        N = len(H_NN)
+        dtype = H_NN.dtype
+        if self.replicated_N != N:
+            onegrid = BlacsGrid(self.blockcomm, 1, 1)
+            self.replicateddescriptor = onegrid.new_descriptor(N, N, N, N)
+            mb = self.nndescriptor.mb
+            blockdescriptor = self.blockgrid.new_descriptor(N, N, mb, mb)
+            self.replicated2block = Redistributor(self.blockcomm,
+                                                  self.replicateddescriptor,
+                                                  blockdescriptor)
+            self.block2replicated = Redistributor(self.blockcomm,
+                                                  blockdescriptor,
+                                                  self.replicateddescriptor)
+            self.replicated_N = N
+
+        if self.replicateddescriptor:
+            Hr_NN, Sr_NN = H_NN, S_NN
+        else:
+            Hr_NN = self.replicateddescriptor.zeros(dtype=dtype)
+            Sr_NN = self.replicateddescriptor.zeros(dtype=dtype)
+        blockdescriptor = self.replicated2block.dstdescriptor
+        H_nn = blockdescriptor.zeros(dtype=dtype)
+        S_nn = blockdescriptor.zeros(dtype=dtype)
+        C_nn = blockdescriptor.zeros(dtype=dtype)
+        self.replicated2block.redistribute(Hr_NN, H_nn)
+        self.replicated2block.redistribute(Sr_NN, S_nn)
+
+        eps_X = np.empty(N)
+        self.timer.start('General diagonalize')
+        blockdescriptor.general_diagonalize_dc(H_nn, S_nn, C_nn, eps_X,
+                                               UL='L')
+        self.timer.stop('General diagonalize')
+
+        # Eigenvectors back into the rows of H_NN on blockcomm rank 0;
+        # eps_X is already there:
+        self.block2replicated.redistribute(C_nn, Hr_NN)
+        eps_N[:] = eps_X
+
     def inverse_cholesky(self, S_nn):
         self.timer.start('Inverse Cholesky')
         self._inverse_cholesky(S_nn)
@@ -262,6 +327,12 @@ class BlacsBandLayouts(BlacsLayouts): #XXX should derive from BandLayouts too!
         return ' '.join([title, s])
 
 
+# The best (grid shape, block size) found by autotuning, keyed by
+# (nao, ranks).  Kept for the process lifetime so that further
+# calculators of the same size skip the benchmark.
+_autotuned_layouts = {}
+
+
 class BlacsOrbitalLayouts(BlacsLayouts):
     """ScaLAPACK Dense Linear Algebra.
 
@@ -328,6 +399,110 @@ class BlacsOrbitalLayouts(BlacsLayouts):
         self.mm2nM = Redistributor(self.blockcomm, self.mmdescriptor,
                                    self.nM_unique_descriptor)
 
+        # 2D layouts for the density-matrix product: the coefficients
+        # are spread over the full block grid, so the O(nao^2 nbands)
+        # multiplication is divided over all ranks instead of being
+        # duplicated within every domain:
+        self.nmdescriptor = self.blockgrid.new_descriptor(nbands, nao,
+                                                          blocksize,
+                                                          blocksize)
+        self.nM2nm = Redistributor(self.blockcomm, self.nM_unique_descriptor,
+                                   self.nmdescriptor)
+        self.mm2mM = Redistributor(self.blockcomm, self.mmdescriptor,
+                                   self.mM_unique_descriptor)
+
+        # Layout autotuning (see _autotune_layout); the tuned
+        # redistributors replace mM2mm/mm2nM for the eigensolve only:
+        self.autotune = bool(extra_parameters.get('sl_autotune'))
+        self.mm2tuned = None
+        self.tuned2nM = None
+
+    def _solve(self, blockdescriptor, H_mm, S_mm, C_mm, eps_M):
+        # The divide-and-conquer driver is the safe default.  The
+        # expert drivers compute only the occupied subset of the
+        # eigenvectors (iu), which saves a large fraction of the
+        # back-transformation for big basis sets; select them with the
+        # scalapack_diagonalizer extra parameter.
+        solver = extra_parameters.get('scalapack_diagonalizer', 'dc')
+        if solver == 'mr3':
+            blockdescriptor.general_diagonalize_mr3(H_mm, S_mm.copy(), C_mm,
+                                                    eps_M, UL='L',
+                                                    iu=self.bd.nbands)
+        elif solver == 'ex':
+            # general_diagonalize_ex may have a buffer overflow - use
+            # with care
+            blockdescriptor.general_diagonalize_ex(H_mm, S_mm.copy(), C_mm,
+                                                   eps_M, UL='L',
+                                                   iu=self.bd.nbands)
+        else:
+            blockdescriptor.general_diagonalize_dc(H_mm, S_mm.copy(), C_mm,
+                                                   eps_M, UL='L')
+
+    def _layout_candidates(self):
+        """(grid shape, block size) combinations worth benchmarking."""
+        size = self.blockcomm.size
+        prow = int(np.sqrt(size))
+        while size % prow:
+            prow -= 1
+        shape_c = [(self.blockgrid.nprow, self.blockgrid.npcol)]
+        if (prow, size // prow) not in shape_c:
+            shape_c.append((prow, size // prow))
+        mb_c = sorted(set([mb for mb in [32, 64, self.mmdescriptor.mb]
+                           if mb <= self.nao]))
+        if not mb_c:
+            mb_c = [self.mmdescriptor.mb]
+        return [(nprow, npcol, mb)
+                for nprow, npcol in shape_c
+                for mb in mb_c]
+
+    def _autotune_layout(self, H_mm, S_mm):
+        """Pick the fastest BLACS layout by trying it on the real matrix.
+
+        The first diagonalization solves the actual (H, S) problem with
+        a few (grid shape, block size) candidates, times them, and
+        locks in the fastest one for the rest of the run.  Block size
+        32 vs 64 alone can make a factor of two in the eigensolver,
+        and which one wins depends on nao and the rank count.  The
+        incoming matrices keep the static layout - only the eigensolve
+        runs in the tuned one, at the price of one extra redistribution
+        per diagonalization."""
+        self.autotune = False
+        key = (self.nao, self.blockcomm.size)
+        best = _autotuned_layouts.get(key)
+        if best is None:
+            self.timer.start('Autotune layout')
+            eps_M = np.empty(self.nao)
+            t_x = np.empty(1)
+            results = []
+            for nprow, npcol, mb in self._layout_candidates():
+                grid = BlacsGrid(self.blockcomm, nprow, npcol)
+                desc = grid.new_descriptor(self.nao, self.nao, mb, mb)
+                redist = Redistributor(self.blockcomm, self.mmdescriptor,
+                                       desc)
+                H2_mm = desc.zeros(dtype=H_mm.dtype)
+                S2_mm = desc.zeros(dtype=S_mm.dtype)
+                C2_mm = desc.zeros(dtype=H_mm.dtype)
+                redist.redistribute(H_mm, H2_mm)
+                redist.redistribute(S_mm, S2_mm)
+                self.blockcomm.barrier()
+                t0 = time()
+                self._solve(desc, H2_mm, S2_mm, C2_mm, eps_M)
+                t_x[0] = time() - t0
+                self.blockcomm.max(t_x)
+                results.append((t_x[0], (nprow, npcol, mb)))
+            best = min(results)[1]
+            _autotuned_layouts[key] = best
+            self.timer.stop('Autotune layout')
+        if best == (self.blockgrid.nprow, self.blockgrid.npcol,
+                    self.mmdescriptor.mb):
+            return  # the static layout was already the fastest
+        nprow, npcol, mb = best
+        grid = BlacsGrid(self.blockcomm, nprow, npcol)
+        desc = grid.new_descriptor(self.nao, self.nao, mb, mb)
+        self.mm2tuned = Redistributor(self.blockcomm, self.mmdescriptor, desc)
+        self.tuned2nM = Redistributor(self.blockcomm, desc,
+                                      self.nM_unique_descriptor)
+
     def diagonalize(self, H_mm, C_nM, eps_n, S_mm):
         # C_nM needs to be simultaneously compatible with:
         # 1. outdescriptor
@@ -340,17 +515,25 @@ class BlacsOrbitalLayouts(BlacsLayouts):
         dtype = S_mm.dtype
         eps_M = np.empty(C_nM.shape[-1]) # empty helps us debug
         subM, subN = outdescriptor.gshape
-        
+
+        if self.autotune:
+            self._autotune_layout(H_mm, S_mm)
+        mm2nM = self.mm2nM
+        if self.mm2tuned is not None:
+            blockdescriptor = self.mm2tuned.dstdescriptor
+            H2_mm = blockdescriptor.zeros(dtype=dtype)
+            S2_mm = blockdescriptor.zeros(dtype=dtype)
+            self.mm2tuned.redistribute(H_mm, H2_mm)
+            self.mm2tuned.redistribute(S_mm, S2_mm)
+            H_mm = H2_mm
+            S_mm = S2_mm
+            mm2nM = self.tuned2nM
+
         C_mm = blockdescriptor.zeros(dtype=dtype)
         self.timer.start('General diagonalize')
-        # general_diagonalize_ex may have a buffer overflow, so
-        # we no longer use it
-        # blockdescriptor.general_diagonalize_ex(H_mm, S_mm.copy(), C_mm, eps_M,
-        #                                        UL='L', iu=self.bd.nbands)
-        blockdescriptor.general_diagonalize_dc(H_mm, S_mm.copy(), C_mm, eps_M,
-                                               UL='L')
+        self._solve(blockdescriptor, H_mm, S_mm, C_mm, eps_M)
         self.timer.stop('General diagonalize')
- 
+
         # Make C_nM compatible with the redistributor
         self.timer.start('Redistribute coefs')
         if outdescriptor:
@@ -358,7 +541,7 @@ class BlacsOrbitalLayouts(BlacsLayouts):
         else:
             C2_nM = outdescriptor.empty(dtype=dtype)
         assert outdescriptor.check(C2_nM)
-        self.mm2nM.redistribute(C_mm, C2_nM, subM, subN) #blocks2cols
+        mm2nM.redistribute(C_mm, C2_nM, subM, subN) #blocks2cols
         self.timer.stop('Redistribute coefs')
 
         self.timer.start('Send coefs to domains')
@@ -404,16 +587,40 @@ class BlacsOrbitalLayouts(BlacsLayouts):
         return self.mmdescriptor.shape
 
     def calculate_density_matrix(self, f_n, C_nM, rho_mM=None):
-        nbands = self.bd.nbands
-        mynbands = self.bd.mynbands
-        nao = self.nao
-        
-        if rho_mM is None:
-            rho_mM = self.mMdescriptor.zeros(dtype=C_nM.dtype)
-        
+        """Calculate density matrix from occupations and coefficients.
+
+        The product C^dagger f C runs distributed on the 2D block grid,
+        so all ranks share the O(nao^2 nbands) work; only the final
+        rows are gathered back into the column layout that
+        construct_density and the atomic corrections need."""
+        dtype = C_nM.dtype
+
         Cf_nM = (C_nM * f_n[:, None]).conj()
-        pblas_simple_gemm(self.nMdescriptor, self.nMdescriptor,
-                          self.mMdescriptor, Cf_nM, C_nM, rho_mM, transa='T')
+        coldesc = self.nM_unique_descriptor
+        if not coldesc: # XXX ugly way to sort out inactive ranks
+            C_nM = coldesc.zeros(dtype=dtype)
+            Cf_nM = coldesc.zeros(dtype=dtype)
+
+        C_nm = self.nmdescriptor.zeros(dtype=dtype)
+        Cf_nm = self.nmdescriptor.zeros(dtype=dtype)
+        self.nM2nm.redistribute(C_nM, C_nm)
+        self.nM2nm.redistribute(Cf_nM, Cf_nm)
+
+        rho_mm = self.mmdescriptor.zeros(dtype=dtype)
+        pblas_gemm(1.0, Cf_nm, C_nm, 0.0, rho_mm,
+                   self.nmdescriptor, self.nmdescriptor, self.mmdescriptor,
+                   transa='T')
+
+        # Gather the rows of my band group on the grid masters and
+        # share them with the rest of the domain:
+        if rho_mM is None:
+            rho_mM = self.mMdescriptor.zeros(dtype=dtype)
+        if coldesc:
+            rhou_mM = rho_mM
+        else:
+            rhou_mM = self.mM_unique_descriptor.zeros(dtype=dtype)
+        self.mm2mM.redistribute(rho_mm, rhou_mM)
+        self.gd.comm.broadcast(rho_mM, 0)
         return rho_mM
 
     def get_transposed_density_matrix(self, f_n, C_nM, rho_mM=None):
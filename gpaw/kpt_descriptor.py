@@ -66,11 +66,22 @@ class KPointDescriptor:
         self.weight_k = None
         self.nibzkpts = None
 
-        self.rank0 = None
         self.mynks = None
         self.ks0 = None
         self.ibzk_qc = None
 
+        # Cost model for the distribution over kpt_comm (one entry per
+        # ks-pair) and accumulated per-kpt iteration times:
+        self.cost_ks = None
+        self.mytime_u = None
+        self.count_r = None
+        self.offset_r = None
+
+        # Cache of per-(k-point, axis, direction) phase factors, keyed
+        # by the k-point coordinates (see initialize_phases):
+        self.sdisp_cd = None
+        self.phase_cache = {}
+
     def __len__(self):
         """Return number of k-point/spin combinations of local CPU."""
         
@@ -132,26 +143,148 @@ class KPointDescriptor:
     def set_communicator(self, comm):
         """Set k-point communicator."""
 
-        # Ranks < self.rank0 have mynks0 k-point/spin combinations and
-        # ranks >= self.rank0 have mynks0+1 k-point/spin combinations.
-        mynks0, x = divmod(self.nks, comm.size)
-        self.rank0 = comm.size - x
         self.comm = comm
 
+        # Each rank gets a contiguous chunk of ks-pairs; the chunk
+        # boundaries follow the cost model (uniform by default, so the
+        # counts differ by at most one as before):
+        if self.cost_ks is None:
+            cost_ks = np.ones(self.nks)
+        else:
+            cost_ks = self.cost_ks
+        self.count_r, self.offset_r = self.partition(cost_ks)
+        self.distribute()
+
+    def partition(self, cost_ks):
+        """Split the ks-pairs into contiguous chunks of near-equal cost.
+
+        Returns the number of ks-pairs and the offset of the first one
+        for every rank of the k-point communicator."""
+
+        size = self.comm.size
+        cum_ks = np.cumsum(cost_ks)
+        total = cum_ks[-1]
+        count_r = np.zeros(size, dtype=int)
+        offset_r = np.zeros(size, dtype=int)
+        b = 0
+        for r in range(size - 1):
+            # Ideal cumulative cost after this rank's chunk:
+            t = total * (r + 1.0) / size
+            c = int(np.searchsorted(cum_ks, t))
+            if c < self.nks:
+                below = t - (cum_ks[c - 1] if c > 0 else 0.0)
+                if cum_ks[c] - t < below:
+                    c += 1
+            c = max(c, b)
+            if self.nks >= size:
+                # However lopsided the costs, never leave a rank
+                # without any ks-pair:
+                c = max(c, b + 1)
+                c = min(c, self.nks - (size - 1 - r))
+            offset_r[r] = b
+            count_r[r] = c - b
+            b = c
+        offset_r[size - 1] = b
+        count_r[size - 1] = self.nks - b
+        return count_r, offset_r
+
+    def distribute(self):
+        """Update the local view of the current distribution."""
+
         # My number and offset of k-point/spin combinations
         self.mynks, self.ks0 = self.get_count(), self.get_offset()
 
-        if self.nspins == 2 and comm.size == 1:
+        if self.nspins == 2 and self.comm.size == 1:
             # Avoid duplicating k-points in local list of k-points.
             self.ibzk_qc = self.ibzk_kc.copy()
         else:
             self.ibzk_qc = np.vstack((self.ibzk_kc,
                                       self.ibzk_kc))[self.get_slice()]
 
+    def set_costs(self, cost_ks):
+        """Set the cost model (one entry per ks-pair).
+
+        Takes effect on the next set_communicator/rebalance call; the
+        symmetry weights or measured iteration times are the natural
+        inputs."""
+
+        assert len(cost_ks) == self.nks
+        self.cost_ks = np.asarray(cost_ks, float)
+
+    def register_time(self, myu, t):
+        """Accumulate measured iteration time for a local ks-pair."""
+
+        if self.mytime_u is None:
+            self.mytime_u = np.zeros(self.mynks)
+        self.mytime_u[myu] += t
+
+    def rebalance(self):
+        """Repartition the ks-pairs from the measured iteration times.
+
+        Collective over the k-point communicator.  Returns True if the
+        distribution changed - the caller is then responsible for
+        redistributing its k-point data (see
+        WaveFunctions.rebalance_kpoints)."""
+
+        if self.mytime_u is None:
+            self.mytime_u = np.zeros(self.mynks)
+        cost_ks = np.zeros(self.nks)
+        cost_ks[self.ks0:self.ks0 + self.mynks] = self.mytime_u
+        self.comm.sum(cost_ks)
+        self.mytime_u = None
+        if not cost_ks.any():
+            # Nobody measured anything (an eigensolver that does not
+            # feed the cost model):
+            return False
+        self.cost_ks = cost_ks
+        old_count_r = self.count_r
+        self.count_r, self.offset_r = self.partition(cost_ks)
+        if (self.count_r == old_count_r).all():
+            return False
+        self.distribute()
+        return True
+
+    def initialize_phases(self, sdisp_cd):
+        """Precompute the phase factors for all irreducible k-points.
+
+        sdisp_cd are the scaled displacements of the domain neighbors
+        (gd.sdisp_cd).  The phases exp(2j pi sdisp_cd k_c) expanded per
+        (k-point, axis, direction) are cached here and shared by the
+        stencil operators, transformers and LFC objects through
+        get_phases(), instead of being re-evaluated every time a
+        k-point loop re-enters.  Phases for other k-points (e.g. the
+        full BZ vectors of the response code) are cached on first use."""
+
+        if (self.sdisp_cd is not None and
+            self.sdisp_cd.shape == sdisp_cd.shape and
+            (self.sdisp_cd == sdisp_cd).all()):
+            return
+        self.sdisp_cd = sdisp_cd.copy()
+        self.phase_cache = {}
+        if self.ibzk_kc is not None:
+            for k_c in self.ibzk_kc:
+                self.get_phases(k_c)
+
+    def get_phases(self, k_c):
+        """Return the cached (3, 2) phase_cd array for a k-point."""
+
+        k_c = np.asarray(k_c, dtype=float)
+        key = tuple(k_c.round(10))
+        phase_cd = self.phase_cache.get(key)
+        if phase_cd is None:
+            if not k_c.any():
+                phase_cd = np.ones((3, 2), complex)
+            else:
+                phase_cd = np.exp(2j * np.pi *
+                                  self.sdisp_cd * k_c[:, np.newaxis])
+            phase_cd.flags.writeable = False
+            self.phase_cache[key] = phase_cd
+        return phase_cd
+
     def create_k_points(self, gd):
         """Return a list of KPoints."""
- 
-        sdisp_cd = gd.sdisp_cd
+
+        self.initialize_phases(gd.sdisp_cd)
 
         kpt_u = []
 
@@ -159,11 +292,7 @@ class KPointDescriptor:
             s, k = divmod(ks, self.nibzkpts)
             q = (ks - self.ks0) % self.nibzkpts
             weight = self.weight_k[k] * 2 / self.nspins
-            if self.gamma:
-                phase_cd = np.ones((3, 2), complex)
-            else:
-                phase_cd = np.exp(2j * np.pi *
-                                  sdisp_cd * self.ibzk_kc[k, :, np.newaxis])
+            phase_cd = self.get_phases(self.ibzk_kc[k])
             kpt_u.append(KPoint(weight, s, k, q, phase_cd))
 
         return kpt_u
@@ -190,20 +319,59 @@ class KPointDescriptor:
         else:
             ik = self.kibz_k[k]
             kibz_c = self.ibzk_kc[ik]
-            kbz_c = self.bzk_kc[k]            
-            import _gpaw
-            b_g = np.zeros_like(psit_G)
+            kbz_c = self.bzk_kc[k]
+            b_g = np.empty_like(psit_G)
             if time_reversal:
                 # assert abs(np.dot(op_cc, kibz_c) - -kbz_c) < tol
-                _gpaw.symmetrize_wavefunction(psit_G, b_g, op_cc.copy(),
-                                              kibz_c, -kbz_c)
+                index_G, phase_G = self.symmetry.get_wavefunction_index_map(
+                    op_cc, kibz_c, -kbz_c, psit_G.shape)
+                b_g.ravel()[index_G] = psit_G.ravel() * phase_G
                 return b_g.conj()
             else:
                 # assert abs(np.dot(op_cc, kibz_c) - kbz_c) < tol
-                _gpaw.symmetrize_wavefunction(psit_G, b_g, op_cc.copy(),
-                                              kibz_c, kbz_c)
+                index_G, phase_G = self.symmetry.get_wavefunction_index_map(
+                    op_cc, kibz_c, kbz_c, psit_G.shape)
+                b_g.ravel()[index_G] = psit_G.ravel() * phase_G
                 return b_g
 
+    def transform_wave_functions(self, psit_nG, k, out_nG=None):
+        """Transform a stack of wave functions from IBZ to BZ.
+
+        Same as transform_wave_function for each band, but the index
+        map and phases of the (symmetry operation, k-point) pair are
+        set up once and every band is a single gather through them."""
+
+        s = self.sym_k[k]
+        time_reversal = self.time_reversal_k[k]
+        op_cc = np.linalg.inv(self.symmetry.op_scc[s]).round().astype(int)
+
+        if out_nG is None:
+            out_nG = np.empty_like(psit_nG)
+
+        # Identity
+        if (np.abs(op_cc - np.eye(3, dtype=int)) < 1e-10).all():
+            if time_reversal:
+                np.conjugate(psit_nG, out_nG)
+            else:
+                out_nG[:] = psit_nG
+        # Inversion symmetry
+        elif (np.abs(op_cc + np.eye(3, dtype=int)) < 1e-10).all():
+            np.conjugate(psit_nG, out_nG)
+        # General point group symmetry
+        else:
+            ik = self.kibz_k[k]
+            kibz_c = self.ibzk_kc[ik]
+            kbz_c = self.bzk_kc[k]
+            if time_reversal:
+                kbz_c = -kbz_c
+            index_G, phase_G = self.symmetry.get_wavefunction_index_map(
+                op_cc, kibz_c, kbz_c, psit_nG.shape[1:])
+            b_nG = out_nG.reshape((len(psit_nG), -1))
+            b_nG[:, index_G] = psit_nG.reshape((len(psit_nG), -1)) * phase_G
+            if time_reversal:
+                np.conjugate(out_nG, out_nG)
+        return out_nG
+
     def find_k_plus_q(self, q_c):
         """Find the indices of k+q for all kpoints in the Brillouin zone.
 
@@ -308,11 +476,7 @@ class KPointDescriptor:
         if rank is None:
             rank = self.comm.rank
         assert rank in xrange(self.comm.size)
-        mynks0 = self.nks // self.comm.size
-        mynks = mynks0
-        if rank >= self.rank0:
-            mynks += 1
-        return mynks
+        return int(self.count_r[rank])
 
     def get_offset(self, rank=None):
         """Return the offset of the first ks-pair on a given rank."""
@@ -320,11 +484,7 @@ class KPointDescriptor:
         if rank is None:
             rank = self.comm.rank
         assert rank in xrange(self.comm.size)
-        mynks0 = self.nks // self.comm.size
-        ks0 = rank * mynks0
-        if rank >= self.rank0:
-            ks0 += rank - self.rank0
-        return ks0
+        return int(self.offset_r[rank])
 
     def get_rank_and_index(self, s, k):
         """Find rank and local index of k-point/spin combination."""
@@ -362,17 +522,15 @@ class KPointDescriptor:
     def who_has(self, u):
         """Convert global index to rank information and local index."""
 
-        mynks0 = self.nks // self.comm.size
-        if u < mynks0 * self.rank0:
-            rank, myu = divmod(u, mynks0)
-        else:
-            rank, myu = divmod(u - mynks0 * self.rank0, mynks0 + 1)
-            rank += self.rank0
+        # Last rank whose offset is not beyond u (empty ranks share
+        # their offset with the owning rank but come first):
+        rank = int(np.searchsorted(self.offset_r, u, side='right')) - 1
+        myu = u - int(self.offset_r[rank])
         return rank, myu
 
     def global_index(self, myu, rank=None):
         """Convert rank information and local index to global index."""
-        
+
         if rank is None:
             rank = self.comm.rank
         assert rank in xrange(self.comm.size)
@@ -382,7 +540,7 @@ class KPointDescriptor:
 
     def what_is(self, u):
         """Convert global index to corresponding kpoint/spin combination."""
-        
+
         s, k = divmod(u, self.nibzkpts)
         return s, k
 
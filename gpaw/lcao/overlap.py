@@ -130,6 +130,10 @@ class BaseOverlapExpansionSet:
     def zeros(self, shape=(), dtype=float):
         return np.zeros(shape + self.shape, dtype=dtype)
 
+    def evaluate_slices(self, disp_p, x):
+        for disp in disp_p:
+            self.evaluate_slice(disp, x)
+
 
 class OverlapExpansion(BaseOverlapExpansionSet):
     """A list of real-space splines representing an overlap integral."""
@@ -166,6 +170,22 @@ class OverlapExpansion(BaseOverlapExpansionSet):
             x_mi += spline(r) * np.dot(G_mmm, rlY_lm[l])
         return x_mi
 
+    def evaluate_batch(self, r_p, rlY_pL):
+        """Get overlaps between localized functions for many displacements.
+
+        Same as evaluate(), but for a whole batch of displacement
+        vectors at once: the radial parts are evaluated by one C call
+        per spline and the Gaunt contraction becomes one matrix
+        product per l, rather than paying the Python overhead for
+        every pair."""
+        x_pmi = np.zeros((len(r_p),) + self.shape)
+        for l, spline, G_mmm in self.gaunt_iter():
+            GrlY_px = np.dot(rlY_pL[:, l**2:(l + 1)**2],
+                             G_mmm.transpose(2, 0, 1).reshape(2 * l + 1, -1))
+            x_pmi += (spline.map(r_p)[:, np.newaxis] *
+                      GrlY_px).reshape(x_pmi.shape)
+        return x_pmi
+
     def derivative(self, r, Rhat_c, rlY_lm, drlYdR_lmc):
         """Get derivative of overlap between localized functions.
 
@@ -206,6 +226,12 @@ class TwoSiteOverlapExpansions(BaseOverlapExpansionSet):
             x_mm += oe.evaluate(r, rlY_lm)
         return x_MM
 
+    def evaluate_batch(self, r_p, rlY_pL):
+        x_pMM = self.zeros((len(r_p),))
+        for x_pmm, oe in self.slice(x_pMM):
+            x_pmm += oe.evaluate_batch(r_p, rlY_pL)
+        return x_pMM
+
     def derivative(self, r, Rhat, rlY_lm, drlYdR_lmc):
         x_cMM = self.zeros((3,))
         for x_cmm, oe in self.slice(x_cMM):
@@ -252,6 +278,31 @@ class ManySiteOverlapExpansions(BaseOverlapExpansionSet):
         x_qxmm, oe = self.getslice(disp.a1, disp.a2, x_qxMM)
         disp.evaluate_overlap(oe, x_qxmm)
 
+    def evaluate_slices(self, disp_p, x_qxMM):
+        """Evaluate a whole list of displacements, batched by species.
+
+        Displacements whose atoms are of the same two types share
+        expansion tables, so their radial and angular parts can be
+        evaluated together with a few large array operations instead
+        of many small ones per pair.  Only the final scattering into
+        the matrix, with phases, is done pair by pair."""
+        if len(disp_p) > 0 and disp_p[0].factory.derivative:
+            BaseOverlapExpansionSet.evaluate_slices(self, disp_p, x_qxMM)
+            return
+        dispgroups_II = {}
+        for disp in disp_p:
+            key = (self.I1_a[disp.a1], self.I2_a[disp.a2])
+            dispgroups_II.setdefault(key, []).append(disp)
+        for (I1, I2), dispgroup in dispgroups_II.items():
+            tsoe = self.tsoe_II[I1, I2]
+            r_p = np.array([disp.r for disp in dispgroup])
+            rlY_pL = np.array([np.concatenate(disp.rlY_lm)
+                               for disp in dispgroup])
+            x_pMM = tsoe.evaluate_batch(r_p, rlY_pL)
+            for disp, x_MM in zip(dispgroup, x_pMM):
+                x_qxmm = self.getslice(disp.a1, disp.a2, x_qxMM)[0]
+                disp.phases.apply(x_MM, x_qxmm)
+
 
 class DomainDecomposedExpansions(BaseOverlapExpansionSet):
     def __init__(self, msoe, local_indices):
@@ -263,6 +314,11 @@ class DomainDecomposedExpansions(BaseOverlapExpansionSet):
         if disp.a2 in self.local_indices:
             self.msoe.evaluate_slice(disp, x_xqMM)
 
+    def evaluate_slices(self, disp_p, x_xqMM):
+        self.msoe.evaluate_slices([disp for disp in disp_p
+                                   if disp.a2 in self.local_indices],
+                                  x_xqMM)
+
 class ManySiteDictionaryWrapper(DomainDecomposedExpansions):
     # Used with dictionaries such as P_aqMi and dPdR_aqcMi
     # Works only with NeighborPairs, not SimpleAtomIter, since it
@@ -284,6 +340,11 @@ class ManySiteDictionaryWrapper(DomainDecomposedExpansions):
             rdisp = disp.reverse()
             rdisp.evaluate_overlap(oe2, x2_qxmi)
 
+    def evaluate_slices(self, disp_p, x_aqxMi):
+        # Dictionaries and the reversed pairs do not fit the batched
+        # slicing; take the pairs one by one.
+        BaseOverlapExpansionSet.evaluate_slices(self, disp_p, x_aqxMi)
+
 class BlacsOverlapExpansions(BaseOverlapExpansionSet):
     def __init__(self, msoe, local_indices, Mmystart, mynao):
         self.msoe = msoe
@@ -332,6 +393,100 @@ class BlacsOverlapExpansions(BaseOverlapExpansionSet):
             # it in the first place
             self.evaluate_slice(disp.reverse(), x_xqNM)
             
+class SparseOverlapExpansions(BaseOverlapExpansionSet):
+    """Sparse assembly of an overlap expansion as atom-pair blocks.
+
+    Basis functions on atoms farther apart than the sum of their
+    cutoffs never overlap, so for large systems only a small fraction
+    of the nao x nao matrix is nonzero.  Instead of scattering into a
+    dense array, each evaluated displacement is accumulated into a
+    dictionary mapping (a1, a2) to a (nq, m1, m2) block; the pair
+    iteration supplies a1 >= a2 only, like the dense lower-triangle
+    fill.  astart/aend restrict assembly to pairs touching a local
+    range of atoms, so the blocks can be distributed by atom ranges."""
+
+    def __init__(self, msoe, nq, dtype, astart=0, aend=None):
+        self.msoe = msoe
+        self.nq = nq
+        self.dtype = dtype
+        self.astart = astart
+        if aend is None:
+            aend = len(msoe.M1_a)
+        self.aend = aend
+        BaseOverlapExpansionSet.__init__(self, msoe.shape)
+
+    def evaluate_slice(self, disp, x_pqmm):
+        a1 = disp.a1
+        a2 = disp.a2
+        if not (self.astart <= a1 < self.aend or
+                self.astart <= a2 < self.aend):
+            return
+        msoe = self.msoe
+        tsoe = msoe.tsoe_II[msoe.I1_a[a1], msoe.I2_a[a2]]
+        x_qmm = x_pqmm.get((a1, a2))
+        if x_qmm is None:
+            x_qmm = tsoe.zeros((self.nq,), dtype=self.dtype)
+            x_pqmm[(a1, a2)] = x_qmm
+        disp.evaluate_overlap(tsoe, x_qmm)
+
+    def finalize(self, x_pqmm):
+        """Hermitize diagonal blocks and mirror the block triangle.
+
+        Does at the block level what tri2full does to the dense
+        matrices, then drops blocks whose row atom is outside the
+        local range."""
+        for (a1, a2), x_qmm in x_pqmm.items():
+            if a1 == a2:
+                for x_mm in x_qmm:
+                    tri2full(x_mm, UL=UL)
+            else:
+                x_pqmm[(a2, a1)] = x_qmm.transpose(0, 2, 1).conj().copy()
+        for a1, a2 in x_pqmm.keys():
+            if not (self.astart <= a1 < self.aend):
+                del x_pqmm[(a1, a2)]
+
+
+def sparse_to_csr(x_pqmm, M_a, nao, q=0):
+    """Compress atom-pair blocks to one CSR matrix for a single q.
+
+    M_a holds the first basis function index of each atom and nao the
+    total number of basis functions.  Returns (data, indices, indptr)
+    as plain arrays following the usual compressed-sparse-row
+    convention, so callers are free to hand them to scipy.sparse.
+    Atoms outside the assembled row range simply yield empty rows."""
+    natoms = len(M_a)
+    nM_a = np.empty(natoms, int)
+    nM_a[:-1] = np.diff(M_a)
+    nM_a[-1] = nao - M_a[-1]
+
+    dtype = float
+    a2_ap = {}
+    for (a1, a2), x_qmm in x_pqmm.items():
+        a2_ap.setdefault(a1, []).append(a2)
+        dtype = x_qmm.dtype
+
+    ncol_M = np.zeros(nao, int)
+    for a1, a2_p in a2_ap.items():
+        a2_p.sort()
+        ncols = sum([nM_a[a2] for a2 in a2_p])
+        ncol_M[M_a[a1]:M_a[a1] + nM_a[a1]] = ncols
+
+    indptr = np.zeros(nao + 1, int)
+    indptr[1:] = np.cumsum(ncol_M)
+    data = np.empty(indptr[nao], dtype)
+    indices = np.empty(indptr[nao], int)
+
+    for a1, a2_p in a2_ap.items():
+        for m in range(nM_a[a1]):
+            i = indptr[M_a[a1] + m]
+            for a2 in a2_p:
+                n = nM_a[a2]
+                indices[i:i + n] = np.arange(M_a[a2], M_a[a2] + n)
+                data[i:i + n] = x_pqmm[(a1, a2)][q, m]
+                i += n
+    return data, indices, indptr
+
+
 class SimpleAtomIter:
     def __init__(self, cell_cv, spos1_ac, spos2_ac, offsetsteps=0):
         self.cell_cv = cell_cv
@@ -591,6 +746,25 @@ class BlochPhases:
     def inverse(self):
         return BlochPhases(-self.ibzk_qc, self.offset)
 
+# Species-pair expansion tables depend only on the setups and their
+# basis functions, not on positions or cell, so they are kept here for
+# the lifetime of the process and shared between calculators.  Without
+# this, anything that reinitializes the wave functions (one calculator
+# per trajectory image, a cell change during relaxation, ...) re-pays
+# the Fourier transforms of all spline pairs on every geometry step.
+_tsoe_cache = {}
+
+
+def setup_expansion_key(setup):
+    """Identity of one species in the expansion-table cache."""
+    basis = getattr(setup, 'basis', None)
+    name = getattr(basis, 'name', None)
+    if basis is not None and name is None:
+        name = id(basis)
+    return (setup.symbol, getattr(setup, 'type', None),
+            getattr(setup, 'fingerprint', None), name)
+
+
 class TwoCenterIntegralCalculator:
     # This class knows how to apply phases, and whether to call the
     # various derivative() or evaluate() methods
@@ -609,9 +783,9 @@ class TwoCenterIntegralCalculator:
         self.derivative = derivative
 
     def calculate(self, atompairs, expansions, arrays):
-        for disp in self.iter(atompairs):
-            for expansion, X_qxMM in zip(expansions, arrays):
-                expansion.evaluate_slice(disp, X_qxMM)
+        disp_p = list(self.iter(atompairs))
+        for expansion, X_qxMM in zip(expansions, arrays):
+            expansion.evaluate_slices(disp_p, X_qxMM)
 
     def iter(self, atompairs):
         for a1, a2, R_c, offset in atompairs.iter():
@@ -654,9 +828,9 @@ class NewTwoCenterIntegrals:
         cutoff_close_a = [covalent_radii[s.Z] / Bohr / 2. for s in setups]
         self.atoms_close = NeighborPairs(cutoff_close_a, cell_cv, pbc_c, False)
 
-        rcmax = max(cutoff_I + [0.001])
+        self.rcmax = rcmax = max(cutoff_I + [0.001])
 
-        ng = 2**extra_parameters.get('log2ng', 10)
+        self.ng = ng = 2**extra_parameters.get('log2ng', 10)
         transformer = FourierTransformer(rcmax, ng)
         tsoc = TwoSiteOverlapCalculator(transformer)
         self.msoc = ManySiteOverlapCalculator(tsoc, I_a, I_a)
@@ -674,13 +848,29 @@ class NewTwoCenterIntegrals:
         self.blacs = mynao is not None
         
     def calculate_expansions(self):
+        # The expensive species-pair tables are position independent;
+        # reuse cached ones and rebuild only the cheap per-atom
+        # indexing when this species combination has been seen before:
+        key = (self.ng, self.rcmax,
+               tuple([setup_expansion_key(setup)
+                      for setup in self.setups_I]))
+        tsoe = _tsoe_cache.get(key)
+        if tsoe is not None:
+            (self.Theta_expansions,
+             self.T_expansions,
+             self.P_expansions) = [ManySiteOverlapExpansions(tsoe_II,
+                                                             self.I_a,
+                                                             self.I_a)
+                                   for tsoe_II in tsoe]
+            return
+
         phit_Ij = [setup.phit_j for setup in self.setups_I]
         l_Ij = []
         for phit_j in phit_Ij:
             l_Ij.append([phit.get_angular_momentum_number()
                          for phit in phit_j])
-        
-        pt_l_Ij = [setup.l_j for setup in self.setups_I]        
+
+        pt_l_Ij = [setup.l_j for setup in self.setups_I]
         pt_Ij = [setup.pt_j for setup in self.setups_I]
         phit_Ijq = self.msoc.transform(phit_Ij)
         pt_Ijq = self.msoc.transform(pt_Ij)
@@ -692,6 +882,9 @@ class NewTwoCenterIntegrals:
         self.T_expansions = msoc.calculate_kinetic_expansions(l_Ij, phit_Ijq)
         self.P_expansions = msoc.calculate_expansions(l_Ij, phit_Ijq,
                                                       pt_l_Ij, pt_Ijq)
+        _tsoe_cache[key] = (self.Theta_expansions.tsoe_II,
+                            self.T_expansions.tsoe_II,
+                            self.P_expansions.tsoe_II)
 
     def _calculate(self, calc, spos_ac, Theta_qxMM, T_qxMM, P_aqxMi):
         for X_xMM in [Theta_qxMM, T_qxMM] + P_aqxMi.values():
@@ -735,6 +928,38 @@ class NewTwoCenterIntegrals:
             for X_MM in list(Theta_qMM) + list(T_qMM):
                 tri2full(X_MM, UL=UL)
 
+    def evaluate_sparse(self, spos_ac, astart=0, aend=None):
+        """Evaluate overlap and kinetic matrices as atom-pair blocks.
+
+        Returns (Theta_pqmm, T_pqmm, M_a): dictionaries mapping atom
+        pairs (a1, a2) to (nq, m1, m2) blocks, and the first basis
+        function index of each atom.  Only blocks whose row atom lies
+        in [astart, aend) are kept, so large matrices can be assembled
+        distributed by atom ranges; sparse_to_csr() compresses the
+        blocks of one q to ordinary CSR arrays.  The dense evaluate()
+        path stays in place for small systems, where the neighbor-list
+        bookkeeping is not worth it."""
+        if self.gamma:
+            dtype = float
+        else:
+            dtype = complex
+        nq = len(self.ibzk_qc)
+
+        self.atompairs.set_positions(spos_ac)
+
+        expansions = [SparseOverlapExpansions(self.Theta_expansions,
+                                              nq, dtype, astart, aend),
+                      SparseOverlapExpansions(self.T_expansions,
+                                              nq, dtype, astart, aend)]
+        Theta_pqmm = {}
+        T_pqmm = {}
+        calc = TwoCenterIntegralCalculator(self.ibzk_qc, derivative=False)
+        calc.calculate(OppositeDirection(self.atompairs), expansions,
+                       [Theta_pqmm, T_pqmm])
+        for expansion, x_pqmm in zip(expansions, [Theta_pqmm, T_pqmm]):
+            expansion.finalize(x_pqmm)
+        return Theta_pqmm, T_pqmm, list(self.Theta_expansions.M1_a)
+
     def derivative(self, spos_ac, dThetadR_qcMM, dTdR_qcMM, dPdR_aqcMi):
         calc = TwoCenterIntegralCalculator(self.ibzk_qc, derivative=True)
         self._calculate(calc, spos_ac, dThetadR_qcMM, dTdR_qcMM, dPdR_aqcMi)
@@ -271,8 +271,14 @@ class NewLocalizedFunctionsCollection(BaseLFC):
         self.atom_indices = []
         M = 0
         self.M_a = []
+        # Global M-offsets (all atoms, same on every rank) for the
+        # packed integrate() reduction:
+        Mglobal = 0
+        self.Mglobal_a = []
         for a, sphere in enumerate(self.sphere_a):
             self.M_a.append(M)
+            self.Mglobal_a.append(Mglobal)
+            Mglobal += sphere.Mmax
             if sphere.rank == self.gd.comm.rank:
                 self.my_atom_indices.append(a)
             G_wb = sphere.G_wb
@@ -288,6 +294,7 @@ class NewLocalizedFunctionsCollection(BaseLFC):
                 M += sphere.Mmax
 
         self.Mmax = M
+        self.Mglobalmax = Mglobal
 
         natoms = len(spos_ac)
         # Holm-Nielsen check:
@@ -339,6 +346,15 @@ class NewLocalizedFunctionsCollection(BaseLFC):
         self.lfc = _gpaw.LFC(self.A_Wgm, self.M_W, self.G_B, self.W_B,
                              self.gd.dv, self.phase_qW)
 
+        # Per-function spline table for the derivative kernels.  It only
+        # depends on the atom order, so derive it here - when atoms
+        # actually moved - instead of on every kernel call:
+        self.cspline_M = []
+        for a in self.atom_indices:
+            for spline in self.sphere_a[a].spline_j:
+                nm = 2 * spline.get_angular_momentum_number() + 1
+                self.cspline_M.extend([spline.spline] * nm)
+
         # Find out which ranks have a piece of the
         # localized functions:
         x_a = np.zeros(natoms, bool)
@@ -495,11 +511,7 @@ class NewLocalizedFunctionsCollection(BaseLFC):
             for c_xi in c_axi.values():
                 assert c_xi.dtype == dtype
 
-        cspline_M = []
-        for a_ in self.atom_indices:
-            for spline in self.sphere_a[a_].spline_j:
-                nm = 2 * spline.get_angular_momentum_number() + 1
-                cspline_M.extend([spline.spline] * nm)
+        cspline_M = self.cspline_M
 
         #Temp solution - set all coefficient to zero except for those at atom a
         # Coefficient indices for atom a
@@ -520,7 +532,45 @@ class NewLocalizedFunctionsCollection(BaseLFC):
         self.lfc.add_derivative(c_xM, a_xG, gd.h_cv, gd.n_c, cspline_M,
                                 gd.beg_c, self.pos_Wv, a, v, q)
 
-            
+    def add_derivatives(self, a_xG, c_axiv, q=-1):
+        """Add derivatives of all localized functions to extended arrays.
+
+        Fused version of add_derivative: one traversal of the grid adds
+        the contributions of all atoms and all three Cartesian
+        directions at once::
+
+                   --- ---  a      a
+          a (G) += >   >   c    dPhi  (G)
+           x       --- ---  xiv     iv
+                    a   iv
+
+        Atoms missing from the ``c_axiv`` dictionary contribute
+        nothing.
+        """
+
+        assert not self.use_global_indices
+
+        if q == -1:
+            assert self.dtype == float
+
+        dtype = a_xG.dtype
+
+        cspline_M = self.cspline_M
+
+        xshape = a_xG.shape[:-3]
+        c_xMv = np.zeros(xshape + (self.Mmax, 3), dtype)
+        M1 = 0
+        for a in self.atom_indices:
+            M2 = M1 + self.sphere_a[a].Mmax
+            c_xiv = c_axiv.get(a)
+            if c_xiv is not None:
+                c_xMv[..., M1:M2, :] = c_xiv
+            M1 = M2
+
+        gd = self.gd
+        self.lfc.add_derivatives(c_xMv, a_xG, gd.h_cv, gd.n_c, cspline_M,
+                                 gd.beg_c, self.pos_Wv, q)
+
     def integrate(self, a_xG, c_axi, q=-1):
         """Calculate integrals of arrays times localized functions.
 
@@ -548,6 +598,27 @@ class NewLocalizedFunctionsCollection(BaseLFC):
         c_xM = np.zeros(xshape + (self.Mmax,), dtype)
         self.lfc.integrate(a_xG, c_xM, q)
 
+        if extra_parameters.get('packlfc'):
+            # With many atoms, one big summation beats thousands of
+            # small per-atom messages.  Scatter the contiguous local
+            # coefficients into a globally indexed array, reduce it in
+            # one call and let each owner pick out its blocks:
+            c_gxM = np.zeros(xshape + (self.Mglobalmax,), dtype)
+            M1 = 0
+            for a in self.atom_indices:
+                sphere = self.sphere_a[a]
+                M2 = M1 + sphere.Mmax
+                Mg = self.Mglobal_a[a]
+                c_gxM[..., Mg:Mg + sphere.Mmax] = c_xM[..., M1:M2]
+                M1 = M2
+            self.gd.comm.sum(c_gxM)
+            for a in self.my_atom_indices:
+                c_xi = c_axi.get(a)
+                if c_xi is not None:
+                    Mg = self.Mglobal_a[a]
+                    c_xi[:] = c_gxM[..., Mg:Mg + self.sphere_a[a].Mmax]
+            return
+
         comm = self.gd.comm
         rank = comm.rank
         srequests = []
@@ -590,6 +661,61 @@ class NewLocalizedFunctionsCollection(BaseLFC):
         for request in srequests:
             comm.wait(request)
 
+    def apply_overlap(self, dO_aii, a_xG, b_xG, q=-1):
+        """Apply the projector part of an overlap-like operator.
+
+        ::
+
+                            --     a     a       a
+          b (G) = a (G) +   >   Phi (G) dO   <Phi | a >
+           x       x        --     i      ij     j   x
+                            a,ij
+
+        dO_aii must be indexable by atom number for every atom whose
+        functions reach this domain.  The coefficient transform and
+        the final addition run fused in C with no per-atom Python
+        step; with domain decomposition the partial integrals are
+        completed with a single summation.
+        """
+        assert not self.use_global_indices
+        if q == -1:
+            assert self.dtype == float
+
+        xshape = a_xG.shape[:-3]
+        dtype = a_xG.dtype
+        b_xG[:] = a_xG
+
+        c_xM = np.zeros(xshape + (self.Mmax,), dtype)
+        self.lfc.integrate(a_xG, c_xM, q)
+
+        if self.gd.comm.size > 1:
+            # Complete the integrals of the functions that straddle
+            # domain boundaries (cf. the packed reduction in
+            # integrate):
+            c_gxM = np.zeros(xshape + (self.Mglobalmax,), dtype)
+            M1 = 0
+            for a in self.atom_indices:
+                sphere = self.sphere_a[a]
+                M2 = M1 + sphere.Mmax
+                Mg = self.Mglobal_a[a]
+                c_gxM[..., Mg:Mg + sphere.Mmax] = c_xM[..., M1:M2]
+                M1 = M2
+            self.gd.comm.sum(c_gxM)
+            M1 = 0
+            for a in self.atom_indices:
+                sphere = self.sphere_a[a]
+                M2 = M1 + sphere.Mmax
+                Mg = self.Mglobal_a[a]
+                c_xM[..., M1:M2] = c_gxM[..., Mg:Mg + sphere.Mmax]
+                M1 = M2
+
+        if len(self.atom_indices) > 0:
+            ni_b = np.array([self.sphere_a[a].Mmax
+                             for a in self.atom_indices])
+            dO_p = np.concatenate([dO_aii[a].ravel()
+                                   for a in self.atom_indices])
+            self.lfc.transform_add(c_xM, b_xG, ni_b, dO_p, q)
+
     def derivative(self, a_xG, c_axiv, q=-1):
         """Calculate x-, y-, and z-derivatives of localized function integrals.
 
@@ -631,11 +757,7 @@ class NewLocalizedFunctionsCollection(BaseLFC):
         xshape = a_xG.shape[:-3]
         c_xMv = np.zeros(xshape + (self.Mmax, 3), dtype)
         
-        cspline_M = []
-        for a in self.atom_indices:
-            for spline in self.sphere_a[a].spline_j:
-                nm = 2 * spline.get_angular_momentum_number() + 1
-                cspline_M.extend([spline.spline] * nm)
+        cspline_M = self.cspline_M
                 
         gd = self.gd
         self.lfc.derivative(a_xG, c_xMv, gd.h_cv, gd.n_c, cspline_M,
@@ -683,6 +805,87 @@ class NewLocalizedFunctionsCollection(BaseLFC):
         for request in srequests:
             comm.wait(request)
 
+    def integrate_and_derivative(self, a_xG, c_axi, c_axiv, q=-1):
+        """Calculate integrals and their derivatives in one grid sweep.
+
+        Fused version of integrate() followed by derivative() for the
+        same array: the grid is traversed once, the spline evaluations
+        are shared between the two results, and the per-atom
+        communication is done with a single message per atom.
+        """
+
+        assert not self.use_global_indices
+        assert self.integral_a is None
+        if q == -1:
+            assert self.dtype == float
+
+        if debug:
+            assert a_xG.ndim >= 3
+            assert (np.sort(c_axi.keys()) == self.my_atom_indices).all()
+            assert (np.sort(c_axiv.keys()) == self.my_atom_indices).all()
+
+        dtype = a_xG.dtype
+
+        xshape = a_xG.shape[:-3]
+        c_xM = np.zeros(xshape + (self.Mmax,), dtype)
+        c_xMv = np.zeros(xshape + (self.Mmax, 3), dtype)
+
+        gd = self.gd
+        self.lfc.integrate_and_derivative(a_xG, c_xM, c_xMv,
+                                          gd.h_cv, gd.n_c, self.cspline_M,
+                                          gd.beg_c, self.pos_Wv, q)
+
+        # Stack value and derivatives so that each atom needs only one
+        # message instead of two:
+        c_xMw = np.empty(xshape + (self.Mmax, 4), dtype)
+        c_xMw[..., 0] = c_xM
+        c_xMw[..., 1:] = c_xMv
+
+        comm = self.gd.comm
+        rank = comm.rank
+        srequests = []
+        rrequests = []
+        c_arxiw = {}
+        b_axiw = {}
+        M1 = 0
+        for a in self.atom_indices:
+            sphere = self.sphere_a[a]
+            M2 = M1 + sphere.Mmax
+            if sphere.rank != rank:
+                c_xiw = c_xMw[..., M1:M2, :].copy()
+                b_axiw[a] = c_xiw
+                srequests.append(comm.send(c_xiw,
+                                           sphere.rank, a, False))
+            else:
+                if len(sphere.ranks) > 0:
+                    c_rxiw = np.empty(sphere.ranks.shape + xshape +
+                                      (M2 - M1, 4), dtype)
+                    c_arxiw[a] = c_rxiw
+                    for r, b_xiw in zip(sphere.ranks, c_rxiw):
+                        rrequests.append(comm.receive(b_xiw, r, a, False))
+            M1 = M2
+
+        for request in rrequests:
+            comm.wait(request)
+
+        M1 = 0
+        for a in self.atom_indices:
+            c_xi = c_axi.get(a)
+            c_xiv = c_axiv.get(a)
+            sphere = self.sphere_a[a]
+            M2 = M1 + sphere.Mmax
+            if c_xi is not None:
+                if len(sphere.ranks) > 0:
+                    c_xiw = c_xMw[..., M1:M2, :] + c_arxiw[a].sum(axis=0)
+                else:
+                    c_xiw = c_xMw[..., M1:M2, :]
+                c_xi[:] = c_xiw[..., 0]
+                c_xiv[:] = c_xiw[..., 1:]
+            M1 = M2
+
+        for request in srequests:
+            comm.wait(request)
+
     def _normalized_derivative(self, a_G, c_aiv):
         """Calculate x-, y-, and z-derivatives of localized function integrals.
 
@@ -734,11 +937,7 @@ class NewLocalizedFunctionsCollection(BaseLFC):
 
         c_Mv = np.zeros((self.Mmax, 7))
 
-        cspline_M = []
-        for a in self.atom_indices:
-            for spline in self.sphere_a[a].spline_j:
-                nm = 2 * spline.get_angular_momentum_number() + 1
-                cspline_M.extend([spline.spline] * nm)
+        cspline_M = self.cspline_M
         gd = self.gd
         self.lfc.normalized_derivative(a_G, c_Mv, gd.h_cv, gd.n_c, cspline_M,
                                        gd.beg_c, self.pos_Wv)
@@ -1022,7 +1221,9 @@ class BasisFunctions(NewLocalizedFunctionsCollection):
             mu nu    |     dr             nu
                     /        c
 
-        Results are added to DVt_vMM.
+        Results are added to DVt_vMM.  All three derivative components
+        are evaluated in one sweep over the grid so that the spline
+        values and radial derivatives are shared between them.
         """
         cspline_M = []
         for a, sphere in enumerate(self.sphere_a):
@@ -1030,15 +1231,14 @@ class BasisFunctions(NewLocalizedFunctionsCollection):
                 nm = 2 * spline.get_angular_momentum_number() + 1
                 cspline_M.extend([spline.spline] * nm)
         gd = self.gd
-        for c in range(3): # XXX
-            self.lfc.calculate_potential_matrix_derivative(vt_G, DVt_vMM[c],
-                                                           gd.h_cv,
-                                                           gd.n_c, q, c,
-                                                           np.array(cspline_M),
-                                                           gd.beg_c,
-                                                           self.pos_Wv,
-                                                           self.Mstart,
-                                                           self.Mstop)
+        self.lfc.calculate_potential_matrix_derivatives(vt_G, DVt_vMM,
+                                                        gd.h_cv,
+                                                        gd.n_c, q,
+                                                        np.array(cspline_M),
+                                                        gd.beg_c,
+                                                        self.pos_Wv,
+                                                        self.Mstart,
+                                                        self.Mstop)
 
     # Python implementations:
     if 0:
@@ -37,6 +37,10 @@ class OmegaMatrix:
       - txt: output stream or file name
       - finegrid: level of fine grid to use. 0: nothing, 1 for poisson only,
         2 everything on the fine grid
+      - blocksize: number of matrix rows to assemble together. Each
+        pair density constructed in the inner loops serves a whole
+        block of rows and the Poisson equations of a block are solved
+        in one batch, at the price of blocksize grids of extra memory.
     """
     def __init__(self,
                  calculator=None,
@@ -48,6 +52,7 @@ class OmegaMatrix:
                  txt=None,
                  finegrid=2,
                  eh_comm=None,
+                 blocksize=4,
                  ):
         
         if not txt and calculator:
@@ -66,6 +71,7 @@ class OmegaMatrix:
 
         self.fullkss = kss
         self.finegrid = finegrid
+        self.blocksize = blocksize
 
         if calculator is None:
             return
@@ -137,6 +143,30 @@ class OmegaMatrix:
         self.eh_comm.sum(self.Om)
         self.full = self.Om
 
+    def pair_density_matrices(self):
+        """Packed pair density matrices of all transitions.
+
+        Returns a dictionary mapping every atom to a (nij, np) array
+        with pack(P_i P_j) of each Kohn-Sham single in its rows.
+        Building them once here lets the pair loops evaluate their
+        atomic corrections as matrix products over whole rows instead
+        of one outer product and pack call per matrix element."""
+
+        wfs = self.paw.wfs
+        kss = self.fullkss
+        nij = len(kss)
+
+        D_aqp = {}
+        for a, P_ni in wfs.kpt_u[kss[0].spin].P_ani.items():
+            ni = P_ni.shape[1]
+            D_aqp[a] = np.empty((nij, ni * (ni + 1) // 2))
+        for q in range(nij):
+            P_ani = wfs.kpt_u[kss[q].spin].P_ani
+            for a, D_qp in D_aqp.items():
+                P_ni = P_ani[a]
+                D_qp[q] = pack(np.outer(P_ni[kss[q].i], P_ni[kss[q].j]))
+        return D_aqp
+
     def get_xc(self):
         """Add xc part of the coupling matrix"""
 
@@ -208,21 +238,35 @@ class OmegaMatrix:
         ns=self.numscale
         xc=self.xc
         print >> self.txt, 'XC',nij,'transitions'
-        for ij in range(eh_comm.rank, nij, eh_comm.size):
-            print >> self.txt,'XC kss['+'%d'%ij+']' 
+
+        # packed pair density matrices and pole spins of all
+        # transitions, for batching the atomic corrections
+        D_aqp = self.pair_density_matrices()
+        pspin_q = np.array([ks.pspin for ks in kss])
+
+        # my rows come in blocks: the pair densities of the inner loop
+        # are integrated against the fxc potentials of a whole block
+        my_ij = range(eh_comm.rank, nij, eh_comm.size)
+        for b in range(0, len(my_ij), self.blocksize):
+            ij_b = my_ij[b:b + self.blocksize]
+            nb = len(ij_b)
+            for ij in ij_b:
+                print >> self.txt,'XC kss['+'%d'%ij+']'
 
             timer = Timer()
             timer.start('init')
             timer2 = Timer()
-                      
-            if self.derivativeLevel == 1:
-                # vxc is available
-                # We use the numerical two point formula for calculating
-                # the integral over fxc*n_ij. The results are
-                # vvt_s        smooth integral
-                # nucleus.I_sp atom based correction matrices (pack2)
-                #              stored on each nucleus
-                timer2.start('init v grids')
+
+            # vxc is available (the other derivative levels raised
+            # above).
+            # We use the numerical two point formula for calculating
+            # the integral over fxc*n_ij. The results are
+            # vvt_bs  smooth integrals of the block
+            # Exc_bq  atom based corrections, already contracted with
+            #         the density matrices of all columns
+            timer2.start('init v grids')
+            vvt_bs = np.zeros((nb,) + nt_s.shape, nt_s.dtype.char)
+            for bi, ij in enumerate(ij_b):
                 vp_s=np.zeros(nt_s.shape,nt_s.dtype.char)
                 vm_s=np.zeros(nt_s.shape,nt_s.dtype.char)
                 if kss.npspins == 2: # spin polarised
@@ -237,19 +281,18 @@ class OmegaMatrix:
                     xc.calculate(gd, nv, vp_s)
                     nv = nt_s - ns * kss[ij].get(fg)
                     xc.calculate(gd, nv, vm_s)
-                vvt_s = (0.5 / ns) * (vp_s - vm_s)
-                timer2.stop()
+                vvt_bs[bi] = (0.5 / ns) * (vp_s - vm_s)
+            timer2.stop()
 
-                # initialize the correction matrices
-                timer2.start('init v corrections')
-                I_asp = {}
-                for a, P_ni in wfs.kpt_u[kss[ij].spin].P_ani.items():
+            # initialize the correction matrices
+            timer2.start('init v corrections')
+            Exc_bq = np.zeros((nb, nij))
+            for bi, ij in enumerate(ij_b):
+                for a, D_qp in D_aqp.items():
                     # create the modified density matrix
-                    Pi_i = P_ni[kss[ij].i]
-                    Pj_i = P_ni[kss[ij].j]
-                    P_ii = np.outer(Pi_i, Pj_i)
-                    # we need the symmetric form, hence we can pack
-                    P_p = pack(P_ii)
+                    # (we need the symmetric form, hence D_qp is
+                    # packed; use pack as I_sp uses pack2)
+                    P_p = D_qp[ij]
                     D_sp = self.paw.density.D_asp[a].copy()
                     D_sp[kss[ij].pspin] -= ns * P_p
                     setup = wfs.setups[a]
@@ -260,110 +303,39 @@ class OmegaMatrix:
                     D_sp[kss[ij].pspin] += ns*P_p
                     setup.xc_correction.calculate(self.xc, D_sp, I_sp)
                     I_sp /= 2.0 * ns
-                    I_asp[a] = I_sp
-                timer2.stop()
-                    
+                    # contract with the density matrices of all columns
+                    Exc_sq = np.dot(I_sp, D_qp.T)
+                    Exc_bq[bi] += Exc_sq[pspin_q, np.arange(nij)]
+            self.gd.comm.sum(Exc_bq)
+            timer2.stop()
+
             timer.stop()
             t0 = timer.get_time('init')
-            timer.start(ij)
-            
-            for kq in range(ij,nij):
-                weight = self.weight_Kijkq(ij, kq)
-                
-                if self.derivativeLevel == 0:
-                    # only Exc is available
-                    
-                    if kss.npspins==2: # spin polarised
-                        nv_g = nt_sg.copy()
-                        nv_g[kss[ij].pspin] +=\
-                                        kss[ij].get(fg)
-                        nv_g[kss[kq].pspin] +=\
-                                        kss[kq].get(fg)
-                        Excpp = xc.get_energy_and_potential(\
-                                        nv_g[0],v_g,nv_g[1],v_g)
-                        nv_g = nt_sg.copy()
-                        nv_g[kss[ij].pspin] +=\
-                                        kss[ij].get(fg)
-                        nv_g[kss[kq].pspin] -= \
-                                        kss[kq].get(fg)
-                        Excpm = xc.get_energy_and_potential(\
-                                            nv_g[0],v_g,nv_g[1],v_g)
-                        nv_g = nt_sg.copy()
-                        nv_g[kss[ij].pspin] -=\
-                                        kss[ij].get(fg)
-                        nv_g[kss[kq].pspin] +=\
-                                        kss[kq].get(fg)
-                        Excmp = xc.get_energy_and_potential(\
-                                            nv_g[0],v_g,nv_g[1],v_g)
-                        nv_g = nt_sg.copy()
-                        nv_g[kss[ij].pspin] -= \
-                                        kss[ij].get(fg)
-                        nv_g[kss[kq].pspin] -=\
-                                        kss[kq].get(fg)
-                        Excpp = xc.get_energy_and_potential(\
-                                            nv_g[0],v_g,nv_g[1],v_g)
-                    else: # spin unpolarised
-                        nv_g=nt_sg + ns*kss[ij].get(fg)\
-                              + ns*kss[kq].get(fg)
-                        Excpp = xc.get_energy_and_potential(nv_g,v_g)
-                        nv_g=nt_sg + ns*kss[ij].get(fg)\
-                              - ns*kss[kq].get(fg)
-                        Excpm = xc.get_energy_and_potential(nv_g,v_g)
-                        nv_g=nt_sg - ns*kss[ij].get(fg)\
-                              + ns*kss[kq].get(fg)
-                        Excmp = xc.get_energy_and_potential(nv_g,v_g)
-                        nv_g=nt_sg - ns*kss[ij].get(fg)\
-                              - ns*kss[kq].get(fg)
-                        Excmm = xc.get_energy_and_potential(nv_g,v_g)
-
-                    Om_xc[ij,kq] += weight *\
-                                0.25*(Excpp-Excmp-Excpm+Excmm)/(ns*ns)
-                              
-                elif self.derivativeLevel == 1:
-                    # vxc is available
-
-                    timer2.start('integrate')
-                    Om_xc[ij,kq] += weight*\
-                                 self.gd.integrate(kss[kq].get(fg)*
-                                                   vvt_s[kss[kq].pspin])
-                    timer2.stop()
-
-                    timer2.start('integrate corrections')
-                    Exc = 0.
-                    for a, P_ni in wfs.kpt_u[kss[kq].spin].P_ani.items():
-                        # create the modified density matrix
-                        Pk_i = P_ni[kss[kq].i]
-                        Pq_i = P_ni[kss[kq].j]
-                        P_ii = np.outer(Pk_i, Pq_i)
-                        # we need the symmetric form, hence we can pack
-                        # use pack as I_sp used pack2
-                        P_p = pack(P_ii)
-                        Exc += np.dot(I_asp[a][kss[kq].pspin], P_p)
-                    Om_xc[ij, kq] += weight * self.gd.comm.sum(Exc)
-                    timer2.stop()
-
-                elif self.derivativeLevel == 2:
-                    # fxc is available
-                    if kss.npspins==2: # spin polarised
-                        Om_xc[ij,kq] += weight *\
-                            gd.integrate(kss[ij].get(fg)*
-                                         kss[kq].get(fg)*
-                                         fxc[kss[ij].pspin,kss[kq].pspin])
-                    else: # spin unpolarised
-                        Om_xc[ij,kq] += weight *\
-                            gd.integrate(kss[ij].get(fg)*
-                                         kss[kq].get(fg)*
-                                         fxc)
-                if ij != kq:
-                    Om_xc[kq,ij] = Om_xc[ij,kq]
-                
+            timer.start(ij_b[0])
+
+            for kq in range(ij_b[0], nij):
+                timer2.start('integrate')
+                I_b = self.gd.integrate(kss[kq].get(fg) *
+                                        vvt_bs[:, kss[kq].pspin])
+                timer2.stop()
+
+                for bi, ij in enumerate(ij_b):
+                    if kq < ij:
+                        continue
+                    weight = self.weight_Kijkq(ij, kq)
+                    Om_xc[ij,kq] += weight * (I_b[bi] + Exc_bq[bi, kq])
+
+                    if ij != kq:
+                        Om_xc[kq,ij] = Om_xc[ij,kq]
+
             timer.stop()
 ##            timer2.write()
+            ij = ij_b[-1]
             if ij < (nij-1):
-                t = timer.get_time(ij) # time for nij-ij calculations
+                t = timer.get_time(ij_b[0]) / nb # time for nij-ij calculations
                 t = .5*t*(nij-ij)  # estimated time for n*(n+1)/2, n=nij-(ij+1)
                 print >> self.txt,'XC estimated time left',\
-                      self.timestring(t0*(nij-ij-1)+t)
+                      self.timestring(t0*(nij-ij-1)/nb+t)
 
 
     def get_rpa(self):
@@ -378,91 +350,98 @@ class OmegaMatrix:
         # calculate omega matrix
         nij = len(kss)
         print >> self.txt,'RPA',nij,'transitions'
-        
+
         Om = self.Om
-        
-        for ij in range(eh_comm.rank, nij, eh_comm.size):
-            print >> self.txt,'RPA kss['+'%d'%ij+']=', kss[ij]
+
+        # packed pair density matrices of all transitions, built once
+        # instead of once per matrix element
+        D_aqp = self.pair_density_matrices()
+        e_q = np.array([ks.get_energy() for ks in kss])
+        w_q = np.array([ks.get_weight() for ks in kss])
+
+        # my rows come in blocks: the pair densities of the inner loop
+        # are integrated against all row potentials of a block and the
+        # Poisson equations of a block are solved in one batch
+        my_ij = range(eh_comm.rank, nij, eh_comm.size)
+        for b in range(0, len(my_ij), self.blocksize):
+            ij_b = my_ij[b:b + self.blocksize]
+            nb = len(ij_b)
+            for ij in ij_b:
+                print >> self.txt,'RPA kss['+'%d'%ij+']=', kss[ij]
 
             timer = Timer()
             timer.start('init')
             timer2 = Timer()
-                      
-            # smooth density including compensation charges
+
+            # smooth densities including compensation charges
             timer2.start('with_compensation_charges 0')
-            rhot_p = kss[ij].with_compensation_charges(
-                finegrid is not 0)
+            rhot_bp = self.poisson.gd.empty(nb)
+            for bi, ij in enumerate(ij_b):
+                rhot_bp[bi] = kss[ij].with_compensation_charges(
+                    finegrid is not 0)
             timer2.stop()
-            
+
             # integrate with 1/|r_1-r_2|
             timer2.start('poisson')
-            phit_p = np.zeros(rhot_p.shape, rhot_p.dtype.char)
-            self.poisson.solve(phit_p, rhot_p, charge=None)
+            phit_bp = np.zeros(rhot_bp.shape, rhot_bp.dtype.char)
+            self.poisson.solve_batch(phit_bp, rhot_bp)
             timer2.stop()
 
             timer.stop()
             t0 = timer.get_time('init')
-            timer.start(ij)
+            timer.start(ij_b[0])
 
             if finegrid == 1:
-                rhot = kss[ij].with_compensation_charges()
-                phit = self.gd.zeros()
-##                print "shapes 0=",phit.shape,rhot.shape
-                self.restrict(phit_p,phit)
+                phit_b = self.gd.zeros(nb)
+                for bi in range(nb):
+                    self.restrict(phit_bp[bi], phit_b[bi])
             else:
-                phit = phit_p
-                rhot = rhot_p
+                phit_b = phit_bp
+
+            # atomic corrections against all columns in one matrix
+            # product per atom
+            timer2.start('integrate corrections 2')
+            Ia_bq = np.zeros((nb, nij))
+            for a, D_qp in D_aqp.items():
+                C_pp = wfs.setups[a].M_pp
+                #   ----
+                # 2 >      P   P  C    P  P
+                #   ----    ip  jr prst ks qt
+                #   prst
+                Ia_bq += 2.0 * np.dot(D_qp[ij_b], np.dot(C_pp, D_qp.T))
+            self.gd.comm.sum(Ia_bq)
+            timer2.stop()
 
-            for kq in range(ij,nij):
-                if kq != ij:
-                    # smooth density including compensation charges
-                    timer2.start('kq with_compensation_charges')
-                    rhot = kss[kq].with_compensation_charges(
-                        finegrid is 2)
-                    timer2.stop()
+            for kq in range(ij_b[0], nij):
+                # smooth density including compensation charges
+                timer2.start('kq with_compensation_charges')
+                rhot = kss[kq].with_compensation_charges(
+                    finegrid is 2)
+                timer2.stop()
 
                 timer2.start('integrate')
-                pre = 2.*sqrt(kss[ij].get_energy()*kss[kq].get_energy()*
-                                  kss[ij].get_weight()*kss[kq].get_weight())
-                Om[ij,kq]= pre * self.gd.integrate(rhot*phit)
-##                print "int=",Om[ij,kq]
+                I_b = self.gd.integrate(rhot * phit_b)
                 timer2.stop()
 
-                # Add atomic corrections
-                timer2.start('integrate corrections 2')
-                Ia = 0.
-                for a, P_ni in wfs.kpt_u[kss[ij].spin].P_ani.items():
-                    Pi_i = P_ni[kss[ij].i]
-                    Pj_i = P_ni[kss[ij].j]
-                    Dij_ii = np.outer(Pi_i, Pj_i)
-                    Dij_p = pack(Dij_ii)
-                    Pkq_ni = wfs.kpt_u[kss[kq].spin].P_ani[a]
-                    Pk_i = Pkq_ni[kss[kq].i]
-                    Pq_i = Pkq_ni[kss[kq].j]
-                    Dkq_ii = np.outer(Pk_i, Pq_i)
-                    Dkq_p = pack(Dkq_ii)
-                    C_pp = wfs.setups[a].M_pp
-                    #   ----
-                    # 2 >      P   P  C    P  P
-                    #   ----    ip  jr prst ks qt
-                    #   prst
-                    Ia += 2.0*np.dot(Dkq_p,np.dot(C_pp,Dij_p))
-                timer2.stop()
-                
-                Om[ij,kq] += pre * self.gd.comm.sum(Ia)
-                    
-                if ij == kq:
-                    Om[ij,kq] += kss[ij].get_energy()**2
-                else:
-                    Om[kq,ij]=Om[ij,kq]
+                for bi, ij in enumerate(ij_b):
+                    if kq < ij:
+                        continue
+                    pre = 2.*sqrt(e_q[ij]*e_q[kq]*w_q[ij]*w_q[kq])
+                    Om[ij,kq] = pre * (I_b[bi] + Ia_bq[bi, kq])
+
+                    if ij == kq:
+                        Om[ij,kq] += e_q[ij]**2
+                    else:
+                        Om[kq,ij]=Om[ij,kq]
 
             timer.stop()
 ##            timer2.write()
+            ij = ij_b[-1]
             if ij < (nij-1):
-                t = timer.get_time(ij) # time for nij-ij calculations
+                t = timer.get_time(ij_b[0]) / nb # time for nij-ij calculations
                 t = .5*t*(nij-ij)  # estimated time for n*(n+1)/2, n=nij-(ij+1)
                 print >> self.txt,'RPA estimated time left',\
-                      self.timestring(t0*(nij-ij-1)+t)
+                      self.timestring(t0*(nij-ij-1)/nb+t)
 
     def singlets_triplets(self):
         """Split yourself into singlet and triplet transitions"""
@@ -10,6 +10,8 @@ import numpy as np
 from gpaw.utilities.blas import axpy
 from gpaw.fd_operators import FDOperator
 
+import _gpaw
+
 
 class BaseMixer:
     """Pulay density mixer."""
@@ -78,13 +80,19 @@ class BaseMixer:
 
         my_nuclei:   All nuclei in local domain.
         """
-        
-        # History for Pulay mixing of densities:
-        self.nt_iG = [] # Pseudo-electron densities
-        self.R_iG = []  # Residuals
+
+        # History for Pulay mixing of densities.  The grid arrays live
+        # in fixed ring buffers (allocated on the first mix); the order
+        # lists map history position to ring slot:
+        self.nt_xG = None # Pseudo-electron densities
+        self.R_xG = None  # Residuals
+        self.nt_order = []
+        self.R_order = []
+        self.ntcount = 0
+        self.Rcount = 0
         self.A_ii = np.zeros((0, 0))
         self.dNt = None
-        
+
         self.D_iap = []
         self.dD_iap = []
 
@@ -100,44 +108,53 @@ class BaseMixer:
         self.dNt = dNt
         
     def mix(self, nt_G, D_ap):
-        iold = len(self.nt_iG)
+        if self.nt_xG is None:
+            # The ring holds up to nmaxold + 1 input densities (a new
+            # one is stored before the oldest is dropped):
+            self.nt_xG = np.empty((self.nmaxold + 1,) + nt_G.shape)
+            self.R_xG = np.empty((self.nmaxold,) + nt_G.shape)
+
+        iold = len(self.nt_order)
         if iold > 0:
             if iold > self.nmaxold:
-                # Throw away too old stuff:
-                del self.nt_iG[0]
-                del self.R_iG[0]
+                # Throw away too old stuff (the freed ring slots are
+                # the next ones overwritten):
+                del self.nt_order[0]
+                del self.R_order[0]
                 del self.D_iap[0]
                 del self.dD_iap[0]
-                # for D_p, D_ip, dD_ip in self.D_a:
-                #     del D_ip[0]
-                #     del dD_ip[0]
                 iold = self.nmaxold
 
             # Calculate new residual (difference between input and
-            # output density):
-            R_G = nt_G - self.nt_iG[-1]
-            self.dNt = self.gd.integrate(np.fabs(R_G))
-            self.R_iG.append(R_G)
+            # output density) and the charge sloshing in one pass:
+            rslot = self.Rcount % self.nmaxold
+            self.Rcount += 1
+            R_G = self.R_xG[rslot]
+            dNt = _gpaw.mixer_residual(nt_G, self.nt_xG[self.nt_order[-1]],
+                                       R_G)
+            self.dNt = self.gd.comm.sum(dNt) * self.gd.dv
+            self.R_order.append(rslot)
             self.dD_iap.append([])
             for D_p, D_ip in zip(D_ap, self.D_iap[-1]):
                 self.dD_iap[-1].append(D_p - D_ip)
 
-            # Update matrix:
+            # Update matrix (only the new row; the rest is copied from
+            # the previous step):
             A_ii = np.zeros((iold, iold))
-            i1 = 0
             i2 = iold - 1
-            
+
             if self.metric is None:
                 mR_G = R_G
             else:
                 mR_G = self.mR_G
                 self.metric(R_G, mR_G)
-                
-            for R_1G in self.R_iG:
-                a = self.gd.comm.sum(np.vdot(R_1G, mR_G))
-                A_ii[i1, i2] = a
-                A_ii[i2, i1] = a
-                i1 += 1
+
+            a_i = np.empty(iold)
+            _gpaw.mixer_overlap(self.R_xG, np.asarray(self.R_order), mR_G,
+                                a_i)
+            self.gd.comm.sum(a_i)
+            A_ii[:, i2] = a_i
+            A_ii[i2, :] = a_i
             A_ii[:i2, :i2] = self.A_ii[-i2:, -i2:]
             self.A_ii = A_ii
 
@@ -154,16 +171,16 @@ class BaseMixer:
                 except ZeroDivisionError:
                     alpha_i[:] = 0.0
                     alpha_i[-1] = 1.0
-            
-            # Calculate new input density:
-            nt_G[:] = 0.0
-            #for D_p, D_ip, dD_ip in self.D_a:
+
+            # Calculate new input density (each block of the grid is
+            # written once while all histories are visited):
+            _gpaw.mixer_combine(alpha_i, self.beta,
+                                self.nt_xG, np.asarray(self.nt_order),
+                                self.R_xG, np.asarray(self.R_order), nt_G)
+            beta = self.beta
             for D in D_ap:
                 D[:] = 0.0
-            beta = self.beta
             for i, alpha in enumerate(alpha_i):
-                axpy(alpha, self.nt_iG[i], nt_G)
-                axpy(alpha * beta, self.R_iG[i], nt_G)
                 for D_p, D_ip, dD_ip in zip(D_ap, self.D_iap[i],
                                             self.dD_iap[i]):
                     axpy(alpha, D_ip, D_p)
@@ -171,14 +188,17 @@ class BaseMixer:
 
 
         # Store new input density (and new atomic density matrices):
-        self.nt_iG.append(nt_G.copy())
+        slot = self.ntcount % (self.nmaxold + 1)
+        self.ntcount += 1
+        self.nt_xG[slot] = nt_G
+        self.nt_order.append(slot)
         self.D_iap.append([])
         for D_p in D_ap:
             self.D_iap[-1].append(D_p.copy())
 
     def estimate_memory(self, mem, gd):
         gridbytes = gd.bytecount()
-        mem.subnode('nt_iG, R_iG', 2 * self.nmaxold * gridbytes)
+        mem.subnode('nt_xG, R_xG', (2 * self.nmaxold + 1) * gridbytes)
 
     def __repr__(self):
         classname = self.__class__.__name__
@@ -6,6 +6,7 @@ import sys
 import time
 import atexit
 import pickle
+import tempfile
 import numpy as np
 
 from gpaw import debug
@@ -73,6 +74,32 @@ class _Communicator:
         else:
             return _Communicator(comm, parent=self)
 
+    def cart_create(self, parsize_c, pbc_c, reorder=True):
+        """Create a Cartesian communicator spanning all ranks in this group.
+        Must be called by all processes in the group.
+
+        With reorder enabled, the MPI library is free to renumber the
+        ranks so that neighbors in the process grid are placed close to
+        each other on the network.  Use get_members() to map the new
+        ranks back to ranks in this group.
+
+        Parameters:
+
+        parsize_c: sequence of 3 ints
+            Size of the process grid along the three axes; the product
+            must equal the size of this communicator.
+        pbc_c: sequence of 3 bools
+            Periodicity of the process grid along the three axes.
+        reorder: bool (default True)
+            Allow the ranks to be reordered.
+
+        """
+        parsize_c = tuple(int(s) for s in parsize_c)
+        assert np.product(parsize_c) == self.size
+        pbc_c = tuple(int(bool(p)) for p in pbc_c)
+        comm = self.comm.cart_create(parsize_c, pbc_c, int(bool(reorder)))
+        return _Communicator(comm, parent=self)
+
     def sum(self, a, root=-1):
         """Perform summation by MPI reduce operations of numerical data.
 
@@ -278,6 +305,57 @@ class _Communicator:
                 a.size * self.size == b.size)
         self.comm.all_gather(a, b)
 
+    def all_gatherv(self, a, b, counts_r):
+        """Gather blocks of varying size from all ranks onto all processes.
+
+        Parameters:
+
+        a: ndarray
+            Source of the data to gather, i.e. send buffer of this rank.
+            Its size must equal this rank's entry in counts_r.
+        b: ndarray
+            Destination of the distributed data, i.e. receive buffer.
+            The size of this array must match the sum of the counts;
+            rank r's block ends up at offset sum(counts_r[:r]).
+        counts_r: ndarray (type int)
+            Number of elements sent by each rank.
+
+        """
+        assert a.flags.contiguous
+        assert b.flags.contiguous
+        assert b.dtype == a.dtype
+        assert len(counts_r) == self.size
+        assert a.size == counts_r[self.rank]
+        assert b.size == sum(counts_r)
+        self.comm.all_gatherv(a, b, np.ascontiguousarray(counts_r, int))
+
+    def reduce_scatter(self, a, b, counts_r):
+        """Sum arrays from all ranks and scatter blocks of the result.
+
+        Equivalent to sum(a) followed by each rank extracting the block
+        of counts_r[rank] elements starting at sum(counts_r[:rank]),
+        but each element is only sent once.
+
+        Parameters:
+
+        a: ndarray
+            Local contribution to the sum; same size on all ranks.
+            Its size must equal the sum of the counts.
+        b: ndarray
+            Destination of this rank's block of the summed result.
+            Its size must equal this rank's entry in counts_r.
+        counts_r: ndarray (type int)
+            Number of elements received by each rank.
+
+        """
+        assert a.flags.contiguous
+        assert b.flags.contiguous
+        assert b.dtype == a.dtype
+        assert len(counts_r) == self.size
+        assert a.size == sum(counts_r)
+        assert b.size == counts_r[self.rank]
+        self.comm.reduce_scatter(a, b, np.ascontiguousarray(counts_r, int))
+
     def gather(self, a, root, b=None):
         """Gather data from all ranks onto a single process in a group.
 
@@ -373,6 +451,40 @@ class _Communicator:
         assert is_contiguous(a)
         self.comm.broadcast(a, root)
 
+    def isum(self, a, root=-1):
+        """Start a non-blocking in-place summation of an array.
+
+        Returns a request that must be handed to wait/waitall before the
+        result (and the array) may be used, allowing the reduction to
+        overlap with computation.  Scalars are not supported; use a
+        0-dimensional array."""
+        assert is_contiguous(a)
+        assert root == -1 or 0 <= root < self.size
+        return self.comm.isum(a, root)
+
+    def ibroadcast(self, a, root):
+        """Start a non-blocking in-place broadcast from root.
+
+        Returns a request for wait/waitall."""
+        assert 0 <= root < self.size
+        assert is_contiguous(a)
+        return self.comm.ibroadcast(a, root)
+
+    def igather(self, a, root, b=None):
+        """Start a non-blocking gather on the root rank.
+
+        Returns a request for wait/waitall."""
+        assert a.flags.contiguous
+        assert 0 <= root < self.size
+        if root == self.rank:
+            assert b.flags.contiguous and b.dtype == a.dtype
+            assert (b.shape[0] == self.size and a.shape == b.shape[1:] or
+                    a.size * self.size == b.size)
+            return self.comm.igather(a, root, b)
+        else:
+            assert b is None
+            return self.comm.igather(a, root)
+
     def sendreceive(self, a, dest, b, src, sendtag=123, recvtag=123):
         assert 0 <= dest < self.size
         assert dest != self.rank
@@ -492,6 +604,12 @@ class _Communicator:
         """
         return self.comm.get_members()
 
+    def get_stats(self):
+        """Return the communication statistics of the wrapped C-object."""
+        if not hasattr(self.comm, 'get_stats'):
+            return {}
+        return self.comm.get_stats()
+
     def get_c_object(self):
         """Return the C-object wrapped by this debug interface.
 
@@ -542,11 +660,31 @@ class SerialCommunicator:
     def all_gather(self, a, b):
         b[:] = a
 
+    def all_gatherv(self, a, b, counts_r):
+        b.ravel()[:] = a.ravel()
+
+    def reduce_scatter(self, a, b, counts_r):
+        b.ravel()[:] = a.ravel()
+
+    def isum(self, a, root=-1):
+        return None
+
+    def ibroadcast(self, a, root):
+        return None
+
+    def igather(self, a, root, b=None):
+        if b is not None:
+            b[:] = a
+        return None
+
     def new_communicator(self, ranks):
         if self.rank not in ranks:
             return None
         return SerialCommunicator(parent=self)
 
+    def cart_create(self, parsize_c, pbc_c, reorder=True):
+        return self
+
     def test(self, request):
         return 1
 
@@ -648,6 +786,180 @@ def distribute_cpus(parsize, parsize_bands, nspins, nibzkpts, comm=world,
     return domain_comm, kpt_comm, band_comm
 
 
+def farm(func, args, comm=world, ngroups=None):
+    """Run independent calculations concurrently on sub-communicators.
+
+    comm is split into ngroups groups of (nearly) equal size - by
+    default one group per argument, limited by the number of ranks.
+    The arguments are distributed round robin over the groups, and
+    func(arg, group_comm) is called for every argument belonging to
+    the group of this rank.  The list of all return values, ordered
+    like args, is returned on every rank.
+
+    This turns a sequential loop of independent calculations, like the
+    displacements of a vibrational or phonon run, into a farm that
+    fills the whole machine::
+
+      def energy(atoms, comm):
+          atoms.set_calculator(GPAW(..., communicator=comm))
+          return atoms.get_potential_energy()
+
+      energies = farm(energy, displaced, world)
+
+    The function must create its calculator on the communicator it is
+    passed.  Return values travel through pickle, so they should be
+    plain data (energies, forces, ...), not calculator objects."""
+
+    args = list(args)
+    ntasks = len(args)
+    if ntasks == 0:
+        return []
+
+    if ngroups is None:
+        ngroups = min(ntasks, comm.size)
+    assert 0 < ngroups <= comm.size
+
+    # Split comm into ngroups groups; the first (size % ngroups)
+    # groups get one rank more:
+    l = comm.size // ngroups
+    rest = comm.size % ngroups
+    group_r0 = [min(g, rest) + l * g for g in range(ngroups)]
+    group_r0.append(comm.size)
+    for g in range(ngroups):
+        if group_r0[g] <= comm.rank < group_r0[g + 1]:
+            mygroup = g
+    group_comm = comm.new_communicator(
+        np.arange(group_r0[mygroup], group_r0[mygroup + 1]))
+
+    myresults = {}
+    for t in range(mygroup, ntasks, ngroups):
+        myresults[t] = func(args[t], group_comm)
+
+    # Gather the results from the group masters and hand the full
+    # list to everybody:
+    if comm.rank == 0:
+        results = [None] * ntasks
+        for t, result in myresults.items():
+            results[t] = result
+        for g in range(1, ngroups):
+            other = pickle.loads(receive_string(group_r0[g], comm))
+            for t, result in other.items():
+                results[t] = result
+    else:
+        results = None
+        if comm.rank == group_r0[mygroup]:
+            send_string(pickle.dumps(myresults, pickle.HIGHEST_PROTOCOL),
+                        0, comm)
+    return broadcast(results, 0, comm)
+
+
+# Cache of two-level reduction structures, keyed by communicator:
+_node_comms = {}
+
+def get_node_communicators(comm=world):
+    """Return the (node_comm, master_comm) pair for two-level reductions.
+
+    node_comm contains the ranks of comm that run on the same node as
+    this rank; master_comm connects the first rank of every node and is
+    None on all other ranks.  Nodes are identified by processor name.
+    The communicators are built collectively on the first call and
+    cached, so this must be called by all ranks of comm the first time.
+    """
+    if comm in _node_comms:
+        return _node_comms[comm]
+
+    if isinstance(comm, SerialCommunicator):
+        # Serial and dry-run communicators have no processor names:
+        return comm, comm
+
+    # Fixed-size buffer so the names can go through one all_gather:
+    name = np.fromstring(comm.name(), np.int8)
+    name_b = np.zeros(256, np.int8)
+    name_b[:len(name)] = name
+    name_rb = np.empty((comm.size, 256), np.int8)
+    comm.all_gather(name_b, name_rb)
+    names = [n.tostring() for n in name_rb]
+
+    myname = names[comm.rank]
+    noderanks = [r for r in range(comm.size) if names[r] == myname]
+    node_comm = comm.new_communicator(np.array(noderanks))
+
+    masters = []
+    for r, n in enumerate(names):
+        if n not in names[:r]:
+            masters.append(r)
+    master_comm = comm.new_communicator(np.array(masters))
+
+    _node_comms[comm] = (node_comm, master_comm)
+    return node_comm, master_comm
+
+def hierarchical_sum(a, comm=world):
+    """Sum scalars or an array in two stages: on-node, then over nodes.
+
+    The on-node reduction goes through shared memory, so only the node
+    masters touch the network and a latency-bound allreduce over all of
+    comm becomes one over the much smaller set of nodes.  A list or
+    tuple of scalars is packed into a single array so that the handful
+    of per-iteration quantities cost one reduction, not one each.
+
+    A scalar argument returns the summed scalar, a sequence returns a
+    list of sums, and an array is summed in place like comm.sum."""
+    batch = isinstance(a, (list, tuple))
+    scalar = isinstance(a, (int, float, complex))
+    if batch or scalar:
+        a = np.array(a)
+
+    if comm.size > 1:
+        node_comm, master_comm = get_node_communicators(comm)
+        node_comm.sum(a, 0)
+        if master_comm is not None:
+            master_comm.sum(a)
+        node_comm.broadcast(a, 0)
+
+    if batch:
+        return a.tolist()
+    elif scalar:
+        return a.item()
+
+
+def shared_array(a, comm=world):
+    """Move an array into memory shared by the ranks on a node.
+
+    All ranks of comm must pass arrays with identical contents.  The
+    node master copies its array into a file on a shared-memory file
+    system and every rank on the node maps the same physical pages
+    back read-only, so the per-rank private copies can be garbage
+    collected.  This is meant for large immutable tables (setup radial
+    data and the like) that would otherwise be held once per rank
+    instead of once per node.  Must be called collectively on comm;
+    returns the array unchanged if the node has only one rank or no
+    shared-memory file system is available.
+    """
+    node_comm, master_comm = get_node_communicators(comm)
+    if node_comm.size == 1 or not os.path.isdir('/dev/shm'):
+        return a
+
+    a = np.ascontiguousarray(a)
+    if node_comm.rank == 0:
+        fd, fname = tempfile.mkstemp(prefix='gpaw-shared-', dir='/dev/shm')
+        os.close(fd)
+        m = np.memmap(fname, dtype=a.dtype, mode='w+', shape=a.shape)
+        m[...] = a
+        m.flush()
+        del m
+        fname = broadcast(fname, 0, node_comm)
+    else:
+        # The master has filled the file before sending us its name:
+        fname = broadcast(None, 0, node_comm)
+    m = np.memmap(fname, dtype=a.dtype, mode='r', shape=a.shape)
+    # Once everybody has mapped the file, the name can go away - the
+    # pages stay around until the last rank unmaps them:
+    node_comm.barrier()
+    if node_comm.rank == 0:
+        os.unlink(fname)
+    return m
+
+
 def compare_atoms(atoms, comm=world):
     """Check whether atoms objects are identical on all processors."""
     # Construct fingerprint:
@@ -764,6 +1076,79 @@ def run(iterators):
         except StopIteration:
             return results
 
+def start_communication_stats():
+    """Start recording per-communicator communication statistics.
+
+    Every communicator records call counts, bytes and size/latency
+    histograms for each operation type (send, recv, reduce, ...) until
+    stop_communication_stats() is called; the numbers are fetched with
+    comm.get_stats() or printed with write_communication_stats()."""
+    if hasattr(_gpaw, 'mpi_stats_enable'):
+        _gpaw.mpi_stats_enable()
+
+
+def stop_communication_stats():
+    """Stop recording communication statistics (counters are kept)."""
+    if hasattr(_gpaw, 'mpi_stats_disable'):
+        _gpaw.mpi_stats_disable()
+
+
+def write_communication_stats(comm=world, out=sys.stdout):
+    """Print this rank's communication statistics of a communicator.
+
+    One line per operation type with call count, transferred data and
+    time inside MPI, followed by the message-size histogram (log2 bins)
+    and the latency histogram (decade bins).  Every rank holds its own
+    counters - in a big run, compare a busy rank against an idle one to
+    attribute slowdowns to halo exchange or collectives."""
+    get_stats = getattr(comm, 'get_stats', None)
+    if get_stats is None:  # serial communicator or debug wrapper
+        return
+    stats = get_stats()
+    if not stats:
+        return
+    sizelabels = ['<%s' % memstring(2.0**(b + 1))
+                  for b in range(len(stats.values()[0]['size_hist']))]
+    timelabels = ['<1us', '<10us', '<100us', '<1ms', '<10ms', '<100ms',
+                  '<1s', '>=1s']
+    out.write('\n%s\n' % ('=' * 60))
+    out.write('Communication (rank %d of %d):\n' % (comm.rank, comm.size))
+    out.write('%s\n' % ('=' * 60))
+    out.write('%-15s %9s %10s %10s\n' % ('operation', 'calls', 'data',
+                                         'time [s]'))
+    for name in sorted(stats):
+        s = stats[name]
+        out.write('%-15s %9d %10s %10.3f\n' %
+                  (name, s['count'], memstring(float(s['bytes'])), s['time']))
+        for label, (labels, hist) in [('sizes', (sizelabels,
+                                                 s['size_hist'])),
+                                      ('latency', (timelabels,
+                                                   s['time_hist']))]:
+            bins = ['%s: %d' % (labels[b], hist[b])
+                    for b in range(len(hist)) if hist[b] > 0]
+            if bins:
+                out.write('  %-8s %s\n' % (label + ':', '  '.join(bins)))
+    out.write('%s\n' % ('=' * 60))
+
+
+def memstring(nbytes):
+    for unit in ['B', 'kB', 'MB', 'GB']:
+        if nbytes < 1024.0:
+            return '%.0f%s' % (nbytes, unit)
+        nbytes /= 1024.0
+    return '%.0fTB' % nbytes
+
+
+if os.environ.get('GPAW_MPI_STATS'):
+    start_communication_stats()
+
+    def _write_stats(world=world):
+        stop_communication_stats()
+        write_communication_stats(world, sys.stderr)
+
+    atexit.register(_write_stats)
+
+
 # Shut down all processes if one of them fails.
 if parallel and not (dry_run_size > 1):
     # This is a true parallel calculation
@@ -0,0 +1,115 @@
+"""Dynamic distribution of independent work items over MPI ranks.
+
+Evaluation points on an energy contour or a frequency grid are
+independent, but their costs are not: contour points near poles need
+more self-energy iterations than points far away, so a static split
+(np.array_split of the point numbers over the ranks) leaves the fast
+ranks idle while the unlucky ones finish.
+
+This module assigns points on completion instead.  One rank hands out
+the next point number whenever another rank reports in, so the ranks
+that draw cheap points simply process more of them.  The caller
+evaluates work(i) for the point numbers it is given, keeps whatever
+per-point data it produces, and combines the partial results
+afterwards - typically with comm.sum, exactly as with a static split.
+"""
+
+from time import sleep
+
+import numpy as np
+
+
+class PointScheduler:
+    """Master-worker dispatcher for independent evaluation points.
+
+    Usage::
+
+      scheduler = PointScheduler(comm)
+      mypoints = scheduler.distribute(npoints, work)
+
+    work(i) is called exactly once, on exactly one rank, for every i in
+    range(npoints); the returned list holds the point numbers this rank
+    evaluated.  The master rank serves assignment requests and works on
+    points itself only while no requests are pending, so no rank is
+    wasted on bookkeeping.  Serial communicators evaluate all points in
+    order.
+    """
+
+    # Message tags, distinct from the default tag used elsewhere (123):
+    request_tag = 141
+    assign_tag = 142
+
+    def __init__(self, comm, master=0):
+        self.comm = comm
+        self.master = master
+
+    def distribute(self, n, work):
+        comm = self.comm
+        if comm.size == 1:
+            for i in range(n):
+                work(i)
+            return range(n)
+        if comm.rank == self.master:
+            return self._serve(n, work)
+        else:
+            return self._request(work)
+
+    def _serve(self, n, work):
+        comm = self.comm
+        workers = [r for r in range(comm.size) if r != self.master]
+        ready_r = {}
+        request_r = {}
+        for r in workers:
+            ready_r[r] = np.zeros(1, int)
+            request_r[r] = comm.receive(ready_r[r], r, self.request_tag,
+                                        block=False)
+        assignment = np.zeros(1, int)
+        mypoints = []
+        nextpoint = 0
+        nfinished = 0
+        while nfinished < len(workers):
+            idle = True
+            for r in workers:
+                if request_r[r] is None or not comm.test(request_r[r]):
+                    continue
+                idle = False
+                if nextpoint < n:
+                    assignment[0] = nextpoint
+                    nextpoint += 1
+                    request_r[r] = comm.receive(ready_r[r], r,
+                                                self.request_tag,
+                                                block=False)
+                else:
+                    assignment[0] = -1
+                    request_r[r] = None
+                    nfinished += 1
+                comm.send(assignment, r, self.assign_tag)
+            if idle:
+                if nextpoint < n:
+                    i = nextpoint
+                    nextpoint += 1
+                    mypoints.append(i)
+                    work(i)
+                else:
+                    sleep(1e-4)
+        # The other ranks may all have signed off before the list was
+        # exhausted (n < size):
+        while nextpoint < n:
+            mypoints.append(nextpoint)
+            work(nextpoint)
+            nextpoint += 1
+        return mypoints
+
+    def _request(self, work):
+        comm = self.comm
+        ready = np.zeros(1, int)
+        assignment = np.zeros(1, int)
+        mypoints = []
+        while True:
+            comm.send(ready, self.master, self.request_tag)
+            comm.receive(assignment, self.master, self.assign_tag)
+            i = int(assignment[0])
+            if i < 0:
+                return mypoints
+            mypoints.append(i)
+            work(i)
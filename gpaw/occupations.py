@@ -348,6 +348,18 @@ class ZeroKelvin(OccupationNumbers):
             wfs.bd.distribute(f_sn[kpt.s], kpt.f_n)
 
 
+class FermiSearchKPoint:
+    """Collected eigenvalues for one k-point/spin.
+
+    Stands in for a KPoint object during the replicated Fermi-level
+    search, where every rank walks all k-points."""
+    def __init__(self, eps_n, weight, s):
+        self.eps_n = eps_n
+        self.weight = weight
+        self.s = s
+        self.f_n = np.empty_like(eps_n)
+
+
 class SmoothDistribution(ZeroKelvin):
     """Base class for Fermi-Dirac and other smooth distributions."""
     def __init__(self, width, fixmagmom, maxiter):
@@ -467,14 +479,27 @@ class SmoothDistribution(ZeroKelvin):
         return wfs.bd.comm.sum(wfs.kpt_comm.sum(fermilevel))
                     
     def find_fermi_level(self, wfs, ne, fermilevel, spins=(0, 1)):
+        # Collect all eigenvalues once so that the Newton search below
+        # runs on identical data on every rank - no communication per
+        # search step:
+        kd = wfs.kd
+        eps_un = np.zeros((kd.nks, wfs.nbands))
+        for myu, kpt in enumerate(wfs.kpt_u):
+            eps_un[kd.ks0 + myu] = wfs.bd.collect(kpt.eps_n, broadcast=True)
+        kd.comm.sum(eps_un)
+
+        kpt_u = []
+        for u in range(kd.nks):
+            s, k = divmod(u, kd.nibzkpts)
+            kpt_u.append(FermiSearchKPoint(eps_un[u],
+                                           kd.weight_k[k] * 2 / kd.nspins, s))
+
         niter = 0
         while True:
             data = np.zeros(4)
-            for kpt in wfs.kpt_u:
+            for kpt in kpt_u:
                 if kpt.s in spins:
                     data += self.distribution(kpt, fermilevel)
-            wfs.kpt_comm.sum(data)
-            wfs.bd.comm.sum(data)
             n, dnde, magmom, e_entropy = data
             dn = ne - n
             if abs(dn) < 1e-9:
@@ -494,6 +519,12 @@ class SmoothDistribution(ZeroKelvin):
             fermilevel += de
             niter += 1
 
+        # Fill in the occupation numbers for the local k-points and
+        # band slices:
+        for kpt in wfs.kpt_u:
+            if kpt.s in spins:
+                self.distribution(kpt, fermilevel)
+
         self.niter = niter
         return fermilevel, magmom, e_entropy
 
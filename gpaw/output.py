@@ -16,6 +16,7 @@ from gpaw.version import version
 from gpaw.utilities import scalapack
 from gpaw import sl_diagonalize, sl_inverse_cholesky, dry_run, extra_parameters
 from gpaw.utilities.memory import maxrss
+from gpaw.utilities.timing import summarize_timers
 import gpaw
 
 
@@ -396,8 +397,66 @@ class PAWTextOutput:
             else:
                 t()
 
+        if os.environ.get('GPAW_SCF_PROFILE'):
+            self.print_iteration_profile(iter)
+
         self.txt.flush()
 
+    # Big SCF cost centers and the timer names that belong to them
+    # (matched at any level of the hierarchical timer):
+    scf_profile_names = [
+        ('eigensolver', ['RMM-DIIS', 'Davidson', 'CG', 'CheFSI filter',
+                         'Subspace diag']),
+        ('poisson', ['Poisson']),
+        ('xc', ['XC 3D grid', 'XC Correction']),
+        ('mixing', ['Mix']),
+        ('ortho', ['Orthonormalize'])]
+
+    def print_iteration_profile(self, iter):
+        """Print a cost breakdown of the last SCF iteration.
+
+        Enabled with the GPAW_SCF_PROFILE environment variable.  The
+        line is machine-parseable: 'profile: iter=N key=value ...'
+        with times in seconds; in parallel runs each value is
+        'max/min' over the ranks, so imbalance shows up as the two
+        numbers drifting apart."""
+        timers = self.timer.get_timers()
+        last = getattr(self, 'scf_profile_timers', {})
+        self.scf_profile_timers = timers
+        tnow = time.time()
+        tlast = getattr(self, 'scf_profile_t0', None)
+        self.scf_profile_t0 = tnow
+        if tlast is None:
+            return  # no previous iteration to diff against
+        data = [tnow - tlast]
+        for label, names in self.scf_profile_names:
+            tcat = 0.0
+            for key, tinc in timers.items():
+                # The times are inclusive, so count only the outermost
+                # occurrence of each name to avoid double counting:
+                if key[-1] in names and not [n for n in key[:-1]
+                                             if n in names]:
+                    tcat += tinc - last.get(key, 0.0)
+            data.append(tcat)
+        world = getattr(self.wfs, 'world', None)
+        fields = ['iter=%d' % iter]
+        if world is not None and world.size > 1:
+            tmax = np.array(data)
+            tmin = np.array(data)
+            world.max(tmax)
+            world.min(tmin)
+            for (label, t1, t0) in zip(['total'] +
+                                       [l for l, n in
+                                        self.scf_profile_names],
+                                       tmax, tmin):
+                fields.append('%s=%.3f/%.3f' % (label, t1, t0))
+        else:
+            for (label, t1) in zip(['total'] + [l for l, n in
+                                                self.scf_profile_names],
+                                   data):
+                fields.append('%s=%.3f' % (label, t1))
+        self.text('profile:', ' '.join(fields))
+
     def print_forces(self):
         if self.forces.F_av is None:
             return
@@ -430,6 +489,9 @@ class PAWTextOutput:
                 else:
                     self.text('Memory usage: %.2f GB' % (mr / 1024.0**3))
 
+            world = getattr(self.wfs, 'world', None)
+            if world is not None and world.size > 1:
+                summarize_timers(self.timer, world, self.txt)
             self.timer.write(self.txt)
 
     def warn(self, string=None):
@@ -13,7 +13,7 @@ import numpy as np
 
 from gpaw.utilities.tools import lowdin, tri2full
 from gpaw import extra_parameters
-from gpaw.utilities.lapack import diagonalize
+from gpaw.utilities.lapack import diagonalize, cholesky, cholesky_solve
 
 class Overlap:
     """Overlap operator class.
@@ -79,6 +79,27 @@ class Overlap:
         self.timer.stop('calc_matrix')
 
         orthonormalization_string = repr(self.ksl)
+
+        if (extra_parameters.get('cholesky_solve') and
+            not extra_parameters.get('sic', False) and
+            not self.ksl.using_blacs and wfs.bd.comm.size == 1):
+            # Factorize S_nn = C_nn C_nn^d and apply inv(C_nn) to the
+            # wave functions with a triangular solve instead of forming
+            # the explicit inverse factor and multiplying - half the
+            # rotation flops.  The solve couples all bands, so this
+            # only works without band parallelization.
+            self.timer.start(orthonormalization_string)
+            self.ksl.blockcomm.broadcast(S_nn, 0)
+            cholesky(S_nn)
+            self.timer.stop(orthonormalization_string)
+
+            self.timer.start('rotate_psi')
+            cholesky_solve(S_nn, psit_nG)
+            for P_ni in P_ani.values():
+                cholesky_solve(S_nn, P_ni)
+            self.timer.stop('rotate_psi')
+            self.timer.stop('Orthonormalize')
+            return
         self.timer.start(orthonormalization_string)
         #
         if extra_parameters.get('sic', False):
@@ -121,6 +142,15 @@ class Overlap:
 
         """
         self.timer.start('Apply overlap')
+        if calculate_P_ani and hasattr(wfs.pt, 'apply_overlap'):
+            # Fused C path: integrate, per-atom dO_ii transform and add
+            # without building and iterating over P_axi dictionaries:
+            dO_aii = dict([(a, wfs.setups[a].dO_ii)
+                           for a in wfs.pt.atom_indices])
+            wfs.pt.apply_overlap(dO_aii, a_xG, b_xG, kpt.q)
+            self.timer.stop('Apply overlap')
+            return
+
         b_xG[:] = a_xG
         shape = a_xG.shape[:-3]
         P_axi = wfs.pt.dict(shape)
@@ -140,6 +170,12 @@ class Overlap:
     def apply_inverse(self, a_xG, b_xG, wfs, kpt, calculate_P_ani=True):
         """Apply approximative inverse overlap operator to wave functions."""
 
+        if calculate_P_ani and hasattr(wfs.pt, 'apply_overlap'):
+            dC_aii = dict([(a, wfs.setups[a].dC_ii)
+                           for a in wfs.pt.atom_indices])
+            wfs.pt.apply_overlap(dC_aii, a_xG, b_xG, kpt.q)
+            return
+
         b_xG[:] = a_xG
         shape = a_xG.shape[:-3]
         P_axi = wfs.pt.dict(shape)
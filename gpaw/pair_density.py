@@ -4,6 +4,7 @@ import numpy as np
 from gpaw.utilities import pack
 from gpaw.utilities.tools import pick
 from gpaw.lfc import LocalizedFunctionsCollection as LFC
+import _gpaw
 
 
 class PairDensity2:
@@ -66,6 +67,53 @@ class PairDensity2:
         else:
             self.density.Ghat.add(rhot_g, Q_aL)
 
+    def initialize_block(self, kpt, n1, n2_m):
+        """Set wave function indices for a block of pairs (fixed n1)."""
+        self.n1 = n1
+        self.n2_m = np.asarray(n2_m, dtype=int)
+        self.spin = kpt.s
+        self.P_ani = kpt.P_ani
+        self.psit_nG = kpt.psit_nG
+
+    def get_coarse_block(self, nt_mG):
+        """Get the whole block of pair densities in one C call.
+
+        The fixed band n1 stays in cache while the n2 bands stream
+        through once each."""
+        n1_m = np.empty(len(self.n2_m), dtype=int)
+        n1_m[:] = self.n1
+        _gpaw.pair_densities(self.psit_nG, self.psit_nG,
+                             n1_m, self.n2_m, nt_mG)
+
+    def add_compensation_charges_block(self, nt_mG, rhot_mg):
+        """Add compensation charges to a block of pair densities.
+
+        The block is interpolated to the fine grid if needed and the
+        compensation charges of all pairs are added in a single LFC
+        pass over the grid."""
+
+        if self.finegrid:
+            self.density.interpolator.apply(nt_mG, rhot_mg)
+        else:
+            rhot_mg[:] = nt_mG
+
+        Q_amL = {}
+        for a, P_ni in self.P_ani.items():
+            assert P_ni.dtype == float
+            P1_i = P_ni[self.n1]
+            Delta_pL = self.density.setups[a].Delta_pL
+            Q_mL = np.empty((len(self.n2_m), Delta_pL.shape[1]))
+            for m, n2 in enumerate(self.n2_m):
+                D_ii = np.outer(P1_i.conj(), P_ni[n2])
+                D_p = pack(D_ii, tolerance=1e30)
+                Q_mL[m] = np.dot(D_p, Delta_pL)
+            Q_amL[a] = Q_mL
+
+        if self.finegrid:
+            self.density.ghat.add(rhot_mg, Q_amL)
+        else:
+            self.density.Ghat.add(rhot_mg, Q_amL)
+
 
 class PairDensity:
     def  __init__(self, paw):
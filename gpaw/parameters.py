@@ -4,7 +4,7 @@ from ase.units import Hartree
 from gpaw.poisson import PoissonSolver, FFTPoissonSolver
 from gpaw.occupations import FermiDirac
 from gpaw import parsize, parsize_bands, sl_default, sl_diagonalize, \
-                 sl_inverse_cholesky, sl_lcao, buffer_size
+                 sl_inverse_cholesky, sl_lcao, buffer_size, nthreads
 
 class InputParameters(dict):
     def __init__(self, **kwargs):
@@ -38,7 +38,8 @@ class InputParameters(dict):
                                  'sl_diagonalize':      sl_diagonalize,
                                  'sl_inverse_cholesky': sl_inverse_cholesky,
                                  'sl_lcao':             sl_lcao,
-                                 'buffer_size':         buffer_size}),
+                                 'buffer_size':         buffer_size,
+                                 'nthreads':            nthreads}),
             ('parsize',         None),
             ('parsize_bands',   None),
             ('parstride_bands', False),
@@ -29,7 +29,7 @@ from gpaw.wavefunctions.base import EmptyWaveFunctions
 from gpaw.wavefunctions.fd import FDWaveFunctions
 from gpaw.wavefunctions.lcao import LCAOWaveFunctions
 from gpaw.wavefunctions.pw import PW
-from gpaw.utilities.memory import MemNode, maxrss
+from gpaw.utilities.memory import MemNode, maxrss, malloc_stats
 from gpaw.parameters import InputParameters
 from gpaw.setup import Setups
 from gpaw.output import PAWTextOutput
@@ -320,6 +320,12 @@ class PAW(PAWTextOutput):
             world = mpi.world.new_communicator(np.asarray(world))
         self.wfs.world = world
 
+        if par.parallel.get('nthreads'):
+            # Threads per rank for the threaded C kernels (hybrid
+            # MPI+threads runs); overrides OMP_NUM_THREADS:
+            import _gpaw
+            _gpaw.set_num_threads(par.parallel['nthreads'])
+
         self.set_text(par.txt, par.verbose)
 
         natoms = len(atoms)
@@ -662,7 +668,9 @@ class PAW(PAWTextOutput):
 
         use mode='all' to write the wave functions.  cmr_params is a
         dictionary that allows you to specify parameters for CMR
-        (Computational Materials Repository).
+        (Computational Materials Repository).  Pass background=True to
+        let a thread on the master write the gpw file to disk while the
+        calculation continues (see gpaw.io.write).
         """
 
         self.timer.start('IO')
@@ -715,6 +723,15 @@ class PAW(PAWTextOutput):
             print >> txt, 'Memory breakdown may be incomplete'
         totalsize = mem.calculate_size()
         mem.write(txt, maxdepth=maxdepth)
+        # Compiled with -DGPAW_MALLOC_STATS, the extension counts its
+        # own allocations; show them so the estimate can be validated:
+        measured = malloc_stats()
+        if measured:
+            live = sum([s['live'] for s in measured.values()])
+            high = sum([s['high_water'] for s in measured.values()])
+            print >> txt, ('C extension buffers: %.2f MiB live, '
+                           '%.2f MiB high-water' %
+                           (live / float(1 << 20), high / float(1 << 20)))
 
     def converge_wave_functions(self):
         """Converge the wave-functions if not present."""
@@ -88,8 +88,17 @@ class PointCharges(Atoms, ElectrostaticPotential):
                                               float(z)),
                                     charge=float(q) ) )
 
-    def get_potential(self, gd=None):
-        """Create the Coulomb potential on the grid."""
+    def get_potential(self, gd=None, rcut=None, coarseness=4):
+        """Create the Coulomb potential on the grid.
+
+        By default the potential is a direct sum over all point
+        charges at every grid point.  With rcut given (in Bohr), only
+        charges closer than rcut to this domain enter the direct sum;
+        the remaining charges are summed on a coarseness times coarser
+        mesh and interpolated trilinearly.  Their potential varies on
+        the scale of rcut, so the interpolation error is of order
+        (coarseness * h / rcut)**2 while the cost of a large charge
+        distribution (QM/MM embedding) drops by coarseness**3."""
 
         if hasattr(self, 'potential'):
             if gd == self.gd or gd is None:
@@ -111,8 +120,26 @@ class PointCharges(Atoms, ElectrostaticPotential):
         self.pc_nc = pc_nc
         self.charge_n = charge_n
 
-        _gpaw.pc_potential(potential, pc_nc, charge_n,
-                           gd.beg_c, gd.end_c, gd.h_cv.diagonal())
+        if rcut is None:
+            _gpaw.pc_potential(potential, pc_nc, charge_n,
+                               gd.beg_c, gd.end_c, gd.h_cv.diagonal())
+        else:
+            h_c = gd.h_cv.diagonal().copy()
+            # Charges within rcut of this domain's bounding box:
+            d_nc = np.maximum(gd.beg_c * h_c - pc_nc,
+                              pc_nc - (gd.end_c - 1) * h_c)
+            near_n = d_nc.max(axis=1) < rcut
+
+            potential[:] = self._far_potential(gd, pc_nc[~near_n],
+                                               charge_n[~near_n],
+                                               coarseness)
+            if near_n.any():
+                near_pot = gd.empty()
+                _gpaw.pc_potential(near_pot,
+                                   np.ascontiguousarray(pc_nc[near_n]),
+                                   np.ascontiguousarray(charge_n[near_n]),
+                                   gd.beg_c, gd.end_c, h_c)
+                potential += near_pot
 
         # save grid descriptor and potential for future use
         self.potential = potential
@@ -120,6 +147,50 @@ class PointCharges(Atoms, ElectrostaticPotential):
 
         return potential
 
+    def _far_potential(self, gd, pc_nc, charge_n, m):
+        """Far-field potential, summed coarsely and interpolated.
+
+        The charges are summed directly on a mesh with spacing m * h
+        covering this domain and the result is interpolated trilinearly
+        to the fine grid."""
+
+        n_c = gd.end_c - gd.beg_c
+        if len(charge_n) == 0:
+            return np.zeros(tuple(n_c))
+
+        h_c = gd.h_cv.diagonal().copy()
+        # Coarse points at the fine positions beg_c + i * m; one extra
+        # point so that every fine point is bracketed:
+        nc_c = (n_c - 2) // m + 2
+        coarse_pot = np.empty(tuple(nc_c))
+        _gpaw.pc_potential(coarse_pot,
+                           np.ascontiguousarray(pc_nc - gd.beg_c * h_c),
+                           np.ascontiguousarray(charge_n),
+                           np.zeros(3, int), np.array(nc_c), m * h_c)
+
+        # Trilinear interpolation back to the fine grid:
+        i_cg = []
+        f_cg = []
+        for c in range(3):
+            g_g = np.arange(n_c[c])
+            # The last fine point may fall on the last coarse point -
+            # interpolate in the cell to the left of it:
+            i_g = np.minimum(g_g // m, nc_c[c] - 2)
+            i_cg.append(i_g)
+            f_cg.append(g_g / float(m) - i_g)
+        potential = np.zeros(tuple(n_c))
+        for c0 in range(2):
+            w0_g = np.abs(1 - c0 - f_cg[0])
+            for c1 in range(2):
+                w01_gg = np.outer(w0_g, np.abs(1 - c1 - f_cg[1]))
+                for c2 in range(2):
+                    w_ggg = (w01_gg[:, :, np.newaxis] *
+                             np.abs(1 - c2 - f_cg[2]))
+                    potential += w_ggg * coarse_pot[np.ix_(i_cg[0] + c0,
+                                                           i_cg[1] + c1,
+                                                           i_cg[2] + c2)]
+        return potential
+
     def get_nuclear_energy(self, nucleus):
         return -1. * nucleus.setup.Z * self.get_value(spos_c = nucleus.spos_c)
 
@@ -5,8 +5,9 @@ from math import pi
 import sys
 
 import numpy as np
-from numpy.fft import fftn, ifftn, fft2, ifft2
+from numpy.fft import fftn, ifftn, fft2, ifft2, fft, ifft
 
+from gpaw.grid_descriptor import GridDescriptor
 from gpaw.transformers import Transformer
 from gpaw.fd_operators import Laplace, LaplaceA, LaplaceB
 from gpaw import PoissonConvergenceError
@@ -19,10 +20,20 @@ import _gpaw
 
 
 class PoissonSolver:
-    def __init__(self, nn=3, relax='J', eps=2e-10):
+    def __init__(self, nn=3, relax='J', eps=2e-10, fmg=False,
+                 agglomerate=None, remove_moment=None):
         self.relax = relax
         self.nn = nn
         self.eps = eps
+        self.fmg = fmg
+        # Minimum number of grid points per rank; coarse levels below
+        # this threshold are replicated on all ranks and solved without
+        # communication (None: keep all levels distributed):
+        self.agglomerate = agglomerate
+        # Number of multipole moments (1, 4 or 9: s, s+p, s+p+d) to
+        # remove from the density of isolated systems before the
+        # multigrid solve - see solve():
+        self.remove_moment = remove_moment
         self.charged_periodic_correction = None
         self.maxiter = 1000
 
@@ -33,11 +44,15 @@ class PoissonSolver:
         elif relax == 'J':
             # Jacobi
             self.relax_method = 2
+        elif relax == 'RB':
+            # Red-black ordered Gauss-Seidel (vectorizable)
+            self.relax_method = 3
         else:
             raise NotImplementedError('Relaxation method %s' % relax)
-    
+
     def get_method(self):
-        return ['Gauss-Seidel', 'Jacobi'][self.relax_method - 1]
+        return ['Gauss-Seidel', 'Jacobi',
+                'red-black Gauss-Seidel'][self.relax_method - 1]
 
     def get_stencil(self):
         return self.nn
@@ -72,18 +87,42 @@ class PoissonSolver:
         # only used if 'J' (Jacobi) is chosen as method
         self.weights = [2.0 / 3.0]
 
+        self.gds = [gd]
+        self.agglevel = None
+        self.aggd = None
         while level < 4:
             try:
                 gd2 = gd.coarsen()
             except ValueError:
                 break
+            if (self.agglomerate and self.agglevel is None and
+                gd2.comm.size > 1 and
+                gd2.N_c.prod() < self.agglomerate * gd2.comm.size):
+                # Below the threshold halo exchange dominates the tiny
+                # sub-boxes.  Replicate the coarse problem on all ranks
+                # so the remaining levels run without communication.
+                # The transformers to and from this level still use the
+                # distributed descriptor:
+                self.agglevel = level + 1
+                self.aggd = gd2
+                self.interpolators.append(Transformer(gd2, gd,
+                                                      allocate=False))
+                self.restrictors.append(Transformer(gd, gd2,
+                                                    allocate=False))
+                gd2 = GridDescriptor(gd2.N_c, gd2.cell_cv, gd2.pbc_c,
+                                     mpi.serial_comm)
+                gd2.use_fixed_bc = gd.use_fixed_bc
+            else:
+                self.interpolators.append(Transformer(gd2, gd,
+                                                      allocate=False))
+                self.restrictors.append(Transformer(gd, gd2,
+                                                    allocate=False))
             self.operators.append(Laplace(gd2, scale, 1, allocate=False))
-            self.interpolators.append(Transformer(gd2, gd, allocate=False))
-            self.restrictors.append(Transformer(gd, gd2, allocate=False))
             self.presmooths.append(4)
             self.postsmooths.append(4)
             self.weights.append(1.0)
             level += 1
+            self.gds.append(gd2)
             gd = gd2
 
         self.levels = level
@@ -94,15 +133,23 @@ class PoissonSolver:
         self.rhos = [gd.empty()]
         self.phis = [None]
         self.residuals = [gd.empty()]
-        for level in range(self.levels):
-            gd2 = gd.coarsen()
+        for level in range(1, self.levels + 1):
+            gd2 = self.gds[level]
             self.phis.append(gd2.empty())
             self.rhos.append(gd2.empty())
             self.residuals.append(gd2.empty())
-            gd = gd2
         assert len(self.phis) == len(self.rhos)
-        level += 1
-        assert level == self.levels
+        level = self.levels
+
+        if self.agglevel is not None:
+            # Distributed buffers for crossing the agglomeration
+            # boundary, and this rank's slice of the replicated grid:
+            self.agg_rho_g = self.aggd.empty()
+            self.agg_phi_g = self.aggd.empty()
+            self.agg_slice = tuple([slice(b - n_p[0], e - n_p[0])
+                                    for b, e, n_p in zip(self.aggd.beg_c,
+                                                         self.aggd.end_c,
+                                                         self.aggd.n_cp)])
 
         for obj in self.operators + self.interpolators + self.restrictors:
             obj.allocate()
@@ -127,6 +174,35 @@ class PoissonSolver:
         if eps is None:
             eps = self.eps
 
+        if self.remove_moment:
+            # The zero boundary condition is what costs the V-cycles
+            # for isolated systems: the multipole tails of the density
+            # produce a slowly decaying potential that the box edge
+            # truncates.  Remove the lowest moments of the density with
+            # gaussians, solve for the rapidly decaying remainder and
+            # add the analytic gaussian potentials back afterwards:
+            assert not self.gd.pbc_c.any()
+            if not hasattr(self, 'gauss'):
+                self.gauss = Gaussian(self.gd)
+            rho_neutral = rho.copy()
+            phi_cor_L = []
+            for L in range(self.remove_moment):
+                phi_cor_L.append(self.gauss.remove_moment(rho_neutral, L))
+
+            # Subtract the corrections so that phi remains a good
+            # initial guess for the remainder problem:
+            if zero_initial_phi:
+                phi[:] = 0.0
+            else:
+                for phi_cor in phi_cor_L:
+                    phi -= phi_cor
+
+            niter = self.solve_neutral(phi, rho_neutral, eps=eps)
+
+            for phi_cor in phi_cor_L:
+                phi += phi_cor
+            return niter
+
         actual_charge = self.gd.integrate(rho)
         background = (actual_charge / self.gd.dv /
                       self.gd.get_size_of_global_array().prod())
@@ -198,9 +274,14 @@ class PoissonSolver:
         else:
             self.B.apply(rho, self.rhos[0])
 
+        if self.fmg:
+            # Full multigrid: build the starting guess from the bottom
+            # up instead of refining the incoming potential:
+            self.solve_fmg()
+
         niter = 1
         maxiter = self.maxiter
-        while self.iterate2(self.step) > eps and niter < maxiter:
+        while self.iterate2(self.step, eps=eps) > eps and niter < maxiter:
             niter += 1
         if niter == maxiter:
             charge = np.sum(rho.ravel()) * self.dv
@@ -217,6 +298,177 @@ class PoissonSolver:
 
         return niter
 
+    def solve_batch(self, phi_xg, rho_xg, charge_x=None, eps=None,
+                    maxcharge=1e-6):
+        """Solve a stack of independent Poisson problems together.
+
+        All right-hand sides run through the same V-cycles, so every
+        relaxation sweep and restriction exchanges the halos of the
+        whole stack in one message set per axis - many solves cost the
+        communication latency of one.  The initial guess is always
+        zero, and eps applies to the residual norm per field on
+        average.  Monopoles are handled per field as in solve(), so
+        neutral and charged densities can share a batch."""
+
+        if eps is None:
+            eps = self.eps
+
+        phi_xg[:] = 0.0
+
+        if self.remove_moment and not self.gd.pbc_c.any():
+            # Take the multipole tails of every field out with
+            # gaussians and put the analytic potentials back after the
+            # batched solve, as in solve():
+            if not hasattr(self, 'gauss'):
+                self.gauss = Gaussian(self.gd)
+            rho_xg = rho_xg.copy()
+            phi_cor_xg = np.zeros_like(phi_xg)
+            for rho_g, phi_cor_g in zip(rho_xg, phi_cor_xg):
+                for L in range(self.remove_moment):
+                    phi_cor_g += self.gauss.remove_moment(rho_g, L)
+            niter = self.solve_neutral_batch(phi_xg, rho_xg, eps=eps)
+            phi_xg += phi_cor_xg
+            return niter
+
+        actual_charge_x = self.gd.integrate(rho_xg)
+        background_x = (actual_charge_x / self.gd.dv /
+                        self.gd.get_size_of_global_array().prod())
+        if charge_x is None:
+            charge_x = actual_charge_x
+        else:
+            charge_x = np.asarray(charge_x, float)
+        newaxes = (slice(None), np.newaxis, np.newaxis, np.newaxis)
+
+        if abs(charge_x).max() <= maxcharge or self.gd.pbc_c.all():
+            # Neutral, or charged and periodic: subtract the per-field
+            # homogeneous backgrounds and shift the charged fields by
+            # the Ewald potential of a probe-charge lattice afterwards:
+            if (abs(charge_x).max() > maxcharge and
+                self.charged_periodic_correction is None):
+                self.charged_periodic_correction = madelung(self.gd.cell_cv)
+            niter = self.solve_neutral_batch(
+                phi_xg, rho_xg - background_x[newaxes], eps=eps)
+            if abs(charge_x).max() > maxcharge:
+                phi_xg += (charge_x *
+                           self.charged_periodic_correction)[newaxes]
+            return niter
+
+        elif not self.gd.pbc_c.any():
+            # Charged and non-periodic: remove the monopole moment of
+            # every field with a gaussian and put the analytic gaussian
+            # potential back afterwards (neutral fields get q ~ 0):
+            self.load_gauss()
+            q_x = actual_charge_x / np.sqrt(4 * pi)
+            niter = self.solve_neutral_batch(
+                phi_xg, rho_xg - q_x[newaxes] * self.rho_gauss, eps=eps)
+            phi_xg += q_x[newaxes] * self.phi_gauss
+            return niter
+
+        else:
+            # Charged with mixed boundary conditions
+            raise NotImplementedError
+
+    def solve_neutral_batch(self, phi_xg, rho_xg, eps=2e-10):
+        """Run the V-cycles of solve_neutral on a stack of fields.
+
+        Stacked per-level buffers are swapped into the multigrid
+        machinery for the duration of the solve; relax,
+        mg_restrict_residual and the transformers all take 4-d arrays
+        and bundle the halo exchange of the whole stack."""
+
+        nx = len(phi_xg)
+        saved = (self.phis, self.rhos, self.residuals)
+        self.phis = [phi_xg]
+        self.rhos = [self.gds[0].empty(nx)]
+        self.residuals = [self.gds[0].empty(nx)]
+        for level in range(1, self.levels + 1):
+            gd2 = self.gds[level]
+            self.phis.append(gd2.empty(nx))
+            self.rhos.append(gd2.empty(nx))
+            self.residuals.append(gd2.empty(nx))
+        if self.agglevel is not None:
+            saved_agg = (self.agg_rho_g, self.agg_phi_g)
+            self.agg_rho_g = self.aggd.empty(nx)
+            self.agg_phi_g = self.aggd.empty(nx)
+
+        if self.B is None:
+            self.rhos[0][:] = rho_xg
+        else:
+            self.B.apply(rho_xg, self.rhos[0])
+
+        try:
+            niter = 1
+            maxiter = self.maxiter
+            # iterate2 returns the residual norm summed over the stack:
+            while (self.iterate2(self.step, eps=eps * nx) > eps * nx and
+                   niter < maxiter):
+                niter += 1
+        finally:
+            self.phis, self.rhos, self.residuals = saved
+            if self.agglevel is not None:
+                self.agg_rho_g, self.agg_phi_g = saved_agg
+
+        if niter == maxiter:
+            msg = 'Poisson solver did not converge in %d iterations!' % maxiter
+            raise PoissonConvergenceError(msg)
+
+        # Set the average potential to zero in periodic systems
+        if np.alltrue(self.gd.pbc_c):
+            phi_ave_x = np.sum(phi_xg.reshape((nx, -1)), axis=1)
+            self.gd.comm.sum(phi_ave_x)
+            N_c = self.gd.get_size_of_global_array()
+            phi_ave_x /= np.product(N_c)
+            phi_xg -= phi_ave_x[:, np.newaxis, np.newaxis, np.newaxis]
+
+        return niter
+
+    def solve_fmg(self):
+        """Full-multigrid starting guess.
+
+        Restrict the charge all the way down, solve cheaply on the
+        coarsest grid and work back up with one V-cycle per level.
+        When the density has changed a lot since the last solve (early
+        SCF iterations, molecular dynamics), this replaces most of the
+        fine-grid V-cycles the previous potential would have needed.
+        Expects self.rhos[0] to be set; leaves the guess in
+        self.phis[0]."""
+
+        if self.levels == 0:
+            return
+
+        for level in range(self.levels):
+            if level + 1 == self.agglevel:
+                self.restrictors[level].apply(self.rhos[level],
+                                              self.agg_rho_g)
+                self.rhos[level + 1][:] = self.aggd.collect(self.agg_rho_g,
+                                                            broadcast=True)
+            else:
+                self.restrictors[level].apply(self.rhos[level],
+                                              self.rhos[level + 1])
+
+        level = self.levels
+        self.phis[level][:] = 0.0
+        self.operators[level].relax(self.relax_method,
+                                    self.phis[level],
+                                    self.rhos[level],
+                                    self.presmooths[level],
+                                    self.weights[level])
+
+        for level in range(self.levels - 1, 0, -1):
+            self.interpolators[level].apply(self.coarse_phi(level + 1),
+                                            self.phis[level])
+            self.iterate2(4.0**level * self.step, level)
+        self.interpolators[0].apply(self.coarse_phi(1), self.phis[0])
+
+    def coarse_phi(self, level):
+        """Return phis[level] in the layout the interpolator to the
+        level above expects (this rank's slice when the level is
+        replicated)."""
+        if level == self.agglevel:
+            self.agg_phi_g[:] = self.phis[level][(Ellipsis,) + self.agg_slice]
+            return self.agg_phi_g
+        return self.phis[level]
+
     def iterate(self, step, level=0):
         residual = self.residuals[level]
         niter = 0
@@ -242,38 +494,122 @@ class PoissonSolver:
 
         return error
 
-    def iterate2(self, step, level=0):
-        """Smooths the solution in every multigrid level"""
+    def iterate2(self, step, level=0, eps=None):
+        """Smooths the solution in every multigrid level.
+
+        The convergence measure is the residual norm that the relax
+        kernel accumulates for free during its final sweep - measured
+        at the start of that sweep, so it never declares convergence
+        early.  When eps is given and the presmooth already meets it,
+        the coarse-grid correction and post-smooth are skipped."""
 
         residual = self.residuals[level]
 
         if level < self.levels:
-            self.operators[level].relax(self.relax_method,
-                                        self.phis[level],
-                                        self.rhos[level],
-                                        self.presmooths[level],
-                                        self.weights[level])
-
-            self.operators[level].apply(self.phis[level], residual)
-            residual -= self.rhos[level]
-            self.restrictors[level].apply(residual,
-                                          self.rhos[level + 1])
+            error = self.operators[level].relax(self.relax_method,
+                                                self.phis[level],
+                                                self.rhos[level],
+                                                self.presmooths[level],
+                                                self.weights[level])
+            if level == 0 and eps is not None:
+                error = self.gd.comm.sum(error) * self.dv
+                if error < eps:
+                    return error
+
+            # Fused in C: residual = A phi - rho, restricted to the
+            # next level in the same call:
+            if level + 1 == self.agglevel:
+                _gpaw.mg_restrict_residual(self.operators[level].operator,
+                                           self.restrictors[level].transformer,
+                                           self.phis[level], self.rhos[level],
+                                           residual, self.agg_rho_g)
+                self.rhos[level + 1][:] = self.aggd.collect(self.agg_rho_g,
+                                                            broadcast=True)
+            else:
+                _gpaw.mg_restrict_residual(self.operators[level].operator,
+                                           self.restrictors[level].transformer,
+                                           self.phis[level], self.rhos[level],
+                                           residual, self.rhos[level + 1])
             self.phis[level + 1][:] = 0.0
             self.iterate2(4.0 * step, level + 1)
-            self.interpolators[level].apply(self.phis[level + 1], residual)
+            self.interpolators[level].apply(self.coarse_phi(level + 1),
+                                            residual)
             self.phis[level] -= residual
 
-        self.operators[level].relax(self.relax_method,
-                                    self.phis[level],
-                                    self.rhos[level],
-                                    self.postsmooths[level],
-                                    self.weights[level])
+        error = self.operators[level].relax(self.relax_method,
+                                            self.phis[level],
+                                            self.rhos[level],
+                                            self.postsmooths[level],
+                                            self.weights[level])
         if level == 0:
-            self.operators[level].apply(self.phis[level], residual)
-            residual -= self.rhos[level]
-            error = self.gd.comm.sum(np.dot(residual.ravel(),
-                                             residual.ravel())) * self.dv
-            return error
+            # The fused norm replaces the extra full stencil
+            # application that used to compute the error here:
+            return self.gd.comm.sum(error) * self.dv
+
+    # Redistributions between the domain decomposition and the slab
+    # decompositions used by the FFT-based subclasses: full xy-planes
+    # for a slab of z-indices (r-distribution) and full z-columns for a
+    # slab of flattened (x, y) rows (k-distribution).
+    def scatter_r_distribution(self, global_rho_g, dtype=float):
+        d1, d2, d3 = self.d1, self.d2, self.d3
+        comm = self.gd.comm
+        index = self.r_distribution[comm.rank]
+        if comm.rank == 0:
+            rho_g1 = global_rho_g[:, :, index]
+            for i in range(1, comm.size):
+                ind = self.r_distribution[i]
+                comm.ssend(global_rho_g[:, :, ind].copy(), i, 178)
+        else:
+            rho_g1 = np.zeros([d1, d2, len(index)], dtype=dtype)
+            comm.receive(rho_g1, 0, 178)
+        return rho_g1
+
+    def gather_r_distribution(self, rho_g, dtype=complex):
+        comm = self.gd.comm
+        index = self.r_distribution[comm.rank]
+        d1, d2, d3 = self.d1, self.d2, self.d3
+        if comm.rank == 0:
+            global_rho_g = np.zeros([d1, d2, d3], dtype)
+            global_rho_g[:, :, index] = rho_g
+            for i in range(1, comm.size):
+                ind = self.r_distribution[i]
+                rho_gi = np.zeros([d1, d2, len(ind)], dtype)
+                comm.receive(rho_gi, i, 368)
+                global_rho_g[:, :, ind] = rho_gi
+        else:
+            comm.ssend(rho_g, 0, 368)
+            global_rho_g = None
+        return global_rho_g
+
+    def scatter_k_distribution(self, global_rho_g):
+        comm = self.gd.comm
+        index = self.k_distribution[comm.rank]
+        if comm.rank == 0:
+            rho_g = global_rho_g[index]
+            for i in range(1, comm.size):
+                ind = self.k_distribution[i]
+                comm.ssend(global_rho_g[ind], i, 370)
+        else:
+            rho_g = np.zeros([len(index), self.d3], dtype=complex)
+            comm.receive(rho_g, 0, 370)
+        return rho_g
+
+    def gather_k_distribution(self, phi_g):
+        comm = self.gd.comm
+        index = self.k_distribution[comm.rank]
+        d12 = self.d1 * self.d2
+        if comm.rank == 0:
+            global_phi_g = np.zeros([d12, self.d3], dtype=complex)
+            global_phi_g[index] = phi_g
+            for i in range(1, comm.size):
+                ind = self.k_distribution[i]
+                phi_gi = np.zeros([len(ind), self.d3], dtype=complex)
+                comm.receive(phi_gi, i, 569)
+                global_phi_g[ind] = phi_gi
+        else:
+            comm.ssend(phi_g, 0, 569)
+            global_phi_g = None
+        return global_phi_g
 
     def estimate_memory(self, mem):
         # XXX Memory estimate works only for J and GS, not FFT solver
@@ -309,6 +645,7 @@ class PoissonFFTSolver(PoissonSolver):
 
     def __init__(self):
         self.charged_periodic_correction = None
+        self.remove_moment = None
 
     def get_method(self):
         return 'FFT solver of the first kind'
@@ -335,7 +672,13 @@ class PoissonFFTSolver(PoissonSolver):
 
 
 class FFTPoissonSolver(PoissonSolver):
-    """FFT Poisson solver for general unit cells."""
+    """FFT Poisson solver for fully periodic unit cells.
+
+    The transform is slab-decomposed: every rank transforms the
+    xy-planes of its z-slab, the data is transposed to z-columns for a
+    slab of (x, y) rows where the division by k^2 and the z-transform
+    happen, and the result is transposed and transformed back.  Cells
+    with non-periodic directions fall back to the multigrid solver."""
 
     relax_method = 0
     nn = 999
@@ -343,28 +686,107 @@ class FFTPoissonSolver(PoissonSolver):
     def __init__(self, eps=2e-10):
         self.charged_periodic_correction = None
         self.eps = eps
+        self.use_fft = True
+        self.fmg = False
+        self.agglomerate = None
+        self.remove_moment = None
 
     def get_method(self):
-        return 'FFT solver of the second kind'
+        if self.use_fft:
+            return 'FFT solver of the second kind'
+        return 'multigrid fallback (%s)' % PoissonSolver.get_method(self)
 
     def set_grid_descriptor(self, gd):
-        assert gd.pbc_c.all()
+        if not gd.pbc_c.all():
+            # Non-periodic directions - the FFT solve does not apply.
+            # Configure the multigrid machinery of the base class:
+            self.use_fft = False
+            self.relax = 'J'
+            self.relax_method = 2
+            self.nn = 3
+            self.maxiter = 1000
+            PoissonSolver.set_grid_descriptor(self, gd)
+            return
         self.gd = gd
 
     def initialize(self):
-        if self.gd.comm.rank == 0:
-            self.k2_Q, self.N3 = construct_reciprocal(self.gd)
+        if not self.use_fft:
+            PoissonSolver.initialize(self)
+            return
+
+        gd = self.gd
+        comm = gd.comm
+        self.d1, self.d2, self.d3 = gd.N_c
+
+        self.r_distribution = np.array_split(np.arange(self.d3), comm.size)
+        self.k_distribution = np.array_split(np.arange(self.d1 * self.d2),
+                                             comm.size)
+        self.comm_reshape = not (gd.parsize_c[0] == 1 and
+                                 gd.parsize_c[1] == 1)
+
+        # Every rank only keeps the rows of 4*pi/k^2 for its slab of
+        # (x, y) indices:
+        index = self.k_distribution[comm.rank]
+        self.poisson_factor = np.zeros([len(index), self.d3])
+        if comm.rank == 0:
+            k2_Q, self.N3 = construct_reciprocal(gd)
+            k2_Q.shape = (self.d1 * self.d2, self.d3)
+            self.poisson_factor[:] = 4.0 * pi / k2_Q[index]
+            for r in range(1, comm.size):
+                ind = self.k_distribution[r]
+                comm.ssend(4.0 * pi / k2_Q[ind], r, 701)
+        else:
+            comm.receive(self.poisson_factor, 0, 701)
 
     def solve_neutral(self, phi_g, rho_g, eps=None):
+        if not self.use_fft:
+            return PoissonSolver.solve_neutral(self, phi_g, rho_g, eps)
+
         if self.gd.comm.size == 1:
-            phi_g[:] = ifftn(fftn(rho_g) * 4.0 * pi / self.k2_Q).real
+            factor_Q = self.poisson_factor.reshape(self.d1, self.d2, self.d3)
+            phi_g[:] = ifftn(fftn(rho_g) * factor_Q).real
+            return 1
+
+        if self.comm_reshape:
+            global_rho_g = self.gd.collect(rho_g)
+            rho_g1 = self.scatter_r_distribution(global_rho_g)
         else:
-            rho_g = self.gd.collect(rho_g)
-            if self.gd.comm.rank == 0:
-                globalphi_g = ifftn(fftn(rho_g) * 4.0 * pi / self.k2_Q).real
-            else:
-                globalphi_g = None
-            self.gd.distribute(globalphi_g, phi_g)
+            rho_g1 = rho_g
+
+        # Transform the xy-planes of the local z-slab.
+        # use copy() to avoid the C_contiguous=False
+        rho_g2 = fft2(rho_g1, None, (0, 1)).copy()
+
+        # Transpose to full z-columns for a slab of (x, y) rows:
+        global_rho_g = self.gather_r_distribution(rho_g2)
+        if self.gd.comm.rank == 0:
+            global_rho_g.shape = (self.d1 * self.d2, self.d3)
+        rho_g3 = self.scatter_k_distribution(global_rho_g)
+
+        # Transform along z, divide by k^2 and transform back:
+        phi_g1 = ifft(fft(rho_g3, axis=1) * self.poisson_factor, axis=1)
+
+        # Transpose back and invert the xy-transform:
+        global_phi_g = self.gather_k_distribution(phi_g1)
+        if self.gd.comm.rank == 0:
+            global_phi_g.shape = (self.d1, self.d2, self.d3)
+        phi_g2 = self.scatter_r_distribution(global_phi_g, dtype=complex)
+        phi_g3 = ifft2(phi_g2, None, (0, 1)).real.copy()
+        if self.comm_reshape:
+            global_phi_g = self.gather_r_distribution(phi_g3, dtype=float)
+            self.gd.distribute(global_phi_g, phi_g)
+        else:
+            phi_g[:] = phi_g3
+        return 1
+
+    def solve_neutral_batch(self, phi_xg, rho_xg, eps=2e-10):
+        if not self.use_fft:
+            return PoissonSolver.solve_neutral_batch(self, phi_xg, rho_xg,
+                                                     eps)
+        # The FFT solve is direct and has no halo exchange to share -
+        # just solve the fields one by one:
+        for phi_g, rho_g in zip(phi_xg, rho_xg):
+            self.solve_neutral(phi_g, rho_g, eps)
         return 1
 
 
@@ -460,67 +882,6 @@ class FixedBoundaryPoissonSolver(PoissonSolver):
         self.solve_neutral(phi_g, rho_g - background)
         phi_g += actual_charge * self.charged_periodic_correction
 
-    def scatter_r_distribution(self, global_rho_g, dtype=float):
-        d1, d2, d3 = self.d1, self.d2, self.d3
-        comm = self.gd.comm
-        index = self.r_distribution[comm.rank]
-        if comm.rank == 0:
-            rho_g1 = global_rho_g[:, :, index]
-            for i in range(1, comm.size):
-                ind = self.r_distribution[i]
-                comm.ssend(global_rho_g[:, :, ind].copy(), i, 178)
-        else:
-            rho_g1 = np.zeros([d1, d2, len(index)], dtype=dtype)
-            comm.receive(rho_g1, 0, 178)
-        return rho_g1
-
-    def gather_r_distribution(self, rho_g, dtype=complex):
-        comm = self.gd.comm
-        index = self.r_distribution[comm.rank]
-        d1, d2, d3 = self.d1, self.d2, self.d3
-        if comm.rank == 0:
-            global_rho_g = np.zeros([d1, d2, d3], dtype)
-            global_rho_g[:, :, index] = rho_g
-            for i in range(1, comm.size):
-                ind = self.r_distribution[i]
-                rho_gi = np.zeros([d1, d2, len(ind)], dtype)
-                comm.receive(rho_gi, i, 368)
-                global_rho_g[:, :, ind] = rho_gi
-        else:
-            comm.ssend(rho_g, 0, 368)
-            global_rho_g = None
-        return global_rho_g
-
-    def scatter_k_distribution(self, global_rho_g):
-        comm = self.gd.comm
-        index = self.k_distribution[comm.rank]
-        if comm.rank == 0:
-            rho_g = global_rho_g[index]
-            for i in range(1, comm.size):
-                ind = self.k_distribution[i]
-                comm.ssend(global_rho_g[ind], i, 370)
-        else:
-            rho_g = np.zeros([len(index), self.d3], dtype=complex)
-            comm.receive(rho_g, 0, 370)
-        return rho_g
-
-    def gather_k_distribution(self, phi_g):
-        comm = self.gd.comm
-        index = self.k_distribution[comm.rank]
-        d12 = self.d1 * self.d2
-        if comm.rank == 0:
-            global_phi_g = np.zeros([d12, self.d3], dtype=complex)
-            global_phi_g[index] = phi_g
-            for i in range(1, comm.size):
-                ind = self.k_distribution[i]
-                phi_gi = np.zeros([len(ind), self.d3], dtype=complex)
-                comm.receive(phi_gi, i, 569)
-                global_phi_g[ind] = phi_gi
-        else:
-            comm.ssend(phi_g, 0, 569)
-            global_phi_g = None
-        return global_phi_g
-
     def solve_neutral(self, phi_g, rho_g):
         # b_phi1 and b_phi2 are the boundary Hartree potential values
         # of left and right sides
@@ -93,8 +93,9 @@ class BASECHI:
         self.nG = calc.get_number_of_grid_points()
         self.nG0 = self.nG[0] * self.nG[1] * self.nG[2]
         gd = GridDescriptor(self.nG, calc.wfs.gd.cell_cv, pbc_c=True, comm=serial_comm)
-        self.gd = gd        
+        self.gd = gd
         self.h_cv = gd.h_cv
+        kd.initialize_phases(gd.sdisp_cd)
 
         # obtain eigenvalues, occupations
         nibzkpt = kd.nibzkpts
@@ -310,7 +311,7 @@ class BASECHI:
                 dpsit_g = gd.empty(dtype=complex)
                 tmp = np.zeros((3), dtype=complex)
     
-                phase_cd = np.exp(2j * pi * gd.sdisp_cd * bzk_kc[kq_k[k], :, np.newaxis])
+                phase_cd = kd.get_phases(bzk_kc[kq_k[k]])
                 for ix in range(3):
                     d_c[ix](psit2_g, dpsit_g, phase_cd)
                     tmp[ix] = gd.integrate(psit1_g.conj() * dpsit_g)
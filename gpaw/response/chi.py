@@ -4,7 +4,7 @@ import numpy as np
 from math import sqrt, pi
 from ase.units import Hartree, Bohr
 from gpaw import extra_parameters
-from gpaw.utilities.blas import gemv, scal, axpy
+from gpaw.utilities.blas import gemm, gemv, scal, axpy
 from gpaw.mpi import world, rank, size, serial_comm
 from gpaw.fd_operators import Gradient
 from gpaw.response.math_func import hilbert_transform, full_hilbert_transform
@@ -152,7 +152,6 @@ class CHI(BASECHI):
         calc = self.calc
         kd = self.kd
         gd = self.gd
-        sdisp_cd = gd.sdisp_cd
         ibzk_kc = self.ibzk_kc
         bzk_kc = self.bzk_kc
         kq_k = self.kq_k
@@ -176,6 +175,31 @@ class CHI(BASECHI):
             tmp = np.zeros((3), dtype=complex)
 
         rho_G = np.zeros(self.npw, dtype=complex)
+
+        # The pair densities do not depend on frequency, so without
+        # hilbert transform they are queued up and applied to all local
+        # frequencies at once: one zgemm per frequency instead of one
+        # rank-1 update per pair and frequency.  With a serial ground
+        # state calculator (no collectives in get_wavefunction) the
+        # band pairs are additionally split over the frequency
+        # communicator, so each pair density is built once in the whole
+        # world and shared by broadcasting the npw vector.
+        wsize = 1
+        if not self.hilbert_trans:
+            if calc.wfs.world.size == 1:
+                wsize = self.wcomm.size
+            w_w = self.w_w[self.wstart:self.wend] / Hartree
+            npair = 0
+            rho_xG = []
+            focc_x = []
+            de_x = []
+
+        # Flat index into the fft box - one fancy-index gather per pair
+        # instead of a python loop over planewaves:
+        index_G3 = np.array([self.Gindex_G[iG] for iG in range(self.npw)])
+        Gindex_G = ((index_G3[:, 0] * self.nG[1] + index_G3[:, 1]) *
+                    self.nG[2] + index_G3[:, 2])
+
         t0 = time()
         t_get_wfs = 0
         for k in range(self.kstart, self.kend):
@@ -205,6 +229,13 @@ class CHI(BASECHI):
 			check_focc = (f_kn[ibzkpt1, n] - f_kn[ibzkpt2, m]) > self.ftol
                     else:
                         check_focc = np.abs(f_kn[ibzkpt1, n] - f_kn[ibzkpt2, m]) > self.ftol
+                        if check_focc and wsize > 1:
+                            # Deterministic round-robin split of the
+                            # pairs over the frequency communicator
+                            # (f_kn is replicated, so all ranks count
+                            # the same pairs):
+                            check_focc = npair % wsize == self.wcomm.rank
+                            npair += 1
 
                     t1 = time()
                     psitold_g = self.get_wavefunction(ibzkpt2, m, check_focc, spin=spin)
@@ -218,12 +249,10 @@ class CHI(BASECHI):
                         # fft
                         tmp_g = np.fft.fftn(psit2_g*psit1_g) * self.vol / self.nG0
 
-                        for iG in range(self.npw):
-                            index = self.Gindex_G[iG]
-                            rho_G[iG] = tmp_g[index[0], index[1], index[2]]
+                        rho_G[:] = tmp_g.ravel()[Gindex_G]
 
                         if self.optical_limit:
-                            phase_cd = np.exp(2j * pi * sdisp_cd * bzk_kc[kq_k[k], :, np.newaxis])
+                            phase_cd = kd.get_phases(bzk_kc[kq_k[k]])
                             for ix in range(3):
                                 d_c[ix](psit2_g, dpsit_g, phase_cd)
                                 tmp[ix] = gd.integrate(psit1_g * dpsit_g)
@@ -237,15 +266,14 @@ class CHI(BASECHI):
                         if self.optical_limit:
                             rho_G[0] /= e_kn[ibzkpt2, m] - e_kn[ibzkpt1, n]
 
-                        rho_GG = np.outer(rho_G, rho_G.conj())
-                        
                         if not self.hilbert_trans:
-                            for iw in range(self.Nw_local):
-                                w = self.w_w[iw + self.wstart] / Hartree
-                                C =  (f_kn[ibzkpt1, n] - f_kn[ibzkpt2, m]) / (
-                                     w + e_kn[ibzkpt1, n] - e_kn[ibzkpt2, m] + 1j * self.eta)
-                                axpy(C, rho_GG, chi0_wGG[iw])
+                            # Queue the pair; the frequency loop is
+                            # done blockwise after the m loop.
+                            rho_xG.append(rho_G.copy())
+                            focc_x.append(f_kn[ibzkpt1, n] - f_kn[ibzkpt2, m])
+                            de_x.append(e_kn[ibzkpt1, n] - e_kn[ibzkpt2, m])
                         else:
+                            rho_GG = np.outer(rho_G, rho_G.conj())
                             focc = f_kn[ibzkpt1,n] - f_kn[ibzkpt2,m]
                             w0 = e_kn[ibzkpt2,m] - e_kn[ibzkpt1,n]
                             scal(focc, rho_GG)
@@ -266,6 +294,40 @@ class CHI(BASECHI):
 #                            for wi in range(self.NwS_local):
 #                                if deltaw[wi + self.wS1] > 1e-8:
 #                                    specfunc_wGG[wi] += tmp_GG * deltaw[wi + self.wS1]
+                if not self.hilbert_trans:
+                    # Apply the queued pair densities: the whole block
+                    # enters chi0 through one zgemm per local frequency.
+                    for r in range(wsize):
+                        if wsize > 1:
+                            nx_w = np.zeros(1, dtype=int)
+                            if r == self.wcomm.rank:
+                                nx_w[0] = len(rho_xG)
+                            self.wcomm.broadcast(nx_w, r)
+                            nx = nx_w[0]
+                            if nx == 0:
+                                continue
+                            if r == self.wcomm.rank:
+                                block_xG = np.array(rho_xG)
+                                C_bx = np.array([focc_x, de_x])
+                            else:
+                                block_xG = np.zeros((nx, self.npw),
+                                                    dtype=complex)
+                                C_bx = np.zeros((2, nx))
+                            self.wcomm.broadcast(block_xG, r)
+                            self.wcomm.broadcast(C_bx, r)
+                        else:
+                            if len(rho_xG) == 0:
+                                continue
+                            block_xG = np.array(rho_xG)
+                            C_bx = np.array([focc_x, de_x])
+                        for iw in range(self.Nw_local):
+                            C_x = C_bx[0] / (w_w[iw] + C_bx[1] +
+                                             1j * self.eta)
+                            gemm(1.0, block_xG.conj(),
+                                 block_xG.T * C_x, 1.0, chi0_wGG[iw])
+                    rho_xG = []
+                    focc_x = []
+                    de_x = []
                 if self.nkpt == 1:
                     if n == 0:
                         dt = time() - t0
@@ -289,7 +351,7 @@ class CHI(BASECHI):
         self.printtxt('Finished summation over k')
 
         self.kcomm.barrier()
-        del rho_GG, rho_G
+        del rho_G
         # Hilbert Transform
         if not self.hilbert_trans:
             self.kcomm.sum(chi0_wGG)
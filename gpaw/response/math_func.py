@@ -15,36 +15,39 @@ def delta_function(x0, dx, Nx, sigma):
     return deltax / (2. * sqrt(pi * sigma))
 
 
-def hilbert_transform(specfunc_wGG, Nw, dw, eta):
-
-    NwS = specfunc_wGG.shape[0]
-    tmp_ww = np.zeros((Nw, NwS), dtype=complex)
-
-    for iw in range(Nw):
-        w = iw * dw
-        for jw in range(NwS):
-            ww = jw * dw 
-            tmp_ww[iw, jw] = 1. / (w - ww + 1j*eta) - 1. / (w + ww + 1j*eta)
+def _hilbert_transform(specfunc_wGG, Nw, dw, eta, full):
+    """Spectral transform of a (local block of the) spectral function.
+
+    Uses the threaded C kernel when available (the kernel weights are
+    generated on the fly, so no (Nw, NwS) matrix is stored); otherwise
+    falls back to building the weight matrix and one gemm."""
+
+    import _gpaw
+    sshape = specfunc_wGG.shape
+    if hasattr(_gpaw, 'hilbert_transform'):
+        spec_wg = specfunc_wGG.reshape(sshape[0], -1)
+        chi0_wg = np.empty((Nw, spec_wg.shape[1]), dtype=complex)
+        _gpaw.hilbert_transform(spec_wg, chi0_wg, dw, eta, int(full))
+        return chi0_wg.reshape((Nw,) + sshape[1:])
+
+    NwS = sshape[0]
+    w_w = dw * np.arange(Nw)
+    ws_w = dw * np.arange(NwS)
+    sign = full and -1j or 1j
+    tmp_ww = (1. / (w_w[:, np.newaxis] - ws_w + sign * eta) -
+              1. / (w_w[:, np.newaxis] + ws_w + 1j * eta))
 
     chi0_wGG = gemmdot(tmp_ww, specfunc_wGG, beta = 0.)
 
     return chi0_wGG * dw
 
 
-def full_hilbert_transform(specfunc_wGG, Nw, dw, eta):
-
-    NwS = specfunc_wGG.shape[0]
-    tmp_ww = np.zeros((Nw, NwS), dtype=complex)
-
-    for iw in range(Nw):
-        w = iw * dw
-        for jw in range(NwS):
-            ww = jw * dw
-            tmp_ww[iw, jw] = 1. / (w - ww - 1j*eta) - 1. / (w + ww + 1j*eta)
+def hilbert_transform(specfunc_wGG, Nw, dw, eta):
+    return _hilbert_transform(specfunc_wGG, Nw, dw, eta, full=False)
 
-    chi0_wGG = gemmdot(tmp_ww, specfunc_wGG, beta = 0.)
 
-    return chi0_wGG * dw
+def full_hilbert_transform(specfunc_wGG, Nw, dw, eta):
+    return _hilbert_transform(specfunc_wGG, Nw, dw, eta, full=True)
 
 
 def two_phi_planewave_integrals(k_Gv, setup=None, rgd=None, phi_jg=None,
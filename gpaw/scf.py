@@ -1,6 +1,7 @@
 import numpy as np
 
 from gpaw import KohnShamConvergenceError
+from gpaw.utilities.regions import region_begin, region_end
 
 
 class SCFLoop:
@@ -43,24 +44,39 @@ class SCFLoop:
             return
         
         for iter in range(1, self.maxiter + 1):
+            region_begin('SCF/eigensolver')
             wfs.eigensolver.iterate(hamiltonian, wfs)
+            region_end('SCF/eigensolver')
+            region_begin('SCF/occupations')
             occupations.calculate(wfs)
+            region_end('SCF/occupations')
             # XXX ortho, dens, wfs?
 
             energy = hamiltonian.get_energy(occupations)
             self.energies.append(energy)
             self.check_convergence(density, wfs.eigensolver)
             yield iter
-            
+
             if self.converged:
                 break
 
             if iter > self.niter_fixdensity:
+                region_begin('SCF/density')
                 density.update(wfs)
+                region_end('SCF/density')
+                region_begin('SCF/hamiltonian')
                 hamiltonian.update(density)
+                region_end('SCF/hamiltonian')
             else:
                 hamiltonian.npoisson = 0
 
+            if iter % 5 == 0:
+                # Move k-points from slow to fast ranks if the measured
+                # iteration times have drifted apart:
+                region_begin('SCF/rebalance')
+                wfs.rebalance_kpoints()
+                region_end('SCF/rebalance')
+
         # Don't fix the density in the next step:
         self.niter_fixdensity = 0
         
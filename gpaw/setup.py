@@ -24,7 +24,7 @@ from gpaw.basis_data import Basis
 from gpaw.gaunt import gaunt as G_LLL, Y_LLv
 from gpaw.spline import Spline
 from gpaw.grid_descriptor import RadialGridDescriptor
-from gpaw.utilities import unpack, pack, hartree, divrl
+from gpaw.utilities import unpack, pack, hartree, hartree_batch, divrl
 from gpaw.rotation import rotation
 from gpaw import extra_parameters
 
@@ -74,6 +74,31 @@ class BaseSetup:
     def get_basis_description(self):
         return self.basis.get_description()
 
+    def share_radial_data(self, comm):
+        """Keep one copy per node of the large immutable tables.
+
+        The radial data, the Coulomb correction matrix and the xc
+        correction tables come out identical on every rank, so they
+        are re-pointed at node-shared read-only memory and the private
+        copies are freed.  Collective on comm; call only after the
+        setup is fully constructed - the shared arrays cannot be
+        written to."""
+        from gpaw.mpi import shared_array
+        for obj in [self, getattr(self, 'data', None),
+                    getattr(self, 'xc_correction', None)]:
+            if obj is None:
+                continue
+            for name in ['M_pp', 'Delta_Lii', 'nc_g', 'nct_g',
+                         'n_qg', 'nt_qg', 'tau_npg', 'taut_npg',
+                         'vbar_g', 'tauc_g', 'phicorehole_g',
+                         'phi_jg', 'pt_jg']:
+                a = getattr(obj, name, None)
+                if isinstance(a, np.ndarray):
+                    setattr(obj, name, shared_array(a, comm))
+                elif (isinstance(a, list) and len(a) > 0 and
+                      isinstance(a[0], np.ndarray)):
+                    setattr(obj, name, [shared_array(b, comm) for b in a])
+
     def calculate_initial_occupation_numbers(self, magmom, hund, charge,
                                              nspins, f_j=None):
         """If f_j is specified, custom occupation numbers will be used.
@@ -387,6 +412,7 @@ class LeanSetup(BaseSetup):
         self.K_p = s.K_p
         self.MB = s.MB
         self.MB_p = s.MB_p
+        self.dH0_p = s.dH0_p
 
         self.dO_ii = s.dO_ii
 
@@ -652,15 +678,21 @@ class Setup(BaseSetup):
             yrrdr_g *= r_g * dr_g
             return yrrdr_g
 
+        # ... and for a batch of densities with a common l:
+        def H_batch(n_qg, l):
+            yrrdr_qg = np.zeros_like(n_qg)
+            nrdr_qg = n_qg * r_g * dr_g
+            hartree_batch(l, nrdr_qg, beta, ng, yrrdr_qg)
+            yrrdr_qg *= r_g * dr_g
+            return yrrdr_qg
+
         wnc_g = H(nc_g, l=0)
         wnct_g = H(nct_g, l=0)
 
         self.wg_lg = wg_lg = [H(g_lg[l], l) for l in range(lmax + 1)]
 
-        wn_lqg = [np.array([H(n_qg[q], l) for q in range(nq)])
-                  for l in range(2 * lcut + 1)]
-        wnt_lqg = [np.array([H(nt_qg[q], l) for q in range(nq)])
-                   for l in range(2 * lcut + 1)]
+        wn_lqg = [H_batch(n_qg, l) for l in range(2 * lcut + 1)]
+        wnt_lqg = [H_batch(nt_qg, l) for l in range(2 * lcut + 1)]
 
         rdr_g = r_g * dr_g
         dv_g = r_g * rdr_g
@@ -722,6 +754,10 @@ class Setup(BaseSetup):
 
         self.Nct = data.get_smooth_core_density_integral(Delta0)
         self.K_p = data.get_linear_kinetic_correction(T_Lqp[0])
+        # Constant part of the atomic hamiltonian: the kinetic, Hartree
+        # and vbar linear corrections never change for a given setup,
+        # so combine them once instead of once per SCF iteration:
+        self.dH0_p = self.K_p + self.M_p + self.MB_p
         
         r = 0.02 * rcut2 * np.arange(51, dtype=float)
         alpha = data.rcgauss**-2
@@ -1002,11 +1038,28 @@ class Setups(list):
         self.setups = {}
         natoms = {}
         self.id_a = zip(Z_a, type_a, basis_a)
+        ids = []
         for id in self.id_a:
-            setup = self.setups.get(id)
-            if setup is None:
-                Z, type, basis = id
-                symbol = chemical_symbols[Z]
+            if id not in natoms:
+                natoms[id] = 0
+                ids.append(id)
+            natoms[id] += 1
+
+        # Building a setup takes seconds (spline fits and radial
+        # integrals), and every rank would redo the same work for
+        # every species.  With several species and several ranks, deal
+        # the species out round-robin and broadcast the finished
+        # objects instead:
+        distribute = world is not None and world.size > 1 and len(ids) > 1
+        if distribute:
+            from gpaw.mpi import broadcast
+
+        for i, id in enumerate(ids):
+            Z, type, basis = id
+            symbol = chemical_symbols[Z]
+            if distribute and world.rank != i % world.size:
+                setup = None
+            else:
                 setupdata = None
                 if not isinstance(type, str):
                     setupdata = type
@@ -1014,13 +1067,29 @@ class Setups(list):
                 # (meaning we load the basis set now from a file) or an actual
                 # pre-created Basis object (meaning we just pass it along)
                 if isinstance(basis, str):
-                    basis = Basis(symbol, basis, world=world)
+                    # When construction is distributed, the owner reads
+                    # the files alone instead of collectively:
+                    basis = Basis(symbol, basis,
+                                  world=None if distribute else world)
                 setup = create_setup(symbol, xc, lmax, type,
-                                     basis, setupdata=setupdata, world=world)
-                self.setups[id] = setup
-                natoms[id] = 0
-            natoms[id] += 1
-            self.append(setup)
+                                     basis, setupdata=setupdata,
+                                     world=None if distribute else world)
+            if distribute:
+                setup = broadcast(setup, i % world.size, world)
+            self.setups[id] = setup
+
+        for id in self.id_a:
+            self.append(self.setups[id])
+
+        if world is not None and world.size > 1:
+            # The setups are identical on all ranks - let the ranks of
+            # a node share one copy of the big immutable tables.  Walk
+            # the species in id_a order so all ranks agree on it:
+            shared = set()
+            for id in self.id_a:
+                if id not in shared:
+                    shared.add(id)
+                    self.setups[id].share_radial_data(world)
 
         # Sum up ...
         self.nvalence = 0       # number of valence electrons
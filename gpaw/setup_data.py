@@ -3,6 +3,7 @@
 import os
 import xml.sax
 import re
+import pickle
 from cStringIO import StringIO
 from math import sqrt, pi
 
@@ -15,7 +16,7 @@ from gpaw.spline import Spline
 from gpaw.utilities import _fact, divrl
 from gpaw.utilities.tools import md5_new
 from gpaw.xc.pawcorrection import PAWXCCorrection
-from gpaw.mpi import broadcast_string
+from gpaw.mpi import broadcast_string, broadcast
 
 try:
     import gzip
@@ -385,6 +386,52 @@ def search_for_file(name, world=None):
     return filename, source
 
 
+# Parsing the setup XML files dominates startup time for large systems.
+# The parsed arrays are therefore cached in pickle files keyed by the
+# md5 fingerprint of the XML source, so a modified setup file can never
+# be shadowed by a stale cache.  The cache files go to $GPAW_SETUP_CACHE
+# if set, otherwise next to the setup files.
+setupcache_version = 1
+
+def cache_filename(filename, fingerprint):
+    dir = os.environ.get('GPAW_SETUP_CACHE')
+    if not dir:
+        dir = os.path.dirname(filename)
+    name = os.path.basename(filename)
+    if name.endswith('.gz'):
+        name = name[:-3]
+    return os.path.join(dir, '%s.%s.pckl' % (name, fingerprint))
+
+
+def read_cache(filename, fingerprint):
+    """Return cached parser output, or None if there is no valid cache."""
+    try:
+        f = open(cache_filename(filename, fingerprint), 'rb')
+        version, state = pickle.load(f)
+        f.close()
+    except (IOError, OSError, EOFError, ValueError, pickle.UnpicklingError):
+        return None
+    if version != setupcache_version:
+        return None
+    return state
+
+
+def write_cache(filename, fingerprint, state):
+    try:
+        f = open(cache_filename(filename, fingerprint), 'wb')
+        pickle.dump((setupcache_version, state), f, pickle.HIGHEST_PROTOCOL)
+        f.close()
+    except (IOError, OSError):
+        pass  # read-only setup directory - the cache is only a speedup
+
+
+# Long-lived processes (a screening loop or gpaw-worker) construct many
+# calculators; the fully parsed setup attributes are kept in memory so
+# each setup file is read and parsed once per process, not once per
+# calculator:
+_parsed_setups = {}
+
+
 class PAWXMLParser(xml.sax.handler.ContentHandler):
     def __init__(self, setup):
         xml.sax.handler.ContentHandler.__init__(self)
@@ -394,9 +441,38 @@ class PAWXMLParser(xml.sax.handler.ContentHandler):
 
     def parse(self, source=None, world=None):
         setup = self.setup
+        key = None
         if source is None:
-            (setup.filename, source) = search_for_file(setup.stdfilename,
-                                                       world)
+            key = (setup.stdfilename, setup.zero_reference,
+                   tuple(setup_paths))
+            state = _parsed_setups.get(key)
+            if state is not None:
+                setup.__dict__.update(state)
+                # The pseudo partial waves are modified in place during
+                # basis construction - hand out private copies:
+                setup.phit_jg = [a.copy() for a in state['phit_jg']]
+                return
+        self._parse(source, world)
+        if key is not None:
+            state = dict(setup.__dict__)
+            state['phit_jg'] = [a.copy() for a in setup.phit_jg]
+            _parsed_setups[key] = state
+
+    def _parse(self, source=None, world=None):
+        setup = self.setup
+        if source is None and world is not None and world.size > 1:
+            # Only rank 0 touches the disk and parses; the others get
+            # the finished attributes as a pickle broadcast:
+            if world.rank == 0:
+                self.parse()
+                state = dict(setup.__dict__)
+            else:
+                state = None
+            setup.__dict__.update(broadcast(state, 0, world))
+            return
+
+        if source is None:
+            (setup.filename, source) = search_for_file(setup.stdfilename)
 
         if source is None:
             print """
@@ -408,12 +484,28 @@ http://wiki.fysik.dtu.dk/gpaw/install/installationguide.html for details."""
                                 setup.symbol))
         
         setup.fingerprint = md5_new(source).hexdigest()
-        
-        # XXXX There must be a better way!
-        # We don't want to look at the dtd now.  Remove it:
-        source = re.compile(r'<!DOCTYPE .*?>', re.DOTALL).sub('', source, 1)
-        xml.sax.parse(StringIO(source), self) # XXX There is a special parse
-                                              # function that takes a string
+
+        state = None
+        if setup.filename is not None:
+            state = read_cache(setup.filename, setup.fingerprint)
+        if state is not None:
+            setup.__dict__.update(state)
+        else:
+            # XXXX There must be a better way!
+            # We don't want to look at the dtd now.  Remove it:
+            source = re.compile(r'<!DOCTYPE .*?>', re.DOTALL).sub('',
+                                                                  source, 1)
+            xml.sax.parse(StringIO(source), self) # XXX There is a special
+                                                  # parse function that
+                                                  # takes a string
+            if setup.filename is not None:
+                state = dict(setup.__dict__)
+                # Cache only what the parser produced:
+                for key in ['symbol', 'setupname', 'name', 'zero_reference',
+                            'stdfilename', 'filename', 'fingerprint']:
+                    del state[key]
+                write_cache(setup.filename, setup.fingerprint, state)
+
         if setup.zero_reference:
             setup.e_total = 0.0
             setup.e_kinetic = 0.0
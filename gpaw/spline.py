@@ -8,6 +8,17 @@ from gpaw.utilities import divrl, is_contiguous
 import _gpaw
 
 
+def map_splines(spline_j, r_g):
+    """Evaluate several splines at a shared array of radii.
+
+    Returns an array of shape ``(len(spline_j), len(r_g))``.  The
+    whole set is evaluated in a single C call - use this instead of
+    calling map() spline by spline when all the radial functions of a
+    setup are needed at the same radii."""
+    r_g = np.ascontiguousarray(r_g, float)
+    return _gpaw.splines_map([spline.spline for spline in spline_j], r_g)
+
+
 class Spline:
     def __init__(self, l, rmax, f_g, r_g=None, beta=None, points=25):
         """Spline(l, rcut, list) -> Spline object
@@ -43,8 +54,22 @@ class Spline:
         # Copy so we don't change the values of the input array
         f_g = f_g.copy()
         f_g[-1] = 0.0
+        # Keep the ingredients - the C object cannot be pickled, so
+        # __getstate__/__setstate__ rebuild it from these:
+        self.l = l
+        self.rmax = rmax
+        self.f_g = f_g
         self.spline = _gpaw.Spline(l, rmax, f_g)
 
+    def __getstate__(self):
+        state = self.__dict__.copy()
+        del state['spline']
+        return state
+
+    def __setstate__(self, state):
+        self.__dict__.update(state)
+        self.spline = _gpaw.Spline(self.l, self.rmax, self.f_g)
+
     def get_cutoff(self):
         """Return the radial cutoff."""
         return self.spline.get_cutoff()
@@ -62,7 +87,7 @@ class Spline:
         return self.spline(r)
 
     def map(self, r_g):
-        return np.array(map(self, r_g))
+        return self.spline.map(np.ascontiguousarray(r_g, float))
 
     def get_functions(self, gd, start_c, end_c, spos_c):
         h_cv = gd.h_cv
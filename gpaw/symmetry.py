@@ -219,6 +219,37 @@ class Symmetry:
         
         gd.symmetrize(a, self.op_scc)
 
+    def get_wavefunction_index_map(self, C_cc, kpt0_c, kpt1_c, shape):
+        """Index map and phases for wavefunction symmetrization.
+
+        Returns (index_G, phase_G) so that assigning
+        a_g.ravel() * phase_G into b_g.ravel()[index_G] rotates a Bloch
+        function at kpt0_c into one at kpt1_c, with the same
+        conventions as _gpaw.symmetrize_wavefunction called with the
+        matrix C_cc.  The index arithmetic and the complex
+        exponentials depend only on (operation, k-point pair, grid) -
+        not on the band - so they are cached and a band loop pays one
+        gather per band."""
+        key = (tuple(C_cc.ravel()), tuple(kpt0_c), tuple(kpt1_c), shape)
+        try:
+            return self._index_map_cache[key]
+        except AttributeError:
+            self._index_map_cache = {}
+        except KeyError:
+            pass
+        # A handful of (operation, k-point) pairs are in play at a
+        # time; don't let old grids accumulate:
+        if len(self._index_map_cache) >= 8:
+            self._index_map_cache.clear()
+        N_c = np.array(shape)
+        g_cG = np.indices(shape).reshape(3, -1)
+        p_cG = np.dot(C_cc.T, g_cG) % N_c[:, np.newaxis]
+        index_G = (p_cG[0] * N_c[1] + p_cG[1]) * N_c[2] + p_cG[2]
+        phase_G = np.exp(2j * np.pi * (np.dot(kpt1_c / N_c, p_cG) -
+                                       np.dot(kpt0_c / N_c, g_cG)))
+        self._index_map_cache[key] = (index_G, phase_G)
+        return index_G, phase_G
+
     def symmetrize_wavefunction(self, a_g, kibz_c, kbz_c, op_cc,
                                 time_reversal):
         """Generate Bloch function from symmetry related function in the IBZ.
@@ -248,17 +279,18 @@ class Symmetry:
             return a_g.conj()
         # General point group symmetry
         else:
-            import _gpaw
-            b_g = np.zeros_like(a_g)
+            b_g = np.empty_like(a_g)
             if time_reversal:
                 # assert abs(np.dot(op_cc, kibz_c) - -kbz_c) < tol
-                _gpaw.symmetrize_wavefunction(a_g, b_g, op_cc.T.copy(),
-                                              kibz_c, -kbz_c)
+                index_G, phase_G = self.get_wavefunction_index_map(
+                    op_cc.T, kibz_c, -kbz_c, a_g.shape)
+                b_g.ravel()[index_G] = a_g.ravel() * phase_G
                 return b_g.conj()
             else:
                 # assert abs(np.dot(op_cc, kibz_c) - kbz_c) < tol
-                _gpaw.symmetrize_wavefunction(a_g, b_g, op_cc.T.copy(),
-                                              kibz_c, kbz_c)
+                index_G, phase_G = self.get_wavefunction_index_map(
+                    op_cc.T, kibz_c, kbz_c, a_g.shape)
+                b_g.ravel()[index_G] = a_g.ravel() * phase_G
                 return b_g
         
     def symmetrize_forces(self, F0_av):
@@ -5,8 +5,8 @@ gradient stabilized method. Requires Numpy and GPAW's own BLAS."""
 
 import numpy as np
 
-from gpaw.utilities.blas import axpy
-from gpaw.utilities.blas import dotc
+from gpaw.utilities.blas import multi_axpy
+from gpaw.utilities.blas import multi_dotc
 from gpaw.mpi import rank
 
 class BiCGStab:
@@ -102,19 +102,17 @@ class BiCGStab:
         omega[:] = 1.
 
         # Multivector dot product, a^H b, where ^H is conjugate transpose
+        # (one batched kernel call instead of one BLAS call per band)
         def multi_zdotc(s, x,y, nvec):
-            for i in range(nvec):
-                s[i] = dotc(x[i],y[i])
+            multi_dotc(x, y, s)
             self.gd.comm.sum(s)
             return s
         # Multivector ZAXPY: a x + y => y
         def multi_zaxpy(a,x,y, nvec):
-            for i in range(nvec):
-                axpy(a[i]*(1+0J), x[i], y[i])
+            multi_axpy(np.ascontiguousarray(a, complex), x, y)
         # Multiscale: a x => x
         def multi_scale(a,x, nvec):
-            for i in range(nvec):
-                x[i] *= a[i]
+            x *= a.reshape((nvec,) + (1,) * (x.ndim - 1))
 
         # scale = square of the norm of b
         multi_zdotc(scale, b,b, nvec)
@@ -5,9 +5,8 @@ for complex symmetric matrices. Requires Numpy and GPAW's own BLAS."""
 
 import numpy as np
 
-from gpaw.utilities.blas import axpy
-from gpaw.utilities.blas import dotu
-from gpaw.utilities.blas import dotc
+from gpaw.utilities.blas import multi_axpy
+from gpaw.utilities.blas import multi_dotu
 from gpaw.mpi import rank
 
 class CSCG:
@@ -98,19 +97,17 @@ class CSCG:
         rhop[:] = 1.
 
         # Multivector dot product, a^T b, where ^T is transpose
+        # (one batched kernel call instead of one BLAS call per band)
         def multi_zdotu(s, x,y, nvec):
-            for i in range(nvec):
-                s[i] = dotu(x[i],y[i])
+            multi_dotu(x, y, s)
             self.gd.comm.sum(s)
             return s
         # Multivector ZAXPY: a x + y => y
         def multi_zaxpy(a,x,y, nvec):
-            for i in range(nvec):
-                axpy(a[i]*(1+0J), x[i], y[i])
+            multi_axpy(np.ascontiguousarray(a, complex), x, y)
         # Multiscale: a x => x
         def multi_scale(a,x, nvec):
-            for i in range(nvec):
-                x[i] *= a[i]
+            x *= a.reshape((nvec,) + (1,) * (x.ndim - 1))
 
         # scale = square of the norm of b
         multi_zdotu(scale, b,b, nvec)
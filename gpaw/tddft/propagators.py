@@ -144,7 +144,41 @@ class ExplicitCrankNicolson(DummyPropagator):
         self.hpsit = None
         self.spsit = None
         self.sinvhpsit = None
-        
+
+        # Solution history for extrapolating the initial guess
+        self.prev_kpt_u = None
+        self.nhist = 0
+        self.prev_time_step = None
+
+    def update_guess(self, kpt, prev_kpt, time_step):
+        """Extrapolate the initial guess from the solution history.
+
+        Stores psit(t) in prev_kpt and, when the previous propagation
+        step is available, overwrites kpt.psit_nG by the linear
+        extrapolation 2 psit(t) - psit(t-dt).  The wavefunctions evolve
+        smoothly, so this starts the linear solver much closer to
+        psit(t+dt) than the explicit Euler step does.  Returns whether
+        the guess was extrapolated.
+
+        Parameters
+        ----------
+        kpt: Kpoint
+            K-point with the current wavefunctions (and solver guess)
+        prev_kpt: DummyKPoint
+            wavefunctions from the previous propagation step
+        time_step: float
+            time step
+
+        """
+        extrapolate = (self.nhist > 0 and time_step == self.prev_time_step)
+        if extrapolate:
+            guess_nG = 2.0 * kpt.psit_nG - prev_kpt.psit_nG
+            prev_kpt.psit_nG[:] = kpt.psit_nG
+            kpt.psit_nG[:] = guess_nG
+        else:
+            prev_kpt.psit_nG[:] = kpt.psit_nG
+        return extrapolate
+
     # ( S + i H dt/2 ) psit(t+dt) = ( S - i H dt/2 ) psit(t)
     def propagate(self, kpt_u, time, time_step):
         """Propagate wavefunctions. 
@@ -170,6 +204,15 @@ class ExplicitCrankNicolson(DummyPropagator):
                                                 dtype=complex)
                 self.tmp_kpt_u.append(tmp_kpt)
 
+        # Allocate wavefunction history for guess extrapolation
+        if self.prev_kpt_u is None:
+            self.prev_kpt_u = []
+            for kpt in kpt_u:
+                prev_kpt = DummyKPoint()
+                prev_kpt.psit_nG = self.gd.empty(n=len(kpt.psit_nG),
+                                                 dtype=complex)
+                self.prev_kpt_u.append(prev_kpt)
+
         # Allocate memory for Crank-Nicolson stuff
         nvec = len(kpt_u[0].psit_nG)
         if self.hpsit is None:
@@ -197,11 +240,16 @@ class ExplicitCrankNicolson(DummyPropagator):
             self.tmp_kpt_u[u].psit_nG[:] = kpt_u[u].psit_nG
 
 
-        # Euler step
+        # Euler step (or extrapolation from the solution history)
         # Overwrite psit_nG in tmp_kpt_u by (1 - i S^(-1)(t) H(t) dt) psit_nG
         # from corresponding kpt_u in a Euler step before predicting psit(t+dt)
-        for [kpt, rhs_kpt] in zip(kpt_u, self.tmp_kpt_u):
-            self.solve_propagation_equation(kpt, rhs_kpt, time_step, guess=True)
+        for [kpt, rhs_kpt, prev_kpt] in zip(kpt_u, self.tmp_kpt_u,
+                                            self.prev_kpt_u):
+            euler = not self.update_guess(kpt, prev_kpt, time_step)
+            self.solve_propagation_equation(kpt, rhs_kpt, time_step,
+                                            guess=euler)
+        self.nhist += 1
+        self.prev_time_step = time_step
 
         # update projections before exiting
         self.td_overlap.update()
@@ -350,6 +398,15 @@ class SemiImplicitCrankNicolson(ExplicitCrankNicolson):
                                                 dtype=complex)
                 self.tmp_kpt_u.append(tmp_kpt)
 
+        # Allocate wavefunction history for guess extrapolation
+        if self.prev_kpt_u is None:
+            self.prev_kpt_u = []
+            for kpt in kpt_u:
+                prev_kpt = DummyKPoint()
+                prev_kpt.psit_nG = self.gd.empty(n=len(kpt.psit_nG),
+                                                 dtype=complex)
+                self.prev_kpt_u.append(prev_kpt)
+
         # Allocate memory for Crank-Nicolson stuff
         nvec = len(kpt_u[0].psit_nG)
         if self.hpsit is None:
@@ -381,8 +438,14 @@ class SemiImplicitCrankNicolson(ExplicitCrankNicolson):
         # Predictor step
         # Overwrite psit_nG in tmp_kpt_u by (1 - i S^(-1)(t) H(t) dt) psit_nG
         # from corresponding kpt_u in a Euler step before predicting psit(t+dt)
-        for [kpt, rhs_kpt] in zip(kpt_u, self.tmp_kpt_u):
-            self.solve_propagation_equation(kpt, rhs_kpt, time_step, guess=True)
+        # (or extrapolate the prediction from the solution history)
+        for [kpt, rhs_kpt, prev_kpt] in zip(kpt_u, self.tmp_kpt_u,
+                                            self.prev_kpt_u):
+            euler = not self.update_guess(kpt, prev_kpt, time_step)
+            self.solve_propagation_equation(kpt, rhs_kpt, time_step,
+                                            guess=euler)
+        self.nhist += 1
+        self.prev_time_step = time_step
 
         self.timer.start('Update time-dependent operators')
 
@@ -571,6 +634,15 @@ class EnforcedTimeReversalSymmetryCrankNicolson(ExplicitCrankNicolson):
                                                 dtype=complex)
                 self.tmp_kpt_u.append(tmp_kpt)
 
+        # Allocate wavefunction history for guess extrapolation
+        if self.prev_kpt_u is None:
+            self.prev_kpt_u = []
+            for kpt in kpt_u:
+                prev_kpt = DummyKPoint()
+                prev_kpt.psit_nG = self.gd.empty(n=len(kpt.psit_nG),
+                                                 dtype=complex)
+                self.prev_kpt_u.append(prev_kpt)
+
         # Allocate memory for Crank-Nicolson stuff
         nvec = len(kpt_u[0].psit_nG)
         if self.hpsit is None:
@@ -606,9 +678,13 @@ class EnforcedTimeReversalSymmetryCrankNicolson(ExplicitCrankNicolson):
         if update_callback is not None:
             update_callback()
 
-            
-        for [kpt, rhs_kpt] in zip(kpt_u, self.old_kpt_u):            
+
+        for [kpt, rhs_kpt, prev_kpt] in zip(kpt_u, self.old_kpt_u,
+                                            self.prev_kpt_u):
+            self.update_guess(kpt, prev_kpt, time_step)
             self.solve_propagation_equation(kpt, rhs_kpt, time_step)
+        self.nhist += 1
+        self.prev_time_step = time_step
 
 
         self.timer.start('Update time-dependent operators')
@@ -1,40 +1,42 @@
 # Written by Lauri Lehtovaara 2008
 
+import numpy as np
+
 from gpaw.utilities.blas import axpy
-from gpaw.utilities.blas import dotc
+from gpaw.utilities.blas import multi_axpy
+from gpaw.utilities.blas import multi_dotc
 
 class MultiBlas:
+    """Batched BLAS operations on multivectors.
+
+    The band-indexed operations go through the batched kernels in
+    c/blas.c, so the TDDFT inner loops pay the Python and BLAS
+    dispatch overhead once per call instead of once per band."""
     def __init__(self, gd):
         self.gd = gd
 
     # Multivector ZAXPY: a x + y => y
     def multi_zaxpy(self, a,x,y, nvec):
         if isinstance(a, (float, complex)):
-            for i in range(nvec):
-                axpy(a*(1+0J), x[i], y[i])
+            axpy(complex(a), x, y)
         else:
-            for i in range(nvec):
-                axpy(a[i]*(1.0+0.0J), x[i], y[i])
+            multi_axpy(np.ascontiguousarray(a, complex), x, y)
 
     # Multivector dot product, a^H b, where ^H is transpose
     def multi_zdotc(self, s, x,y, nvec):
-        for i in range(nvec):
-            s[i] = dotc(x[i],y[i])
+        multi_dotc(x, y, s)
         self.gd.comm.sum(s)
         return s
-            
+
     # Multiscale: a x => x
     def multi_scale(self, a,x, nvec):
         if isinstance(a, (float, complex)):
             x *= a
         else:
-            for i in range(nvec):
-                x[i] *= a[i]
+            x *= a.reshape((nvec,) + (1,) * (x.ndim - 1))
 
 # -------------------------------------------------------------------
 
-import numpy as np
-
 class BandPropertyMonitor:
     def __init__(self, wfs, name, interval=1):
         self.niter = 0
@@ -75,6 +75,7 @@ tests = [
     'derivatives.py',
     'second_derivative.py',
     'integral4.py',
+    'setup_pickle.py',
     'transformations.py',
     'occupations.py',
     'nabla.py',
@@ -88,6 +89,8 @@ tests = [
     'vdwradii.py',
     'parallel/ut_parallel.py',
     'parallel/compare.py',
+    'parallel/redistribute.py',
+    'parallel/scheduler.py',
     'ase3k.py',
     'laplace.py',
     'ds_beta.py',
@@ -113,6 +116,7 @@ tests = [
     'partitioning.py',
     'mixer.py',
     'broydenmixer.py',
+    'memory_checkpoint.py',
     'restart.py',
     'mgga_restart.py',
     'gga_atom.py',
@@ -161,7 +165,9 @@ tests = [
     'parallel/lcao_parallel_kpt.py',
     'parallel/fd_parallel.py',
     'parallel/fd_parallel_kpt.py',
-    'gllbatomic.py', 
+    'parallel/kpt_rebalance.py',
+    'parallel/davidson_band.py',
+    'gllbatomic.py',
     'ne_gllb.py',
     'ne_disc.py', 
     'wannier_ethylene.py',
@@ -241,6 +247,11 @@ tests = [
     'constant_electric_field.py',
     'stark_shift.py',
     'aluminum_testcell.py',
+    # Performance regression tests - no-ops unless
+    # GPAW_PERF_BASELINE_DIR is set (see perf/__init__.py):
+    'perf/bmgs.py',
+    'perf/lfc.py',
+    'perf/scf.py',
     ]
 
 exclude = []
@@ -269,6 +280,7 @@ if mpi.size < 4:
 if mpi.size != 4:
     exclude += ['parallel/lcao_parallel.py']
     exclude += ['parallel/fd_parallel.py']
+    exclude += ['parallel/davidson_band.py']
 
 if mpi.size == 8:
     exclude += ['transport.py']
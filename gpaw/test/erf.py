@@ -29,6 +29,13 @@ for test in values:
         print 'z=', z, ' ok (error=', error, ')'
     else:
         print z, res, cerf(z), erf(r), error
-        string = ('error for erf(' + str(z) +') = ' + str(error) + 
-                  ' > ' + str(maxerror)) 
+        string = ('error for erf(' + str(z) +') = ' + str(error) +
+                  ' > ' + str(maxerror))
         assert(error < maxerror), string
+
+# A whole array in one call gives the same values:
+import numpy as np
+z_x = np.array([z for z, res in values], complex)
+res_x = np.array([res for z, res in values], complex)
+error = abs(res_x / cerf(z_x) - 1.).max()
+assert error < maxerror, error
@@ -95,3 +95,19 @@ niter_tolerance = 0
 #equal(niter_c00, 14, niter_tolerance) # svnversion 5252
 #equal(E_c1, -11.5590572387, energy_tolerance) # svnversion 5252
 #equal(niter_c1, 14, niter_tolerance) # svnversion 5252
+
+# Far-field mode: distant charges summed on a coarse mesh and
+# interpolated must agree with the direct sum.
+import numpy as np
+from gpaw.grid_descriptor import GridDescriptor
+from gpaw.point_charges import PointCharge
+
+gd = GridDescriptor((24, 24, 24), (8.0, 8.0, 8.0), pbc_c=False)
+far = PointCharges()
+for x in range(5):
+    far.append(PointCharge(position=(4 + x, 3, 40 + 2 * x),
+                           charge=(-1)**x))
+v0_g = far.get_potential(gd).copy()
+del far.potential, far.gd
+v1_g = far.get_potential(gd, rcut=10.0)
+equal(abs(v1_g - v0_g).max(), 0.0, 1.e-4)
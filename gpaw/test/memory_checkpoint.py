@@ -0,0 +1,27 @@
+import numpy as np
+
+from ase import Atoms
+from gpaw import GPAW
+from gpaw.checkpoint import MemoryCheckpoint
+from gpaw.test import equal
+
+a = 4.0
+atoms = Atoms('H', magmoms=[1.0], cell=(a, a, a), pbc=True)
+calc = GPAW(h=0.3, nbands=1, convergence={'energy': 1e-5})
+atoms.set_calculator(calc)
+e0 = atoms.get_potential_energy()
+
+# Snapshot the converged state, then trash the density and the mixer
+# history and check that restore brings the arrays back:
+cp = MemoryCheckpoint(calc)
+cp.save()
+nt0_sG = calc.density.nt_sG.copy()
+calc.density.nt_sG += 0.1
+calc.density.mixer.reset()
+cp.restore()
+assert np.abs(calc.density.nt_sG - nt0_sG).max() < 1e-14
+
+# After a restore the SCF loop must be able to just continue:
+calc.scf.reset()
+e1 = atoms.get_potential_energy()
+equal(e0, e1, 1e-4)
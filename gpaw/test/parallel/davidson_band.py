@@ -0,0 +1,25 @@
+from ase.data.molecules import molecule
+
+from gpaw import GPAW
+from gpaw import KohnShamConvergenceError
+from gpaw.test import equal
+
+# Compare a band-parallelized Davidson calculation to the
+# single-band-group result.
+
+
+def energy(**parallel):
+    system = molecule('H2O')
+    system.center(2.0)
+    calc = GPAW(mode='fd', nbands=6, maxiter=3, eigensolver='dav',
+                parallel=dict(parallel))
+    system.set_calculator(calc)
+    try:
+        system.get_potential_energy()
+    except KohnShamConvergenceError:
+        pass
+    return calc.hamiltonian.Etot
+
+e0 = energy()
+e1 = energy(band=2)
+equal(e1, e0, 4e-5)
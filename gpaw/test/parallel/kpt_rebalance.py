@@ -0,0 +1,33 @@
+from ase import Atoms
+from gpaw import GPAW
+from gpaw.test import equal
+
+# Moving whole k-points between ranks must not change the SCF
+# trajectory, since the migrated state is exact.
+
+kwargs = dict(h=0.3, nbands=2, kpts=(8, 1, 1),
+              convergence={'energy': 1e-6})
+
+atoms = Atoms('H2', positions=[(0, 0, 0), (0, 0, 0.74)],
+              cell=(3.0, 3.0, 3.0), pbc=True)
+
+calc = GPAW(**kwargs)
+atoms.set_calculator(calc)
+e0 = atoms.get_potential_energy()
+
+# Same calculation, but with a grossly lopsided cost model fed in every
+# iteration, so that k-points keep being pushed away from rank 0:
+calc = GPAW(**kwargs)
+atoms.set_calculator(calc)
+
+
+def skew():
+    wfs = calc.wfs
+    kd = wfs.kd
+    for myu in range(kd.mynks):
+        kd.register_time(myu, 1.0 + 10.0 * (kd.comm.rank == 0))
+    wfs.rebalance_kpoints()
+
+calc.attach(skew, 1)
+e1 = atoms.get_potential_energy()
+equal(e0, e1, 1e-8)
@@ -0,0 +1,29 @@
+import numpy as np
+from gpaw.grid_descriptor import GridDescriptor
+from gpaw.mpi import world
+
+# Move an array between two different domain decompositions and check
+# that every grid point ends up where it belongs.
+
+N_c = (16, 12, 8)
+cell_cv = (4.0, 3.0, 2.0)
+gd1 = GridDescriptor(N_c, cell_cv, comm=world)
+gd2 = GridDescriptor(N_c, cell_cv, comm=world, parsize=(1, 1, world.size))
+
+
+def fill(gd):
+    # Unique value for each global grid point:
+    i_cg = np.indices(gd.n_c) + gd.beg_c[:, np.newaxis,
+                                         np.newaxis, np.newaxis]
+    return ((i_cg[0] * 100.0 + i_cg[1]) * 100.0 + i_cg[2])
+
+a1_g = fill(gd1)
+a2_g = gd1.redistribute(gd2, a1_g)
+assert np.all(a2_g == fill(gd2))
+
+# ... back again, with an extra leading dimension and a given output:
+a12_xg = np.array([a2_g, -2.0 * a2_g])
+b_xg = gd1.empty(2)
+gd2.redistribute(gd1, a12_xg, b_xg)
+assert np.all(b_xg[0] == a1_g)
+assert np.all(b_xg[1] == -2.0 * a1_g)
@@ -0,0 +1,23 @@
+import numpy as np
+from gpaw.mpi import world
+from gpaw.mpi.scheduler import PointScheduler
+
+n = 17
+x = np.zeros(n)
+
+
+def work(i):
+    x[i] = i + 1
+
+scheduler = PointScheduler(world)
+mypoints = scheduler.distribute(n, work)
+
+# Every point evaluated exactly once, on exactly one rank:
+count = np.zeros(n, int)
+for i in mypoints:
+    count[i] += 1
+world.sum(count)
+assert (count == 1).all()
+
+world.sum(x)
+assert abs(x.sum() - n * (n + 1) / 2.0) < 1e-12
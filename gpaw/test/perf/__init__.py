@@ -0,0 +1,82 @@
+"""Performance regression tests.
+
+The scripts in this directory time the bmgs kernels, the LFC entry
+points and a small SCF run and compare against stored per-machine
+baselines, so kernel-level slowdowns (a BLAS relink, a bc.c change)
+are caught by the nightly runs instead of reaching production.
+
+The tests are in the normal registry but do nothing unless the
+GPAW_PERF_BASELINE_DIR environment variable points at a writable
+directory - timings are meaningless on loaded or unknown machines, so
+the functional suite stays purely functional.  The first run on a host
+records its baseline (one file per hostname) and passes; later runs
+fail when a timing exceeds the baseline by more than the threshold
+factor (GPAW_PERF_THRESHOLD, default 1.5).  Faster runs update the
+baseline, so it converges towards the best observed time.
+"""
+
+import os
+import time
+import socket
+
+from gpaw import mpi
+
+
+def enabled():
+    return bool(os.environ.get('GPAW_PERF_BASELINE_DIR'))
+
+
+def baseline_file():
+    return os.path.join(os.environ['GPAW_PERF_BASELINE_DIR'],
+                        socket.gethostname() + '.txt')
+
+
+def load_baselines():
+    baselines = {}
+    if os.path.isfile(baseline_file()):
+        for line in open(baseline_file()):
+            name, t = line.split()
+            baselines[name] = float(t)
+    return baselines
+
+
+def save_baselines(baselines):
+    f = open(baseline_file(), 'w')
+    for name in sorted(baselines):
+        f.write('%s %r\n' % (name, baselines[name]))
+    f.close()
+
+
+def best_time(func, repeats=5):
+    """Return the best wall time over repeats calls of func."""
+    t = 1e30
+    for i in range(repeats):
+        t0 = time.time()
+        func()
+        t = min(t, time.time() - t0)
+    return t
+
+
+def check(name, t, threshold=None):
+    """Compare a timing against the stored baseline.
+
+    Records the baseline on first sight and moves it down when beaten;
+    fails when t exceeds it by more than the threshold factor."""
+    if mpi.rank != 0:
+        return
+    if threshold is None:
+        threshold = float(os.environ.get('GPAW_PERF_THRESHOLD', '1.5'))
+    baselines = load_baselines()
+    t0 = baselines.get(name)
+    if t0 is None:
+        baselines[name] = t
+        save_baselines(baselines)
+        print '%s: %.4f s (new baseline)' % (name, t)
+        return
+    if t < t0:
+        baselines[name] = t
+        save_baselines(baselines)
+    print '%s: %.4f s (baseline %.4f s)' % (name, t, t0)
+    assert t <= threshold * t0, (
+        '%s regressed: %.4f s > %.1f x baseline %.4f s' %
+        (name, t, threshold, t0))
@@ -0,0 +1,9 @@
+from gpaw.test.perf import enabled, check
+
+if enabled():
+    import _gpaw
+    repeats = 10
+    for kernel, k in [('fd', 3), ('fd', 7), ('relax', 5),
+                      ('interpolate', 4), ('restrict', 4)]:
+        t = _gpaw.benchmark_bmgs(kernel, (64, 64, 64), k, repeats) / repeats
+        check('bmgs_%s_k%d_64' % (kernel, k), t)
@@ -0,0 +1,22 @@
+from gpaw.grid_descriptor import GridDescriptor
+from gpaw.spline import Spline
+import gpaw.mpi as mpi
+from gpaw.lfc import LocalizedFunctionsCollection as LFC
+from gpaw.test.perf import enabled, check, best_time
+
+if enabled():
+    s = Spline(0, 2.0, [1.0, 0.6, 0.1, 0.0])
+    n = 64
+    a = 12.0
+    gd = GridDescriptor((n, n, n), (a, a, a), comm=mpi.serial_comm)
+    spos_ac = [(0.15 + 0.1 * i, 0.5, 0.5) for i in range(8)]
+    c = LFC(gd, [[s]] * len(spos_ac))
+    c.set_positions(spos_ac)
+
+    a_xG = gd.zeros(4)
+    c_axi = c.dict(4)
+    for c_xi in c_axi.values():
+        c_xi[:] = 1.0
+
+    check('lfc_add_64x8', best_time(lambda: c.add(a_xG, c_axi)))
+    check('lfc_integrate_64x8', best_time(lambda: c.integrate(a_xG, c_axi)))
@@ -0,0 +1,13 @@
+import time
+
+from ase import Atom, Atoms
+from gpaw import GPAW
+from gpaw.test.perf import enabled, check
+
+if enabled():
+    a = 2.0
+    H = Atoms([Atom('H')], cell=(a, a, a), pbc=True)
+    H.set_calculator(GPAW(gpts=(16, 16, 16), txt=None))
+    t0 = time.time()
+    H.get_potential_energy()
+    check('scf_H_16', time.time() - t0)
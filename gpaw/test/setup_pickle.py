@@ -0,0 +1,25 @@
+# Setups are pickled when their construction is distributed over the
+# ranks - check that a setup survives the round trip, splines included.
+import cPickle as pickle
+
+import numpy as np
+
+from gpaw.setup import create_setup
+from gpaw.xc import XC
+
+s = create_setup('H', XC('PBE'))
+s2 = pickle.loads(pickle.dumps(s, pickle.HIGHEST_PROTOCOL))
+
+assert s2.ni == s.ni
+assert s2.E == s.E
+assert (s2.M_pp == s.M_pp).all()
+assert (s2.xc_correction.n_qg == s.xc_correction.n_qg).all()
+
+for spline, spline2 in zip(s.pt_j + [s.nct, s.vbar],
+                           s2.pt_j + [s2.nct, s2.vbar]):
+    rc = spline.get_cutoff()
+    assert spline2.get_cutoff() == rc
+    assert (spline2.get_angular_momentum_number() ==
+            spline.get_angular_momentum_number())
+    for r in np.linspace(0.0, 0.99 * rc, 17):
+        assert spline2(r) == spline(r)
@@ -0,0 +1,108 @@
+"""Microbenchmarks for the bmgs multigrid kernels.
+
+Times bmgs_fd, bmgs_relax, bmgs_interpolate and bmgs_restrict in
+isolation over representative grid sizes and stencil orders, and
+reports effective bandwidth and arithmetic throughput per kernel.
+The timed loops run in C (_gpaw.benchmark_bmgs), so the numbers
+reflect the kernels and not Python overhead - handy for evaluating
+compiler flags without timing full SCF runs.  Run it as::
+
+    gpaw-benchmark [-r repeats] [-s 32,64,128]
+"""
+
+import sys
+from optparse import OptionParser
+
+import _gpaw
+
+kernels = ['fd', 'relax', 'interpolate', 'restrict']
+
+# Orders: finite-difference stencils are 3 * k - 2 point Laplacians;
+# interpolation/restriction use k-tap filters as in Transformer:
+orders = {'fd': [3, 5, 7],
+          'relax': [3, 5, 7],
+          'interpolate': [2, 4, 6],
+          'restrict': [2, 4, 6]}
+
+default_sizes = [(32, 32, 32), (64, 64, 64), (96, 80, 80),
+                 (128, 128, 128)]
+
+
+def counts(kernel, n_c, k):
+    """Bytes moved and flops done per kernel invocation.
+
+    Streaming estimates: every array is counted as read or written
+    once per pass; cache reuse of the stencil neighborhood is not
+    charged extra.  n_c is the coarse interior grid."""
+    n0, n1, n2 = n_c
+    ng = n0 * n1 * n2
+    if kernel in ['fd', 'relax']:
+        r = (k - 1) // 2
+        npad = (n0 + 2 * r) * (n1 + 2 * r) * (n2 + 2 * r)
+        ncoefs = 3 * k - 2
+        if kernel == 'fd':
+            nbytes = 8 * (npad + ng)
+            flops = 2 * ncoefs * ng
+        else:
+            # reads a and src, writes a and b, plus the residual:
+            nbytes = 8 * (npad + 3 * ng)
+            flops = (2 * ncoefs + 6) * ng
+    elif kernel == 'interpolate':
+        e = k - 1
+        m_c = [n + e for n in n_c]
+        p1 = m_c[0] * m_c[1] * 2 * n2
+        p2 = m_c[0] * 2 * n1 * 2 * n2
+        p3 = 8 * ng
+        nbytes = 8 * (m_c[0] * m_c[1] * m_c[2] + 2 * (p1 + p2) + p3)
+        # every second output point is a k-tap filter, the rest are
+        # copies:
+        flops = k * (p1 + p2 + p3)
+    else:
+        assert kernel == 'restrict'
+        e = 2 * k - 3
+        m_c = [2 * n + e for n in n_c]
+        q1 = m_c[0] * m_c[1] * n2
+        q2 = m_c[0] * n1 * n2
+        q3 = ng
+        nbytes = 8 * (m_c[0] * m_c[1] * m_c[2] + 2 * (q1 + q2) + q3)
+        flops = 2 * (2 * k - 1) * (q1 + q2 + q3)
+    return nbytes, flops
+
+
+def run(sizes=None, repeats=10, out=sys.stdout):
+    if sizes is None:
+        sizes = default_sizes
+    out.write('%-12s %2s %-14s %10s %8s %9s\n' %
+              ('kernel', 'k', 'grid', 'ms/call', 'GB/s', 'GFLOP/s'))
+    for kernel in kernels:
+        for k in orders[kernel]:
+            for n_c in sizes:
+                t = _gpaw.benchmark_bmgs(kernel, tuple(n_c), k, repeats)
+                t /= repeats
+                nbytes, flops = counts(kernel, n_c, k)
+                out.write('%-12s %2d %-14s %10.3f %8.2f %9.2f\n' %
+                          (kernel, k, '%dx%dx%d' % tuple(n_c),
+                           1e3 * t, 1e-9 * nbytes / t, 1e-9 * flops / t))
+        out.write('\n')
+
+
+def main(args=None):
+    parser = OptionParser(usage='%prog [options]',
+                          description='Benchmark the bmgs kernels.')
+    parser.add_option('-r', '--repeats', type='int', default=10,
+                      help='timed iterations per measurement '
+                      '[default: %default]')
+    parser.add_option('-s', '--sizes', metavar='N1,N2,...',
+                      help='comma-separated cubic grid sizes '
+                      '[default: 32,64,96,128]')
+    opt, args = parser.parse_args(args)
+    if args:
+        parser.error('no arguments expected')
+    sizes = None
+    if opt.sizes:
+        sizes = [(n, n, n) for n in map(int, opt.sizes.split(','))]
+    run(sizes, opt.repeats)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,159 @@
+"""Benchmark the iterative eigensolvers on a converged calculation.
+
+Starting from a converged calculation, the pseudo density is perturbed
+by a small long-wavelength modulation - deterministic, so the same
+perturbation is obtained on every run and domain decomposition - and
+the Hamiltonian is refreshed once.  Each eigensolver then iterates
+from an identical snapshot of the wave functions with the Hamiltonian
+held fixed, and the harness records how many sweeps and how much wall
+time it takes to push the residual below each target.  This answers
+the rmm-diis/cg/davidson (and blocksize) question for a given system
+class without burning full SCF runs on every combination.  Run as::
+
+    python -m gpaw.testing.eigensolver_benchmark relaxed.gpw
+"""
+
+import sys
+import time
+from optparse import OptionParser
+
+import numpy as np
+
+from gpaw import GPAW
+from gpaw.eigensolvers import get_eigensolver
+from gpaw.eigensolvers.rmm_diis import RMM_DIIS
+
+default_solvers = ['rmm-diis', 'cg', 'dav']
+default_blocksizes = [1, 10, 32]
+default_targets = [1e-6, 1e-8, 1e-10]
+
+
+def perturb_density(density, hamiltonian, amplitude=0.01):
+    """Scale the pseudo density by 1 + amplitude * sum of cosines.
+
+    One cosine period per cell axis, so the perturbation is smooth,
+    reproducible and independent of the domain decomposition.  The
+    density is renormalized and pushed through the usual interpolation
+    pipeline before the Hamiltonian is updated."""
+    gd = density.gd
+    r_vG = gd.get_grid_point_coordinates()
+    cell_c = gd.cell_cv.diagonal()
+    modulation = np.ones(r_vG.shape[1:])
+    for v in range(3):
+        modulation += (amplitude / 3.0) * np.cos(2 * np.pi * r_vG[v] /
+                                                 cell_c[v])
+    density.nt_sG *= modulation
+    density.normalize()
+    comp_charge = density.calculate_multipole_moments()
+    density.interpolate(comp_charge)
+    density.calculate_pseudo_charge(comp_charge)
+    hamiltonian.update(density)
+
+
+def snapshot_wave_functions(wfs):
+    """Copy out psit_nG, projections and eigenvalues for all k-points."""
+    data = []
+    for kpt in wfs.kpt_u:
+        P_ani = dict([(a, P_ni.copy()) for a, P_ni in kpt.P_ani.items()])
+        data.append((kpt.psit_nG.copy(), P_ani, kpt.eps_n.copy()))
+    return data
+
+
+def restore_wave_functions(wfs, data):
+    for kpt, (psit_nG, P_ani, eps_n) in zip(wfs.kpt_u, data):
+        kpt.psit_nG[:] = psit_nG
+        for a, P_ni in kpt.P_ani.items():
+            P_ni[:] = P_ani[a]
+        kpt.eps_n[:] = eps_n
+
+
+def make_solver(name, blocksize):
+    if name == 'rmm-diis':
+        return RMM_DIIS(blocksize=blocksize)
+    return get_eigensolver(name, 'fd')
+
+
+def time_solver(calc, solver, targets, maxiter, data):
+    """Iterate one solver to the residual targets from the snapshot.
+
+    Returns a list of (target, niter, time) for the targets that were
+    reached, plus the final residual after at most maxiter sweeps."""
+    restore_wave_functions(calc.wfs, data)
+    solver.tolerance = min(targets)
+    remaining = sorted(targets, reverse=True)
+    reached = []
+    t0 = time.time()
+    niter = 0
+    while niter < maxiter and remaining:
+        solver.iterate(calc.hamiltonian, calc.wfs)
+        niter += 1
+        while remaining and solver.error < remaining[0]:
+            reached.append((remaining.pop(0), niter, time.time() - t0))
+    return reached, solver.error
+
+
+def run(calc, solvers=None, blocksizes=None, targets=None, maxiter=50,
+        amplitude=0.01, out=sys.stdout):
+    if solvers is None:
+        solvers = default_solvers
+    if blocksizes is None:
+        blocksizes = default_blocksizes
+    if targets is None:
+        targets = default_targets
+
+    calc.converge_wave_functions()
+    data = snapshot_wave_functions(calc.wfs)
+    perturb_density(calc.density, calc.hamiltonian, amplitude)
+
+    out.write('%-10s %6s %9s %6s %9s\n' %
+              ('solver', 'block', 'target', 'iters', 'time[s]'))
+    for name in solvers:
+        # Only rmm-diis works in band blocks; the others get one line:
+        for blocksize in (name == 'rmm-diis' and blocksizes or [None]):
+            solver = make_solver(name, blocksize)
+            reached, error = time_solver(calc, solver, targets, maxiter,
+                                         data)
+            block = blocksize is None and '-' or str(blocksize)
+            for target, niter, t in reached:
+                out.write('%-10s %6s %9.1e %6d %9.3f\n' %
+                          (name, block, target, niter, t))
+            for target in sorted(targets):
+                if target not in [r[0] for r in reached]:
+                    out.write('%-10s %6s %9.1e %6s %9s  (residual %.1e '
+                              'after %d iterations)\n' %
+                              (name, block, target, '-', '-', error,
+                               maxiter))
+        out.write('\n')
+
+
+def main(args=None):
+    parser = OptionParser(
+        usage='%prog [options] restart.gpw',
+        description='Benchmark the eigensolvers on a converged '
+        'calculation.')
+    parser.add_option('-s', '--solvers', metavar='NAME,...',
+                      help='solvers to time [default: rmm-diis,cg,dav]')
+    parser.add_option('-b', '--blocksizes', metavar='B1,B2,...',
+                      help='rmm-diis band block sizes '
+                      '[default: 1,10,32]')
+    parser.add_option('-t', '--targets', metavar='T1,T2,...',
+                      help='residual targets [default: 1e-6,1e-8,1e-10]')
+    parser.add_option('-m', '--maxiter', type='int', default=50,
+                      help='iteration limit per solver '
+                      '[default: %default]')
+    parser.add_option('-a', '--amplitude', type='float', default=0.01,
+                      help='density perturbation amplitude '
+                      '[default: %default]')
+    opt, args = parser.parse_args(args)
+    if len(args) != 1:
+        parser.error('expected one .gpw file')
+    solvers = opt.solvers and opt.solvers.split(',') or None
+    blocksizes = (opt.blocksizes and
+                  map(int, opt.blocksizes.split(',')) or None)
+    targets = opt.targets and map(float, opt.targets.split(',')) or None
+    calc = GPAW(args[0], txt=None)
+    run(calc, solvers, blocksizes, targets, opt.maxiter, opt.amplitude)
+
+
+if __name__ == '__main__':
+    main()
@@ -79,6 +79,11 @@ class _Transformer:
         self.allocated = True
         
     def apply(self, input, output, phases=None):
+        """Transform input array(s) to output array(s).
+
+        The arrays can be 3-d or stacked 4-d (e.g. all spins at once);
+        a stack is transformed with one boundary exchange per axis per
+        chunk of bands instead of one per band."""
         self.transformer.apply(input, output, phases)
 
     def get_async_sizes(self):
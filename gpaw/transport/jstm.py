@@ -663,16 +663,31 @@ class STM:
            function matrices along the N-axis of the processor grid.
          """
 
-        dtype = 'float'        
-        if np.any(self.input_parameters['k_c']):
-            dtype = 'complex'
-
         if world.rank == 0:
             T = time.localtime()
             self.log.write(' %d:%02d:%02d ' % (T[3], T[4], T[5])
                          + 'Fullscan\n')
             self.log.flush()
-        
+
+        gpts_i, V_g = self.calculate_hoppings()
+        self.evaluate_scan(gpts_i, V_g)
+
+        T = time.localtime()
+        self.log.write(' %d:%02d:%02d' % (T[3], T[4], T[5]) +
+                       'Fullscan done\n')
+
+    def calculate_hoppings(self):
+        """Calculate the tip-surface hoppings of a constant height scan.
+
+        The tip positions are distributed over the domain communicator
+        and the overlap hamiltonian is evaluated at each position on
+        this cpu.  The hoppings do not depend on the bias, so a scan
+        over several bias voltages has to calculate them only once."""
+
+        dtype = 'float'
+        if np.any(self.input_parameters['k_c']):
+            dtype = 'complex'
+
         #distribute grid points over cpu's
         dcomm = self.domain_comm
         N_c = self.srf.wfs.gd.N_c[:2]
@@ -687,14 +702,23 @@ class STM:
             stop = l * (dcomm.rank + 1) + rest
 
         gpts_i = gpts_i[start:stop] # gridpoints on this cpu
-        V_g = np.zeros((len(gpts_i), self.nj, self.ni), 
+        V_g = np.zeros((len(gpts_i), self.nj, self.ni),
                        dtype=dtype) # V_ij's on this cpu
-        
+
         for i, gpt in enumerate(gpts_i):
             x = gpt / N_c[1]
             y = gpt % N_c[1]
             V_g[i] =  self.get_V((x, y))
 
+        return gpts_i, V_g
+
+    def evaluate_scan(self, gpts_i, V_g):
+        """Evaluate transmissions, currents and the image of a scan.
+
+        Needs the tip positions and hoppings from calculate_hoppings()
+        and the Green's function tables of the current bias in
+        self.stm_calc."""
+
         #get the distribution of the energy grid over CPUs
         el = len(self.energies) // world.size # minimum number of enpts per cpu
         erest = len(self.energies) % world.size # first #rest cpus get +1 enpt
@@ -856,11 +880,116 @@ class STM:
             pickle.dump((dmin,fullscan[0], fullscan[1]), fd, 2)
             fd.close()
         
-        world.barrier()       
+        world.barrier()
         self.scans['fullscan'] = fullscan
+
+    def scan_bias_series(self, biases, filename='bias_series.pckl'):
+        """Perform constant height scans for a series of bias voltages.
+
+        The tip-surface hoppings do not depend on the bias and are
+        calculated once for the whole series.  A bias only shifts the
+        energies at which the two lead Green's functions are
+        evaluated, so their tables are cached by those energies: the
+        lead whose potential is fixed reuses its whole table across
+        the series and the other one reuses every energy point shared
+        between bias windows.  The images are collected in
+        self.scans['bias_series'] and dumped to a file."""
+
+        p = self.input_parameters
+        w = p['w']
+        de = p['de']
+
+        self.set(bias=biases[0])
+        self.initialize()
+        stm_calc = self.stm_calc
+
+        # The retarded Green's functions of the biased junction are
+        # those of the unbiased one at shifted energies,
+        #   gft1(e) = gft1_0(e + bias * w)
+        #   gft2(e) = gft2_0(e + bias * (w - 1)),
+        # so the tables of the first bias point seed the caches:
+        bias0 = stm_calc.bias
+        gf1_table = {}
+        gf2_table = {}
+        for e, energy in enumerate(stm_calc.energies):
+            gf1_table[round(energy + bias0 * w, 8)] = stm_calc.gft1_emm[e]
+            gf2_table[round(energy + bias0 * (w - 1), 8)] = \
+                stm_calc.gft2_emm[e]
+
+        # bias independent tip-surface hoppings
+        gpts_i, V_g = self.calculate_hoppings()
+
+        series = {}
+        for bias in biases:
+            if world.rank == 0:
+                T = time.localtime()
+                self.log.write(' %d:%02d:%02d ' % (T[3], T[4], T[5])
+                               + 'Bias point %s\n' % str(bias))
+                self.log.flush()
+
+            if p['energies'] == None:
+                energies = np.sign(bias) * \
+                np.arange(-abs(bias) * w, -abs(bias) * (w - 1) + de, de)
+                energies.sort()
+            else:
+                energies = np.asarray(p['energies'])
+            self.energies = energies # global energy grid
+
+            # energy grid on this cpu, as in initialize_transport
+            l = len(energies) // world.size
+            rest = len(energies) % world.size
+            if world.rank < rest:
+                start = (l + 1) * world.rank
+                stop = (l + 1) * (world.rank + 1)
+            else:
+                start = l * world.rank + rest
+                stop = l * (world.rank + 1) + rest
+            energies = energies[start:stop]
+
+            # assemble the Green's function tables of this bias point,
+            # evaluating only the energies that are not cached yet;
+            # the stored calculator is biased by bias0, so the
+            # unbiased leads are evaluated at backshifted energies
+            gft_emm = []
+            for shift0, shift, gf_table, greenfunction in \
+                [(bias0 * w, bias * w, gf1_table,
+                  stm_calc.greenfunction1),
+                 (bias0 * (w - 1), bias * (w - 1), gf2_table,
+                  stm_calc.greenfunction2)]:
+                gft = []
+                for energy in energies:
+                    key = round(energy + shift, 8)
+                    if key not in gf_table:
+                        gf_table[key] = greenfunction.retarded(
+                            energy + shift - shift0).copy()
+                    gft.append(gf_table[key])
+                gft_emm.append(np.array(gft))
+
+            stm_calc.energies = energies # energy grid on this cpu
+            stm_calc.bias = bias
+            stm_calc.gft1_emm, stm_calc.gft2_emm = gft_emm
+            self.input_parameters['bias'] = bias
+
+            self.evaluate_scan(gpts_i, V_g)
+            series[bias] = self.scans['fullscan'][1].copy()
+
+        sgd = self.srf.wfs.gd
+        data = (np.asarray(biases), sgd.N_c, sgd.h_cv.diagonal(),
+                sgd.cell_cv, sgd.cell_cv.diagonal())
+        self.scans['bias_series'] = (data, series)
+        if world.rank == 0:
+            fd = open(filename, 'wb')
+            pickle.dump((self.get_dmin(), data, series), fd, 2)
+            fd.close()
+        world.barrier()
+
+        # the tables of the last bias point were rotated around the
+        # domain communicator by evaluate_scan
+        self.transport_uptodate = False
+
         T = time.localtime()
-        self.log.write(' %d:%02d:%02d' % (T[3], T[4], T[5]) + 
-                       'Fullscan done\n')
+        self.log.write(' %d:%02d:%02d' % (T[3], T[4], T[5]) +
+                       'Bias series done\n')
 
     def scan3d(self, zmin, zmax, filename = 'scan3d.pckl'):
         """Map the current between the minumum tip height zmin and the
@@ -177,15 +177,23 @@ class Banded_Sparse_Matrix:
         print 'mintime', mintime
                 
     def inv(self):
-        #kl, ku, index0 = self.band_index[:3]
-        #dim = index0.shape[0]
-        #inv_mat = np.eye(dim, dtype=complex)
-        #ldab = 2*kl + ku + 1
-        #source_mat = self.spar[index0]
-        #assert source_mat.flags.contiguous
-        #info = _gpaw.linear_solve_band(source_mat, inv_mat, kl, ku)            
-        #return inv_mat
-        return np.linalg.inv(self.recover()).copy()
+        kl, ku, index0 = self.band_index[:3]
+        if kl == ku and self.dtype == complex:
+            # Banded inversion with zgbsv, O(dim * kl^2) instead of
+            # O(dim^3).  spar[index0] is the band storage of the
+            # transposed matrix (column major order for LAPACK), so
+            # zgbsv solves the transposed system and the right-hand
+            # side, read row major, comes back as the inverse itself.
+            dim = index0.shape[0]
+            inv_mat = np.eye(dim, dtype=complex)
+            source_mat = self.spar[index0]
+            assert source_mat.flags.contiguous
+            info = _gpaw.linear_solve_band(source_mat, inv_mat, kl, ku)
+            if info == 0:
+                return inv_mat
+        mat = self.recover()
+        inverse_general(mat)
+        return mat
        
 class Tp_Sparse_HSD:
     def __init__(self, dtype, ns, npk, ll_index, ex=True):
@@ -248,7 +256,9 @@ class Tp_Sparse_HSD:
         self.G.reset_from_others(self.S[pk], self.H[s][pk], zp, -1, init=True)
         self.G.substract_sigma(sigma)
         if full:
-            return np.linalg.inv(self.G.recover())
+            mat = self.G.recover()
+            inverse_general(mat)
+            return mat
         else:
             #self.G.test_inv_eq()
             self.G.inv_eq()
@@ -15,13 +15,24 @@ from gpaw import debug
 from numpy import linalg
 
 elementwise_multiply_add = _gpaw.elementwise_multiply_add
+scaled_elementwise_multiply_add = _gpaw.scaled_elementwise_multiply_add
+axpby = _gpaw.axpby
+add_density = _gpaw.add_density
 utilities_vdot = _gpaw.utilities_vdot
 utilities_vdot_self = _gpaw.utilities_vdot_self
 
 
 erf = np.vectorize(_gpaw.erf, (float,), 'Error function')
 # XXX should we unify double and complex erf ???
-cerf = np.vectorize(_gpaw.cerf, (complex,), 'Complex error function')
+def cerf(z):
+    """Complex error function.
+
+    Works on scalars and arrays; arrays are evaluated in a single C
+    call instead of one boundary crossing per value."""
+    z_x = np.ascontiguousarray(z, complex)
+    erf_x = np.empty(z_x.shape, complex)
+    _gpaw.cerf_array(z_x.reshape(-1), erf_x.reshape(-1))
+    return erf_x
 
 # Factorials:
 _fact = [1, 1, 2, 6, 24, 120, 720, 5040, 40320,
@@ -118,6 +129,18 @@ def hartree(l, nrdr, beta, N, vr):
     assert nrdr.shape == vr.shape and len(vr.shape) == 1
     return _gpaw.hartree(l, nrdr, beta, N, vr)
 
+
+def hartree_batch(l, nrdr_xg, beta, N, vr_xg):
+    """Calculate radial Coulomb integrals for a batch of densities.
+
+    Like hartree, but solves for all the densities in nrdr_xg (one per
+    row, all with the same angular momentum l) in a single call,
+    sharing the radial grid geometry between them."""
+    assert is_contiguous(nrdr_xg, float)
+    assert is_contiguous(vr_xg, float)
+    assert nrdr_xg.shape == vr_xg.shape and len(vr_xg.shape) == 2
+    return _gpaw.hartree_batch(l, nrdr_xg, beta, N, vr_xg)
+
 def packed_index(i1, i2, ni):
     """Return a packed index"""
     if i1 > i2:
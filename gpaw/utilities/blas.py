@@ -81,6 +81,34 @@ def gemm(alpha, a, b, beta, c, transa='n'):
     _gpaw.gemm(alpha, a, b, beta, c, transa)
 
 
+def gemm_batched(alpha, a, b, beta, c):
+    """Batch of equally shaped General Matrix Multiplies.
+
+    Performs the operation::
+
+      c  <- alpha * a .b  + beta * c
+       x            x  x           x
+
+    for all x, where a, b and c are 3-d arrays and x runs over the
+    first axis.  Use this instead of a Python loop over gemm when
+    multiplying many small (e.g. per-atom) matrices - one call replaces
+    the per-matrix Python and BLAS call overhead.
+    """
+    assert np.isfinite(c).all()
+
+    assert (a.dtype == float and b.dtype == float and c.dtype == float and
+            isinstance(alpha, float) and isinstance(beta, float) or
+            a.dtype == complex and b.dtype == complex and c.dtype == complex)
+    assert a.flags.contiguous
+    assert b.flags.contiguous
+    assert c.flags.contiguous
+    assert a.ndim == 3 and b.ndim == 3 and c.ndim == 3
+    assert a.shape[0] == b.shape[0] == c.shape[0]
+    assert a.shape[2] == b.shape[1]
+    assert c.shape[1:] == (a.shape[1], b.shape[2])
+    _gpaw.gemm_batched(alpha, a, b, beta, c)
+
+
 def gemv(alpha, a, x, beta, y, trans='t'):
     """General Matrix Vector product.
 
@@ -139,6 +167,71 @@ def axpy(alpha, x, y):
     _gpaw.axpy(alpha, x, y)
 
 
+def multi_axpy(alpha_n, x_nG, y_nG):
+    """One axpy per band in a single call.
+
+    Performs the operation::
+
+      y  <- alpha * x  + y
+       n        n    n    n
+
+    for all n, where the first axis of ``x`` and ``y`` counts the
+    vectors.  ``alpha_n`` may be a real array together with complex
+    vectors."""
+    assert alpha_n.flags.contiguous
+    assert x_nG.flags.contiguous and y_nG.flags.contiguous
+    if alpha_n.dtype == complex:
+        assert x_nG.dtype == complex
+    else:
+        assert alpha_n.dtype == float
+        assert x_nG.dtype in [float, complex]
+    assert x_nG.dtype == y_nG.dtype
+    assert x_nG.shape == y_nG.shape
+    assert alpha_n.shape == x_nG.shape[:1]
+    _gpaw.multi_axpy(alpha_n, x_nG, y_nG)
+
+
+def multi_dotu(x_nG, y_nG, s_n):
+    """One unconjugated dot product per band in a single call.
+
+    Fills ``s_n`` with the values of the operation::
+
+            _
+           \
+      s  =  ) x       * y
+       n   /_  nijk...   nijk...
+          ijk...
+
+    where the first axis of ``x`` and ``y`` counts the vectors."""
+    assert x_nG.flags.contiguous and y_nG.flags.contiguous
+    assert s_n.flags.contiguous
+    assert x_nG.dtype in [float, complex]
+    assert x_nG.dtype == y_nG.dtype == s_n.dtype
+    assert x_nG.shape == y_nG.shape
+    assert s_n.shape == x_nG.shape[:1]
+    _gpaw.multi_dotu(x_nG, y_nG, s_n)
+
+
+def multi_dotc(x_nG, y_nG, s_n):
+    """One conjugated dot product per band in a single call.
+
+    Like multi_dotu, but the first vector is complex conjugated::
+
+            _
+           \   cc
+      s  =  ) x       * y
+       n   /_  nijk...   nijk...
+          ijk...
+    """
+    assert x_nG.flags.contiguous and y_nG.flags.contiguous
+    assert s_n.flags.contiguous
+    assert x_nG.dtype in [float, complex]
+    assert x_nG.dtype == y_nG.dtype == s_n.dtype
+    assert x_nG.shape == y_nG.shape
+    assert s_n.shape == x_nG.shape[:1]
+    _gpaw.multi_dotc(x_nG, y_nG, s_n)
+
+
 def rk(alpha, a, beta, c):
     """Rank-k update of a matrix.
 
@@ -332,8 +425,12 @@ def _rotate(in_jj, U_ij, a=1., b=0., out_ii=None, work_ij=None):
 if not debug:
     scal = _gpaw.scal
     gemm = _gpaw.gemm
+    gemm_batched = _gpaw.gemm_batched
     gemv = _gpaw.gemv
     axpy = _gpaw.axpy
+    multi_axpy = _gpaw.multi_axpy
+    multi_dotu = _gpaw.multi_dotu
+    multi_dotc = _gpaw.multi_dotc
     rk = _gpaw.rk
     r2k = _gpaw.r2k
     dotc = _gpaw.dotc
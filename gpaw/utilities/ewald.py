@@ -2,6 +2,7 @@ import numpy as np
 
 from gpaw.utilities import erf
 from math import pi
+import _gpaw
 
 
 def erfc(x):
@@ -39,11 +40,30 @@ class Ewald:
         """Wigner-Seitz radius for N electrons in the unit cell."""
         return ( 3. * self.Vcell / (4. * pi * N))**(1./3.)
 
+    def get_sums(self, r_xv):
+        """The real and reciprocal space sums for a batch of vectors.
+
+        Evaluates the lattice sums of get_sum_real_ij and
+        get_sum_recip_ij for every vector in r_xv in one call to the C
+        engine, which sets each (reciprocal) lattice vector up once
+        and streams it over the whole batch.  Returns the pair of
+        arrays (Er_x, Eg_x)."""
+        r_xv = np.ascontiguousarray(r_xv, float)
+        Er_x = np.empty(len(r_xv))
+        Eg_x = np.empty(len(r_xv))
+        _gpaw.ewald_sums(np.ascontiguousarray(self.cell, float),
+                         np.ascontiguousarray(self.recip_cell),
+                         self.G, r_xv,
+                         np.asarray(self.Nl), np.asarray(self.Ng),
+                         Er_x, Eg_x)
+        Eg_x *= pi / (self.Vcell * self.G**2)
+        return Er_x, Eg_x
+
     def get_sum_recip_ij(self, r_v, eps=1e-10):
         """The reciprocal space sum.
 
         ::
-        
+
               -----  -x  i g.r
            pi \     e   e
           ---2 |   -------   , with x = g^2/(4 G^2)
@@ -51,44 +71,23 @@ class Ewald:
               -----
              g not 0
         """
-        N = self.Ng
-        b1, b2, b3 = self.recip_cell
-        E_g = 0.
-        for i in range(-N[0], N[0] + 1):
-            for j in range(-N[1], N[1] + 1):
-                for k in range(-N[2], N[2] + 1):
-                    g_v = 2 * pi * (i * b1 + j * b2 + k * b3)
-                    g2 = np.dot(g_v, g_v)
-                    if g2 > eps: # exclude g=0
-                        x = .25 * g2 / self.G**2
-                        E_g += np.exp(1.j * np.dot(r_v, g_v) - x) / x
-        return pi / (self.Vcell * self.G**2) * E_g.real   
+        return self.get_sums(np.asarray(r_v, float).reshape((1, 3)))[1][0]
 
     def get_sum_real_ij(self, r_v, eps=1e-5):
         """The real space sum.
 
         ::
-        
-            -----   
+
+            -----
             \     erfc( G [l-r| )
-             |   -------------- 
+             |   --------------
             /         |l-r|
             -----
            l not 0
-           
+
         Note: Add the l=0 term with erfc(r).
         """
-        N = self.Nl
-        a1, a2, a3 = self.cell
-        E_r = 0.
-        for i in range(-N[0], N[0] + 1):
-            for j in range(-N[1], N[1] + 1):
-                for k in range(-N[2], N[2] + 1):       
-                    l_v = i * a1 + j * a2 + k * a3
-                    if np.linalg.norm(l_v) > eps: # exclude l=0
-                        lr = np.linalg.norm(l_v - r_v)
-                        E_r += erfc(self.G * lr) / lr
-        return E_r
+        return self.get_sums(np.asarray(r_v, float).reshape((1, 3)))[0][0]
 
     def get_electrostatic_potential(self, r, r_B, q_B, excludefroml0=None):
         """...
@@ -114,35 +113,54 @@ class Ewald:
         be included in the central (l=0) unit cell. Used for Madelung
         constants.
         """
-        E0 = 0.
+        w_B = self.get_potential_weights(r, r_B, len(q_B), excludefroml0)
+        return np.dot(w_B, q_B)
+
+    def get_electrostatic_potentials(self, r, r_B, q_cB, excludefroml0=None):
+        """The potentials at r for a batch of charge configurations.
+
+        q_cB holds one charge configuration per row, all on the same
+        positions r_B in the same lattice.  The Ewald sums only depend
+        on the geometry and are evaluated once; every configuration
+        then costs a dot product."""
+        q_cB = np.asarray(q_cB)
+        w_B = self.get_potential_weights(r, r_B, q_cB.shape[-1],
+                                         excludefroml0)
+        return np.dot(q_cB, w_B)
+
+    def get_potential_weights(self, r, r_B, nB, excludefroml0=None):
+        """Weights w_B so that phi(r) = sum_B w_B q_B.
+
+        Includes the lattice sums, the central cell terms and the
+        neutralizing homogeneous background of get_electrostatic_potential,
+        all of which are independent of the charge values."""
         if excludefroml0 is None:
-            excludefroml0 = np.zeros(len(q_B), dtype=int)
-        if excludefroml0 in range(len(q_B)):
+            excludefroml0 = np.zeros(nB, dtype=int)
+        if excludefroml0 in range(nB):
             i = excludefroml0
-            excludefroml0 = np.zeros(len(q_B), dtype=int)
+            excludefroml0 = np.zeros(nB, dtype=int)
             excludefroml0[i] = 1
-        
+
         assert sum(excludefroml0) <= 1
 
-        for i, q in enumerate(q_B): # potential from point charges
-            rprime = r - r_B[i]
-            absr = np.linalg.norm(rprime)
-            E0 += q * self.get_sum_real_ij(rprime)
-            E0 += q * self.get_sum_recip_ij(rprime)
+        rprime_Bv = np.asarray(r, float) - \
+            np.asarray(r_B, float).reshape((nB, -1))
+        Er_B, Eg_B = self.get_sums(rprime_Bv) # lattice sums, one C call
+        w_B = Er_B + Eg_B
+        for i in range(nB):
+            absr = np.linalg.norm(rprime_Bv[i])
             if excludefroml0[i]: # if sum over l not 0
                 if absr < 1e-14:
                     # lim r -> 0 erf(r G) / r = 2 * G / sqrt(pi)
-                    E0 -= q * 2. * self.G / np.sqrt(pi)
+                    w_B[i] -= 2. * self.G / np.sqrt(pi)
                 else:
-                    E0 -= q * erf(absr * self.G) / absr
+                    w_B[i] -= erf(absr * self.G) / absr
             else: # if sum over all l
-                E0 += q * erfc(absr * self.G) / absr
+                w_B[i] += erfc(absr * self.G) / absr
 
         # correct for compensating homogeneous background
-        q_hom = -sum(q_B)
-        E0 += q_hom * pi / (self.G**2 * self.Vcell)
-        
-        return E0
+        w_B -= pi / (self.G**2 * self.Vcell)
+        return w_B
 
 
 def madelung(cell):
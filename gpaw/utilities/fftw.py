@@ -0,0 +1,158 @@
+"""Cached FFTW plans with wisdom persistence.
+
+get_plan() returns a plan for a complex transform, cached by (shape,
+dtype, direction) so every descriptor shares one MEASURE-level plan
+per transform instead of re-planning (or, with numpy.fft, using the
+generic path) on every call.  Accumulated wisdom is written at exit to
+a site-configurable file - GPAW_FFTW_WISDOM, or ~/.gpaw/fftw-wisdom -
+and imported before the first plan is made, so once one job has
+measured a given grid, later jobs start with tuned plans instantly.
+
+Plans own aligned input/output buffers: fill plan.in_R, call
+plan.execute(), read plan.out_R.  execute() computes the unnormalized
+transform (FFTW convention) in both directions; callers scale backward
+transforms by 1/N.  Without libfftw3 a numpy-backed plan with the same
+interface is returned.
+"""
+
+import os
+import atexit
+import ctypes
+
+import numpy as np
+
+FORWARD = -1
+BACKWARD = 1
+
+MEASURE = 0
+ESTIMATE = 64
+
+
+def load_fftw():
+    for soname in ['libfftw3.so.3', 'libfftw3.so', 'libfftw3.dylib']:
+        try:
+            return ctypes.CDLL(soname)
+        except OSError:
+            pass
+    return None
+
+lib = load_fftw()
+
+if lib is not None:
+    lib.fftw_plan_dft.restype = ctypes.c_void_p
+    lib.fftw_plan_many_dft.restype = ctypes.c_void_p
+    lib.fftw_execute.argtypes = [ctypes.c_void_p]
+    lib.fftw_destroy_plan.argtypes = [ctypes.c_void_p]
+
+_wisdom_loaded = False
+_wisdom_dirty = False
+
+
+def wisdom_file():
+    name = os.environ.get('GPAW_FFTW_WISDOM')
+    if name:
+        return name
+    return os.path.join(os.path.expanduser('~'), '.gpaw', 'fftw-wisdom')
+
+
+def load_wisdom():
+    global _wisdom_loaded
+    if _wisdom_loaded or lib is None:
+        return
+    _wisdom_loaded = True
+    name = wisdom_file()
+    if os.path.isfile(name):
+        lib.fftw_import_wisdom_from_filename(name)
+
+
+def save_wisdom():
+    if lib is None or not _wisdom_dirty:
+        return
+    name = wisdom_file()
+    dir = os.path.dirname(name)
+    if dir and not os.path.isdir(dir):
+        try:
+            os.makedirs(dir)
+        except OSError:
+            return
+    lib.fftw_export_wisdom_to_filename(name)
+
+atexit.register(save_wisdom)
+
+
+class FFTWPlan:
+    """Complex many-dimensional FFTW plan with its own buffers.
+
+    With howmany > 1 the plan transforms that many contiguous grids in
+    one execute() call (the FFTW "many" interface), keeping twiddle
+    tables hot across bands; the buffers get a leading howmany axis."""
+    def __init__(self, shape, sign, flags=MEASURE, howmany=1):
+        global _wisdom_dirty
+        load_wisdom()
+        if howmany > 1:
+            bshape = (howmany,) + tuple(shape)
+        else:
+            bshape = tuple(shape)
+        self.in_R = np.empty(bshape, complex)
+        self.out_R = np.empty(bshape, complex)
+        self.sign = sign
+        rank = len(shape)
+        n = (ctypes.c_int * rank)(*shape)
+        in_p = ctypes.c_void_p(self.in_R.ctypes.data)
+        out_p = ctypes.c_void_p(self.out_R.ctypes.data)
+        if howmany > 1:
+            dist = int(np.prod(shape))
+            self.plan = lib.fftw_plan_many_dft(
+                rank, n, howmany,
+                in_p, None, 1, dist,
+                out_p, None, 1, dist,
+                sign, flags)
+        else:
+            self.plan = lib.fftw_plan_dft(rank, n, in_p, out_p,
+                                          sign, flags)
+        _wisdom_dirty = True
+
+    def execute(self):
+        lib.fftw_execute(self.plan)
+
+    def __del__(self):
+        if lib is not None and self.plan:
+            lib.fftw_destroy_plan(self.plan)
+
+
+class NumpyFFTPlan:
+    """Fallback plan with the FFTWPlan interface, using numpy.fft."""
+    def __init__(self, shape, sign, howmany=1):
+        if howmany > 1:
+            bshape = (howmany,) + tuple(shape)
+        else:
+            bshape = tuple(shape)
+        self.in_R = np.empty(bshape, complex)
+        self.out_R = np.empty(bshape, complex)
+        self.sign = sign
+        self.axes = tuple(range(-len(shape), 0))
+        self.ngpts = int(np.prod(shape))
+
+    def execute(self):
+        if self.sign == FORWARD:
+            self.out_R[:] = np.fft.fftn(self.in_R, axes=self.axes)
+        else:
+            # Unnormalized, like FFTW:
+            self.out_R[:] = np.fft.ifftn(self.in_R, axes=self.axes)
+            self.out_R *= self.ngpts
+
+_plans = {}
+
+
+def get_plan(shape, sign, flags=MEASURE, dtype=complex, howmany=1):
+    """Return the cached plan for this transform, creating it once."""
+    assert dtype == complex
+    key = (tuple(shape), dtype, sign, howmany)
+    plan = _plans.get(key)
+    if plan is None:
+        if lib is not None:
+            plan = FFTWPlan(shape, sign, flags, howmany)
+        else:
+            plan = NumpyFFTPlan(shape, sign, howmany)
+        _plans[key] = plan
+    return plan
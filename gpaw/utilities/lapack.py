@@ -9,7 +9,7 @@ Linear Algebra PACKage (LAPACK)
 
 import numpy as np
 
-from gpaw import debug
+from gpaw import debug, extra_parameters
 import _gpaw
 from gpaw.utilities.tools import tri2full
 from gpaw.utilities.blas import gemm
@@ -21,7 +21,10 @@ def diagonalize(a, w):
     Uses dsyevd/zheevd to diagonalize symmetric/hermitian matrix
     `a`. The eigenvectors are returned in the rows of `a`, and the
     eigenvalues in `w` in ascending order. Only the lower triangle of
-    `a` is considered."""
+    `a` is considered.
+
+    Set the ``mr3`` extra parameter to use the faster MRRR driver
+    (dsyevr/zheevr) instead - useful for large subspace matrices."""
 
     assert a.flags.contiguous
     assert w.flags.contiguous
@@ -31,7 +34,13 @@ def diagonalize(a, w):
     assert a.shape == (n, n)
     assert w.shape == (n,)
 
-    info = _gpaw.diagonalize(a, w)
+    if extra_parameters.get('mr3'):
+        # The MRRR driver writes the eigenvectors to a separate array:
+        z = np.empty_like(a)
+        info = _gpaw.diagonalize_mr3(a, w, z)
+        a[:] = z
+    else:
+        info = _gpaw.diagonalize(a, w)
     if info != 0:
         raise RuntimeError('diagonalize error: %d' % info)
 
@@ -82,22 +91,114 @@ def general_diagonalize(a, w, b):
     if info != 0:
         raise RuntimeError('general_diagonalize error: %d' % info)
 
+def general_diagonalize_mixed(a, w, b):
+    """Mixed-precision version of general_diagonalize.
+
+    The generalized eigenproblem is solved in single precision
+    (ssygv/chegv) and the eigenvalues are then refined in double
+    precision as Rayleigh quotients of the single-precision
+    eigenvectors with the original matrices.  The eigenvalue error is
+    quadratic in the (single-precision) eigenvector error, so the
+    refined eigenvalues are good to ~1e-13 while the factorization
+    runs at twice the throughput.  The eigenvectors keep
+    single-precision accuracy - acceptable while the density is still
+    far from converged."""
+
+    assert a.flags.contiguous
+    assert w.flags.contiguous
+    assert a.dtype in [float, complex]
+    assert w.dtype == float
+    n = len(a)
+    assert a.shape == (n, n)
+    assert w.shape == (n,)
+    assert b.flags.contiguous
+    assert b.dtype == a.dtype
+    assert b.shape == a.shape
+
+    # Keep the originals for the refinement (only the lower triangles
+    # are valid input):
+    H = a.copy()
+    tri2full(H, 'L')
+    info = _gpaw.general_diagonalize_single(a, w, b)
+    if info != 0:
+        raise RuntimeError('general_diagonalize_single error: %d' % info)
+    if n > 0:
+        # Rayleigh quotients; the eigenvectors sit in the rows of a,
+        # and the single-precision solver left b alone (H and b are
+        # hermitian after tri2full, so z* (z H) is the quotient
+        # numerator in this storage convention):
+        tri2full(b, 'L')
+        Z = a
+        num_n = (Z.conj() * np.dot(Z, H)).sum(axis=1).real
+        den_n = (Z.conj() * np.dot(Z, b)).sum(axis=1).real
+        w[:] = num_n / den_n
+
 def inverse_cholesky(a):
     """Calculate the inverse of the Cholesky decomposition of
     a symmetric/hermitian positive definite matrix `a`.
 
     Uses dpotrf/zpotrf to calculate the decomposition and then
-    dtrtri/ztrtri for the inversion"""
+    dtrtri/ztrtri for the inversion.
+
+    Set the ``cholesky_update`` extra parameter to a drift threshold
+    to skip the refactorization whenever `a` is that close to the unit
+    matrix: the wave functions were orthonormal at the end of the
+    previous SCF iteration, so once the density is stable the overlap
+    drifts only slightly from unity and a first-order inverse factor
+    is accurate to the square of the drift."""
 
     assert a.flags.contiguous
     assert a.dtype in [float, complex]
     n = len(a)
     assert a.shape == (n, n)
 
+    tol = extra_parameters.get('cholesky_update')
+    if tol and n > 0:
+        E_nn = np.tril(a, -1)
+        d_n = a.diagonal().real - 1.0
+        if max(abs(E_nn).max(), abs(d_n).max()) < tol:
+            # a = 1 + E: the inverse Cholesky factor is
+            # 1 - tril(E, -1) - diag(E) / 2 to first order in E.
+            a[:] = -E_nn
+            a.flat[::n + 1] = 1.0 - 0.5 * d_n
+            return
+
     info = _gpaw.inverse_cholesky(a)
     if info != 0:
         raise RuntimeError('inverse_cholesky error: %d' % info)
 
+def cholesky(a):
+    """Calculate the Cholesky decomposition a = L L^d of a
+    symmetric/hermitian positive definite matrix `a`.
+
+    Uses dpotrf/zpotrf; on return the lower triangle of `a` holds the
+    factor L.  Use cholesky_solve to apply inv(L) to a set of vectors
+    without forming the explicit inverse."""
+
+    assert a.flags.contiguous
+    assert a.dtype in [float, complex]
+    n = len(a)
+    assert a.shape == (n, n)
+
+    info = _gpaw.cholesky(a)
+    if info != 0:
+        raise RuntimeError('cholesky error: %d' % info)
+
+def cholesky_solve(a, b):
+    """Overwrite `b` with inv(L) b, where L is the triangular factor
+    calculated by cholesky().
+
+    One vector per row of `b`.  This is the blocked triangular solve
+    (dtrsm/ztrsm) - half the flops of multiplying with an explicitly
+    inverted factor."""
+
+    assert a.flags.contiguous
+    assert b.flags.contiguous
+    assert b.dtype == a.dtype
+    assert len(b) == len(a)
+
+    _gpaw.cholesky_solve(a, b)
+
 def inverse_general(a):
     assert a.dtype in [float, complex]
     n = len(a)
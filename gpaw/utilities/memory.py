@@ -64,6 +64,22 @@ def maxrss():
     return 0.0 # no more ideas
 
 
+def malloc_stats():
+    """Return C-extension allocation statistics as a dict.
+
+    Maps 'file:line' call-site tags to dicts with 'live', 'high_water'
+    and 'calls' counting the bytes currently allocated, the high-water
+    mark and the number of allocations made through GPAW_MALLOC at that
+    call site.  Requires the extension to be compiled with
+    -DGPAW_MALLOC_STATS (see c/mstats.c); returns an empty dict
+    otherwise.
+    """
+    import _gpaw
+    if hasattr(_gpaw, 'memory_stats'):
+        return _gpaw.memory_stats()
+    return {}
+
+
 class MemNode:
     """Represents the estimated memory use of an object and its components.
 
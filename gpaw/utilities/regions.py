@@ -0,0 +1,21 @@
+"""Named profiler regions.
+
+region_begin() and region_end() forward phase names like
+'SCF/eigensolver' to whichever profiling backend the C extension was
+compiled against (CrayPAT, IBM HPM, or the overridable hook functions
+in c/regions.c), so external profilers show GPAW-aware regions instead
+of raw addresses.  With an extension lacking the entry points the
+calls are no-ops, so callers need no guards.
+"""
+
+import _gpaw
+
+if hasattr(_gpaw, 'region_begin'):
+    region_begin = _gpaw.region_begin
+    region_end = _gpaw.region_end
+else:
+    def region_begin(name):
+        pass
+
+    def region_end(name):
+        pass
@@ -0,0 +1,69 @@
+"""Roofline-style bandwidth and throughput report.
+
+The instrumented C objects (stencil operators, transformers and LFCs)
+accumulate wall time plus a static streaming cost model - bytes moved
+and flops executed, derived from box sizes and stencil shapes (see
+c/perf.h).  write_roofline_report() walks the hot objects hanging off
+a calculator and prints the achieved bandwidth and throughput per
+entry point, with fractions of the machine peaks when those are known
+(pass them in or set GPAW_PEAK_GBS and GPAW_PEAK_GFLOPS), so kernel
+optimizations can be prioritized per workload.  Collection must be
+switched on with _gpaw.perf_enable() before the run::
+
+    import _gpaw
+    _gpaw.perf_enable()
+    e = atoms.get_potential_energy()
+    from gpaw.utilities.roofline import write_roofline_report
+    write_roofline_report(calc)
+"""
+
+import os
+import sys
+
+
+def _candidates(calc):
+    """Yield (name, C object) for the instrumented hot objects."""
+    wfs = calc.wfs
+    density = calc.density
+    hamiltonian = calc.hamiltonian
+    for name, obj, attr in [
+        ('kinetic', getattr(wfs, 'kin', None), 'operator'),
+        ('projectors', getattr(wfs, 'pt', None), 'lfc'),
+        ('ghat', getattr(density, 'ghat', None), 'lfc'),
+        ('nct', getattr(density, 'nct', None), 'lfc'),
+        ('interpolator', getattr(density, 'interpolator', None),
+         'transformer'),
+        ('vbar', getattr(hamiltonian, 'vbar', None), 'lfc'),
+        ('restrictor', getattr(hamiltonian, 'restrictor', None),
+         'transformer')]:
+        cobj = getattr(obj, attr, None)
+        if cobj is not None and hasattr(cobj, 'get_stats'):
+            yield name, cobj
+
+
+def write_roofline_report(calc, out=sys.stdout,
+                          peak_gbs=None, peak_gflops=None):
+    """Print achieved vs. peak bandwidth and throughput per hot object.
+
+    Peaks default to the GPAW_PEAK_GBS / GPAW_PEAK_GFLOPS environment
+    variables; without them only the achieved numbers are printed."""
+    if peak_gbs is None and os.environ.get('GPAW_PEAK_GBS'):
+        peak_gbs = float(os.environ['GPAW_PEAK_GBS'])
+    if peak_gflops is None and os.environ.get('GPAW_PEAK_GFLOPS'):
+        peak_gflops = float(os.environ['GPAW_PEAK_GFLOPS'])
+
+    out.write('%-14s %8s %9s %7s %7s %9s %7s\n' %
+              ('object', 'calls', 'time[s]', 'GB/s', '%peak',
+               'GFLOP/s', '%peak'))
+    for name, cobj in _candidates(calc):
+        stats = cobj.get_stats()
+        if stats['calls'] == 0 or stats['model_bytes'] == 0:
+            continue
+        t = stats['time']
+        gbs = 1e-9 * stats['model_bytes'] / t
+        gflops = 1e-9 * stats['model_flops'] / t
+        bfrac = peak_gbs and '%6.1f%%' % (100.0 * gbs / peak_gbs) or '-'
+        ffrac = (peak_gflops and
+                 '%6.1f%%' % (100.0 * gflops / peak_gflops) or '-')
+        out.write('%-14s %8d %9.3f %7.2f %7s %9.2f %7s\n' %
+                  (name, stats['calls'], t, gbs, bfrac, gflops, ffrac))
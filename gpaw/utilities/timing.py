@@ -20,6 +20,7 @@ avoided by calling the ``update()`` function at intervals smaller than
 import time
 import math
 import sys
+import pickle
 try:
     import pytau
 except ImportError:
@@ -39,6 +40,24 @@ except ImportError:
 import gpaw.mpi as mpi
 MASTER = 0
 
+try:
+    # A clock that can not be stepped backwards by NTP adjustments, so
+    # short intervals measured with it are always trustworthy:
+    import ctypes
+    class _timespec(ctypes.Structure):
+        _fields_ = [('tv_sec', ctypes.c_long), ('tv_nsec', ctypes.c_long)]
+    _clock_gettime = ctypes.CDLL('librt.so.1', use_errno=True).clock_gettime
+    _CLOCK_MONOTONIC = 1  # from <linux/time.h>
+    def monotonic():
+        """Return the value of a monotonic clock in seconds."""
+        t = _timespec()
+        if _clock_gettime(_CLOCK_MONOTONIC, ctypes.byref(t)) != 0:
+            return time.time()
+        return t.tv_sec + 1e-9 * t.tv_nsec
+    monotonic()
+except (ImportError, OSError, AttributeError):
+    monotonic = time.time
+
 wrap = 1e-6 * 2**32
 
 # Global variables:
@@ -108,7 +127,11 @@ class Timer:
     def get_time(self, *names):
 #        print self.timers, names
         return self.timers[names]
-                
+
+    def get_timers(self):
+        """Return a copy of the accumulated (inclusive) times."""
+        return dict(self.timers)
+
     def write(self, out=sys.stdout):
         while self.running:
             self.stop()
@@ -165,6 +188,176 @@ class Timer:
             self.timers[name] = self.timers.get(name, 0.0) + t
 
 
+class TraceTimer(Timer):
+    """Timer that records individual events for timeline viewing.
+
+    Instead of updating the accumulated-time dictionary, start() and
+    stop() record one (region, start, stop) event in a preallocated
+    ring buffer using the monotonic clock, so a start/stop pair costs
+    little more than two clock readings.  When the buffer wraps around,
+    the evicted events are folded into the usual totals - write()
+    always reports exact accumulated times, while write_trace()
+    exports the last ``size`` events in the trace-event JSON format
+    that chrome://tracing and other timeline viewers understand."""
+
+    def __init__(self, print_levels=1000, size=100000):
+        Timer.__init__(self, print_levels)
+        self.size = size
+        self.epoch = monotonic()
+        self.event_names = [None] * size
+        self.event_t1 = [0.0] * size
+        self.event_t2 = [0.0] * size
+        self.head = 0
+        self.wrapped = False
+        self.stack = []
+        # Cache of (parent names, name) -> names tuples, so start()
+        # does not have to build a new tuple on every call:
+        self.names_cache = {}
+
+    def start(self, name):
+        if self.stack:
+            parent = self.stack[-1][0]
+        else:
+            parent = ()
+        names = self.names_cache.get((parent, name))
+        if names is None:
+            names = parent + (name,)
+            self.names_cache[(parent, name)] = names
+        self.stack.append((names, monotonic()))
+        self.running.append(name)
+
+    def stop(self, name=None):
+        if name is None:
+            name = self.running[-1]
+        if name != self.running[-1]:
+            raise RuntimeError('Must stop timers by stack order.  '
+                               'Requested stopping of %s but topmost is %s'
+                               % (name, self.running[-1]))
+        self.running.pop()
+        names, t1 = self.stack.pop()
+        head = self.head
+        if self.wrapped:
+            # Fold the event about to be evicted into the totals:
+            old = self.event_names[head]
+            self.timers[old] = (self.timers.get(old, 0.0) +
+                                self.event_t2[head] - self.event_t1[head])
+        self.event_names[head] = names
+        self.event_t1[head] = t1
+        self.event_t2[head] = monotonic()
+        head += 1
+        if head == self.size:
+            head = 0
+            self.wrapped = True
+        self.head = head
+
+    def get_timers(self):
+        timers = dict(self.timers)
+        if self.wrapped:
+            nevents = self.size
+        else:
+            nevents = self.head
+        for e in range(nevents):
+            names = self.event_names[e]
+            timers[names] = (timers.get(names, 0.0) +
+                             self.event_t2[e] - self.event_t1[e])
+        return timers
+
+    def get_time(self, *names):
+        return self.get_timers()[names]
+
+    def write(self, out=sys.stdout):
+        while self.running:
+            self.stop()
+        self.timers = self.get_timers()
+        self.head = 0
+        self.wrapped = False
+        Timer.write(self, out)
+
+    def _trace_events(self, pid):
+        # One complete event ('X') per buffered event, oldest first;
+        # timestamps and durations are in microseconds:
+        if self.wrapped:
+            order = range(self.head, self.size) + range(self.head)
+        else:
+            order = range(self.head)
+        lines = []
+        for e in order:
+            name = self.event_names[e][-1]
+            name = name.replace('\\', '\\\\').replace('"', '\\"')
+            lines.append('{"ph": "X", "name": "%s", "pid": %d, "tid": 0, '
+                         '"ts": %.3f, "dur": %.3f}' %
+                         (name, pid,
+                          1e6 * (self.event_t1[e] - self.epoch),
+                          1e6 * (self.event_t2[e] - self.event_t1[e])))
+        return lines
+
+    def write_trace(self, filename, comm=None):
+        """Write the buffered events to a trace-event JSON file.
+
+        The file can be opened in chrome://tracing or any other viewer
+        of the trace-event format.  With a communicator the events of
+        all ranks are collected into one file with one process line per
+        rank; note that each rank's timeline starts at its own timer
+        creation, so the lines are only aligned to within the rank
+        startup skew."""
+        if comm is None or comm.size == 1:
+            lines = self._trace_events(0)
+        elif comm.rank == 0:
+            lines = self._trace_events(0)
+            for rank in range(1, comm.size):
+                lines.extend(pickle.loads(mpi.receive_string(rank, comm)))
+        else:
+            string = pickle.dumps(self._trace_events(comm.rank),
+                                  pickle.HIGHEST_PROTOCOL)
+            mpi.send_string(string, 0, comm)
+            return
+        f = open(filename, 'w')
+        f.write('{"traceEvents": [\n')
+        f.write(',\n'.join(lines))
+        f.write('\n]}\n')
+        f.close()
+
+
+def summarize_timers(timer, comm=mpi.world, out=sys.stdout):
+    """Print a parallel timing summary.
+
+    The accumulated (inclusive) time of every region is gathered on the
+    master rank, which prints the average, minimum and maximum across
+    ranks together with the load imbalance max/avg - 1.00 means
+    perfectly balanced."""
+    while timer.running:
+        timer.stop()
+    if comm.rank != MASTER:
+        string = pickle.dumps(timer.get_timers(), pickle.HIGHEST_PROTOCOL)
+        mpi.send_string(string, MASTER, comm)
+        return
+    timers_r = [timer.get_timers()]
+    for rank in range(1, comm.size):
+        timers_r.append(pickle.loads(mpi.receive_string(rank, comm)))
+    allnames = set()
+    for timers in timers_r:
+        allnames.update(timers)
+    if not allnames:
+        return
+    allnames = sorted(allnames)
+    n = max([len(names[-1]) + len(names) for names in allnames]) + 1
+    out.write('\n%s\n' % ('=' * 60))
+    out.write('%-*s     avg.      min.      max.  imbal.\n' %
+              (n, 'Timing (%d ranks):' % comm.size))
+    out.write('%s\n' % ('=' * 60))
+    for names in allnames:
+        t_r = [timers.get(names, 0.0) for timers in timers_r]
+        tavg = sum(t_r) / comm.size
+        if tavg > 0.0:
+            imbalance = '%6.2f' % (max(t_r) / tavg)
+        else:
+            imbalance = '     -'
+        name = (len(names) - 1) * ' ' + names[-1] + ':'
+        out.write('%-*s%9.3f %9.3f %9.3f  %s\n' %
+                  (n, name, tavg, min(t_r), max(t_r), imbalance))
+    out.write('%s\n' % ('=' * 60))
+
+
 class NullTimer:
     """Compatible with Timer and StepTimer interfaces.  Does nothing."""
     def __init__(self): pass
@@ -172,6 +365,8 @@ class NullTimer:
     def stop(self, name=None): pass
     def gettime(self, name):
         return 0.0
+    def get_timers(self):
+        return {}
     def write(self, out=sys.stdout): pass
     def write_now(self, mark=''): pass
     def add(self, timer): pass
@@ -0,0 +1,108 @@
+"""Persistent GPAW worker process.
+
+High-throughput screening pays the Python/MPI startup cost and the
+setup file parsing for every job, which can rival the SCF time for
+small systems.  The worker keeps one MPI-launched process tree alive
+and runs a sequence of task scripts in it, so imports happen once and
+the parsed setups stay in the in-memory cache of gpaw.setup_data.
+
+Tasks are plain GPAW scripts dropped into a spool directory::
+
+  mpirun -np 64 gpaw-python `which gpaw-worker` spool/
+
+The master rank claims the alphabetically first ``*.py`` file by
+renaming it to ``*.py.running`` (rename is atomic, so several workers
+can share one spool directory), every rank executes it like a script,
+and the file ends up as ``*.py.done`` or ``*.py.failed``.  The worker
+polls until a file called ``stop`` appears in the directory.
+
+A failing task is caught and reported without killing the worker, but
+a task that dies inside a collective operation can leave the ranks out
+of step - keep tasks to ordinary calculations."""
+
+import os
+import sys
+import time
+import traceback
+from optparse import OptionParser
+
+import gpaw.mpi as mpi
+
+
+def claim_next_task(dir):
+    """Claim the first unclaimed task script, or return None."""
+    for name in sorted(os.listdir(dir)):
+        if not name.endswith('.py'):
+            continue
+        filename = os.path.join(dir, name)
+        try:
+            os.rename(filename, filename + '.running')
+        except OSError:
+            continue  # someone else got it first
+        return filename
+    return None
+
+
+def execute(filename):
+    """Run a task script the way the interpreter would."""
+    namespace = {'__name__': '__main__', '__file__': filename}
+    execfile(filename, namespace)
+
+
+def run(argv=None):
+    if argv is None:
+        argv = sys.argv[1:]
+
+    parser = OptionParser(usage='%prog [options] taskdir',
+                          description='Run GPAW task scripts from a spool '
+                          'directory in one long-lived process tree.')
+    parser.add_option('--poll', type='float', default=5.0, metavar='SECONDS',
+                      help='how often to look for new tasks '
+                      '[default: %default]')
+    parser.add_option('--once', action='store_true', default=False,
+                      help='exit when the directory has no more tasks '
+                      'instead of polling')
+    opt, args = parser.parse_args(argv)
+    if len(args) != 1:
+        parser.error('expected exactly one task directory')
+    dir = args[0]
+
+    while True:
+        # The master alone looks at the file system - both for the next
+        # task and for the stop file - so that every rank takes the same
+        # branch and nobody is left behind in the next broadcast:
+        if mpi.rank == 0:
+            task = claim_next_task(dir)
+            stop = (task is None and
+                    (opt.once or os.path.isfile(os.path.join(dir, 'stop'))))
+            task = (task, stop)
+        else:
+            task = None
+        task, stop = mpi.broadcast(task, 0)
+
+        if task is None:
+            if stop:
+                break
+            time.sleep(opt.poll)
+            continue
+
+        try:
+            execute(task + '.running')
+        except (KeyboardInterrupt, SystemExit):
+            raise
+        except Exception:
+            traceback.print_exc()
+            tag = '.failed'
+        else:
+            tag = '.done'
+        # All ranks finish the task before the master renames it:
+        mpi.world.barrier()
+        if mpi.rank == 0:
+            os.rename(task + '.running', task + tag)
+
+
+def main():
+    try:
+        run()
+    except KeyboardInterrupt:
+        pass
@@ -93,12 +93,29 @@ class WaveFunctions(EmptyWaveFunctions):
 
     def calculate_density_contribution(self, nt_sG):
         """Calculate contribution to pseudo density from wave functions."""
+        for x in self.icalculate_density_contribution(nt_sG):
+            pass
+
+    def icalculate_density_contribution(self, nt_sG):
+        """Iterator version of calculate_density_contribution.
+
+        The band group and k-point reductions of the grid contribution
+        run non-blocking; each of the two steps of the iterator
+        finishes one of them, so work done between the steps (like the
+        atomic density matrices in Density.update) overlaps the
+        reductions."""
         nt_sG.fill(0.0)
         for kpt in self.kpt_u:
             self.add_to_density_from_k_point(nt_sG, kpt)
-        self.band_comm.sum(nt_sG)
-        self.kpt_comm.sum(nt_sG)
-        
+        request = self.band_comm.isum(nt_sG)
+        yield None
+        if request is not None:
+            self.band_comm.wait(request)
+        request = self.kpt_comm.isum(nt_sG)
+        yield None
+        if request is not None:
+            self.kpt_comm.wait(request)
+
         self.timer.start('Symmetrize density')
         for nt_G in nt_sG:
             self.symmetry.symmetrize(nt_G, self.gd)
@@ -226,6 +243,89 @@ class WaveFunctions(EmptyWaveFunctions):
         if self.symmetry is not None:
             self.symmetry.check(spos_ac)
 
+    def rebalance_kpoints(self):
+        """Even out the k-point distribution from measured times.
+
+        Repartitions the ks-pairs with the iteration times the
+        eigensolver feeds to the k-point descriptor and moves whole
+        k-points - wave functions, projections, eigenvalues and
+        occupation numbers - from overloaded to idle ranks.  The moved
+        state is exact, so the SCF iteration continues unchanged.
+        Collective over the k-point communicator; returns True if
+        anything moved."""
+
+        kd = self.kd
+        if kd.comm.size == 1:
+            kd.mytime_u = None
+            return False
+
+        # Extra per-k-point state (e.g. dscf orbital constraints) does
+        # not migrate - leave such calculations alone:
+        ok = int(not any(hasattr(kpt, 'c_on') for kpt in self.kpt_u))
+        if kd.comm.sum(ok) < kd.comm.size:
+            kd.mytime_u = None
+            return False
+
+        old_rank_ks = np.empty(kd.nks, int)
+        for r in range(kd.comm.size):
+            o = kd.offset_r[r]
+            old_rank_ks[o:o + kd.count_r[r]] = r
+        old_ks0 = kd.ks0
+        old_kpt_u = self.kpt_u
+
+        if not kd.rebalance():
+            return False
+
+        new_rank_ks = np.empty(kd.nks, int)
+        for r in range(kd.comm.size):
+            o = kd.offset_r[r]
+            new_rank_ks[o:o + kd.count_r[r]] = r
+
+        self.timer.start('Redistribute k-points')
+        comm = kd.comm
+        my_atom_indices = np.argwhere(
+            self.rank_a == self.gd.comm.rank).ravel()
+        requests = []
+
+        for myu, kpt in enumerate(old_kpt_u):
+            ks = old_ks0 + myu
+            r = new_rank_ks[ks]
+            if r != comm.rank:
+                requests.append(comm.send(kpt.psit_nG, r, 1300, False))
+                requests.append(comm.send(kpt.eps_n, r, 1301, False))
+                requests.append(comm.send(kpt.f_n, r, 1302, False))
+                for a in my_atom_indices:
+                    requests.append(comm.send(kpt.P_ani[a], r, 1303, False))
+
+        self.kpt_u = kd.create_k_points(self.gd)
+        for myu, kpt in enumerate(self.kpt_u):
+            ks = kd.ks0 + myu
+            r = old_rank_ks[ks]
+            if r == comm.rank:
+                # Already here - carry the arrays over:
+                old = old_kpt_u[ks - old_ks0]
+                kpt.psit_nG = old.psit_nG
+                kpt.eps_n = old.eps_n
+                kpt.f_n = old.f_n
+                kpt.P_ani = old.P_ani
+            else:
+                kpt.psit_nG = self.wd.empty(self.mynbands, self.dtype)
+                kpt.eps_n = np.empty(self.mynbands)
+                kpt.f_n = np.empty(self.mynbands)
+                kpt.P_ani = {}
+                requests.append(comm.receive(kpt.psit_nG, r, 1300, False))
+                requests.append(comm.receive(kpt.eps_n, r, 1301, False))
+                requests.append(comm.receive(kpt.f_n, r, 1302, False))
+                for a in my_atom_indices:
+                    ni = self.setups[a].ni
+                    kpt.P_ani[a] = np.empty((self.mynbands, ni), self.dtype)
+                    requests.append(comm.receive(kpt.P_ani[a], r, 1303,
+                                                 False))
+        comm.waitall(requests)
+        self.ibzk_qc = kd.ibzk_qc
+        self.timer.stop('Redistribute k-points')
+        return True
+
     def allocate_arrays_for_projections(self, my_atom_indices):
         if not self.positions_set and self.kpt_u[0].P_ani is not None:
             # Projections have been read from file - don't delete them!
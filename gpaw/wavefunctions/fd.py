@@ -4,7 +4,7 @@ from gpaw.overlap import Overlap
 from gpaw.fd_operators import Laplace
 from gpaw.lfc import LocalizedFunctionsCollection as LFC
 from gpaw.utilities import unpack
-from gpaw.io.tar import TarFileReference
+from gpaw.io import FileReference
 from gpaw.lfc import BasisFunctions
 from gpaw.utilities.blas import axpy
 from gpaw.transformers import Transformer
@@ -14,6 +14,7 @@ from gpaw import extra_parameters
 from gpaw.wavefunctions.fdpw import FDPWWaveFunctions
 from gpaw.hs_operators import MatrixOperator
 from gpaw.preconditioner import Preconditioner
+import _gpaw
 
 
 class FDWaveFunctions(FDPWWaveFunctions):
@@ -51,6 +52,14 @@ class FDWaveFunctions(FDPWWaveFunctions):
         self.kin.apply(psit_xG, Htpsit_xG, kpt.phase_cd)
         hamiltonian.apply_local_potential(psit_xG, Htpsit_xG, kpt.s)
 
+    def apply_pseudo_hamiltonian_and_subtract(self, kpt, hamiltonian,
+                                              psit_xG, eps_x, Htpsit_xG):
+        # The eigenvalues are folded into the central coefficient of the
+        # kinetic stencil, so the residual never makes a separate
+        # subtraction pass over the grid:
+        self.kin.apply_and_subtract(psit_xG, Htpsit_xG, eps_x, kpt.phase_cd)
+        hamiltonian.apply_local_potential(psit_xG, Htpsit_xG, kpt.s)
+
     def add_orbital_density(self, nt_G, kpt, n):
         if self.dtype == float:
             axpy(1.0, kpt.psit_nG[n]**2, nt_G)
@@ -61,7 +70,12 @@ class FDWaveFunctions(FDPWWaveFunctions):
     def add_to_density_from_k_point_with_occupation(self, nt_sG, kpt, f_n):
         # Used in calculation of response part of GLLB-potential
         nt_G = nt_sG[kpt.s]
-        if self.dtype == float:
+        if isinstance(kpt.psit_nG, np.ndarray):
+            # Accumulate f * |psit|^2 for all bands in one fused pass
+            # without squared temporaries:
+            _gpaw.add_density(kpt.psit_nG,
+                              np.ascontiguousarray(f_n, float), nt_G)
+        elif self.dtype == float:
             for f, psit_G in zip(f_n, kpt.psit_nG):
                 axpy(f, psit_G**2, nt_G)
         else:
@@ -83,16 +97,27 @@ class FDWaveFunctions(FDPWWaveFunctions):
 
     def calculate_kinetic_energy_density(self, tauct, grad_v):
         assert not hasattr(self.kpt_u[0], 'c_on')
-        if isinstance(self.kpt_u[0].psit_nG, TarFileReference):
+        if isinstance(self.kpt_u[0].psit_nG, FileReference):
             raise RuntimeError('Wavefunctions have not been initialized.')
 
         taut_sG = self.gd.zeros(self.nspins)
-        dpsit_G = self.gd.empty(dtype=self.dtype)
-        for kpt in self.kpt_u:
-            for f, psit_G in zip(kpt.f_n, kpt.psit_nG):
-                for v in range(3):
-                    grad_v[v](psit_G, dpsit_G, kpt.phase_cd)
-                    axpy(0.5 * f, abs(dpsit_G)**2, taut_sG[kpt.s])
+        if grad_v[0].dtype == self.dtype:
+            # Fused C driver: all three gradients of a block of bands
+            # and the occupation-weighted accumulation of |grad psi|^2
+            # in one pass, with a single halo exchange per band block.
+            op_v = [grad.operator for grad in grad_v]
+            for kpt in self.kpt_u:
+                _gpaw.add_kinetic_energy_density(
+                    op_v[0], op_v[1], op_v[2], kpt.psit_nG,
+                    np.ascontiguousarray(kpt.f_n, float),
+                    taut_sG[kpt.s], kpt.phase_cd)
+        else:
+            dpsit_G = self.gd.empty(dtype=self.dtype)
+            for kpt in self.kpt_u:
+                for f, psit_G in zip(kpt.f_n, kpt.psit_nG):
+                    for v in range(3):
+                        grad_v[v].apply(psit_G, dpsit_G, kpt.phase_cd)
+                        axpy(0.5 * f, abs(dpsit_G)**2, taut_sG[kpt.s])
 
         self.kpt_comm.sum(taut_sG)
         self.band_comm.sum(taut_sG)
@@ -5,7 +5,7 @@ from gpaw.overlap import Overlap
 from gpaw.fd_operators import Laplace
 from gpaw.lfc import LocalizedFunctionsCollection as LFC
 from gpaw.utilities import unpack
-from gpaw.io.tar import TarFileReference
+from gpaw.io import FileReference
 from gpaw.lfc import BasisFunctions
 from gpaw.utilities.blas import axpy
 from gpaw.transformers import Transformer
@@ -39,11 +39,32 @@ class FDPWWaveFunctions(WaveFunctions):
 
     def set_positions(self, spos_ac):
         WaveFunctions.set_positions(self, spos_ac)
+        self.spos_ac = spos_ac
         self.set_orthonormalized(False)
         self.pt.set_positions(spos_ac)
         self.allocate_arrays_for_projections(self.pt.my_atom_indices)
         self.positions_set = True
 
+    def rebalance_kpoints(self):
+        if not WaveFunctions.rebalance_kpoints(self):
+            return False
+        if not self.gamma:
+            # The local set of k-points changed, so the projectors need
+            # the phase factors of the new set:
+            self.pt.set_k_points(self.kd.ibzk_qc)
+            self.pt.set_positions(self.spos_ac)
+        return True
+
+    def apply_pseudo_hamiltonian_and_subtract(self, kpt, hamiltonian,
+                                              psit_xG, eps_x, Htpsit_xG):
+        """Calculate (H - eps) applied to psit_xG.
+
+        Generic fallback: apply the pseudo Hamiltonian and subtract
+        eps_x * psit_xG in a second pass.  Subclasses can fuse the two."""
+        self.apply_pseudo_hamiltonian(kpt, hamiltonian, psit_xG, Htpsit_xG)
+        for Htpsit_G, eps, psit_G in zip(Htpsit_xG, eps_x, psit_xG):
+            axpy(-eps, psit_G, Htpsit_G)
+
     def initialize(self, density, hamiltonian, spos_ac):
         if self.kpt_u[0].psit_nG is None:
             basis_functions = BasisFunctions(self.gd,
@@ -53,7 +74,7 @@ class FDPWWaveFunctions(WaveFunctions):
             if not self.gamma:
                 basis_functions.set_k_points(self.kd.ibzk_qc)
             basis_functions.set_positions(spos_ac)
-        elif isinstance(self.kpt_u[0].psit_nG, TarFileReference):
+        elif isinstance(self.kpt_u[0].psit_nG, FileReference):
             self.initialize_wave_functions_from_restart_file()
 
         if self.kpt_u[0].psit_nG is not None:
@@ -133,7 +154,7 @@ class FDPWWaveFunctions(WaveFunctions):
         self.timer.stop('LCAO initialization')
 
     def initialize_wave_functions_from_restart_file(self):
-        if not isinstance(self.kpt_u[0].psit_nG, TarFileReference):
+        if not isinstance(self.kpt_u[0].psit_nG, FileReference):
             return
 
         # Calculation started from a restart file.  Copy data
@@ -240,33 +261,110 @@ class FDPWWaveFunctions(WaveFunctions):
             raise RuntimeError('This calculator has no wave functions!')
         return psit_nG[n][:] # dereference possible tar-file content
 
-    def write_wave_functions(self, writer):
+    def write_wave_functions(self, writer, compress=False):
         try:
             from gpaw.io.hdf5 import Writer as HDF5Writer
         except ImportError:
             hdf5 = False
         else:
             hdf5 = isinstance(writer, HDF5Writer)
-            
+
         if self.world.rank == 0 or hdf5:
-            writer.add('PseudoWaveFunctions',
-                       ('nspins', 'nibzkpts', 'nbands',
-                        'ngptsx', 'ngptsy', 'ngptsz'),
-                       dtype=self.dtype)
+            if compress and hasattr(writer, 'finish_compressed'):
+                # One float32 zlib chunk per band (gpw files only):
+                writer.add('PseudoWaveFunctions',
+                           ('nspins', 'nibzkpts', 'nbands',
+                            'ngptsx', 'ngptsy', 'ngptsz'),
+                           dtype=self.dtype, compress=True)
+            else:
+                writer.add('PseudoWaveFunctions',
+                           ('nspins', 'nibzkpts', 'nbands',
+                            'ngptsx', 'ngptsy', 'ngptsz'),
+                           dtype=self.dtype)
 
         if hdf5:
             for kpt in self.kpt_u:
                 indices = [kpt.s, kpt.k]
                 indices.append(self.bd.get_slice())
                 indices += self.gd.get_slice()
-                writer.fill(kpt.psit_nG, parallel=True, *indices)
-        else:
+                # np.asarray materializes psit_nG if it is still a
+                # file reference from a lazy restart:
+                writer.fill(np.asarray(kpt.psit_nG), parallel=True, *indices)
+        elif self.world.size == 1:
             for s in range(self.nspins):
                 for k in range(self.nibzkpts):
                     for n in range(self.nbands):
-                        psit_G = self.get_wave_function_array(n, k, s)
-                        if self.world.rank == 0:
-                            writer.fill(psit_G, s, k, n)
+                        writer.fill(self.get_wave_function_array(n, k, s),
+                                    s, k, n)
+        else:
+            self.stream_wave_functions(writer)
+
+    def stream_wave_functions(self, writer):
+        """Write all wave functions through the master in band slabs.
+
+        Each band is collected on the domain master of the rank pair
+        that owns it and sent to the global master, as in
+        get_wave_function_array, but the master posts the receives for
+        a whole slab of bands before draining the previous slab to the
+        writer.  The gathers for the next slab therefore overlap the
+        master's I/O, and master memory stays bounded by two reused
+        slab buffers instead of one allocation per band."""
+        master = (self.world.rank == 0)
+        domain_size = self.gd.comm.size
+        if master:
+            bandbytes = self.gd.bytecount(self.dtype)
+            nslab = max(1, min(self.nbands, 32 * 1024**2 // bandbytes))
+            shape = tuple(self.gd.get_size_of_global_array())
+            buf_ixG = np.empty((2, nslab) + shape, self.dtype)
+
+        for s in range(self.nspins):
+            for k in range(self.nibzkpts):
+                kpt_rank, u = self.kd.get_rank_and_index(s, k)
+                if not master:
+                    if self.kpt_comm.rank == kpt_rank:
+                        for n in range(self.nbands):
+                            band_rank, myn = self.bd.who_has(n)
+                            if self.band_comm.rank == band_rank:
+                                a_G = self.gd.collect(
+                                    self._get_wave_function_array(u, myn))
+                                if self.gd.comm.rank == 0:
+                                    self.world.send(a_G, 0, 1398)
+                    continue
+
+                pending = None
+                ibuf = 0
+                for n0 in range(0, self.nbands, nslab):
+                    n1 = min(n0 + nslab, self.nbands)
+                    requests = []
+                    for i, n in enumerate(range(n0, n1)):
+                        band_rank, myn = self.bd.who_has(n)
+                        owner = (kpt_rank * domain_size *
+                                 self.band_comm.size +
+                                 band_rank * domain_size)
+                        if owner != 0:
+                            requests.append(self.world.receive(
+                                buf_ixG[ibuf, i], owner, 1398, block=False))
+                    # Collect the bands we own ourselves (collective
+                    # over our domain):
+                    if kpt_rank == 0:
+                        for i, n in enumerate(range(n0, n1)):
+                            band_rank, myn = self.bd.who_has(n)
+                            if band_rank == 0:
+                                buf_ixG[ibuf, i] = self.gd.collect(
+                                    self._get_wave_function_array(u, myn))
+                    # Write the previous slab while this slab's sends
+                    # are still in flight:
+                    if pending is not None:
+                        p0, p1, reqs, jbuf = pending
+                        self.world.waitall(reqs)
+                        for i, n in enumerate(range(p0, p1)):
+                            writer.fill(buf_ixG[jbuf, i], s, k, n)
+                    pending = (n0, n1, requests, ibuf)
+                    ibuf = 1 - ibuf
+                p0, p1, reqs, jbuf = pending
+                self.world.waitall(reqs)
+                for i, n in enumerate(range(p0, p1)):
+                    writer.fill(buf_ixG[jbuf, i], s, k, n)
 
     def estimate_memory(self, mem):
         gridbytes = self.gd.bytecount(self.dtype)
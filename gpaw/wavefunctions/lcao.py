@@ -484,7 +484,9 @@ class LCAOWaveFunctions(WaveFunctions):
         
         self.lazyloader = LazyLoader(hamiltonian, spos_ac)
         
-    def write_wave_functions(self, writer):
+    def write_wave_functions(self, writer, compress=False):
+        # The coefficient matrices are small - compression is only
+        # worthwhile for grid wave functions, so compress is ignored.
         if self.world.rank == 0:
             writer.dimension('nbasis', self.setups.nao)
             writer.add('WaveFunctionCoefficients',
@@ -1,8 +1,8 @@
 import numpy as np
-from numpy.fft import fftn, ifftn
 import ase.units as units
 
 from gpaw.lfc import LocalizedFunctionsCollection as LFC
+from gpaw.utilities import fftw
 from gpaw.wavefunctions.fdpw import FDPWWaveFunctions
 from gpaw.hs_operators import MatrixOperator
 
@@ -35,8 +35,20 @@ class PWDescriptor:
         self.dv = gd.dv / N_c.prod()
         self.comm = gd.comm
 
+        # Cached FFTW plans (numpy fallback) for the transforms below.
+        # The batched plans transform blocksize bands per execute so
+        # the twiddle tables stay hot; leftover bands go through the
+        # single-grid plans.
+        self.blocksize = 10
+        self.fftplan = fftw.get_plan(tuple(N_c), fftw.FORWARD)
+        self.ifftplan = fftw.get_plan(tuple(N_c), fftw.BACKWARD)
+        self.fftplan_b = fftw.get_plan(tuple(N_c), fftw.FORWARD,
+                                       howmany=self.blocksize)
+        self.ifftplan_b = fftw.get_plan(tuple(N_c), fftw.BACKWARD,
+                                        howmany=self.blocksize)
+
         self.n_c = self.Q_G  # used by hs_operators.py XXX
-        
+
     def bytecount(self, dtype=float):
         return len(self.Q_G) * np.array(1, dtype).itemsize
     
@@ -55,14 +67,51 @@ class PWDescriptor:
         return np.empty(shape, complex)
     
     def fft(self, a_xR):
-        a_xQ = fftn(a_xR, axes=(-3, -2, -1))
-        return a_xQ.reshape(a_xR.shape[:-3] + (-1,))[..., self.Q_G].copy()
+        xshape = a_xR.shape[:-3]
+        a_mR = a_xR.reshape((-1,) + a_xR.shape[-3:])
+        nm = len(a_mR)
+        a_mG = np.empty((nm, len(self.Q_G)), complex)
+        B = self.blocksize
+        m = 0
+        while nm - m >= B:
+            plan = self.fftplan_b
+            plan.in_R[:] = a_mR[m:m + B]
+            plan.execute()
+            a_mG[m:m + B] = plan.out_R.reshape((B, -1))[:, self.Q_G]
+            m += B
+        plan = self.fftplan
+        while m < nm:
+            plan.in_R[:] = a_mR[m]
+            plan.execute()
+            a_mG[m] = plan.out_R.ravel()[self.Q_G]
+            m += 1
+        return a_mG.reshape(xshape + (-1,))
 
     def ifft(self, a_xG):
         xshape = a_xG.shape[:-1]
-        a_xQ = self.gd.zeros(xshape, complex)
-        a_xQ.reshape(xshape + (-1,))[..., self.Q_G] = a_xG
-        return ifftn(a_xQ, axes=(-3, -2, -1)).copy()
+        a_mG = a_xG.reshape((-1, a_xG.shape[-1]))
+        nm = len(a_mG)
+        a_mR = np.empty((nm,) + tuple(self.gd.N_c), complex)
+        B = self.blocksize
+        m = 0
+        while nm - m >= B:
+            plan = self.ifftplan_b
+            in_bQ = plan.in_R.reshape((B, -1))
+            in_bQ[:] = 0.0
+            in_bQ[:, self.Q_G] = a_mG[m:m + B]
+            plan.execute()
+            a_mR[m:m + B] = plan.out_R
+            m += B
+        plan = self.ifftplan
+        in_Q = plan.in_R.ravel()
+        while m < nm:
+            in_Q[:] = 0.0
+            in_Q[self.Q_G] = a_mG[m]
+            plan.execute()
+            a_mR[m] = plan.out_R
+            m += 1
+        a_mR *= 1.0 / self.gd.N_c.prod()
+        return a_mR.reshape(xshape + tuple(self.gd.N_c))
 
 
 class Preconditioner:
@@ -100,6 +149,12 @@ class PWWaveFunctions(FDPWWaveFunctions):
     def summary(self, fd):
         fd.write('Mode: Plane waves (%d, ecut=%.3f eV)\n' %
                  (len(self.pd.Q_G), self.pd.ecut * units.Hartree))
+
+    def rebalance_kpoints(self):
+        # The plane-wave descriptor holds per-k-point G-vector data
+        # that would have to move along - not supported:
+        self.kd.mytime_u = None
+        return False
         
     def make_preconditioner(self, block=1):
         return Preconditioner(self.pd)
@@ -107,14 +162,20 @@ class PWWaveFunctions(FDPWWaveFunctions):
     def apply_pseudo_hamiltonian(self, kpt, hamiltonian, psit_xG, Htpsit_xG):
         """Apply the non-pseudo Hamiltonian i.e. without PAW corrections."""
         Htpsit_xG[:] = 0.5 * self.pd.G2_qG[kpt.q] * psit_xG
-        for psit_G, Htpsit_G in zip(psit_xG, Htpsit_xG):
-            psit_R = self.pd.ifft(psit_G)
-            Htpsit_G += self.pd.fft(psit_R * hamiltonian.vt_sG[kpt.s])
+        vt_R = hamiltonian.vt_sG[kpt.s]
+        B = self.pd.blocksize
+        for x1 in range(0, len(psit_xG), B):
+            psit_bR = self.pd.ifft(psit_xG[x1:x1 + B])
+            psit_bR *= vt_R
+            Htpsit_xG[x1:x1 + B] += self.pd.fft(psit_bR)
 
     def add_to_density_from_k_point_with_occupation(self, nt_sR, kpt, f_n):
         nt_R = nt_sR[kpt.s]
-        for f, psit_G in zip(f_n, kpt.psit_nG):
-            nt_R += f * abs(self.pd.ifft(psit_G))**2
+        B = self.pd.blocksize
+        for n1 in range(0, len(f_n), B):
+            psit_bR = self.pd.ifft(kpt.psit_nG[n1:n1 + B])
+            for f, psit_R in zip(f_n[n1:n1 + B], psit_bR):
+                nt_R += f * abs(psit_R)**2
 
     def initialize_wave_functions_from_basis_functions(self, basis_functions,
                                                        density, hamiltonian,
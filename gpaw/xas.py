@@ -4,6 +4,7 @@ from math import log, pi, sqrt
 import numpy as np
 from ase.units import Hartree
 from gpaw.utilities.cg import CG
+from gpaw.utilities.blas import gemm
 import gpaw.mpi as mpi
 
 
@@ -292,6 +293,7 @@ class RecursionMethod:
             
         self.tol = tol
         self.maxiter = maxiter
+        self.reortho = False
 
      
         if filename is not None:
@@ -454,7 +456,7 @@ class RecursionMethod:
         for u in range(nmykpts):
             self.wfs.pt.add(self.w_ucG[u], A_aci, u)
 
-    def run(self, nsteps, inverse_overlap="exact"):
+    def run(self, nsteps, inverse_overlap="exact", reorthogonalize=False):
 
         if inverse_overlap == "exact":
             self.solver = self.solve
@@ -465,7 +467,8 @@ class RecursionMethod:
         else:
             raise RuntimeError("""Error, inverse_solver must be either 'exact',
             'approximate' or 'noinverse' """)
-            
+
+        self.reortho = reorthogonalize
 
         ni = self.a_uci.shape[2]
         a_uci = np.empty((self.nmykpts, self.dim, ni + nsteps), self.wfs.dtype)
@@ -476,8 +479,21 @@ class RecursionMethod:
         self.b_uci = b_uci
 
         for u in range(self.nmykpts):
+            if reorthogonalize:
+                # Basis of this k-point's recursion: the S-orthonormal
+                # vectors and their S-images, so lost orthogonality can
+                # be repaired with two gemms per step (costs
+                # 2 * nsteps * dim grids of memory):
+                self.zbase_cjG = self.wfs.gd.zeros((self.dim, nsteps),
+                                                   self.wfs.dtype)
+                self.wbase_cjG = self.wfs.gd.zeros((self.dim, nsteps),
+                                                   self.wfs.dtype)
+                self.nbase = 0
             for i in range(nsteps):
                 self.step(u, ni + i)
+            if reorthogonalize:
+                self.zbase_cjG = None
+                self.wbase_cjG = None
 
     def step(self, u, i):
         print u, i
@@ -498,14 +514,42 @@ class RecursionMethod:
         else:
             b_c = np.reshape(np.zeros(self.dim), (self.dim, 1, 1, 1))
     
+        if self.reortho:
+            self.zbase_cjG[:, self.nbase] = z_cG
+            self.wbase_cjG[:, self.nbase] = w_cG
+            self.nbase += 1
+
         self.hamiltonian.apply(z_cG, y_cG, self.wfs, self.wfs.kpt_u[u])
         a_c = np.reshape(integrate(np.conjugate(z_cG) * y_cG), (self.dim, 1, 1, 1))
         wnew_cG = (y_cG - a_c * w_cG - b_c * wold_cG)
+        if self.reortho:
+            self.reorthogonalize(wnew_cG)
         wold_cG[:] = w_cG
         w_cG[:] = wnew_cG
         self.a_uci[u, :, i] = a_c[:, 0, 0, 0]
         self.b_uci[u, :, i] = b_c[:, 0, 0, 0]
 
+    def reorthogonalize(self, w_cG):
+        """Repair the lost orthogonality of a new block residual.
+
+        Long recursions drift: rounding reintroduces components along
+        the converged part of the spectrum.  This projects the stored
+        S-orthonormal basis out of w_cG with two gemms per channel -
+        one for the overlaps with the whole basis, one for the update -
+        instead of a dot product per stored vector."""
+
+        gd = self.wfs.gd
+        nbase = self.nbase
+        ng = w_cG[0].size
+        for c in range(self.dim):
+            z_jg = self.zbase_cjG[c, :nbase].reshape(nbase, ng)
+            w_jg = self.wbase_cjG[c, :nbase].reshape(nbase, ng)
+            w_1g = w_cG[c:c + 1].reshape(1, ng)
+            o_1j = np.zeros((1, nbase), self.wfs.dtype)
+            gemm(gd.dv, z_jg, w_1g, 0.0, o_1j, 'c')
+            gd.comm.sum(o_1j)
+            gemm(-1.0, w_jg, o_1j, 1.0, w_1g)
+
 
     def continued_fraction(self, e, k, c, i, imax):
         a_i = self.a_uci[k, c]
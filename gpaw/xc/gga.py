@@ -1,36 +1,38 @@
 import numpy as np
 
 from gpaw.xc.lda import LDA
-from gpaw.utilities.blas import axpy
 from gpaw.fd_operators import Gradient
+import _gpaw
 
 
 class GGA(LDA):
     def set_grid_descriptor(self, gd):
         LDA.set_grid_descriptor(self, gd)
-        self.grad_v = [Gradient(gd, v, allocate=True).apply for v in range(3)]
+        self.grad_v = [Gradient(gd, v, allocate=True) for v in range(3)]
 
     def calculate_lda(self, e_g, n_sg, v_sg):
         nspins = len(n_sg)
         gradn_svg = self.gd.empty((nspins, 3))
         sigma_xg = self.gd.zeros(nspins * 2 - 1)
         dedsigma_xg = self.gd.empty(nspins * 2 - 1)
-        for v in range(3):
-            for s in range(nspins):
-                self.grad_v[v](n_sg[s], gradn_svg[s, v])
-                axpy(1.0, gradn_svg[s, v]**2, sigma_xg[2 * s])
-            if nspins == 2:
-                axpy(1.0, gradn_svg[0, v] * gradn_svg[1, v], sigma_xg[1])
+        op_v = [grad.operator for grad in self.grad_v]
+        for s in range(nspins):
+            # All three gradients and the sigma accumulation in one
+            # traversal, with a single halo exchange of the density:
+            _gpaw.apply_gradients(op_v[0], op_v[1], op_v[2],
+                                  n_sg[s], gradn_svg[s], sigma_xg[2 * s])
+        if nspins == 2:
+            sigma_xg[1] = (gradn_svg[0] * gradn_svg[1]).sum(0)
         self.calculate_gga(e_g, n_sg, v_sg, sigma_xg, dedsigma_xg)
-        vv_g = sigma_xg[0]
-        for v in range(3):
-            for s in range(nspins):
-                self.grad_v[v](dedsigma_xg[2 * s] * gradn_svg[s, v], vv_g)
-                axpy(-2.0, vv_g, v_sg[s])
-                if nspins == 2:
-                    self.grad_v[v](dedsigma_xg[1] * gradn_svg[s, v], vv_g)
-                    axpy(-1.0, vv_g, v_sg[1 - s])
-                    # TODO: can the number of gradient evaluations be reduced?
+        for s in range(nspins):
+            # v -= 2 div(dedsigma grad n) as a fused divergence:
+            _gpaw.gradient_correction(op_v[0], op_v[1], op_v[2],
+                                      gradn_svg[s], dedsigma_xg[2 * s],
+                                      v_sg[s], -2.0)
+            if nspins == 2:
+                _gpaw.gradient_correction(op_v[0], op_v[1], op_v[2],
+                                          gradn_svg[s], dedsigma_xg[1],
+                                          v_sg[1 - s], -1.0)
 
     def calculate_gga(self, e_g, n_sg, v_sg, sigma_xg, dedsigma_xg):
         self.kernel.calculate(e_g, n_sg, v_sg, sigma_xg, dedsigma_xg)
@@ -72,6 +74,51 @@ class GGA(LDA):
         v_sg += vv_sg
         return rgd.integrate(e_g), rd_vsg, dedsigma_xg
 
+    def calculate_radial_batch(self, rgd, n_sLg, Y_nL, v_sng, e_ng,
+                               dndr_sLg, rnablaY_nLv):
+        """Evaluate the kernel for all angular slices in one call.
+
+        Same math as calculate_radial, but with the slices stacked
+        along a leading angular axis, so the kernel is dispatched once
+        for the whole sphere instead of once per point.  The radial
+        gradient corrections are added to v_sng; the integrated
+        energies, the angular gradient parts and dedsigma are returned
+        for each slice."""
+        nspins = len(n_sLg)
+        nn = len(Y_nL)
+        n_sng = np.dot(Y_nL, n_sLg).transpose(1, 0, 2).copy()
+        rd_nvsg = np.dot(rnablaY_nLv.transpose(0, 2, 1), n_sLg)
+        sigma_xng = rgd.empty((2 * nspins - 1, nn))
+        sigma_xng[::2] = (rd_nvsg**2).sum(1).transpose(1, 0, 2)
+        if nspins == 2:
+            sigma_xng[1] = (rd_nvsg[:, :, 0] * rd_nvsg[:, :, 1]).sum(1)
+        sigma_xng[:, :, 1:] /= rgd.r_g[1:]**2
+        sigma_xng[:, :, 0] = sigma_xng[:, :, 1]
+        d_sng = np.dot(Y_nL, dndr_sLg).transpose(1, 0, 2)
+        sigma_xng[::2] += d_sng**2
+        if nspins == 2:
+            sigma_xng[1] += d_sng[0] * d_sng[1]
+        dedsigma_xng = rgd.zeros((2 * nspins - 1, nn))
+        self.kernel.calculate(e_ng, n_sng, v_sng, sigma_xng, dedsigma_xng)
+        vv_sng = sigma_xng[:nspins]  # reuse array
+        for s in range(nspins):
+            for n in range(nn):
+                rgd.derivative2(-2 * rgd.dv_g * dedsigma_xng[2 * s, n] *
+                                d_sng[s, n], vv_sng[s, n])
+        if nspins == 2:
+            v_g = rgd.empty()
+            for n in range(nn):
+                rgd.derivative2(rgd.dv_g * dedsigma_xng[1, n] * d_sng[1, n],
+                                v_g)
+                vv_sng[0, n] -= v_g
+                rgd.derivative2(rgd.dv_g * dedsigma_xng[1, n] * d_sng[0, n],
+                                v_g)
+                vv_sng[1, n] -= v_g
+        vv_sng[:, :, 1:] /= rgd.dv_g[1:]
+        vv_sng[:, :, 0] = vv_sng[:, :, 1]
+        v_sng += vv_sng
+        return np.dot(e_ng, rgd.dv_g), rd_nvsg, dedsigma_xng
+
     def calculate_spherical(self, rgd, n_sg, v_sg, e_g=None):
         dndr_sg = np.empty_like(n_sg)
         for n_g, dndr_g in zip(n_sg, dndr_sg):
@@ -3,7 +3,7 @@ from gpaw.xc import XC
 from gpaw.xc.pawcorrection import rnablaY_nLv
 from gpaw.xc.gllb import safe_sqr
 from math import sqrt, pi
-from gpaw.io.tar import TarFileReference
+from gpaw.io import FileReference
 from gpaw.sphere.lebedev import weight_n
 import numpy as np
 
@@ -69,7 +69,7 @@ class C_GLLBScr(Contribution):
 
     def get_coefficients_by_kpt(self, kpt_u, lumo_perturbation=False, homolumo=None):
         if kpt_u[0].psit_nG is None or isinstance(kpt_u[0].psit_nG,
-                                                  TarFileReference): 
+                                                  FileReference): 
             return None
 
         if homolumo == None:
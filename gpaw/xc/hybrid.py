@@ -16,12 +16,14 @@ from gpaw.utilities.tools import symmetrize
 from gpaw.atom.configurations import core_states
 from gpaw.lfc import LFC
 from gpaw.utilities.blas import gemm
+import _gpaw
 from gpaw.gaunt import make_gaunt
 
 
 class HybridXC(XCFunctional):
     orbital_dependent = True
-    def __init__(self, name, hybrid=None, xc=None, finegrid=False):
+    def __init__(self, name, hybrid=None, xc=None, finegrid=False,
+                 blocksize=8):
         """Mix standard functionals with exact exchange.
 
         name: str
@@ -32,6 +34,8 @@ class HybridXC(XCFunctional):
             Standard DFT functional with scaled down exchange.
         finegrid: boolean
             Use fine grid for energy functional evaluations?
+        blocksize: int
+            Number of pair densities queued per batched Poisson solve.
         """
 
         if name == 'EXX':
@@ -54,6 +58,7 @@ class HybridXC(XCFunctional):
         self.xc = xc
         self.type = xc.type
         self.finegrid = finegrid
+        self.blocksize = blocksize
 
         XCFunctional.__init__(self, name)
 
@@ -70,6 +75,7 @@ class HybridXC(XCFunctional):
         assert wfs.gamma
         self.xc.initialize(density, hamiltonian, wfs, occupations)
         self.kpt_comm = wfs.kpt_comm
+        self.bd = wfs.bd
         self.nspins = wfs.nspins
         self.setups = wfs.setups
         self.density = density
@@ -118,15 +124,16 @@ class HybridXC(XCFunctional):
         P_ani = kpt.P_ani
         setups = self.setups
 
-        vt_g = self.finegd.empty()
-        if self.gd is not self.finegd:
-            vt_G = self.gd.empty()
-
-        nocc = int(kpt.f_n.sum()) // (3 - self.nspins)
+        f_n = kpt.f_n
+        if self.bd.comm.size > 1:
+            f_n = self.bd.collect(f_n, broadcast=True)
+        nocc = int(f_n.sum()) // (3 - self.nspins)
         self.nocc_s[kpt.s] = nocc
 
         if Htpsit_nG is not None:
-            kpt.vt_nG = self.gd.empty(nocc)
+            # Each diagonal pair is assigned by exactly one band rank,
+            # so the band sum below needs the other rows zeroed:
+            kpt.vt_nG = self.gd.zeros(nocc)
             kpt.vxx_ani = {}
             kpt.vxx_anii = {}
             for a, P_ni in P_ani.items():
@@ -138,48 +145,79 @@ class HybridXC(XCFunctional):
         ekin = 0.0
 
         # Determine pseudo-exchange
-        for n1 in range(nocc):
-            psit1_G = psit_nG[n1]
-            for n2 in range(n1, nocc):
-                psit2_G = psit_nG[n2]
+        bd = self.bd
+        B = bd.comm.size
+        if B > 1:
+            # Band parallelization: replicate the orbitals and
+            # projections over the band group, so that any rank can
+            # form any pair and the pair loop below can be split over
+            # the band communicator:
+            psit_nG = bd.collect(psit_nG, broadcast=True)
+            P_ani = dict([(a, bd.collect(P_ni, broadcast=True))
+                          for a, P_ni in P_ani.items()])
+            out_nG = None
+            if Htpsit_nG is not None:
+                htpsit_nG = self.gd.zeros(nocc)
+                out_nG = htpsit_nG
+        else:
+            out_nG = Htpsit_nG
+
+        # This band rank's share of the pair loop:
+        pair_p = [(n1, n2) for n1 in range(nocc) for n2 in range(n1, nocc)]
+        pair_p = pair_p[bd.comm.rank::B]
+
+        blocksize = self.blocksize
+        for p0 in range(0, len(pair_p), blocksize):
+            block_x = pair_p[p0:p0 + blocksize]
+            nx = len(block_x)
+
+            # Form the pair densities of the block in one batched pass:
+            nt_xG, rhot_xg = self.calculate_pair_densities(block_x,
+                                                           psit_nG, P_ani)
+
+            # ... and solve their Poisson problems as one multi-RHS
+            # multigrid run: every sweep, restriction and interpolation
+            # exchanges the halos of the whole block in one message set
+            # per axis instead of one per pair:
+            charge_x = -np.array([float(n1 == n2) for n1, n2 in block_x])
+            vt_xg = self.finegd.empty(nx)
+            self.poissonsolver.solve_batch(vt_xg, -rhot_xg, charge_x,
+                                           eps=1e-12)
+            vt_xg *= hybrid
+
+            if self.gd is self.finegd:
+                vt_xG = vt_xg
+            else:
+                vt_xG = self.gd.empty(nx)
+                self.restrictor.apply(vt_xg, vt_xG)
+
+            # Integrate the potentials on fine and coarse grids
+            int_fine_x = self.finegd.integrate(vt_xg * rhot_xg)
+            int_coarse_x = self.gd.integrate(vt_xG * nt_xG)
+            if Htpsit_nG is not None:
+                v_axL = self.ghat.dict(nx)
+                self.ghat.integrate(vt_xg, v_axL)
 
+            for x, (n1, n2) in enumerate(block_x):
                 # Double count factor:
                 dc = (1 + (n1 != n2)) * deg
-                
-                nt_G, rhot_g = self.calculate_pair_density(n1, n2, psit_nG,
-                                                           P_ani)
-                vt_g[:] = 0.0
-                iter = self.poissonsolver.solve(vt_g, -rhot_g,
-                                                charge=-float(n1 == n2),
-                                                eps=1e-12,
-                                                zero_initial_phi=True)
-                vt_g *= hybrid
-
-                if self.gd is self.finegd:
-                    vt_G = vt_g
-                else:
-                    self.restrictor.apply(vt_g, vt_G)
-
-                # Integrate the potential on fine and coarse grids
-                int_fine = self.finegd.integrate(vt_g * rhot_g)
-                int_coarse = self.gd.integrate(vt_G * nt_G)
+
                 if self.gd.comm.rank == 0:  # only add to energy on master CPU
-                    exx += 0.5 * dc * int_fine
-                    ekin -= dc * int_coarse
+                    exx += 0.5 * dc * int_fine_x[x]
+                    ekin -= dc * int_coarse_x[x]
                 if Htpsit_nG is not None:
-                    Htpsit_nG[n1] += vt_G * psit2_G
+                    vt_G = vt_xG[x]
+                    out_nG[n1] += vt_G * psit_nG[n2]
                     if n1 == n2:
                         kpt.vt_nG[n1] = vt_G
                     else:
-                        Htpsit_nG[n2] += vt_G * psit1_G
+                        out_nG[n2] += vt_G * psit_nG[n1]
 
                     # Update the vxx_uni and vxx_unii vectors of the nuclei,
-                    # used to determine the atomic hamiltonian, and the 
+                    # used to determine the atomic hamiltonian, and the
                     # residuals
-                    v_aL = self.ghat.dict()
-                    self.ghat.integrate(vt_g, v_aL)
-                    for a, v_L in v_aL.items():
-                        v_ii = unpack(np.dot(setups[a].Delta_pL, v_L))
+                    for a, v_xL in v_axL.items():
+                        v_ii = unpack(np.dot(setups[a].Delta_pL, v_xL[x]))
                         v_ni = kpt.vxx_ani[a]
                         v_nii = kpt.vxx_anii[a]
                         P_ni = P_ani[a]
@@ -190,6 +228,20 @@ class HybridXC(XCFunctional):
                             # XXX Check this:
                             v_nii[n1] = v_ii
 
+        if B > 1:
+            # Collect the pair contributions from the whole band group:
+            exx = bd.comm.sum(exx)
+            ekin = bd.comm.sum(ekin)
+            if Htpsit_nG is not None:
+                bd.comm.sum(htpsit_nG)
+                bd.comm.sum(kpt.vt_nG)
+                for a in kpt.vxx_ani:
+                    bd.comm.sum(kpt.vxx_ani[a])
+                    bd.comm.sum(kpt.vxx_anii[a])
+                for myn, n in enumerate(bd.get_band_indices()):
+                    if n < nocc:
+                        Htpsit_nG[myn] += htpsit_nG[n]
+
         # Apply the atomic corrections to the energy and the Hamiltonian matrix
         for a, P_ni in P_ani.items():
             setup = setups[a]
@@ -250,6 +302,11 @@ class HybridXC(XCFunctional):
             
         nocc = self.nocc_s[kpt.s]
         for a, P_ni in kpt.P_ani.items():
+            if self.bd.comm.size > 1:
+                # vxx_ani is indexed by global band, so the local
+                # projections must be collected over the band group
+                # before the two can be contracted:
+                P_ni = self.bd.collect(P_ni, broadcast=True)
             H_nn[:nocc, :nocc] += symmetrize(np.inner(P_ni[:nocc],
                                                       kpt.vxx_ani[a]))
         self.gd.comm.sum(H_nn)
@@ -279,6 +336,38 @@ class HybridXC(XCFunctional):
 
         return nt_G, rhot_g
 
+    def calculate_pair_densities(self, n12_x, psit_nG, P_ani):
+        """Form a block of pair densities in one pass.
+
+        The products are computed by one C call (streaming the band
+        arrays once), the block is interpolated together and the
+        compensation charges of all pairs are added in a single LFC
+        pass over the fine grid."""
+
+        nx = len(n12_x)
+        n1_x = np.array([n1 for n1, n2 in n12_x])
+        n2_x = np.array([n2 for n1, n2 in n12_x])
+        nt_xG = self.gd.empty(nx)
+        _gpaw.pair_densities(psit_nG, psit_nG, n1_x, n2_x, nt_xG)
+
+        if self.finegd is self.gd:
+            rhot_xg = nt_xG.copy()
+        else:
+            rhot_xg = self.finegd.empty(nx)
+            self.interpolator.apply(nt_xG, rhot_xg)
+
+        Q_axL = {}
+        for a, P_ni in P_ani.items():
+            Delta_pL = self.setups[a].Delta_pL
+            Q_xL = np.empty((nx, Delta_pL.shape[1]))
+            for x, (n1, n2) in enumerate(n12_x):
+                D_ii = np.outer(P_ni[n1], P_ni[n2].conj()).real
+                Q_xL[x] = np.dot(pack(D_ii), Delta_pL)
+            Q_axL[a] = Q_xL
+        self.ghat.add(rhot_xg, Q_axL)
+
+        return nt_xG, rhot_xg
+
     def add_correction(self, kpt, psit_xG, Htpsit_xG, P_axi, c_axi, n_x,
                        calculate_change=False):
         if kpt.f_n is None:
@@ -31,6 +31,17 @@ class LDA(XCFunctional):
         self.kernel.calculate(e_g, n_sg, v_sg)
         return rgd.integrate(e_g)
 
+    def calculate_radial_batch(self, rgd, n_sLg, Y_nL, v_sng, e_ng):
+        """Evaluate the kernel for all angular slices in one call.
+
+        Y_nL holds one row of spherical harmonics per angular point.
+        The slices are stacked along a leading angular axis, so the
+        kernel is dispatched once for the whole sphere instead of once
+        per point.  Returns the integrated energies, one per slice."""
+        n_sng = np.dot(Y_nL, n_sLg).transpose(1, 0, 2).copy()
+        self.kernel.calculate(e_ng, n_sng, v_sng)
+        return np.dot(e_ng, rgd.dv_g)
+
     def calculate_spherical(self, rgd, n_sg, v_sg, e_g=None):
         return self.calculate_radial(rgd, n_sg[:, np.newaxis], [1.0], v_sg,
                                      e_g=e_g)
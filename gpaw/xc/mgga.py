@@ -37,7 +37,7 @@ class MGGA(GGA):
         self.restrict = hamiltonian.restrictor.apply
         self.interpolate = density.interpolator.apply
         self.taugrad_v = [Gradient(wfs.gd, v, n=self.nn, dtype=wfs.dtype,
-                                   allocate=True).apply
+                                   allocate=True)
                           for v in range(3)]
 
     def set_positions(self, spos_ac):
@@ -70,9 +70,9 @@ class MGGA(GGA):
         a_G = self.wfs.gd.empty(dtype=psit_xG.dtype)
         for psit_G, Htpsit_G in zip(psit_xG, Htpsit_xG):
             for v in range(3):
-                self.taugrad_v[v](psit_G, a_G, kpt.phase_cd)
-                self.taugrad_v[v](self.dedtaut_sG[kpt.s] * a_G, a_G,
-                                  kpt.phase_cd)
+                self.taugrad_v[v].apply(psit_G, a_G, kpt.phase_cd)
+                self.taugrad_v[v].apply(self.dedtaut_sG[kpt.s] * a_G, a_G,
+                                        kpt.phase_cd)
                 axpy(-0.5, a_G, Htpsit_G)
 
     def add_forces(self, F_av):
@@ -123,6 +123,11 @@ class PAWXCCorrection:
         D_sLq = np.inner(D_sp, self.B_pqL.T)
         v_sg = self.rgd.empty(nspins)
         XC = xc.calculate_radial
+        # Plain LDA/GGA functionals can evaluate the whole sphere in
+        # one stacked kernel dispatch (orbital-dependent functionals
+        # override calculate_radial and MGGA needs tau per point):
+        batch = (type in ('LDA', 'GGA') and
+                 hasattr(xc, 'calculate_radial_batch'))
 
         if type == 'MGGA':
             dedtau_sg = self.rgd.empty(nspins)
@@ -145,6 +150,44 @@ class PAWXCCorrection:
                 for s in range(nspins):
                     for n_g, dndr_g in zip(n_sLg[s], dndr_sLg[s]):
                         self.rgd.derivative(n_g, dndr_g)
+            if batch:
+                nn = len(self.Y_nL)
+                e_ng = self.rgd.empty(nn)
+                v_sng = self.rgd.zeros((nspins, nn))
+                if type == 'LDA':
+                    e_n = xc.calculate_radial_batch(self.rgd, n_sLg,
+                                                    self.Y_nL, v_sng, e_ng)
+                else:
+                    e_n, rd_nvsg, dedsigma_xng = xc.calculate_radial_batch(
+                        self.rgd, n_sLg, self.Y_nL, v_sng, e_ng,
+                        dndr_sLg, self.rnablaY_nLv)
+                    # Angular gradient terms summed over the whole
+                    # sphere with matrix products:
+                    v_nvsg = (dedsigma_xng[::2].transpose(1, 0, 2)
+                              [:, np.newaxis] * rd_nvsg)
+                    if nspins == 2:
+                        v_nvsg += (0.5 * dedsigma_xng[1]
+                                   [:, np.newaxis, np.newaxis] *
+                                   rd_nvsg[:, :, ::-1])
+                    v_nvsq = np.inner(v_nvsg * self.rgd.dr_g, n_qg)
+                    wrY_nLv = (8 * pi * sign *
+                               weight_n[:, np.newaxis, np.newaxis] *
+                               self.rnablaY_nLv)
+                    A_Lsq = np.dot(
+                        wrY_nLv.transpose(1, 0, 2).reshape(self.Lmax, -1),
+                        v_nvsq.reshape(3 * nn, -1)).reshape(
+                        self.Lmax, nspins, -1)
+                    dH_sp += np.dot(
+                        A_Lsq.transpose(1, 2, 0).reshape(nspins, -1),
+                        self.B_pqL.reshape(len(self.B_pqL), -1).T)
+                de += sign * np.dot(weight_n, e_n)
+                wY_nL = sign * weight_n[:, np.newaxis] * self.Y_nL
+                dH_Lsq = np.inner(np.dot(wY_nL.T, v_sng) * self.dv_g, n_qg)
+                dH_sp += np.dot(
+                    dH_Lsq.transpose(1, 2, 0).reshape(nspins, -1),
+                    self.B_pqL.reshape(len(self.B_pqL), -1).T)
+                sign = -1
+                continue
             for n, Y_L in enumerate(self.Y_nL):
                 w = sign * weight_n[n]
                 v_sg[:] = 0.0
@@ -173,7 +216,7 @@ class PAWXCCorrection:
                     v_qvs = np.inner(n_qg, v_vsg * self.rgd.dr_g)
                     dH_sp += np.dot(B_pqv.reshape((len(B_pqv), -1)),
                                     v_qvs.reshape((-1, nspins))).T
-                    
+
                 de += w * e
                 dH_sq = w * np.inner(v_sg * self.dv_g, n_qg)
                 dH_sp += np.inner(dH_sq, np.dot(self.B_pqL, Y_L))
@@ -614,9 +614,14 @@ class FFTVDWFunctional(VDWFunctional):
         if self.verbose:
             print 'VDW: fft:',
             
+        kshape = (self.shape[0], self.shape[1], self.shape[2] // 2 + 1)
+        # The thetas are stored stacked in one contiguous array so that
+        # the convolution below can combine all local alphas in a
+        # single C call (and pass over the k-points) per output alpha:
+        theta_bk = np.empty((len(self.alphas),) + kshape, complex)
         theta_ak = {}
         p_ag = {}
-        for a in self.alphas:
+        for b, a in enumerate(self.alphas):
             self.timer.start('hmm2')
             C_pg = self.C_aip[a, i_g].transpose((3, 0, 1, 2))
             pa_g = (C_pg[0] + dq0_g *
@@ -625,11 +630,12 @@ class FFTVDWFunctional(VDWFunctional):
             self.timer.stop('hmm2')
             del C_pg
             self.timer.start('FFT')
-            theta_ak[a] = rfftn(n_g * pa_g, self.shape).copy()
+            theta_bk[b] = rfftn(n_g * pa_g, self.shape)
+            theta_ak[a] = theta_bk[b]
             if extra_parameters.get('vdw0'):
                 theta_ak[a][0, 0, 0] = 0.0
             self.timer.stop()
-            
+
             if not self.energy_only:
                 p_ag[a] = pa_g
             del pa_g
@@ -651,13 +657,12 @@ class FFTVDWFunctional(VDWFunctional):
         for a in range(N):
             if vdwcomm is not None:
                 vdw_ranka = a * vdwcomm.size // N
-                F_k = np.zeros((self.shape[0],
-                                self.shape[1],
-                                self.shape[2] // 2 + 1), complex)
+                F_k = np.zeros(kshape, complex)
             self.timer.start('Convolution')
-            for b in self.alphas:
-                _gpaw.vdw2(self.phi_aajp[a, b], self.j_k, dj_k,
-                           theta_ak[b], F_k)
+            if self.alphas:
+                phi_bjp = np.array([self.phi_aajp[a, b]
+                                    for b in self.alphas])
+                _gpaw.vdw2(phi_bjp, self.j_k, dj_k, theta_bk, F_k)
             self.timer.stop()
             
             if vdwcomm is not None:
@@ -677,7 +682,7 @@ class FFTVDWFunctional(VDWFunctional):
                 print a,
                 sys.stdout.flush()
 
-        del theta_ak
+        del theta_ak, theta_bk
 
         if self.verbose:
             print
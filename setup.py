@@ -196,7 +196,7 @@ extension = Extension('_gpaw',
 
 scripts = [join('tools', script)
            for script in ('gpaw', 'gpaw-test', 'gpaw-setup', 'gpaw-basis',
-                          'gpaw-mpisim')]
+                          'gpaw-mpisim', 'gpaw-benchmark', 'gpaw-worker')]
 
 write_configuration(define_macros, include_dirs, libraries, library_dirs,
                     extra_link_args, extra_compile_args,